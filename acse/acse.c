@@ -11,11 +11,19 @@
 #include "target_info.h"
 #include "program.h"
 #include "target_asm_print.h"
+#include "target_obj_write.h"
 #include "target_transform.h"
-#include "cfg.h"
 #include "reg_alloc.h"
+#include "optimizer.h"
 #include "parser.h"
 #include "errors.h"
+#include "build_cache.h"
+#include "time_report.h"
+#include "profile.h"
+
+#ifndef ACSE_VERSION
+#define ACSE_VERSION "unknown"
+#endif
 
 
 char *getLogFileName(const char *logType, const char *fn)
@@ -50,7 +58,7 @@ void banner(void)
 
 void version(void)
 {
-  puts("ACSE toolchain version 2.0.2");
+  puts("ACSE toolchain version " ACSE_VERSION);
   printf("Target: %s\n", TARGET_NAME);
 }
 
@@ -60,6 +68,24 @@ void usage(const char *name)
   printf("usage: %s [options] input\n\n", name);
   puts("Options:");
   puts("  -o ASMFILE    Name the output ASMFILE (default output.asm)");
+  puts("  -elf          Assemble the program and write an ELF object file");
+  puts("                instead of the assembly code (default name output.o)");
+  puts("  --cache-dir=DIR");
+  puts("                Copy the output from the cache in DIR if the same");
+  puts("                input was already compiled, and store it there");
+  puts("                otherwise. Warnings are not printed again on a hit");
+  puts("  -O0, -O1      Disable (the default) or enable the optimizations of");
+  puts("                the program before the lowering to the target");
+  puts("  -ralloc=ALGORITHM");
+  puts("                Allocate the registers with the given algorithm:");
+  puts("                `linear' for linear scan (the default), or `color'");
+  puts("                for graph coloring, which is slower but spills less");
+  puts("  -fprofile-use=FILE");
+  puts("                Use the execution counts in the profile FILE, written");
+  puts("                by `simrv32im --profile', to choose the registers to");
+  puts("                spill and the loops to optimize");
+  puts("  -time-report  Print the time and memory used by each phase of the");
+  puts("                compilation, and the size of the program after it");
   puts("  -v, --version Display version number");
   puts("  -h, --help    Displays available options");
 }
@@ -73,17 +99,63 @@ int main(int argc, char *argv[])
   FILE *logFp;
 #endif
   static const struct option options[] = {
-      {   "help", no_argument, NULL, 'h'},
-      {"version", no_argument, NULL, 'v'},
+      {     "help",       no_argument, NULL, 'h'},
+      {  "version",       no_argument, NULL, 'v'},
+      {"cache-dir", required_argument, NULL, 'C'},
+      {   "ralloc", required_argument, NULL, 'R'},
+      {      "elf",       no_argument, NULL, 'E'},
+      {"time-report",     no_argument, NULL, 'T'},
+      {"fprofile-use", required_argument, NULL, 'P'},
+      {       NULL,                 0, NULL,   0}
   };
 
-  char *outputFn = "output.asm";
+  char *outputFn = NULL;
+  bool elfOutput = false;
+  char *cacheDir = NULL;
+  char *profileFn = NULL;
+  t_regAllocAlgorithm regAllocAlgorithm = RA_LINEAR_SCAN;
+  int optLevel = 0;
 
-  while ((ch = getopt_long(argc, argv, "ho:v", options, NULL)) != -1) {
+  // Long options may also be given with a single dash, as in `-ralloc=color'.
+  while ((ch = getopt_long_only(argc, argv, "ho:vO:", options, NULL)) != -1) {
     switch (ch) {
       case 'o':
         outputFn = optarg;
         break;
+      case 'C':
+        cacheDir = optarg;
+        break;
+      case 'E':
+        elfOutput = true;
+        break;
+      case 'T':
+        timeReportEnabled = true;
+        break;
+      case 'P':
+        profileFn = optarg;
+        break;
+      case 'R':
+        if (strcmp(optarg, "linear") == 0) {
+          regAllocAlgorithm = RA_LINEAR_SCAN;
+        } else if (strcmp(optarg, "color") == 0) {
+          regAllocAlgorithm = RA_GRAPH_COLORING;
+        } else {
+          emitError(nullFileLocation, "unknown register allocator \"%s\"",
+              optarg);
+          return 1;
+        }
+        break;
+      case 'O':
+        if (strcmp(optarg, "0") == 0) {
+          optLevel = 0;
+        } else if (strcmp(optarg, "1") == 0) {
+          optLevel = 1;
+        } else {
+          emitError(nullFileLocation, "unsupported optimization level \"%s\"",
+              optarg);
+          return 1;
+        }
+        break;
       case 'h':
         usage(name);
         return 1;
@@ -106,20 +178,63 @@ int main(int argc, char *argv[])
     return 1;
   }
 
+  if (!outputFn)
+    outputFn = elfOutput ? "output.o" : "output.asm";
+
 #ifndef NDEBUG
   banner();
   printf("\n");
 #endif
 
+  t_buildCache *cache = NULL;
+  if (cacheDir) {
+    cache = newBuildCache(cacheDir, "acse " ACSE_VERSION " " TARGET_NAME);
+    if (regAllocAlgorithm == RA_GRAPH_COLORING)
+      bcacheAddOption(cache, "-ralloc=color");
+    if (optLevel > 0)
+      bcacheAddOption(cache, "-O1");
+    if (elfOutput)
+      bcacheAddOption(cache, "-elf");
+    if (profileFn)
+      bcacheAddOption(cache, "-fprofile-use");
+    // an unreadable input is reported by the parser, an unreadable profile
+    // by loadProfile()
+    if (!bcacheAddInput(cache, argv[0]) ||
+        (profileFn && !bcacheAddInput(cache, profileFn))) {
+      deleteBuildCache(cache);
+      cache = NULL;
+    } else if (bcacheFetch(cache, outputFn)) {
+#ifndef NDEBUG
+      fprintf(stderr, "Output \"%s\" copied from the cache\n", outputFn);
+#endif
+      deleteBuildCache(cache);
+      return 0;
+    }
+  }
+
+  t_profile *profile = NULL;
+  if (profileFn) {
+#ifndef NDEBUG
+    fprintf(stderr, "Reading the profile from \"%s\"\n", profileFn);
+#endif
+    profile = loadProfile(profileFn);
+    if (!profile) {
+      deleteBuildCache(cache);
+      return 1;
+    }
+  }
+
   res = 1;
 
 #ifndef NDEBUG
   fprintf(stderr, "Parsing the input program\n");
   fprintf(stderr, " -> Reading input from \"%s\"\n", argv[0]);
 #endif
+  trBegin(TR_PARSE);
   t_program *program = parseProgram(argv[0]);
   if (!program)
     goto fail;
+  trEnd(TR_PARSE, program, NULL);
 #ifndef NDEBUG
   logFn = getLogFileName("frontend", outputFn);
   logFp = fopen(logFn, "w");
@@ -131,27 +246,69 @@ int main(int argc, char *argv[])
   free(logFn);
 #endif
 
+  if (optLevel > 0) {
+    t_optStats optStats = {0};
+#ifndef NDEBUG
+    fprintf(stderr, "Optimizing the program.\n");
+#endif
+    trBegin(TR_OPTIMIZE);
+    optimizeProgram(program, profile, &optStats);
+    trEnd(TR_OPTIMIZE, program, NULL);
+#ifndef NDEBUG
+    fprintf(stderr, " -> %d variables promoted, %d instructions folded, "
+        "%d loads propagated, %d simplified, %d hoisted, %d removed, "
+        "%d unreachable\n", optStats.numPromoted, optStats.numFolded,
+        optStats.numPropagated, optStats.numSimplified, optStats.numHoisted,
+        optStats.numRemoved, optStats.numUnreachable);
+    logFn = getLogFileName("optimizer", outputFn);
+    logFp = fopen(logFn, "w");
+    if (logFp) {
+      fprintf(stderr, " -> Writing the optimized program to \"%s\"\n", logFn);
+      optStatsDump(&optStats, logFp);
+      fprintf(logFp, "\n");
+      programDump(program, logFp);
+      fclose(logFp);
+    }
+    free(logFn);
+#endif
+  }
+
 #ifndef NDEBUG
   fprintf(stderr, "Lowering of pseudo-instructions to machine instructions.\n");
 #endif
+  trBegin(TR_LOWERING);
   doTargetSpecificTransformations(program);
+  trEnd(TR_LOWERING, program, NULL);
 
 #ifndef NDEBUG
   fprintf(stderr, "Performing register allocation.\n");
+#endif
+  t_regAllocator *regAlloc =
+      newRegAllocator(program, regAllocAlgorithm, profile);
+#ifndef NDEBUG
   logFn = getLogFileName("controlFlow", outputFn);
   logFp = fopen(logFn, "w");
   if (logFp) {
     fprintf(stderr, " -> Writing the control flow graph to \"%s\"\n", logFn);
-    t_cfg *cfg = programToCFG(program);
-    cfgComputeLiveness(cfg);
-    cfgDump(cfg, logFp, true);
-    deleteCFG(cfg);
+    regallocDumpCFG(regAlloc, logFp);
     fclose(logFp);
   }
   free(logFn);
 #endif
-  t_regAllocator *regAlloc = newRegAllocator(program);
   regallocRun(regAlloc);
+  if (optLevel > 0) {
+#ifndef NDEBUG
+    fprintf(stderr, "Performing peephole optimizations.\n");
+#endif
+    trBegin(TR_PEEPHOLE);
+    int numChanges = doTargetSpecificOptimizations(program);
+    trEnd(TR_PEEPHOLE, program, NULL);
+#ifndef NDEBUG
+    fprintf(stderr, " -> %d instruction sequences simplified\n", numChanges);
+#else
+    (void)numChanges;
+#endif
+  }
 #ifndef NDEBUG
   logFn = getLogFileName("regAlloc", outputFn);
   logFp = fopen(logFn, "w");
@@ -165,7 +322,10 @@ int main(int argc, char *argv[])
   deleteRegAllocator(regAlloc);
 
 #ifndef NDEBUG
-  fprintf(stderr, "Writing the assembly file.\n");
+  if (elfOutput)
+    fprintf(stderr, "Writing the object file.\n");
+  else
+    fprintf(stderr, "Writing the assembly file.\n");
   fprintf(stderr, " -> Output file name: \"%s\"\n", outputFn);
   fprintf(stderr, " -> Code segment size: %d instructions\n",
       listLength(program->instructions));
@@ -173,15 +333,27 @@ int main(int argc, char *argv[])
       listLength(program->symbols));
   fprintf(stderr, " -> Number of labels: %d\n", listLength(program->labels));
 #endif
-  bool ok = writeAssembly(program, outputFn);
+  bool ok;
+  trBegin(TR_OUTPUT);
+  if (elfOutput)
+    ok = writeObject(program, outputFn);
+  else
+    ok = writeAssembly(program, outputFn);
   if (!ok) {
     emitError(nullFileLocation, "could not write output file");
     goto fail;
   }
+  trEnd(TR_OUTPUT, program, NULL);
+  if (timeReportEnabled)
+    trPrint(stderr);
+  if (cache)
+    bcacheStore(cache, outputFn);
 
   res = 0;
 fail:
+  deleteBuildCache(cache);
   deleteProgram(program);
+  deleteProfile(profile);
 #ifndef NDEBUG
   fprintf(stderr, "Finished.\n");
 #endif
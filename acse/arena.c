@@ -0,0 +1,95 @@
+/// @file arena.c
+/// @brief Region and pool allocators implementation
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "errors.h"
+
+#define ARENA_CHUNK_SIZE 0x10000
+#define ARENA_ALIGN 16
+#define POOL_BATCH_SIZE 256
+
+struct t_arenaChunk {
+  t_arenaChunk *next; ///< The next chunk, allocated before this one.
+  size_t size;        ///< Number of bytes in the chunk.
+  size_t used;        ///< Number of bytes already allocated.
+  uint8_t *data;      ///< The bytes of the chunk.
+};
+
+
+void *arenaAlloc(t_arena *arena, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  t_arenaChunk *chunk = arena->chunks;
+  if (!chunk || chunk->size - chunk->used < size) {
+    // Objects larger than a chunk get a chunk of their own.
+    size_t chunkSize = ARENA_CHUNK_SIZE;
+    if (size > chunkSize)
+      chunkSize = size;
+    size_t headSize =
+        (sizeof(t_arenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    chunk = malloc(headSize + chunkSize);
+    if (!chunk)
+      fatalError("out of memory");
+    chunk->data = (uint8_t *)chunk + headSize;
+    chunk->size = chunkSize;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+  }
+  void *res = chunk->data + chunk->used;
+  chunk->used += size;
+  return res;
+}
+
+char *arenaStrdup(t_arena *arena, const char *str)
+{
+  size_t size = strlen(str) + 1;
+  char *res = arenaAlloc(arena, size);
+  memcpy(res, str, size);
+  return res;
+}
+
+void deleteArena(t_arena *arena)
+{
+  t_arenaChunk *chunk, *next;
+  for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+    next = chunk->next;
+    free(chunk);
+  }
+  arena->chunks = NULL;
+}
+
+
+void *poolAlloc(t_pool *pool)
+{
+  if (pool->freeList == NULL) {
+    // Allocate a batch of objects next to each other, with the alignment of
+    // a pointer instead of the larger one of the arena.
+    size_t size = (pool->objSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    uint8_t *batch = arenaAlloc(&pool->arena, size * POOL_BATCH_SIZE);
+    for (int i = 0; i < POOL_BATCH_SIZE - 1; i++)
+      *(void **)(batch + size * i) = batch + size * (i + 1);
+    *(void **)(batch + size * (POOL_BATCH_SIZE - 1)) = NULL;
+    pool->freeList = batch;
+  }
+  void *res = pool->freeList;
+  pool->freeList = *(void **)res;
+  return res;
+}
+
+void poolFree(t_pool *pool, void *obj)
+{
+  if (obj == NULL)
+    return;
+  *(void **)obj = pool->freeList;
+  pool->freeList = obj;
+}
+
+void poolFreeChain(t_pool *pool, void *first, void *last)
+{
+  *(void **)last = pool->freeList;
+  pool->freeList = first;
+}
@@ -0,0 +1,86 @@
+/// @file arena.h
+/// @brief Region and pool allocators
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * @defgroup arena Arenas and Pools
+ * @brief Allocators for the many small objects of the compiler.
+ *
+ * The intermediate representation of a program is made of a very large number
+ * of small objects (instructions, labels, nodes of the lists and of the
+ * control flow graph) which are allocated one by one and mostly freed all
+ * together. Allocating each of them with malloc() costs a call and a header
+ * per object, and freeing them costs a walk of every data structure.
+ *
+ * An arena is a region of memory from which objects of any size are carved
+ * one after the other. They cannot be freed one by one: all the memory of the
+ * arena is released at once by deleteArena().
+ *
+ * A pool hands out objects of a single size, carved from an arena. The freed
+ * objects are kept in a list and reused by the next allocations, so they are
+ * suited to objects created and destroyed continuously, such as list nodes.
+ * @{
+ */
+
+/// Chunk of memory of an arena.
+typedef struct t_arenaChunk t_arenaChunk;
+
+/** Region of memory from which objects are allocated and released all
+ * together. An arena initialized to all zeros is empty. */
+typedef struct {
+  t_arenaChunk *chunks; ///< Chunks allocated, the most recent first.
+} t_arena;
+
+/** Allocator of objects of the same size, which may be freed one by one. */
+typedef struct {
+  size_t objSize; ///< Size of the objects.
+  t_arena arena;  ///< Region where the objects are allocated.
+  void *freeList; ///< Objects freed and not reused yet.
+} t_pool;
+
+/// Initializer of a pool of objects of the given type.
+#define POOL_INITIALIZER(type) {sizeof(type), {NULL}, NULL}
+
+/** Allocates an object from an arena. The memory is not initialized.
+ * @param arena The arena.
+ * @param size  The size of the object.
+ * @returns A pointer to the object, aligned for any type. */
+void *arenaAlloc(t_arena *arena, size_t size);
+
+/** Copies a string to memory allocated from an arena.
+ * @param arena The arena.
+ * @param str   The string to copy.
+ * @returns The copy of the string. */
+char *arenaStrdup(t_arena *arena, const char *str);
+
+/** Releases all the memory of an arena, which becomes empty. The objects
+ * allocated from it so far must not be used anymore.
+ * @param arena The arena. */
+void deleteArena(t_arena *arena);
+
+/** Allocates an object from a pool. The memory is not initialized.
+ * @param pool The pool.
+ * @returns A pointer to the object. */
+void *poolAlloc(t_pool *pool);
+
+/** Returns an object to the pool it was allocated from, to be reused.
+ * @param pool The pool.
+ * @param obj  The object to free. If NULL, the function does nothing. */
+void poolFree(t_pool *pool, void *obj);
+
+/** Returns to a pool a chain of objects, each one pointing to the next one
+ * through the pointer at its beginning, in constant time.
+ * @param pool  The pool.
+ * @param first The first object of the chain.
+ * @param last  The last object of the chain. */
+void poolFreeChain(t_pool *pool, void *first, void *last);
+
+/**
+ * @}
+ */
+
+#endif
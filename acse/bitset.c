@@ -0,0 +1,86 @@
+/// @file bitset.c
+/// @brief Implementation of dense sets of small non-negative integers
+
+#include <stdlib.h>
+#include <string.h>
+#include "bitset.h"
+#include "errors.h"
+
+
+t_bitset *newBitset(int capacity)
+{
+  t_bitset *result = malloc(sizeof(t_bitset));
+  if (result == NULL)
+    fatalError("out of memory");
+  result->numWords = (capacity + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+  // One more word than needed, so that the array of an empty set is not
+  // a zero-sized allocation.
+  result->words = calloc((size_t)result->numWords + 1, sizeof(t_bitsetWord));
+  if (result->words == NULL)
+    fatalError("out of memory");
+  return result;
+}
+
+void deleteBitset(t_bitset *set)
+{
+  if (set == NULL)
+    return;
+  free(set->words);
+  free(set);
+}
+
+
+void bitsetClear(t_bitset *set)
+{
+  memset(set->words, 0, sizeof(t_bitsetWord) * (size_t)set->numWords);
+}
+
+void bitsetCopy(t_bitset *dest, const t_bitset *src)
+{
+  memcpy(dest->words, src->words,
+      sizeof(t_bitsetWord) * (size_t)dest->numWords);
+}
+
+bool bitsetUnion(t_bitset *dest, const t_bitset *src)
+{
+  // Accumulate the changed bits instead of branching on each word, so that
+  // the compiler can vectorize the loop.
+  t_bitsetWord changed = 0;
+  for (int i = 0; i < dest->numWords; i++) {
+    t_bitsetWord old = dest->words[i];
+    t_bitsetWord new = old | src->words[i];
+    changed |= old ^ new;
+    dest->words[i] = new;
+  }
+  return changed != 0;
+}
+
+bool bitsetUnionDifference(t_bitset *dest, const t_bitset *a,
+    const t_bitset *b, const t_bitset *c)
+{
+  t_bitsetWord changed = 0;
+  for (int i = 0; i < dest->numWords; i++) {
+    t_bitsetWord new = a->words[i] | (b->words[i] & ~c->words[i]);
+    changed |= dest->words[i] ^ new;
+    dest->words[i] = new;
+  }
+  return changed != 0;
+}
+
+int bitsetNext(const t_bitset *set, int from)
+{
+  if (from < 0)
+    from = 0;
+  int i = from / BITSET_WORD_BITS;
+  if (i >= set->numWords)
+    return -1;
+  // Discard the bits before the starting point in the first word.
+  t_bitsetWord word = set->words[i] &
+      (~(t_bitsetWord)0 << (from % BITSET_WORD_BITS));
+  while (word == 0) {
+    if (++i >= set->numWords)
+      return -1;
+    word = set->words[i];
+  }
+  return i * BITSET_WORD_BITS + __builtin_ctzll(word);
+}
@@ -0,0 +1,115 @@
+/// @file bitset.h
+/// @brief Dense sets of small non-negative integers
+
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @defgroup bitset Bit Sets
+ * @brief Library for fixed-size sets of integers represented as bit vectors.
+ *
+ * A bit set holds a subset of the integers from zero to the capacity given
+ * when it is created. Each element is represented by one bit, so all the set
+ * operations work on a whole machine word at a time, which makes them far
+ * faster than the equivalent operations on sets represented as lists when the
+ * elements are dense, as the identifiers of temporary registers are.
+ *
+ * All the sets passed to the same binary operation must have been created
+ * with the same capacity.
+ * @{
+ */
+
+/// Type of the words in which the bits of a set are stored.
+typedef uint64_t t_bitsetWord;
+
+/// Number of bits in a word of a bit set.
+#define BITSET_WORD_BITS 64
+
+/// A set of integers from zero to a fixed capacity.
+typedef struct {
+  int numWords;         ///< Number of words in the `words' array.
+  t_bitsetWord *words;  ///< The bits of the set, in ascending order.
+} t_bitset;
+
+
+/** Creates a new empty bit set.
+ * @param capacity The number of elements which can be in the set. All the
+ *                 elements must be less than the capacity.
+ * @returns The new set. */
+t_bitset *newBitset(int capacity);
+
+/** Frees a bit set.
+ * @param set The set to be freed. */
+void deleteBitset(t_bitset *set);
+
+/** Adds an element to a set.
+ * @param set     The set.
+ * @param element The element to be added. */
+static inline void bitsetAdd(t_bitset *set, int element)
+{
+  set->words[element / BITSET_WORD_BITS] |= (t_bitsetWord)1
+      << (element % BITSET_WORD_BITS);
+}
+
+/** Removes an element from a set.
+ * @param set     The set.
+ * @param element The element to be removed. */
+static inline void bitsetRemove(t_bitset *set, int element)
+{
+  set->words[element / BITSET_WORD_BITS] &= ~((t_bitsetWord)1
+      << (element % BITSET_WORD_BITS));
+}
+
+/** Tests whether an element belongs to a set.
+ * @param set     The set.
+ * @param element The element to be found.
+ * @returns true if the element is in the set. */
+static inline bool bitsetContains(const t_bitset *set, int element)
+{
+  return (set->words[element / BITSET_WORD_BITS] >>
+             (element % BITSET_WORD_BITS)) & 1;
+}
+
+/** Removes all the elements from a set.
+ * @param set The set. */
+void bitsetClear(t_bitset *set);
+
+/** Replaces the contents of a set with the contents of another.
+ * @param dest The set to be modified.
+ * @param src  The set to be copied. */
+void bitsetCopy(t_bitset *dest, const t_bitset *src);
+
+/** Adds all the elements of a set to another set.
+ * @param dest The set to be modified.
+ * @param src  The set whose elements are to be added.
+ * @returns true if `dest' was modified. */
+bool bitsetUnion(t_bitset *dest, const t_bitset *src);
+
+/** Computes dest = a U (b \ c).
+ * @param dest The set which receives the result. It can be the same object
+ *             as one of the other arguments.
+ * @param a    The first set.
+ * @param b    The set whose elements are added if they are not in c.
+ * @param c    The set of elements removed from b.
+ * @returns true if `dest' was modified. */
+bool bitsetUnionDifference(t_bitset *dest, const t_bitset *a,
+    const t_bitset *b, const t_bitset *c);
+
+/** Finds the smallest element of a set which is greater than or equal to a
+ * given integer. It can be used to iterate through all the elements of a set:
+ *
+ *     for (int i = bitsetNext(set, 0); i >= 0; i = bitsetNext(set, i + 1))
+ *
+ * @param set  The set.
+ * @param from The integer where the search starts.
+ * @returns The element found, or -1 if there is none. */
+int bitsetNext(const t_bitset *set, int from);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,2096 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison implementation for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* C LALR(1) parser skeleton written by Richard Stallman, by
+   simplifying the original so-called "semantic" parser.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+/* All symbols defined below should begin with yy or YY, to avoid
+   infringing on user name space.  This should be done even for local
+   variables, as they might otherwise be expanded by user macros.
+   There are some unavoidable exceptions within include files to
+   define necessary library symbols; they are noted "INFRINGES ON
+   USER NAME SPACE" below.  */
+
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
+
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
+
+/* Skeleton name.  */
+#define YYSKELETON_NAME "yacc.c"
+
+/* Pure parsers.  */
+#define YYPURE 0
+
+/* Push parsers.  */
+#define YYPUSH 0
+
+/* Pull parsers.  */
+#define YYPULL 1
+
+
+
+
+/* First part of user prologue.  */
+#line 5 "parser.y"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "errors.h"
+#include "list.h"
+#include "codegen.h"
+#include "scanner.h"
+#include "parser.h"
+
+/*
+ * Global variables
+ */
+
+// The program currently being compiled.
+static t_program *program;
+
+void yyerror(const char *msg)
+{
+  emitError(curFileLoc, "%s", msg);
+}
+
+/*
+ * Utility functions for the code generation of expressions
+ */
+
+// Returns an expression whose value is in the given register.
+static t_expValue registerExp(t_regID reg)
+{
+  t_expValue result = {0};
+  result.kind = EXP_REGISTER;
+  result.reg = reg;
+  return result;
+}
+
+// Returns an expression which compares the values of two registers.
+static t_expValue comparisonExp(t_compareOp op, t_regID rSrc1, t_regID rSrc2)
+{
+  t_expValue result = {0};
+  result.kind = EXP_COMPARISON;
+  result.compareOp = op;
+  result.rSrc1 = rSrc1;
+  result.rSrc2 = rSrc2;
+  return result;
+}
+
+// Returns a condition which jumps to the given labels when it is false.
+static t_expValue conditionExp(t_listNode *lFalse)
+{
+  t_expValue result = {0};
+  result.kind = EXP_CONDITION;
+  result.lFalse = lFalse;
+  return result;
+}
+
+// Assigns all the labels in a list to the next instruction, and frees the
+// list.
+static void assignLabels(t_listNode *labels)
+{
+  for (t_listNode *curNode = labels; curNode != NULL; curNode = curNode->next)
+    assignLabel(program, (t_label *)curNode->data);
+  deleteList(labels);
+}
+
+// Generates a branch to a label which is taken if the comparison with the
+// given operator between two registers is true.
+static void genComparisonBranch(
+    t_compareOp op, t_regID rSrc1, t_regID rSrc2, t_label *label)
+{
+  switch (op) {
+    case CMP_EQ:
+      genBEQ(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_NE:
+      genBNE(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_LT:
+      genBLT(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_GE:
+      genBGE(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_GT:
+      genBGT(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_LE:
+      genBLE(program, rSrc1, rSrc2, label);
+      break;
+  }
+}
+
+// Returns the register which contains the value of an expression, generating
+// the code which computes it if needed.
+static t_regID genExpToRegister(t_expValue exp)
+{
+  if (exp.kind == EXP_REGISTER)
+    return exp.reg;
+
+  t_regID rDest = getNewRegister(program);
+  if (exp.kind == EXP_COMPARISON) {
+    switch (exp.compareOp) {
+      case CMP_EQ:
+        genSEQ(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_NE:
+        genSNE(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_LT:
+        genSLT(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_GE:
+        genSGE(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_GT:
+        genSGT(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_LE:
+        genSLE(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+    }
+    return rDest;
+  }
+
+  // The code of a condition falls through when the condition is true.
+  t_label *lExit = createLabel(program);
+  genLI(program, rDest, 1);
+  genJ(program, lExit);
+  assignLabels(exp.lFalse);
+  genLI(program, rDest, 0);
+  assignLabel(program, lExit);
+  return rDest;
+}
+
+// Generates the code which jumps away when the value of an expression is
+// zero, and falls through otherwise. Returns the list of the labels which
+// must be assigned to the destination of the jump.
+static t_listNode *genJumpIfFalse(t_expValue exp)
+{
+  if (exp.kind == EXP_CONDITION)
+    return exp.lFalse;
+
+  t_label *lFalse = createLabel(program);
+  if (exp.kind == EXP_REGISTER)
+    genBEQ(program, exp.reg, REG_0, lFalse);
+  else
+    genComparisonBranch(
+        (t_compareOp)(exp.compareOp ^ 1), exp.rSrc1, exp.rSrc2, lFalse);
+  return listInsert(NULL, lFalse, -1);
+}
+
+// Generates the code which jumps to a label when the value of an expression
+// is not zero, and falls through otherwise.
+static void genJumpIfTrue(t_expValue exp, t_label *lTrue)
+{
+  if (exp.kind == EXP_REGISTER) {
+    genBNE(program, exp.reg, REG_0, lTrue);
+  } else if (exp.kind == EXP_COMPARISON) {
+    genComparisonBranch(exp.compareOp, exp.rSrc1, exp.rSrc2, lTrue);
+  } else {
+    genJ(program, lTrue);
+    assignLabels(exp.lFalse);
+  }
+}
+
+
+#line 237 "build/parser.tab.c"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+#include "parser.tab.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_EOF_TOK = 3,                    /* EOF_TOK  */
+  YYSYMBOL_LPAR = 4,                       /* LPAR  */
+  YYSYMBOL_RPAR = 5,                       /* RPAR  */
+  YYSYMBOL_LSQUARE = 6,                    /* LSQUARE  */
+  YYSYMBOL_RSQUARE = 7,                    /* RSQUARE  */
+  YYSYMBOL_LBRACE = 8,                     /* LBRACE  */
+  YYSYMBOL_RBRACE = 9,                     /* RBRACE  */
+  YYSYMBOL_COMMA = 10,                     /* COMMA  */
+  YYSYMBOL_SEMI = 11,                      /* SEMI  */
+  YYSYMBOL_PLUS = 12,                      /* PLUS  */
+  YYSYMBOL_MINUS = 13,                     /* MINUS  */
+  YYSYMBOL_MUL_OP = 14,                    /* MUL_OP  */
+  YYSYMBOL_DIV_OP = 15,                    /* DIV_OP  */
+  YYSYMBOL_MOD_OP = 16,                    /* MOD_OP  */
+  YYSYMBOL_AND_OP = 17,                    /* AND_OP  */
+  YYSYMBOL_XOR_OP = 18,                    /* XOR_OP  */
+  YYSYMBOL_OR_OP = 19,                     /* OR_OP  */
+  YYSYMBOL_NOT_OP = 20,                    /* NOT_OP  */
+  YYSYMBOL_ASSIGN = 21,                    /* ASSIGN  */
+  YYSYMBOL_LT = 22,                        /* LT  */
+  YYSYMBOL_GT = 23,                        /* GT  */
+  YYSYMBOL_SHL_OP = 24,                    /* SHL_OP  */
+  YYSYMBOL_SHR_OP = 25,                    /* SHR_OP  */
+  YYSYMBOL_EQ = 26,                        /* EQ  */
+  YYSYMBOL_NOTEQ = 27,                     /* NOTEQ  */
+  YYSYMBOL_LTEQ = 28,                      /* LTEQ  */
+  YYSYMBOL_GTEQ = 29,                      /* GTEQ  */
+  YYSYMBOL_ANDAND = 30,                    /* ANDAND  */
+  YYSYMBOL_OROR = 31,                      /* OROR  */
+  YYSYMBOL_TYPE = 32,                      /* TYPE  */
+  YYSYMBOL_RETURN = 33,                    /* RETURN  */
+  YYSYMBOL_READ = 34,                      /* READ  */
+  YYSYMBOL_WRITE = 35,                     /* WRITE  */
+  YYSYMBOL_ELSE = 36,                      /* ELSE  */
+  YYSYMBOL_IF = 37,                        /* IF  */
+  YYSYMBOL_WHILE = 38,                     /* WHILE  */
+  YYSYMBOL_DO = 39,                        /* DO  */
+  YYSYMBOL_IDENTIFIER = 40,                /* IDENTIFIER  */
+  YYSYMBOL_NUMBER = 41,                    /* NUMBER  */
+  YYSYMBOL_YYACCEPT = 42,                  /* $accept  */
+  YYSYMBOL_program = 43,                   /* program  */
+  YYSYMBOL_var_declarations = 44,          /* var_declarations  */
+  YYSYMBOL_var_declaration = 45,           /* var_declaration  */
+  YYSYMBOL_declarator_list = 46,           /* declarator_list  */
+  YYSYMBOL_declarator = 47,                /* declarator  */
+  YYSYMBOL_code_block = 48,                /* code_block  */
+  YYSYMBOL_statements = 49,                /* statements  */
+  YYSYMBOL_statement = 50,                 /* statement  */
+  YYSYMBOL_assign_statement = 51,          /* assign_statement  */
+  YYSYMBOL_52_1 = 52,                      /* @1  */
+  YYSYMBOL_if_statement = 53,              /* if_statement  */
+  YYSYMBOL_54_2 = 54,                      /* $@2  */
+  YYSYMBOL_55_3 = 55,                      /* $@3  */
+  YYSYMBOL_else_part = 56,                 /* else_part  */
+  YYSYMBOL_while_statement = 57,           /* while_statement  */
+  YYSYMBOL_58_4 = 58,                      /* $@4  */
+  YYSYMBOL_59_5 = 59,                      /* $@5  */
+  YYSYMBOL_do_while_statement = 60,        /* do_while_statement  */
+  YYSYMBOL_61_6 = 61,                      /* $@6  */
+  YYSYMBOL_return_statement = 62,          /* return_statement  */
+  YYSYMBOL_read_statement = 63,            /* read_statement  */
+  YYSYMBOL_write_statement = 64,           /* write_statement  */
+  YYSYMBOL_exp = 65,                       /* exp  */
+  YYSYMBOL_66_7 = 66,                      /* @7  */
+  YYSYMBOL_67_8 = 67,                      /* @8  */
+  YYSYMBOL_left_operand = 68,              /* left_operand  */
+  YYSYMBOL_var_id = 69                     /* var_id  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
+
+
+
+
+#ifdef short
+# undef short
+#endif
+
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
+#endif
+
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
+typedef signed char yytype_int8;
+#endif
+
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
+#else
+typedef short yytype_uint8;
+#endif
+
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
+#else
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
+#endif
+
+#ifndef YYSIZE_T
+# ifdef __SIZE_TYPE__
+#  define YYSIZE_T __SIZE_TYPE__
+# elif defined size_t
+#  define YYSIZE_T size_t
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYSIZE_T size_t
+# else
+#  define YYSIZE_T unsigned
+# endif
+#endif
+
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_uint8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
+
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(Msgid) Msgid
+# endif
+#endif
+
+
+#ifndef YY_ATTRIBUTE_PURE
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
+#endif
+
+#ifndef YY_ATTRIBUTE_UNUSED
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
+#endif
+
+/* Suppress unused-variable warnings by "using" E.  */
+#if ! defined lint || defined __GNUC__
+# define YY_USE(E) ((void) (E))
+#else
+# define YY_USE(E) /* empty */
+#endif
+
+/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
+#else
+# define YY_INITIAL_VALUE(Value) Value
+#endif
+#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
+#endif
+#ifndef YY_INITIAL_VALUE
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
+#endif
+
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
+
+#if !defined yyoverflow
+
+/* The parser invokes alloca or malloc; define the necessary symbols.  */
+
+# ifdef YYSTACK_USE_ALLOCA
+#  if YYSTACK_USE_ALLOCA
+#   ifdef __GNUC__
+#    define YYSTACK_ALLOC __builtin_alloca
+#   elif defined __BUILTIN_VA_ARG_INCR
+#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
+#   elif defined _AIX
+#    define YYSTACK_ALLOC __alloca
+#   elif defined _MSC_VER
+#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
+#    define alloca _alloca
+#   else
+#    define YYSTACK_ALLOC alloca
+#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
+#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
+#     ifndef EXIT_SUCCESS
+#      define EXIT_SUCCESS 0
+#     endif
+#    endif
+#   endif
+#  endif
+# endif
+
+# ifdef YYSTACK_ALLOC
+   /* Pacify GCC's 'empty if-body' warning.  */
+#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+    /* The OS might guarantee only one guard page at the bottom of the stack,
+       and a page size can be as small as 4096 bytes.  So we cannot safely
+       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
+       to allow for a few compiler-allocated temporary stack slots.  */
+#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
+#  endif
+# else
+#  define YYSTACK_ALLOC YYMALLOC
+#  define YYSTACK_FREE YYFREE
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
+#  endif
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
+       && ! ((defined YYMALLOC || defined malloc) \
+             && (defined YYFREE || defined free)))
+#   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
+#   endif
+#  endif
+#  ifndef YYMALLOC
+#   define YYMALLOC malloc
+#   if ! defined malloc && ! defined EXIT_SUCCESS
+void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+#  ifndef YYFREE
+#   define YYFREE free
+#   if ! defined free && ! defined EXIT_SUCCESS
+void free (void *); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+# endif
+#endif /* !defined yyoverflow */
+
+#if (! defined yyoverflow \
+     && (! defined __cplusplus \
+         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+
+/* A type that is properly aligned for any stack member.  */
+union yyalloc
+{
+  yy_state_t yyss_alloc;
+  YYSTYPE yyvs_alloc;
+};
+
+/* The size of the maximum gap between one aligned stack and the next.  */
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
+
+/* The size of an array large to enough to hold all stacks, each with
+   N elements.  */
+# define YYSTACK_BYTES(N) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
+      + YYSTACK_GAP_MAXIMUM)
+
+# define YYCOPY_NEEDED 1
+
+/* Relocate STACK from its old location to the new one.  The
+   local variables YYSIZE and YYSTACKSIZE give the old and new number of
+   elements in the stack, and YYPTR gives the new location of the
+   stack.  Advance YYPTR to a properly aligned location for the next
+   stack.  */
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
+    while (0)
+
+#endif
+
+#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
+/* Copy COUNT objects from SRC to DST.  The source and destination do
+   not overlap.  */
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
+#endif /* !YYCOPY_NEEDED */
+
+/* YYFINAL -- State number of the termination state.  */
+#define YYFINAL  3
+/* YYLAST -- Last index in YYTABLE.  */
+#define YYLAST   416
+
+/* YYNTOKENS -- Number of terminals.  */
+#define YYNTOKENS  42
+/* YYNNTS -- Number of nonterminals.  */
+#define YYNNTS  28
+/* YYNRULES -- Number of rules.  */
+#define YYNRULES  64
+/* YYNSTATES -- Number of states.  */
+#define YYNSTATES  143
+
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   296
+
+
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
+
+/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
+{
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
+       5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    27,    28,    29,    30,    31,    32,    33,    34,
+      35,    36,    37,    38,    39,    40,    41
+};
+
+#if YYDEBUG
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
+{
+       0,   270,   270,   283,   284,   290,   294,   295,   301,   305,
+     313,   317,   318,   322,   323,   324,   325,   326,   327,   328,
+     329,   335,   340,   339,   356,   361,   355,   378,   379,   387,
+     393,   386,   411,   410,   427,   436,   447,   464,   470,   474,
+     479,   483,   489,   495,   501,   507,   513,   519,   525,   531,
+     537,   543,   549,   553,   557,   561,   565,   569,   573,   590,
+     589,   601,   600,   618,   625
+};
+#endif
+
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
+/* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+   First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
+static const char *const yytname[] =
+{
+  "\"end of file\"", "error", "\"invalid token\"", "EOF_TOK", "LPAR",
+  "RPAR", "LSQUARE", "RSQUARE", "LBRACE", "RBRACE", "COMMA", "SEMI",
+  "PLUS", "MINUS", "MUL_OP", "DIV_OP", "MOD_OP", "AND_OP", "XOR_OP",
+  "OR_OP", "NOT_OP", "ASSIGN", "LT", "GT", "SHL_OP", "SHR_OP", "EQ",
+  "NOTEQ", "LTEQ", "GTEQ", "ANDAND", "OROR", "TYPE", "RETURN", "READ",
+  "WRITE", "ELSE", "IF", "WHILE", "DO", "IDENTIFIER", "NUMBER", "$accept",
+  "program", "var_declarations", "var_declaration", "declarator_list",
+  "declarator", "code_block", "statements", "statement",
+  "assign_statement", "@1", "if_statement", "$@2", "$@3", "else_part",
+  "while_statement", "$@4", "$@5", "do_while_statement", "$@6",
+  "return_statement", "read_statement", "write_statement", "exp", "@7",
+  "@8", "left_operand", "var_id", YY_NULLPTR
+};
+
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
+{
+  return yytname[yysymbol];
+}
+#endif
+
+#define YYPACT_NINF (-106)
+
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
+
+#define YYTABLE_NINF (-1)
+
+#define yytable_value_is_error(Yyn) \
+  0
+
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
+static const yytype_int16 yypact[] =
+{
+    -106,     5,   -26,  -106,   -23,  -106,    -1,    12,     1,  -106,
+    -106,  -106,  -106,    17,    21,    23,  -106,  -106,  -106,  -106,
+      29,  -106,  -106,    30,    31,    34,    43,    -2,    14,   -23,
+    -106,    35,     3,     3,    72,    71,  -106,  -106,  -106,  -106,
+    -106,     3,     3,    70,  -106,    84,     3,     3,     3,  -106,
+      69,   110,    96,     3,  -106,    52,   202,   247,  -106,  -106,
+     123,    15,  -106,  -106,  -106,  -106,  -106,  -106,  -106,  -106,
+    -106,  -106,  -106,  -106,  -106,  -106,  -106,  -106,  -106,  -106,
+    -106,  -106,     3,  -106,   150,    13,   113,  -106,  -106,     3,
+       3,     3,     3,     3,     3,     3,     3,     3,     3,     3,
+       3,     3,     3,     3,     3,     3,     3,   227,    71,  -106,
+    -106,     3,   108,    15,    15,  -106,  -106,  -106,   340,   322,
+     304,   391,   391,    91,    91,   358,   358,   391,   391,   286,
+     267,  -106,  -106,    71,   177,     3,    94,  -106,  -106,   247,
+      71,  -106,  -106
+};
+
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
+{
+       4,     0,    12,     1,     0,     3,     0,     8,     0,     7,
+       2,    20,    34,     0,     0,     0,    29,    32,    64,    11,
+       0,    14,    15,     0,     0,     0,     0,     0,     0,     0,
+       5,     0,     0,     0,     0,     0,    13,    16,    17,    18,
+      19,     0,     0,     0,     6,     0,     0,     0,     0,    37,
+       0,    38,     0,     0,    12,     0,     0,    21,     9,    35,
+       0,    41,    58,    36,    63,    63,    63,    63,    63,    63,
+      63,    63,    63,    63,    63,    63,    63,    63,    63,    63,
+      59,    61,     0,    24,     0,     0,     0,    22,    40,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,    30,
+      10,     0,     0,    42,    43,    44,    45,    46,    47,    48,
+      49,    52,    53,    50,    51,    54,    55,    56,    57,    60,
+      62,    39,    25,     0,     0,     0,    28,    31,    33,    23,
+       0,    26,    27
+};
+
+/* YYPGOTO[NTERM-NUM].  */
+static const yytype_int16 yypgoto[] =
+{
+    -106,  -106,  -106,  -106,  -106,   102,  -105,    78,  -106,  -106,
+    -106,  -106,  -106,  -106,  -106,  -106,  -106,  -106,  -106,  -106,
+    -106,  -106,  -106,   -33,  -106,  -106,   323,    -5
+};
+
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_uint8 yydefgoto[] =
+{
+       0,     1,     2,     5,     8,     9,    55,     6,    19,    20,
+     112,    21,   108,   136,   141,    22,    34,   133,    23,    35,
+      24,    25,    26,    50,   105,   106,    89,    51
+};
+
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_uint8 yytable[] =
+{
+      52,    27,    10,   132,    41,     3,     4,    46,    56,    57,
+      11,    29,    30,    60,    61,    62,    47,     7,    28,    42,
+      84,    31,   110,    48,    11,    32,    45,    33,   137,    66,
+      67,    68,    12,    13,    14,   142,    15,    16,    17,    18,
+      36,    37,    38,    18,    49,    39,    12,    13,    14,   107,
+      15,    16,    17,    18,    40,    43,   113,   114,   115,   116,
+     117,   118,   119,   120,   121,   122,   123,   124,   125,   126,
+     127,   128,   129,   130,    63,    18,    53,    58,   134,    54,
+      27,    64,    65,    66,    67,    68,    69,    70,    71,    59,
+      86,    72,    73,    74,    75,    76,    77,    78,    79,    80,
+      81,    83,   139,    64,    65,    66,    67,    68,    64,    65,
+      66,    67,    68,    69,    70,    71,    82,   111,    72,    73,
+      74,    75,    76,    77,    78,    79,    80,    81,    88,   135,
+     140,    44,    85,     0,     0,    64,    65,    66,    67,    68,
+      69,    70,    71,     0,     0,    72,    73,    74,    75,    76,
+      77,    78,    79,    80,    81,   109,     0,     0,     0,     0,
+       0,     0,    64,    65,    66,    67,    68,    69,    70,    71,
+       0,     0,    72,    73,    74,    75,    76,    77,    78,    79,
+      80,    81,   138,     0,     0,     0,     0,     0,     0,    64,
+      65,    66,    67,    68,    69,    70,    71,     0,     0,    72,
+      73,    74,    75,    76,    77,    78,    79,    80,    81,    87,
+       0,     0,     0,     0,    64,    65,    66,    67,    68,    69,
+      70,    71,     0,     0,    72,    73,    74,    75,    76,    77,
+      78,    79,    80,    81,   131,     0,     0,     0,     0,    64,
+      65,    66,    67,    68,    69,    70,    71,     0,     0,    72,
+      73,    74,    75,    76,    77,    78,    79,    80,    81,    64,
+      65,    66,    67,    68,    69,    70,    71,     0,     0,    72,
+      73,    74,    75,    76,    77,    78,    79,    80,    81,    64,
+      65,    66,    67,    68,    69,    70,    71,     0,     0,    72,
+      73,    74,    75,    76,    77,    78,    79,    80,    64,    65,
+      66,    67,    68,    69,    70,    71,     0,     0,    72,    73,
+      74,    75,    76,    77,    78,    79,    64,    65,    66,    67,
+      68,    69,    70,     0,     0,     0,    72,    73,    74,    75,
+      76,    77,    78,    79,    64,    65,    66,    67,    68,    69,
+       0,     0,     0,     0,    72,    73,    74,    75,    76,    77,
+      78,    79,    64,    65,    66,    67,    68,     0,     0,     0,
+       0,     0,    72,    73,    74,    75,    76,    77,    78,    79,
+      64,    65,    66,    67,    68,     0,     0,     0,     0,     0,
+      72,    73,    74,    75,     0,     0,    78,    79,    90,    91,
+      92,    93,    94,    95,    96,    97,    98,    99,   100,   101,
+     102,   103,   104,    64,    65,    66,    67,    68,     0,     0,
+       0,     0,     0,     0,     0,    74,    75
+};
+
+static const yytype_int16 yycheck[] =
+{
+      33,     6,     3,   108,     6,     0,    32,     4,    41,    42,
+      11,    10,    11,    46,    47,    48,    13,    40,     6,    21,
+      53,     4,     9,    20,    11,     4,    31,     4,   133,    14,
+      15,    16,    33,    34,    35,   140,    37,    38,    39,    40,
+      11,    11,    11,    40,    41,    11,    33,    34,    35,    82,
+      37,    38,    39,    40,    11,    41,    89,    90,    91,    92,
+      93,    94,    95,    96,    97,    98,    99,   100,   101,   102,
+     103,   104,   105,   106,     5,    40,     4,     7,   111,     8,
+      85,    12,    13,    14,    15,    16,    17,    18,    19,     5,
+      38,    22,    23,    24,    25,    26,    27,    28,    29,    30,
+      31,     5,   135,    12,    13,    14,    15,    16,    12,    13,
+      14,    15,    16,    17,    18,    19,     6,     4,    22,    23,
+      24,    25,    26,    27,    28,    29,    30,    31,     5,    21,
+      36,    29,    54,    -1,    -1,    12,    13,    14,    15,    16,
+      17,    18,    19,    -1,    -1,    22,    23,    24,    25,    26,
+      27,    28,    29,    30,    31,     5,    -1,    -1,    -1,    -1,
+      -1,    -1,    12,    13,    14,    15,    16,    17,    18,    19,
+      -1,    -1,    22,    23,    24,    25,    26,    27,    28,    29,
+      30,    31,     5,    -1,    -1,    -1,    -1,    -1,    -1,    12,
+      13,    14,    15,    16,    17,    18,    19,    -1,    -1,    22,
+      23,    24,    25,    26,    27,    28,    29,    30,    31,     7,
+      -1,    -1,    -1,    -1,    12,    13,    14,    15,    16,    17,
+      18,    19,    -1,    -1,    22,    23,    24,    25,    26,    27,
+      28,    29,    30,    31,     7,    -1,    -1,    -1,    -1,    12,
+      13,    14,    15,    16,    17,    18,    19,    -1,    -1,    22,
+      23,    24,    25,    26,    27,    28,    29,    30,    31,    12,
+      13,    14,    15,    16,    17,    18,    19,    -1,    -1,    22,
+      23,    24,    25,    26,    27,    28,    29,    30,    31,    12,
+      13,    14,    15,    16,    17,    18,    19,    -1,    -1,    22,
+      23,    24,    25,    26,    27,    28,    29,    30,    12,    13,
+      14,    15,    16,    17,    18,    19,    -1,    -1,    22,    23,
+      24,    25,    26,    27,    28,    29,    12,    13,    14,    15,
+      16,    17,    18,    -1,    -1,    -1,    22,    23,    24,    25,
+      26,    27,    28,    29,    12,    13,    14,    15,    16,    17,
+      -1,    -1,    -1,    -1,    22,    23,    24,    25,    26,    27,
+      28,    29,    12,    13,    14,    15,    16,    -1,    -1,    -1,
+      -1,    -1,    22,    23,    24,    25,    26,    27,    28,    29,
+      12,    13,    14,    15,    16,    -1,    -1,    -1,    -1,    -1,
+      22,    23,    24,    25,    -1,    -1,    28,    29,    65,    66,
+      67,    68,    69,    70,    71,    72,    73,    74,    75,    76,
+      77,    78,    79,    12,    13,    14,    15,    16,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    24,    25
+};
+
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
+{
+       0,    43,    44,     0,    32,    45,    49,    40,    46,    47,
+       3,    11,    33,    34,    35,    37,    38,    39,    40,    50,
+      51,    53,    57,    60,    62,    63,    64,    69,     6,    10,
+      11,     4,     4,     4,    58,    61,    11,    11,    11,    11,
+      11,     6,    21,    41,    47,    69,     4,    13,    20,    41,
+      65,    69,    65,     4,     8,    48,    65,    65,     7,     5,
+      65,    65,    65,     5,    12,    13,    14,    15,    16,    17,
+      18,    19,    22,    23,    24,    25,    26,    27,    28,    29,
+      30,    31,     6,     5,    65,    49,    38,     7,     5,    68,
+      68,    68,    68,    68,    68,    68,    68,    68,    68,    68,
+      68,    68,    68,    68,    68,    66,    67,    65,    54,     5,
+       9,     4,    52,    65,    65,    65,    65,    65,    65,    65,
+      65,    65,    65,    65,    65,    65,    65,    65,    65,    65,
+      65,     7,    48,    59,    65,    21,    55,    48,     5,    65,
+      36,    56,    48
+};
+
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
+{
+       0,    42,    43,    44,    44,    45,    46,    46,    47,    47,
+      48,    49,    49,    50,    50,    50,    50,    50,    50,    50,
+      50,    51,    52,    51,    54,    55,    53,    56,    56,    58,
+      59,    57,    61,    60,    62,    63,    64,    65,    65,    65,
+      65,    65,    65,    65,    65,    65,    65,    65,    65,    65,
+      65,    65,    65,    65,    65,    65,    65,    65,    65,    66,
+      65,    67,    65,    68,    69
+};
+
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
+{
+       0,     2,     3,     2,     0,     3,     3,     1,     1,     4,
+       3,     2,     0,     2,     1,     1,     2,     2,     2,     2,
+       1,     3,     0,     7,     0,     0,     8,     2,     0,     0,
+       0,     7,     0,     7,     1,     4,     4,     1,     1,     4,
+       3,     2,     4,     4,     4,     4,     4,     4,     4,     4,
+       4,     4,     4,     4,     4,     4,     4,     4,     2,     0,
+       4,     0,     4,     0,     1
+};
+
+
+enum { YYENOMEM = -2 };
+
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = YYEMPTY)
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
+
+
+#define YYRECOVERING()  (!!yyerrstatus)
+
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
+
+
+/* Enable debugging if requested.  */
+#if YYDEBUG
+
+# ifndef YYFPRINTF
+#  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYFPRINTF fprintf
+# endif
+
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
+} while (0)
+
+
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
+} while (0)
+
+
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
+
+static void
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+{
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  if (!yyvaluep)
+    return;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
+
+static void
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+{
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
+
+  yy_symbol_value_print (yyo, yykind, yyvaluep);
+  YYFPRINTF (yyo, ")");
+}
+
+/*------------------------------------------------------------------.
+| yy_stack_print -- Print the state stack from its BOTTOM up to its |
+| TOP (included).                                                   |
+`------------------------------------------------------------------*/
+
+static void
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
+{
+  YYFPRINTF (stderr, "Stack now");
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
+  YYFPRINTF (stderr, "\n");
+}
+
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
+} while (0)
+
+
+/*------------------------------------------------.
+| Report that the YYRULE is going to be reduced.  |
+`------------------------------------------------*/
+
+static void
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule)
+{
+  int yylno = yyrline[yyrule];
+  int yynrhs = yyr2[yyrule];
+  int yyi;
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
+  /* The symbols being reduced.  */
+  for (yyi = 0; yyi < yynrhs; yyi++)
+    {
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)]);
+      YYFPRINTF (stderr, "\n");
+    }
+}
+
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule); \
+} while (0)
+
+/* Nonzero means print parse trace.  It is left uninitialized so that
+   multiple parsers can coexist.  */
+int yydebug;
+#else /* !YYDEBUG */
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
+# define YY_STACK_PRINT(Bottom, Top)
+# define YY_REDUCE_PRINT(Rule)
+#endif /* !YYDEBUG */
+
+
+/* YYINITDEPTH -- initial size of the parser's stacks.  */
+#ifndef YYINITDEPTH
+# define YYINITDEPTH 200
+#endif
+
+/* YYMAXDEPTH -- maximum size the stacks can grow to (effective only
+   if the built-in stack extension method is used).
+
+   Do not make this value too large; the results are undefined if
+   YYSTACK_ALLOC_MAXIMUM < YYSTACK_BYTES (YYMAXDEPTH)
+   evaluated with infinite-precision integer arithmetic.  */
+
+#ifndef YYMAXDEPTH
+# define YYMAXDEPTH 10000
+#endif
+
+
+
+
+
+
+/*-----------------------------------------------.
+| Release the memory associated to this symbol.  |
+`-----------------------------------------------*/
+
+static void
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep)
+{
+  YY_USE (yyvaluep);
+  if (!yymsg)
+    yymsg = "Deleting";
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/* Lookahead token kind.  */
+int yychar;
+
+/* The semantic value of the lookahead symbol.  */
+YYSTYPE yylval;
+/* Number of syntax errors so far.  */
+int yynerrs;
+
+
+
+
+/*----------.
+| yyparse.  |
+`----------*/
+
+int
+yyparse (void)
+{
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
+
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
+
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
+
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
+
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
+
+  int yyn;
+  /* The return value of yyparse.  */
+  int yyresult;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
+  /* The variables used to return semantic value and location from the
+     action routines.  */
+  YYSTYPE yyval;
+
+
+
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+
+  /* The number of symbols on the RHS of the reduced rule.
+     Keep to zero when no symbol should be popped.  */
+  int yylen = 0;
+
+  YYDPRINTF ((stderr, "Starting parse\n"));
+
+  yychar = YYEMPTY; /* Cause a token to be read.  */
+
+  goto yysetstate;
+
+
+/*------------------------------------------------------------.
+| yynewstate -- push a new state, which is found in yystate.  |
+`------------------------------------------------------------*/
+yynewstate:
+  /* In all cases, when you get here, the value and location stacks
+     have just been pushed.  So pushing a state here evens the stacks.  */
+  yyssp++;
+
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
+
+  if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
+    {
+      /* Get the current used size of the three stacks, in elements.  */
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
+
+# if defined yyoverflow
+      {
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
+      }
+# else /* defined YYSTACK_RELOCATE */
+      /* Extend the stack our own way.  */
+      if (YYMAXDEPTH <= yystacksize)
+        YYNOMEM;
+      yystacksize *= 2;
+      if (YYMAXDEPTH < yystacksize)
+        yystacksize = YYMAXDEPTH;
+
+      {
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
+#  undef YYSTACK_RELOCATE
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
+      }
+# endif
+
+      yyssp = yyss + yysize - 1;
+      yyvsp = yyvs + yysize - 1;
+
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
+
+      if (yyss + yystacksize - 1 <= yyssp)
+        YYABORT;
+    }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
+
+
+  if (yystate == YYFINAL)
+    YYACCEPT;
+
+  goto yybackup;
+
+
+/*-----------.
+| yybackup.  |
+`-----------*/
+yybackup:
+  /* Do appropriate processing given the current state.  Read a
+     lookahead token if we need one and don't already have one.  */
+
+  /* First try to decide what to do without reference to lookahead token.  */
+  yyn = yypact[yystate];
+  if (yypact_value_is_default (yyn))
+    goto yydefault;
+
+  /* Not known => get a lookahead token if don't already have one.  */
+
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
+  if (yychar == YYEMPTY)
+    {
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex ();
+    }
+
+  if (yychar <= YYEOF)
+    {
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
+      YYDPRINTF ((stderr, "Now at end of input.\n"));
+    }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
+  else
+    {
+      yytoken = YYTRANSLATE (yychar);
+      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
+    }
+
+  /* If the proper action on seeing token YYTOKEN is to reduce or to
+     detect an error, take that action.  */
+  yyn += yytoken;
+  if (yyn < 0 || YYLAST < yyn || yycheck[yyn] != yytoken)
+    goto yydefault;
+  yyn = yytable[yyn];
+  if (yyn <= 0)
+    {
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
+      yyn = -yyn;
+      goto yyreduce;
+    }
+
+  /* Count tokens shifted since error; after three, turn off error
+     status.  */
+  if (yyerrstatus)
+    yyerrstatus--;
+
+  /* Shift the lookahead token.  */
+  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
+  yystate = yyn;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
+  goto yynewstate;
+
+
+/*-----------------------------------------------------------.
+| yydefault -- do the default action for the current state.  |
+`-----------------------------------------------------------*/
+yydefault:
+  yyn = yydefact[yystate];
+  if (yyn == 0)
+    goto yyerrlab;
+  goto yyreduce;
+
+
+/*-----------------------------.
+| yyreduce -- do a reduction.  |
+`-----------------------------*/
+yyreduce:
+  /* yyn is the number of a rule to reduce with.  */
+  yylen = yyr2[yyn];
+
+  /* If YYLEN is nonzero, implement the default value of the action:
+     '$$ = $1'.
+
+     Otherwise, the following line sets YYVAL to garbage.
+     This behavior is undocumented and Bison
+     users should not rely upon it.  Assigning to YYVAL
+     unconditionally makes the parser a bit smaller, and it avoids a
+     GCC warning that YYVAL may be used uninitialized.  */
+  yyval = yyvsp[1-yylen];
+
+
+  YY_REDUCE_PRINT (yyn);
+  switch (yyn)
+    {
+  case 2: /* program: var_declarations statements EOF_TOK  */
+#line 271 "parser.y"
+  {
+    // Generate the epilog of the program, that is, a call to the
+    // `exit' syscall.
+    genEpilog(program);
+    // Return from yyparse().
+    YYACCEPT;
+  }
+#line 1445 "build/parser.tab.c"
+    break;
+
+  case 8: /* declarator: IDENTIFIER  */
+#line 302 "parser.y"
+  {
+    createSymbol(program, (yyvsp[0].string), TYPE_INT, 0);
+  }
+#line 1453 "build/parser.tab.c"
+    break;
+
+  case 9: /* declarator: IDENTIFIER LSQUARE NUMBER RSQUARE  */
+#line 306 "parser.y"
+  {
+    createSymbol(program, (yyvsp[-3].string), TYPE_INT_ARRAY, (yyvsp[-1].integer));
+  }
+#line 1461 "build/parser.tab.c"
+    break;
+
+  case 21: /* assign_statement: var_id ASSIGN exp  */
+#line 336 "parser.y"
+  {
+    genStoreRegisterToVariable(program, (yyvsp[-2].var), genExpToRegister((yyvsp[0].exp)));
+  }
+#line 1469 "build/parser.tab.c"
+    break;
+
+  case 22: /* @1: %empty  */
+#line 340 "parser.y"
+  {
+    // The index must be computed before the code of the assigned value.
+    (yyval.reg) = genExpToRegister((yyvsp[-1].exp));
+  }
+#line 1478 "build/parser.tab.c"
+    break;
+
+  case 23: /* assign_statement: var_id LSQUARE exp RSQUARE @1 ASSIGN exp  */
+#line 345 "parser.y"
+  {
+    genStoreRegisterToArrayElement(
+        program, (yyvsp[-6].var), (yyvsp[-2].reg), genExpToRegister((yyvsp[0].exp)));
+  }
+#line 1487 "build/parser.tab.c"
+    break;
+
+  case 24: /* $@2: %empty  */
+#line 356 "parser.y"
+  {
+    // Generate a jump to the else part if the expression is equal to zero.
+    (yyvsp[-3].ifStmt).lElse = genJumpIfFalse((yyvsp[-1].exp));
+  }
+#line 1496 "build/parser.tab.c"
+    break;
+
+  case 25: /* $@3: %empty  */
+#line 361 "parser.y"
+  {
+    // After the `then' part, generate a jump to the end of the statement.
+    (yyvsp[-5].ifStmt).lExit = createLabel(program);
+    genJ(program, (yyvsp[-5].ifStmt).lExit);
+    // Assign the labels which point to the first instruction of the else
+    // part.
+    assignLabels((yyvsp[-5].ifStmt).lElse);
+  }
+#line 1509 "build/parser.tab.c"
+    break;
+
+  case 26: /* if_statement: IF LPAR exp RPAR $@2 code_block $@3 else_part  */
+#line 370 "parser.y"
+  {
+    // Assign the label to the end of the statement.
+    assignLabel(program, (yyvsp[-7].ifStmt).lExit);
+  }
+#line 1518 "build/parser.tab.c"
+    break;
+
+  case 29: /* $@4: %empty  */
+#line 387 "parser.y"
+  {
+    // Assign a label at the beginning of the loop for the back-edge.
+    (yyvsp[0].whileStmt).lLoop = createLabel(program);
+    assignLabel(program, (yyvsp[0].whileStmt).lLoop);
+  }
+#line 1528 "build/parser.tab.c"
+    break;
+
+  case 30: /* $@5: %empty  */
+#line 393 "parser.y"
+  {
+    // Generate a jump out of the loop if the condition is equal to zero.
+    (yyvsp[-4].whileStmt).lExit = genJumpIfFalse((yyvsp[-1].exp));
+  }
+#line 1537 "build/parser.tab.c"
+    break;
+
+  case 31: /* while_statement: WHILE $@4 LPAR exp RPAR $@5 code_block  */
+#line 398 "parser.y"
+  {
+    // Generate a jump back to the beginning of the loop after its body.
+    genJ(program, (yyvsp[-6].whileStmt).lLoop);
+    // Assign the labels to the end of the loop.
+    assignLabels((yyvsp[-6].whileStmt).lExit);
+  }
+#line 1548 "build/parser.tab.c"
+    break;
+
+  case 32: /* $@6: %empty  */
+#line 411 "parser.y"
+  {
+    // Assign a label at the beginning of the loop for the back-edge.
+    (yyvsp[0].label) = createLabel(program);
+    assignLabel(program, (yyvsp[0].label));
+  }
+#line 1558 "build/parser.tab.c"
+    break;
+
+  case 33: /* do_while_statement: DO $@6 code_block WHILE LPAR exp RPAR  */
+#line 417 "parser.y"
+  {
+    // Generate a jump to the beginning of the loop to repeat the code block
+    // if the condition is not equal to zero.
+    genJumpIfTrue((yyvsp[-1].exp), (yyvsp[-6].label));
+  }
+#line 1568 "build/parser.tab.c"
+    break;
+
+  case 34: /* return_statement: RETURN  */
+#line 428 "parser.y"
+  {
+    genExit0Syscall(program);
+  }
+#line 1576 "build/parser.tab.c"
+    break;
+
+  case 35: /* read_statement: READ LPAR var_id RPAR  */
+#line 437 "parser.y"
+  {
+    t_regID rTmp = getNewRegister(program);
+    genReadIntSyscall(program, rTmp);
+    genStoreRegisterToVariable(program, (yyvsp[-1].var), rTmp);
+  }
+#line 1586 "build/parser.tab.c"
+    break;
+
+  case 36: /* write_statement: WRITE LPAR exp RPAR  */
+#line 448 "parser.y"
+  {
+    // Generate a call to the PrintInt syscall.
+    genPrintIntSyscall(program, genExpToRegister((yyvsp[-1].exp)));
+    // Also generate code to print a newline after the integer.
+    t_regID rTmp = getNewRegister(program);
+    genLI(program, rTmp, '\n');
+    genPrintCharSyscall(program, rTmp);
+  }
+#line 1599 "build/parser.tab.c"
+    break;
+
+  case 37: /* exp: NUMBER  */
+#line 465 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genLI(program, rDest, (yyvsp[0].integer));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1609 "build/parser.tab.c"
+    break;
+
+  case 38: /* exp: var_id  */
+#line 471 "parser.y"
+  {
+    (yyval.exp) = registerExp(genLoadVariable(program, (yyvsp[0].var)));
+  }
+#line 1617 "build/parser.tab.c"
+    break;
+
+  case 39: /* exp: var_id LSQUARE exp RSQUARE  */
+#line 475 "parser.y"
+  {
+    (yyval.exp) = registerExp(
+        genLoadArrayElement(program, (yyvsp[-3].var), genExpToRegister((yyvsp[-1].exp))));
+  }
+#line 1626 "build/parser.tab.c"
+    break;
+
+  case 40: /* exp: LPAR exp RPAR  */
+#line 480 "parser.y"
+  {
+    (yyval.exp) = (yyvsp[-1].exp);
+  }
+#line 1634 "build/parser.tab.c"
+    break;
+
+  case 41: /* exp: MINUS exp  */
+#line 484 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genSUB(program, rDest, REG_0, genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1644 "build/parser.tab.c"
+    break;
+
+  case 42: /* exp: exp PLUS left_operand exp  */
+#line 490 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genADD(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1654 "build/parser.tab.c"
+    break;
+
+  case 43: /* exp: exp MINUS left_operand exp  */
+#line 496 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genSUB(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1664 "build/parser.tab.c"
+    break;
+
+  case 44: /* exp: exp MUL_OP left_operand exp  */
+#line 502 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genMUL(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1674 "build/parser.tab.c"
+    break;
+
+  case 45: /* exp: exp DIV_OP left_operand exp  */
+#line 508 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genDIV(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1684 "build/parser.tab.c"
+    break;
+
+  case 46: /* exp: exp MOD_OP left_operand exp  */
+#line 514 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genREM(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1694 "build/parser.tab.c"
+    break;
+
+  case 47: /* exp: exp AND_OP left_operand exp  */
+#line 520 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genAND(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1704 "build/parser.tab.c"
+    break;
+
+  case 48: /* exp: exp XOR_OP left_operand exp  */
+#line 526 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genXOR(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1714 "build/parser.tab.c"
+    break;
+
+  case 49: /* exp: exp OR_OP left_operand exp  */
+#line 532 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genOR(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1724 "build/parser.tab.c"
+    break;
+
+  case 50: /* exp: exp SHL_OP left_operand exp  */
+#line 538 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genSLL(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1734 "build/parser.tab.c"
+    break;
+
+  case 51: /* exp: exp SHR_OP left_operand exp  */
+#line 544 "parser.y"
+  {
+    t_regID rDest = getNewRegister(program);
+    genSRA(program, rDest, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+    (yyval.exp) = registerExp(rDest);
+  }
+#line 1744 "build/parser.tab.c"
+    break;
+
+  case 52: /* exp: exp LT left_operand exp  */
+#line 550 "parser.y"
+  {
+    (yyval.exp) = comparisonExp(CMP_LT, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+  }
+#line 1752 "build/parser.tab.c"
+    break;
+
+  case 53: /* exp: exp GT left_operand exp  */
+#line 554 "parser.y"
+  {
+    (yyval.exp) = comparisonExp(CMP_GT, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+  }
+#line 1760 "build/parser.tab.c"
+    break;
+
+  case 54: /* exp: exp EQ left_operand exp  */
+#line 558 "parser.y"
+  {
+    (yyval.exp) = comparisonExp(CMP_EQ, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+  }
+#line 1768 "build/parser.tab.c"
+    break;
+
+  case 55: /* exp: exp NOTEQ left_operand exp  */
+#line 562 "parser.y"
+  {
+    (yyval.exp) = comparisonExp(CMP_NE, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+  }
+#line 1776 "build/parser.tab.c"
+    break;
+
+  case 56: /* exp: exp LTEQ left_operand exp  */
+#line 566 "parser.y"
+  {
+    (yyval.exp) = comparisonExp(CMP_LE, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+  }
+#line 1784 "build/parser.tab.c"
+    break;
+
+  case 57: /* exp: exp GTEQ left_operand exp  */
+#line 570 "parser.y"
+  {
+    (yyval.exp) = comparisonExp(CMP_GE, (yyvsp[-1].reg), genExpToRegister((yyvsp[0].exp)));
+  }
+#line 1792 "build/parser.tab.c"
+    break;
+
+  case 58: /* exp: NOT_OP exp  */
+#line 574 "parser.y"
+  {
+    if ((yyvsp[0].exp).kind == EXP_REGISTER) {
+      (yyval.exp) = comparisonExp(CMP_EQ, (yyvsp[0].exp).reg, REG_0);
+    } else if ((yyvsp[0].exp).kind == EXP_COMPARISON) {
+      (yyval.exp) = (yyvsp[0].exp);
+      (yyval.exp).compareOp = (t_compareOp)((yyvsp[0].exp).compareOp ^ 1);
+    } else {
+      // Swap the code executed when the condition is true with the code
+      // executed when it is false.
+      t_label *lFalse = createLabel(program);
+      genJ(program, lFalse);
+      assignLabels((yyvsp[0].exp).lFalse);
+      (yyval.exp) = conditionExp(listInsert(NULL, lFalse, -1));
+    }
+  }
+#line 1812 "build/parser.tab.c"
+    break;
+
+  case 59: /* @7: %empty  */
+#line 590 "parser.y"
+  {
+    // Skip the right operand if the left one is false.
+    (yyval.list) = genJumpIfFalse((yyvsp[-1].exp));
+  }
+#line 1821 "build/parser.tab.c"
+    break;
+
+  case 60: /* exp: exp ANDAND @7 exp  */
+#line 595 "parser.y"
+  {
+    t_listNode *lFalse = genJumpIfFalse((yyvsp[0].exp));
+    (yyval.exp) = conditionExp(listAppendList((yyvsp[-1].list), lFalse));
+    deleteList(lFalse);
+  }
+#line 1831 "build/parser.tab.c"
+    break;
+
+  case 61: /* @8: %empty  */
+#line 601 "parser.y"
+  {
+    // Skip the right operand if the left one is true.
+    (yyval.label) = createLabel(program);
+    genJumpIfTrue((yyvsp[-1].exp), (yyval.label));
+  }
+#line 1841 "build/parser.tab.c"
+    break;
+
+  case 62: /* exp: exp OROR @8 exp  */
+#line 607 "parser.y"
+  {
+    (yyval.exp) = conditionExp(genJumpIfFalse((yyvsp[0].exp)));
+    assignLabel(program, (yyvsp[-1].label));
+  }
+#line 1850 "build/parser.tab.c"
+    break;
+
+  case 63: /* left_operand: %empty  */
+#line 618 "parser.y"
+  {
+    // The left operand is the symbol before the operator.
+    (yyval.reg) = genExpToRegister((yyvsp[(-1) - (0)].exp));
+  }
+#line 1859 "build/parser.tab.c"
+    break;
+
+  case 64: /* var_id: IDENTIFIER  */
+#line 626 "parser.y"
+  {
+    t_symbol *var = getSymbol(program, (yyvsp[0].string));
+    if (var == NULL) {
+      yyerror("variable not declared");
+      YYERROR;
+    }
+    (yyval.var) = var;
+    free((yyvsp[0].string));
+  }
+#line 1873 "build/parser.tab.c"
+    break;
+
+
+#line 1877 "build/parser.tab.c"
+
+      default: break;
+    }
+  /* User semantic actions sometimes alter yychar, and that requires
+     that yytoken be updated with the new translation.  We take the
+     approach of translating immediately before every use of yytoken.
+     One alternative is translating here after every semantic action,
+     but that translation would be missed if the semantic action invokes
+     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
+     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
+     incorrect destructor might then be invoked immediately.  In the
+     case of YYERROR or YYBACKUP, subsequent parser actions might lead
+     to an incorrect destructor call or verbose syntax error message
+     before the lookahead is translated.  */
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
+
+  YYPOPSTACK (yylen);
+  yylen = 0;
+
+  *++yyvsp = yyval;
+
+  /* Now 'shift' the result of the reduction.  Determine what state
+     that goes to, based on the state we popped back to and the rule
+     number reduced by.  */
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
+
+  goto yynewstate;
+
+
+/*--------------------------------------.
+| yyerrlab -- here on detecting error.  |
+`--------------------------------------*/
+yyerrlab:
+  /* Make sure we have latest lookahead translation.  See comments at
+     user semantic actions for why this is necessary.  */
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
+  /* If not already recovering from an error, report this error.  */
+  if (!yyerrstatus)
+    {
+      ++yynerrs;
+      yyerror (YY_("syntax error"));
+    }
+
+  if (yyerrstatus == 3)
+    {
+      /* If just tried and failed to reuse lookahead token after an
+         error, discard it.  */
+
+      if (yychar <= YYEOF)
+        {
+          /* Return failure if at end of input.  */
+          if (yychar == YYEOF)
+            YYABORT;
+        }
+      else
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval);
+          yychar = YYEMPTY;
+        }
+    }
+
+  /* Else will try to reuse lookahead token after shifting the error
+     token.  */
+  goto yyerrlab1;
+
+
+/*---------------------------------------------------.
+| yyerrorlab -- error raised explicitly by YYERROR.  |
+`---------------------------------------------------*/
+yyerrorlab:
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
+
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYERROR.  */
+  YYPOPSTACK (yylen);
+  yylen = 0;
+  YY_STACK_PRINT (yyss, yyssp);
+  yystate = *yyssp;
+  goto yyerrlab1;
+
+
+/*-------------------------------------------------------------.
+| yyerrlab1 -- common code for both syntax error and YYERROR.  |
+`-------------------------------------------------------------*/
+yyerrlab1:
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
+
+  /* Pop stack until we find a state that shifts the error token.  */
+  for (;;)
+    {
+      yyn = yypact[yystate];
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
+
+      /* Pop the current state because it cannot handle the error token.  */
+      if (yyssp == yyss)
+        YYABORT;
+
+
+      yydestruct ("Error: popping",
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp);
+      YYPOPSTACK (1);
+      yystate = *yyssp;
+      YY_STACK_PRINT (yyss, yyssp);
+    }
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+
+  /* Shift the error token.  */
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
+
+  yystate = yyn;
+  goto yynewstate;
+
+
+/*-------------------------------------.
+| yyacceptlab -- YYACCEPT comes here.  |
+`-------------------------------------*/
+yyacceptlab:
+  yyresult = 0;
+  goto yyreturnlab;
+
+
+/*-----------------------------------.
+| yyabortlab -- YYABORT comes here.  |
+`-----------------------------------*/
+yyabortlab:
+  yyresult = 1;
+  goto yyreturnlab;
+
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
+yyexhaustedlab:
+  yyerror (YY_("memory exhausted"));
+  yyresult = 2;
+  goto yyreturnlab;
+
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval);
+    }
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYABORT or YYACCEPT.  */
+  YYPOPSTACK (yylen);
+  YY_STACK_PRINT (yyss, yyssp);
+  while (yyssp != yyss)
+    {
+      yydestruct ("Cleanup: popping",
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp);
+      YYPOPSTACK (1);
+    }
+#ifndef yyoverflow
+  if (yyss != yyssa)
+    YYSTACK_FREE (yyss);
+#endif
+
+  return yyresult;
+}
+
+#line 637 "parser.y"
+
+
+t_program *parseProgram(char *fn)
+{
+  FILE *fp = fopen(fn, "r");
+  if (!fp) {
+    emitError(nullFileLocation, "could not open input file");
+    return NULL;
+  }
+
+  program = newProgram();
+  curFileLoc.file = fn;
+  curFileLoc.row = 0;
+  numErrors = 0;
+  yyin = fp;
+  yyparse();
+
+  if (numErrors > 0) {
+    fprintf(stderr, "%d error(s) generated.\n", numErrors);
+    fclose(fp);
+    deleteProgram(program);
+    return NULL;
+  }
+
+  fclose(fp);
+  return program;
+}
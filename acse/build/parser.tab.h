@@ -0,0 +1,131 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison interface for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+#ifndef YY_YY_BUILD_PARSER_TAB_H_INCLUDED
+# define YY_YY_BUILD_PARSER_TAB_H_INCLUDED
+/* Debug traces.  */
+#ifndef YYDEBUG
+# define YYDEBUG 0
+#endif
+#if YYDEBUG
+extern int yydebug;
+#endif
+
+/* Token kinds.  */
+#ifndef YYTOKENTYPE
+# define YYTOKENTYPE
+  enum yytokentype
+  {
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    EOF_TOK = 258,                 /* EOF_TOK  */
+    LPAR = 259,                    /* LPAR  */
+    RPAR = 260,                    /* RPAR  */
+    LSQUARE = 261,                 /* LSQUARE  */
+    RSQUARE = 262,                 /* RSQUARE  */
+    LBRACE = 263,                  /* LBRACE  */
+    RBRACE = 264,                  /* RBRACE  */
+    COMMA = 265,                   /* COMMA  */
+    SEMI = 266,                    /* SEMI  */
+    PLUS = 267,                    /* PLUS  */
+    MINUS = 268,                   /* MINUS  */
+    MUL_OP = 269,                  /* MUL_OP  */
+    DIV_OP = 270,                  /* DIV_OP  */
+    MOD_OP = 271,                  /* MOD_OP  */
+    AND_OP = 272,                  /* AND_OP  */
+    XOR_OP = 273,                  /* XOR_OP  */
+    OR_OP = 274,                   /* OR_OP  */
+    NOT_OP = 275,                  /* NOT_OP  */
+    ASSIGN = 276,                  /* ASSIGN  */
+    LT = 277,                      /* LT  */
+    GT = 278,                      /* GT  */
+    SHL_OP = 279,                  /* SHL_OP  */
+    SHR_OP = 280,                  /* SHR_OP  */
+    EQ = 281,                      /* EQ  */
+    NOTEQ = 282,                   /* NOTEQ  */
+    LTEQ = 283,                    /* LTEQ  */
+    GTEQ = 284,                    /* GTEQ  */
+    ANDAND = 285,                  /* ANDAND  */
+    OROR = 286,                    /* OROR  */
+    TYPE = 287,                    /* TYPE  */
+    RETURN = 288,                  /* RETURN  */
+    READ = 289,                    /* READ  */
+    WRITE = 290,                   /* WRITE  */
+    ELSE = 291,                    /* ELSE  */
+    IF = 292,                      /* IF  */
+    WHILE = 293,                   /* WHILE  */
+    DO = 294,                      /* DO  */
+    IDENTIFIER = 295,              /* IDENTIFIER  */
+    NUMBER = 296                   /* NUMBER  */
+  };
+  typedef enum yytokentype yytoken_kind_t;
+#endif
+
+/* Value type.  */
+#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
+union YYSTYPE
+{
+#line 186 "parser.y"
+
+  int integer;
+  char *string;
+  t_regID reg;
+  t_expValue exp;
+  t_symbol *var;
+  t_listNode *list;
+  t_label *label;
+  t_ifStmt ifStmt;
+  t_whileStmt whileStmt;
+
+#line 117 "build/parser.tab.h"
+
+};
+typedef union YYSTYPE YYSTYPE;
+# define YYSTYPE_IS_TRIVIAL 1
+# define YYSTYPE_IS_DECLARED 1
+#endif
+
+
+extern YYSTYPE yylval;
+
+
+int yyparse (void);
+
+
+#endif /* !YY_YY_BUILD_PARSER_TAB_H_INCLUDED  */
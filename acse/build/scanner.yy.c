@@ -0,0 +1,80 @@
+/* Hand-written stand-in for the flex scanner, only used to build acse in a
+ * sandbox without flex. Not part of the repository. */
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "list.h"
+#include "scanner.h"
+#include "parser.h"
+#include "parser.tab.h"
+
+t_fileLocation curFileLoc = {NULL, -1};
+FILE *yyin;
+
+static int next(void) { return fgetc(yyin); }
+static void back(int c) { if (c != EOF) ungetc(c, yyin); }
+
+int yylex(void)
+{
+  for (;;) {
+    int c = next();
+    if (c == EOF) { curFileLoc.row = -1; return EOF_TOK; }
+    if (c == '\n') { curFileLoc.row++; continue; }
+    if (c == '\r') { int d = next(); if (d == '\n') { curFileLoc.row++; continue; } back(d); return -1; }
+    if (c == ' ' || c == '\t' || c == '\f' || c == '\v') continue;
+    if (c == '/') {
+      int d = next();
+      if (d == '/') { while ((c = next()) != EOF && c != '\n'); back(c); continue; }
+      if (d == '*') {
+        int prev = 0;
+        for (;;) {
+          c = next();
+          if (c == EOF) { curFileLoc.row = -1; return EOF_TOK; }
+          if (c == '\n') curFileLoc.row++;
+          if (prev == '*' && c == '/') break;
+          prev = c;
+        }
+        continue;
+      }
+      back(d); return DIV_OP;
+    }
+    int d;
+    switch (c) {
+      case '{': return LBRACE; case '}': return RBRACE;
+      case '[': return LSQUARE; case ']': return RSQUARE;
+      case '(': return LPAR; case ')': return RPAR;
+      case ';': return SEMI; case '+': return PLUS; case '-': return MINUS;
+      case '*': return MUL_OP; case '%': return MOD_OP;
+      case '^': return XOR_OP; case ',': return COMMA;
+      case '&': d = next(); if (d == '&') return ANDAND; back(d); return AND_OP;
+      case '|': d = next(); if (d == '|') return OROR; back(d); return OR_OP;
+      case '!': d = next(); if (d == '=') return NOTEQ; back(d); return NOT_OP;
+      case '=': d = next(); if (d == '=') return EQ; back(d); return ASSIGN;
+      case '<': d = next(); if (d == '=') return LTEQ; if (d == '<') return SHL_OP; back(d); return LT;
+      case '>': d = next(); if (d == '=') return GTEQ; if (d == '>') return SHR_OP; back(d); return GT;
+    }
+    char buf[4096]; int n = 0;
+    if (isalpha(c) || c == '_') {
+      do { buf[n++] = (char)c; c = next(); } while ((isalnum(c) || c == '_') && n < 4095);
+      back(c); buf[n] = 0;
+      if (!strcmp(buf, "do")) return DO;
+      if (!strcmp(buf, "else")) return ELSE;
+      if (!strcmp(buf, "if")) return IF;
+      if (!strcmp(buf, "int")) return TYPE;
+      if (!strcmp(buf, "while")) return WHILE;
+      if (!strcmp(buf, "return")) return RETURN;
+      if (!strcmp(buf, "read")) return READ;
+      if (!strcmp(buf, "write")) return WRITE;
+      yylval.string = strdup(buf);
+      return IDENTIFIER;
+    }
+    if (isdigit(c)) {
+      do { buf[n++] = (char)c; c = next(); } while (isdigit(c) && n < 4095);
+      back(c); buf[n] = 0;
+      yylval.integer = atoi(buf);
+      return NUMBER;
+    }
+    yyerror("unexpected token");
+    return -1;
+  }
+}
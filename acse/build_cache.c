@@ -0,0 +1,247 @@
+/// @file build_cache.c
+/// @brief Cache of the compiled output files implementation
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "build_cache.h"
+#include "errors.h"
+
+/// Magic string at the start of each entry. An entry holds the magic, the
+/// size of the key and the size of the output, as 64 bit little endian
+/// numbers, followed by the key and the output.
+#define BCACHE_MAGIC "ACSEBC01"
+/// Size of the magic string.
+#define BCACHE_MAGIC_SIZE (sizeof(BCACHE_MAGIC) - 1)
+/// Size of the header of an entry.
+#define BCACHE_HEADER_SIZE (BCACHE_MAGIC_SIZE + 8 + 8)
+
+/// Tag of the key field with the name and the version of the tool.
+#define BCACHE_FIELD_TOOL 'T'
+/// Tag of a key field with an option.
+#define BCACHE_FIELD_OPTION 'O'
+/// Tag of a key field with the contents of an input file.
+#define BCACHE_FIELD_INPUT 'I'
+
+/// Structure describing a build cache.
+struct t_buildCache {
+  /// Directory containing the entries.
+  char *dir;
+  /// The key, as a sequence of fields, each one made of a tag byte, its size
+  /// and its contents.
+  uint8_t *key;
+  /// Size of the key in bytes.
+  size_t keySize;
+  /// Allocated size of the key buffer.
+  size_t keyCapacity;
+};
+
+
+static void bcachePut64(uint8_t *out, uint64_t x)
+{
+  for (int i = 0; i < 8; i++, x >>= 8)
+    out[i] = (uint8_t)(x & 0xFF);
+}
+
+static uint64_t bcacheGet64(const uint8_t *in)
+{
+  uint64_t res = 0;
+  for (int i = 7; i >= 0; i--)
+    res = (res << 8) | in[i];
+  return res;
+}
+
+
+static void bcacheAppendField(
+    t_buildCache *cache, char tag, const void *data, size_t size)
+{
+  size_t needed = cache->keySize + 1 + 8 + size;
+  if (needed > cache->keyCapacity) {
+    size_t capacity = cache->keyCapacity * 2;
+    if (capacity < needed)
+      capacity = needed;
+    uint8_t *key = realloc(cache->key, capacity);
+    if (!key)
+      fatalError("out of memory");
+    cache->key = key;
+    cache->keyCapacity = capacity;
+  }
+  uint8_t *p = cache->key + cache->keySize;
+  p[0] = (uint8_t)tag;
+  bcachePut64(p + 1, size);
+  if (size > 0)
+    memcpy(p + 9, data, size);
+  cache->keySize = needed;
+}
+
+
+t_buildCache *newBuildCache(const char *dir, const char *tool)
+{
+  t_buildCache *cache = calloc(1, sizeof(t_buildCache));
+  if (!cache)
+    fatalError("out of memory");
+  cache->dir = strdup(dir);
+  if (!cache->dir)
+    fatalError("out of memory");
+  bcacheAppendField(cache, BCACHE_FIELD_TOOL, tool, strlen(tool));
+  return cache;
+}
+
+void deleteBuildCache(t_buildCache *cache)
+{
+  if (!cache)
+    return;
+  free(cache->dir);
+  free(cache->key);
+  free(cache);
+}
+
+
+/// Read the whole file in a buffer allocated with malloc.
+static uint8_t *bcacheReadFile(const char *path, size_t *outSize)
+{
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return NULL;
+  size_t size = 0, capacity = 0x10000;
+  uint8_t *buf = malloc(capacity);
+  if (!buf)
+    fatalError("out of memory");
+  size_t n;
+  while ((n = fread(buf + size, 1, capacity - size, fp)) > 0) {
+    size += n;
+    if (size == capacity) {
+      capacity *= 2;
+      uint8_t *newBuf = realloc(buf, capacity);
+      if (!newBuf)
+        fatalError("out of memory");
+      buf = newBuf;
+    }
+  }
+  bool failed = ferror(fp) != 0;
+  fclose(fp);
+  if (failed) {
+    free(buf);
+    return NULL;
+  }
+  *outSize = size;
+  return buf;
+}
+
+bool bcacheAddInput(t_buildCache *cache, const char *path)
+{
+  size_t size;
+  uint8_t *buf = bcacheReadFile(path, &size);
+  if (!buf)
+    return false;
+  bcacheAppendField(cache, BCACHE_FIELD_INPUT, buf, size);
+  free(buf);
+  return true;
+}
+
+void bcacheAddOption(t_buildCache *cache, const char *option)
+{
+  bcacheAppendField(cache, BCACHE_FIELD_OPTION, option, strlen(option));
+}
+
+
+/// The name of the entry is the FNV-1a hash of the key.
+static char *bcacheEntryPath(t_buildCache *cache, const char *suffix)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < cache->keySize; i++)
+    hash = (hash ^ cache->key[i]) * 1099511628211ULL;
+
+  size_t size = strlen(cache->dir) + 1 + 16 + strlen(suffix) + 1;
+  char *path = malloc(size);
+  if (!path)
+    fatalError("out of memory");
+  snprintf(path, size, "%s/%016llx%s", cache->dir, (unsigned long long)hash,
+      suffix);
+  return path;
+}
+
+
+static bool bcacheWriteFile(
+    const char *path, const uint8_t *header, size_t headerSize,
+    const uint8_t *key, size_t keySize, const uint8_t *data, size_t dataSize)
+{
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL)
+    return false;
+  bool ok = fwrite(header, 1, headerSize, fp) == headerSize &&
+      fwrite(key, 1, keySize, fp) == keySize &&
+      fwrite(data, 1, dataSize, fp) == dataSize;
+  if (fclose(fp) != 0)
+    ok = false;
+  return ok;
+}
+
+bool bcacheFetch(t_buildCache *cache, const char *outPath)
+{
+  char *path = bcacheEntryPath(cache, "");
+  int fd = open(path, O_RDONLY);
+  free(path);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < BCACHE_HEADER_SIZE) {
+    close(fd);
+    return false;
+  }
+  size_t size = (size_t)st.st_size;
+  // entries are never modified after they are renamed into place, so the
+  // mapping stays valid even if the entry is replaced meanwhile
+  uint8_t *entry = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (entry == MAP_FAILED)
+    return false;
+
+  bool hit = memcmp(entry, BCACHE_MAGIC, BCACHE_MAGIC_SIZE) == 0 &&
+      bcacheGet64(entry + BCACHE_MAGIC_SIZE) == cache->keySize &&
+      bcacheGet64(entry + BCACHE_MAGIC_SIZE + 8) ==
+          size - BCACHE_HEADER_SIZE - cache->keySize &&
+      memcmp(entry + BCACHE_HEADER_SIZE, cache->key, cache->keySize) == 0;
+  if (hit) {
+    const uint8_t *data = entry + BCACHE_HEADER_SIZE + cache->keySize;
+    size_t dataSize = size - BCACHE_HEADER_SIZE - cache->keySize;
+    FILE *fp = fopen(outPath, "wb");
+    hit = fp != NULL && fwrite(data, 1, dataSize, fp) == dataSize;
+    if (fp != NULL && fclose(fp) != 0)
+      hit = false;
+  }
+  munmap(entry, size);
+  return hit;
+}
+
+void bcacheStore(t_buildCache *cache, const char *outPath)
+{
+  size_t size;
+  uint8_t *data = bcacheReadFile(outPath, &size);
+  if (!data)
+    return;
+  mkdir(cache->dir, 0777);
+
+  uint8_t header[BCACHE_HEADER_SIZE];
+  memcpy(header, BCACHE_MAGIC, BCACHE_MAGIC_SIZE);
+  bcachePut64(header + BCACHE_MAGIC_SIZE, cache->keySize);
+  bcachePut64(header + BCACHE_MAGIC_SIZE + 8, size);
+
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%ld.tmp", (long)getpid());
+  char *tmpPath = bcacheEntryPath(cache, suffix);
+  char *path = bcacheEntryPath(cache, "");
+  if (!bcacheWriteFile(tmpPath, header, sizeof(header), cache->key,
+          cache->keySize, data, size) ||
+      rename(tmpPath, path) != 0)
+    remove(tmpPath);
+  free(path);
+  free(tmpPath);
+  free(data);
+}
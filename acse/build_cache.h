@@ -0,0 +1,65 @@
+/// @file build_cache.h
+/// @brief Cache of the compiled output files
+
+#ifndef BUILD_CACHE_H
+#define BUILD_CACHE_H
+
+#include <stdbool.h>
+
+/**
+ * @defgroup buildcache Build Cache
+ * @brief Reuse of the output of previous compilations.
+ *
+ * The cache is a directory which can be shared by any number of concurrent
+ * runs of the compiler. An entry is keyed by the name and the version of the
+ * tool, by the options which affect the output and by the contents of the
+ * input file. The whole key is stored in the entry and compared on lookup, so
+ * that a hash collision can only cause a miss. Entries are written to a
+ * temporary file and then renamed, so a reader never sees a partial entry.
+ *
+ * The cache is only an optimization: when it cannot be read or written the
+ * output is simply produced, or not stored, without reporting any error.
+ * @{
+ */
+
+/** Opaque build cache object. */
+typedef struct t_buildCache t_buildCache;
+
+/** Create a new build cache object.
+ *  @param dir  The directory containing the cache entries. It is created
+ *              when the first entry is stored.
+ *  @param tool The name and the version of the tool, added to the key.
+ *  @return A new build cache object. */
+t_buildCache *newBuildCache(const char *dir, const char *tool);
+
+/** Deallocate a build cache object.
+ *  @param cache The build cache object, or NULL. */
+void deleteBuildCache(t_buildCache *cache);
+
+/** Add the contents of an input file to the key.
+ *  @param cache The build cache object.
+ *  @param path  The path of the input file.
+ *  @return false if the file cannot be read. */
+bool bcacheAddInput(t_buildCache *cache, const char *path);
+
+/** Add an option which affects the output to the key.
+ *  @param cache  The build cache object.
+ *  @param option The option as a string. */
+void bcacheAddOption(t_buildCache *cache, const char *option);
+
+/** Look up the key in the cache, and copy the output to a file on a hit.
+ *  @param cache   The build cache object.
+ *  @param outPath The path of the output file.
+ *  @return true if the output was found and written to outPath. */
+bool bcacheFetch(t_buildCache *cache, const char *outPath);
+
+/** Store in the cache the output just written to a file.
+ *  @param cache   The build cache object.
+ *  @param outPath The path of the output file. */
+void bcacheStore(t_buildCache *cache, const char *outPath);
+
+/**
+ * @}
+ */
+
+#endif
@@ -9,38 +9,40 @@
 #include "errors.h"
 
 
-static bool compareCFGRegAndRegID(void *a, void *b)
-{
-  t_cfgReg *cfgReg = (t_cfgReg *)a;
-  t_regID id = *((t_regID *)b);
-
-  if (cfgReg == NULL)
-    return false;
-  return cfgReg->tempRegID == id;
-}
-
 /* Alloc a new control flow graph register object. If a register object
  * referencing the same identifier already exists, returns the pre-existing
  * object. */
 static t_cfgReg *createCFGRegister(t_cfg *graph, t_instrArg *arg)
 {
-  // Test if a register with the same identifier is already present.
-  t_listNode *elementFound =
-      listFindWithCallback(graph->registers, &arg->ID, compareCFGRegAndRegID);
+  if (arg->ID < 0)
+    fatalError("bug: invalid register identifier %d in CFG", arg->ID);
+
+  // Grow the table of the registers by identifier to make room for this one.
+  if (arg->ID >= graph->numRegsByID) {
+    int newSize = graph->numRegsByID * 2;
+    if (newSize <= arg->ID)
+      newSize = arg->ID + 1;
+    t_cfgReg **newTable =
+        realloc(graph->regsByID, sizeof(t_cfgReg *) * (size_t)newSize);
+    if (newTable == NULL)
+      fatalError("out of memory");
+    for (int i = graph->numRegsByID; i < newSize; i++)
+      newTable[i] = NULL;
+    graph->regsByID = newTable;
+    graph->numRegsByID = newSize;
+  }
 
-  t_cfgReg *result;
-  if (elementFound) {
-    // It's there: just use it.
-    result = (t_cfgReg *)elementFound->data;
-  } else {
+  // Test if a register with the same identifier is already present.
+  t_cfgReg *result = graph->regsByID[arg->ID];
+  if (result == NULL) {
     // If it's not there it needs to be created.
-    result = malloc(sizeof(t_cfgReg));
-    if (result == NULL)
-      fatalError("out of memory");
+    result = arenaAlloc(&graph->arena, sizeof(t_cfgReg));
     result->tempRegID = arg->ID;
     result->mcRegWhitelist = NULL;
+    result->liveIndex = -1;
     // Insert it in the list of registers
     graph->registers = listInsert(graph->registers, result, -1);
+    graph->regsByID[arg->ID] = result;
   }
 
   // Copy the machine register allocation constraint, or compute the
@@ -67,33 +69,18 @@ static t_cfgReg *createCFGRegister(t_cfg *graph, t_instrArg *arg)
 }
 
 
-static t_bbNode *newBBNode(t_instruction *instr)
+static t_bbNode *newBBNode(t_cfg *graph, t_instruction *instr)
 {
-  t_bbNode *result = malloc(sizeof(t_bbNode));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_bbNode *result = arenaAlloc(&graph->arena, sizeof(t_bbNode));
   for (int i = 0; i < CFG_MAX_DEFS; i++)
     result->defs[i] = NULL;
   for (int i = 0; i < CFG_MAX_USES; i++)
     result->uses[i] = NULL;
   result->instr = instr;
-  result->in = NULL;
-  result->out = NULL;
   result->parent = NULL;
   return result;
 }
 
-/** Free a given basic block node.
- *  @param node The node to be freed. */
-static void deleteBBNode(t_bbNode *node)
-{
-  if (node == NULL)
-    return;
-  deleteList(node->in);
-  deleteList(node->out);
-  free(node);
-}
-
 static void bbNodeComputeDefUses(t_bbNode *node)
 {
   t_cfg *graph = node->parent->parent;
@@ -123,38 +110,36 @@ static void bbNodeComputeDefUses(t_bbNode *node)
 
 
 /** Allocate a new empty basic block.
+ *  @param graph The graph which owns the memory of the block.
  *  @returns The new block. */
-t_basicBlock *newBasicBlock(void)
+static t_basicBlock *newBasicBlock(t_cfg *graph)
 {
-  t_basicBlock *result = malloc(sizeof(t_basicBlock));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_basicBlock *result = arenaAlloc(&graph->arena, sizeof(t_basicBlock));
   result->pred = NULL;
   result->succ = NULL;
   result->nodes = NULL;
-  result->parent = NULL;
+  result->parent = graph;
+  result->use = NULL;
+  result->def = NULL;
+  result->in = NULL;
+  result->out = NULL;
+  result->livenessIndex = -1;
+  result->loopDepth = 0;
   return result;
 }
 
-/** Frees the memory associated with a given basic block.
+/** Frees the memory associated with a given basic block, except the block
+ *  itself and its nodes, which belong to the arena of the graph.
  *  @param block The block to be freed. */
-void deleteBasicBlock(t_basicBlock *block)
+static void deleteBasicBlock(t_basicBlock *block)
 {
-  if (block == NULL)
-    return;
-
   deleteList(block->pred);
   deleteList(block->succ);
-
-  t_listNode *curNode = block->nodes;
-  while (curNode != NULL) {
-    t_bbNode *curCFGNode = (t_bbNode *)curNode->data;
-    deleteBBNode(curCFGNode);
-    curNode = curNode->next;
-  }
-
   deleteList(block->nodes);
-  free(block);
+  deleteBitset(block->use);
+  deleteBitset(block->def);
+  deleteBitset(block->in);
+  deleteBitset(block->out);
 }
 
 /** Adds a predecessor to a basic block.
@@ -183,7 +168,7 @@ void bbAddSucc(t_basicBlock *block, t_basicBlock *succ)
 
 t_bbNode *bbInsertInstruction(t_basicBlock *block, t_instruction *instr)
 {
-  t_bbNode *newNode = newBBNode(instr);
+  t_bbNode *newNode = newBBNode(block->parent, instr);
   block->nodes = listInsert(block->nodes, newNode, -1);
   newNode->parent = block;
   bbNodeComputeDefUses(newNode);
@@ -197,7 +182,10 @@ t_bbNode *bbInsertInstructionBefore(
   if (listIP == NULL)
     fatalError("bug: invalid basic block node; corrupt CFG?");
 
-  t_bbNode *newNode = newBBNode(instr);
+  // Code inserted around an instruction belongs to the same statement.
+  if (!instr->source.file)
+    instr->source = ip->instr->source;
+  t_bbNode *newNode = newBBNode(block->parent, instr);
   block->nodes = listInsertBefore(block->nodes, listIP, newNode);
   newNode->parent = block;
   bbNodeComputeDefUses(newNode);
@@ -211,7 +199,10 @@ t_bbNode *bbInsertInstructionAfter(
   if (listIP == NULL)
     fatalError("bug: invalid basic block node; corrupt CFG?");
 
-  t_bbNode *newNode = newBBNode(instr);
+  // Code inserted around an instruction belongs to the same statement.
+  if (!instr->source.file)
+    instr->source = ip->instr->source;
+  t_bbNode *newNode = newBBNode(block->parent, instr);
   block->nodes = listInsertAfter(block->nodes, listIP, newNode);
   newNode->parent = block;
   bbNodeComputeDefUses(newNode);
@@ -225,10 +216,16 @@ static t_cfg *newCFG(void)
   if (result == NULL)
     fatalError("out of memory");
   result->blocks = NULL;
+  result->numBlocks = 0;
+  result->livenessOrder = NULL;
   result->registers = NULL;
+  result->regsByID = NULL;
+  result->numRegsByID = 0;
+  result->liveRegs = NULL;
+  result->numLiveRegs = 0;
+  result->arena = (t_arena){NULL};
   // Create the dummy ending block.
-  result->endingBlock = newBasicBlock();
-  result->endingBlock->parent = result;
+  result->endingBlock = newBasicBlock(result);
   return result;
 }
 
@@ -245,17 +242,20 @@ void deleteCFG(t_cfg *graph)
     curNode = curNode->next;
   }
   deleteList(graph->blocks);
+  free(graph->livenessOrder);
   deleteBasicBlock(graph->endingBlock);
 
   curNode = graph->registers;
   while (curNode) {
     t_cfgReg *curReg = (t_cfgReg *)curNode->data;
     deleteList(curReg->mcRegWhitelist);
-    free(curReg);
     curNode = curNode->next;
   }
   deleteList(graph->registers);
+  free(graph->regsByID);
+  free(graph->liveRegs);
 
+  deleteArena(&graph->arena);
   free(graph);
 }
 
@@ -264,38 +264,12 @@ void deleteCFG(t_cfg *graph)
  *  @returns The new block. */
 t_basicBlock *cfgCreateBlock(t_cfg *graph)
 {
-  t_basicBlock *block = newBasicBlock();
+  t_basicBlock *block = newBasicBlock(graph);
   graph->blocks = listInsert(graph->blocks, block, -1);
-  block->parent = graph;
+  graph->numBlocks++;
   return block;
 }
 
-static t_basicBlock *cfgSearchLabel(t_cfg *graph, t_label *label)
-{
-  if (label == NULL)
-    return NULL;
-
-  t_basicBlock *bblock = NULL;
-  t_listNode *curNode = graph->blocks;
-  while (curNode != NULL) {
-    bblock = (t_basicBlock *)curNode->data;
-
-    // Check the first node of the basic block. If its instruction has a label,
-    // check if it's the label we are searching for.
-    t_bbNode *curCFGNode = (t_bbNode *)bblock->nodes->data;
-    if ((curCFGNode->instr)->label != NULL) {
-      if ((curCFGNode->instr)->label->labelID == label->labelID)
-        // Found!
-        break;
-    }
-
-    curNode = curNode->next;
-  }
-
-  return bblock;
-}
-
-
 static bool instrIsStartingNode(t_instruction *instr)
 {
   return instr->label != NULL;
@@ -306,14 +280,16 @@ static bool instrIsEndingNode(t_instruction *instr)
   return isExitInstruction(instr) || isJumpInstruction(instr);
 }
 
-static void cfgComputeTransitions(t_cfg *graph)
+static void cfgComputeTransitions(t_cfg *graph, t_basicBlock **blocksByLabel)
 {
   // This function is the continuation of programToCFG(), where after creating
   // the blocks in the CFG we need to construct the transitions between them.
   //   After the basic block construction, all branch instructions are now
   // found at the end of (some of the) basic blocks. The algorithm for adding
   // the transitions simply consists of searching for every branch, and adding
-  // the correct outgoing edges to its basic block.
+  // the correct outgoing edges to its basic block. The block which starts
+  // with each label is found in the `blocksByLabel' array, indexed by label
+  // ID.
   t_listNode *curNode = graph->blocks;
   while (curNode != NULL) {
     t_basicBlock *curBlock = (t_basicBlock *)curNode->data;
@@ -328,6 +304,7 @@ static void cfgComputeTransitions(t_cfg *graph)
     if (isExitInstruction(lastInstr)) {
       bbAddSucc(curBlock, graph->endingBlock);
       bbAddPred(graph->endingBlock, curBlock);
+      curNode = curNode->next;
       continue;
     }
 
@@ -336,7 +313,8 @@ static void cfgComputeTransitions(t_cfg *graph)
     if (isJumpInstruction(lastInstr)) {
       if (lastInstr->addressParam == NULL)
         fatalError("bug: malformed jump instruction with no label in CFG");
-      t_basicBlock *jumpBlock = cfgSearchLabel(graph, lastInstr->addressParam);
+      t_basicBlock *jumpBlock =
+          blocksByLabel[lastInstr->addressParam->labelID];
       if (jumpBlock == NULL)
         fatalError("bug: malformed jump instruction with invalid label in CFG");
       bbAddPred(jumpBlock, curBlock);
@@ -367,6 +345,82 @@ static void cfgComputeTransitions(t_cfg *graph)
   }
 }
 
+/* Computes the order in which cfgComputeLiveness() visits the blocks, which
+ * is the reverse post-order of a depth-first visit of the reversed graph
+ * starting from the ending block. Blocks from which the ending block cannot
+ * be reached (infinite loops) are visited afterwards, starting from the last
+ * one in the program. The visit uses an explicit stack, because the depth
+ * of the graph can be as large as the number of blocks. */
+static void cfgComputeLivenessOrder(t_cfg *graph)
+{
+  size_t maxDepth = (size_t)graph->numBlocks + 1;
+  t_basicBlock **order = malloc(sizeof(t_basicBlock *) * maxDepth);
+  t_basicBlock **stack = malloc(sizeof(t_basicBlock *) * maxDepth);
+  t_listNode **nextPred = malloc(sizeof(t_listNode *) * maxDepth);
+  if (order == NULL || stack == NULL || nextPred == NULL)
+    fatalError("out of memory");
+
+  // During the visit, `livenessIndex' is -1 for the blocks not visited yet
+  // and 0 for the others. The blocks are stored in post-order.
+  t_listNode *curNode = graph->blocks;
+  while (curNode != NULL) {
+    ((t_basicBlock *)curNode->data)->livenessIndex = -1;
+    curNode = curNode->next;
+  }
+
+  int numVisited = 0;
+  t_basicBlock *root = graph->endingBlock;
+  t_listNode *nextRoot = listGetLastNode(graph->blocks);
+  while (root != NULL) {
+    int depth = 0;
+    stack[0] = root;
+    nextPred[0] = root->pred;
+    while (depth >= 0) {
+      t_listNode *predNode = nextPred[depth];
+      if (predNode == NULL) {
+        // All the predecessors were visited: the block is done.
+        if (stack[depth] != graph->endingBlock)
+          order[numVisited++] = stack[depth];
+        depth--;
+        continue;
+      }
+      nextPred[depth] = predNode->next;
+      t_basicBlock *pred = (t_basicBlock *)predNode->data;
+      if (pred->livenessIndex == -1) {
+        pred->livenessIndex = 0;
+        depth++;
+        stack[depth] = pred;
+        nextPred[depth] = pred->pred;
+      }
+    }
+
+    // Find the next block not visited yet.
+    root = NULL;
+    while (nextRoot != NULL && root == NULL) {
+      t_basicBlock *block = (t_basicBlock *)nextRoot->data;
+      if (block->livenessIndex == -1) {
+        block->livenessIndex = 0;
+        root = block;
+      }
+      nextRoot = nextRoot->prev;
+    }
+  }
+
+  // Reverse the post-order.
+  for (int i = 0; i < numVisited / 2; i++) {
+    t_basicBlock *tmp = order[i];
+    order[i] = order[numVisited - 1 - i];
+    order[numVisited - 1 - i] = tmp;
+  }
+  for (int i = 0; i < numVisited; i++)
+    order[i]->livenessIndex = i;
+
+  free(graph->livenessOrder);
+  graph->livenessOrder = order;
+  free(stack);
+  free(nextPred);
+}
+
 t_cfg *programToCFG(t_program *program)
 {
   t_cfg *result = newCFG();
@@ -382,6 +436,10 @@ t_cfg *programToCFG(t_program *program)
   // block is created lazily at the next instruction found. This ensures no
   // empty blocks are created.
   t_basicBlock *bblock = NULL;
+  t_basicBlock **blocksByLabel = calloc(
+      (size_t)program->firstUnusedLblID + 1, sizeof(t_basicBlock *));
+  if (blocksByLabel == NULL)
+    fatalError("out of memory");
   t_listNode *curNode = program->instructions;
   while (curNode != NULL) {
     t_instruction *curInstr = (t_instruction *)curNode->data;
@@ -393,7 +451,9 @@ t_cfg *programToCFG(t_program *program)
       bblock = cfgCreateBlock(result);
 
     // Add the instruction to the end of the current basic block.
-    t_bbNode *curCFGNode = bbInsertInstruction(bblock, curInstr);
+    bbInsertInstruction(bblock, curInstr);
+    if (curInstr->label)
+      blocksByLabel[curInstr->label->labelID] = bblock;
 
     // If the instruction is a basic block terminator, set `bblock' to NULL
     // to stop inserting nodes into it.
@@ -405,7 +465,10 @@ t_cfg *programToCFG(t_program *program)
 
   // Now all the blocks have been created, we need to add the edges between
   // blocks, which is done in the cfgComputeTransitions() function.
-  cfgComputeTransitions(result);
+  cfgComputeTransitions(result, blocksByLabel);
+  free(blocksByLabel);
+  // Finally, compute the order of the blocks for the liveness analysis.
+  cfgComputeLivenessOrder(result);
   return result;
 }
 
@@ -462,186 +525,292 @@ int cfgIterateNodes(t_cfg *graph, void *context,
 }
 
 
+/* Builds the list of the registers in a set, in the order of their index in
+ * the given array of registers. */
+static t_listNode *cfgRegisterSetToList(t_cfgReg **regs, const t_bitset *set)
+{
+  t_listNode *result = NULL;
+  t_listNode *last = NULL;
+  for (int i = bitsetNext(set, 0); i >= 0; i = bitsetNext(set, i + 1)) {
+    result = listInsertAfter(result, last, regs[i]);
+    last = last ? last->next : result;
+  }
+  return result;
+}
+
 t_listNode *bbGetLiveOut(t_basicBlock *bblock)
 {
   if (bblock == NULL)
     return NULL;
-  if (bblock->nodes == NULL)
+  if (bblock->out == NULL)
     return NULL;
-
-  t_listNode *last = listGetLastNode(bblock->nodes);
-  t_bbNode *lastNode = (t_bbNode *)last->data;
-  return listClone(lastNode->out);
+  return cfgRegisterSetToList(bblock->parent->liveRegs, bblock->out);
 }
 
 t_listNode *bbGetLiveIn(t_basicBlock *bblock)
 {
   if (bblock == NULL)
     return NULL;
-  if (bblock->nodes == NULL)
+  if (bblock->in == NULL)
     return NULL;
-
-  t_bbNode *firstNode = (t_bbNode *)bblock->nodes->data;
-  return listClone(firstNode->in);
+  return cfgRegisterSetToList(bblock->parent->liveRegs, bblock->in);
 }
 
-static t_listNode *addElementToSet(t_listNode *set, void *element,
-    bool (*compareFunc)(void *a, void *b), bool *modified)
+/* Returns whether a register used or defined by a node is tracked in the
+ * liveness sets. The register 'zero' is not, when it is constant. */
+static bool cfgIsLivenessReg(t_cfgReg *reg)
 {
-  if (element == NULL)
-    return set;
-
-  // Add the element if it's not already in the `set' list.
-  if (listFindWithCallback(set, element, compareFunc) == NULL) {
-    set = listInsert(set, element, -1);
-    if (modified != NULL)
-      (*modified) = true;
-  }
-
-  return set;
+  if (reg == NULL)
+    return false;
+  return !(TARGET_REG_ZERO_IS_CONST && reg->tempRegID == REG_0);
 }
 
-static t_listNode *addElementsToSet(t_listNode *set, t_listNode *elements,
-    bool (*compareFunc)(void *a, void *b), bool *modified)
+/* Turns the set of the registers live at the exit of a node into the set of
+ * the registers live at its entry, by applying the standard flow equation:
+ *   in(node) = use(node) U (out(node) - def(node))
+ * The set is indexed by register identifier. */
+static void bbNodeApplyLiveness(t_bbNode *node, t_bitset *live)
 {
-  // Add all the elements to the set one by one.
-  t_listNode *curNode = elements;
-  while (curNode != NULL) {
-    void *curData = curNode->data;
-    set = addElementToSet(set, curData, compareFunc, modified);
-    curNode = curNode->next;
+  for (int i = 0; i < CFG_MAX_DEFS; i++) {
+    if (cfgIsLivenessReg(node->defs[i]))
+      bitsetRemove(live, node->defs[i]->tempRegID);
+  }
+  for (int i = 0; i < CFG_MAX_USES; i++) {
+    if (cfgIsLivenessReg(node->uses[i]))
+      bitsetAdd(live, node->uses[i]->tempRegID);
   }
-
-  // Return the new list.
-  return set;
 }
 
-static t_listNode *computeLiveInSetEquation(t_cfgReg *defs[CFG_MAX_DEFS],
-    t_cfgReg *uses[CFG_MAX_USES], t_listNode *liveOut)
+/* Finds the registers which are used in a block before being defined in it,
+ * and numbers them in the `liveRegs' array of the graph. These are the only
+ * registers which can be live at the boundary of a block; all the others
+ * are only live between a definition and a use in the same block. In the
+ * code produced by ACSE most temporary registers are of the second kind. */
+static void cfgFindLiveRegisters(t_cfg *graph)
 {
-  // Initialize live in set as equal to live out set.
-  t_listNode *liveIn = listClone(liveOut);
+  free(graph->liveRegs);
+  graph->liveRegs = malloc(sizeof(t_cfgReg *) * (graph->numRegsByID + 1));
+  // The number of the last block where each register was defined.
+  int *lastDefBlock = malloc(sizeof(int) * (graph->numRegsByID + 1));
+  if (graph->liveRegs == NULL || lastDefBlock == NULL)
+    fatalError("out of memory");
+  graph->numLiveRegs = 0;
+  for (int i = 0; i < graph->numRegsByID; i++) {
+    lastDefBlock[i] = -1;
+    if (graph->regsByID[i])
+      graph->regsByID[i]->liveIndex = -1;
+  }
 
-  // Add all items from set of uses.
-  for (int i = 0; i < CFG_MAX_USES; i++) {
-    if (uses[i] == NULL)
-      continue;
-    if (TARGET_REG_ZERO_IS_CONST && uses[i]->tempRegID == REG_0)
-      continue;
-    liveIn = addElementToSet(liveIn, uses[i], NULL, NULL);
+  int blockIndex = 0;
+  t_listNode *curBlockNode = graph->blocks;
+  while (curBlockNode != NULL) {
+    t_basicBlock *curBlock = (t_basicBlock *)curBlockNode->data;
+    t_listNode *curInnerNode = curBlock->nodes;
+    while (curInnerNode != NULL) {
+      t_bbNode *node = (t_bbNode *)curInnerNode->data;
+      // An instruction reads its sources before writing its destination.
+      for (int i = 0; i < CFG_MAX_USES; i++) {
+        t_cfgReg *reg = node->uses[i];
+        if (cfgIsLivenessReg(reg) && reg->liveIndex < 0 &&
+            lastDefBlock[reg->tempRegID] != blockIndex) {
+          reg->liveIndex = graph->numLiveRegs;
+          graph->liveRegs[graph->numLiveRegs++] = reg;
+        }
+      }
+      for (int i = 0; i < CFG_MAX_DEFS; i++) {
+        if (node->defs[i])
+          lastDefBlock[node->defs[i]->tempRegID] = blockIndex;
+      }
+      curInnerNode = curInnerNode->next;
+    }
+    blockIndex++;
+    curBlockNode = curBlockNode->next;
   }
 
-  // Remove items from set of definitions as long as they are not present in
-  // the set of uses.
-  for (int defIdx = 0; defIdx < CFG_MAX_DEFS; defIdx++) {
-    int found = 0;
+  free(lastDefBlock);
+}
 
-    if (defs[defIdx] == NULL)
-      continue;
-    if (TARGET_REG_ZERO_IS_CONST && defs[defIdx]->tempRegID == REG_0)
-      continue;
+/* Creates the liveness sets of a block, and computes its 'use' and 'def'
+ * sets from the ones of its nodes. */
+static void bbInitLiveness(t_basicBlock *bblock, int numLiveRegs)
+{
+  deleteBitset(bblock->use);
+  deleteBitset(bblock->def);
+  deleteBitset(bblock->in);
+  deleteBitset(bblock->out);
+  bblock->use = newBitset(numLiveRegs);
+  bblock->def = newBitset(numLiveRegs);
+  bblock->in = newBitset(numLiveRegs);
+  bblock->out = newBitset(numLiveRegs);
 
-    for (int useIdx = 0; useIdx < CFG_MAX_USES && !found; useIdx++) {
-      if (uses[useIdx] && uses[useIdx]->tempRegID == defs[defIdx]->tempRegID)
-        found = 1;
+  // Proceed backwards from the last node, so that a register is in the 'use'
+  // set only if it is used before any definition in the block.
+  t_listNode *curLI = listGetLastNode(bblock->nodes);
+  while (curLI != NULL) {
+    t_bbNode *curNode = (t_bbNode *)curLI->data;
+    for (int i = 0; i < CFG_MAX_DEFS; i++) {
+      t_cfgReg *reg = curNode->defs[i];
+      if (cfgIsLivenessReg(reg) && reg->liveIndex >= 0) {
+        bitsetAdd(bblock->def, reg->liveIndex);
+        bitsetRemove(bblock->use, reg->liveIndex);
+      }
     }
-
-    if (!found)
-      liveIn = listFindAndRemove(liveIn, defs[defIdx]);
+    for (int i = 0; i < CFG_MAX_USES; i++) {
+      t_cfgReg *reg = curNode->uses[i];
+      if (cfgIsLivenessReg(reg) && reg->liveIndex >= 0)
+        bitsetAdd(bblock->use, reg->liveIndex);
+    }
+    curLI = curLI->prev;
   }
-
-  return liveIn;
 }
 
-/* Re-computes the live registers out of a block by applying the standard
- * flow equation:
- *   out(block) = union in(block') for all successor block' */
-static t_listNode *cfgComputeLiveOutOfBlock(t_cfg *graph, t_basicBlock *block)
+/* Re-computes the live registers in and out of a block by applying the
+ * standard flow equations:
+ *   out(block) = union in(block') for all successor block'
+ *   in(block)  = use(block) U (out(block) - def(block)) */
+static bool cfgUpdateLivenessOfBlock(t_basicBlock *bblock)
 {
-  // Iterate through all the successor blocks
-  t_listNode *result = NULL;
-  t_listNode *curSuccNode = block->succ;
+  // The sets only grow during the analysis, so the union of the live in sets
+  // of the successors can be accumulated into the current live out set.
+  t_listNode *curSuccNode = bblock->succ;
   while (curSuccNode != NULL) {
     t_basicBlock *curSuccessor = (t_basicBlock *)curSuccNode->data;
-
-    if (curSuccessor != graph->endingBlock) {
-      // Update our block's 'out' set by adding all registers 'in' to the
-      // current successor.
-      t_listNode *liveINRegs = bbGetLiveIn(curSuccessor);
-      result = addElementsToSet(result, liveINRegs, NULL, NULL);
-      deleteList(liveINRegs);
-    }
-
+    bitsetUnion(bblock->out, curSuccessor->in);
     curSuccNode = curSuccNode->next;
   }
 
-  return result;
+  // Only the live in set matters to the other blocks.
+  return bitsetUnionDifference(
+      bblock->in, bblock->use, bblock->out, bblock->def);
 }
 
-static bool cfgUpdateLivenessOfNodesInBlock(t_cfg *graph, t_basicBlock *bblock)
+void cfgComputeLiveness(t_cfg *graph)
 {
-  // Keep track of whether we modified something or not.
-  bool modified = false;
-
-  // Start with the last node in the basic block, we will proceed upwards
-  // from there.
-  t_listNode *curLI = listGetLastNode(bblock->nodes);
-  // The live in set of the successors of the last node in the block is the
-  // live out set of the block itself.
-  t_listNode *successorsLiveIn = cfgComputeLiveOutOfBlock(graph, bblock);
-
-  while (curLI != NULL) {
-    // Get the current CFG node.
-    t_bbNode *curNode = (t_bbNode *)curLI->data;
-
-    // Live out of a block is equal to the union of the live in sets of the
-    // successors.
-    curNode->out =
-        addElementsToSet(curNode->out, successorsLiveIn, NULL, &modified);
-    deleteList(successorsLiveIn);
+  cfgFindLiveRegisters(graph);
 
-    // Compute the live in set of the block using the set of definition,
-    // uses and live out registers of the block.
-    t_listNode *liveIn =
-        computeLiveInSetEquation(curNode->defs, curNode->uses, curNode->out);
-    curNode->in = addElementsToSet(curNode->in, liveIn, NULL, &modified);
+  // The ending block is empty, so nothing is live in it.
+  bbInitLiveness(graph->endingBlock, graph->numLiveRegs);
+  t_listNode *curNode = graph->blocks;
+  while (curNode != NULL) {
+    bbInitLiveness((t_basicBlock *)curNode->data, graph->numLiveRegs);
+    curNode = curNode->next;
+  }
 
-    // Since there are no branches in a basic block, the successors of
-    // the predecessor is just the current block.
-    successorsLiveIn = liveIn;
+  // Solve the flow equations with a worklist of the positions of the blocks
+  // in the liveness order. Initially all the blocks must be visited; then a
+  // block is visited again only if the live in set of one of its successors
+  // has changed. The worklist is scanned cyclically in ascending order, so
+  // that the blocks are always visited in the liveness order, and in most
+  // programs each one is visited only a few times.
+  t_bitset *worklist = newBitset(graph->numBlocks);
+  for (int i = 0; i < graph->numBlocks; i++)
+    bitsetAdd(worklist, i);
+
+  int i = bitsetNext(worklist, 0);
+  while (i >= 0) {
+    bitsetRemove(worklist, i);
+    t_basicBlock *curBlock = graph->livenessOrder[i];
+
+    if (cfgUpdateLivenessOfBlock(curBlock)) {
+      t_listNode *curPredNode = curBlock->pred;
+      while (curPredNode != NULL) {
+        t_basicBlock *curPred = (t_basicBlock *)curPredNode->data;
+        bitsetAdd(worklist, curPred->livenessIndex);
+        curPredNode = curPredNode->next;
+      }
+    }
 
-    // Continue backwards to the previous node.
-    curLI = curLI->prev;
+    int next = bitsetNext(worklist, i + 1);
+    if (next < 0)
+      next = bitsetNext(worklist, 0);
+    i = next;
   }
 
-  deleteList(successorsLiveIn);
-
-  // Return a non-zero value if anything was modified.
-  return modified;
+  deleteBitset(worklist);
 }
 
-static bool cfgPerformLivenessIteration(t_cfg *graph)
+void cfgComputeLoopDepths(t_cfg *graph)
 {
-  bool modified = false;
-  t_listNode *curNode = listGetLastNode(graph->blocks);
+  // Number the blocks in program order, temporarily using the loop depth
+  // field. The ending block never belongs to a loop.
+  int index = 0;
+  t_listNode *curNode = graph->blocks;
   while (curNode != NULL) {
-    t_basicBlock *curBlock = (t_basicBlock *)curNode->data;
+    ((t_basicBlock *)curNode->data)->loopDepth = index++;
+    curNode = curNode->next;
+  }
 
-    // Update the liveness informations for the current basic block.
-    if (cfgUpdateLivenessOfNodesInBlock(graph, curBlock))
-      modified = true;
+  // Each backward jump increments the depth of a range of blocks. Record the
+  // difference between the depth of a block and the previous one.
+  int *depthDelta = calloc((size_t)index + 1, sizeof(int));
+  if (depthDelta == NULL)
+    fatalError("out of memory");
+  curNode = graph->blocks;
+  while (curNode != NULL) {
+    t_basicBlock *curBlock = (t_basicBlock *)curNode->data;
+    t_listNode *curSuccNode = curBlock->succ;
+    while (curSuccNode != NULL) {
+      t_basicBlock *curSucc = (t_basicBlock *)curSuccNode->data;
+      if (curSucc != graph->endingBlock &&
+          curSucc->loopDepth <= curBlock->loopDepth) {
+        depthDelta[curSucc->loopDepth]++;
+        depthDelta[curBlock->loopDepth + 1]--;
+      }
+      curSuccNode = curSuccNode->next;
+    }
+    curNode = curNode->next;
+  }
 
-    curNode = curNode->prev;
+  int depth = 0;
+  index = 0;
+  curNode = graph->blocks;
+  while (curNode != NULL) {
+    depth += depthDelta[index++];
+    ((t_basicBlock *)curNode->data)->loopDepth = depth;
+    curNode = curNode->next;
   }
-  return modified;
+  graph->endingBlock->loopDepth = 0;
+  free(depthDelta);
 }
 
-void cfgComputeLiveness(t_cfg *graph)
+int bbIterateNodesLiveness(t_basicBlock *bblock, void *context,
+    int (*callback)(t_bbNode *node, const t_bitset *in, const t_bitset *out,
+        void *context))
 {
-  bool modified;
-  do {
-    modified = cfgPerformLivenessIteration(graph);
-  } while (modified);
+  if (bblock->out == NULL)
+    fatalError("bug: liveness of a basic block used before computing it");
+
+  // The sets of the nodes are indexed by register identifier, because they
+  // also contain the registers live only inside the block.
+  t_cfg *graph = bblock->parent;
+  t_bitset *in = newBitset(graph->numRegsByID);
+  t_bitset *out = newBitset(graph->numRegsByID);
+  const t_bitset *blockOut = bblock->out;
+  for (int i = bitsetNext(blockOut, 0); i >= 0;
+       i = bitsetNext(blockOut, i + 1))
+    bitsetAdd(out, graph->liveRegs[i]->tempRegID);
+
+  int exitcode = 0;
+  t_listNode *curLI = listGetLastNode(bblock->nodes);
+  while (curLI != NULL) {
+    t_bbNode *curNode = (t_bbNode *)curLI->data;
+    bitsetCopy(in, out);
+    bbNodeApplyLiveness(curNode, in);
+
+    exitcode = callback(curNode, in, out, context);
+    if (exitcode != 0)
+      break;
+
+    // The live out set of the previous node is the live in set of this one.
+    t_bitset *tmp = out;
+    out = in;
+    in = tmp;
+    curLI = curLI->prev;
+  }
+
+  deleteBitset(in);
+  deleteBitset(out);
+  return exitcode;
 }
 
 
@@ -724,6 +893,27 @@ static void dumpBBList(t_listNode *list, FILE *fout)
   }
 }
 
+/* Live in and out sets of all the nodes in a block, collected by
+ * bbIterateNodesLiveness() for the dump. */
+typedef struct {
+  t_cfg *graph;
+  t_listNode **in;
+  t_listNode **out;
+  int index;
+} t_cfgDumpLiveness;
+
+static int cfgDumpLivenessCallback(
+    t_bbNode *node, const t_bitset *in, const t_bitset *out, void *context)
+{
+  t_cfgDumpLiveness *liveness = (t_cfgDumpLiveness *)context;
+  // The nodes are visited from the last one.
+  liveness->index--;
+  t_cfgReg **regs = liveness->graph->regsByID;
+  liveness->in[liveness->index] = cfgRegisterSetToList(regs, in);
+  liveness->out[liveness->index] = cfgRegisterSetToList(regs, out);
+  return 0;
+}
+
 static void cfgDumpBB(t_basicBlock *block, FILE *fout, bool verbose)
 {
   if (block == NULL)
@@ -731,6 +921,17 @@ static void cfgDumpBB(t_basicBlock *block, FILE *fout, bool verbose)
   if (fout == NULL)
     return;
 
+  t_cfgDumpLiveness liveness = {block->parent, NULL, NULL, 0};
+  int numNodes = listLength(block->nodes);
+  if (verbose && block->out != NULL) {
+    liveness.in = calloc((size_t)numNodes + 1, sizeof(t_listNode *));
+    liveness.out = calloc((size_t)numNodes + 1, sizeof(t_listNode *));
+    if (liveness.in == NULL || liveness.out == NULL)
+      fatalError("out of memory");
+    liveness.index = numNodes;
+    bbIterateNodesLiveness(block, &liveness, cfgDumpLivenessCallback);
+  }
+
   fprintf(fout, "  Predecessor blocks: {");
   dumpBBList(block->pred, fout);
   fprintf(fout, "}\n");
@@ -758,18 +959,29 @@ static void cfgDumpBB(t_basicBlock *block, FILE *fout, bool verbose)
       dumpArrayOfCFGRegisters(curCFGNode->uses, CFG_MAX_USES, fout);
       fprintf(fout, "}\n");
 
-      fprintf(fout, "    in  = {");
-      dumpListOfCFGRegisters(curCFGNode->in, fout);
-      fprintf(fout, "}\n");
-      fprintf(fout, "    out = {");
-      dumpListOfCFGRegisters(curCFGNode->out, fout);
-      fprintf(fout, "}\n");
+      if (liveness.in != NULL) {
+        fprintf(fout, "    in  = {");
+        dumpListOfCFGRegisters(liveness.in[count - 1], fout);
+        fprintf(fout, "}\n");
+        fprintf(fout, "    out = {");
+        dumpListOfCFGRegisters(liveness.out[count - 1], fout);
+        fprintf(fout, "}\n");
+      }
     }
 
     count++;
     elem = elem->next;
   }
   fflush(fout);
+
+  if (liveness.in != NULL) {
+    for (int i = 0; i < numNodes; i++) {
+      deleteList(liveness.in[i]);
+      deleteList(liveness.out[i]);
+    }
+    free(liveness.in);
+    free(liveness.out);
+  }
 }
 
 void cfgDump(t_cfg *graph, FILE *fout, bool verbose)
@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include "program.h"
 #include "list.h"
+#include "bitset.h"
 
 /**
  * @defgroup cfg Control Flow Graph
@@ -17,6 +18,14 @@
  * modify a Control Flow Graph (CFG) representation of a program.
  * A program can be converted to and from a CFG, and a CFG can be analyzed to
  * compute the liveness of each register.
+ *   Sets of registers are represented as bit sets. The liveness is stored for
+ * each basic block, and it is computed for the single nodes only on request,
+ * because storing a set for each node would take time and memory
+ * proportional to the number of nodes times the number of registers. For the
+ * same reason, the sets of the blocks only include the registers which are
+ * used in some block before being defined in it, and they are indexed by the
+ * position of the register in the `liveRegs' array of the graph. The sets of
+ * the nodes are indexed by register identifier.
  * These facilities are used by the register allocation process.
  * @{
  */
@@ -34,13 +43,16 @@ typedef struct {
   t_regID tempRegID;
   /// Physical register whitelist. Used by the register allocator.
   t_listNode *mcRegWhitelist;
+  /// Index of the register in the liveness sets of the basic blocks, or -1
+  /// if the register is never live at the boundary of a block.
+  int liveIndex;
 } t_cfgReg;
 
 typedef struct t_basicBlock t_basicBlock;
 typedef struct t_cfg t_cfg;
 
-/** Node in a basic block. Represents an instruction, the temporary registers
- * it uses and/or defines, and live temporary registers in/out of the node. */
+/** Node in a basic block. Represents an instruction and the temporary
+ * registers it uses and/or defines. */
 typedef struct {
   /// Pointer to the containing basic block.
   t_basicBlock *parent;
@@ -50,10 +62,6 @@ typedef struct {
   t_cfgReg *defs[CFG_MAX_DEFS];
   /// Set of registers used by this node ('use' set). NULL slots are ignored.
   t_cfgReg *uses[CFG_MAX_USES];
-  /// Set of registers live at the entry of the node ('in' set).
-  t_listNode *in;
-  /// Set of registers live at the exit of the node ('out' set).
-  t_listNode *out;
 } t_bbNode;
 
 /** Structure representing a basic block, i.e. a segment of contiguous
@@ -65,6 +73,20 @@ struct t_basicBlock {
   t_listNode *pred;  ///< List of predecessors to this basic block.
   t_listNode *succ;  ///< List of successors to this basic block.
   t_listNode *nodes; ///< List of instructions in the block.
+  /// Registers used in the block before being defined ('use' set), or NULL
+  /// if the liveness was not computed.
+  t_bitset *use;
+  /// Registers defined in the block ('def' set), or NULL.
+  t_bitset *def;
+  /// Registers live at the entry of the block ('in' set), or NULL.
+  t_bitset *in;
+  /// Registers live at the exit of the block ('out' set), or NULL.
+  t_bitset *out;
+  /// Position of the block in the `livenessOrder' array of the graph, or -1
+  /// for the ending block.
+  int livenessIndex;
+  /// Number of loops containing the block. Computed by cfgComputeLoopDepths().
+  int loopDepth;
 };
 
 /** Data structure describing a control flow graph. */
@@ -74,8 +96,28 @@ struct t_cfg {
   /// Unique final basic block. The control flow must eventually reach here.
   /// This block is always empty, and is not part of the 'blocks' list.
   t_basicBlock *endingBlock;
+  /// Number of blocks in the `blocks' list.
+  int numBlocks;
+  /// All the basic blocks, in the order in which the liveness analysis visits
+  /// them: the reverse post-order of the reversed graph, from the ending
+  /// block. In this order a block is visited, when possible, after its
+  /// successors.
+  t_basicBlock **livenessOrder;
   /// List of all temporary registers used in the program.
   t_listNode *registers;
+  /// The registers in the `registers' list indexed by their identifier.
+  /// Identifiers not used in the program map to NULL.
+  t_cfgReg **regsByID;
+  /// Number of elements in the `regsByID' array.
+  int numRegsByID;
+  /// The registers which may be live at the boundary of a basic block,
+  /// indexed by their `liveIndex'. Computed by cfgComputeLiveness().
+  t_cfgReg **liveRegs;
+  /// Number of elements in the `liveRegs' array.
+  int numLiveRegs;
+  /// Memory of the blocks, of their nodes and of the registers, which is
+  /// released all together with the graph.
+  t_arena arena;
 };
 
 
@@ -145,10 +187,37 @@ void deleteCFG(t_cfg *graph);
 /// @name Data Flow Analysis
 /// @{
 
-/** Computes graph-level liveness information of temporary registers.
+/** Computes the liveness information of temporary registers, at the level
+ * of basic blocks.
  *  @param graph The control flow graph. */
 void cfgComputeLiveness(t_cfg *graph);
 
+/** Computes the number of loops which contain each basic block.
+ * A loop is recognized from a jump to a block which precedes the jump in
+ * program order, and contains all the blocks from the target of the jump up
+ * to the jump itself. This is exact for the structured control flow
+ * generated from the source language, where every loop is closed by a
+ * backward jump to its beginning.
+ *  @param graph The control flow graph. */
+void cfgComputeLoopDepths(t_cfg *graph);
+
+/** Computes the sets of temporary registers live at the entry and at the exit
+ * of each node of a basic block. Only valid after calling
+ * cfgComputeLiveness() on the graph.
+ * @param bblock   The basic block.
+ * @param context  The context pointer that will be passed to the callback
+ *                 function.
+ * @param callback The callback function that will be called for each node,
+ *                 from the last to the first one. The `in' and `out' sets
+ *                 are indexed by register identifier, and they are only
+ *                 valid until the callback returns.
+ *                 The callback can return a non-zero value to stop the
+ *                 iteration process.
+ * @returns The value returned by the last callback invocation. */
+int bbIterateNodesLiveness(t_basicBlock *bblock, void *context,
+    int (*callback)(t_bbNode *node, const t_bitset *in, const t_bitset *out,
+        void *context));
+
 /** Retrieve the list of live temporary registers entering the given block.
  * Only valid after calling cfgComputeLiveness() on the graph.
  * @param bblock The basic block.
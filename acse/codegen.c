@@ -503,8 +503,8 @@ t_regID genLoadArrayAddress(t_program *program, t_symbol *array, t_regID rIdx)
   t_label *label = array->label;
 
   // Generate a load of the base address using LA
-  t_regID rAddr = getNewRegister(program);
-  genLA(program, rAddr, label);
+  t_regID rBase = getNewRegister(program);
+  genLA(program, rBase, label);
 
   // Generate the code to compute the offset of the element in the array in
   // bytes. Assume the type is an integer (no other scalar types are supported).
@@ -518,8 +518,11 @@ t_regID genLoadArrayAddress(t_program *program, t_symbol *array, t_regID rIdx)
   }
 
   // Generate the code which computes the final address by summing the base
-  // address to the offset of the element.
-  genADD(program, rAddr, rAddr, rOffset);
+  // address to the offset of the element. The result goes to a new register,
+  // so that the base address is only defined once and the loop
+  // optimizations can move it out of loops.
+  t_regID rAddr = getNewRegister(program);
+  genADD(program, rAddr, rBase, rOffset);
   return rAddr;
 }
 
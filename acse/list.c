@@ -5,16 +5,21 @@
 #include <assert.h>
 #include "list.h"
 #include "errors.h"
+#include "arena.h"
 
+/* The nodes of all the lists. The `next' pointer is the first member of a
+ * node, therefore a whole list is also a chain of objects of the pool. */
+static t_pool listNodePool = POOL_INITIALIZER(t_listNode);
 
 static t_listNode *newListNode(void *data)
 {
-  t_listNode *result = (t_listNode *)malloc(sizeof(t_listNode));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_listNode *result = poolAlloc(&listNodePool);
   result->data = data;
   result->prev = NULL;
   result->next = NULL;
+  // A node by itself is a list of one element.
+  result->last = result;
+  result->length = 1;
   return result;
 }
 
@@ -23,19 +28,26 @@ static t_listNode *listInsertNodeAfter(
     t_listNode *list, t_listNode *listPos, t_listNode *newElem)
 {
   if (listPos == NULL) {
-    // Add at the beginning of the list.
+    // Add at the beginning of the list. The new head takes over the last
+    // node and the length of the list.
     if (list != NULL) {
       list->prev = newElem;
       newElem->next = list;
+      newElem->last = list->last;
+      newElem->length = list->length + 1;
     }
     return newElem;
   }
 
+  assert(list->prev == NULL && "prev link of head of list not NULL");
   newElem->next = listPos->next;
   newElem->prev = listPos;
   listPos->next = newElem;
   if (newElem->next)
     newElem->next->prev = newElem;
+  else
+    list->last = newElem;
+  list->length++;
 
   return list;
 }
@@ -52,9 +64,13 @@ t_listNode *listGetLastNode(t_listNode *list)
 {
   if (list == NULL)
     return NULL;
-  while (list->next != NULL)
-    list = list->next;
-  return list;
+  // Only the first node knows the last one.
+  if (list->prev != NULL) {
+    while (list->next != NULL)
+      list = list->next;
+    return list;
+  }
+  return list->last;
 }
 
 
@@ -158,6 +174,9 @@ t_listNode *listRemoveNode(t_listNode *list, t_listNode *element)
     element->prev->next = element->next;
     if (element->next != NULL)
       element->next->prev = element->prev;
+    else
+      list->last = element->prev;
+    list->length--;
   } else {
     // Head of the list.
     assert(list == element && "element to remove not belonging to the list");
@@ -167,11 +186,13 @@ t_listNode *listRemoveNode(t_listNode *list, t_listNode *element)
 
       // Update the new head of the list.
       list = element->next;
+      list->last = element->last;
+      list->length = element->length - 1;
     } else
       list = NULL;
   }
 
-  free(element);
+  poolFree(&listNodePool, element);
   // Return the new head of the list.
   return list;
 }
@@ -188,8 +209,8 @@ t_listNode *listFindAndRemove(t_listNode *list, void *data)
 
 t_listNode *deleteList(t_listNode *list)
 {
-  while (list != NULL)
-    list = listRemoveNode(list, list);
+  if (list != NULL)
+    poolFreeChain(&listNodePool, list, listGetLastNode(list));
   return NULL;
 }
 
@@ -213,12 +234,18 @@ int listNodePosition(t_listNode *list, t_listNode *element)
 
 int listLength(t_listNode *list)
 {
-  int counter = 0;
-  while (list != NULL) {
-    counter++;
-    list = list->next;
+  if (list == NULL)
+    return 0;
+  // Only the first node knows the length of the list.
+  if (list->prev != NULL) {
+    int counter = 0;
+    while (list != NULL) {
+      counter++;
+      list = list->next;
+    }
+    return counter;
   }
-  return counter;
+  return list->length;
 }
 
 
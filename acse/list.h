@@ -26,6 +26,14 @@
  * has no nodes, therefore it is represented by a pointer to NULL. All functions
  * that add/remove nodes from the list return a new head for the list, which
  * *must* replace the previous one.
+ *
+ * The first node of a list also records the last node and the length of the
+ * list, so that appending an element, finding the last node and computing the
+ * length take constant time. For this reason the nodes must only be linked
+ * and unlinked through these functions.
+ *
+ * The nodes are allocated from a pool shared by all the lists, which reuses
+ * the memory of the nodes removed.
  * @{
  */
 
@@ -42,6 +50,11 @@ typedef struct t_listNode {
   struct t_listNode *prev; ///< The previous element in the chain, if it
                            ///  exists, or NULL instead.
   void *data;              ///< Pointer to the data associated to this node.
+  struct t_listNode *last; ///< In the first node of a list, the last node
+                           ///  of the list. Not meaningful in the others.
+  int length;              ///< In the first node of a list, the number of
+                           ///  nodes in the list. Not meaningful in the
+                           ///  others.
 } t_listNode;
 
 
@@ -142,13 +155,13 @@ int listNodePosition(t_listNode *list, t_listNode *element);
  *          if it is too short for the position to be valid. */
 t_listNode *listGetNodeAt(t_listNode *list, unsigned int position);
 
-/** Retrieves the last element in a list.
+/** Retrieves the last element in a list. Takes constant time.
  * @param list The list where to find the element.
  * @returns The last element in the list, or NULL if the list is empty. */
 t_listNode *listGetLastNode(t_listNode *list);
 
 
-/** Find the size of a list.
+/** Find the size of a list. Takes constant time.
  * @param list A list.
  * @returns The number of elements in the list. */
 int listLength(t_listNode *list);
@@ -159,7 +172,7 @@ int listLength(t_listNode *list);
  *          in the same order as the given list. */
 t_listNode *listClone(t_listNode *list);
 
-/** Remove all the elements of a list.
+/** Remove all the elements of a list, in constant time.
  * @param list The list to be deleted.
  * @returns NULL. */
 t_listNode *deleteList(t_listNode *list);
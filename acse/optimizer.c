@@ -0,0 +1,1476 @@
+/// @file optimizer.c
+/// @brief Machine-independent optimizations of the program implementation
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "optimizer.h"
+#include "target_info.h"
+#include "list.h"
+#include "cfg.h"
+#include "errors.h"
+
+
+/** Kinds of values known for a register or for a memory word. */
+typedef enum {
+  OPT_UNKNOWN,  ///< Nothing is known about the value.
+  OPT_CONSTANT, ///< The value is a constant.
+  OPT_ADDRESS,  ///< The value is the address of a label (registers only).
+  /// The value is an address inside the array at a label (registers only).
+  OPT_ELEMENT,
+  OPT_REGISTER  ///< The value is held in another register.
+} t_optValueKind;
+
+/** Value of a register or of the memory word at a label, as known at the
+ * current point of the program. */
+typedef struct {
+  /// Epoch when the value was computed. Values from older epochs are
+  /// unknown.
+  unsigned int epoch;
+  t_optValueKind kind;
+  /// The constant, for OPT_CONSTANT values.
+  int constant;
+  /// The label, for OPT_ADDRESS and OPT_ELEMENT values.
+  t_label *label;
+  /// The register holding the value, for OPT_REGISTER values.
+  t_regID reg;
+  /// Version of the register holding the value. The value is not held there
+  /// anymore if the register was defined again in the meantime.
+  unsigned int version;
+} t_optValue;
+
+/** State of the constant propagation. The values are tracked only within
+ * a basic block: a new epoch starts at each label, which forgets all of
+ * them at once. The values of the memory words are also forgotten at each
+ * store whose address is not known. */
+typedef struct {
+  t_optStats *stats;
+  /// Epoch counter.
+  unsigned int lastEpoch;
+  /// Epoch of the values of the registers.
+  unsigned int regEpoch;
+  /// Epoch of the values of the memory words.
+  unsigned int memEpoch;
+  /// Values of the registers, indexed by register identifier.
+  t_optValue *regs;
+  /// Number of definitions of each register, indexed by register identifier.
+  unsigned int *regVersions;
+  /// Values of the memory words at each label, indexed by label identifier.
+  t_optValue *memory;
+} t_optState;
+
+/** A loop, as the range of the basic blocks from its beginning to the last
+ * block which jumps back to it, in program order. */
+typedef struct {
+  int header; ///< Index of the first block of the loop.
+  int last;   ///< Index of the last block of the loop.
+} t_optLoop;
+
+/** State of the motion of the invariant code out of loops. */
+typedef struct {
+  t_program *program;
+  t_optStats *stats;
+  /// Execution counts of a previous run of the program, or NULL.
+  const t_profile *profile;
+  /// CFG of the program.
+  t_cfg *graph;
+  /// Number of executions of each block in the profile, indexed by its
+  /// `livenessIndex', or NULL if there is no profile.
+  double *blockCounts;
+  /// Blocks of the CFG of the program, in program order.
+  t_basicBlock **blocks;
+  /// Node of the first instruction of each block in the instruction list of
+  /// the program, indexed like `blocks'.
+  t_listNode **firstNodes;
+  /// Whether the instructions of a block were changed since the CFG was
+  /// built, indexed like `blocks'.
+  bool *changedBlocks;
+  /// Number of definitions of each register in the program.
+  int *numDefs;
+  /// Number of definitions of each register in the current loop, not
+  /// counting the invariant ones.
+  int *numLoopDefs;
+  /// Register which replaces each register in the whole program, because
+  /// the other register is loaded with the same value, or REG_INVALID.
+  t_regID *renames;
+} t_licmState;
+
+
+/* Returns whether an opcode is an arithmetic or comparison operation between
+ * two registers. */
+static bool isRegisterOperation(int opcode)
+{
+  return (opcode >= OPC_ADD && opcode <= OPC_SRA) ||
+      (opcode >= OPC_SEQ && opcode <= OPC_SLEU);
+}
+
+/* Returns whether an opcode is an arithmetic or comparison operation between
+ * a register and the immediate. */
+static bool isImmediateOperation(int opcode)
+{
+  return (opcode >= OPC_ADDI && opcode <= OPC_SRAI) ||
+      (opcode >= OPC_SEQI && opcode <= OPC_SLEIU);
+}
+
+/* Returns whether an instruction only computes the value of its destination
+ * register, and can be removed if the value is not used. */
+static bool isPureInstruction(t_instruction *instr)
+{
+  return isRegisterOperation(instr->opcode) ||
+      isImmediateOperation(instr->opcode) || instr->opcode == OPC_LI ||
+      instr->opcode == OPC_LA;
+}
+
+/* Returns the opcode which performs the same operation as a register to
+ * register opcode, with the operand in rs2 replaced by the immediate. If
+ * `swapped' is true, the operand replaced is the one in rs1 instead, and
+ * rs2 becomes the register operand. Returns -1 if there is no such opcode. */
+static int getImmediateOpcode(int opcode, bool swapped)
+{
+  switch (opcode) {
+    case OPC_ADD:
+      return OPC_ADDI;
+    case OPC_SUB:
+      return swapped ? -1 : OPC_SUBI;
+    case OPC_AND:
+      return OPC_ANDI;
+    case OPC_OR:
+      return OPC_ORI;
+    case OPC_XOR:
+      return OPC_XORI;
+    case OPC_MUL:
+      return OPC_MULI;
+    case OPC_DIV:
+      return swapped ? -1 : OPC_DIVI;
+    case OPC_REM:
+      return swapped ? -1 : OPC_REMI;
+    case OPC_SLL:
+      return swapped ? -1 : OPC_SLLI;
+    case OPC_SRL:
+      return swapped ? -1 : OPC_SRLI;
+    case OPC_SRA:
+      return swapped ? -1 : OPC_SRAI;
+    case OPC_SEQ:
+      return OPC_SEQI;
+    case OPC_SNE:
+      return OPC_SNEI;
+    case OPC_SLT:
+      return swapped ? OPC_SGTI : OPC_SLTI;
+    case OPC_SLTU:
+      return swapped ? OPC_SGTIU : OPC_SLTIU;
+    case OPC_SGE:
+      return swapped ? OPC_SLEI : OPC_SGEI;
+    case OPC_SGEU:
+      return swapped ? OPC_SLEIU : OPC_SGEIU;
+    case OPC_SGT:
+      return swapped ? OPC_SLTI : OPC_SGTI;
+    case OPC_SGTU:
+      return swapped ? OPC_SLTIU : OPC_SGTIU;
+    case OPC_SLE:
+      return swapped ? OPC_SGEI : OPC_SLEI;
+    case OPC_SLEU:
+      return swapped ? OPC_SGEIU : OPC_SLEIU;
+  }
+  return -1;
+}
+
+/* Returns whether an operation with the immediate is better than the same
+ * operation with the constant in a register. The target computes the
+ * multiplications and divisions, and the operations with an immediate which
+ * does not fit in 12 bits, with the constant loaded in a register anyway:
+ * keeping the register allows to load it once out of a loop. */
+static bool isUsefulImmediate(int opcode, int imm)
+{
+  uint32_t uimm = (uint32_t)imm;
+  switch (opcode) {
+    case OPC_MULI:
+      return (imm >= -1 && imm <= 1) || (uimm & (uimm - 1)) == 0;
+    case OPC_DIVI:
+    case OPC_REMI:
+      return imm == 1 || imm == -1;
+    case OPC_SLLI:
+    case OPC_SRLI:
+    case OPC_SRAI:
+      return true;
+  }
+  // The lowering may negate the immediate or add one to it.
+  return imm > -(1 << 11) && imm < (1 << 11) - 1;
+}
+
+/* Computes the result of an arithmetic or comparison operation with the
+ * semantics of the target machine. `b' is either the value of rs2 or the
+ * immediate. Returns false if the operation is not folded. */
+static bool evaluateOperation(int opcode, int a, int b, int *result)
+{
+  uint32_t ua = (uint32_t)a, ub = (uint32_t)b;
+  switch (opcode) {
+    case OPC_ADD:
+    case OPC_ADDI:
+      *result = (int)(ua + ub);
+      return true;
+    case OPC_SUB:
+    case OPC_SUBI:
+      *result = (int)(ua - ub);
+      return true;
+    case OPC_AND:
+    case OPC_ANDI:
+      *result = a & b;
+      return true;
+    case OPC_OR:
+    case OPC_ORI:
+      *result = a | b;
+      return true;
+    case OPC_XOR:
+    case OPC_XORI:
+      *result = a ^ b;
+      return true;
+    case OPC_MUL:
+    case OPC_MULI:
+      *result = (int)(ua * ub);
+      return true;
+    case OPC_DIV:
+    case OPC_DIVI:
+    case OPC_REM:
+    case OPC_REMI:
+      // Divisions by zero are left to be computed at run time.
+      if (b == 0)
+        return false;
+      if (a == INT32_MIN && b == -1)
+        *result = (opcode == OPC_DIV || opcode == OPC_DIVI) ? INT32_MIN : 0;
+      else if (opcode == OPC_DIV || opcode == OPC_DIVI)
+        *result = a / b;
+      else
+        *result = a % b;
+      return true;
+    case OPC_SLL:
+    case OPC_SLLI:
+      *result = (int)(ua << (ub & 0x1F));
+      return true;
+    case OPC_SRL:
+    case OPC_SRLI:
+      *result = (int)(ua >> (ub & 0x1F));
+      return true;
+    case OPC_SRA:
+    case OPC_SRAI:
+      *result = a >> (ub & 0x1F);
+      return true;
+    case OPC_SEQ:
+    case OPC_SEQI:
+      *result = a == b;
+      return true;
+    case OPC_SNE:
+    case OPC_SNEI:
+      *result = a != b;
+      return true;
+    case OPC_SLT:
+    case OPC_SLTI:
+      *result = a < b;
+      return true;
+    case OPC_SLTU:
+    case OPC_SLTIU:
+      *result = ua < ub;
+      return true;
+    case OPC_SGE:
+    case OPC_SGEI:
+      *result = a >= b;
+      return true;
+    case OPC_SGEU:
+    case OPC_SGEIU:
+      *result = ua >= ub;
+      return true;
+    case OPC_SGT:
+    case OPC_SGTI:
+      *result = a > b;
+      return true;
+    case OPC_SGTU:
+    case OPC_SGTIU:
+      *result = ua > ub;
+      return true;
+    case OPC_SLE:
+    case OPC_SLEI:
+      *result = a <= b;
+      return true;
+    case OPC_SLEU:
+    case OPC_SLEIU:
+      *result = ua <= ub;
+      return true;
+  }
+  return false;
+}
+
+
+/* Rewrites an instruction to `li rd, value'. */
+static void rewriteToLI(t_instruction *instr, int value)
+{
+  instr->opcode = OPC_LI;
+  deleteInstrArg(instr->rSrc1);
+  instr->rSrc1 = NULL;
+  deleteInstrArg(instr->rSrc2);
+  instr->rSrc2 = NULL;
+  instr->addressParam = NULL;
+  instr->immediate = value;
+}
+
+/* Rewrites an instruction to an operation between the register in `rs' and
+ * the immediate. The other source register is removed. */
+static void rewriteToImmediate(
+    t_instruction *instr, int opcode, t_instrArg *rs, int immediate)
+{
+  if (rs == instr->rSrc2) {
+    deleteInstrArg(instr->rSrc1);
+    instr->rSrc1 = instr->rSrc2;
+    instr->rSrc2 = NULL;
+  } else {
+    deleteInstrArg(instr->rSrc2);
+    instr->rSrc2 = NULL;
+  }
+  instr->opcode = opcode;
+  instr->addressParam = NULL;
+  instr->immediate = immediate;
+}
+
+/* Rewrites an instruction to a copy of the given register. */
+static void rewriteToMove(t_instruction *instr, t_regID rs)
+{
+  deleteInstrArg(instr->rSrc2);
+  instr->rSrc2 = NULL;
+  if (instr->rSrc1 == NULL)
+    instr->rSrc1 = newInstrArg(rs);
+  else
+    instr->rSrc1->ID = rs;
+  instr->opcode = OPC_ADDI;
+  instr->addressParam = NULL;
+  instr->immediate = 0;
+}
+
+/* Returns whether an instruction is a copy of its source register. */
+static bool isMoveInstruction(t_instruction *instr)
+{
+  return instr->opcode == OPC_ADDI && instr->immediate == 0;
+}
+
+/* Simplifies an operation whose two operands are the same register.
+ * Returns true if the instruction was modified. */
+static bool simplifySameOperands(t_instruction *instr)
+{
+  switch (instr->opcode) {
+    case OPC_SUB:
+    case OPC_XOR:
+    case OPC_SNE:
+    case OPC_SLT:
+    case OPC_SLTU:
+    case OPC_SGT:
+    case OPC_SGTU:
+      rewriteToLI(instr, 0);
+      return true;
+    case OPC_SEQ:
+    case OPC_SGE:
+    case OPC_SGEU:
+    case OPC_SLE:
+    case OPC_SLEU:
+      rewriteToLI(instr, 1);
+      return true;
+    case OPC_AND:
+    case OPC_OR:
+      rewriteToMove(instr, instr->rSrc1->ID);
+      return true;
+  }
+  return false;
+}
+
+/* Applies the algebraic identities to an operation between a register and
+ * the immediate. Returns true if the instruction was modified. */
+static bool simplifyImmediateOperation(t_instruction *instr)
+{
+  int imm = instr->immediate;
+  uint32_t uimm = (uint32_t)imm;
+
+  switch (instr->opcode) {
+    case OPC_SUBI:
+    case OPC_ORI:
+    case OPC_XORI:
+      if (imm == 0) {
+        rewriteToMove(instr, instr->rSrc1->ID);
+        return true;
+      }
+      if (instr->opcode == OPC_ORI && imm == -1) {
+        rewriteToLI(instr, -1);
+        return true;
+      }
+      break;
+    case OPC_SLLI:
+    case OPC_SRLI:
+    case OPC_SRAI:
+      if ((uimm & 0x1F) == 0) {
+        rewriteToMove(instr, instr->rSrc1->ID);
+        return true;
+      }
+      break;
+    case OPC_ANDI:
+      if (imm == 0) {
+        rewriteToLI(instr, 0);
+        return true;
+      }
+      if (imm == -1) {
+        rewriteToMove(instr, instr->rSrc1->ID);
+        return true;
+      }
+      break;
+    case OPC_MULI:
+    case OPC_DIVI:
+      if (imm == 1) {
+        rewriteToMove(instr, instr->rSrc1->ID);
+        return true;
+      }
+      if (imm == -1) {
+        // 0 - x, which also matches the result of INT32_MIN / -1.
+        instr->opcode = OPC_SUB;
+        instr->rSrc2 = instr->rSrc1;
+        instr->rSrc1 = newInstrArg(REG_0);
+        return true;
+      }
+      if (instr->opcode == OPC_MULI && imm == 0) {
+        rewriteToLI(instr, 0);
+        return true;
+      }
+      // Multiplications by a power of two become shifts.
+      if (instr->opcode == OPC_MULI && uimm != 0 && (uimm & (uimm - 1)) == 0) {
+        instr->opcode = OPC_SLLI;
+        instr->immediate = __builtin_ctz(uimm);
+        return true;
+      }
+      break;
+    case OPC_REMI:
+      if (imm == 1 || imm == -1) {
+        rewriteToLI(instr, 0);
+        return true;
+      }
+      break;
+  }
+  return false;
+}
+
+
+static t_optValue getRegValue(t_optState *state, t_regID reg)
+{
+  t_optValue res = {0};
+  if (TARGET_REG_ZERO_IS_CONST && reg == REG_0) {
+    res.kind = OPT_CONSTANT;
+    return res;
+  }
+  t_optValue *value = &state->regs[reg];
+  if (value->epoch != state->regEpoch)
+    return res;
+  if (value->kind == OPT_REGISTER &&
+      state->regVersions[value->reg] != value->version)
+    return res;
+  return *value;
+}
+
+/* Returns the value of a register, or if it is not known the fact that it
+ * is held in the register. This is the value of a copy of the register. */
+static t_optValue getCopiedValue(t_optState *state, t_regID reg)
+{
+  t_optValue value = getRegValue(state, reg);
+  if (value.kind == OPT_UNKNOWN) {
+    value.kind = OPT_REGISTER;
+    value.reg = reg;
+    value.version = state->regVersions[reg];
+  }
+  return value;
+}
+
+/* Returns the register which holds the original of a copied value. */
+static t_regID getOriginalRegister(t_optState *state, t_regID reg)
+{
+  t_optValue value = getRegValue(state, reg);
+  if (value.kind == OPT_REGISTER)
+    return value.reg;
+  return reg;
+}
+
+static void setRegValue(t_optState *state, t_regID reg, t_optValue value)
+{
+  if (TARGET_REG_ZERO_IS_CONST && reg == REG_0)
+    return;
+  state->regVersions[reg]++;
+  value.epoch = state->regEpoch;
+  state->regs[reg] = value;
+}
+
+static t_optValue getMemoryValue(t_optState *state, t_label *label)
+{
+  t_optValue res = {0};
+  t_optValue *value = &state->memory[label->labelID];
+  if (value->epoch != state->memEpoch)
+    return res;
+  if (value->kind == OPT_REGISTER &&
+      state->regVersions[value->reg] != value->version)
+    return res;
+  return *value;
+}
+
+static void setMemoryValue(t_optState *state, t_label *label, t_regID reg)
+{
+  t_optValue value = getCopiedValue(state, reg);
+  if (value.kind == OPT_ADDRESS) {
+    value.kind = OPT_REGISTER;
+    value.reg = reg;
+    value.version = state->regVersions[reg];
+  }
+  value.epoch = state->memEpoch;
+  state->memory[label->labelID] = value;
+}
+
+/* Returns the label whose memory word is accessed by a load or a store, or
+ * NULL if it is not known. */
+static t_label *getAccessedLabel(t_optState *state, t_instruction *instr)
+{
+  if (instr->opcode == OPC_LW_G || instr->opcode == OPC_SW_G)
+    return instr->addressParam;
+  if (instr->immediate != 0)
+    return NULL;
+  t_optValue addr = getRegValue(state, instr->rSrc1->ID);
+  if (addr.kind != OPT_ADDRESS)
+    return NULL;
+  return addr.label;
+}
+
+/* Folds and simplifies the arithmetic and comparison instructions. */
+static void optimizeOperation(t_optState *state, t_instruction *instr)
+{
+  if (isRegisterOperation(instr->opcode)) {
+    t_optValue a = getRegValue(state, instr->rSrc1->ID);
+    t_optValue b = getRegValue(state, instr->rSrc2->ID);
+    int result, opcode;
+    if (a.kind == OPT_CONSTANT && b.kind == OPT_CONSTANT &&
+        evaluateOperation(instr->opcode, a.constant, b.constant, &result)) {
+      rewriteToLI(instr, result);
+      state->stats->numFolded++;
+      return;
+    }
+    if (b.kind == OPT_CONSTANT &&
+        (opcode = getImmediateOpcode(instr->opcode, false)) >= 0 &&
+        isUsefulImmediate(opcode, b.constant)) {
+      rewriteToImmediate(instr, opcode, instr->rSrc1, b.constant);
+      state->stats->numSimplified++;
+    } else if (a.kind == OPT_CONSTANT &&
+        (opcode = getImmediateOpcode(instr->opcode, true)) >= 0 &&
+        isUsefulImmediate(opcode, a.constant)) {
+      rewriteToImmediate(instr, opcode, instr->rSrc2, a.constant);
+      state->stats->numSimplified++;
+    } else if (instr->rSrc1->ID == instr->rSrc2->ID) {
+      if (simplifySameOperands(instr))
+        state->stats->numSimplified++;
+      return;
+    }
+  }
+
+  if (isImmediateOperation(instr->opcode)) {
+    t_optValue a = getRegValue(state, instr->rSrc1->ID);
+    int result;
+    if (a.kind == OPT_CONSTANT &&
+        evaluateOperation(instr->opcode, a.constant, instr->immediate,
+            &result)) {
+      rewriteToLI(instr, result);
+      state->stats->numFolded++;
+    } else if (!isMoveInstruction(instr) &&
+        simplifyImmediateOperation(instr)) {
+      state->stats->numSimplified++;
+    }
+  }
+}
+
+/* Optimizes an instruction and updates the known values with its effects. */
+static void optimizeInstruction(t_optState *state, t_instruction *instr)
+{
+  // A label may be reached from other blocks, where the values are not the
+  // same.
+  if (instr->label != NULL) {
+    state->regEpoch = state->memEpoch = ++state->lastEpoch;
+  }
+
+  // Read the copied values from the original registers, so that the copies
+  // may become unused.
+  if (instr->rSrc1 != NULL)
+    instr->rSrc1->ID = getOriginalRegister(state, instr->rSrc1->ID);
+  if (instr->rSrc2 != NULL)
+    instr->rSrc2->ID = getOriginalRegister(state, instr->rSrc2->ID);
+
+  optimizeOperation(state, instr);
+
+  t_optValue value = {0};
+  t_label *label;
+  switch (instr->opcode) {
+    case OPC_LI:
+      value.kind = OPT_CONSTANT;
+      value.constant = instr->immediate;
+      break;
+    case OPC_LA:
+      value.kind = OPT_ADDRESS;
+      value.label = instr->addressParam;
+      break;
+    case OPC_LW:
+    case OPC_LW_G:
+      label = getAccessedLabel(state, instr);
+      if (label == NULL)
+        break;
+      value = getMemoryValue(state, label);
+      if (value.kind == OPT_CONSTANT) {
+        rewriteToLI(instr, value.constant);
+        state->stats->numPropagated++;
+      } else if (value.kind == OPT_REGISTER) {
+        rewriteToMove(instr, value.reg);
+        state->stats->numPropagated++;
+        value = getCopiedValue(state, value.reg);
+      } else {
+        // The loaded register now holds the value of the memory word.
+        setRegValue(state, instr->rDest->ID, value);
+        setMemoryValue(state, label, instr->rDest->ID);
+        return;
+      }
+      break;
+    case OPC_SW:
+    case OPC_SW_G:
+      label = getAccessedLabel(state, instr);
+      if (label == NULL && instr->opcode == OPC_SW &&
+          getRegValue(state, instr->rSrc1->ID).kind == OPT_ELEMENT) {
+        // Only the array may have been overwritten, as the elements of an
+        // array are always accessed through its address.
+        label = getRegValue(state, instr->rSrc1->ID).label;
+        state->memory[label->labelID].epoch = 0;
+      } else if (label == NULL) {
+        // Any variable may have been overwritten.
+        state->memEpoch = ++state->lastEpoch;
+      } else if (instr->opcode == OPC_SW) {
+        setMemoryValue(state, label, instr->rSrc2->ID);
+      } else {
+        setMemoryValue(state, label, instr->rSrc1->ID);
+      }
+      break;
+    default:
+      if (isMoveInstruction(instr)) {
+        value = getCopiedValue(state, instr->rSrc1->ID);
+      } else if (instr->opcode == OPC_ADD || instr->opcode == OPC_ADDI) {
+        // Track the addresses of the elements of the arrays.
+        t_optValue base = getRegValue(state, instr->rSrc1->ID);
+        if (instr->opcode == OPC_ADD && base.kind != OPT_ADDRESS &&
+            base.kind != OPT_ELEMENT)
+          base = getRegValue(state, instr->rSrc2->ID);
+        if (base.kind == OPT_ADDRESS || base.kind == OPT_ELEMENT) {
+          value.kind = OPT_ELEMENT;
+          value.label = base.label;
+        }
+      }
+      break;
+  }
+
+  if (instr->rDest != NULL)
+    setRegValue(state, instr->rDest->ID, value);
+}
+
+/* Inserts a list of new instructions at the beginning of the program. The
+ * entry point is moved to the first of them, while the jumps to the old first
+ * instruction are redirected to a new label. */
+static void insertAtProgramStart(t_program *program, t_listNode *instrs)
+{
+  t_instruction *oldFirst = (t_instruction *)program->instructions->data;
+  t_instruction *newFirst = (t_instruction *)instrs->data;
+  for (t_listNode *curNode = listGetLastNode(instrs); curNode != NULL;
+       curNode = curNode->prev) {
+    t_instruction *instr = (t_instruction *)curNode->data;
+    instr->source = oldFirst->source;
+    program->instructions = listInsert(program->instructions, instr, 0);
+  }
+
+  t_label *oldLabel = oldFirst->label;
+  if (oldLabel == NULL)
+    return;
+  t_label *newLabel = createLabel(program);
+  program->labelIDs[newLabel->labelID].assigned = true;
+  newFirst->label = oldLabel;
+  oldFirst->label = newLabel;
+  for (t_listNode *curNode = program->instructions; curNode != NULL;
+       curNode = curNode->next) {
+    t_instruction *instr = (t_instruction *)curNode->data;
+    if (isJumpInstruction(instr) &&
+        instr->addressParam->labelID == oldLabel->labelID)
+      instr->addressParam = newLabel;
+  }
+}
+
+/* Keeps the scalar variables in registers for the whole program, instead of
+ * loading them from memory at each use and storing them at each assignment.
+ * There are no function calls, and the address of a scalar variable is only
+ * used to load or store its value, so the memory is observed only when the
+ * program exits: the variables which were assigned are written back there. */
+static void promoteScalarVariables(t_program *program, t_optStats *stats)
+{
+  t_regID numRegs = program->firstUnusedReg;
+  unsigned int numLabels = program->firstUnusedLblID;
+  int *numDefs = calloc((size_t)numRegs, sizeof(int));
+  int *numUses = calloc((size_t)numRegs, sizeof(int));
+  // Label of the variable whose address is loaded in each register.
+  t_label **varAddrs = calloc((size_t)numRegs, sizeof(t_label *));
+  // Register which holds each variable, indexed by label identifier. It is
+  // REG_INVALID for the labels which cannot be promoted, and REG_0 for the
+  // variables until their register is allocated.
+  t_regID *varRegs = malloc(sizeof(t_regID) * (numLabels + 1));
+  bool *varStored = calloc(numLabels + 1, sizeof(bool));
+  if (!numDefs || !numUses || !varAddrs || !varRegs || !varStored)
+    fatalError("out of memory");
+  for (unsigned int i = 0; i <= numLabels; i++)
+    varRegs[i] = REG_INVALID;
+  for (t_listNode *curNode = program->symbols; curNode != NULL;
+       curNode = curNode->next) {
+    t_symbol *var = (t_symbol *)curNode->data;
+    if (var->type == TYPE_INT)
+      varRegs[var->label->labelID] = REG_0;
+  }
+
+  // Find the registers loaded with the address of a variable. Any other
+  // reference to the label of a variable prevents its promotion.
+  t_listNode *curNode = program->instructions;
+  for (; curNode != NULL; curNode = curNode->next) {
+    t_instruction *instr = (t_instruction *)curNode->data;
+    if (instr->rSrc1 != NULL)
+      numUses[instr->rSrc1->ID]++;
+    if (instr->rSrc2 != NULL)
+      numUses[instr->rSrc2->ID]++;
+    if (instr->rDest != NULL)
+      numDefs[instr->rDest->ID]++;
+    if (instr->addressParam == NULL || isJumpInstruction(instr))
+      continue;
+    unsigned int labelID = instr->addressParam->labelID;
+    if (instr->opcode != OPC_LA || instr->rDest->ID == REG_0)
+      varRegs[labelID] = REG_INVALID;
+    else if (varRegs[labelID] != REG_INVALID)
+      varAddrs[instr->rDest->ID] = instr->addressParam;
+  }
+
+  // The addresses must only be used as the base of the loads and stores of
+  // the value of the variable.
+  for (curNode = program->instructions; curNode != NULL;
+       curNode = curNode->next) {
+    t_instruction *instr = (t_instruction *)curNode->data;
+    t_instrArg *args[3] = {instr->rDest, instr->rSrc1, instr->rSrc2};
+    for (int i = 0; i < 3; i++) {
+      if (args[i] == NULL || varAddrs[args[i]->ID] == NULL)
+        continue;
+      t_label *label = varAddrs[args[i]->ID];
+      bool isAccess = i == 1 && instr->immediate == 0 &&
+          (instr->opcode == OPC_LW || instr->opcode == OPC_SW);
+      bool isDef = i == 0 && instr->opcode == OPC_LA;
+      if ((!isAccess && !isDef) || numDefs[args[i]->ID] != 1)
+        varRegs[label->labelID] = REG_INVALID;
+      if (isAccess && instr->opcode == OPC_SW)
+        varStored[label->labelID] = true;
+    }
+  }
+
+  t_listNode *inits = NULL;
+  for (t_listNode *curVar = program->symbols; curVar != NULL;
+       curVar = curVar->next) {
+    t_symbol *var = (t_symbol *)curVar->data;
+    unsigned int labelID = var->label->labelID;
+    if (var->type != TYPE_INT || varRegs[labelID] == REG_INVALID)
+      continue;
+    // The variables start from zero, as in the data segment.
+    varRegs[labelID] = getNewRegister(program);
+    inits = listInsert(inits,
+        genInstruction(NULL, OPC_LI, varRegs[labelID], REG_INVALID,
+            REG_INVALID, NULL, 0),
+        -1);
+    stats->numPromoted++;
+  }
+  if (inits == NULL) {
+    free(numDefs);
+    free(numUses);
+    free(varAddrs);
+    free(varRegs);
+    free(varStored);
+    return;
+  }
+
+  // Replace the loads with copies of the register of the variable, and the
+  // stores with copies to it. When the stored value is computed just before
+  // only to be stored, it is computed in the register of the variable instead.
+  curNode = program->instructions;
+  while (curNode != NULL) {
+    t_listNode *nextNode = curNode->next;
+    t_instruction *instr = (t_instruction *)curNode->data;
+    t_label *label = NULL;
+    if (instr->rSrc1 != NULL && instr->rSrc1->ID < numRegs)
+      label = varAddrs[instr->rSrc1->ID];
+    if (instr->opcode == OPC_LA && varAddrs[instr->rDest->ID] &&
+        varRegs[instr->addressParam->labelID] != REG_INVALID) {
+      removeInstructionAt(program, curNode);
+    } else if (label == NULL || varRegs[label->labelID] == REG_INVALID) {
+      // Not an access to a promoted variable.
+    } else if (instr->opcode == OPC_LW) {
+      rewriteToMove(instr, varRegs[label->labelID]);
+    } else {
+      t_regID rValue = instr->rSrc2->ID;
+      t_instruction *prev =
+          curNode->prev ? (t_instruction *)curNode->prev->data : NULL;
+      if (prev && !instr->label && prev->rDest &&
+          prev->rDest->ID == rValue && rValue != REG_0 &&
+          numDefs[rValue] == 1 && numUses[rValue] == 1) {
+        prev->rDest->ID = varRegs[label->labelID];
+        removeInstructionAt(program, curNode);
+      } else {
+        instr->rDest = newInstrArg(varRegs[label->labelID]);
+        rewriteToMove(instr, rValue);
+      }
+    }
+    curNode = nextNode;
+  }
+
+  // Write back the variables which were assigned before each exit.
+  for (curNode = program->instructions; curNode != NULL;
+       curNode = curNode->next) {
+    t_instruction *exitInstr = (t_instruction *)curNode->data;
+    if (!isExitInstruction(exitInstr))
+      continue;
+    t_instruction *first = NULL;
+    for (t_listNode *curVar = program->symbols; curVar != NULL;
+         curVar = curVar->next) {
+      t_symbol *var = (t_symbol *)curVar->data;
+      unsigned int labelID = var->label->labelID;
+      if (var->type != TYPE_INT || varRegs[labelID] == REG_INVALID ||
+          !varStored[labelID])
+        continue;
+      t_regID rAddr = getNewRegister(program);
+      t_instruction *la = genInstruction(
+          NULL, OPC_LA, rAddr, REG_INVALID, REG_INVALID, var->label, 0);
+      t_instruction *sw = genInstruction(
+          NULL, OPC_SW, REG_INVALID, rAddr, varRegs[labelID], NULL, 0);
+      la->source = sw->source = exitInstr->source;
+      program->instructions =
+          listInsertBefore(program->instructions, curNode, la);
+      program->instructions =
+          listInsertBefore(program->instructions, curNode, sw);
+      if (first == NULL)
+        first = la;
+    }
+    if (first != NULL) {
+      first->label = exitInstr->label;
+      exitInstr->label = NULL;
+    }
+  }
+
+  insertAtProgramStart(program, inits);
+  deleteList(inits);
+  free(numDefs);
+  free(numUses);
+  free(varAddrs);
+  free(varRegs);
+  free(varStored);
+}
+
+/* Performs constant folding and propagation through the registers and
+ * the variables, and simplifies the operations with constant operands. */
+static void propagateConstants(t_program *program, t_optStats *stats)
+{
+  t_optState state;
+  state.stats = stats;
+  state.lastEpoch = state.regEpoch = state.memEpoch = 1;
+  state.regs = calloc((size_t)program->firstUnusedReg, sizeof(t_optValue));
+  state.regVersions =
+      calloc((size_t)program->firstUnusedReg, sizeof(unsigned int));
+  state.memory =
+      calloc((size_t)program->firstUnusedLblID + 1, sizeof(t_optValue));
+  if (!state.regs || !state.regVersions || !state.memory)
+    fatalError("out of memory");
+
+  t_listNode *curNode = program->instructions;
+  while (curNode != NULL) {
+    optimizeInstruction(&state, (t_instruction *)curNode->data);
+    curNode = curNode->next;
+  }
+
+  free(state.regs);
+  free(state.regVersions);
+  free(state.memory);
+}
+
+/* Removes the instructions which compute a value that is never used,
+ * for example the constants which were folded into other instructions. */
+static void removeUnusedResults(t_program *program, t_optStats *stats)
+{
+  int *numUses = calloc((size_t)program->firstUnusedReg, sizeof(int));
+  if (numUses == NULL)
+    fatalError("out of memory");
+
+  t_listNode *curNode = program->instructions;
+  while (curNode != NULL) {
+    t_instruction *instr = (t_instruction *)curNode->data;
+    if (instr->rSrc1 != NULL)
+      numUses[instr->rSrc1->ID]++;
+    if (instr->rSrc2 != NULL)
+      numUses[instr->rSrc2->ID]++;
+    curNode = curNode->next;
+  }
+
+  // Proceed backwards, so that the definitions of the operands of a removed
+  // instruction are usually examined after it.
+  curNode = listGetLastNode(program->instructions);
+  while (curNode != NULL) {
+    t_listNode *prevNode = curNode->prev;
+    t_instruction *instr = (t_instruction *)curNode->data;
+    if (isPureInstruction(instr) && instr->rDest != NULL &&
+        (instr->rDest->ID == REG_0 || numUses[instr->rDest->ID] == 0)) {
+      if (instr->rSrc1 != NULL)
+        numUses[instr->rSrc1->ID]--;
+      if (instr->rSrc2 != NULL)
+        numUses[instr->rSrc2->ID]--;
+      removeInstructionAt(program, curNode);
+      stats->numRemoved++;
+    }
+    curNode = prevNode;
+  }
+
+  free(numUses);
+}
+
+/* Returns the index of a block of the CFG, numbered by findLoops() or by
+ * removeDeadCode(). */
+static int getBlockIndex(t_basicBlock *block)
+{
+  return block->loopDepth;
+}
+
+/* Changes the destination of the jumps to the labels with a replacement in
+ * `redirects', indexed by label identifier. */
+static void redirectJumps(t_program *program, t_label **redirects)
+{
+  for (t_listNode *curNode = program->instructions; curNode != NULL;
+       curNode = curNode->next) {
+    t_instruction *instr = (t_instruction *)curNode->data;
+    if (!isJumpInstruction(instr))
+      continue;
+    while (redirects[instr->addressParam->labelID] != NULL)
+      instr->addressParam = redirects[instr->addressParam->labelID];
+  }
+}
+
+/* Kinds of instructions found by removeDeadCode(). */
+typedef enum {
+  DCE_LIVE,       ///< The instruction is needed.
+  DCE_DEAD,       ///< The result of the instruction is never used.
+  DCE_UNREACHABLE ///< The instruction is never executed.
+} t_dceKind;
+
+/* Marks the instructions of the blocks which cannot be reached from the
+ * beginning of the program, indexed in program order. */
+static void findUnreachableCode(t_cfg *graph, t_basicBlock **blocks,
+    int numBlocks, const int *firstIndex, t_dceKind *kinds)
+{
+  bool *reached = calloc((size_t)numBlocks + 1, sizeof(bool));
+  t_basicBlock **stack =
+      malloc(sizeof(t_basicBlock *) * (size_t)(numBlocks + 1));
+  if (reached == NULL || stack == NULL)
+    fatalError("out of memory");
+  int stackSize = 0;
+  if (numBlocks > 0) {
+    reached[0] = true;
+    stack[stackSize++] = blocks[0];
+  }
+  while (stackSize > 0) {
+    t_basicBlock *block = stack[--stackSize];
+    for (t_listNode *curNode = block->succ; curNode != NULL;
+         curNode = curNode->next) {
+      t_basicBlock *succ = (t_basicBlock *)curNode->data;
+      if (succ == graph->endingBlock || reached[getBlockIndex(succ)])
+        continue;
+      reached[getBlockIndex(succ)] = true;
+      stack[stackSize++] = succ;
+    }
+  }
+
+  for (int i = 0; i < numBlocks; i++) {
+    if (reached[i])
+      continue;
+    for (int k = firstIndex[i]; k < firstIndex[i + 1]; k++)
+      kinds[k] = DCE_UNREACHABLE;
+  }
+  free(reached);
+  free(stack);
+}
+
+/* Marks the instructions of a block whose result is not live after them,
+ * walking the block backwards from the registers live at its exit. The
+ * marked nodes are detached from their registers, so that they are ignored
+ * when the liveness is computed again. The set `live' must be empty, and it
+ * is left empty. Returns whether any instruction was marked. */
+static bool findDeadInstructions(t_cfg *graph, t_basicBlock *block,
+    t_bitset *live, t_dceKind *kinds, int lastIndex)
+{
+  for (int i = bitsetNext(block->out, 0); i >= 0;
+       i = bitsetNext(block->out, i + 1))
+    bitsetAdd(live, graph->liveRegs[i]->tempRegID);
+
+  bool found = false;
+  int k = lastIndex;
+  for (t_listNode *curNode = listGetLastNode(block->nodes); curNode != NULL;
+       curNode = curNode->prev, k--) {
+    t_bbNode *node = (t_bbNode *)curNode->data;
+    t_cfgReg *def = node->defs[0];
+    if (def && isPureInstruction(node->instr) &&
+        (def->tempRegID == REG_0 || !bitsetContains(live, def->tempRegID))) {
+      kinds[k] = DCE_DEAD;
+      found = true;
+      for (int i = 0; i < CFG_MAX_DEFS; i++)
+        node->defs[i] = NULL;
+      for (int i = 0; i < CFG_MAX_USES; i++)
+        node->uses[i] = NULL;
+      continue;
+    }
+    if (def)
+      bitsetRemove(live, def->tempRegID);
+    for (int i = 0; i < CFG_MAX_USES; i++) {
+      if (node->uses[i])
+        bitsetAdd(live, node->uses[i]->tempRegID);
+    }
+  }
+
+  // Clearing only the registers which may have been added is faster than
+  // clearing the whole set for each block.
+  for (int i = bitsetNext(block->out, 0); i >= 0;
+       i = bitsetNext(block->out, i + 1))
+    bitsetRemove(live, graph->liveRegs[i]->tempRegID);
+  for (t_listNode *curNode = block->nodes; curNode != NULL;
+       curNode = curNode->next) {
+    t_bbNode *node = (t_bbNode *)curNode->data;
+    for (int i = 0; i < CFG_MAX_USES; i++) {
+      if (node->uses[i])
+        bitsetRemove(live, node->uses[i]->tempRegID);
+    }
+  }
+  return found;
+}
+
+/* Removes the code which cannot be reached from the beginning of the
+ * program, and the instructions whose result is overwritten or not used on
+ * any path which follows them. Removing an instruction may make dead the
+ * ones which compute its operands in other blocks, so the liveness is
+ * computed again until no more dead instructions are found. */
+static void removeDeadCode(t_program *program, t_optStats *stats)
+{
+  t_cfg *graph = programToCFG(program);
+
+  // Number the blocks, and find the position in the program of their first
+  // instruction.
+  t_basicBlock **blocks =
+      malloc(sizeof(t_basicBlock *) * (size_t)(graph->numBlocks + 1));
+  int *firstIndex = malloc(sizeof(int) * (size_t)(graph->numBlocks + 1));
+  if (blocks == NULL || firstIndex == NULL)
+    fatalError("out of memory");
+  int numBlocks = 0, numInstrs = 0;
+  for (t_listNode *curNode = graph->blocks; curNode != NULL;
+       curNode = curNode->next) {
+    t_basicBlock *block = (t_basicBlock *)curNode->data;
+    block->loopDepth = numBlocks;
+    blocks[numBlocks] = block;
+    firstIndex[numBlocks++] = numInstrs;
+    numInstrs += listLength(block->nodes);
+  }
+  firstIndex[numBlocks] = numInstrs;
+
+  t_dceKind *kinds = calloc((size_t)numInstrs + 1, sizeof(t_dceKind));
+  t_bitset *live = newBitset(graph->numRegsByID);
+  if (kinds == NULL || live == NULL)
+    fatalError("out of memory");
+  findUnreachableCode(graph, blocks, numBlocks, firstIndex, kinds);
+  bool changed;
+  do {
+    cfgComputeLiveness(graph);
+    changed = false;
+    for (int i = 0; i < numBlocks; i++) {
+      if (kinds[firstIndex[i]] != DCE_UNREACHABLE &&
+          findDeadInstructions(
+              graph, blocks[i], live, kinds, firstIndex[i + 1] - 1))
+        changed = true;
+    }
+  } while (changed);
+  deleteBitset(live);
+  free(blocks);
+  free(firstIndex);
+
+  // Remove the instructions from the program rebuilt from the graph, which
+  // has them in the same order. The labels of the unreachable code are only
+  // referenced by unreachable jumps, so they are dropped. When the label of
+  // a dead instruction would move to an instruction which already has one,
+  // the jumps to the latter are redirected instead.
+  cfgToProgram(program, graph);
+  deleteCFG(graph);
+  t_label **redirects =
+      calloc((size_t)program->firstUnusedLblID + 1, sizeof(t_label *));
+  if (redirects == NULL)
+    fatalError("out of memory");
+  bool redirected = false;
+  t_listNode *curNode = program->instructions;
+  for (int k = 0; curNode != NULL; k++) {
+    t_listNode *nextNode = curNode->next;
+    t_instruction *instr = (t_instruction *)curNode->data;
+    t_instruction *next = nextNode ? (t_instruction *)nextNode->data : NULL;
+    if (kinds[k] == DCE_UNREACHABLE) {
+      instr->label = NULL;
+      stats->numUnreachable++;
+    } else if (kinds[k] == DCE_DEAD) {
+      if (instr->label && next && next->label &&
+          kinds[k + 1] != DCE_UNREACHABLE) {
+        redirects[next->label->labelID] = instr->label;
+        next->label = NULL;
+        redirected = true;
+      }
+      stats->numRemoved++;
+    }
+    if (kinds[k] != DCE_LIVE)
+      removeInstructionAt(program, curNode);
+    curNode = nextNode;
+  }
+  if (redirected)
+    redirectJumps(program, redirects);
+  free(redirects);
+  free(kinds);
+}
+
+static int compareLoopSizes(const void *a, const void *b)
+{
+  const t_optLoop *la = a, *lb = b;
+  return (la->last - la->header) - (lb->last - lb->header);
+}
+
+/* Finds the loops in the CFG, and returns them from the innermost to the
+ * outermost. As in cfgComputeLoopDepths(), a loop is found from a jump to a
+ * block which precedes the jump in program order. Loops which can be entered
+ * from a block other than the first one are ignored. */
+static int findLoops(t_licmState *state, int numBlocks, t_optLoop **loops)
+{
+  // Number the blocks in program order, temporarily using the loop depth
+  // field, as cfgComputeLoopDepths() does.
+  for (int i = 0; i < numBlocks; i++)
+    state->blocks[i]->loopDepth = i;
+
+  int *lastOfHeader = malloc(sizeof(int) * (size_t)(numBlocks + 1));
+  *loops = malloc(sizeof(t_optLoop) * (size_t)(numBlocks + 1));
+  if (lastOfHeader == NULL || *loops == NULL)
+    fatalError("out of memory");
+  for (int i = 0; i < numBlocks; i++)
+    lastOfHeader[i] = -1;
+
+  for (int i = 0; i < numBlocks; i++) {
+    t_listNode *curSuccNode = state->blocks[i]->succ;
+    while (curSuccNode != NULL) {
+      t_basicBlock *succ = (t_basicBlock *)curSuccNode->data;
+      curSuccNode = curSuccNode->next;
+      if (succ == state->graph->endingBlock)
+        continue;
+      if (getBlockIndex(succ) <= i)
+        lastOfHeader[getBlockIndex(succ)] = i;
+    }
+  }
+
+  int numLoops = 0;
+  for (int header = 0; header < numBlocks; header++) {
+    if (lastOfHeader[header] < 0)
+      continue;
+    bool singleEntry = true;
+    for (int i = header + 1; i <= lastOfHeader[header] && singleEntry; i++) {
+      t_listNode *curPredNode = state->blocks[i]->pred;
+      while (curPredNode != NULL) {
+        int pred = getBlockIndex((t_basicBlock *)curPredNode->data);
+        if (pred < header || pred > lastOfHeader[header])
+          singleEntry = false;
+        curPredNode = curPredNode->next;
+      }
+    }
+    if (singleEntry) {
+      (*loops)[numLoops].header = header;
+      (*loops)[numLoops].last = lastOfHeader[header];
+      numLoops++;
+    }
+  }
+  free(lastOfHeader);
+
+  qsort(*loops, (size_t)numLoops, sizeof(t_optLoop), compareLoopSizes);
+  return numLoops;
+}
+
+/* Returns whether the value computed by an instruction of a loop is the same
+ * at every iteration, and the instruction can be moved before the loop. */
+static bool isLoopInvariant(t_licmState *state, t_instruction *instr)
+{
+  if (!isPureInstruction(instr) || instr->rDest == NULL ||
+      instr->rDest->ID == REG_0 || state->numDefs[instr->rDest->ID] != 1)
+    return false;
+  if (instr->rSrc1 && state->numLoopDefs[instr->rSrc1->ID] != 0)
+    return false;
+  if (instr->rSrc2 && state->numLoopDefs[instr->rSrc2->ID] != 0)
+    return false;
+  return true;
+}
+
+/* Moves the invariant instructions of a loop immediately before it. The
+ * moved instructions take the label of the loop, and the jumps inside the
+ * loop are redirected to a new label, so that the moved instructions are
+ * executed once when entering the loop. Returns true if the program was
+ * changed. */
+static bool hoistFromLoop(t_licmState *state, t_optLoop loop)
+{
+  t_program *program = state->program;
+
+  // Collect the instructions of the loop and their definitions.
+  int numInstrs = 0;
+  for (int i = loop.header; i <= loop.last; i++)
+    numInstrs += listLength(state->blocks[i]->nodes);
+  t_instruction **instrs = malloc(sizeof(t_instruction *) * (size_t)numInstrs);
+  bool *hoist = calloc((size_t)numInstrs, sizeof(bool));
+  if (instrs == NULL || hoist == NULL)
+    fatalError("out of memory");
+  int k = 0;
+  for (int i = loop.header; i <= loop.last; i++) {
+    t_listNode *curNode = state->blocks[i]->nodes;
+    while (curNode != NULL) {
+      t_instruction *instr = ((t_bbNode *)curNode->data)->instr;
+      instrs[k++] = instr;
+      if (instr->rDest)
+        state->numLoopDefs[instr->rDest->ID]++;
+      curNode = curNode->next;
+    }
+  }
+
+  // Find the invariant instructions. An instruction whose operands are
+  // computed by invariant instructions is invariant as well.
+  int numHoisted = 0;
+  bool changed;
+  do {
+    changed = false;
+    for (k = 0; k < numInstrs; k++) {
+      if (hoist[k] || !isLoopInvariant(state, instrs[k]))
+        continue;
+      hoist[k] = true;
+      state->numLoopDefs[instrs[k]->rDest->ID]--;
+      numHoisted++;
+      changed = true;
+    }
+  } while (changed);
+
+  for (k = 0; k < numInstrs; k++) {
+    if (instrs[k]->rDest)
+      state->numLoopDefs[instrs[k]->rDest->ID] = 0;
+  }
+  if (numHoisted == 0) {
+    free(instrs);
+    free(hoist);
+    return false;
+  }
+
+  // Copy the invariant instructions before the loop. A constant or an
+  // address already loaded by another copy is not loaded again: the uses of
+  // its register are renamed instead.
+  t_listNode *headerNode = state->firstNodes[loop.header];
+  t_instruction *firstCopy = NULL;
+  t_listNode *copies = NULL;
+  for (k = 0; k < numInstrs; k++) {
+    if (!hoist[k])
+      continue;
+    t_instruction *orig = instrs[k];
+
+    t_instruction *same = NULL;
+    t_listNode *curCopy = copies;
+    while (curCopy != NULL && same == NULL) {
+      t_instruction *copy = (t_instruction *)curCopy->data;
+      if ((orig->opcode == OPC_LI && copy->opcode == OPC_LI &&
+              orig->immediate == copy->immediate) ||
+          (orig->opcode == OPC_LA && copy->opcode == OPC_LA &&
+              orig->addressParam->labelID == copy->addressParam->labelID))
+        same = copy;
+      curCopy = curCopy->next;
+    }
+    if (same != NULL) {
+      state->renames[orig->rDest->ID] = same->rDest->ID;
+      continue;
+    }
+
+    t_instruction *copy = genInstruction(NULL, orig->opcode, orig->rDest->ID,
+        orig->rSrc1 ? orig->rSrc1->ID : REG_INVALID,
+        orig->rSrc2 ? orig->rSrc2->ID : REG_INVALID, orig->addressParam,
+        orig->immediate);
+    copy->source = orig->source;
+    program->instructions =
+        listInsertBefore(program->instructions, headerNode, copy);
+    copies = listInsert(copies, copy, -1);
+    if (firstCopy == NULL)
+      firstCopy = copy;
+  }
+  deleteList(copies);
+
+  // Move the label of the loop to the copies, and redirect the jumps inside
+  // the loop to a new label.
+  t_label *oldLabel = instrs[0]->label;
+  t_label *newLabel = createLabel(program);
+  program->labelIDs[newLabel->labelID].assigned = true;
+  firstCopy->label = oldLabel;
+  instrs[0]->label = newLabel;
+  for (k = 0; k < numInstrs; k++) {
+    if (oldLabel && isJumpInstruction(instrs[k]) &&
+        instrs[k]->addressParam->labelID == oldLabel->labelID)
+      instrs[k]->addressParam = newLabel;
+  }
+
+  // Remove the original instructions. The instructions of the loop are
+  // contiguous in the program, starting from the header.
+  t_listNode *curNode = headerNode;
+  for (k = 0; k < numInstrs; k++) {
+    t_listNode *nextNode = curNode->next;
+    if (hoist[k])
+      removeInstructionAt(program, curNode);
+    curNode = nextNode;
+  }
+  state->stats->numHoisted += numHoisted;
+
+  free(instrs);
+  free(hoist);
+  return true;
+}
+
+/* Returns whether the profile shows that a loop is entered more often than
+ * it iterates, so that the instructions moved before it would be executed
+ * more times than inside it. The header of a loop is executed once per entry
+ * and once per iteration, its last block once per iteration. */
+static bool isRarelyIterated(t_licmState *state, t_optLoop loop)
+{
+  if (state->blockCounts == NULL)
+    return false;
+  double headerRuns =
+      state->blockCounts[state->blocks[loop.header]->livenessIndex];
+  double lastRuns = state->blockCounts[state->blocks[loop.last]->livenessIndex];
+  if (headerRuns < 0 || lastRuns < 0)
+    return false;
+  return lastRuns * 2 < headerRuns;
+}
+
+/* Moves the computations whose result does not change across the iterations
+ * of a loop, such as the addresses of the variables and the constants, out
+ * of the loops. The loops are processed from the innermost, so that an
+ * instruction moved out of a loop may then be moved out of the enclosing
+ * ones. */
+static void hoistLoopInvariants(
+    t_program *program, const t_profile *profile, t_optStats *stats)
+{
+  t_licmState state;
+  state.program = program;
+  state.stats = stats;
+  state.profile = profile;
+  state.numDefs = calloc((size_t)program->firstUnusedReg, sizeof(int));
+  state.numLoopDefs = calloc((size_t)program->firstUnusedReg, sizeof(int));
+  state.renames = malloc(sizeof(t_regID) * (size_t)program->firstUnusedReg);
+  if (!state.numDefs || !state.numLoopDefs || !state.renames)
+    fatalError("out of memory");
+  for (t_regID reg = 0; reg < program->firstUnusedReg; reg++)
+    state.renames[reg] = REG_INVALID;
+  t_listNode *curNode = program->instructions;
+  while (curNode != NULL) {
+    t_instruction *instr = (t_instruction *)curNode->data;
+    if (instr->rDest)
+      state.numDefs[instr->rDest->ID]++;
+    curNode = curNode->next;
+  }
+
+  // After a loop is changed, the CFG is out of date for the loops which
+  // contain it, and it must be built again for them.
+  bool changed;
+  do {
+    changed = false;
+    t_cfg *graph = programToCFG(program);
+    state.graph = graph;
+    state.blockCounts =
+        profile ? profileGetBlockCounts(profile, graph) : NULL;
+    state.blocks =
+        malloc(sizeof(t_basicBlock *) * (size_t)(graph->numBlocks + 1));
+    state.firstNodes =
+        malloc(sizeof(t_listNode *) * (size_t)(graph->numBlocks + 1));
+    state.changedBlocks = calloc((size_t)graph->numBlocks + 1, sizeof(bool));
+    if (!state.blocks || !state.firstNodes || !state.changedBlocks)
+      fatalError("out of memory");
+    int numBlocks = 0;
+    t_listNode *curInstrNode = program->instructions;
+    curNode = graph->blocks;
+    while (curNode != NULL) {
+      t_basicBlock *block = (t_basicBlock *)curNode->data;
+      state.blocks[numBlocks] = block;
+      state.firstNodes[numBlocks] = curInstrNode;
+      for (int i = listLength(block->nodes); i > 0; i--)
+        curInstrNode = curInstrNode->next;
+      numBlocks++;
+      curNode = curNode->next;
+    }
+
+    t_optLoop *loops;
+    int numLoops = findLoops(&state, numBlocks, &loops);
+    for (int i = 0; i < numLoops; i++) {
+      bool outOfDate = false;
+      for (int j = loops[i].header; j <= loops[i].last && !outOfDate; j++)
+        outOfDate = state.changedBlocks[j];
+      if (outOfDate || isRarelyIterated(&state, loops[i]))
+        continue;
+      if (hoistFromLoop(&state, loops[i])) {
+        for (int j = loops[i].header; j <= loops[i].last; j++)
+          state.changedBlocks[j] = true;
+        changed = true;
+      }
+    }
+
+    free(loops);
+    free(state.blocks);
+    free(state.firstNodes);
+    free(state.changedBlocks);
+    free(state.blockCounts);
+    deleteCFG(graph);
+  } while (changed);
+
+  // Replace the registers loaded with the same value as another one.
+  curNode = program->instructions;
+  while (curNode != NULL) {
+    t_instruction *instr = (t_instruction *)curNode->data;
+    t_instrArg *args[2] = {instr->rSrc1, instr->rSrc2};
+    for (int i = 0; i < 2; i++) {
+      while (args[i] != NULL && state.renames[args[i]->ID] != REG_INVALID)
+        args[i]->ID = state.renames[args[i]->ID];
+    }
+    curNode = curNode->next;
+  }
+  free(state.renames);
+
+  free(state.numDefs);
+  free(state.numLoopDefs);
+}
+
+void optimizeProgram(
+    t_program *program, const t_profile *profile, t_optStats *stats)
+{
+  t_optStats dummy = {0};
+  if (stats == NULL)
+    stats = &dummy;
+
+  promoteScalarVariables(program, stats);
+  propagateConstants(program, stats);
+  hoistLoopInvariants(program, profile, stats);
+  removeUnusedResults(program, stats);
+  removeDeadCode(program, stats);
+}
+
+void optStatsDump(const t_optStats *stats, FILE *fout)
+{
+  fprintf(fout, "Variables kept in registers: %d\n", stats->numPromoted);
+  fprintf(fout, "Instructions folded to a constant: %d\n", stats->numFolded);
+  fprintf(fout, "Variable loads replaced by their value: %d\n",
+      stats->numPropagated);
+  fprintf(fout, "Instructions simplified: %d\n", stats->numSimplified);
+  fprintf(fout, "Instructions moved out of loops: %d\n", stats->numHoisted);
+  fprintf(fout, "Unused instructions removed: %d\n", stats->numRemoved);
+  fprintf(fout, "Unreachable instructions removed: %d\n",
+      stats->numUnreachable);
+}
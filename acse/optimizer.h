@@ -0,0 +1,62 @@
+/// @file optimizer.h
+/// @brief Machine-independent optimizations of the program
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <stdio.h>
+#include "program.h"
+#include "profile.h"
+
+/**
+ * @defgroup optimizer Optimizer
+ * @brief Machine-independent optimizations of the program
+ *
+ * The optimizations run on the intermediate representation produced by the
+ * front end, before it is lowered to the target machine instructions. They
+ * are enabled by the `-O1' command line option.
+ * @{
+ */
+
+/** Counters of the changes made by the optimizations. */
+typedef struct {
+  /// Scalar variables kept in a register for the whole program.
+  int numPromoted;
+  /// Instructions replaced by the constant they compute.
+  int numFolded;
+  /// Loads of variables replaced by their known value.
+  int numPropagated;
+  /// Instructions rewritten to a simpler equivalent.
+  int numSimplified;
+  /// Instructions moved out of loops because their result is the same at
+  /// every iteration.
+  int numHoisted;
+  /// Instructions removed because their result is never used.
+  int numRemoved;
+  /// Instructions removed because they are never executed.
+  int numUnreachable;
+} t_optStats;
+
+/** Keeps the scalar variables in registers, and performs constant folding,
+ * constant propagation, algebraic simplification, loop invariant code
+ * motion and dead code elimination on a program.
+ * @param program The program to optimize. The transformation is performed
+ *                in-place.
+ * @param profile Execution counts of a previous run of the program, or NULL.
+ *                The invariant code is not moved out of the loops which
+ *                were entered more often than they iterated.
+ * @param stats   Object where to accumulate the number of changes. It may
+ *                be NULL if the statistics are not needed. */
+void optimizeProgram(
+    t_program *program, const t_profile *profile, t_optStats *stats);
+
+/** Prints the statistics of the optimizations to the specified file.
+ * @param stats The statistics to print.
+ * @param fout  The file where to print the statistics. */
+void optStatsDump(const t_optStats *stats, FILE *fout);
+
+/**
+ * @}
+ */
+
+#endif
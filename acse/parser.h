@@ -16,16 +16,55 @@
 
 /** Utility structure used to store information about an if statement. */
 typedef struct {
-  t_label *lElse; ///< Label to the else part.
-  t_label *lExit; ///< Label to the first instruction after the statement.
+  t_listNode *lElse; ///< Labels to the else part.
+  t_label *lExit;    ///< Label to the first instruction after the statement.
 } t_ifStmt;
 
 /** Utility structure used to store information about a while statement. */
 typedef struct {
-  t_label *lLoop; ///< Label to the beginning of the loop.
-  t_label *lExit; ///< Label to the first instruction after the loop.
+  t_label *lLoop;    ///< Label to the beginning of the loop.
+  t_listNode *lExit; ///< Labels to the first instruction after the loop.
 } t_whileStmt;
 
+/** Comparison operators. Each operator is followed by its negation, so that
+ * the negation of any operator `op' is `op ^ 1'. */
+typedef enum {
+  CMP_EQ, ///< Equal.
+  CMP_NE, ///< Not equal.
+  CMP_LT, ///< Less than.
+  CMP_GE, ///< Greater than or equal.
+  CMP_GT, ///< Greater than.
+  CMP_LE  ///< Less than or equal.
+} t_compareOp;
+
+/** Kinds of code generated for an expression. */
+typedef enum {
+  /// The value of the expression is in a register.
+  EXP_REGISTER,
+  /// The expression is a comparison between two registers, whose code has
+  /// not been generated yet. It becomes either a set instruction or a
+  /// branch depending on how the expression is used.
+  EXP_COMPARISON,
+  /// The expression is a condition whose code has already been generated
+  /// as branches. The code falls through when the condition is true, and
+  /// jumps to a list of labels when it is false.
+  EXP_CONDITION
+} t_expKind;
+
+/** Utility structure used to store the result of an expression. */
+typedef struct {
+  t_expKind kind;
+  /// For EXP_REGISTER, the register which contains the value.
+  t_regID reg;
+  /// For EXP_COMPARISON, the operator and its two operands.
+  t_compareOp compareOp;
+  t_regID rSrc1;
+  t_regID rSrc2;
+  /// For EXP_CONDITION, the labels to assign to the code executed when the
+  /// condition is false.
+  t_listNode *lFalse;
+} t_expValue;
+
 /**
  * @}
  */
@@ -24,6 +24,148 @@ void yyerror(const char *msg)
   emitError(curFileLoc, "%s", msg);
 }
 
+/*
+ * Utility functions for the code generation of expressions
+ */
+
+// Returns an expression whose value is in the given register.
+static t_expValue registerExp(t_regID reg)
+{
+  t_expValue result = {0};
+  result.kind = EXP_REGISTER;
+  result.reg = reg;
+  return result;
+}
+
+// Returns an expression which compares the values of two registers.
+static t_expValue comparisonExp(t_compareOp op, t_regID rSrc1, t_regID rSrc2)
+{
+  t_expValue result = {0};
+  result.kind = EXP_COMPARISON;
+  result.compareOp = op;
+  result.rSrc1 = rSrc1;
+  result.rSrc2 = rSrc2;
+  return result;
+}
+
+// Returns a condition which jumps to the given labels when it is false.
+static t_expValue conditionExp(t_listNode *lFalse)
+{
+  t_expValue result = {0};
+  result.kind = EXP_CONDITION;
+  result.lFalse = lFalse;
+  return result;
+}
+
+// Assigns all the labels in a list to the next instruction, and frees the
+// list.
+static void assignLabels(t_listNode *labels)
+{
+  for (t_listNode *curNode = labels; curNode != NULL; curNode = curNode->next)
+    assignLabel(program, (t_label *)curNode->data);
+  deleteList(labels);
+}
+
+// Generates a branch to a label which is taken if the comparison with the
+// given operator between two registers is true.
+static void genComparisonBranch(
+    t_compareOp op, t_regID rSrc1, t_regID rSrc2, t_label *label)
+{
+  switch (op) {
+    case CMP_EQ:
+      genBEQ(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_NE:
+      genBNE(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_LT:
+      genBLT(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_GE:
+      genBGE(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_GT:
+      genBGT(program, rSrc1, rSrc2, label);
+      break;
+    case CMP_LE:
+      genBLE(program, rSrc1, rSrc2, label);
+      break;
+  }
+}
+
+// Returns the register which contains the value of an expression, generating
+// the code which computes it if needed.
+static t_regID genExpToRegister(t_expValue exp)
+{
+  if (exp.kind == EXP_REGISTER)
+    return exp.reg;
+
+  t_regID rDest = getNewRegister(program);
+  if (exp.kind == EXP_COMPARISON) {
+    switch (exp.compareOp) {
+      case CMP_EQ:
+        genSEQ(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_NE:
+        genSNE(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_LT:
+        genSLT(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_GE:
+        genSGE(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_GT:
+        genSGT(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+      case CMP_LE:
+        genSLE(program, rDest, exp.rSrc1, exp.rSrc2);
+        break;
+    }
+    return rDest;
+  }
+
+  // The code of a condition falls through when the condition is true.
+  t_label *lExit = createLabel(program);
+  genLI(program, rDest, 1);
+  genJ(program, lExit);
+  assignLabels(exp.lFalse);
+  genLI(program, rDest, 0);
+  assignLabel(program, lExit);
+  return rDest;
+}
+
+// Generates the code which jumps away when the value of an expression is
+// zero, and falls through otherwise. Returns the list of the labels which
+// must be assigned to the destination of the jump.
+static t_listNode *genJumpIfFalse(t_expValue exp)
+{
+  if (exp.kind == EXP_CONDITION)
+    return exp.lFalse;
+
+  t_label *lFalse = createLabel(program);
+  if (exp.kind == EXP_REGISTER)
+    genBEQ(program, exp.reg, REG_0, lFalse);
+  else
+    genComparisonBranch(
+        (t_compareOp)(exp.compareOp ^ 1), exp.rSrc1, exp.rSrc2, lFalse);
+  return listInsert(NULL, lFalse, -1);
+}
+
+// Generates the code which jumps to a label when the value of an expression
+// is not zero, and falls through otherwise.
+static void genJumpIfTrue(t_expValue exp, t_label *lTrue)
+{
+  if (exp.kind == EXP_REGISTER) {
+    genBNE(program, exp.reg, REG_0, lTrue);
+  } else if (exp.kind == EXP_COMPARISON) {
+    genComparisonBranch(exp.compareOp, exp.rSrc1, exp.rSrc2, lTrue);
+  } else {
+    genJ(program, lTrue);
+    assignLabels(exp.lFalse);
+  }
+}
+
 %}
 
 /*
@@ -45,6 +187,7 @@ void yyerror(const char *msg)
   int integer;
   char *string;
   t_regID reg;
+  t_expValue exp;
   t_symbol *var;
   t_listNode *list;
   t_label *label;
@@ -87,7 +230,8 @@ void yyerror(const char *msg)
  */
 
 %type <var> var_id
-%type <reg> exp
+%type <exp> exp
+%type <reg> left_operand
 
 /*
  * Operator precedence and associativity
@@ -190,11 +334,17 @@ statement
 assign_statement
   : var_id ASSIGN exp
   {
-    genStoreRegisterToVariable(program, $1, $3);
+    genStoreRegisterToVariable(program, $1, genExpToRegister($3));
+  }
+  | var_id LSQUARE exp RSQUARE
+  {
+    // The index must be computed before the code of the assigned value.
+    $<reg>$ = genExpToRegister($3);
   }
-  | var_id LSQUARE exp RSQUARE ASSIGN exp
+  ASSIGN exp
   {
-    genStoreRegisterToArrayElement(program, $1, $3, $6);
+    genStoreRegisterToArrayElement(
+        program, $1, $<reg>5, genExpToRegister($7));
   }
 ;
 
@@ -205,16 +355,16 @@ if_statement
   : IF LPAR exp RPAR
   {
     // Generate a jump to the else part if the expression is equal to zero.
-    $1.lElse = createLabel(program);
-    genBEQ(program, $3, REG_0, $1.lElse);
+    $1.lElse = genJumpIfFalse($3);
   }
   code_block
   {
     // After the `then' part, generate a jump to the end of the statement.
     $1.lExit = createLabel(program);
     genJ(program, $1.lExit);
-    // Assign the label which points to the first instruction of the else part.
-    assignLabel(program, $1.lElse);
+    // Assign the labels which point to the first instruction of the else
+    // part.
+    assignLabels($1.lElse);
   }
   else_part
   {
@@ -242,15 +392,14 @@ while_statement
   LPAR exp RPAR
   {
     // Generate a jump out of the loop if the condition is equal to zero.
-    $1.lExit = createLabel(program);
-    genBEQ(program, $4, REG_0, $1.lExit);
+    $1.lExit = genJumpIfFalse($4);
   }
   code_block
   {
     // Generate a jump back to the beginning of the loop after its body.
     genJ(program, $1.lLoop);
-    // Assign the label to the end of the loop.
-    assignLabel(program, $1.lExit);
+    // Assign the labels to the end of the loop.
+    assignLabels($1.lExit);
   }
 ;
 
@@ -268,7 +417,7 @@ do_while_statement
   {
     // Generate a jump to the beginning of the loop to repeat the code block
     // if the condition is not equal to zero.
-    genBNE(program, $6, REG_0, $1);
+    genJumpIfTrue($6, $1);
   }
 ;
 
@@ -298,7 +447,7 @@ write_statement
   : WRITE LPAR exp RPAR
   {
     // Generate a call to the PrintInt syscall.
-    genPrintIntSyscall(program, $3);
+    genPrintIntSyscall(program, genExpToRegister($3));
     // Also generate code to print a newline after the integer.
     t_regID rTmp = getNewRegister(program);
     genLI(program, rTmp, '\n');
@@ -307,21 +456,25 @@ write_statement
 ;
 
 /* The exp rule represents the syntax of expressions. The semantic value of
- * the rule is the register ID that will contain the value of the expression
- * at runtime. */
+ * the rule describes where the value of the expression will be at runtime.
+ * Usually it is a register; comparisons and logical operators are instead
+ * translated to branches when they are used as a condition, and the logical
+ * operators evaluate their right operand only when needed. */
 exp
   : NUMBER
   {
-    $$ = getNewRegister(program);
-    genLI(program, $$, $1);
+    t_regID rDest = getNewRegister(program);
+    genLI(program, rDest, $1);
+    $$ = registerExp(rDest);
   }
   | var_id
   {
-    $$ = genLoadVariable(program, $1);
+    $$ = registerExp(genLoadVariable(program, $1));
   }
   | var_id LSQUARE exp RSQUARE
   {
-    $$ = genLoadArrayElement(program, $1, $3);
+    $$ = registerExp(
+        genLoadArrayElement(program, $1, genExpToRegister($3)));
   }
   | LPAR exp RPAR
   {
@@ -329,111 +482,142 @@ exp
   }
   | MINUS exp
   {
-    $$ = getNewRegister(program);
-    genSUB(program, $$, REG_0, $2);
+    t_regID rDest = getNewRegister(program);
+    genSUB(program, rDest, REG_0, genExpToRegister($2));
+    $$ = registerExp(rDest);
   }
-  | exp PLUS exp
+  | exp PLUS left_operand exp
   {
-    $$ = getNewRegister(program);
-    genADD(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genADD(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp MINUS exp
+  | exp MINUS left_operand exp
   {
-    $$ = getNewRegister(program);
-    genSUB(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genSUB(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp MUL_OP exp
+  | exp MUL_OP left_operand exp
   {
-    $$ = getNewRegister(program);
-    genMUL(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genMUL(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp DIV_OP exp
+  | exp DIV_OP left_operand exp
   {
-    $$ = getNewRegister(program);
-    genDIV(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genDIV(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp MOD_OP exp
+  | exp MOD_OP left_operand exp
   {
-    $$ = getNewRegister(program);
-    genREM(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genREM(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp AND_OP exp
+  | exp AND_OP left_operand exp
   {
-    $$ = getNewRegister(program);
-    genAND(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genAND(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp XOR_OP exp
+  | exp XOR_OP left_operand exp
   {
-    $$ = getNewRegister(program);
-    genXOR(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genXOR(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp OR_OP exp
+  | exp OR_OP left_operand exp
   {
-    $$ = getNewRegister(program);
-    genOR(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genOR(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp SHL_OP exp
+  | exp SHL_OP left_operand exp
   {
-    $$ = getNewRegister(program);
-    genSLL(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genSLL(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp SHR_OP exp
+  | exp SHR_OP left_operand exp
   {
-    $$ = getNewRegister(program);
-    genSRA(program, $$, $1, $3);
+    t_regID rDest = getNewRegister(program);
+    genSRA(program, rDest, $3, genExpToRegister($4));
+    $$ = registerExp(rDest);
   }
-  | exp LT exp
+  | exp LT left_operand exp
   {
-    $$ = getNewRegister(program);
-    genSLT(program, $$, $1, $3);
+    $$ = comparisonExp(CMP_LT, $3, genExpToRegister($4));
   }
-  | exp GT exp
+  | exp GT left_operand exp
   {
-    $$ = getNewRegister(program);
-    genSGT(program, $$, $1, $3);
+    $$ = comparisonExp(CMP_GT, $3, genExpToRegister($4));
   }
-  | exp EQ exp
+  | exp EQ left_operand exp
   {
-    $$ = getNewRegister(program);
-    genSEQ(program, $$, $1, $3);
+    $$ = comparisonExp(CMP_EQ, $3, genExpToRegister($4));
   }
-  | exp NOTEQ exp
+  | exp NOTEQ left_operand exp
   {
-    $$ = getNewRegister(program);
-    genSNE(program, $$, $1, $3);
+    $$ = comparisonExp(CMP_NE, $3, genExpToRegister($4));
   }
-  | exp LTEQ exp
+  | exp LTEQ left_operand exp
   {
-    $$ = getNewRegister(program);
-    genSLE(program, $$, $1, $3);
+    $$ = comparisonExp(CMP_LE, $3, genExpToRegister($4));
   }
-  | exp GTEQ exp
+  | exp GTEQ left_operand exp
   {
-    $$ = getNewRegister(program);
-    genSGE(program, $$, $1, $3);
+    $$ = comparisonExp(CMP_GE, $3, genExpToRegister($4));
   }
   | NOT_OP exp
   {
-    $$ = getNewRegister(program);
-    genSEQ(program, $$, $2, REG_0);
+    if ($2.kind == EXP_REGISTER) {
+      $$ = comparisonExp(CMP_EQ, $2.reg, REG_0);
+    } else if ($2.kind == EXP_COMPARISON) {
+      $$ = $2;
+      $$.compareOp = (t_compareOp)($2.compareOp ^ 1);
+    } else {
+      // Swap the code executed when the condition is true with the code
+      // executed when it is false.
+      t_label *lFalse = createLabel(program);
+      genJ(program, lFalse);
+      assignLabels($2.lFalse);
+      $$ = conditionExp(listInsert(NULL, lFalse, -1));
+    }
+  }
+  | exp ANDAND
+  {
+    // Skip the right operand if the left one is false.
+    $<list>$ = genJumpIfFalse($1);
   }
-  | exp ANDAND exp
+  exp
   {
-    t_regID rNormalizedOp1 = getNewRegister(program);
-    genSNE(program, rNormalizedOp1, $1, REG_0);
-    t_regID rNormalizedOp2 = getNewRegister(program);
-    genSNE(program, rNormalizedOp2, $3, REG_0);
-    $$ = getNewRegister(program);
-    genAND(program, $$, rNormalizedOp1, rNormalizedOp2);
+    t_listNode *lFalse = genJumpIfFalse($4);
+    $$ = conditionExp(listAppendList($<list>3, lFalse));
+    deleteList(lFalse);
   }
-  | exp OROR exp
+  | exp OROR
+  {
+    // Skip the right operand if the left one is true.
+    $<label>$ = createLabel(program);
+    genJumpIfTrue($1, $<label>$);
+  }
+  exp
+  {
+    $$ = conditionExp(genJumpIfFalse($4));
+    assignLabel(program, $<label>3);
+  }
+;
+
+/* The left operand of a binary operator is moved to a register before the
+ * code of the right operand, in case it is a condition whose code has
+ * already been generated. Its semantic value is that register. */
+left_operand
+  : /* empty */
   {
-    t_regID rNormalizedOp1 = getNewRegister(program);
-    genSNE(program, rNormalizedOp1, $1, REG_0);
-    t_regID rNormalizedOp2 = getNewRegister(program);
-    genSNE(program, rNormalizedOp2, $3, REG_0);
-    $$ = getNewRegister(program);
-    genOR(program, $$, rNormalizedOp1, rNormalizedOp2);
+    // The left operand is the symbol before the operator.
+    $$ = genExpToRegister($<exp>-1);
   }
 ;
 
@@ -0,0 +1,243 @@
+/// @file profile.c
+/// @brief Execution profiles of a previous run of the program implementation
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "profile.h"
+#include "arena.h"
+
+/// Beginning of the first line of the report.
+#define PROFILE_TITLE "Profile of "
+/// Title of the section of the report with the counts of the source lines.
+/// Each line of the section holds the number of instructions executed, their
+/// percentage, the number of executions of the line and its location as
+/// "file:line"; the section ends with an empty line. It is missing if no line
+/// was executed.
+#define PROFILE_SECTION "Source lines by execution count:"
+
+/// Number of executions of a line of the program.
+typedef struct {
+  /// Name of the file, without the directories.
+  const char *file;
+  /// Zero-based index of the line in the file.
+  int row;
+  /// Number of times the line was executed.
+  double runs;
+} t_profileLine;
+
+/// Structure describing a profile.
+struct t_profile {
+  /// The lines with a count, sorted by file name and then by line.
+  t_profileLine *lines;
+  /// Number of elements in the `lines' array.
+  int numLines;
+  /// Memory of the names of the files.
+  t_arena arena;
+};
+
+
+/* Returns the name of a file without the directories */
+static const char *profileBaseName(const char *path)
+{
+  const char *slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+static int compareLines(const void *a, const void *b)
+{
+  const t_profileLine *la = a, *lb = b;
+  int res = strcmp(la->file, lb->file);
+  if (res != 0)
+    return res;
+  return (la->row > lb->row) - (la->row < lb->row);
+}
+
+/* Parses a line of the section, as "count percent% runs file:line". Returns
+ * false if it is not well formed. */
+static bool parseLine(
+    t_profile *profile, char *text, const char **lastFile, t_profileLine *res)
+{
+  char *p = text;
+  char *end;
+  strtoull(p, &end, 10);
+  if (end == p)
+    return false;
+  p = end;
+  strtod(p, &end);
+  if (end == p || *end != '%')
+    return false;
+  p = end + 1;
+  unsigned long long runs = strtoull(p, &end, 10);
+  if (end == p || !isspace((unsigned char)*end))
+    return false;
+  p = end;
+  while (isspace((unsigned char)*p))
+    p++;
+
+  size_t len = strlen(p);
+  while (len > 0 && isspace((unsigned char)p[len - 1]))
+    p[--len] = '\0';
+  char *colon = strrchr(p, ':');
+  if (colon == NULL || colon == p)
+    return false;
+  long line = strtol(colon + 1, &end, 10);
+  if (end == colon + 1 || *end != '\0' || line < 1)
+    return false;
+  *colon = '\0';
+
+  // The lines of the same file are usually next to each other.
+  const char *file = profileBaseName(p);
+  if (*lastFile == NULL || strcmp(*lastFile, file) != 0)
+    *lastFile = arenaStrdup(&profile->arena, file);
+  res->file = *lastFile;
+  res->row = (int)line - 1;
+  res->runs = (double)runs;
+  return true;
+}
+
+t_profile *loadProfile(const char *fn)
+{
+  FILE *fp = fopen(fn, "r");
+  if (fp == NULL) {
+    emitError(nullFileLocation, "could not open profile \"%s\"", fn);
+    return NULL;
+  }
+
+  t_profile *profile = calloc(1, sizeof(t_profile));
+  if (profile == NULL)
+    fatalError("out of memory");
+  int size = 0;
+  bool found = false;
+  char *text = NULL;
+  size_t textSize = 0;
+  const char *lastFile = NULL;
+
+  if (getline(&text, &textSize, fp) < 0 ||
+      strncmp(text, PROFILE_TITLE, strlen(PROFILE_TITLE)) != 0) {
+    emitError(nullFileLocation, "\"%s\" is not a profile written by the "
+        "simulator", fn);
+    free(text);
+    fclose(fp);
+    deleteProfile(profile);
+    return NULL;
+  }
+
+  // Skip to the section of the source lines, and then its column titles.
+  while (!found && getline(&text, &textSize, fp) >= 0)
+    found = strncmp(text, PROFILE_SECTION, strlen(PROFILE_SECTION)) == 0;
+  if (found && getline(&text, &textSize, fp) < 0)
+    found = false;
+  while (found && getline(&text, &textSize, fp) >= 0) {
+    t_profileLine line;
+    if (!parseLine(profile, text, &lastFile, &line))
+      break;
+    if (profile->numLines == size) {
+      size = size ? size * 2 : 256;
+      profile->lines =
+          realloc(profile->lines, sizeof(t_profileLine) * (size_t)size);
+      if (profile->lines == NULL)
+        fatalError("out of memory");
+    }
+    profile->lines[profile->numLines++] = line;
+  }
+  free(text);
+  fclose(fp);
+
+  if (profile->numLines > 0)
+    qsort(profile->lines, (size_t)profile->numLines, sizeof(t_profileLine),
+        compareLines);
+  return profile;
+}
+
+void deleteProfile(t_profile *profile)
+{
+  if (profile == NULL)
+    return;
+  free(profile->lines);
+  deleteArena(&profile->arena);
+  free(profile);
+}
+
+
+double profileGetCount(const t_profile *profile, t_fileLocation loc)
+{
+  if (loc.file == NULL || loc.row < 0)
+    return -1;
+  t_profileLine key = {profileBaseName(loc.file), loc.row, 0};
+
+  // Find the first line which does not precede the location.
+  int low = 0, high = profile->numLines;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (compareLines(&profile->lines[mid], &key) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low < profile->numLines) {
+    const t_profileLine *line = &profile->lines[low];
+    if (compareLines(line, &key) == 0)
+      return line->runs;
+    if (strcmp(line->file, key.file) == 0)
+      return 0;
+  }
+  // The lines which were never executed are missing from the profile.
+  if (low > 0 && strcmp(profile->lines[low - 1].file, key.file) == 0)
+    return 0;
+  return -1;
+}
+
+/* Returns the largest count of the lines of the instructions of a block, or
+ * -1 if none of them has a count */
+static double getLinesCount(const t_profile *profile, t_basicBlock *block)
+{
+  double res = -1;
+  t_listNode *curNode = block->nodes;
+  while (curNode != NULL) {
+    t_bbNode *node = (t_bbNode *)curNode->data;
+    double count = profileGetCount(profile, node->instr->source);
+    if (count > res)
+      res = count;
+    curNode = curNode->next;
+  }
+  return res;
+}
+
+double *profileGetBlockCounts(const t_profile *profile, t_cfg *graph)
+{
+  double *counts = malloc(sizeof(double) * (size_t)(graph->numBlocks + 1));
+  if (counts == NULL)
+    fatalError("out of memory");
+  t_listNode *curBlockNode = graph->blocks;
+  while (curBlockNode != NULL) {
+    t_basicBlock *block = (t_basicBlock *)curBlockNode->data;
+    counts[block->livenessIndex] = getLinesCount(profile, block);
+    curBlockNode = curBlockNode->next;
+  }
+
+  // Bound the counts in program order, so that the predecessors of a block
+  // are usually bounded before it.
+  bool isFirst = true;
+  curBlockNode = graph->blocks;
+  while (curBlockNode != NULL) {
+    t_basicBlock *block = (t_basicBlock *)curBlockNode->data;
+    double bound = isFirst ? 1 : 0;
+    t_listNode *curPredNode = block->pred;
+    while (curPredNode != NULL && bound >= 0) {
+      t_basicBlock *pred = (t_basicBlock *)curPredNode->data;
+      if (counts[pred->livenessIndex] < 0)
+        bound = -1;
+      else
+        bound += counts[pred->livenessIndex];
+      curPredNode = curPredNode->next;
+    }
+    double *count = &counts[block->livenessIndex];
+    if (bound >= 0 && (*count < 0 || *count > bound))
+      *count = bound;
+    isFirst = false;
+    curBlockNode = curBlockNode->next;
+  }
+  return counts;
+}
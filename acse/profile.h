@@ -0,0 +1,63 @@
+/// @file profile.h
+/// @brief Execution profiles of a previous run of the program
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "errors.h"
+#include "cfg.h"
+
+/**
+ * @defgroup profile Execution Profiles
+ * @brief Execution counts used to guide the optimizations.
+ *
+ * A profile is the report written by `simrv32im --profile' while running an
+ * earlier build of the same program. Only its section with the source lines
+ * is read: the number of times each line was executed is mapped back to the
+ * instructions compiled from it through their source locations. Files are
+ * matched by their name without the directories, so that the profile stays
+ * valid if the program is compiled from another directory.
+ *
+ * The counts only weight decisions which are already made by estimates, so
+ * a stale or unrelated profile makes the code slower but never incorrect.
+ * @{
+ */
+
+/** Opaque execution profile object. */
+typedef struct t_profile t_profile;
+
+/** Read a profile written by the simulator.
+ *  @param fn The name of the file.
+ *  @return The new profile, or NULL if the file cannot be read or is not a
+ *          report of the simulator. The error is reported. */
+t_profile *loadProfile(const char *fn);
+
+/** Deallocate a profile.
+ *  @param profile The profile object, or NULL. */
+void deleteProfile(t_profile *profile);
+
+/** Return how many times a line of the program was executed.
+ *  @param profile The profile.
+ *  @param loc     The location of the line.
+ *  @return The number of executions, which is zero for a line without any
+ *          count in a file of the profile, or -1 if the file is not in the
+ *          profile or the location is unknown. */
+double profileGetCount(const t_profile *profile, t_fileLocation loc);
+
+/** Return how many times each basic block of a graph was executed. The
+ *  count of a block is the largest count of the lines of its instructions,
+ *  but no more than the sum of the counts of its predecessors, since the
+ *  instructions moved out of a loop keep the line they come from. The first
+ *  block is also entered once when the program starts.
+ *  @param profile The profile.
+ *  @param graph   The control flow graph.
+ *  @return A dynamically allocated array with the count of each block,
+ *          indexed by its `livenessIndex', or -1 if the count is unknown.
+ *          The caller is responsible for freeing it. */
+double *profileGetBlockCounts(const t_profile *profile, t_cfg *graph);
+
+/**
+ * @}
+ */
+
+#endif
@@ -12,11 +12,15 @@
 #include "target_asm_print.h"
 
 
-static t_label *newLabel(unsigned int value)
+/* Instructions and their arguments, which may be created before being added
+ * to a program */
+static t_pool instructionPool = POOL_INITIALIZER(t_instruction);
+static t_pool instrArgPool = POOL_INITIALIZER(t_instrArg);
+
+
+static t_label *newLabel(t_program *program, unsigned int value)
 {
-  t_label *result = (t_label *)malloc(sizeof(t_label));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_label *result = arenaAlloc(&program->arena, sizeof(t_label));
   result->labelID = value;
   result->name = NULL;
   result->global = 0;
@@ -24,29 +28,120 @@ static t_label *newLabel(unsigned int value)
   return result;
 }
 
-void deleteLabel(t_label *lab)
+
+/// Entry of the hash table of the label names.
+struct t_labelName {
+  char *name;           ///< The name of the label.
+  unsigned int labelID; ///< The identifier of the label.
+  t_labelName *next;    ///< The next entry in the same bucket, or NULL.
+};
+
+static unsigned int hashLabelName(const char *name)
 {
-  free(lab->name);
-  free(lab);
+  // FNV-1a
+  unsigned int hash = 2166136261U;
+  for (const char *p = name; *p != '\0'; p++)
+    hash = (hash ^ (unsigned char)*p) * 16777619U;
+  return hash;
 }
 
-void deleteLabels(t_listNode *labels)
+/* Returns true if a label with another identifier than the given one has
+ * the given name in the hash table. */
+static bool isLabelNameTaken(
+    t_program *program, const char *name, unsigned int labelID)
 {
-  t_listNode *curNode = labels;
-  while (curNode != NULL) {
-    t_label *curLabel = (t_label *)curNode->data;
-    deleteLabel(curLabel);
-    curNode = curNode->next;
+  if (program->labelNamesSize == 0)
+    return false;
+  unsigned int bucket = hashLabelName(name) & (program->labelNamesSize - 1);
+  for (t_labelName *entry = program->labelNames[bucket]; entry != NULL;
+       entry = entry->next) {
+    if (entry->labelID != labelID && strcmp(entry->name, name) == 0)
+      return true;
+  }
+  return false;
+}
+
+static void addLabelName(
+    t_program *program, const char *name, unsigned int labelID)
+{
+  // Keep the load factor at most 1 by doubling the number of buckets, which
+  // is always a power of two.
+  if (program->numLabelNames >= program->labelNamesSize) {
+    unsigned int newSize =
+        program->labelNamesSize ? program->labelNamesSize * 2 : 64;
+    t_labelName **newTable = calloc(newSize, sizeof(t_labelName *));
+    if (newTable == NULL)
+      fatalError("out of memory");
+    for (unsigned int i = 0; i < program->labelNamesSize; i++) {
+      t_labelName *entry = program->labelNames[i];
+      while (entry != NULL) {
+        t_labelName *next = entry->next;
+        unsigned int bucket = hashLabelName(entry->name) & (newSize - 1);
+        entry->next = newTable[bucket];
+        newTable[bucket] = entry;
+        entry = next;
+      }
+    }
+    free(program->labelNames);
+    program->labelNames = newTable;
+    program->labelNamesSize = newSize;
   }
-  deleteList(labels);
+
+  t_labelName *entry = arenaAlloc(&program->arena, sizeof(t_labelName));
+  entry->name = arenaStrdup(&program->arena, name);
+  entry->labelID = labelID;
+  unsigned int bucket = hashLabelName(name) & (program->labelNamesSize - 1);
+  entry->next = program->labelNames[bucket];
+  program->labelNames[bucket] = entry;
+  program->numLabelNames++;
 }
 
+static void removeLabelName(
+    t_program *program, const char *name, unsigned int labelID)
+{
+  if (program->labelNamesSize == 0)
+    return;
+  unsigned int bucket = hashLabelName(name) & (program->labelNamesSize - 1);
+  t_labelName **link = &program->labelNames[bucket];
+  while (*link != NULL) {
+    t_labelName *entry = *link;
+    if (entry->labelID == labelID && strcmp(entry->name, name) == 0) {
+      *link = entry->next;
+      program->numLabelNames--;
+      return;
+    }
+    link = &entry->next;
+  }
+}
+
+/* Returns true if a label with another identifier than the given one has
+ * the given name, either set explicitly or generated by getLabelName(). */
+static bool isLabelNameUsed(
+    t_program *program, const char *name, unsigned int labelID)
+{
+  if (isLabelNameTaken(program, name, labelID))
+    return true;
+
+  // Check if the name is the one generated for an unnamed label.
+  if (name[0] != 'l' || name[1] != '_' || !isdigit(name[2]))
+    return false;
+  char *end;
+  unsigned long otherID = strtoul(name + 2, &end, 10);
+  if (*end != '\0' || otherID == labelID ||
+      otherID >= program->firstUnusedLblID)
+    return false;
+  t_listNode *others = program->labelIDs[otherID].labels;
+  if (others == NULL || ((t_label *)others->data)->name != NULL)
+    return false;
+  // The number must be written the same way, without leading zeros.
+  char generated[24];
+  snprintf(generated, sizeof(generated), "l_%lu", otherID);
+  return strcmp(generated, name) == 0;
+}
 
 t_instrArg *newInstrArg(t_regID ID)
 {
-  t_instrArg *result = (t_instrArg *)malloc(sizeof(t_instrArg));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_instrArg *result = poolAlloc(&instrArgPool);
   result->ID = ID;
   result->mcRegWhitelist = NULL;
   return result;
@@ -54,9 +149,7 @@ t_instrArg *newInstrArg(t_regID ID)
 
 t_instruction *newInstruction(int opcode)
 {
-  t_instruction *result = (t_instruction *)malloc(sizeof(t_instruction));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_instruction *result = poolAlloc(&instructionPool);
   result->opcode = opcode;
   result->rDest = NULL;
   result->rSrc1 = NULL;
@@ -65,27 +158,27 @@ t_instruction *newInstruction(int opcode)
   result->label = NULL;
   result->addressParam = NULL;
   result->comment = NULL;
+  result->source = nullFileLocation;
   return result;
 }
 
+void deleteInstrArg(t_instrArg *arg)
+{
+  if (arg == NULL)
+    return;
+  deleteList(arg->mcRegWhitelist);
+  poolFree(&instrArgPool, arg);
+}
+
 void deleteInstruction(t_instruction *inst)
 {
   if (inst == NULL)
     return;
-  if (inst->rDest != NULL) {
-    deleteList(inst->rDest->mcRegWhitelist);
-    free(inst->rDest);
-  }
-  if (inst->rSrc1 != NULL) {
-    deleteList(inst->rSrc1->mcRegWhitelist);
-    free(inst->rSrc1);
-  }
-  if (inst->rSrc2 != NULL) {
-    deleteList(inst->rSrc2->mcRegWhitelist);
-    free(inst->rSrc2);
-  }
-  free(inst->comment);
-  free(inst);
+  deleteInstrArg(inst->rDest);
+  deleteInstrArg(inst->rSrc1);
+  deleteInstrArg(inst->rSrc2);
+  // The comment belongs to the arena of the program.
+  poolFree(&instructionPool, inst);
 }
 
 void deleteInstructions(t_listNode *instructions)
@@ -104,11 +197,10 @@ void deleteInstructions(t_listNode *instructions)
 }
 
 
-t_symbol *newSymbol(char *ID, t_symbolType type, int arraySize)
+static t_symbol *newSymbol(
+    t_program *program, char *ID, t_symbolType type, int arraySize)
 {
-  t_symbol *result = (t_symbol *)malloc(sizeof(t_symbol));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_symbol *result = arenaAlloc(&program->arena, sizeof(t_symbol));
   result->type = type;
   result->arraySize = arraySize;
   result->ID = ID;
@@ -119,7 +211,6 @@ t_symbol *newSymbol(char *ID, t_symbolType type, int arraySize)
 static void deleteSymbol(t_symbol *s)
 {
   free(s->ID);
-  free(s);
 }
 
 static void deleteSymbols(t_listNode *variables)
@@ -149,6 +240,12 @@ t_program *newProgram(void)
   result->labels = NULL;
   result->firstUnusedLblID = 0;
   result->pendingLabel = NULL;
+  result->labelIDs = NULL;
+  result->labelIDsSize = 0;
+  result->labelNames = NULL;
+  result->labelNamesSize = 0;
+  result->numLabelNames = 0;
+  result->arena = (t_arena){NULL};
 
   // Create the start label.
   t_label *lStart = createLabel(result);
@@ -165,18 +262,41 @@ void deleteProgram(t_program *program)
     return;
   deleteSymbols(program->symbols);
   deleteInstructions(program->instructions);
-  deleteLabels(program->labels);
+  deleteList(program->labels);
+  for (unsigned int i = 0; i < program->firstUnusedLblID; i++)
+    deleteList(program->labelIDs[i].labels);
+  free(program->labelIDs);
+  free(program->labelNames);
+  deleteArena(&program->arena);
   free(program);
 }
 
 
 t_label *createLabel(t_program *program)
 {
-  t_label *result = newLabel(program->firstUnusedLblID);
+  t_label *result = newLabel(program, program->firstUnusedLblID);
   if (result == NULL)
     fatalError("out of memory");
   program->firstUnusedLblID++;
   program->labels = listInsert(program->labels, result, -1);
+
+  // Make room for the new identifier in the table of the identifiers.
+  if (result->labelID >= program->labelIDsSize) {
+    unsigned int newSize =
+        program->labelIDsSize ? program->labelIDsSize * 2 : 64;
+    t_labelIDInfo *newTable =
+        realloc(program->labelIDs, sizeof(t_labelIDInfo) * newSize);
+    if (newTable == NULL)
+      fatalError("out of memory");
+    for (unsigned int i = program->labelIDsSize; i < newSize; i++) {
+      newTable[i].labels = NULL;
+      newTable[i].assigned = false;
+    }
+    program->labelIDs = newTable;
+    program->labelIDsSize = newSize;
+  }
+  t_labelIDInfo *info = &program->labelIDs[result->labelID];
+  info->labels = listInsert(info->labels, result, -1);
   return result;
 }
 
@@ -185,21 +305,23 @@ void setRawLabelName(t_program *program, t_label *label, const char *finalName)
 {
   t_listNode *i;
 
-  // Check the entire list of labels because there might be two
-  // label objects with the same ID and they need to be kept in sync.
-  for (i = program->labels; i != NULL; i = i->next) {
+  // Change all the label objects with the same ID, because they need to be
+  // kept in sync.
+  t_labelIDInfo *info = &program->labelIDs[label->labelID];
+  for (i = info->labels; i != NULL; i = i->next) {
     t_label *thisLab = i->data;
 
-    if (thisLab->labelID == label->labelID) {
-      // Found! Remove old name.
-      free(thisLab->name);
-      // Change to new name.
-      if (finalName)
-        thisLab->name = strdup(finalName);
-      else
-        thisLab->name = NULL;
-    }
+    // Remove old name.
+    if (thisLab->name)
+      removeLabelName(program, thisLab->name, thisLab->labelID);
+    // Change to new name. The old one stays in the arena of the program.
+    if (finalName)
+      thisLab->name = arenaStrdup(&program->arena, finalName);
+    else
+      thisLab->name = NULL;
   }
+  if (finalName)
+    addLabelName(program, finalName, label->labelID);
 }
 
 void setLabelName(t_program *program, t_label *label, const char *name)
@@ -221,29 +343,8 @@ void setLabelName(t_program *program, t_label *label, const char *name)
     fatalError("out of memory");
   snprintf(finalName, allocatedSpace, "%s", sanitizedName);
   int serial = -1;
-  bool ok;
-  do {
-    t_listNode *i;
-    ok = true;
-    for (i = program->labels; i != NULL; i = i->next) {
-      t_label *thisLab = i->data;
-      char *thisLabName;
-      int difference;
-
-      if (thisLab->labelID == label->labelID)
-        continue;
-
-      thisLabName = getLabelName(thisLab);
-      difference = strcmp(finalName, thisLabName);
-      free(thisLabName);
-
-      if (difference == 0) {
-        ok = false;
-        snprintf(finalName, allocatedSpace, "%s_%d", sanitizedName, ++serial);
-        break;
-      }
-    }
-  } while (!ok);
+  while (isLabelNameUsed(program, finalName, label->labelID))
+    snprintf(finalName, allocatedSpace, "%s_%d", sanitizedName, ++serial);
 
   free(sanitizedName);
   setRawLabelName(program, label, finalName);
@@ -253,11 +354,8 @@ void setLabelName(t_program *program, t_label *label, const char *name)
 void assignLabel(t_program *program, t_label *label)
 {
   // Check if this label has already been assigned.
-  for (t_listNode *li = program->instructions; li != NULL; li = li->next) {
-    t_instruction *instr = li->data;
-    if (instr->label && instr->label->labelID == label->labelID)
-      fatalError("bug: label already assigned");
-  }
+  if (program->labelIDs[label->labelID].assigned)
+    fatalError("bug: label already assigned");
 
   // Test if the next instruction already has a label.
   if (program->pendingLabel != NULL) {
@@ -275,8 +373,14 @@ void assignLabel(t_program *program, t_label *label)
     if (name)
       name = strdup(name);
 
-    // Change ID and name.
+    // Change ID and name. The old ID is left with no label objects.
+    t_labelIDInfo *oldInfo = &program->labelIDs[label->labelID];
+    if (label->name)
+      removeLabelName(program, label->name, label->labelID);
+    oldInfo->labels = listFindAndRemove(oldInfo->labels, label);
     label->labelID = (program->pendingLabel)->labelID;
+    t_labelIDInfo *newInfo = &program->labelIDs[label->labelID];
+    newInfo->labels = listInsert(newInfo->labels, label, -1);
     setRawLabelName(program, label, name);
 
     // Promote both labels to global if at least one is global.
@@ -316,6 +420,8 @@ void addInstruction(t_program *program, t_instruction *instr)
   // Assign the currently pending label if there is one.
   instr->label = program->pendingLabel;
   program->pendingLabel = NULL;
+  if (instr->label)
+    program->labelIDs[instr->label->labelID].assigned = true;
 
   // Add a comment with the line number.
   if (curFileLoc.row >= 0 &&
@@ -323,13 +429,13 @@ void addInstruction(t_program *program, t_instruction *instr)
           curFileLoc.row != lastFileLoc.row)) {
     size_t fileNameLen = strlen(curFileLoc.file);
     size_t strBufSz = fileNameLen + 10 + 1;
-    instr->comment = calloc(strBufSz, sizeof(char));
-    if (instr->comment) {
-      snprintf(instr->comment, strBufSz, "%s:%d", curFileLoc.file,
-          curFileLoc.row + 1);
-    }
+    instr->comment = arenaAlloc(&program->arena, strBufSz);
+    snprintf(instr->comment, strBufSz, "%s:%d", curFileLoc.file,
+        curFileLoc.row + 1);
   }
   lastFileLoc = curFileLoc;
+  if (curFileLoc.row >= 0)
+    instr->source = curFileLoc;
 
   // Update the list of instructions.
   program->instructions = listInsert(program->instructions, instr, -1);
@@ -362,8 +468,10 @@ void removeInstructionAt(t_program *program, t_listNode *instrLi)
 {
   t_instruction *instrToRemove = (t_instruction *)instrLi->data;
 
-  // Move the label and/or the comment to the next instruction.
-  if (instrToRemove->label || instrToRemove->comment) {
+  // Move the label, the comment and/or the source location to the next
+  // instruction.
+  if (instrToRemove->label || instrToRemove->comment ||
+      instrToRemove->source.file) {
     // Find the next instruction, if it exists.
     t_listNode *nextPos = instrLi->next;
     t_instruction *nextInst = NULL;
@@ -388,6 +496,11 @@ void removeInstructionAt(t_program *program, t_listNode *instrLi)
       nextInst->comment = instrToRemove->comment;
       instrToRemove->comment = NULL;
     }
+
+    // Move the source location, so that the code which replaces an
+    // instruction is attributed to the same statement.
+    if (nextInst && !nextInst->source.file)
+      nextInst->source = instrToRemove->source;
   }
 
   // Remove the instruction.
@@ -423,7 +536,7 @@ t_symbol *createSymbol(
   }
 
   // Allocate and initialize a new symbol object.
-  t_symbol *res = newSymbol(ID, type, arraySize);
+  t_symbol *res = newSymbol(program, ID, type, arraySize);
 
   // Reserve a new label for the variable.
   res->label = createLabel(program);
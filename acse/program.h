@@ -7,6 +7,8 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include "list.h"
+#include "errors.h"
+#include "arena.h"
 
 /**
  * @defgroup program Program Intermediate Representation
@@ -77,6 +79,9 @@ typedef struct {
   t_label *addressParam; ///< Address argument.
   /// A comment string associated with the instruction, or NULL if none.
   char *comment;
+  /// Location in the source code of the statement the instruction was
+  /// generated from, or nullFileLocation if unknown.
+  t_fileLocation source;
 } t_instruction;
 
 /** A structure that represents the properties of a given symbol in the source
@@ -93,6 +98,18 @@ typedef struct t_symbol {
   int arraySize;
 } t_symbol;
 
+/** Information about a label identifier. */
+typedef struct {
+  /// List of the label objects with this identifier: the label created with
+  /// it and its aliases.
+  t_listNode *labels;
+  /// True if the label has already been assigned to an instruction.
+  bool assigned;
+} t_labelIDInfo;
+
+/// Entry of the hash table of the label names of a program.
+typedef struct t_labelName t_labelName;
+
 /** Object containing the program's intermediate representation during the
  * compilation process. */
 typedef struct {
@@ -102,6 +119,20 @@ typedef struct {
   t_regID firstUnusedReg;        ///< Next unused register ID.
   unsigned int firstUnusedLblID; ///< Next unused label ID.
   t_label *pendingLabel;         ///< Next pending label to assign.
+  /// Information about each label identifier, indexed by identifier.
+  t_labelIDInfo *labelIDs;
+  /// Number of elements allocated in the `labelIDs' array.
+  unsigned int labelIDsSize;
+  /// Hash table of the names of the labels, with their identifier. Only the
+  /// names set explicitly are in the table.
+  t_labelName **labelNames;
+  /// Number of buckets in the `labelNames' hash table.
+  unsigned int labelNamesSize;
+  /// Number of entries in the `labelNames' hash table.
+  unsigned int numLabelNames;
+  /// Memory of the labels, their names, the symbols and the comments of the
+  /// instructions, which is released all together with the program.
+  t_arena arena;
 } t_program;
 
 
@@ -156,6 +187,15 @@ char *getLabelName(t_label *label);
  * @returns The identifier of the register. */
 t_regID getNewRegister(t_program *program);
 
+/** Allocate a new register argument for an instruction.
+ * @param ID The identifier of the register.
+ * @returns The new argument, with no whitelist of machine registers. */
+t_instrArg *newInstrArg(t_regID ID);
+
+/** Free a register argument allocated by newInstrArg() or genInstruction().
+ * @param arg The argument to free. If NULL, the function does nothing. */
+void deleteInstrArg(t_instrArg *arg);
+
 /** Add a new instruction at the end the current program's list of instructions.
  * @param program   The program where to add the instruction.
  * @param opcode    Identifier for the operation performed by the instruction.
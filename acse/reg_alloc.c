@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include "reg_alloc.h"
@@ -13,6 +14,8 @@
 #include "list.h"
 #include "cfg.h"
 #include "target_asm_print.h"
+#include "time_report.h"
+#include "profile.h"
 
 /// Maximum amount of arguments to an instruction.
 #define MAX_INSTR_ARGS (CFG_MAX_DEFS + CFG_MAX_USES)
@@ -22,37 +25,180 @@
 /// Fictitious register ID marking currently unallocated temporaries.
 #define RA_REGISTER_INVALID ((t_regID)(-1))
 
+/// Maximum number of nodes examined when looking for the next use of a
+/// register held in a spill register.
+#define RA_SPILL_LOOKAHEAD 256
+
+/// Set of physical registers, where the bit in position N is set if the
+/// register with identifier N belongs to the set. All the physical registers
+/// of the target must fit in it.
+typedef uint32_t t_regMask;
+
+/// Returns the set which contains only the given physical register.
+#define REG_MASK(reg) ((t_regMask)1 << (reg))
+
 
 /// Structure describing a live interval of a register in a program.
 typedef struct {
   /// Identifier of the register.
   t_regID tempRegID;
-  /// List of all physical registers where this temporary register can be
-  /// allocated.
-  t_listNode *mcRegConstraints;
+  /// Set of all physical registers where this temporary register can be
+  /// allocated. It is empty if the register has no constraints yet.
+  t_regMask mcRegConstraints;
+  /// The registers in `mcRegConstraints', in order of preference.
+  uint8_t mcRegOrder[NUM_REGISTERS];
   /// Index of the first instruction that uses/defines this register.
   int startPoint;
   /// Index of the last instruction that uses/defines this register.
   int endPoint;
+  /// Number of executions of the uses and definitions of the register in
+  /// the profile, which is the cost of spilling it. Only computed when
+  /// there is a profile.
+  double spillCost;
 } t_liveInterval;
 
-/// Structure used for mapping a spilled temporary register to the label
-/// pointing to its physical storage location in memory.
+/// Structure used for collecting the function calls in a program, together
+/// with the registers which are clobbered by each of them.
 typedef struct {
-  /// The spilled temporary register ID.
-  t_regID tempRegID;
-  /// The label pointing to the spill area.
-  t_label *label;
-} t_spillLocation;
+  /// Number of calls found.
+  int numCalls;
+  /// Number of elements allocated in the arrays.
+  int size;
+  /// Index of the node of each call, in ascending order.
+  int *nodeIndexes;
+  /// Registers clobbered by each call.
+  t_regMask *clobbered;
+} t_callClobbers;
+
+/// Set of the live intervals which are allocated to a register at the
+/// current point of the linear scan.
+typedef struct {
+  /// Number of active intervals.
+  int numIntervals;
+  /// The active intervals, ordered by ascending end point. Each of them is
+  /// allocated to a different physical register, so there cannot be more of
+  /// them than registers.
+  t_liveInterval *intervals[NUM_REGISTERS];
+} t_activeIntervals;
+
+/// Node of the interference graph used by the graph coloring allocator.
+/// There is a node for each temporary register identifier.
+typedef struct {
+  /// True if the node corresponds to a temporary register of the program
+  /// which needs to be allocated.
+  bool present;
+  /// True if the register has a whitelist in the program. Such registers are
+  /// colored first and never spilled, as the spill registers are not in any
+  /// whitelist.
+  bool whitelisted;
+  /// True if the node has been removed from the graph by the simplification.
+  bool removed;
+  /// True if the node is in the simplification worklist.
+  bool inWorklist;
+  /// The node this node was coalesced into, or the node itself.
+  t_regID alias;
+  /// Set of the physical registers where the register can be allocated.
+  t_regMask allowed;
+  /// Number of neighbors still in the graph.
+  int degree;
+  /// Neighbors of the node. The entries of the nodes which were coalesced
+  /// into other nodes are stale, and they must be skipped.
+  t_regID *adj;
+  /// Number of elements in the `adj' array.
+  int numAdj;
+  /// Number of elements allocated for the `adj' array.
+  int sizeAdj;
+  /// Indexes of the moves which involve this node or one of the nodes
+  /// coalesced into it.
+  int *moves;
+  /// Number of elements in the `moves' array.
+  int numMoves;
+  /// Number of elements allocated for the `moves' array.
+  int sizeMoves;
+  /// Estimated cost of spilling the register: the number of its uses and
+  /// definitions, each weighted by the number of executions of its block in
+  /// the profile, or else by the depth of the loops containing it.
+  double spillCost;
+  /// Physical register assigned to the node, RA_SPILL_REQUIRED for spilled
+  /// nodes, or RA_REGISTER_INVALID if the node was not colored yet.
+  t_regID color;
+} t_igNode;
+
+/// Instruction which copies a temporary register into another one.
+typedef struct {
+  /// The destination register.
+  t_regID dest;
+  /// The source register.
+  t_regID src;
+  /// Estimated execution frequency of the instruction.
+  double weight;
+  /// Position of the instruction in the program.
+  int index;
+} t_igMove;
+
+/// Interference graph of the temporary registers of a program.
+typedef struct {
+  /// Number of elements in the `nodes' array.
+  int numNodes;
+  /// The nodes of the graph, indexed by temporary register identifier.
+  t_igNode *nodes;
+  /// Number of elements in the `moves' array.
+  int numMoves;
+  /// Number of elements allocated for the `moves' array.
+  int sizeMoves;
+  /// The moves between temporary registers, by descending weight after the
+  /// graph is built.
+  t_igMove *moves;
+  /// Hash set of the edges of the graph, with open addressing. Each element
+  /// is the key returned by igEdgeKey(), or zero for empty slots.
+  uint64_t *edges;
+  /// Number of slots in the `edges' array, always a power of two.
+  size_t edgesSize;
+  /// Number of edges in the `edges' set.
+  size_t numEdges;
+  /// Marks used for visiting each neighbor of a pair of nodes only once,
+  /// indexed by register identifier.
+  int *marks;
+  /// Mark not yet used in the `marks' array.
+  int curMark;
+  /// Number of nodes coalesced into other ones.
+  int numCoalesced;
+} t_interferenceGraph;
+
+/// Set of registers with constant time insertion, removal and membership
+/// test, and iteration proportional to the number of elements.
+typedef struct {
+  /// The elements of the set, in no particular order.
+  t_regID *members;
+  /// Position of each element in `members', indexed by register identifier.
+  /// The positions of the registers not in the set are not meaningful.
+  int *positions;
+  /// Number of elements in the set.
+  int numMembers;
+} t_sparseRegSet;
 
 /// Structure encapsulating the state of the register allocator.
 struct t_regAllocator {
+  /// The algorithm used for the allocation.
+  t_regAllocAlgorithm algorithm;
   /// The program where register allocation needs to be performed.
   t_program *program;
   /// The temporary control flow graph produced from the program.
   t_cfg *graph;
-  /// List of live intervals, ordered depending on their start index.
-  t_listNode *liveIntervals;
+  /// Execution counts of a previous run of the program, or NULL.
+  const t_profile *profile;
+  /// Number of executions of each block of the graph in the profile, indexed
+  /// by `livenessIndex', or NULL if there is no profile.
+  double *blockCounts;
+  /// Array of the live intervals, indexed by temporary register identifier.
+  /// The intervals of the registers which do not appear in the program have
+  /// a negative start point.
+  t_liveInterval *intervalsByReg;
+  /// Array of pointers to the live intervals, ordered depending on their
+  /// start index.
+  t_liveInterval **liveIntervals;
+  /// Number of elements in the `liveIntervals' array.
+  int numLiveIntervals;
   /// Number of temporary registers in the program.
   int tempRegNum;
   /// Pointer to a dynamically allocated array which maps every temporary
@@ -60,8 +206,17 @@ struct t_regAllocator {
   /// Temporary registers allocated to a spill location are marked by the
   /// RA_SPILL_REQUIRED virtual register ID.
   t_regID *bindings;
-  /// List of spill locations for temporary registers in the program.
-  t_listNode *spills;
+  /// Pointer to a dynamically allocated array which maps every spilled
+  /// temporary register to the label pointing to its physical storage
+  /// location in memory, or to NULL if the register is not spilled.
+  t_label **spills;
+  /// Pointer to a dynamically allocated array which maps every spilled
+  /// temporary register whose only definition is a constant or an address
+  /// load to that definition, or to NULL. These registers are recomputed at
+  /// each use instead of being loaded from memory.
+  t_instruction **remats;
+  /// The interference graph, when graph coloring is used.
+  t_interferenceGraph *interference;
 };
 
 /// Structure representing the current state of an instruction argument during
@@ -78,7 +233,8 @@ typedef struct {
 
 /// Structure representing the current state of a spill-reserved register.
 typedef struct {
-  /// Temporary register ID associated to this spill register.
+  /// Temporary register ID associated to this spill register, or
+  /// REG_INVALID if the register is free.
   t_regID assignedTempReg;
   /// Non-zero if at least one of the instructions wrote something new into
   /// the spill register, and the value has not been written to the spill
@@ -94,165 +250,209 @@ typedef struct {
 } t_spillState;
 
 
-static t_liveInterval *newLiveInterval(
-    t_regID tempRegID, t_listNode *mcRegs, int startPoint, int endPoint)
+/* Returns the set of the physical registers in a list. */
+static t_regMask listToRegMask(t_listNode *regs)
 {
-  t_liveInterval *result = malloc(sizeof(t_liveInterval));
-  if (result == NULL)
-    fatalError("out of memory");
-  result->tempRegID = tempRegID;
-  result->mcRegConstraints = listClone(mcRegs);
-  result->startPoint = startPoint;
-  result->endPoint = endPoint;
+  t_regMask result = 0;
+  for (; regs; regs = regs->next)
+    result |= REG_MASK(LIST_DATA_TO_INT(regs->data));
   return result;
 }
 
-static void deleteLiveInterval(t_liveInterval *interval)
+static int regMaskCount(t_regMask regs)
 {
-  if (interval == NULL)
-    return;
-  free(interval->mcRegConstraints);
-  free(interval);
+  return __builtin_popcount(regs);
 }
 
-/* Given two live intervals, compare them by the start point (find whichever
- * starts first). */
-static int compareLiveIntStartPoints(void *varA, void *varB)
+/* Replaces the register constraints of an interval with the registers in a
+ * list, preferring them in the same order as in the list. */
+static void setRegisterSet(t_liveInterval *interval, t_listNode *regs)
 {
-  t_liveInterval *liA = (t_liveInterval *)varA;
-  t_liveInterval *liB = (t_liveInterval *)varB;
-
-  if (varA == NULL)
-    return 0;
-  if (varB == NULL)
-    return 0;
-
-  return liA->startPoint - liB->startPoint;
+  interval->mcRegConstraints = 0;
+  int numRegs = 0;
+  for (; regs; regs = regs->next) {
+    t_regID reg = (t_regID)LIST_DATA_TO_INT(regs->data);
+    if (interval->mcRegConstraints & REG_MASK(reg))
+      continue;
+    interval->mcRegConstraints |= REG_MASK(reg);
+    interval->mcRegOrder[numRegs++] = (uint8_t)reg;
+  }
 }
 
-/* Given two live intervals, compare them by the end point (find whichever
- * ends first). */
-static int compareLiveIntEndPoints(void *varA, void *varB)
+/* Move a register to the front of the order of preference of the register
+ * constraints of an interval, if it is one of them. */
+static void preferRegister(t_liveInterval *interval, t_regID reg)
 {
-  t_liveInterval *liA = (t_liveInterval *)varA;
-  t_liveInterval *liB = (t_liveInterval *)varB;
-
-  if (varA == NULL)
-    return 0;
-  if (varB == NULL)
-    return 0;
-
-  return liA->endPoint - liB->endPoint;
+  if (!(interval->mcRegConstraints & REG_MASK(reg)))
+    return;
+  int i = 0;
+  while (interval->mcRegOrder[i] != reg)
+    i++;
+  memmove(&interval->mcRegOrder[1], &interval->mcRegOrder[0], (size_t)i);
+  interval->mcRegOrder[0] = (uint8_t)reg;
 }
 
-/* Given two live intervals, check if they refer to the same interval. */
-static bool compareLiveIntWithRegID(void *a, void *b)
+/* Move the registers in the constraints of interval `a` which are also in the
+ * constraints of interval `b` to the front of the order of preference. */
+static void optimizeRegisterSet(t_liveInterval *a, const t_liveInterval *b)
 {
-  t_liveInterval *interval = (t_liveInterval *)a;
-  t_regID tempRegID = *((t_regID *)b);
-  return interval->tempRegID == tempRegID;
+  int numRegs = regMaskCount(b->mcRegConstraints);
+  for (int i = 0; i < numRegs; i++)
+    preferRegister(a, b->mcRegOrder[i]);
 }
 
-/* Update the liveness interval list to account for the fact that variable 'var'
- * is live at index 'counter' in the current program.
- * If the variable already appears in the list, its live interval its prolonged
- * to include the given counter location.
- * Otherwise, a new liveness interval is generated for it. */
-static t_listNode *updateIntervalsWithLiveVarAtLocation(
-    t_listNode *intervals, t_cfgReg *var, int counter)
+/* Remove a set of registers from the constraints of an interval, keeping the
+ * order of preference of the remaining ones. */
+static void subtractRegisterSet(t_liveInterval *interval, t_regMask regs)
 {
-  // Search if there's already a liveness interval for the variable.
-  t_listNode *element_found = listFindWithCallback(
-      intervals, &(var->tempRegID), compareLiveIntWithRegID);
-
-  if (!element_found) {
-    // It's not there: add a new interval at the end of the list.
-    t_liveInterval *interval =
-        newLiveInterval(var->tempRegID, var->mcRegWhitelist, counter, counter);
-    intervals = listInsert(intervals, interval, -1);
-  } else {
-    // It's there: update the interval range.
-    t_liveInterval *interval_found = (t_liveInterval *)element_found->data;
-    // Counter should always be increasing!
-    assert(interval_found->startPoint <= counter);
-    assert(interval_found->endPoint <= counter);
-    interval_found->endPoint = counter;
+  if (!(interval->mcRegConstraints & regs))
+    return;
+  int numRegs = regMaskCount(interval->mcRegConstraints);
+  int numKept = 0;
+  for (int i = 0; i < numRegs; i++) {
+    t_regID reg = interval->mcRegOrder[i];
+    if (!(regs & REG_MASK(reg)))
+      interval->mcRegOrder[numKept++] = (uint8_t)reg;
   }
-
-  return intervals;
+  interval->mcRegConstraints &= ~regs;
 }
 
-/* Add/augment the live interval list with the variables live at a given
- * instruction location in the program. */
-static t_listNode *updateIntervalsWithInstrAtLocation(
-    t_listNode *result, t_bbNode *node, int counter)
+/* Extends the live interval of a register, stored in an array of intervals
+ * indexed by register identifier, to include the given program point.
+ * If the register has no interval yet, a new one is created for it. */
+static void extendIntervalToLocation(
+    t_liveInterval *intervals, t_cfgReg *var, int counter)
 {
-  t_listNode *elem;
-
-  elem = node->in;
-  while (elem != NULL) {
-    t_cfgReg *curCFGReg = (t_cfgReg *)elem->data;
-    result = updateIntervalsWithLiveVarAtLocation(result, curCFGReg, counter);
-    elem = elem->next;
-  }
-
-  elem = node->out;
-  while (elem != NULL) {
-    t_cfgReg *curCFGReg = (t_cfgReg *)elem->data;
-    result = updateIntervalsWithLiveVarAtLocation(result, curCFGReg, counter);
-    elem = elem->next;
+  t_liveInterval *interval = &intervals[var->tempRegID];
+  if (interval->startPoint < 0) {
+    interval->tempRegID = var->tempRegID;
+    setRegisterSet(interval, var->mcRegWhitelist);
+    interval->startPoint = counter;
+    interval->endPoint = counter;
+    interval->spillCost = 0;
+    return;
   }
+  if (counter < interval->startPoint)
+    interval->startPoint = counter;
+  if (counter > interval->endPoint)
+    interval->endPoint = counter;
+}
 
-  for (int i = 0; i < CFG_MAX_DEFS; i++) {
-    if (node->defs[i])
-      result =
-          updateIntervalsWithLiveVarAtLocation(result, node->defs[i], counter);
-  }
+/* Given two pointers to live intervals, compare them by the start point and
+ * then by register identifier, for qsort(). */
+static int compareLiveIntStartPointsAndIDs(const void *a, const void *b)
+{
+  t_liveInterval *liA = *(t_liveInterval *const *)a;
+  t_liveInterval *liB = *(t_liveInterval *const *)b;
 
-  return result;
+  if (liA->startPoint != liB->startPoint)
+    return liA->startPoint - liB->startPoint;
+  return liA->tempRegID - liB->tempRegID;
 }
 
-static int getLiveIntervalsNodeCallback(
-    t_bbNode *node, int nodeIndex, void *context)
+/* Returns the estimated execution frequency of an instruction, assuming that
+ * each loop is executed ten times. */
+static double loopDepthWeight(int loopDepth)
 {
-  t_listNode **list = (t_listNode **)context;
-  *list = updateIntervalsWithInstrAtLocation(*list, node, nodeIndex);
-  return 0;
+  double weight = 1;
+  for (int i = 0; i < loopDepth && i < 8; i++)
+    weight *= 10;
+  return weight;
 }
 
-/* Collect a list of live intervals from the in/out sets in the CFG.
- * Since cfgIterateNodes passes incrementing counter values to the
- * callback, the list returned from here is already ordered. */
-static t_listNode *getLiveIntervals(t_cfg *graph)
+/* Returns the execution frequency of the instructions of a block: their
+ * count in the profile if there is one, or else an estimate by the loop
+ * depth, which must have been computed. */
+static double blockWeight(t_regAllocator *RA, t_basicBlock *block)
 {
-  t_listNode *result = NULL;
-  cfgIterateNodes(graph, (void *)&result, getLiveIntervalsNodeCallback);
-  return result;
+  if (RA->blockCounts != NULL && RA->blockCounts[block->livenessIndex] >= 0)
+    return RA->blockCounts[block->livenessIndex];
+  return loopDepthWeight(block->loopDepth);
 }
 
-
-/* Move the elements in list `a` which are also contained in list `b` to the
- * front of the list. */
-static t_listNode *optimizeRegisterSet(t_listNode *a, t_listNode *b)
+/* Compute the live interval of every register, and the array of the live
+ * intervals ordered by start point.
+ *   A register is live at a node if it is in the 'in' or 'out' set of the
+ * node, or if it is defined by it. The live interval of a register spans from
+ * the first to the last node where it is live. In a basic block these are
+ * either nodes which use or define the register, or the first and the last
+ * node if the register is live in or out of the block. Therefore the
+ * intervals can be computed from the liveness of the blocks alone, without
+ * the sets of each node. The nodes are numbered in the same order as in
+ * cfgIterateNodes(). */
+static void getLiveIntervals(t_regAllocator *RA)
 {
-  for (; b; b = b->next) {
-    t_listNode *old;
-    if ((old = listFind(a, b->data))) {
-      a = listRemoveNode(a, old);
-      a = listInsert(a, b->data, 0);
+  t_cfg *graph = RA->graph;
+  t_liveInterval *intervals =
+      malloc(sizeof(t_liveInterval) * ((size_t)graph->numRegsByID + 1));
+  if (intervals == NULL)
+    fatalError("out of memory");
+  for (int i = 0; i < graph->numRegsByID; i++)
+    intervals[i].startPoint = -1;
+
+  int counter = 0;
+  t_listNode *curBlockNode = graph->blocks;
+  while (curBlockNode != NULL) {
+    t_basicBlock *curBlock = (t_basicBlock *)curBlockNode->data;
+    int firstNode = counter;
+    double weight = RA->blockCounts ? blockWeight(RA, curBlock) : 0;
+
+    t_listNode *curInnerNode = curBlock->nodes;
+    while (curInnerNode != NULL) {
+      t_bbNode *node = (t_bbNode *)curInnerNode->data;
+      for (int i = 0; i < CFG_MAX_DEFS; i++) {
+        if (node->defs[i]) {
+          extendIntervalToLocation(intervals, node->defs[i], counter);
+          intervals[node->defs[i]->tempRegID].spillCost += weight;
+        }
+      }
+      // The register 'zero' is never live when it is constant.
+      for (int i = 0; i < CFG_MAX_USES; i++) {
+        if (node->uses[i] && !(TARGET_REG_ZERO_IS_CONST &&
+                                 node->uses[i]->tempRegID == REG_0)) {
+          extendIntervalToLocation(intervals, node->uses[i], counter);
+          intervals[node->uses[i]->tempRegID].spillCost += weight;
+        }
+      }
+      counter++;
+      curInnerNode = curInnerNode->next;
     }
+
+    int lastNode = counter - 1;
+    const t_bitset *in = curBlock->in;
+    for (int i = bitsetNext(in, 0); i >= 0; i = bitsetNext(in, i + 1))
+      extendIntervalToLocation(intervals, graph->liveRegs[i], firstNode);
+    const t_bitset *out = curBlock->out;
+    for (int i = bitsetNext(out, 0); i >= 0; i = bitsetNext(out, i + 1))
+      extendIntervalToLocation(intervals, graph->liveRegs[i], lastNode);
+
+    curBlockNode = curBlockNode->next;
   }
-  return a;
-}
 
-static t_listNode *subtractRegisterSets(t_listNode *a, t_listNode *b)
-{
-  for (; b; b = b->next) {
-    a = listFindAndRemove(a, b->data);
+  // Sort the intervals by start point.
+  int numIntervals = 0;
+  for (int i = 0; i < graph->numRegsByID; i++) {
+    if (intervals[i].startPoint >= 0)
+      numIntervals++;
   }
-  return a;
+  t_liveInterval **sorted =
+      malloc(sizeof(t_liveInterval *) * ((size_t)numIntervals + 1));
+  if (sorted == NULL)
+    fatalError("out of memory");
+  numIntervals = 0;
+  for (int i = 0; i < graph->numRegsByID; i++) {
+    if (intervals[i].startPoint >= 0)
+      sorted[numIntervals++] = &intervals[i];
+  }
+  qsort(sorted, (size_t)numIntervals, sizeof(t_liveInterval *),
+      compareLiveIntStartPointsAndIDs);
+
+  RA->intervalsByReg = intervals;
+  RA->liveIntervals = sorted;
+  RA->numLiveIntervals = numIntervals;
 }
 
+
 /* Create register constraint sets for all temporaries that don't have one.
  * This is the main function that makes register allocation with constraints
  * work.
@@ -265,20 +465,20 @@ static t_listNode *subtractRegisterSets(t_listNode *a, t_listNode *b)
  * constraints, but in ACSE this doesn't happen. */
 static void initializeRegisterConstraints(t_regAllocator *ra)
 {
-  t_listNode *i = ra->liveIntervals;
-  for (; i; i = i->next) {
-    t_liveInterval *interval = i->data;
+  t_listNode *allRegs = getListOfGenPurposeMachineRegisters();
+
+  for (int i = 0; i < ra->numLiveIntervals; i++) {
+    t_liveInterval *interval = ra->liveIntervals[i];
     // Skip instructions that already have constraints.
     if (interval->mcRegConstraints)
       continue;
     // Initial set consists of all registers.
-    interval->mcRegConstraints = getListOfGenPurposeMachineRegisters();
+    setRegisterSet(interval, allRegs);
 
     // Scan the temporary registers that are alive together with this one and
     // already have constraints.
-    t_listNode *j = i->next;
-    for (; j; j = j->next) {
-      t_liveInterval *overlappingIval = j->data;
+    for (int j = i + 1; j < ra->numLiveIntervals; j++) {
+      t_liveInterval *overlappingIval = ra->liveIntervals[j];
       if (overlappingIval->startPoint > interval->endPoint)
         break;
       if (!overlappingIval->mcRegConstraints)
@@ -288,112 +488,688 @@ static void initializeRegisterConstraints(t_regAllocator *ra)
         // other temporary register as a destination. Optimize the constraint
         // order to allow allocating source and destination to the same register
         // if possible.
-        interval->mcRegConstraints = optimizeRegisterSet(
-            interval->mcRegConstraints, overlappingIval->mcRegConstraints);
+        optimizeRegisterSet(interval, overlappingIval);
       } else {
         // Another variable (defined after this one) wants to be allocated
         // to a restricted set of registers. Punch a hole in the current
         // variable's set of allowed registers to ensure that this is
         // possible.
-        interval->mcRegConstraints = subtractRegisterSets(
-            interval->mcRegConstraints, overlappingIval->mcRegConstraints);
+        subtractRegisterSet(interval, overlappingIval->mcRegConstraints);
       }
     }
   }
+
+  deleteList(allRegs);
+}
+
+/* Returns the registers whose value is not preserved by a call instruction,
+ * except for the ones where its arguments and its result are allocated. */
+static t_regMask getCallClobberedRegisters(t_bbNode *node)
+{
+  t_listNode *callerSaveRegs = getListOfCallerSaveMachineRegisters();
+  t_regMask clobberedRegs = listToRegMask(callerSaveRegs);
+  deleteList(callerSaveRegs);
+  for (int i = 0; i < CFG_MAX_DEFS; i++) {
+    if (node->defs[i] != NULL)
+      clobberedRegs &= ~listToRegMask(node->defs[i]->mcRegWhitelist);
+  }
+  for (int i = 0; i < CFG_MAX_USES; i++) {
+    if (node->uses[i] != NULL)
+      clobberedRegs &= ~listToRegMask(node->uses[i]->mcRegWhitelist);
+  }
+  return clobberedRegs;
 }
 
 static int handleCallerSaveRegistersNodeCallback(
     t_bbNode *node, int nodeIndex, void *context)
 {
-  t_regAllocator *ra = (t_regAllocator *)context;
+  t_callClobbers *calls = (t_callClobbers *)context;
 
   if (!isCallInstruction(node->instr))
     return 0;
 
-  t_listNode *clobberedRegs = getListOfCallerSaveMachineRegisters();
-  for (int i = 0; i < CFG_MAX_DEFS; i++) {
-    if (node->defs[i] != NULL)
-      clobberedRegs =
-          subtractRegisterSets(clobberedRegs, node->defs[i]->mcRegWhitelist);
+  t_regMask clobberedRegs = getCallClobberedRegisters(node);
+
+  if (calls->numCalls == calls->size) {
+    calls->size = calls->size ? calls->size * 2 : 64;
+    calls->nodeIndexes =
+        realloc(calls->nodeIndexes, sizeof(int) * (size_t)calls->size);
+    calls->clobbered =
+        realloc(calls->clobbered, sizeof(t_regMask) * (size_t)calls->size);
+    if (calls->nodeIndexes == NULL || calls->clobbered == NULL)
+      fatalError("out of memory");
   }
-  for (int i = 0; i < CFG_MAX_USES; i++) {
-    if (node->uses[i] != NULL)
-      clobberedRegs =
-          subtractRegisterSets(clobberedRegs, node->uses[i]->mcRegWhitelist);
+  calls->nodeIndexes[calls->numCalls] = nodeIndex;
+  calls->clobbered[calls->numCalls] = clobberedRegs;
+  calls->numCalls++;
+  return 0;
+}
+
+/* Restrict register constraints in order to avoid register corrupted by
+ * function calls.
+ *   The calls are collected first, in order of node index. Then the calls
+ * inside each live interval are found with a binary search, instead of
+ * testing every interval against every call. */
+static void handleCallerSaveRegisters(t_regAllocator *ra, t_cfg *cfg)
+{
+  t_callClobbers calls = {0, 0, NULL, NULL};
+  cfgIterateNodes(cfg, (void *)&calls, handleCallerSaveRegistersNodeCallback);
+
+  for (int i = 0; i < ra->numLiveIntervals; i++) {
+    t_liveInterval *ival = ra->liveIntervals[i];
+
+    // Find the first call at or after the start of the interval.
+    int low = 0;
+    int high = calls.numCalls;
+    while (low < high) {
+      int mid = low + (high - low) / 2;
+      if (calls.nodeIndexes[mid] < ival->startPoint)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    t_regMask clobberedRegs = 0;
+    for (int j = low;
+         j < calls.numCalls && calls.nodeIndexes[j] <= ival->endPoint; j++)
+      clobberedRegs |= calls.clobbered[j];
+    subtractRegisterSet(ival, clobberedRegs);
   }
 
-  t_listNode *li_ival = ra->liveIntervals;
-  while (li_ival) {
-    t_liveInterval *ival = li_ival->data;
+  free(calls.nodeIndexes);
+  free(calls.clobbered);
+}
+
 
-    if (ival->startPoint <= nodeIndex && nodeIndex <= ival->endPoint) {
-      ival->mcRegConstraints =
-          subtractRegisterSets(ival->mcRegConstraints, clobberedRegs);
+/* Appends an element to a dynamically allocated array of integers, growing
+ * it if needed. */
+static void appendToArray(int **array, int *num, int *size, int value)
+{
+  if (*num == *size) {
+    *size = *size ? *size * 2 : 4;
+    *array = realloc(*array, sizeof(int) * (size_t)*size);
+    if (*array == NULL)
+      fatalError("out of memory");
+  }
+  (*array)[(*num)++] = value;
+}
+
+/* Returns whether a node copies a temporary register into another one. */
+static bool isMoveNode(t_bbNode *node)
+{
+  t_instruction *instr = node->instr;
+  if (instr->opcode != OPC_ADDI || instr->immediate != 0 ||
+      instr->addressParam != NULL)
+    return false;
+  if (node->defs[0] == NULL || node->uses[0] == NULL || node->uses[1] != NULL)
+    return false;
+  if (TARGET_REG_ZERO_IS_CONST && node->uses[0]->tempRegID == REG_0)
+    return false;
+  return node->defs[0] != node->uses[0];
+}
+
+/* Returns the key of the edge between two nodes in the hash set of the
+ * edges. The key of an edge never is zero. */
+static uint64_t igEdgeKey(t_regID a, t_regID b)
+{
+  if (a > b) {
+    t_regID tmp = a;
+    a = b;
+    b = tmp;
+  }
+  return (((uint64_t)a << 32) | (uint32_t)b) + 1;
+}
+
+/* Returns the slot of an edge in the hash set of the edges: either the slot
+ * where the edge is, or the empty slot where it would be inserted. */
+static size_t igFindEdgeSlot(
+    uint64_t *edges, size_t edgesSize, uint64_t key)
+{
+  size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) &
+      (edgesSize - 1);
+  while (edges[slot] != 0 && edges[slot] != key)
+    slot = (slot + 1) & (edgesSize - 1);
+  return slot;
+}
+
+static bool igInterfere(t_interferenceGraph *g, t_regID a, t_regID b)
+{
+  uint64_t key = igEdgeKey(a, b);
+  return g->edges[igFindEdgeSlot(g->edges, g->edgesSize, key)] == key;
+}
+
+/* Adds an edge between two nodes, if it is not already in the graph. */
+static void igAddEdge(t_interferenceGraph *g, t_regID a, t_regID b)
+{
+  if (a == b)
+    return;
+  uint64_t key = igEdgeKey(a, b);
+  size_t slot = igFindEdgeSlot(g->edges, g->edgesSize, key);
+  if (g->edges[slot] == key)
+    return;
+
+  g->edges[slot] = key;
+  g->numEdges++;
+  // Keep the hash set at most half full.
+  if (g->numEdges * 2 > g->edgesSize) {
+    size_t newSize = g->edgesSize * 2;
+    uint64_t *newEdges = calloc(newSize, sizeof(uint64_t));
+    if (newEdges == NULL)
+      fatalError("out of memory");
+    for (size_t i = 0; i < g->edgesSize; i++) {
+      if (g->edges[i] != 0)
+        newEdges[igFindEdgeSlot(newEdges, newSize, g->edges[i])] = g->edges[i];
     }
+    free(g->edges);
+    g->edges = newEdges;
+    g->edgesSize = newSize;
+  }
 
-    li_ival = li_ival->next;
+  t_igNode *nodeA = &g->nodes[a];
+  t_igNode *nodeB = &g->nodes[b];
+  appendToArray(&nodeA->adj, &nodeA->numAdj, &nodeA->sizeAdj, b);
+  appendToArray(&nodeB->adj, &nodeB->numAdj, &nodeB->sizeAdj, a);
+  nodeA->degree++;
+  nodeB->degree++;
+}
+
+/* Returns the node which represents a node after coalescing. */
+static t_regID igFind(t_interferenceGraph *g, t_regID node)
+{
+  t_regID root = node;
+  while (g->nodes[root].alias != root)
+    root = g->nodes[root].alias;
+  while (g->nodes[node].alias != root) {
+    t_regID next = g->nodes[node].alias;
+    g->nodes[node].alias = root;
+    node = next;
   }
+  return root;
+}
 
-  return 0;
+/* Returns whether the entry of a neighbor of a node refers to a node which is
+ * still in the graph. */
+static bool igIsValidNeighbor(t_interferenceGraph *g, t_regID neighbor)
+{
+  t_igNode *node = &g->nodes[neighbor];
+  return node->alias == neighbor && !node->removed;
 }
 
-/* Restrict register constraints in order to avoid register corrupted by
- * function calls. */
-static void handleCallerSaveRegisters(t_regAllocator *ra, t_cfg *cfg)
+static int compareMoveWeights(const void *a, const void *b)
 {
-  cfgIterateNodes(cfg, (void *)ra, handleCallerSaveRegistersNodeCallback);
+  const t_igMove *moveA = (const t_igMove *)a;
+  const t_igMove *moveB = (const t_igMove *)b;
+
+  if (moveA->weight != moveB->weight)
+    return moveA->weight < moveB->weight ? 1 : -1;
+  return moveA->index - moveB->index;
 }
 
+static bool sparseRegSetContains(const t_sparseRegSet *set, t_regID reg)
+{
+  int pos = set->positions[reg];
+  return pos < set->numMembers && set->members[pos] == reg;
+}
 
-static t_spillLocation *newSpillLocation(t_label *label, t_regID tempRegID)
+static void sparseRegSetAdd(t_sparseRegSet *set, t_regID reg)
 {
-  t_spillLocation *result = malloc(sizeof(t_spillLocation));
-  if (result == NULL)
+  if (sparseRegSetContains(set, reg))
+    return;
+  set->positions[reg] = set->numMembers;
+  set->members[set->numMembers++] = reg;
+}
+
+static void sparseRegSetRemove(t_sparseRegSet *set, t_regID reg)
+{
+  if (!sparseRegSetContains(set, reg))
+    return;
+  t_regID last = set->members[--set->numMembers];
+  set->members[set->positions[reg]] = last;
+  set->positions[last] = set->positions[reg];
+}
+
+static void deleteInterferenceGraph(t_interferenceGraph *g)
+{
+  if (g == NULL)
+    return;
+  for (int i = 0; i < g->numNodes; i++) {
+    free(g->nodes[i].adj);
+    free(g->nodes[i].moves);
+  }
+  free(g->nodes);
+  free(g->moves);
+  free(g->edges);
+  free(g->marks);
+  free(g);
+}
+
+/* Builds the interference graph of the temporary registers of a program.
+ *   Two registers interfere if one of them is defined where the other one is
+ * live, except when the definition is a move from the other register: in
+ * that case they hold the same value, and they can share a physical
+ * register. The liveness of each node is computed by walking every basic
+ * block backwards from its live out set, which is kept as a sparse set: an
+ * array of the live registers, and the position of each register in it.
+ *   At the same time the constraints of the calls are applied to the
+ * registers live across them, and the spill costs are accumulated. */
+static t_interferenceGraph *buildInterferenceGraph(t_regAllocator *RA)
+{
+  t_cfg *graph = RA->graph;
+  t_interferenceGraph *g = calloc(1, sizeof(t_interferenceGraph));
+  if (g == NULL)
     fatalError("out of memory");
-  result->label = label;
-  result->tempRegID = tempRegID;
-  return result;
+  g->numNodes = graph->numRegsByID;
+  g->nodes = calloc((size_t)g->numNodes + 1, sizeof(t_igNode));
+  g->marks = calloc((size_t)g->numNodes + 1, sizeof(int));
+  g->edgesSize = 1024;
+  g->edges = calloc(g->edgesSize, sizeof(uint64_t));
+  if (g->nodes == NULL || g->marks == NULL || g->edges == NULL)
+    fatalError("out of memory");
+
+  t_listNode *gpRegs = getListOfGenPurposeMachineRegisters();
+  t_regMask gpRegMask = listToRegMask(gpRegs);
+  deleteList(gpRegs);
+  for (t_regID i = 0; i < g->numNodes; i++) {
+    t_igNode *node = &g->nodes[i];
+    node->alias = i;
+    node->color = RA_REGISTER_INVALID;
+    t_cfgReg *reg = graph->regsByID[i];
+    if (reg == NULL || (TARGET_REG_ZERO_IS_CONST && i == REG_0))
+      continue;
+    node->present = true;
+    if (reg->mcRegWhitelist) {
+      node->whitelisted = true;
+      node->allowed = listToRegMask(reg->mcRegWhitelist);
+    } else {
+      node->allowed = gpRegMask;
+    }
+  }
+
+  t_sparseRegSet live;
+  live.members = malloc(sizeof(t_regID) * ((size_t)g->numNodes + 1));
+  live.positions = calloc((size_t)g->numNodes + 1, sizeof(int));
+  if (live.members == NULL || live.positions == NULL)
+    fatalError("out of memory");
+
+  int nodeIndex = 0;
+  t_listNode *curBlockNode = graph->blocks;
+  while (curBlockNode != NULL) {
+    t_basicBlock *curBlock = (t_basicBlock *)curBlockNode->data;
+    double weight = blockWeight(RA, curBlock);
+    int numNodes = listLength(curBlock->nodes);
+
+    live.numMembers = 0;
+    const t_bitset *out = curBlock->out;
+    for (int i = bitsetNext(out, 0); i >= 0; i = bitsetNext(out, i + 1))
+      sparseRegSetAdd(&live, graph->liveRegs[i]->tempRegID);
+
+    int curIndex = nodeIndex + numNodes;
+    t_listNode *curInnerNode = listGetLastNode(curBlock->nodes);
+    while (curInnerNode != NULL) {
+      t_bbNode *node = (t_bbNode *)curInnerNode->data;
+      curIndex--;
+
+      t_regID moveSrc = REG_INVALID;
+      if (isMoveNode(node)) {
+        moveSrc = node->uses[0]->tempRegID;
+        if (g->numMoves == g->sizeMoves) {
+          g->sizeMoves = g->sizeMoves ? g->sizeMoves * 2 : 64;
+          g->moves = realloc(g->moves, sizeof(t_igMove) * (size_t)g->sizeMoves);
+          if (g->moves == NULL)
+            fatalError("out of memory");
+        }
+        t_igMove *move = &g->moves[g->numMoves++];
+        move->dest = node->defs[0]->tempRegID;
+        move->src = moveSrc;
+        move->weight = weight;
+        move->index = curIndex;
+      }
+
+      if (isCallInstruction(node->instr)) {
+        // The registers live across the call cannot be allocated to the
+        // registers clobbered by it.
+        t_regMask clobberedRegs = getCallClobberedRegisters(node);
+        for (int i = 0; i < live.numMembers; i++) {
+          t_regID reg = live.members[i];
+          bool isDef = false;
+          for (int j = 0; j < CFG_MAX_DEFS; j++)
+            isDef |= node->defs[j] && node->defs[j]->tempRegID == reg;
+          if (!isDef)
+            g->nodes[reg].allowed &= ~clobberedRegs;
+        }
+      }
+
+      for (int i = 0; i < CFG_MAX_DEFS; i++) {
+        if (node->defs[i] == NULL)
+          continue;
+        t_regID def = node->defs[i]->tempRegID;
+        if (!g->nodes[def].present)
+          continue;
+        for (int j = 0; j < live.numMembers; j++) {
+          if (live.members[j] != moveSrc)
+            igAddEdge(g, def, live.members[j]);
+        }
+        g->nodes[def].spillCost += weight;
+      }
+      for (int i = 0; i < CFG_MAX_DEFS; i++) {
+        if (node->defs[i] != NULL)
+          sparseRegSetRemove(&live, node->defs[i]->tempRegID);
+      }
+      for (int i = 0; i < CFG_MAX_USES; i++) {
+        if (node->uses[i] == NULL)
+          continue;
+        t_regID use = node->uses[i]->tempRegID;
+        if (!g->nodes[use].present)
+          continue;
+        sparseRegSetAdd(&live, use);
+        g->nodes[use].spillCost += weight;
+      }
+
+      curInnerNode = curInnerNode->prev;
+    }
+
+    nodeIndex += numNodes;
+    curBlockNode = curBlockNode->next;
+  }
+
+  free(live.members);
+  free(live.positions);
+
+  // Coalesce the most frequently executed moves first.
+  if (g->numMoves > 0)
+    qsort(g->moves, (size_t)g->numMoves, sizeof(t_igMove), compareMoveWeights);
+  for (int i = 0; i < g->numMoves; i++) {
+    t_igNode *dest = &g->nodes[g->moves[i].dest];
+    t_igNode *src = &g->nodes[g->moves[i].src];
+    appendToArray(&dest->moves, &dest->numMoves, &dest->sizeMoves, i);
+    appendToArray(&src->moves, &src->numMoves, &src->sizeMoves, i);
+  }
+  return g;
 }
 
-static bool compareSpillLocWithRegId(void *a, void *b)
+/* Returns whether two nodes can be coalesced without making the graph harder
+ * to color, according to the conservative test by Briggs: the resulting node
+ * must have fewer neighbors of significant degree than the registers where
+ * it can be allocated. A neighbor has significant degree if it has at least
+ * as many neighbors as allowed registers. Whitelisted neighbors are never
+ * removed from the graph, so they are always significant. */
+static bool igCanCoalesce(t_interferenceGraph *g, t_regID a, t_regID b)
 {
-  t_spillLocation *spillLoc = (t_spillLocation *)a;
-  t_regID reg = *((t_regID *)b);
+  t_igNode *nodeA = &g->nodes[a];
+  t_igNode *nodeB = &g->nodes[b];
+  t_regMask allowed = nodeA->allowed & nodeB->allowed;
+  if (allowed == 0)
+    return false;
+  bool whitelisted = nodeA->whitelisted || nodeB->whitelisted;
+
+  // Mark the neighbors of `a' with `mark', and the neighbors of both nodes
+  // with `mark + 1'. The neighbors already counted get `mark + 2'.
+  int mark = g->curMark;
+  g->curMark += 3;
+  for (int i = 0; i < nodeA->numAdj; i++) {
+    if (igIsValidNeighbor(g, nodeA->adj[i]))
+      g->marks[nodeA->adj[i]] = mark;
+  }
+  for (int i = 0; i < nodeB->numAdj; i++) {
+    t_regID t = nodeB->adj[i];
+    if (igIsValidNeighbor(g, t))
+      g->marks[t] = g->marks[t] == mark ? mark + 1 : mark;
+  }
 
-  if (spillLoc == NULL)
-    return 0;
-  return spillLoc->tempRegID == reg;
+  int numSignificant = 0;
+  for (int k = 0; k < 2; k++) {
+    t_igNode *node = k == 0 ? nodeA : nodeB;
+    for (int i = 0; i < node->numAdj; i++) {
+      t_regID t = node->adj[i];
+      if (!igIsValidNeighbor(g, t) || g->marks[t] == mark + 2)
+        continue;
+      t_igNode *neighbor = &g->nodes[t];
+      // A node whitelisted like the coalesced node may need its register.
+      if (whitelisted && neighbor->whitelisted &&
+          (neighbor->allowed & allowed))
+        return false;
+      // The neighbors of both nodes lose one edge.
+      int degree = neighbor->degree - (g->marks[t] == mark + 1);
+      if (neighbor->whitelisted || degree >= regMaskCount(neighbor->allowed))
+        numSignificant++;
+      g->marks[t] = mark + 2;
+    }
+  }
+  return numSignificant < regMaskCount(allowed);
 }
 
-static void deleteSpillLocationList(t_listNode *spills)
+/* Coalesces node `b' into node `a'. */
+static void igCoalesce(t_interferenceGraph *g, t_regID a, t_regID b)
 {
-  if (spills == NULL)
-    return;
+  t_igNode *nodeB = &g->nodes[b];
+  for (int i = 0; i < nodeB->numAdj; i++) {
+    t_regID t = nodeB->adj[i];
+    if (!igIsValidNeighbor(g, t))
+      continue;
+    // The edge with `b' is replaced by an edge with `a', if it is not there.
+    g->nodes[t].degree--;
+    igAddEdge(g, a, t);
+  }
 
-  t_listNode *curNode = spills;
-  while (curNode != NULL) {
-    t_spillLocation *spillLoc = (t_spillLocation *)curNode->data;
-    free(spillLoc);
-    curNode = curNode->next;
+  t_igNode *nodeA = &g->nodes[a];
+  nodeB->alias = a;
+  nodeA->allowed &= nodeB->allowed;
+  nodeA->whitelisted |= nodeB->whitelisted;
+  nodeA->spillCost += nodeB->spillCost;
+  for (int i = 0; i < nodeB->numMoves; i++)
+    appendToArray(&nodeA->moves, &nodeA->numMoves, &nodeA->sizeMoves,
+        nodeB->moves[i]);
+  g->numCoalesced++;
+}
+
+/* Coalesces the source and the destination of the moves, as long as the
+ * conservative test allows it. */
+static void igCoalesceMoves(t_interferenceGraph *g)
+{
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = 0; i < g->numMoves; i++) {
+      t_regID a = igFind(g, g->moves[i].dest);
+      t_regID b = igFind(g, g->moves[i].src);
+      if (a == b || igInterfere(g, a, b) || !igCanCoalesce(g, a, b))
+        continue;
+      igCoalesce(g, a, b);
+      changed = true;
+    }
+  }
+}
+
+/* Chooses a physical register for a node, among the ones not assigned to its
+ * neighbors. A register assigned to a node connected by a move is preferred,
+ * because then the move is not needed. Otherwise the registers are tried in
+ * the same order as the linear scan does. */
+static t_regID igSelectColor(
+    t_interferenceGraph *g, t_regID n, const uint8_t *order, int numOrder)
+{
+  t_igNode *node = &g->nodes[n];
+  t_regMask forbidden = 0;
+  for (int i = 0; i < node->numAdj; i++) {
+    t_regID t = node->adj[i];
+    if (g->nodes[t].alias == t && g->nodes[t].color >= 0)
+      forbidden |= REG_MASK(g->nodes[t].color);
+  }
+  t_regMask available = node->allowed & ~forbidden;
+  if (available == 0)
+    return RA_SPILL_REQUIRED;
+
+  for (int i = 0; i < node->numMoves; i++) {
+    t_igMove *move = &g->moves[node->moves[i]];
+    t_regID other = igFind(g, move->dest);
+    if (other == n)
+      other = igFind(g, move->src);
+    t_regID color = g->nodes[other].color;
+    if (color >= 0 && (available & REG_MASK(color)))
+      return color;
+  }
+  for (int i = 0; i < numOrder; i++) {
+    if (available & REG_MASK(order[i]))
+      return order[i];
+  }
+  return __builtin_ctz(available);
+}
+
+/* Colors the interference graph. The nodes which have fewer neighbors than
+ * allowed registers are removed from the graph and pushed on a stack, which
+ * may make other nodes colorable in turn. When no such node is left, the
+ * node with the lowest spill cost relative to its degree is removed
+ * anyway, optimistically. Then the nodes are colored in the reverse order of
+ * removal, and the nodes left without a color are spilled. */
+static void igColorGraph(t_interferenceGraph *g)
+{
+  t_listNode *gpRegs = getListOfGenPurposeMachineRegisters();
+  uint8_t order[NUM_REGISTERS];
+  int numOrder = 0;
+  for (t_listNode *i = gpRegs; i; i = i->next)
+    order[numOrder++] = (uint8_t)LIST_DATA_TO_INT(i->data);
+  deleteList(gpRegs);
+
+  t_regID *candidates = malloc(sizeof(t_regID) * ((size_t)g->numNodes + 1));
+  t_regID *worklist = malloc(sizeof(t_regID) * ((size_t)g->numNodes + 1));
+  t_regID *stack = malloc(sizeof(t_regID) * ((size_t)g->numNodes + 1));
+  if (candidates == NULL || worklist == NULL || stack == NULL)
+    fatalError("out of memory");
+  int numCandidates = 0;
+  int numWorklist = 0;
+  int numStack = 0;
+
+  for (t_regID i = 0; i < g->numNodes; i++) {
+    t_igNode *node = &g->nodes[i];
+    if (!node->present || node->alias != i || node->whitelisted)
+      continue;
+    candidates[numCandidates++] = i;
+    if (node->degree < regMaskCount(node->allowed)) {
+      node->inWorklist = true;
+      worklist[numWorklist++] = i;
+    }
+  }
+
+  int numLeft = numCandidates;
+  while (numLeft > 0) {
+    if (numWorklist == 0) {
+      // Choose a spill candidate, and drop the removed nodes from the array
+      // of the candidates.
+      t_regID best = REG_INVALID;
+      double bestCost = 0;
+      int numKept = 0;
+      for (int i = 0; i < numCandidates; i++) {
+        t_igNode *node = &g->nodes[candidates[i]];
+        if (node->removed)
+          continue;
+        candidates[numKept++] = candidates[i];
+        double cost = node->spillCost / (node->degree ? node->degree : 1);
+        if (best == REG_INVALID || cost < bestCost) {
+          best = candidates[i];
+          bestCost = cost;
+        }
+      }
+      numCandidates = numKept;
+      g->nodes[best].inWorklist = true;
+      worklist[numWorklist++] = best;
+    }
+
+    t_regID n = worklist[--numWorklist];
+    t_igNode *node = &g->nodes[n];
+    node->inWorklist = false;
+    node->removed = true;
+    stack[numStack++] = n;
+    numLeft--;
+    for (int i = 0; i < node->numAdj; i++) {
+      t_regID t = node->adj[i];
+      if (!igIsValidNeighbor(g, t))
+        continue;
+      t_igNode *neighbor = &g->nodes[t];
+      neighbor->degree--;
+      if (!neighbor->whitelisted && !neighbor->inWorklist &&
+          neighbor->degree < regMaskCount(neighbor->allowed)) {
+        neighbor->inWorklist = true;
+        worklist[numWorklist++] = t;
+      }
+    }
+  }
+
+  // The whitelisted nodes are colored first.
+  for (t_regID i = 0; i < g->numNodes; i++) {
+    t_igNode *node = &g->nodes[i];
+    if (!node->present || node->alias != i || !node->whitelisted)
+      continue;
+    node->color = igSelectColor(g, i, order, numOrder);
+    if (node->color == RA_SPILL_REQUIRED)
+      fatalError("bug: no register in the whitelist of t%d is available", i);
+  }
+  while (numStack > 0) {
+    t_regID n = stack[--numStack];
+    g->nodes[n].color = igSelectColor(g, n, order, numOrder);
+  }
+
+  free(candidates);
+  free(worklist);
+  free(stack);
+}
+
+static void executeGraphColoring(t_regAllocator *RA)
+{
+  t_interferenceGraph *g = RA->interference;
+  igCoalesceMoves(g);
+  igColorGraph(g);
+
+  for (t_regID i = 0; i < g->numNodes && i < RA->tempRegNum; i++) {
+    if (g->nodes[i].present)
+      RA->bindings[i] = g->nodes[igFind(g, i)].color;
   }
+}
 
-  deleteList(spills);
+/* Remove the moves from a physical register to itself, which are left in the
+ * program when the source and the destination of a move are coalesced. */
+static void removeCoalescedMoves(t_program *program)
+{
+  t_listNode *curNode = program->instructions;
+  while (curNode != NULL) {
+    t_listNode *nextNode = curNode->next;
+    t_instruction *instr = (t_instruction *)curNode->data;
+    if (instr->opcode == OPC_ADDI && instr->immediate == 0 &&
+        instr->addressParam == NULL && instr->rDest && instr->rSrc1 &&
+        instr->rDest->ID != REG_0 && instr->rDest->ID == instr->rSrc1->ID)
+      removeInstructionAt(program, curNode);
+    curNode = nextNode;
+  }
 }
 
 
-t_regAllocator *newRegAllocator(t_program *program)
+t_regAllocator *newRegAllocator(t_program *program,
+    t_regAllocAlgorithm algorithm, const t_profile *profile)
 {
   t_regAllocator *result = (t_regAllocator *)calloc(1, sizeof(t_regAllocator));
   if (result == NULL)
     fatalError("out of memory");
 
   // Create a CFG from the given program and compute the liveness intervals.
+  result->algorithm = algorithm;
   result->program = program;
+  result->profile = profile;
+  trBegin(TR_CFG);
   result->graph = programToCFG(program);
+  trEnd(TR_CFG, program, result->graph);
+  trBegin(TR_LIVENESS);
   cfgComputeLiveness(result->graph);
-
-  // Compute the ordered list of live intervals.
-  result->liveIntervals = getLiveIntervals(result->graph);
+  trEnd(TR_LIVENESS, program, result->graph);
+
+  trBegin(TR_ALLOCATION);
+
+  // Compute the ordered array of live intervals. The loop depths are the
+  // estimates of the spill costs where the profile has no counts.
+  if (profile)
+    result->blockCounts = profileGetBlockCounts(profile, result->graph);
+  if (algorithm == RA_LINEAR_SCAN) {
+    if (profile)
+      cfgComputeLoopDepths(result->graph);
+    getLiveIntervals(result);
+  }
 
   // Find the maximum temporary register ID in the program, then allocate the
   // array of register bindings with that size. If there are unused register
@@ -420,12 +1196,21 @@ t_regAllocator *newRegAllocator(t_program *program)
   if (TARGET_REG_ZERO_IS_CONST)
     result->bindings[REG_0] = REG_0;
 
-  // Initialize the list of spill locations.
-  result->spills = NULL;
+  // Initialize the array of spill locations.
+  result->spills = calloc((size_t)result->tempRegNum, sizeof(t_label *));
+  if (result->spills == NULL)
+    fatalError("out of memory");
 
-  // Initialize register constraints.
-  initializeRegisterConstraints(result);
-  handleCallerSaveRegisters(result, result->graph);
+  if (algorithm == RA_LINEAR_SCAN) {
+    // Initialize register constraints.
+    initializeRegisterConstraints(result);
+    handleCallerSaveRegisters(result, result->graph);
+  } else {
+    // Build the interference graph, with the constraints of each register.
+    cfgComputeLoopDepths(result->graph);
+    result->interference = buildInterferenceGraph(result);
+  }
+  trEnd(TR_ALLOCATION, program, result->graph);
 
   // return the new register allocator.
   return result;
@@ -436,131 +1221,158 @@ void deleteRegAllocator(t_regAllocator *RA)
   if (RA == NULL)
     return;
 
-  t_listNode *curNode = RA->liveIntervals;
-  while (curNode) {
-    t_liveInterval *curInterval = (t_liveInterval *)curNode->data;
-    deleteLiveInterval(curInterval);
-    curNode = curNode->next;
-  }
-
-  deleteList(RA->liveIntervals);
+  free(RA->intervalsByReg);
+  free(RA->liveIntervals);
   free(RA->bindings);
-  deleteSpillLocationList(RA->spills);
+  free(RA->spills);
+  free(RA->remats);
+  free(RA->blockCounts);
+  deleteInterferenceGraph(RA->interference);
   deleteCFG(RA->graph);
 
   free(RA);
 }
 
 
-static bool compareFreeRegListNodes(void *freeReg, void *constraintReg)
+/* Insert an interval in the set of active intervals, before the intervals
+ * which end at the same point or later. */
+static void activateInterval(
+    t_activeIntervals *active, t_liveInterval *interval)
 {
-  return INT_TO_LIST_DATA(constraintReg) == INT_TO_LIST_DATA(freeReg);
+  assert(active->numIntervals < NUM_REGISTERS);
+  int i = active->numIntervals;
+  while (i > 0 && active->intervals[i - 1]->endPoint >= interval->endPoint) {
+    active->intervals[i] = active->intervals[i - 1];
+    i--;
+  }
+  active->intervals[i] = interval;
+  active->numIntervals++;
 }
 
 /* Remove from activeInterv all the live intervals that end before the
  * beginning of the current live interval. */
-static void expireOldIntervals(t_regAllocator *RA, t_listNode **activeInterv,
-    t_listNode **freeRegs, t_liveInterval *interval)
+static void expireOldIntervals(t_regAllocator *RA,
+    t_activeIntervals *activeInterv, t_regMask *freeRegs,
+    t_liveInterval *interval)
 {
-  // No active intervals, bail out!
-  if (*activeInterv == NULL)
-    return;
-
   // Iterate over the set of active intervals.
-  t_listNode *curNode = *activeInterv;
-  while (curNode != NULL) {
+  int numExpired = 0;
+  while (numExpired < activeInterv->numIntervals) {
     // Get the live interval
-    t_liveInterval *curInterval = (t_liveInterval *)curNode->data;
+    t_liveInterval *curInterval = activeInterv->intervals[numExpired];
 
     // If the considered interval ends before the beginning of the current live
     // interval, we don't need to keep track of it anymore; otherwise, this is
     // the first interval we must still take into account when assigning
     // registers.
     if (curInterval->endPoint > interval->startPoint)
-      return;
+      break;
 
     // When curInterval->endPoint == interval->startPoint, the variable
     // associated to curInterval is being used by the instruction that defines
     // interval. As a result, we can allocate interval to the same reg as
     // curInterval.
-    if (curInterval->endPoint == interval->startPoint) {
-      t_regID curIntReg = RA->bindings[curInterval->tempRegID];
-      if (curIntReg >= 0) {
-        t_listNode *allocated =
-            listInsert(NULL, INT_TO_LIST_DATA(curIntReg), 0);
-        interval->mcRegConstraints =
-            optimizeRegisterSet(interval->mcRegConstraints, allocated);
-        deleteList(allocated);
-      }
-    }
-
-    // Get the next live interval.
-    t_listNode *nextNode = curNode->next;
-
-    // Remove the current element from the list.
-    *activeInterv = listFindAndRemove(*activeInterv, curInterval);
+    t_regID curIntReg = RA->bindings[curInterval->tempRegID];
+    if (curInterval->endPoint == interval->startPoint && curIntReg >= 0)
+      preferRegister(interval, curIntReg);
 
     // Free all the registers associated with the removed interval.
-    *freeRegs = listInsert(
-        *freeRegs, INT_TO_LIST_DATA(RA->bindings[curInterval->tempRegID]), 0);
+    *freeRegs |= REG_MASK(curIntReg);
 
     // Step to the next interval.
-    curNode = nextNode;
+    numExpired++;
   }
+
+  // Remove the expired intervals from the set.
+  activeInterv->numIntervals -= numExpired;
+  memmove(&activeInterv->intervals[0], &activeInterv->intervals[numExpired],
+      sizeof(t_liveInterval *) * (size_t)activeInterv->numIntervals);
 }
 
-/* Get a new register from the free list. */
-static t_regID assignRegister(
-    t_regAllocator *RA, t_listNode **freeRegs, t_listNode *constraints)
+/* Get a new register from the set of free registers. */
+static t_regID assignRegister(t_regMask *freeRegs, t_liveInterval *interval)
 {
-  if (constraints == NULL)
-    return RA_SPILL_REQUIRED;
-
-  for (t_listNode *i = constraints; i; i = i->next) {
-    t_regID tempRegID = (t_regID)LIST_DATA_TO_INT(i->data);
-    t_listNode *freeReg = listFindWithCallback(
-        *freeRegs, INT_TO_LIST_DATA(tempRegID), compareFreeRegListNodes);
-    if (freeReg) {
-      *freeRegs = listRemoveNode(*freeRegs, freeReg);
-      return tempRegID;
+  int numRegs = regMaskCount(interval->mcRegConstraints);
+  for (int i = 0; i < numRegs; i++) {
+    t_regID reg = interval->mcRegOrder[i];
+    if (*freeRegs & REG_MASK(reg)) {
+      *freeRegs &= ~REG_MASK(reg);
+      return reg;
     }
   }
 
   return RA_SPILL_REQUIRED;
 }
 
+/* Returns whether spilling the first interval costs less than spilling the
+ * second one, according to the profile. */
+static bool isCheaperToSpill(const t_liveInterval *a, const t_liveInterval *b)
+{
+  if (a->spillCost != b->spillCost)
+    return a->spillCost < b->spillCost;
+  return a->endPoint > b->endPoint;
+}
+
 /* Perform a spill that allows the allocation of the given interval, given the
- * list of active live intervals. */
-static void spillAtInterval(
-    t_regAllocator *RA, t_listNode **activeInterv, t_liveInterval *interval)
+ * set of active live intervals. */
+static void spillAtInterval(t_regAllocator *RA,
+    t_activeIntervals *activeInterv, t_liveInterval *interval)
 {
   // An interval is made active when its register is allocated. As a result,
-  // if the list of active intervals is empty and we request a spill, we are
+  // if the set of active intervals is empty and we request a spill, we are
   // working on a machine with 0 registers and we need to spill everything.
-  if (*activeInterv == NULL) {
+  if (activeInterv->numIntervals == 0) {
     RA->bindings[interval->tempRegID] = RA_SPILL_REQUIRED;
     return;
   }
 
+  // With a profile, spill the interval whose uses and definitions were
+  // executed the least, among the current one and the active ones whose
+  // register it can take. Between equally cheap intervals, the one which
+  // ends the last is spilled, as below.
+  if (RA->profile != NULL) {
+    int cheapest = -1;
+    for (int i = 0; i < activeInterv->numIntervals; i++) {
+      t_liveInterval *active = activeInterv->intervals[i];
+      t_regID reg = RA->bindings[active->tempRegID];
+      if ((interval->mcRegConstraints & REG_MASK(reg)) &&
+          (cheapest < 0 || isCheaperToSpill(active,
+                               activeInterv->intervals[cheapest])))
+        cheapest = i;
+    }
+    if (cheapest < 0 ||
+        !isCheaperToSpill(activeInterv->intervals[cheapest], interval)) {
+      RA->bindings[interval->tempRegID] = RA_SPILL_REQUIRED;
+      return;
+    }
+    t_liveInterval *spilled = activeInterv->intervals[cheapest];
+    RA->bindings[interval->tempRegID] = RA->bindings[spilled->tempRegID];
+    RA->bindings[spilled->tempRegID] = RA_SPILL_REQUIRED;
+    activeInterv->numIntervals--;
+    for (int i = cheapest; i < activeInterv->numIntervals; i++)
+      activeInterv->intervals[i] = activeInterv->intervals[i + 1];
+    activateInterval(activeInterv, interval);
+    return;
+  }
+
   // If the current interval ends before the last one successfully allocated,
   // spill the last one. This has the result of making one register available
   // much sooner. Otherwise spill the current interval.
-  t_listNode *lastNode = listGetLastNode(*activeInterv);
-  t_liveInterval *lastInterval = (t_liveInterval *)lastNode->data;
+  t_liveInterval *lastInterval =
+      activeInterv->intervals[activeInterv->numIntervals - 1];
   if (lastInterval->endPoint > interval->endPoint) {
     // The last interval does end later than the current one.
     // Ensure that the current interval is allocatable to the last interval's
     // register.
     t_regID attempt = RA->bindings[lastInterval->tempRegID];
-    if (listFind(interval->mcRegConstraints, INT_TO_LIST_DATA(attempt))) {
+    if (interval->mcRegConstraints & REG_MASK(attempt)) {
       // All conditions satisfied for the last interval.
       // Take its register for our interval and mark it as spilled.
       RA->bindings[interval->tempRegID] = RA->bindings[lastInterval->tempRegID];
       RA->bindings[lastInterval->tempRegID] = RA_SPILL_REQUIRED;
-      // Update the active intervals list.
-      *activeInterv = listFindAndRemove(*activeInterv, lastInterval);
-      *activeInterv =
-          listInsertSorted(*activeInterv, interval, compareLiveIntEndPoints);
+      // Update the active intervals set.
+      activeInterv->numIntervals--;
+      activateInterval(activeInterv, interval);
       return;
     }
   }
@@ -569,68 +1381,137 @@ static void spillAtInterval(
 
 static void executeLinearScan(t_regAllocator *RA)
 {
-  t_listNode *freeRegs = getListOfMachineRegisters();
-  t_listNode *activeInterv = NULL;
+  t_listNode *machineRegs = getListOfMachineRegisters();
+  t_regMask freeRegs = listToRegMask(machineRegs);
+  deleteList(machineRegs);
+  t_activeIntervals activeInterv;
+  activeInterv.numIntervals = 0;
 
-  for (t_listNode *curNode = RA->liveIntervals; curNode != NULL;
-       curNode = curNode->next) {
-    t_liveInterval *curInterval = (t_liveInterval *)curNode->data;
+  for (int i = 0; i < RA->numLiveIntervals; i++) {
+    t_liveInterval *curInterval = RA->liveIntervals[i];
 
     // Check which intervals are ended and remove them from the active set,
     // thus freeing registers.
     expireOldIntervals(RA, &activeInterv, &freeRegs, curInterval);
 
-    t_regID reg = assignRegister(RA, &freeRegs, curInterval->mcRegConstraints);
+    t_regID reg = assignRegister(&freeRegs, curInterval);
 
     // If all registers are busy, perform a spill.
     if (reg == RA_SPILL_REQUIRED) {
       spillAtInterval(RA, &activeInterv, curInterval);
     } else {
       // Otherwise, assign a new register to the current live interval
-      // and add the current interval to the list of active intervals, in
+      // and add the current interval to the set of active intervals, in
       // order of ending points (to allow easier expire management).
       RA->bindings[curInterval->tempRegID] = reg;
-      activeInterv =
-          listInsertSorted(activeInterv, curInterval, compareLiveIntEndPoints);
+      activateInterval(&activeInterv, curInterval);
     }
   }
-
-  activeInterv = deleteList(activeInterv);
-  freeRegs = deleteList(freeRegs);
 }
 
 
 /* For each spilled variable, this function statically allocates memory for
- * that variable, returns a list of t_templabel structures mapping the
- * spilled variables and the label that points to the allocated memory block. */
+ * that variable, and records the label that points to the allocated memory
+ * block in the array of the spill locations. */
 static void materializeSpillMemory(t_regAllocator *RA)
 {
   for (t_regID counter = 0; counter < RA->tempRegNum; counter++) {
     if (RA->bindings[counter] != RA_SPILL_REQUIRED)
       continue;
+    // Rematerialized registers are never stored.
+    if (RA->remats[counter] != NULL)
+      continue;
 
     // Statically allocate some room for the spilled variable and add it to the
-    // list of spills.
+    // spill locations.
     char name[32];
     sprintf(name, ".t%d", counter);
     t_symbol *sym = createSymbol(RA->program, strdup(name), TYPE_INT, 0);
-    t_spillLocation *spillLoc = newSpillLocation(sym->label, counter);
-    RA->spills = listInsert(RA->spills, spillLoc, -1);
+    RA->spills[counter] = sym->label;
+  }
+}
+
+/* Find the spilled registers whose only definition loads a constant or an
+ * address. Their value can be recomputed by a copy of the definition
+ * wherever it is needed, which is cheaper than a store and a load. */
+static void findRematerializableRegisters(t_regAllocator *RA)
+{
+  RA->remats = calloc((size_t)RA->tempRegNum, sizeof(t_instruction *));
+  int *numDefs = calloc((size_t)RA->tempRegNum, sizeof(int));
+  if (RA->remats == NULL || numDefs == NULL)
+    fatalError("out of memory");
+
+  t_listNode *curBlockNode = RA->graph->blocks;
+  while (curBlockNode != NULL) {
+    t_basicBlock *curBlock = (t_basicBlock *)curBlockNode->data;
+    t_listNode *curInnerNode = curBlock->nodes;
+    while (curInnerNode != NULL) {
+      t_bbNode *node = (t_bbNode *)curInnerNode->data;
+      for (int i = 0; i < CFG_MAX_DEFS; i++) {
+        if (node->defs[i] == NULL)
+          continue;
+        t_regID reg = node->defs[i]->tempRegID;
+        numDefs[reg]++;
+        if (node->instr->opcode == OPC_LI || node->instr->opcode == OPC_LA)
+          RA->remats[reg] = node->instr;
+      }
+      curInnerNode = curInnerNode->next;
+    }
+    curBlockNode = curBlockNode->next;
+  }
+
+  for (t_regID reg = 0; reg < RA->tempRegNum; reg++) {
+    if (RA->bindings[reg] != RA_SPILL_REQUIRED || numDefs[reg] != 1)
+      RA->remats[reg] = NULL;
+  }
+  free(numDefs);
+}
+
+/* Returns whether a register is live at the exit of a basic block. */
+static bool isLiveOut(t_regAllocator *RA, t_basicBlock *block, t_regID reg)
+{
+  t_cfgReg *cfgReg = RA->graph->regsByID[reg];
+  return cfgReg->liveIndex >= 0 &&
+      bitsetContains(block->out, cfgReg->liveIndex);
+}
+
+/* Returns the number of nodes from the given one to the next use of a
+ * register, in the same basic block. The distance is zero if the register
+ * is used by the given node. Returns -1 if the value of the register is
+ * dead, because it is overwritten or it is not live out of the block, and
+ * RA_SPILL_LOOKAHEAD if the next use is not found within that many nodes. */
+static int getNextUseDistance(t_regAllocator *RA, t_basicBlock *block,
+    t_listNode *fromNode, t_regID reg)
+{
+  int distance = 0;
+  for (t_listNode *curNode = fromNode; curNode != NULL;
+       curNode = curNode->next) {
+    if (distance == RA_SPILL_LOOKAHEAD)
+      return RA_SPILL_LOOKAHEAD;
+    t_bbNode *node = (t_bbNode *)curNode->data;
+    for (int i = 0; i < CFG_MAX_USES; i++) {
+      if (node->uses[i] && node->uses[i]->tempRegID == reg)
+        return distance;
+    }
+    for (int i = 0; i < CFG_MAX_DEFS; i++) {
+      if (node->defs[i] && node->defs[i]->tempRegID == reg)
+        return -1;
+    }
+    distance++;
   }
+  return isLiveOut(RA, block, reg) ? RA_SPILL_LOOKAHEAD : -1;
 }
 
 static void genStoreSpillVariable(t_regAllocator *RA, t_regID rSpilled,
     t_regID rSrc, t_basicBlock *block, t_bbNode *curCFGNode, bool before)
 {
   // Find the spill location.
-  t_listNode *elementFound =
-      listFindWithCallback(RA->spills, &rSpilled, compareSpillLocWithRegId);
-  if (elementFound == NULL)
-    fatalError("bug: t%d missing from the spill label list", rSpilled);
-  t_spillLocation *loc = (t_spillLocation *)elementFound->data;
+  t_label *loc = RA->spills[rSpilled];
+  if (loc == NULL)
+    fatalError("bug: t%d missing from the spill locations", rSpilled);
 
   // Insert a store instruction in the required position.
-  t_instruction *storeInstr = genSWGlobal(NULL, rSrc, loc->label, REG_T6);
+  t_instruction *storeInstr = genSWGlobal(NULL, rSrc, loc, REG_T6);
   if (before) {
     bbInsertInstructionBefore(block, storeInstr, curCFGNode);
   } else {
@@ -641,15 +1522,23 @@ static void genStoreSpillVariable(t_regAllocator *RA, t_regID rSpilled,
 static void genLoadSpillVariable(t_regAllocator *RA, t_regID rSpilled,
     t_regID rDest, t_basicBlock *block, t_bbNode *curCFGNode, bool before)
 {
-  // Find the spill location.
-  t_listNode *elementFound =
-      listFindWithCallback(RA->spills, &rSpilled, compareSpillLocWithRegId);
-  if (elementFound == NULL)
-    fatalError("bug: t%d missing from the spill label list", rSpilled);
-  t_spillLocation *loc = (t_spillLocation *)elementFound->data;
-
-  // Insert a load instruction in the required position.
-  t_instruction *loadInstr = genLWGlobal(NULL, rDest, loc->label);
+  t_instruction *loadInstr;
+  t_instruction *remat = RA->remats[rSpilled];
+  if (remat != NULL) {
+    // Recompute the value from a copy of its definition.
+    if (remat->opcode == OPC_LI)
+      loadInstr = genLI(NULL, rDest, remat->immediate);
+    else
+      loadInstr = genLA(NULL, rDest, remat->addressParam);
+  } else {
+    // Find the spill location.
+    t_label *loc = RA->spills[rSpilled];
+    if (loc == NULL)
+      fatalError("bug: t%d missing from the spill locations", rSpilled);
+    loadInstr = genLWGlobal(NULL, rDest, loc);
+  }
+
+  // Insert the load instruction in the required position.
   if (before) {
     bbInsertInstructionBefore(block, loadInstr, curCFGNode);
     // If the `curCFGNode' instruction has a label, move it to the new
@@ -664,8 +1553,17 @@ static void genLoadSpillVariable(t_regAllocator *RA, t_regID rSpilled,
 }
 
 static void materializeRegAllocInBBForInstructionNode(t_regAllocator *RA,
-    t_spillState *state, t_basicBlock *curBlock, t_bbNode *curCFGNode)
+    t_spillState *state, t_basicBlock *curBlock, t_listNode *curInnerNode)
 {
+  t_bbNode *curCFGNode = (t_bbNode *)curInnerNode->data;
+  t_instruction *instr = curCFGNode->instr;
+
+  // The definition of a rematerialized register is removed later, as its
+  // value is recomputed wherever it is used.
+  if (instr->rDest && RA->bindings[instr->rDest->ID] == RA_SPILL_REQUIRED &&
+      RA->remats[instr->rDest->ID] == instr)
+    return;
+
   // The elements in this array indicate whether the corresponding spill
   // register will be used or not by this instruction.
   bool spillSlotInUse[NUM_SPILL_REGS] = {false};
@@ -676,7 +1574,6 @@ static void materializeRegAllocInBBForInstructionNode(t_regAllocator *RA,
   t_spillInstrArgState argState[MAX_INSTR_ARGS];
 
   // Analyze the current instruction.
-  t_instruction *instr = curCFGNode->instr;
   int numArgs = 0;
   if (instr->rDest) {
     argState[numArgs].reg = instr->rDest;
@@ -745,20 +1642,40 @@ static void materializeRegAllocInBBForInstructionNode(t_regAllocator *RA,
     if (alreadyFound)
       continue;
 
-    // Otherwise we need to find a new slot.
-    int slot;
-    for (slot = 0; slot < NUM_SPILL_REGS; slot++) {
-      if (spillSlotInUse[slot] == false)
+    // Otherwise we need to find a new slot. Use a free one if possible, or
+    // else evict the register whose value is needed the farthest in the
+    // future, so that the values used again soon stay in the spill registers.
+    int slot = -1;
+    int slotDistance = -2;
+    for (int curSlot = 0; curSlot < NUM_SPILL_REGS; curSlot++) {
+      if (spillSlotInUse[curSlot])
+        continue;
+      t_regID curReg = state->regs[curSlot].assignedTempReg;
+      if (curReg == REG_INVALID) {
+        slot = curSlot;
+        slotDistance = -1;
+        break;
+      }
+      int distance = getNextUseDistance(RA, curBlock, curInnerNode, curReg);
+      if (distance == -1) {
+        // Dead values are the best choice, as they need no write back.
+        slot = curSlot;
+        slotDistance = -1;
         break;
+      }
+      if (distance > slotDistance) {
+        slot = curSlot;
+        slotDistance = distance;
+      }
     }
     // If we don't find anything, we don't have enough spill registers!
     // This should never happen, bail out!
-    if (slot == NUM_SPILL_REGS)
+    if (slot == -1)
       fatalError("bug: spill slots exhausted");
 
     // If needed, write back the old variable that was assigned to this
-    // slot before reassigning it.
-    if (state->regs[slot].needsWB) {
+    // slot before reassigning it. Dead values are simply discarded.
+    if (state->regs[slot].needsWB && slotDistance != -1) {
       genStoreSpillVariable(RA, state->regs[slot].assignedTempReg,
           getSpillMachineRegister(slot), curBlock, curCFGNode, true);
     }
@@ -769,9 +1686,15 @@ static void materializeRegAllocInBBForInstructionNode(t_regAllocator *RA,
     state->regs[slot].assignedTempReg = argState[argIdx].reg->ID;
     state->regs[slot].needsWB = argState[argIdx].isDestination;
 
-    // Load the value of the variable in the spill register if not a
-    // destination of the instruction.
-    if (!argState[argIdx].isDestination) {
+    // Load the value of the variable in the spill register if it is read by
+    // the instruction, even when it is also its destination.
+    bool isSource = false;
+    for (int otherArg = 0; otherArg < numArgs; otherArg++) {
+      if (!argState[otherArg].isDestination &&
+          argState[otherArg].reg->ID == argState[argIdx].reg->ID)
+        isSource = true;
+    }
+    if (isSource) {
       genLoadSpillVariable(RA, argState[argIdx].reg->ID,
           getSpillMachineRegister(slot), curBlock, curCFGNode, true);
     }
@@ -806,7 +1729,8 @@ static void materializeRegAllocInBB(t_regAllocator *RA, t_basicBlock *curBlock)
     // Change the register IDs of the argument of the instruction according
     // to the given register allocation. Generate load and stores for spilled
     // registers.
-    materializeRegAllocInBBForInstructionNode(RA, &state, curBlock, curCFGNode);
+    materializeRegAllocInBBForInstructionNode(
+        RA, &state, curBlock, curInnerNode);
     curInnerNode = curInnerNode->next;
   }
   if (curCFGNode == NULL)
@@ -816,15 +1740,33 @@ static void materializeRegAllocInBB(t_regAllocator *RA, t_basicBlock *curBlock)
       (isJumpInstruction(curCFGNode->instr) ||
           isExitInstruction(curCFGNode->instr));
 
-  // Writeback everything at the end of the basic block.
+  // Writeback everything at the end of the basic block, except the values
+  // which are not used by the following blocks.
   for (int counter = 0; counter < NUM_SPILL_REGS; counter++) {
     if (state.regs[counter].needsWB == false)
       continue;
+    if (!isLiveOut(RA, curBlock, state.regs[counter].assignedTempReg))
+      continue;
     genStoreSpillVariable(RA, state.regs[counter].assignedTempReg,
         getSpillMachineRegister(counter), curBlock, curCFGNode, bbHasTermInstr);
   }
 }
 
+/* Remove the definitions of the rematerialized registers, which were left
+ * untouched by the materialization of the register allocation. */
+static void removeRematerializedDefinitions(t_regAllocator *RA)
+{
+  t_listNode *curNode = RA->program->instructions;
+  while (curNode != NULL) {
+    t_listNode *nextNode = curNode->next;
+    t_instruction *instr = (t_instruction *)curNode->data;
+    if (instr->rDest && instr->rDest->ID < RA->tempRegNum &&
+        RA->remats[instr->rDest->ID] == instr)
+      removeInstructionAt(RA->program, curNode);
+    curNode = nextNode;
+  }
+}
+
 static void materializeRegAllocInCFG(t_regAllocator *RA)
 {
   t_listNode *curBlockNode = RA->graph->blocks;
@@ -839,11 +1781,19 @@ static void materializeRegAllocInCFG(t_regAllocator *RA)
 void regallocRun(t_regAllocator *regalloc)
 {
   // Bind each temporary register to a physical register using the linear scan
-  // algorithm. Spilled registers are all tagged with the fictitious register
-  // RA_SPILL_REQUIRED.
-  executeLinearScan(regalloc);
-
-  // Generate statically allocated globals for each spilled temporary register.
+  // algorithm or graph coloring. Spilled registers are all tagged with the
+  // fictitious register RA_SPILL_REQUIRED.
+  trBegin(TR_ALLOCATION);
+  if (regalloc->algorithm == RA_GRAPH_COLORING)
+    executeGraphColoring(regalloc);
+  else
+    executeLinearScan(regalloc);
+  trEnd(TR_ALLOCATION, regalloc->program, regalloc->graph);
+
+  // Generate statically allocated globals for each spilled temporary register,
+  // except for the ones which can be recomputed instead.
+  trBegin(TR_SPILLS);
+  findRematerializableRegisters(regalloc);
   materializeSpillMemory(regalloc);
 
   // Replace temporary register IDs with physical register IDs. In case of
@@ -852,6 +1802,11 @@ void regallocRun(t_regAllocator *regalloc)
 
   // Rewrite the program object from the CFG.
   cfgToProgram(regalloc->program, regalloc->graph);
+
+  removeRematerializedDefinitions(regalloc);
+  if (regalloc->algorithm == RA_GRAPH_COLORING)
+    removeCoalescedMoves(regalloc->program);
+  trEnd(TR_SPILLS, regalloc->program, regalloc->graph);
 }
 
 
@@ -870,16 +1825,11 @@ void dumpVariableBindings(t_regAllocator *RA, FILE *fout)
     free(regStr);
 
     if (physReg == RA_SPILL_REQUIRED) {
-      t_listNode *spillLi = RA->spills;
-      t_spillLocation *loc;
-      while (spillLi) {
-        loc = (t_spillLocation *)spillLi->data;
-        if (loc->tempRegID == tempReg)
-          break;
-        spillLi = spillLi->next;
-      }
-      if (spillLi) {
-        char *labelName = getLabelName(loc->label);
+      t_label *loc = RA->spills[tempReg];
+      if (RA->remats && RA->remats[tempReg]) {
+        fprintf(fout, "spilled and recomputed at each use\n");
+      } else if (loc) {
+        char *labelName = getLabelName(loc);
         fprintf(fout, "spilled to label %s\n", labelName);
         free(labelName);
       } else {
@@ -897,14 +1847,13 @@ void dumpVariableBindings(t_regAllocator *RA, FILE *fout)
   fflush(fout);
 }
 
-void dumpLiveIntervals(t_listNode *intervals, FILE *fout)
+void dumpLiveIntervals(t_liveInterval **intervals, int numIntervals, FILE *fout)
 {
   if (fout == NULL)
     return;
 
-  t_listNode *curNode = intervals;
-  while (curNode != NULL) {
-    t_liveInterval *interval = (t_liveInterval *)curNode->data;
+  for (int curIdx = 0; curIdx < numIntervals; curIdx++) {
+    t_liveInterval *interval = intervals[curIdx];
 
     char *regStr = registerIDToString(interval->tempRegID, false);
     fprintf(fout, "%s:\n", regStr);
@@ -913,25 +1862,73 @@ void dumpLiveIntervals(t_listNode *intervals, FILE *fout)
     fprintf(fout, "  live interval = [%3d, %3d]\n", interval->startPoint,
         interval->endPoint);
     fprintf(fout, "  constraints = {");
-    t_listNode *i = interval->mcRegConstraints;
-    while (i) {
+    int numRegs = regMaskCount(interval->mcRegConstraints);
+    for (int i = 0; i < numRegs; i++) {
       char *reg;
 
-      reg = registerIDToString((t_regID)LIST_DATA_TO_INT(i->data), true);
+      reg = registerIDToString(interval->mcRegOrder[i], true);
       fprintf(fout, "%s", reg);
       free(reg);
 
-      if (i->next != NULL)
+      if (i + 1 < numRegs)
         fprintf(fout, ", ");
-      i = i->next;
     }
     fprintf(fout, "}\n");
+  }
+  fflush(fout);
+}
+
+void dumpInterferenceGraph(t_interferenceGraph *g, FILE *fout)
+{
+  if (fout == NULL)
+    return;
 
-    curNode = curNode->next;
+  fprintf(fout, "Number of coalesced registers: %d\n\n", g->numCoalesced);
+  for (t_regID i = 0; i < g->numNodes; i++) {
+    t_igNode *node = &g->nodes[i];
+    if (!node->present)
+      continue;
+
+    char *regStr = registerIDToString(i, false);
+    fprintf(fout, "%s:\n", regStr);
+    free(regStr);
+
+    if (node->alias != i) {
+      regStr = registerIDToString(igFind(g, i), false);
+      fprintf(fout, "  coalesced into %s\n", regStr);
+      free(regStr);
+      continue;
+    }
+
+    int numNeighbors = 0;
+    for (int j = 0; j < node->numAdj; j++) {
+      if (g->nodes[node->adj[j]].alias == node->adj[j])
+        numNeighbors++;
+    }
+    fprintf(fout, "  neighbors = %d, spill cost = %g\n", numNeighbors,
+        node->spillCost);
+    fprintf(fout, "  constraints = {");
+    bool first = true;
+    for (t_regID reg = 0; reg < NUM_REGISTERS; reg++) {
+      if (!(node->allowed & REG_MASK(reg)))
+        continue;
+      char *regName = registerIDToString(reg, true);
+      fprintf(fout, "%s%s", first ? "" : ", ", regName);
+      free(regName);
+      first = false;
+    }
+    fprintf(fout, "}\n");
   }
   fflush(fout);
 }
 
+void regallocDumpCFG(t_regAllocator *RA, FILE *fout)
+{
+  if (RA == NULL)
+    return;
+  cfgDump(RA->graph, fout, true);
+}
+
 void regallocDump(t_regAllocator *RA, FILE *fout)
 {
   if (RA == NULL)
@@ -945,8 +1942,13 @@ void regallocDump(t_regAllocator *RA, FILE *fout)
   fprintf(fout, "Number of available physical registers: %d\n", NUM_GP_REGS);
   fprintf(fout, "Number of virtual registers used: %d\n\n", RA->tempRegNum);
 
-  fprintf(fout, "## Live intervals and constraints\n\n");
-  dumpLiveIntervals(RA->liveIntervals, fout);
+  if (RA->algorithm == RA_GRAPH_COLORING) {
+    fprintf(fout, "## Interference graph and constraints\n\n");
+    dumpInterferenceGraph(RA->interference, fout);
+  } else {
+    fprintf(fout, "## Live intervals and constraints\n\n");
+    dumpLiveIntervals(RA->liveIntervals, RA->numLiveIntervals, fout);
+  }
   fprintf(fout, "\n");
 
   fprintf(fout, "## Register assignment\n\n");
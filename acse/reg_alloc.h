@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include "program.h"
+#include "profile.h"
 
 /**
  * @defgroup regalloc Register Allocator
@@ -13,18 +14,36 @@
  *
  * Once the program has been translated to an initial assembly-like intermediate
  * language, the compiler needs to allocate each temporary register to a
- * physical register. The register allocation object performs this process by
- * using the linear scan algorithm on the program's control flow graph.
+ * physical register. The register allocation object performs this process on
+ * the program's control flow graph, by using either the linear scan algorithm
+ * or graph coloring.
  * @{
  */
 
+/** Algorithms for the allocation of the temporary registers. */
+typedef enum {
+  /// Linear scan on the live intervals of the registers. Fast, but a spilled
+  /// register is spilled for all of its live interval. With a profile the
+  /// register whose uses were executed the least is spilled, otherwise the
+  /// one whose interval ends the last.
+  RA_LINEAR_SCAN,
+  /// Chaitin-Briggs graph coloring of the interference graph, with
+  /// conservative coalescing of register moves, and spill costs weighted by
+  /// the profile or by the loop depth of each use and definition.
+  RA_GRAPH_COLORING
+} t_regAllocAlgorithm;
+
 /** Opaque register allocator object. */
 typedef struct t_regAllocator t_regAllocator;
 
 /** Create a new register allocator object for the given program.
- *  @param program The program whose registers need to be allocated.
+ *  @param program   The program whose registers need to be allocated.
+ *  @param algorithm The algorithm which will be used for the allocation.
+ *  @param profile   Execution counts of a previous run of the program,
+ *                   which decide the registers to spill, or NULL.
  *  @return A new register allocator object. */
-t_regAllocator *newRegAllocator(t_program *program);
+t_regAllocator *newRegAllocator(t_program *program,
+    t_regAllocAlgorithm algorithm, const t_profile *profile);
 
 /** Deallocate a register allocator.
  *  @param regAlloc The register allocator object. */
@@ -35,6 +54,12 @@ void deleteRegAllocator(t_regAllocator *regAlloc);
  *  @param regAlloc The register allocator object. */
 void regallocRun(t_regAllocator *regAlloc);
 
+/** Dump the control flow graph of the program, with the liveness information
+ *  used by the allocation. It must be called before regallocRun().
+ *  @param regAlloc The register allocation object.
+ *  @param fout     The file where to print the dump. */
+void regallocDumpCFG(t_regAllocator *regAlloc, FILE *fout);
+
 /** Dump the results of register allocation to the specified file.
  *  @param regAlloc The register allocation object.
  *  @param fout     The file where to print the dump. */
@@ -260,156 +260,297 @@ static int opcodeToFormat(int opcode)
 }
 
 
-char *registerIDToString(t_regID regID, bool machineRegIDs)
-{
+/// Buffer of the output. The text is accumulated in the buffer, written out
+/// whenever it fills up, and counted so that the fields of the lines can be
+/// padded without formatting them separately first.
+typedef struct {
+  FILE *fp;
   char *buf;
-  static const char *mcRegIds[] = {"zero", "ra", "sp", "gp", "tp", "t0", "t1",
-      "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7", "s2",
-      "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5",
-      "t6"};
+  size_t size;
+  size_t length;
+  /// Number of characters emitted since the writer was created.
+  size_t written;
+  /// True if a write to fp has failed.
+  bool error;
+} t_asmWriter;
 
-  if (machineRegIDs || (TARGET_REG_ZERO_IS_CONST && regID == 0)) {
-    if (regID < 0 || regID >= 32)
-      return NULL;
-    return strdup(mcRegIds[regID]);
-  }
+/// Size of the buffer of writeAssembly(), which is also the size of each
+/// write to the output file.
+#define ASM_BUFFER_SIZE 0x40000
 
-  if (regID < 0)
-    return strdup("invalid_reg");
-  buf = calloc(24, sizeof(char));
-  snprintf(buf, 24, "temp%d", regID);
-  return buf;
-}
+static const char *mcRegNames[] = {"zero", "ra", "sp", "gp", "tp", "t0", "t1",
+    "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7", "s2",
+    "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5",
+    "t6"};
 
 
-char *registerToString(t_instrArg *reg, bool machineRegIDs)
+static void asmFlush(t_asmWriter *w)
 {
-  if (!reg)
-    return NULL;
-  return registerIDToString(reg->ID, machineRegIDs);
+  if (w->length > 0 && fwrite(w->buf, 1, w->length, w->fp) < w->length)
+    w->error = true;
+  w->length = 0;
 }
 
+static void asmPutMem(t_asmWriter *w, const char *str, size_t len)
+{
+  w->written += len;
+  while (len > 0) {
+    if (w->length == w->size)
+      asmFlush(w);
+    size_t chunk = w->size - w->length;
+    if (chunk > len)
+      chunk = len;
+    memcpy(w->buf + w->length, str, chunk);
+    w->length += chunk;
+    str += chunk;
+    len -= chunk;
+  }
+}
 
-int labelToString(char *buf, int bufsz, t_label *label, int finalColon)
+static void asmPutString(t_asmWriter *w, const char *str)
 {
-  char *labelName;
-  int res;
+  asmPutMem(w, str, strlen(str));
+}
 
-  if (!label)
-    return -1;
+static void asmPutChar(t_asmWriter *w, char c)
+{
+  if (w->length == w->size)
+    asmFlush(w);
+  w->buf[w->length++] = c;
+  w->written++;
+}
 
-  labelName = getLabelName(label);
+/// Same as printf("%d").
+static void asmPutInt(t_asmWriter *w, int value)
+{
+  char digits[12];
+  int n = 0;
+  unsigned int mag = value < 0 ? -(unsigned int)value : (unsigned int)value;
+
+  do {
+    digits[n++] = (char)('0' + mag % 10);
+    mag /= 10;
+  } while (mag != 0);
+  if (value < 0)
+    digits[n++] = '-';
+  while (n > 0)
+    asmPutChar(w, digits[--n]);
+}
 
-  if (finalColon)
-    res = snprintf(buf, bufsz, "%s:", labelName);
-  else
-    res = snprintf(buf, bufsz, "%s", labelName);
+/// Pads with spaces the text emitted since `start', which is a value of
+/// w->written, to `width' characters, as the printf("%-*s") format does.
+static void asmPad(t_asmWriter *w, size_t start, size_t width)
+{
+  while (w->written - start < width)
+    asmPutChar(w, ' ');
+}
 
-  free(labelName);
-  return res;
+static void asmPutRegister(
+    t_asmWriter *w, t_instrArg *reg, bool machineRegIDs)
+{
+  t_regID regID = reg->ID;
+  if (machineRegIDs || (TARGET_REG_ZERO_IS_CONST && regID == 0)) {
+    if (regID < 0 || regID >= 32)
+      asmPutString(w, "invalid_reg");
+    else
+      asmPutString(w, mcRegNames[regID]);
+  } else if (regID < 0) {
+    asmPutString(w, "invalid_reg");
+  } else {
+    asmPutString(w, "temp");
+    asmPutInt(w, regID);
+  }
+}
+
+/// Emits the name of a label, the same returned by getLabelName().
+static void asmPutLabel(t_asmWriter *w, t_label *label)
+{
+  if (label->name) {
+    asmPutString(w, label->name);
+  } else {
+    asmPutString(w, "l_");
+    asmPutInt(w, (int)label->labelID);
+  }
 }
 
 
-int instructionToString(
-    char *buf, int bufsz, t_instruction *instr, bool machineRegIDs)
+char *registerIDToString(t_regID regID, bool machineRegIDs)
 {
-  int res;
-  char *buf0 = buf;
-  char *address = NULL;
+  char *buf;
 
-  const char *opc = opcodeToString(instr->opcode);
-  char *rd = registerToString(instr->rDest, machineRegIDs);
-  char *rs1 = registerToString(instr->rSrc1, machineRegIDs);
-  char *rs2 = registerToString(instr->rSrc2, machineRegIDs);
-  if (instr->addressParam) {
-    int n = labelToString(NULL, 0, instr->addressParam, 0);
-    address = calloc((size_t)n + 1, sizeof(char));
-    if (!address)
-      fatalError("out of memory");
-    labelToString(address, n + 1, instr->addressParam, 0);
+  if (machineRegIDs || (TARGET_REG_ZERO_IS_CONST && regID == 0)) {
+    if (regID < 0 || regID >= 32)
+      return NULL;
+    return strdup(mcRegNames[regID]);
   }
-  int32_t imm = instr->immediate;
 
+  if (regID < 0)
+    return strdup("invalid_reg");
+  buf = calloc(24, sizeof(char));
+  snprintf(buf, 24, "temp%d", regID);
+  return buf;
+}
+
+
+static void asmPutInstruction(
+    t_asmWriter *w, t_instruction *instr, bool machineRegIDs)
+{
+  t_instrArg *rd = instr->rDest;
+  t_instrArg *rs1 = instr->rSrc1;
+  t_instrArg *rs2 = instr->rSrc2;
+  t_label *address = instr->addressParam;
+  const char *opc = opcodeToString(instr->opcode);
   int format = opcodeToFormat(instr->opcode);
+
+  // Check the arguments required by the format.
+  bool valid;
   switch (format) {
     case FORMAT_OP:
-      if (!instr->rDest || !instr->rSrc1 || !instr->rSrc2)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s, %s, %s", opc, rd, rs1, rs2);
+      valid = rd && rs1 && rs2;
       break;
     case FORMAT_OPIMM:
-      if (!instr->rDest || !instr->rSrc1)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s, %s, %d", opc, rd, rs1, imm);
-      break;
     case FORMAT_LOAD:
-      if (!instr->rDest || !instr->rSrc1)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s, %d(%s)", opc, rd, imm, rs1);
+      valid = rd && rs1;
       break;
     case FORMAT_LOAD_GL:
-      if (!instr->rDest || !instr->addressParam)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s, %s", opc, rd, address);
+    case FORMAT_LA:
+      valid = rd && address;
       break;
     case FORMAT_STORE:
-      if (!instr->rSrc2 || !instr->rSrc1)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s, %d(%s)", opc, rs2, imm, rs1);
+      valid = rs1 && rs2;
       break;
     case FORMAT_STORE_GL:
-      if (!instr->rDest || !instr->rSrc1 || !instr->addressParam)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s, %s, %s", opc, rs1, address, rd);
+      valid = rd && rs1 && address;
       break;
     case FORMAT_BRANCH:
-      if (!instr->rSrc1 || !instr->rSrc2 || !instr->addressParam)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s, %s, %s", opc, rs1, rs2, address);
+      valid = rs1 && rs2 && address;
       break;
     case FORMAT_JUMP:
-      if (!instr->addressParam)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s", opc, address);
+      valid = address != NULL;
       break;
     case FORMAT_LI:
-      if (!instr->rDest)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s, %d", opc, rd, imm);
+      valid = rd != NULL;
       break;
+    default:
+      valid = true;
+  }
+  if (!valid)
+    fatalError("bug: invalid instruction found in the program");
+
+  if (format == FORMAT_SYSTEM) {
+    asmPutString(w, opc);
+    return;
+  }
+  if (format == FORMAT_FUNC || format == FORMAT_AUTO) {
+    if (rd) {
+      asmPutRegister(w, rd, machineRegIDs);
+      asmPutString(w, " = ");
+    }
+    asmPutString(w, opc);
+    asmPutChar(w, '(');
+    if (rs1)
+      asmPutRegister(w, rs1, machineRegIDs);
+    if (rs1 && rs2)
+      asmPutString(w, ", ");
+    if (rs2)
+      asmPutRegister(w, rs2, machineRegIDs);
+    asmPutChar(w, ')');
+    return;
+  }
+
+  size_t start = w->written;
+  asmPutString(w, opc);
+  asmPad(w, start, 6);
+  asmPutChar(w, ' ');
+  switch (format) {
+    case FORMAT_OP:
+    case FORMAT_BRANCH:
+      if (format == FORMAT_OP) {
+        asmPutRegister(w, rd, machineRegIDs);
+        asmPutString(w, ", ");
+      }
+      asmPutRegister(w, rs1, machineRegIDs);
+      asmPutString(w, ", ");
+      asmPutRegister(w, rs2, machineRegIDs);
+      if (format == FORMAT_BRANCH) {
+        asmPutString(w, ", ");
+        asmPutLabel(w, address);
+      }
+      break;
+    case FORMAT_OPIMM:
+      asmPutRegister(w, rd, machineRegIDs);
+      asmPutString(w, ", ");
+      asmPutRegister(w, rs1, machineRegIDs);
+      asmPutString(w, ", ");
+      asmPutInt(w, instr->immediate);
+      break;
+    case FORMAT_LOAD:
+    case FORMAT_STORE:
+      asmPutRegister(w, format == FORMAT_LOAD ? rd : rs2, machineRegIDs);
+      asmPutString(w, ", ");
+      asmPutInt(w, instr->immediate);
+      asmPutChar(w, '(');
+      asmPutRegister(w, rs1, machineRegIDs);
+      asmPutChar(w, ')');
+      break;
+    case FORMAT_LOAD_GL:
     case FORMAT_LA:
-      if (!instr->rDest || !instr->addressParam)
-        fatalError("bug: invalid instruction found in the program");
-      res = snprintf(buf, bufsz, "%-6s %s, %s", opc, rd, address);
+      asmPutRegister(w, rd, machineRegIDs);
+      asmPutString(w, ", ");
+      asmPutLabel(w, address);
       break;
-    case FORMAT_SYSTEM:
-      res = snprintf(buf, bufsz, "%s", opc);
+    case FORMAT_STORE_GL:
+      asmPutRegister(w, rs1, machineRegIDs);
+      asmPutString(w, ", ");
+      asmPutLabel(w, address);
+      asmPutString(w, ", ");
+      asmPutRegister(w, rd, machineRegIDs);
       break;
-    case FORMAT_FUNC:
-    default:
-      if (instr->rDest)
-        buf += sprintf(buf, "%s = ", rd);
-      buf += sprintf(buf, "%s(", opc);
-      if (instr->rSrc1)
-        buf += sprintf(buf, "%s", rs1);
-      if (instr->rSrc1 && instr->rSrc2)
-        buf += sprintf(buf, ", ");
-      if (instr->rSrc2)
-        buf += sprintf(buf, "%s", rs2);
-      buf += sprintf(buf, ")");
-      res = (int)(buf - buf0);
+    case FORMAT_JUMP:
+      asmPutLabel(w, address);
+      break;
+    case FORMAT_LI:
+      asmPutRegister(w, rd, machineRegIDs);
+      asmPutString(w, ", ");
+      asmPutInt(w, instr->immediate);
       break;
   }
+}
 
-  free(address);
-  free(rd);
-  free(rs1);
-  free(rs2);
-  return res;
+
+/// Emits an instruction with its label and its comment, without the final
+/// newline.
+static void asmPutInstructionLine(
+    t_asmWriter *w, t_instruction *instr, bool machineRegIDs)
+{
+  size_t start = w->written;
+  if (instr->label != NULL) {
+    asmPutLabel(w, instr->label);
+    asmPutChar(w, ':');
+  }
+  asmPad(w, start, 8);
+
+  start = w->written;
+  asmPutInstruction(w, instr, machineRegIDs);
+  if (instr->comment) {
+    asmPad(w, start, 48);
+    asmPutString(w, "# ");
+    asmPutString(w, instr->comment);
+  }
 }
 
 
-bool translateForwardDeclarations(t_program *program, FILE *fp)
+bool printInstruction(t_instruction *instr, FILE *fp, bool machineRegIDs)
+{
+  char buf[BUF_LENGTH];
+  t_asmWriter w = {fp, buf, BUF_LENGTH, 0, 0, false};
+  asmPutInstructionLine(&w, instr, machineRegIDs);
+  asmFlush(&w);
+  return !w.error;
+}
+
+
+static void translateForwardDeclarations(t_program *program, t_asmWriter *w)
 {
   for (t_listNode *li = program->labels; li != NULL; li = li->next) {
     t_label *nextLabel = li->data;
@@ -418,85 +559,83 @@ bool translateForwardDeclarations(t_program *program, FILE *fp)
       continue;
 
     if (nextLabel->global) {
-      char *labelName;
-      int res;
-
-      labelName = getLabelName(nextLabel);
-      res = fprintf(fp, "%-8s.global %s\n", "", labelName);
-      free(labelName);
-
-      if (res < 0)
-        return false;
+      asmPutString(w, "        .global ");
+      asmPutLabel(w, nextLabel);
+      asmPutChar(w, '\n');
     }
   }
-
-  return true;
 }
 
 
-bool printInstruction(t_instruction *instr, FILE *fp, bool machineRegIDs)
+/** Emits the .file and .loc directives which attribute the following
+ * instructions to a line of the source code, if the line differs from the
+ * last one emitted.
+ * @param w       The output writer.
+ * @param instr   The instruction about to be emitted.
+ * @param last    The last source location emitted, updated by the function.
+ * @param fileNum The number of the last file declared, updated by the
+ *                function. */
+static void translateSourceLocation(t_asmWriter *w, t_instruction *instr,
+    t_fileLocation *last, int *fileNum)
 {
-  char buf[BUF_LENGTH];
-
-  if (instr->label != NULL) {
-    labelToString(buf, BUF_LENGTH, instr->label, 1);
-  } else {
-    buf[0] = '\0';
-  }
-  if (fprintf(fp, "%-8s", buf) < 0)
-    return false;
-
-  instructionToString(buf, BUF_LENGTH, instr, machineRegIDs);
-  int res;
-  if (instr->comment) {
-    res = fprintf(fp, "%-48s# %s", buf, instr->comment);
-  } else {
-    res = fprintf(fp, "%s", buf);
+  if (!instr->source.file)
+    return;
+  if (instr->source.file != last->file) {
+    (*fileNum)++;
+    asmPutString(w, "        .file ");
+    asmPutInt(w, *fileNum);
+    asmPutString(w, " \"");
+    for (char *p = instr->source.file; *p != '\0'; p++) {
+      if (*p == '"' || *p == '\\')
+        asmPutChar(w, '\\');
+      asmPutChar(w, *p);
+    }
+    asmPutString(w, "\"\n");
+  } else if (instr->source.row == last->row) {
+    return;
   }
-  if (res < 0)
-    return false;
-
-  return true;
+  *last = instr->source;
+  asmPutString(w, "        .loc ");
+  asmPutInt(w, *fileNum);
+  asmPutChar(w, ' ');
+  asmPutInt(w, last->row + 1);
+  asmPutChar(w, '\n');
 }
 
-bool translateCodeSegment(t_program *program, FILE *fp)
+static void translateCodeSegment(t_program *program, t_asmWriter *w)
 {
   if (!program->instructions)
-    return true;
+    return;
 
   // Write the .text directive to switch to the text segment.
-  if (fprintf(fp, "%-8s.text\n", "") < 0)
-    return false;
+  asmPutString(w, "        .text\n");
 
+  t_fileLocation lastSource = nullFileLocation;
+  int fileNum = 0;
   t_listNode *curNode = program->instructions;
   while (curNode != NULL) {
     t_instruction *curInstr = (t_instruction *)curNode->data;
     if (curInstr == NULL)
       fatalError("bug: NULL instruction found in the program");
 
-    if (!printInstruction(curInstr, fp, true))
-      return false;
-    if (fprintf(fp, "\n") < 0)
-      return false;
+    translateSourceLocation(w, curInstr, &lastSource, &fileNum);
+    asmPutInstructionLine(w, curInstr, true);
+    asmPutChar(w, '\n');
 
     curNode = curNode->next;
   }
-  return true;
 }
 
 
-int printGlobalDeclaration(t_symbol *data, FILE *fp)
+static void translateGlobalDeclaration(t_asmWriter *w, t_symbol *data)
 {
-  char buf[BUF_LENGTH];
-
   // Print the label.
+  size_t start = w->written;
   if (data->label != NULL) {
-    labelToString(buf, BUF_LENGTH, data->label, 1);
-  } else {
-    buf[0] = '\0';
+    asmPutLabel(w, data->label);
+    asmPutChar(w, ':');
   }
-  if (fprintf(fp, "%-8s", buf) < 0)
-    return -1;
+  asmPad(w, start, 8);
 
   // Print the directive.
   int size;
@@ -510,56 +649,56 @@ int printGlobalDeclaration(t_symbol *data, FILE *fp)
     default:
       fatalError("bug: invalid data type found in the program");
   }
-  if (fprintf(fp, ".space %d", size) < 0)
-    return -1;
-
-  return 0;
+  asmPutString(w, ".space ");
+  asmPutInt(w, size);
 }
 
-bool translateDataSegment(t_program *program, FILE *fp)
+static void translateDataSegment(t_program *program, t_asmWriter *w)
 {
   // If the symbol table is empty, nothing to do.
   if (program->symbols == NULL)
-    return true;
+    return;
 
-  // Write the .data directive to switch to the data segment.
-  if (fprintf(fp, "%-8s.data\n", "") < 0)
-    return false;
+  // Write the .bss directive to switch to the data segment. All variables are
+  // initialized to zero, so they do not need space in the executable file.
+  asmPutString(w, "        .bss\n");
 
   // Print a static declaration for each symbol.
   t_listNode *li = program->symbols;
   while (li != NULL) {
     t_symbol *symbol = (t_symbol *)li->data;
 
-    if (printGlobalDeclaration(symbol, fp) < 0)
-      return false;
-    if (fprintf(fp, "\n") < 0)
-      return false;
+    translateGlobalDeclaration(w, symbol);
+    asmPutChar(w, '\n');
 
     li = li->next;
   }
-
-  return true;
 }
 
 
 bool writeAssembly(t_program *program, const char *fn)
 {
-  bool res = false;
-  FILE *fp = fopen(fn, "w");
-  if (fp == NULL)
-    return res;
-
-  if (!translateForwardDeclarations(program, fp))
-    goto fail;
-  if (!translateDataSegment(program, fp))
-    goto fail;
-  if (!translateCodeSegment(program, fp))
-    goto fail;
-
-  res = true;
-fail:
-  if (fclose(fp) == EOF)
+  t_asmWriter w = {NULL, NULL, ASM_BUFFER_SIZE, 0, 0, false};
+  w.buf = malloc(ASM_BUFFER_SIZE);
+  if (w.buf == NULL)
+    fatalError("out of memory");
+  w.fp = fopen(fn, "w");
+  if (w.fp == NULL) {
+    free(w.buf);
+    return false;
+  }
+
+  // The whole buffer is written with each call, so stdio would only copy it
+  // once more.
+  setvbuf(w.fp, NULL, _IONBF, 0);
+  translateForwardDeclarations(program, &w);
+  translateDataSegment(program, &w);
+  translateCodeSegment(program, &w);
+  asmFlush(&w);
+
+  free(w.buf);
+  bool res = !w.error;
+  if (fclose(w.fp) == EOF)
     res = false;
   return res;
 }
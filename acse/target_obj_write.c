@@ -0,0 +1,315 @@
+/// @file target_obj_write.c
+/// @brief Generation of the output object file implementation
+
+/* The object, encoding and output modules of asrv32im are linked in acse;
+ * their types have the same names as some of ours, and their diagnostics
+ * functions are renamed when they are built (see the Makefile). Their headers
+ * must be included before any of ours. */
+#define t_instruction t_asmInstruction
+#define t_fileLocation t_asmFileLocation
+#define nullFileLocation asmNullFileLocation
+#define emitError asEmitError
+#define emitWarning asEmitWarning
+#define fatalError asFatalError
+#define setErrorOutput asSetErrorOutput
+#define getErrorOutput asGetErrorOutput
+#include "../asrv32im/object.h"
+#include "../asrv32im/output.h"
+#undef t_instruction
+#undef t_fileLocation
+#undef nullFileLocation
+#undef emitError
+#undef emitWarning
+#undef fatalError
+#undef setErrorOutput
+#undef getErrorOutput
+#undef ERRORS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "errors.h"
+#include "target_obj_write.h"
+#include "target_info.h"
+
+
+/* Returns the opcode of the assembler for an instruction of the lowered
+ * program, as written by writeAssembly() */
+static t_instrOpcode objOpcode(int opcode)
+{
+  switch (opcode) {
+    case OPC_ADD:
+      return INSTR_OPC_ADD;
+    case OPC_SUB:
+      return INSTR_OPC_SUB;
+    case OPC_AND:
+      return INSTR_OPC_AND;
+    case OPC_OR:
+      return INSTR_OPC_OR;
+    case OPC_XOR:
+      return INSTR_OPC_XOR;
+    case OPC_MUL:
+      return INSTR_OPC_MUL;
+    case OPC_DIV:
+      return INSTR_OPC_DIV;
+    case OPC_REM:
+      return INSTR_OPC_REM;
+    case OPC_SLL:
+      return INSTR_OPC_SLL;
+    case OPC_SRL:
+      return INSTR_OPC_SRL;
+    case OPC_SRA:
+      return INSTR_OPC_SRA;
+    case OPC_SLT:
+      return INSTR_OPC_SLT;
+    case OPC_SLTU:
+      return INSTR_OPC_SLTU;
+    case OPC_ADDI:
+      return INSTR_OPC_ADDI;
+    case OPC_ANDI:
+      return INSTR_OPC_ANDI;
+    case OPC_ORI:
+      return INSTR_OPC_ORI;
+    case OPC_XORI:
+      return INSTR_OPC_XORI;
+    case OPC_SLLI:
+      return INSTR_OPC_SLLI;
+    case OPC_SRLI:
+      return INSTR_OPC_SRLI;
+    case OPC_SRAI:
+      return INSTR_OPC_SRAI;
+    case OPC_SLTI:
+      return INSTR_OPC_SLTI;
+    case OPC_SLTIU:
+      return INSTR_OPC_SLTIU;
+    case OPC_J:
+      return INSTR_OPC_J;
+    case OPC_BEQ:
+      return INSTR_OPC_BEQ;
+    case OPC_BNE:
+      return INSTR_OPC_BNE;
+    case OPC_BLT:
+      return INSTR_OPC_BLT;
+    case OPC_BLTU:
+      return INSTR_OPC_BLTU;
+    case OPC_BGE:
+      return INSTR_OPC_BGE;
+    case OPC_BGEU:
+      return INSTR_OPC_BGEU;
+    case OPC_BGT:
+      return INSTR_OPC_BGT;
+    case OPC_BGTU:
+      return INSTR_OPC_BGTU;
+    case OPC_BLE:
+      return INSTR_OPC_BLE;
+    case OPC_BLEU:
+      return INSTR_OPC_BLEU;
+    case OPC_LW:
+      return INSTR_OPC_LW;
+    case OPC_LW_G:
+      return INSTR_OPC_LW_G;
+    case OPC_SW:
+      return INSTR_OPC_SW;
+    case OPC_SW_G:
+      return INSTR_OPC_SW_G;
+    case OPC_LI:
+      return INSTR_OPC_LI;
+    case OPC_LA:
+      return INSTR_OPC_LA;
+    case OPC_NOP:
+      return INSTR_OPC_NOP;
+    case OPC_ECALL:
+      return INSTR_OPC_ECALL;
+    case OPC_EBREAK:
+      return INSTR_OPC_EBREAK;
+  }
+  fatalError("bug: invalid instruction found in the program");
+}
+
+/* Returns the label of the object with the same name as a label of the
+ * program */
+static t_objLabel *objLabel(t_object *obj, t_label *label)
+{
+  char *name = getLabelName(label);
+  t_objLabel *res = objGetLabel(obj, name);
+  free(name);
+  return res;
+}
+
+/* Returns the physical register of an argument of an instruction */
+static t_instrRegID objRegister(t_instrArg *arg)
+{
+  if (!arg)
+    fatalError("bug: invalid instruction found in the program");
+  return arg->ID;
+}
+
+/* Translates an instruction of the program, with the operands written in the
+ * assembly code by writeAssembly() */
+static t_asmInstruction objInstruction(
+    t_object *obj, t_instruction *instr, t_asmFileLocation source)
+{
+  t_asmInstruction res = {0};
+  res.opcode = objOpcode(instr->opcode);
+  res.location = source;
+  res.source = source;
+  res.immMode = INSTR_IMM_CONST;
+
+  switch (instr->opcode) {
+    case OPC_ADD:
+    case OPC_SUB:
+    case OPC_AND:
+    case OPC_OR:
+    case OPC_XOR:
+    case OPC_MUL:
+    case OPC_DIV:
+    case OPC_REM:
+    case OPC_SLL:
+    case OPC_SRL:
+    case OPC_SRA:
+    case OPC_SLT:
+    case OPC_SLTU:
+      res.dest = objRegister(instr->rDest);
+      res.src1 = objRegister(instr->rSrc1);
+      res.src2 = objRegister(instr->rSrc2);
+      break;
+    case OPC_ADDI:
+    case OPC_ANDI:
+    case OPC_ORI:
+    case OPC_XORI:
+    case OPC_SLLI:
+    case OPC_SRLI:
+    case OPC_SRAI:
+    case OPC_SLTI:
+    case OPC_SLTIU:
+    case OPC_LW:
+      res.dest = objRegister(instr->rDest);
+      res.src1 = objRegister(instr->rSrc1);
+      res.constant = instr->immediate;
+      break;
+    case OPC_SW:
+      res.src1 = objRegister(instr->rSrc1);
+      res.src2 = objRegister(instr->rSrc2);
+      res.constant = instr->immediate;
+      break;
+    case OPC_LI:
+      res.dest = objRegister(instr->rDest);
+      res.constant = instr->immediate;
+      break;
+    case OPC_LA:
+    case OPC_LW_G:
+      res.dest = objRegister(instr->rDest);
+      break;
+    case OPC_SW_G:
+      // `sw rs, label, rt' stores rs, using rt as a temporary register.
+      res.src2 = objRegister(instr->rSrc1);
+      res.dest = objRegister(instr->rDest);
+      break;
+    case OPC_BEQ:
+    case OPC_BNE:
+    case OPC_BLT:
+    case OPC_BLTU:
+    case OPC_BGE:
+    case OPC_BGEU:
+    case OPC_BGT:
+    case OPC_BGTU:
+    case OPC_BLE:
+    case OPC_BLEU:
+      res.src1 = objRegister(instr->rSrc1);
+      res.src2 = objRegister(instr->rSrc2);
+      break;
+  }
+
+  switch (instr->opcode) {
+    case OPC_J:
+    case OPC_LA:
+    case OPC_LW_G:
+    case OPC_SW_G:
+    case OPC_BEQ:
+    case OPC_BNE:
+    case OPC_BLT:
+    case OPC_BLTU:
+    case OPC_BGE:
+    case OPC_BGEU:
+    case OPC_BGT:
+    case OPC_BGTU:
+    case OPC_BLE:
+    case OPC_BLEU:
+      if (!instr->addressParam)
+        fatalError("bug: invalid instruction found in the program");
+      res.immMode = INSTR_IMM_LBL;
+      res.label = objLabel(obj, instr->addressParam);
+      break;
+  }
+  return res;
+}
+
+static void translateDataSegment(t_program *program, t_object *obj)
+{
+  t_objSection *bss = objGetSection(obj, OBJ_SECTION_BSS);
+
+  for (t_listNode *li = program->symbols; li != NULL; li = li->next) {
+    t_symbol *symbol = (t_symbol *)li->data;
+    t_data data = {0};
+
+    switch (symbol->type) {
+      case TYPE_INT:
+        data.dataSize = 4 / TARGET_PTR_GRANULARITY;
+        break;
+      case TYPE_INT_ARRAY:
+        data.dataSize =
+            (4 / TARGET_PTR_GRANULARITY) * (size_t)symbol->arraySize;
+        break;
+      default:
+        fatalError("bug: invalid data type found in the program");
+    }
+    data.initialized = false;
+    data.location = asmNullFileLocation;
+    if (symbol->label)
+      objSecDeclareLabel(bss, objLabel(obj, symbol->label));
+    objSecAppendData(bss, data);
+  }
+}
+
+static void translateCodeSegment(t_program *program, t_object *obj)
+{
+  t_objSection *text = objGetSection(obj, OBJ_SECTION_TEXT);
+
+  // The instructions without a source location are attributed to the last
+  // one found, as done by the assembler with the .loc directives.
+  t_asmFileLocation source = asmNullFileLocation;
+  char *lastFile = NULL;
+  for (t_listNode *li = program->instructions; li != NULL; li = li->next) {
+    t_instruction *instr = (t_instruction *)li->data;
+    if (instr == NULL)
+      fatalError("bug: NULL instruction found in the program");
+
+    if (instr->source.file) {
+      if (instr->source.file != lastFile) {
+        lastFile = instr->source.file;
+        source.file = objNewString(obj, lastFile, strlen(lastFile));
+      }
+      source.row = instr->source.row;
+      source.column = 0;
+    }
+    if (instr->label)
+      objSecDeclareLabel(text, objLabel(obj, instr->label));
+    objSecAppendInstruction(text, objInstruction(obj, instr, source));
+  }
+}
+
+bool writeObject(t_program *program, const char *fn)
+{
+  t_object *obj = newObject();
+
+  for (t_listNode *li = program->labels; li != NULL; li = li->next) {
+    t_label *label = li->data;
+    if (!label->isAlias && label->global)
+      objLabelSetGlobal(objLabel(obj, label));
+  }
+  translateDataSegment(program, obj);
+  translateCodeSegment(program, obj);
+
+  bool res = objMaterialize(obj) && outputToELF(obj, fn) == OUT_NO_ERROR;
+  deleteObject(obj);
+  return res;
+}
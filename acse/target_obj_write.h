@@ -0,0 +1,29 @@
+/// @file target_obj_write.h
+/// @brief Generation of the output object file
+
+#ifndef TARGET_OBJ_WRITE_H
+#define TARGET_OBJ_WRITE_H
+
+#include <stdbool.h>
+#include "program.h"
+
+/**
+ * @addtogroup asm_print
+ * @{
+ */
+
+/** Assemble the program and write it to the specified file as an executable
+ * ELF object, like the one produced by asrv32im from the output of
+ * writeAssembly(), without writing the assembly code first.
+ * @param program The program being compiled. Its registers must already be
+ *                allocated.
+ * @param fn      The path of the output file.
+ * @returns false if the program could not be assembled or an error occurred
+ *          while writing to the file. */
+bool writeObject(t_program *program, const char *fn);
+
+/**
+ * @}
+ */
+
+#endif
@@ -352,3 +352,237 @@ void doTargetSpecificTransformations(t_program *program)
   fixSyscalls(program);
   fixUnsupportedImmediates(program);
 }
+
+
+/* Returns whether an instruction copies a register to another, and in that
+ * case the source register. */
+static bool isMoveInstr(t_instruction *instr, t_regID *src)
+{
+  if (instr->rDest == NULL || instr->rSrc1 == NULL)
+    return false;
+  if (instr->opcode == OPC_ADDI && IMM(instr) == 0 &&
+      instr->addressParam == NULL) {
+    *src = RS1(instr);
+    return true;
+  }
+  if (instr->opcode == OPC_ADD || instr->opcode == OPC_OR ||
+      instr->opcode == OPC_XOR || instr->opcode == OPC_SUB) {
+    if (RS2(instr) == REG_0) {
+      *src = RS1(instr);
+      return true;
+    }
+    if (RS1(instr) == REG_0 && instr->opcode != OPC_SUB) {
+      *src = RS2(instr);
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Returns whether an instruction only computes its destination register from
+ * the source registers it names explicitly. */
+static bool isComputationInstr(t_instruction *instr)
+{
+  return (instr->opcode >= OPC_ADD && instr->opcode <= OPC_SLTIU) ||
+      instr->opcode == OPC_LW;
+}
+
+/* Removes a move from a register to itself. */
+static bool peepholeSelfMove(t_program *program, t_listNode *node)
+{
+  t_instruction *instr = node->data;
+  t_regID src;
+  if (!isMoveInstr(instr, &src) || RD(instr) != src || src == REG_0)
+    return false;
+  removeInstructionAt(program, node);
+  return true;
+}
+
+/* Removes a jump or a branch to the instruction immediately following it. */
+static bool peepholeJumpToNext(t_program *program, t_listNode *node)
+{
+  t_instruction *instr = node->data;
+  if (!isJumpInstruction(instr) || node->next == NULL)
+    return false;
+  t_instruction *next = node->next->data;
+  if (next->label == NULL ||
+      next->label->labelID != instr->addressParam->labelID)
+    return false;
+  removeInstructionAt(program, node);
+  return true;
+}
+
+/* Removes the second move of a pair copying two registers back and forth. */
+static bool peepholeMoveBack(t_program *program, t_listNode *node)
+{
+  if (node->next == NULL)
+    return false;
+  t_instruction *first = node->data;
+  t_instruction *second = node->next->data;
+  t_regID src1, src2;
+  if (second->label || !isMoveInstr(first, &src1) ||
+      !isMoveInstr(second, &src2))
+    return false;
+  if (RD(second) != src1 || src2 != RD(first))
+    return false;
+  removeInstructionAt(program, node->next);
+  return true;
+}
+
+/* Replaces a load from the address just written by a store with a copy of
+ * the stored register. Both the global form and the one with a base
+ * register are handled. */
+static bool peepholeStoreLoad(t_program *program, t_listNode *node)
+{
+  if (node->next == NULL)
+    return false;
+  t_instruction *store = node->data;
+  t_instruction *load = node->next->data;
+  if (load->label)
+    return false;
+
+  t_regID value;
+  if (store->opcode == OPC_SW_G && load->opcode == OPC_LW_G) {
+    if (store->addressParam->labelID != load->addressParam->labelID)
+      return false;
+    // The temporary register of the store is overwritten by it.
+    value = RS1(store);
+    if (value == RD(store))
+      return false;
+  } else if (store->opcode == OPC_SW && load->opcode == OPC_LW) {
+    if (RS1(store) != RS1(load) || IMM(store) != IMM(load))
+      return false;
+    value = RS2(store);
+  } else {
+    return false;
+  }
+
+  t_instruction *move = genADDI(NULL, RD(load), value, 0);
+  move->source = load->source;
+  addInstrAfter(program, node->next, move);
+  removeInstructionAt(program, node->next);
+  return true;
+}
+
+/* Replaces a reload of a variable through a new address register with a
+ * copy of the value just stored to the variable:
+ *   la ra, L; sw rs, 0(ra); la rd, L; lw rd, 0(rd)
+ * becomes
+ *   la ra, L; sw rs, 0(ra); mv rd, rs */
+static bool peepholeStoreReload(t_program *program, t_listNode *node)
+{
+  t_listNode *nodes[4];
+  nodes[0] = node;
+  for (int i = 1; i < 4; i++) {
+    if (nodes[i - 1]->next == NULL)
+      return false;
+    nodes[i] = nodes[i - 1]->next;
+    if (((t_instruction *)nodes[i]->data)->label)
+      return false;
+  }
+  t_instruction *la1 = nodes[0]->data, *store = nodes[1]->data;
+  t_instruction *la2 = nodes[2]->data, *load = nodes[3]->data;
+  if (la1->opcode != OPC_LA || store->opcode != OPC_SW ||
+      la2->opcode != OPC_LA || load->opcode != OPC_LW)
+    return false;
+  if (la1->addressParam->labelID != la2->addressParam->labelID ||
+      RS1(store) != RD(la1) || IMM(store) != 0 || RD(la2) != RD(load) ||
+      RS1(load) != RD(la2) || IMM(load) != 0)
+    return false;
+
+  t_instruction *move = genADDI(NULL, RD(load), RS2(store), 0);
+  move->source = la2->source;
+  addInstrAfter(program, nodes[3], move);
+  removeInstructionAt(program, nodes[3]);
+  removeInstructionAt(program, nodes[2]);
+  return true;
+}
+
+/* Removes a `la' of the same address loaded in the same register two
+ * instructions before. */
+static bool peepholeRedundantLA(t_program *program, t_listNode *node)
+{
+  if (node->next == NULL || node->next->next == NULL)
+    return false;
+  t_instruction *la1 = node->data;
+  t_instruction *middle = node->next->data;
+  t_instruction *la2 = node->next->next->data;
+  if (la1->opcode != OPC_LA || la2->opcode != OPC_LA || middle->label ||
+      la2->label)
+    return false;
+  if (RD(la1) != RD(la2) ||
+      la1->addressParam->labelID != la2->addressParam->labelID)
+    return false;
+  if (middle->opcode == OPC_ECALL ||
+      (middle->rDest && RD(middle) == RD(la1)))
+    return false;
+  removeInstructionAt(program, node->next->next);
+  return true;
+}
+
+/* Removes a move whose destination is overwritten by the next instruction,
+ * which reads the source register of the move instead. For example the
+ * sequence produced by `sne' and `seq':
+ *   sub rd, rs, zero; sltu rd, zero, rd
+ * becomes
+ *   sltu rd, zero, rs */
+static bool peepholeForwardMove(t_program *program, t_listNode *node)
+{
+  if (node->next == NULL)
+    return false;
+  t_instruction *move = node->data;
+  t_instruction *next = node->next->data;
+  t_regID src;
+  if (next->label || !isMoveInstr(move, &src) || RD(move) == REG_0 ||
+      !isComputationInstr(next) || RD(next) != RD(move))
+    return false;
+
+  // If the next instruction does not read the destination of the move, the
+  // move is dead anyway.
+  if (next->rSrc1 && RS1(next) == RD(move))
+    RS1(next) = src;
+  if (next->rSrc2 && RS2(next) == RD(move))
+    RS2(next) = src;
+  removeInstructionAt(program, node);
+  return true;
+}
+
+/* Peephole rules, in order of application. Each rule examines the sequence
+ * of instructions starting at the given node, and returns true if it changed
+ * it. A rule never changes the instructions before the node. */
+static bool (*const peepholeRules[])(t_program *, t_listNode *) = {
+    peepholeSelfMove,
+    peepholeJumpToNext,
+    peepholeMoveBack,
+    peepholeStoreLoad,
+    peepholeStoreReload,
+    peepholeRedundantLA,
+    peepholeForwardMove,
+};
+
+int doTargetSpecificOptimizations(t_program *program)
+{
+  int numChanges = 0;
+  t_listNode *curi = program->instructions;
+
+  while (curi) {
+    t_listNode *prev = curi->prev;
+    bool changed = false;
+    for (size_t i = 0; i < sizeof(peepholeRules) / sizeof(*peepholeRules);
+         i++) {
+      if (peepholeRules[i](program, curi)) {
+        changed = true;
+        break;
+      }
+    }
+    if (!changed) {
+      curi = curi->next;
+      continue;
+    }
+    // The change may have made a new sequence starting at the previous
+    // instruction match a rule, so examine it again.
+    numChanges++;
+    curi = prev ? prev : program->instructions;
+  }
+  return numChanges;
+}
@@ -17,6 +17,14 @@
  *                 is performed in-place. */
 void doTargetSpecificTransformations(t_program *program);
 
+/** Perform peephole optimizations on a program whose registers have been
+ *  allocated, removing or simplifying short sequences of target instructions
+ *  which do useless work.
+ *  @param program The program to be optimized. The transformation is
+ *                 performed in-place.
+ *  @returns The number of transformations performed. */
+int doTargetSpecificOptimizations(t_program *program);
+
 /**
  * @}
  */
@@ -0,0 +1,137 @@
+/// @file time_report.c
+/// @brief Measurement of the time and memory used by the compilation phases
+///        implementation
+
+#include <time.h>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "time_report.h"
+#include "list.h"
+
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define HAS_MALLINFO2
+#endif
+
+/* Measurements of a phase */
+typedef struct {
+  /// Number of times the phase ended.
+  int numRuns;
+  /// Wall time of all the runs, in seconds.
+  double wallTime;
+  /// Time when the last run started.
+  double startTime;
+  /// Peak resident memory of the process at the end of the last run, in KiB,
+  /// or -1 if unknown.
+  long maxRSS;
+  /// Bytes of the heap in use at the end of the last run, or -1 if unknown.
+  long heapInUse;
+  /// Size of the program produced by the last run.
+  int numInstructions;
+  int numTemporaries;
+  int numLabels;
+  /// Number of basic blocks, or -1 if the phase did not use a CFG.
+  int numBlocks;
+} t_trPhaseInfo;
+
+bool timeReportEnabled = false;
+
+static t_trPhaseInfo phases[TR_NUM_PHASES];
+
+static const char *phaseNames[TR_NUM_PHASES] = {"parse", "optimize",
+    "lowering", "cfg", "liveness", "allocation", "spills", "peephole",
+    "output"};
+
+
+static double getWallTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static long getMaxRSS(void)
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+static long getHeapInUse(void)
+{
+#ifdef HAS_MALLINFO2
+  struct mallinfo2 info = mallinfo2();
+  return (long)(info.uordblks + info.hblkhd);
+#else
+  return -1;
+#endif
+}
+
+
+void trBegin(t_trPhase phase)
+{
+  if (!timeReportEnabled)
+    return;
+  phases[phase].startTime = getWallTime();
+}
+
+void trEnd(t_trPhase phase, t_program *program, t_cfg *cfg)
+{
+  if (!timeReportEnabled)
+    return;
+  t_trPhaseInfo *info = &phases[phase];
+  info->wallTime += getWallTime() - info->startTime;
+  info->numRuns++;
+  info->maxRSS = getMaxRSS();
+  info->heapInUse = getHeapInUse();
+  info->numInstructions = listLength(program->instructions);
+  info->numTemporaries = program->firstUnusedReg;
+  info->numLabels = listLength(program->labels);
+  info->numBlocks = cfg ? cfg->numBlocks : -1;
+}
+
+
+/* Prints a measurement right-aligned in a column, or a dash if unknown */
+static void printField(FILE *fout, int width, long value)
+{
+  if (value < 0)
+    fprintf(fout, "%*s", width, "-");
+  else
+    fprintf(fout, "%*ld", width, value);
+}
+
+void trPrint(FILE *fout)
+{
+  double totalTime = 0;
+  long maxRSS = -1;
+
+  fprintf(fout, "%-12s%11s%11s%11s%9s%8s%8s%8s\n", "Phase", "Wall (ms)",
+      "RSS (KiB)", "Heap (KiB)", "Instrs", "Temps", "Labels", "Blocks");
+  for (int i = 0; i < TR_NUM_PHASES; i++) {
+    t_trPhaseInfo *info = &phases[i];
+    if (info->numRuns == 0)
+      continue;
+    totalTime += info->wallTime;
+    if (info->maxRSS > maxRSS)
+      maxRSS = info->maxRSS;
+
+    fprintf(fout, "%-12s%11.2f", phaseNames[i], info->wallTime * 1000.0);
+    printField(fout, 11, info->maxRSS);
+    printField(fout, 11, info->heapInUse < 0 ? -1 : info->heapInUse / 1024);
+    printField(fout, 9, info->numInstructions);
+    printField(fout, 8, info->numTemporaries);
+    printField(fout, 8, info->numLabels);
+    printField(fout, 8, info->numBlocks);
+    fprintf(fout, "\n");
+  }
+  fprintf(fout, "%-12s%11.2f", "total", totalTime * 1000.0);
+  printField(fout, 11, maxRSS);
+  fprintf(fout, "\n");
+}
@@ -0,0 +1,61 @@
+/// @file time_report.h
+/// @brief Measurement of the time and memory used by the compilation phases
+
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "program.h"
+#include "cfg.h"
+
+/**
+ * @defgroup time_report Time Report
+ * @brief Statistics about the cost of each phase of the compilation
+ *
+ * When the report is enabled with the `-time-report' command line option,
+ * the compiler measures the wall time spent in each phase, the peak resident
+ * memory and the heap in use after it, and the size of the program it
+ * produced. The measurements cost nothing when the report is disabled.
+ * @{
+ */
+
+/** Phases of the compilation measured by the report, in the order in which
+ * they are run. */
+typedef enum {
+  TR_PARSE,      ///< Parsing and code generation.
+  TR_OPTIMIZE,   ///< Machine-independent optimizations.
+  TR_LOWERING,   ///< Lowering to the target instructions.
+  TR_CFG,        ///< Construction of the control flow graph.
+  TR_LIVENESS,   ///< Liveness analysis.
+  TR_ALLOCATION, ///< Assignment of the physical registers.
+  TR_SPILLS,     ///< Materialization of the spilled registers.
+  TR_PEEPHOLE,   ///< Peephole optimizations.
+  TR_OUTPUT,     ///< Writing of the output file.
+  TR_NUM_PHASES
+} t_trPhase;
+
+/// True if the measurements are enabled.
+extern bool timeReportEnabled;
+
+/** Starts measuring a phase. A phase may be measured more than once; the
+ * times of all the runs are accumulated.
+ * @param phase The phase which starts. */
+void trBegin(t_trPhase phase);
+
+/** Ends the measurement of a phase, recording the size of its output.
+ * @param phase   The phase which ends.
+ * @param program The program produced by the phase.
+ * @param cfg     The control flow graph of the program, or NULL if the phase
+ *                did not use one. */
+void trEnd(t_trPhase phase, t_program *program, t_cfg *cfg);
+
+/** Prints the report of the phases measured up to now.
+ * @param fout The file where to print the report. */
+void trPrint(FILE *fout);
+
+/**
+ * @}
+ */
+
+#endif
@@ -1,19 +1,41 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
 #include <getopt.h>
 #include "lexer.h"
 #include "parser.h"
 #include "output.h"
 #include "errors.h"
 #include "object.h"
+#include "buildcache.h"
+
+#ifndef ACSE_VERSION
+#define ACSE_VERSION "unknown"
+#endif
 
 
 void usage(const char *name)
 {
   puts("ACSE RISC-V RV32IM assembler, (c) 2022-24 Politecnico di Milano");
-  printf("usage: %s [options] input\n\n", name);
+  printf("usage: %s [options] input...\n\n", name);
+  puts("More than one input file are assembled in parallel and linked");
+  puts("together. Only the labels declared .global, including _start, are");
+  puts("visible from the other files.\n");
   puts("Options:");
-  puts("  -o OBJFILE    Name the output OBJFILE (default output.o)");
-  puts("  -h, --help    Displays available options");
+  puts("  -o OBJFILE        Name the output OBJFILE (default output.o)");
+  puts("  -c, --rvc         Uses the 16-bit encodings of the C extension for");
+  puts("                      the instructions which have one");
+  puts("  -g, --debug       Writes a line table attributing the instructions");
+  puts("                      to the lines of the input files, unless they");
+  puts("                      follow a .loc directive");
+  puts("  -t, --threads=N   Number of threads used to parse the input files");
+  puts("                      (default: number of processors)");
+  puts("  --cache-dir=DIR   Copies the output from the cache in DIR if the");
+  puts("                      same inputs were already assembled with the");
+  puts("                      same options, and stores it there otherwise.");
+  puts("                      Warnings are not printed again on a hit");
+  puts("  -h, --help        Displays available options");
 }
 
 int main(int argc, char *argv[])
@@ -21,16 +43,42 @@ int main(int argc, char *argv[])
   char *name = argv[0];
   int ch, res = 0;
   static const struct option options[] = {
-      {"help", no_argument, NULL, 'h'},
+      {     "help",       no_argument, NULL, 'h'},
+      {      "rvc",       no_argument, NULL, 'c'},
+      {    "debug",       no_argument, NULL, 'g'},
+      {  "threads", required_argument, NULL, 't'},
+      {"cache-dir", required_argument, NULL, 'C'},
+      {       NULL,                 0, NULL,   0}
   };
 
   char *out = "output.o";
+  bool compressed = false;
+  bool debugLines = false;
+  long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  char *cacheDir = NULL;
+  char *tmpStr;
 
-  while ((ch = getopt_long(argc, argv, "ho:", options, NULL)) != -1) {
+  while ((ch = getopt_long(argc, argv, "cgho:t:", options, NULL)) != -1) {
     switch (ch) {
       case 'o':
         out = optarg;
         break;
+      case 'c':
+        compressed = true;
+        break;
+      case 't':
+        numThreads = strtol(optarg, &tmpStr, 0);
+        if (tmpStr == optarg || *tmpStr != '\0' || numThreads < 1) {
+          emitError(nullFileLocation, "invalid number of threads");
+          return 1;
+        }
+        break;
+      case 'g':
+        debugLines = true;
+        break;
+      case 'C':
+        cacheDir = optarg;
+        break;
       case 'h':
         usage(name);
         return 0;
@@ -45,31 +93,67 @@ int main(int argc, char *argv[])
   if (argc < 1) {
     usage(name);
     return 1;
-  } else if (argc > 1) {
-    emitError(nullFileLocation, "cannot assemble more than one file");
-    return 1;
+  }
+  if (numThreads < 1)
+    numThreads = 1;
+  else if (numThreads > argc)
+    numThreads = argc;
+
+  t_buildCache *cache = NULL;
+  if (cacheDir) {
+    cache = newBuildCache(cacheDir, "asrv32im " ACSE_VERSION);
+    if (compressed)
+      bcacheAddOption(cache, "--rvc");
+    if (debugLines)
+      bcacheAddOption(cache, "--debug");
+    for (int i = 0; cache && i < argc; i++) {
+      // unreadable inputs are reported by the lexer
+      if (!bcacheAddInput(cache, argv[i])) {
+        deleteBuildCache(cache);
+        cache = NULL;
+      }
+    }
+    if (cache && bcacheFetch(cache, out)) {
+      deleteBuildCache(cache);
+      return 0;
+    }
   }
 
   res = 1;
   t_object *obj = NULL;
-  t_lexer *lex = newLexer(argv[0]);
-  if (lex == NULL) {
-    emitError(nullFileLocation, "could not read input file");
+  t_lexer **lexers = calloc((size_t)argc, sizeof(t_lexer *));
+  t_object **objs = calloc((size_t)argc, sizeof(t_object *));
+  if (!lexers || !objs)
+    fatalError("out of memory");
+  if (!parseFiles(argv, argc, (int)numThreads, lexers, objs))
     goto fail;
-  }
-  obj = parseObject(lex);
+  // the objects are all owned by the linked one, even if linking fails
+  obj = argc == 1 ? objs[0] : objLink(objs, argc);
+  for (int i = 0; i < argc; i++)
+    objs[i] = NULL;
   if (obj == NULL)
     goto fail;
+
+  objSetCompressed(obj, compressed);
+  objSetDebugLines(obj, debugLines);
   if (!objMaterialize(obj))
     goto fail;
   if (outputToELF(obj, out) != OUT_NO_ERROR) {
     emitError(nullFileLocation, "could not write output file");
     goto fail;
   }
+  if (cache)
+    bcacheStore(cache, out);
 
   res = 0;
 fail:
-  deleteLexer(lex);
+  deleteBuildCache(cache);
   deleteObject(obj);
+  for (int i = 0; i < argc; i++)
+    deleteObject(objs[i]);
+  free(objs);
+  for (int i = 0; i < argc; i++)
+    deleteLexer(lexers[i]);
+  free(lexers);
   return res;
 }
@@ -0,0 +1,30 @@
+#ifndef BUILDCACHE_H
+#define BUILDCACHE_H
+
+#include <stdbool.h>
+
+/* Cache of the output files, in a directory which can be shared by any
+ * number of concurrent runs. An entry is keyed by the name and the version of
+ * the tool, by the options which affect the output and by the contents of the
+ * input files, all of which are stored in the entry and compared on lookup,
+ * so that a hash collision can only cause a miss. Entries are written to a
+ * temporary file and then renamed, so a reader never sees a partial entry.
+ *   The cache is only an optimization: when it cannot be read or written the
+ * output is simply produced, or not stored, without reporting any error. */
+
+typedef struct t_buildCache t_buildCache;
+
+t_buildCache *newBuildCache(const char *dir, const char *tool);
+void deleteBuildCache(t_buildCache *cache);
+
+/* Adds the contents of an input file to the key. Returns false if the file
+ * cannot be read. */
+bool bcacheAddInput(t_buildCache *cache, const char *path);
+void bcacheAddOption(t_buildCache *cache, const char *option);
+
+/* On a hit, writes the cached output to outPath and returns true */
+bool bcacheFetch(t_buildCache *cache, const char *outPath);
+/* Stores the output just written to outPath */
+void bcacheStore(t_buildCache *cache, const char *outPath);
+
+#endif
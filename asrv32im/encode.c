@@ -97,9 +97,240 @@ static uint32_t encPackJFormat(int opcode, int rd, int32_t imm)
 }
 
 
-size_t encGetInstrLength(t_instruction instr)
+#define ENC_C_IS_REG(r) ((r) >= 8 && (r) <= 15)
+#define ENC_C_REG(r)    ((r) - 8)
+
+static int32_t encSignExtend(int32_t x, int bits)
+{
+  uint32_t sign = (uint32_t)1 << (uint32_t)(bits - 1);
+  return (int32_t)((((uint32_t)x & MASK(bits)) ^ sign) - sign);
+}
+
+static bool encFitsSigned(int32_t x, int bits)
+{
+  return x >= -((int32_t)1 << (bits - 1)) && x < ((int32_t)1 << (bits - 1));
+}
+
+/* Encodes the instruction with one of the 16-bit encodings of the C
+ * extension, if there is one for its operands. */
+static bool encCompressedInstruction(t_instruction instr, uint16_t *out)
+{
+  int rd = instr.dest, rs1 = instr.src1, rs2 = instr.src2, tmp;
+  int32_t imm = instr.constant;
+  uint32_t res;
+
+  switch (instr.opcode) {
+    case INSTR_OPC_ADDI:
+      imm = encSignExtend(imm, 12);
+      if (rd == 0) {
+        if (rs1 != 0 || imm != 0)
+          return false;
+        res = 0x0001; // c.nop
+      } else if (rs1 == rd && imm != 0 && encFitsSigned(imm, 6)) {
+        res = 0x0001 | SHIFT_MASK(imm >> 5, 12, 13) | SHIFT_MASK(rd, 7, 12) |
+            SHIFT_MASK(imm, 2, 7); // c.addi
+      } else if (rs1 == 0 && encFitsSigned(imm, 6)) {
+        res = 0x4001 | SHIFT_MASK(imm >> 5, 12, 13) | SHIFT_MASK(rd, 7, 12) |
+            SHIFT_MASK(imm, 2, 7); // c.li
+      } else if (rs1 != 0 && imm == 0) {
+        res = 0x8002 | SHIFT_MASK(rd, 7, 12) | SHIFT_MASK(rs1, 2, 7); // c.mv
+      } else if (rd == 2 && rs1 == 2 && imm != 0 && imm % 16 == 0 &&
+          encFitsSigned(imm, 10)) {
+        res = 0x6101 | SHIFT_MASK(imm >> 9, 12, 13) |
+            SHIFT_MASK(imm >> 4, 6, 7) | SHIFT_MASK(imm >> 6, 5, 6) |
+            SHIFT_MASK(imm >> 7, 3, 5) |
+            SHIFT_MASK(imm >> 5, 2, 3); // c.addi16sp
+      } else if (rs1 == 2 && ENC_C_IS_REG(rd) && imm > 0 && imm < 0x400 &&
+          imm % 4 == 0) {
+        res = 0x0000 | SHIFT_MASK(imm >> 4, 11, 13) |
+            SHIFT_MASK(imm >> 6, 7, 11) | SHIFT_MASK(imm >> 2, 6, 7) |
+            SHIFT_MASK(imm >> 3, 5, 6) |
+            SHIFT_MASK(ENC_C_REG(rd), 2, 5); // c.addi4spn
+      } else {
+        return false;
+      }
+      break;
+
+    case INSTR_OPC_SLLI:
+      if (rd == 0 || rs1 != rd || imm <= 0 || imm > 31)
+        return false;
+      res = 0x0002 | SHIFT_MASK(rd, 7, 12) | SHIFT_MASK(imm, 2, 7); // c.slli
+      break;
+
+    case INSTR_OPC_SRLI:
+    case INSTR_OPC_SRAI:
+      if (!ENC_C_IS_REG(rd) || rs1 != rd || imm <= 0 || imm > 31)
+        return false;
+      res = (instr.opcode == INSTR_OPC_SRLI ? 0x8001 : 0x8401) |
+          SHIFT_MASK(ENC_C_REG(rd), 7, 10) |
+          SHIFT_MASK(imm, 2, 7); // c.srli, c.srai
+      break;
+
+    case INSTR_OPC_ANDI:
+      imm = encSignExtend(imm, 12);
+      if (!ENC_C_IS_REG(rd) || rs1 != rd || !encFitsSigned(imm, 6))
+        return false;
+      res = 0x8801 | SHIFT_MASK(imm >> 5, 12, 13) |
+          SHIFT_MASK(ENC_C_REG(rd), 7, 10) | SHIFT_MASK(imm, 2, 7); // c.andi
+      break;
+
+    case INSTR_OPC_ADD:
+      if (rd == 0)
+        return false;
+      if (rs1 == 0 && rs2 != 0) {
+        res = 0x8002 | SHIFT_MASK(rd, 7, 12) | SHIFT_MASK(rs2, 2, 7); // c.mv
+        break;
+      }
+      if (rs2 == rd) {
+        tmp = rs1;
+        rs1 = rs2;
+        rs2 = tmp;
+      }
+      if (rs1 != rd || rs2 == 0)
+        return false;
+      res = 0x9002 | SHIFT_MASK(rd, 7, 12) | SHIFT_MASK(rs2, 2, 7); // c.add
+      break;
+
+    case INSTR_OPC_XOR:
+    case INSTR_OPC_OR:
+    case INSTR_OPC_AND:
+      if (rs2 == rd) {
+        tmp = rs1;
+        rs1 = rs2;
+        rs2 = tmp;
+      }
+      // fallthrough
+    case INSTR_OPC_SUB:
+      if (!ENC_C_IS_REG(rd) || rs1 != rd || !ENC_C_IS_REG(rs2))
+        return false;
+      tmp = instr.opcode == INSTR_OPC_SUB ? 0
+          : instr.opcode == INSTR_OPC_XOR ? 1
+          : instr.opcode == INSTR_OPC_OR  ? 2
+                                          : 3;
+      res = 0x8C01 | SHIFT_MASK(ENC_C_REG(rd), 7, 10) | SHIFT_MASK(tmp, 5, 7) |
+          SHIFT_MASK(ENC_C_REG(rs2), 2, 5); // c.sub, c.xor, c.or, c.and
+      break;
+
+    case INSTR_OPC_LUI:
+      imm = encSignExtend(imm, 20);
+      if (rd == 0 || rd == 2 || imm == 0 || !encFitsSigned(imm, 6))
+        return false;
+      res = 0x6001 | SHIFT_MASK(imm >> 5, 12, 13) | SHIFT_MASK(rd, 7, 12) |
+          SHIFT_MASK(imm, 2, 7); // c.lui
+      break;
+
+    case INSTR_OPC_LW:
+      imm = encSignExtend(imm, 12);
+      if (imm < 0 || imm % 4 != 0)
+        return false;
+      if (ENC_C_IS_REG(rd) && ENC_C_IS_REG(rs1) && imm < 0x80) {
+        res = 0x4000 | SHIFT_MASK(imm >> 3, 10, 13) |
+            SHIFT_MASK(ENC_C_REG(rs1), 7, 10) | SHIFT_MASK(imm >> 2, 6, 7) |
+            SHIFT_MASK(imm >> 6, 5, 6) |
+            SHIFT_MASK(ENC_C_REG(rd), 2, 5); // c.lw
+      } else if (rs1 == 2 && rd != 0 && imm < 0x100) {
+        res = 0x4002 | SHIFT_MASK(imm >> 5, 12, 13) | SHIFT_MASK(rd, 7, 12) |
+            SHIFT_MASK(imm >> 2, 4, 7) |
+            SHIFT_MASK(imm >> 6, 2, 4); // c.lwsp
+      } else {
+        return false;
+      }
+      break;
+
+    case INSTR_OPC_SW:
+      imm = encSignExtend(imm, 12);
+      if (imm < 0 || imm % 4 != 0)
+        return false;
+      if (ENC_C_IS_REG(rs1) && ENC_C_IS_REG(rs2) && imm < 0x80) {
+        res = 0xC000 | SHIFT_MASK(imm >> 3, 10, 13) |
+            SHIFT_MASK(ENC_C_REG(rs1), 7, 10) | SHIFT_MASK(imm >> 2, 6, 7) |
+            SHIFT_MASK(imm >> 6, 5, 6) |
+            SHIFT_MASK(ENC_C_REG(rs2), 2, 5); // c.sw
+      } else if (rs1 == 2 && imm < 0x100) {
+        res = 0xC002 | SHIFT_MASK(imm >> 2, 9, 13) |
+            SHIFT_MASK(imm >> 6, 7, 9) | SHIFT_MASK(rs2, 2, 7); // c.swsp
+      } else {
+        return false;
+      }
+      break;
+
+    case INSTR_OPC_JAL:
+      if ((rd != 0 && rd != 1) || imm % 2 != 0 || !encFitsSigned(imm, 12))
+        return false;
+      res = (rd == 0 ? 0xA001 : 0x2001) | SHIFT_MASK(imm >> 11, 12, 13) |
+          SHIFT_MASK(imm >> 4, 11, 12) | SHIFT_MASK(imm >> 8, 9, 11) |
+          SHIFT_MASK(imm >> 10, 8, 9) | SHIFT_MASK(imm >> 6, 7, 8) |
+          SHIFT_MASK(imm >> 7, 6, 7) | SHIFT_MASK(imm >> 1, 3, 6) |
+          SHIFT_MASK(imm >> 5, 2, 3); // c.j, c.jal
+      break;
+
+    case INSTR_OPC_JALR:
+      if ((rd != 0 && rd != 1) || rs1 == 0 || encSignExtend(imm, 12) != 0)
+        return false;
+      res = (rd == 0 ? 0x8002 : 0x9002) |
+          SHIFT_MASK(rs1, 7, 12); // c.jr, c.jalr
+      break;
+
+    case INSTR_OPC_BEQ:
+    case INSTR_OPC_BNE:
+      if (rs1 == 0)
+        rs1 = rs2;
+      else if (rs2 != 0)
+        return false;
+      if (!ENC_C_IS_REG(rs1) || imm % 2 != 0 || !encFitsSigned(imm, 9))
+        return false;
+      res = (instr.opcode == INSTR_OPC_BEQ ? 0xC001 : 0xE001) |
+          SHIFT_MASK(imm >> 8, 12, 13) | SHIFT_MASK(imm >> 3, 10, 12) |
+          SHIFT_MASK(ENC_C_REG(rs1), 7, 10) | SHIFT_MASK(imm >> 6, 5, 7) |
+          SHIFT_MASK(imm >> 1, 3, 5) |
+          SHIFT_MASK(imm >> 5, 2, 3); // c.beqz, c.bnez
+      break;
+
+    case INSTR_OPC_EBREAK:
+      res = 0x9002; // c.ebreak
+      break;
+
+    default:
+      return false;
+  }
+
+  *out = (uint16_t)res;
+  return true;
+}
+
+
+size_t encGetInstrLength(t_instruction instr, bool compressed)
+{
+  uint16_t tmp;
+
+  if (!compressed || instr.uncompressed)
+    return 4;
+  // Branches to labels are compressed until encRelaxInstruction finds that
+  // their label is too far
+  if (instr.immMode == INSTR_IMM_LBL) {
+    if (instr.opcode != INSTR_OPC_JAL && instr.opcode != INSTR_OPC_BEQ &&
+        instr.opcode != INSTR_OPC_BNE)
+      return 4;
+    instr.constant = 0;
+  } else if (instr.immMode != INSTR_IMM_CONST) {
+    return 4;
+  }
+  return encCompressedInstruction(instr, &tmp) ? 2 : 4;
+}
+
+
+bool encRelaxInstruction(t_instruction *instr, uint32_t pc)
 {
-  return 4;
+  uint16_t tmp;
+
+  if (instr->immMode != INSTR_IMM_LBL || encGetInstrLength(*instr, true) != 2)
+    return false;
+  t_instruction actual = *instr;
+  actual.constant = (int32_t)(objLabelGetPointer(instr->label) - pc);
+  if (encCompressedInstruction(actual, &tmp))
+    return false;
+  instr->uncompressed = true;
+  return true;
 }
 
 
@@ -111,7 +342,8 @@ typedef struct t_encInstrData {
   int funct7; // also used for immediates
 } t_encInstrData;
 
-bool encPhysicalInstruction(t_instruction instr, uint32_t pc, t_data *res)
+bool encPhysicalInstruction(
+    t_instruction instr, uint32_t pc, bool compressed, t_data *res)
 {
   static const t_encInstrData opInstData[] = {
       {   INSTR_OPC_ADD, 'R',     ENC_OPCODE_OP,  0,      0x00},
@@ -165,6 +397,18 @@ bool encPhysicalInstruction(t_instruction instr, uint32_t pc, t_data *res)
   };
   const t_encInstrData *info;
   uint32_t buf;
+  uint16_t half;
+
+  if (encGetInstrLength(instr, compressed) == 2) {
+    bool ok = encCompressedInstruction(instr, &half);
+    assert(ok && "compressed instruction does not fit");
+    (void)ok;
+    res->initialized = 1;
+    res->dataSize = 2;
+    res->data[0] = half & 0xFF;
+    res->data[1] = (half >> 8) & 0xFF;
+    return true;
+  }
 
   for (info = opInstData; info->instID != -1; info++) {
     if (info->instID == instr.opcode)
@@ -362,8 +606,11 @@ int encExpandPseudoInstruction(
       mInstBuf[mInstSz++] = instr;
   }
 
-  for (int i = 0; i < mInstSz; i++)
+  for (int i = 0; i < mInstSz; i++) {
+    mInstBuf[i].uncompressed = false;
     mInstBuf[i].location = instr.location;
+    mInstBuf[i].source = instr.source;
+  }
   return mInstSz;
 }
 
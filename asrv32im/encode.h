@@ -8,10 +8,14 @@
 
 #define MAX_EXP_FACTOR 2
 
-size_t encGetInstrLength(t_instruction instr);
+size_t encGetInstrLength(t_instruction instr, bool compressed);
 int encExpandPseudoInstruction(
     t_instruction instr, t_instruction res[MAX_EXP_FACTOR]);
+/* Forces the 32-bit encoding of a compressed branch or jump whose label is
+ * out of range, and returns true if it did so */
+bool encRelaxInstruction(t_instruction *instr, uint32_t pc);
 bool encResolveImmediates(t_instruction *instr, uint32_t pc);
-bool encPhysicalInstruction(t_instruction instr, uint32_t pc, t_data *out);
+bool encPhysicalInstruction(
+    t_instruction instr, uint32_t pc, bool compressed, t_data *out);
 
 #endif
@@ -3,17 +3,31 @@
 #include <stdio.h>
 #include "errors.h"
 
+static __thread FILE *errorOutput = NULL;
+
+
+void setErrorOutput(FILE *fp)
+{
+  errorOutput = fp;
+}
+
+FILE *getErrorOutput(void)
+{
+  return errorOutput ? errorOutput : stderr;
+}
+
 
 static void printMessage(
     t_fileLocation loc, const char *category, const char *fmt, va_list arg)
 {
+  FILE *out = getErrorOutput();
   if (loc.file && loc.row >= 0 && loc.column >= 0)
-    fprintf(stderr, "%s:%d:%d: %s: ", loc.file, loc.row + 1, loc.column + 1,
+    fprintf(out, "%s:%d:%d: %s: ", loc.file, loc.row + 1, loc.column + 1,
         category);
   else
-    fprintf(stderr, "%s: ", category);
-  vfprintf(stderr, fmt, arg);
-  fputc('\n', stderr);
+    fprintf(out, "%s: ", category);
+  vfprintf(out, fmt, arg);
+  fputc('\n', out);
 }
 
 void emitError(t_fileLocation loc, const char *fmt, ...)
@@ -35,6 +49,8 @@ void emitWarning(t_fileLocation loc, const char *fmt, ...)
 __attribute__((noreturn)) void fatalError(const char *fmt, ...)
 {
   va_list args;
+  // the program exits, so the message cannot wait in another stream
+  errorOutput = NULL;
   va_start(args, fmt);
   printMessage(nullFileLocation, "fatal error", fmt, args);
   va_end(args);
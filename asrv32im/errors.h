@@ -1,6 +1,7 @@
 #ifndef ERRORS_H
 #define ERRORS_H
 
+#include <stdio.h>
 #include <stddef.h>
 
 typedef struct {
@@ -11,6 +12,11 @@ typedef struct {
 
 static const t_fileLocation nullFileLocation = {NULL, -1, -1};
 
+/* Diagnostics are written to stderr unless another stream was set for the
+ * calling thread */
+void setErrorOutput(FILE *fp);
+FILE *getErrorOutput(void);
+
 void emitError(t_fileLocation loc, const char *fmt, ...);
 void emitWarning(t_fileLocation loc, const char *fmt, ...);
 
@@ -4,15 +4,40 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "lexer.h"
 #include "errors.h"
 
+#define LEX_POOL_MIN_SIZE 1024
+
+/* Identifier interned in the string pool of the lexer. Keywords are interned
+ * too, with the token they produce. */
+typedef struct t_lexString {
+  uint32_t hash;
+  size_t length;
+  t_tokenID keywordID;
+  int32_t keywordInfo;
+  char text[];
+} t_lexString;
+
 struct t_lexer {
-  char *buf;
+  /* NUL terminated contents of the file */
+  const char *buf;
   size_t bufSize;
-  char *nextTokenPtr;
+  /* size of the mapping of the file, 0 if buf was allocated with malloc */
+  size_t mapSize;
+  const char *nextTokenPtr;
   t_fileLocation nextTokenLoc;
-  char *lookahead;
+  const char *lookahead;
+  /* open addressing hash table of the interned strings, with linear
+   * probing; its size is a power of two and it is never more than half
+   * full */
+  t_lexString **pool;
+  size_t poolSize;
+  size_t poolUsed;
 };
 
 
@@ -28,38 +53,134 @@ static char *lexRangeToString(const char *begin, const char *end)
 }
 
 
-t_lexer *newLexer(const char *fn)
+static uint32_t lexHashString(const char *str, size_t length)
 {
-  t_lexer *lex = calloc(1, sizeof(t_lexer));
-  if (!lex)
+  // FNV-1a
+  uint32_t hash = 2166136261U;
+  for (size_t i = 0; i < length; i++)
+    hash = (hash ^ (uint8_t)str[i]) * 16777619U;
+  return hash;
+}
+
+static t_lexString **lexPoolSlot(
+    t_lexer *lex, const char *str, size_t length, uint32_t hash)
+{
+  size_t mask = lex->poolSize - 1;
+  size_t i = hash & mask;
+  t_lexString **slot;
+  for (; *(slot = &lex->pool[i]) != NULL; i = (i + 1) & mask) {
+    if ((*slot)->hash == hash && (*slot)->length == length &&
+        memcmp((*slot)->text, str, length) == 0)
+      break;
+  }
+  return slot;
+}
+
+static void lexGrowPool(t_lexer *lex)
+{
+  t_lexString **old = lex->pool;
+  size_t oldSize = lex->poolSize;
+  lex->poolSize = oldSize ? oldSize * 2 : LEX_POOL_MIN_SIZE;
+  lex->pool = calloc(lex->poolSize, sizeof(t_lexString *));
+  if (!lex->pool)
     fatalError("out of memory");
+  for (size_t i = 0; i < oldSize; i++) {
+    if (old[i])
+      *lexPoolSlot(lex, old[i]->text, old[i]->length, old[i]->hash) = old[i];
+  }
+  free(old);
+}
 
-  FILE *fp = fopen(fn, "r");
-  if (fp == NULL) {
-    free(lex);
-    return NULL;
+static t_lexString *lexIntern(t_lexer *lex, const char *str, size_t length)
+{
+  uint32_t hash = lexHashString(str, length);
+  t_lexString **slot = lexPoolSlot(lex, str, length, hash);
+  if (*slot)
+    return *slot;
+
+  t_lexString *res = malloc(sizeof(t_lexString) + length + 1);
+  if (!res)
+    fatalError("out of memory");
+  res->hash = hash;
+  res->length = length;
+  res->keywordID = TOK_ID;
+  res->keywordInfo = 0;
+  memcpy(res->text, str, length);
+  res->text[length] = '\0';
+  *slot = res;
+  if (++lex->poolUsed > lex->poolSize / 2)
+    lexGrowPool(lex);
+  return res;
+}
+
+static void lexInternKeywords(t_lexer *lex);
+
+
+static bool lexMapFile(t_lexer *lex, const char *fn)
+{
+  int fd = open(fn, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+  long pageSize = sysconf(_SC_PAGESIZE);
+  size_t size = (size_t)st.st_size;
+  /* The rest of the last page of the mapping reads as zeros, and terminates
+   * the buffer. If there is no such space the file is read instead. */
+  if (size == 0 || pageSize <= 0 || size % (size_t)pageSize == 0) {
+    close(fd);
+    return false;
   }
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+  lex->buf = map;
+  lex->bufSize = size;
+  lex->mapSize = size;
+  return true;
+}
+
+static bool lexReadFile(t_lexer *lex, const char *fn)
+{
+  FILE *fp = fopen(fn, "r");
+  if (fp == NULL)
+    return false;
   fseek(fp, 0, SEEK_END);
   long fileSize = ftell(fp);
   if (fileSize < 0) {
-    free(lex);
-    return NULL;
+    fclose(fp);
+    return false;
   }
   fseek(fp, 0, SEEK_SET);
 
-  if (fileSize == 0) {
-    lex->buf = strdup("");
-  } else {
-    lex->buf = malloc(fileSize + 1);
-    if (lex->buf) {
-      size_t readSz = fread(lex->buf, 1, fileSize, fp);
-      lex->buf[readSz] = '\0';
-      lex->bufSize = readSz;
-    }
-  }
-  if (!lex->buf)
+  char *buf = malloc((size_t)fileSize + 1);
+  if (!buf)
     fatalError("out of memory");
+  size_t readSz = fread(buf, 1, (size_t)fileSize, fp);
+  buf[readSz] = '\0';
   fclose(fp);
+  lex->buf = buf;
+  lex->bufSize = readSz;
+  return true;
+}
+
+
+t_lexer *newLexer(const char *fn)
+{
+  t_lexer *lex = calloc(1, sizeof(t_lexer));
+  if (!lex)
+    fatalError("out of memory");
+
+  if (!lexMapFile(lex, fn) && !lexReadFile(lex, fn)) {
+    free(lex);
+    return NULL;
+  }
+  lexGrowPool(lex);
+  lexInternKeywords(lex);
 
   lex->nextTokenPtr = lex->buf;
   lex->nextTokenLoc.file = strdup(fn);
@@ -75,7 +196,13 @@ void deleteLexer(t_lexer *lex)
 {
   if (lex == NULL)
     return;
-  free(lex->buf);
+  if (lex->mapSize)
+    munmap((void *)lex->buf, lex->mapSize);
+  else
+    free((void *)lex->buf);
+  for (size_t i = 0; i < lex->poolSize; i++)
+    free(lex->pool[i]);
+  free(lex->pool);
   free(lex->nextTokenLoc.file);
   free(lex);
 }
@@ -131,8 +258,8 @@ static int lexAcceptIdentifier(t_lexer *lex)
 
 static bool lexIdentEquals(t_lexer *lex, const char *str)
 {
-  char *p = lex->nextTokenPtr;
-  char *end = lex->lookahead;
+  const char *p = lex->nextTokenPtr;
+  const char *end = lex->lookahead;
   while (p != end) {
     if (toupper(*p) != toupper(*str))
       return false;
@@ -177,10 +304,9 @@ void deleteToken(t_token *tok)
 {
   if (!tok)
     return;
-  if (tok->id == TOK_ID)
-    free(tok->value.id);
-  else if (tok->id == TOK_STRING || tok->id == TOK_CHARACTER)
+  if (tok->id == TOK_STRING || tok->id == TOK_CHARACTER)
     free(tok->value.string);
+  free(tok);
 }
 
 
@@ -263,7 +389,8 @@ typedef enum {
   STRTOI_NO_DIGITS
 } t_strToIntErr;
 
-static t_strToIntErr lexStringToU32(char **next, int base, uint32_t *res)
+static t_strToIntErr lexStringToU32(
+    const char **next, int base, uint32_t *res)
 {
   if (!lexIsDigit(**next, base))
     return STRTOI_NO_DIGITS;
@@ -371,6 +498,8 @@ static t_token *lexExpectDirective(t_lexer *lex)
     return createToken(lex, TOK_TEXT);
   if (lexIdentEquals(lex, ".data"))
     return createToken(lex, TOK_DATA);
+  if (lexIdentEquals(lex, ".bss"))
+    return createToken(lex, TOK_BSS);
   if (lexIdentEquals(lex, ".space"))
     return createToken(lex, TOK_SPACE);
   if (lexIdentEquals(lex, ".word"))
@@ -387,6 +516,10 @@ static t_token *lexExpectDirective(t_lexer *lex)
     return createToken(lex, TOK_BALIGN);
   if (lexIdentEquals(lex, ".global"))
     return createToken(lex, TOK_GLOBAL);
+  if (lexIdentEquals(lex, ".file"))
+    return createToken(lex, TOK_FILE);
+  if (lexIdentEquals(lex, ".loc"))
+    return createToken(lex, TOK_LOC);
 
   return lexExpectUnrecognized(lex);
 }
@@ -417,7 +550,7 @@ typedef struct t_keywordData {
   int32_t info;
 } t_keywordData;
 
-static t_token *lexExpectIdentifierOrKeyword(t_lexer *lex)
+static void lexInternKeywords(t_lexer *lex)
 {
   static const t_keywordData kwdata[] = {
       {    "x0",     TOK_REGISTER,                0},
@@ -550,22 +683,40 @@ static t_token *lexExpectIdentifierOrKeyword(t_lexer *lex)
       {    NULL, TOK_UNRECOGNIZED,                0}
   };
 
-  lexAcceptIdentifier(lex);
   for (int i = 0; kwdata[i].text != NULL; i++) {
-    if (lexIdentEquals(lex, kwdata[i].text)) {
-      t_token *res = createToken(lex, kwdata[i].id);
-      if (kwdata[i].id == TOK_REGISTER)
-        res->value.reg = kwdata[i].info;
-      else if (kwdata[i].id == TOK_MNEMONIC)
-        res->value.mnemonic = kwdata[i].info;
-      else
-        assert(0 && "bad keyword data table");
-      return res;
+    t_lexString *str = lexIntern(lex, kwdata[i].text, strlen(kwdata[i].text));
+    str->keywordID = kwdata[i].id;
+    str->keywordInfo = kwdata[i].info;
+  }
+}
+
+static t_token *lexExpectIdentifierOrKeyword(t_lexer *lex)
+{
+  size_t length = (size_t)lexAcceptIdentifier(lex);
+  t_lexString *str = lexIntern(lex, lex->nextTokenPtr, length);
+  if (str->keywordID == TOK_ID) {
+    /* keywords are not case sensitive, and are interned in lowercase */
+    char folded[16];
+    bool upper = false;
+    for (size_t i = 0; i < length && i < sizeof(folded); i++) {
+      folded[i] = (char)tolower(str->text[i]);
+      upper |= folded[i] != str->text[i];
+    }
+    if (upper && length <= sizeof(folded)) {
+      t_lexString *kw =
+          *lexPoolSlot(lex, folded, length, lexHashString(folded, length));
+      if (kw && kw->keywordID != TOK_ID)
+        str = kw;
     }
   }
 
-  t_token *res = createToken(lex, TOK_ID);
-  res->value.id = lexRangeToString(res->begin, res->end);
+  t_token *res = createToken(lex, str->keywordID);
+  if (str->keywordID == TOK_REGISTER)
+    res->value.reg = str->keywordInfo;
+  else if (str->keywordID == TOK_MNEMONIC)
+    res->value.mnemonic = str->keywordInfo;
+  else
+    res->value.id = str->text;
   return res;
 }
 
@@ -22,6 +22,7 @@ enum {
   TOK_REGISTER,
   TOK_TEXT,
   TOK_DATA,
+  TOK_BSS,
   TOK_SPACE,
   TOK_WORD,
   TOK_HALF,
@@ -30,6 +31,8 @@ enum {
   TOK_ALIGN,
   TOK_BALIGN,
   TOK_GLOBAL,
+  TOK_FILE,
+  TOK_LOC,
   TOK_HI,
   TOK_LO,
   TOK_PCREL_HI,
@@ -43,7 +46,8 @@ typedef struct {
   const char *begin;
   const char *end;
   union {
-    char *id;
+    /* interned, valid until the lexer is deleted */
+    const char *id;
     int32_t localRef;
     int32_t number;
     char *string;
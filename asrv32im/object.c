@@ -5,13 +5,34 @@
 #include "object.h"
 #include "encode.h"
 
+#define OBJ_LABEL_TABLE_MIN_SIZE 256
+#define OBJ_ARENA_CHUNK_SIZE 0x10000
+#define OBJ_ARENA_ALIGN 16
+
+/* Bump allocator for everything owned by an object: section items, labels
+ * and label names are never freed one by one, only all together with the
+ * object. Items appended to a section are thus mostly contiguous in memory. */
+typedef struct t_objArenaChunk {
+  struct t_objArenaChunk *next;
+  size_t size;
+  size_t used;
+  uint8_t *data;
+} t_objArenaChunk;
+
+typedef struct t_objArena {
+  t_objArenaChunk *chunks;
+} t_objArena;
+
 struct t_objLabel {
   struct t_objLabel *next;
   char *name;
+  uint32_t hash;
+  bool global;
   t_objSecItem *pointer;
 };
 
 struct t_objSection {
+  t_objArena *arena;
   t_objSectionID id;
   t_objSecItem *items;
   t_objSecItem *lastItem;
@@ -20,41 +41,82 @@ struct t_objSection {
 };
 
 struct t_object {
+  t_objArena arena;
   t_objSection *data;
   t_objSection *text;
+  t_objSection *bss;
+  /* all labels, most recently created first */
   t_objLabel *labelList;
+  /* open addressing hash table of the labels by name, with linear probing;
+   * its size is a power of two and it is never more than half full */
+  t_objLabel **labelTable;
+  size_t labelTableSize;
+  size_t numLabels;
+  bool compressed;
+  bool debugLines;
+  t_objLine *lines;
+  size_t numLines;
+  size_t linesCapacity;
 };
 
 
-static t_objSection *newSection(t_objSectionID id)
+static void *objArenaAlloc(t_objArena *arena, size_t size)
 {
-  t_objSection *sec;
+  size = (size + OBJ_ARENA_ALIGN - 1) & ~(size_t)(OBJ_ARENA_ALIGN - 1);
+  t_objArenaChunk *chunk = arena->chunks;
+  if (!chunk || chunk->size - chunk->used < size) {
+    size_t chunkSize = OBJ_ARENA_CHUNK_SIZE;
+    if (size > chunkSize)
+      chunkSize = size;
+    size_t headSize = (sizeof(t_objArenaChunk) + OBJ_ARENA_ALIGN - 1) &
+        ~(size_t)(OBJ_ARENA_ALIGN - 1);
+    chunk = malloc(headSize + chunkSize);
+    if (!chunk)
+      fatalError("out of memory");
+    chunk->data = (uint8_t *)chunk + headSize;
+    chunk->size = chunkSize;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+  }
+  void *res = chunk->data + chunk->used;
+  chunk->used += size;
+  return res;
+}
 
-  sec = malloc(sizeof(t_objSection));
-  if (!sec)
-    fatalError("out of memory");
-  sec->id = id;
-  sec->items = NULL;
-  sec->lastItem = NULL;
-  sec->start = 0;
-  sec->size = 0;
-  return sec;
+static void deleteArena(t_objArena *arena)
+{
+  t_objArenaChunk *chunk, *next;
+  for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+    next = chunk->next;
+    free(chunk);
+  }
 }
 
 
-static void deleteSection(t_objSection *sec)
+/* Moves all the chunks of the source arena to the destination */
+static void objArenaMerge(t_objArena *dest, t_objArena *src)
 {
-  t_objSecItem *item, *nextItm;
+  t_objArenaChunk **tail = &dest->chunks;
+  while (*tail != NULL)
+    tail = &(*tail)->next;
+  *tail = src->chunks;
+  src->chunks = NULL;
+}
 
-  if (!sec)
-    return;
 
-  for (item = sec->items; item != NULL; item = nextItm) {
-    nextItm = item->next;
-    free(item);
-  }
+static t_objSection *newSection(t_objArena *arena, t_objSectionID id)
+{
+  t_objSection *sec;
 
-  free(sec);
+  sec = objArenaAlloc(arena, sizeof(t_objSection));
+  sec->arena = arena;
+  sec->id = id;
+  sec->items = NULL;
+  sec->lastItem = NULL;
+  sec->start = 0;
+  sec->size = 0;
+  return sec;
 }
 
 
@@ -65,58 +127,193 @@ t_object *newObject(void)
   obj = malloc(sizeof(t_object));
   if (!obj)
     fatalError("out of memory");
-  obj->data = newSection(OBJ_SECTION_DATA);
-  obj->text = newSection(OBJ_SECTION_TEXT);
+  obj->arena.chunks = NULL;
+  obj->data = newSection(&obj->arena, OBJ_SECTION_DATA);
+  obj->text = newSection(&obj->arena, OBJ_SECTION_TEXT);
+  obj->bss = newSection(&obj->arena, OBJ_SECTION_BSS);
   obj->labelList = NULL;
+  obj->labelTableSize = OBJ_LABEL_TABLE_MIN_SIZE;
+  obj->labelTable = calloc(obj->labelTableSize, sizeof(t_objLabel *));
+  if (!obj->labelTable)
+    fatalError("out of memory");
+  obj->numLabels = 0;
+  obj->compressed = false;
+  obj->debugLines = false;
+  obj->lines = NULL;
+  obj->numLines = 0;
+  obj->linesCapacity = 0;
   return obj;
 }
 
 
 void deleteObject(t_object *obj)
 {
-  t_objLabel *lbl, *nextLbl;
-
   if (!obj)
     return;
 
-  deleteSection(obj->data);
-  deleteSection(obj->text);
+  deleteArena(&obj->arena);
+  free(obj->labelTable);
+  free(obj->lines);
+  free(obj);
+}
+
+
+static void objSecMerge(t_objSection *dest, t_objSection *src)
+{
+  if (src->items == NULL)
+    return;
+  if (dest->items != NULL) {
+    t_alignData align = {0};
+    align.alignModulo = 4;
+    align.nopFill = dest->id == OBJ_SECTION_TEXT;
+    align.location = nullFileLocation;
+    objSecAppendAlignmentData(dest, align);
+    dest->lastItem->next = src->items;
+  } else {
+    dest->items = src->items;
+  }
+  dest->lastItem = src->lastItem;
+  src->items = src->lastItem = NULL;
+}
+
+t_object *objLink(t_object *objs[], int numObjs)
+{
+  t_object *res = newObject();
+  bool ok = true;
+
+  // Collect the global labels defined by each object
+  for (int i = 0; i < numObjs; i++) {
+    t_objLabel *lbl = objs[i]->labelList;
+    for (; lbl != NULL; lbl = lbl->next) {
+      if (!lbl->global || !lbl->pointer)
+        continue;
+      t_objLabel *def = objGetLabel(res, lbl->name);
+      if (def->pointer) {
+        emitError(nullFileLocation,
+            "global label \"%s\" defined in more than one file", lbl->name);
+        ok = false;
+      }
+      def->global = true;
+      def->pointer = lbl->pointer;
+    }
+  }
 
-  for (lbl = obj->labelList; lbl != NULL; lbl = nextLbl) {
-    nextLbl = lbl->next;
-    free(lbl->name);
-    free(lbl);
+  // Labels used but not defined by an object may be global labels of the
+  // other objects
+  for (int i = 0; i < numObjs; i++) {
+    t_objLabel *lbl = objs[i]->labelList;
+    for (; lbl != NULL; lbl = lbl->next) {
+      if (lbl->pointer)
+        continue;
+      t_objLabel *def = objFindLabel(res, lbl->name);
+      if (def)
+        lbl->pointer = def->pointer;
+    }
   }
 
-  free(obj);
+  for (int i = 0; i < numObjs; i++) {
+    objSecMerge(res->text, objs[i]->text);
+    objSecMerge(res->data, objs[i]->data);
+    objSecMerge(res->bss, objs[i]->bss);
+    objArenaMerge(&res->arena, &objs[i]->arena);
+    deleteObject(objs[i]);
+  }
+
+  if (!ok) {
+    deleteObject(res);
+    return NULL;
+  }
+  return res;
 }
 
 
-t_objLabel *objFindLabel(t_object *obj, const char *name)
+void objSetCompressed(t_object *obj, bool compressed)
+{
+  obj->compressed = compressed;
+}
+
+
+bool objIsCompressed(t_object *obj)
+{
+  return obj->compressed;
+}
+
+
+void objSetDebugLines(t_object *obj, bool debugLines)
 {
-  t_objLabel *lbl;
-  for (lbl = obj->labelList; lbl != NULL; lbl = lbl->next) {
-    if (strcmp(lbl->name, name) == 0)
+  obj->debugLines = debugLines;
+}
+
+
+char *objNewString(t_object *obj, const char *str, size_t len)
+{
+  char *res = objArenaAlloc(&obj->arena, len + 1);
+  memcpy(res, str, len);
+  res[len] = '\0';
+  return res;
+}
+
+
+static uint32_t objHashLabelName(const char *name)
+{
+  // FNV-1a
+  uint32_t hash = 2166136261U;
+  for (; *name != '\0'; name++)
+    hash = (hash ^ (uint8_t)*name) * 16777619U;
+  return hash;
+}
+
+/* Returns the slot of the table where the label is or should be inserted */
+static t_objLabel **objLabelTableSlot(
+    t_object *obj, const char *name, uint32_t hash)
+{
+  size_t mask = obj->labelTableSize - 1;
+  size_t i = hash & mask;
+  t_objLabel **slot;
+  for (; *(slot = &obj->labelTable[i]) != NULL; i = (i + 1) & mask) {
+    if ((*slot)->hash == hash && strcmp((*slot)->name, name) == 0)
       break;
   }
-  return lbl;
+  return slot;
 }
 
-t_objLabel *objGetLabel(t_object *obj, const char *name)
+static void objGrowLabelTable(t_object *obj)
 {
-  t_objLabel *lbl = objFindLabel(obj, name);
-  if (lbl)
-    return lbl;
-
-  lbl = malloc(sizeof(t_objLabel));
-  if (!lbl)
-    fatalError("out of memory");
-  lbl->name = strdup(name);
-  if (!lbl->name)
+  t_objLabel **table = calloc(obj->labelTableSize * 2, sizeof(t_objLabel *));
+  if (!table)
     fatalError("out of memory");
+  free(obj->labelTable);
+  obj->labelTable = table;
+  obj->labelTableSize *= 2;
+  for (t_objLabel *lbl = obj->labelList; lbl != NULL; lbl = lbl->next)
+    *objLabelTableSlot(obj, lbl->name, lbl->hash) = lbl;
+}
+
+
+t_objLabel *objFindLabel(t_object *obj, const char *name)
+{
+  return *objLabelTableSlot(obj, name, objHashLabelName(name));
+}
+
+t_objLabel *objGetLabel(t_object *obj, const char *name)
+{
+  uint32_t hash = objHashLabelName(name);
+  t_objLabel **slot = objLabelTableSlot(obj, name, hash);
+  if (*slot)
+    return *slot;
+
+  t_objLabel *lbl = objArenaAlloc(&obj->arena, sizeof(t_objLabel));
+  size_t nameSize = strlen(name) + 1;
+  lbl->name = objArenaAlloc(&obj->arena, nameSize);
+  memcpy(lbl->name, name, nameSize);
+  lbl->hash = hash;
+  lbl->global = false;
   lbl->next = obj->labelList;
   lbl->pointer = NULL;
   obj->labelList = lbl;
+  *slot = lbl;
+  if (++obj->numLabels > obj->labelTableSize / 2)
+    objGrowLabelTable(obj);
   return lbl;
 }
 
@@ -127,6 +324,8 @@ t_objSection *objGetSection(t_object *obj, t_objSectionID id)
     return obj->text;
   if (id == OBJ_SECTION_DATA)
     return obj->data;
+  if (id == OBJ_SECTION_BSS)
+    return obj->bss;
   return NULL;
 }
 
@@ -164,9 +363,7 @@ void objSecAppendData(t_objSection *sec, t_data data)
 {
   t_objSecItem *itm;
 
-  itm = malloc(sizeof(t_objSecItem));
-  if (!itm)
-    fatalError("out of memory");
+  itm = objArenaAlloc(sec->arena, sizeof(t_objSecItem));
   itm->address = 0;
   itm->class = OBJ_SEC_ITM_CLASS_DATA;
   itm->body.data = data;
@@ -177,9 +374,7 @@ void objSecAppendAlignmentData(t_objSection *sec, t_alignData align)
 {
   t_objSecItem *itm;
 
-  itm = malloc(sizeof(t_objSecItem));
-  if (!itm)
-    fatalError("out of memory");
+  itm = objArenaAlloc(sec->arena, sizeof(t_objSecItem));
   itm->address = 0;
   itm->class = OBJ_SEC_ITM_CLASS_ALIGN_DATA;
   itm->body.alignData = align;
@@ -191,9 +386,7 @@ t_objSecItem *objSecInsertInstructionAfter(
 {
   t_objSecItem *itm;
 
-  itm = malloc(sizeof(t_objSecItem));
-  if (!itm)
-    fatalError("out of memory");
+  itm = objArenaAlloc(sec->arena, sizeof(t_objSecItem));
   itm->address = 0;
   itm->class = OBJ_SEC_ITM_CLASS_INSTR;
   itm->body.instr = instr;
@@ -213,11 +406,10 @@ bool objSecDeclareLabel(t_objSection *sec, t_objLabel *label)
   if (label->pointer)
     return false;
 
-  itm = malloc(sizeof(t_objSecItem));
-  if (!itm)
-    fatalError("out of memory");
+  itm = objArenaAlloc(sec->arena, sizeof(t_objSecItem));
   itm->address = 0;
   itm->class = OBJ_SEC_ITM_CLASS_VOID;
+  itm->body.label = label;
   objSecAppend(sec, itm);
 
   label->pointer = itm;
@@ -254,6 +446,16 @@ const char *objLabelGetName(t_objLabel *lbl)
   return lbl->name;
 }
 
+void objLabelSetGlobal(t_objLabel *lbl)
+{
+  lbl->global = true;
+}
+
+bool objLabelIsGlobal(t_objLabel *lbl)
+{
+  return lbl->global;
+}
+
 uint32_t objLabelGetPointer(t_objLabel *lbl)
 {
   if (!lbl->pointer)
@@ -283,7 +485,8 @@ static bool objSecExpandPseudoInstructions(t_objSection *sec)
   return true;
 }
 
-static bool objSecMaterializeAddresses(t_objSection *sec, uint32_t *curAddr)
+static bool objSecMaterializeAddresses(
+    t_objSection *sec, uint32_t *curAddr, bool compressed)
 {
   size_t alignAmt;
   t_objSecItem *itm;
@@ -308,11 +511,13 @@ static bool objSecMaterializeAddresses(t_objSection *sec, uint32_t *curAddr)
           thisSize = alignAmt - (*curAddr % alignAmt);
         itm->body.alignData.effectiveSize = thisSize;
         if (objSecGetID(sec) == OBJ_SECTION_TEXT) {
+          // in RVC mode the fill can start with a 2-byte c.nop
+          uint32_t nopAlign = compressed ? 2 : 4;
           if (itm->body.alignData.nopFill &&
-              (thisSize % 4 != 0 || itm->address % 4 != 0)) {
+              (thisSize % nopAlign != 0 || itm->address % nopAlign != 0)) {
             emitWarning(loc,
                 "implicit nop-fill alignment in .text not aligned to "
-                "a multiple of 4 bytes, using zero-fill instead");
+                "a multiple of %d bytes, using zero-fill instead", nopAlign);
             itm->body.alignData.nopFill = false;
             itm->body.alignData.fillByte = 0;
           }
@@ -320,7 +525,7 @@ static bool objSecMaterializeAddresses(t_objSection *sec, uint32_t *curAddr)
         break;
       case OBJ_SEC_ITM_CLASS_INSTR:
         loc = itm->body.instr.location;
-        thisSize = encGetInstrLength(itm->body.instr);
+        thisSize = encGetInstrLength(itm->body.instr, compressed);
         break;
     }
     // Same as 0x100000000 - *curAddr but safe for 32-bit-sized size_t
@@ -348,7 +553,45 @@ static bool objSecResolveImmediates(t_objSection *sec)
   return true;
 }
 
-static bool objSecMaterializeInstructions(t_objSection *sec)
+static bool objSecRelaxInstructions(t_objSection *sec)
+{
+  t_objSecItem *itm;
+  bool res = false;
+
+  for (itm = sec->items; itm != NULL; itm = itm->next) {
+    if (itm->class != OBJ_SEC_ITM_CLASS_INSTR)
+      continue;
+    res |= encRelaxInstruction(&itm->body.instr, itm->address);
+  }
+  return res;
+}
+
+static void objAddLine(t_object *obj, uint32_t address, t_fileLocation source)
+{
+  // rows are only added where the line changes
+  if (obj->numLines > 0) {
+    t_fileLocation last = obj->lines[obj->numLines - 1].source;
+    if (last.row == source.row &&
+        (last.file == source.file ||
+            (last.file && source.file && strcmp(last.file, source.file) == 0)))
+      return;
+  } else if (!source.file) {
+    return;
+  }
+  if (obj->numLines == obj->linesCapacity) {
+    size_t capacity = obj->linesCapacity ? obj->linesCapacity * 2 : 256;
+    t_objLine *lines = realloc(obj->lines, capacity * sizeof(t_objLine));
+    if (!lines)
+      fatalError("out of memory");
+    obj->lines = lines;
+    obj->linesCapacity = capacity;
+  }
+  obj->lines[obj->numLines].address = address;
+  obj->lines[obj->numLines++].source = source;
+}
+
+static bool objSecMaterializeInstructions(
+    t_object *obj, t_objSection *sec, bool compressed)
 {
   t_objSecItem *itm;
 
@@ -358,7 +601,15 @@ static bool objSecMaterializeInstructions(t_objSection *sec)
     if (itm->class != OBJ_SEC_ITM_CLASS_INSTR)
       continue;
 
-    if (!encPhysicalInstruction(itm->body.instr, itm->address, &tmp))
+    if (sec->id == OBJ_SECTION_TEXT) {
+      t_fileLocation source = itm->body.instr.source;
+      if (!source.file && obj->debugLines)
+        source = itm->body.instr.location;
+      objAddLine(obj, itm->address, source);
+    }
+
+    if (!encPhysicalInstruction(
+            itm->body.instr, itm->address, compressed, &tmp))
       return false;
     itm->class = OBJ_SEC_ITM_CLASS_DATA;
     itm->body.data = tmp;
@@ -374,12 +625,24 @@ bool objMaterialize(t_object *obj)
   if (!objSecExpandPseudoInstructions(obj->data))
     return false;
 
-  // Assign an address to every item in the object
-  uint32_t curAddr = 0x1000;
-  if (!objSecMaterializeAddresses(obj->text, &curAddr))
-    return false;
-  if (!objSecMaterializeAddresses(obj->data, &curAddr))
-    return false;
+  // Assign an address to every item in the object. In RVC mode the branches
+  // to labels start compressed, and the ones found out of range are made
+  // longer until all the remaining ones fit.
+  bool relaxed;
+  do {
+    uint32_t curAddr = 0x1000;
+    if (!objSecMaterializeAddresses(obj->text, &curAddr, obj->compressed))
+      return false;
+    if (!objSecMaterializeAddresses(obj->data, &curAddr, obj->compressed))
+      return false;
+    if (!objSecMaterializeAddresses(obj->bss, &curAddr, obj->compressed))
+      return false;
+    relaxed = false;
+    if (obj->compressed) {
+      relaxed |= objSecRelaxInstructions(obj->text);
+      relaxed |= objSecRelaxInstructions(obj->data);
+    }
+  } while (relaxed);
 
   // Transform label references into constants
   if (!objSecResolveImmediates(obj->text))
@@ -387,16 +650,24 @@ bool objMaterialize(t_object *obj)
   if (!objSecResolveImmediates(obj->data))
     return false;
 
-  // Transform instructions into data
-  if (!objSecMaterializeInstructions(obj->text))
+  // Transform instructions into data, recording the line table of the text
+  obj->numLines = 0;
+  if (!objSecMaterializeInstructions(obj, obj->text, obj->compressed))
     return false;
-  if (!objSecMaterializeInstructions(obj->data))
+  if (!objSecMaterializeInstructions(obj, obj->data, obj->compressed))
     return false;
 
   return true;
 }
 
 
+t_objLine *objGetLines(t_object *obj, size_t *outNumLines)
+{
+  *outNumLines = obj->numLines;
+  return obj->lines;
+}
+
+
 static void objSecDump(t_objSection *sec)
 {
   printf("{\n");
@@ -454,4 +725,7 @@ void objDump(t_object *obj)
 
   printf("Text section: ");
   objSecDump(obj->text);
+
+  printf("BSS section: ");
+  objSecDump(obj->bss);
 }
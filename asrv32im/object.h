@@ -9,7 +9,9 @@
 typedef int t_objSectionID;
 enum {
   OBJ_SECTION_TEXT,
-  OBJ_SECTION_DATA
+  OBJ_SECTION_DATA,
+  /* only uninitialized data, not stored in the output file */
+  OBJ_SECTION_BSS
 };
 
 typedef struct t_object t_object;
@@ -111,7 +113,13 @@ typedef struct t_instruction {
   t_instrImmMode immMode;
   int32_t constant;
   t_objLabel *label;
+  /* in RVC mode, forces the 32-bit encoding of a branch or jump whose label
+   * is out of range of the compressed one */
+  bool uncompressed;
   t_fileLocation location;
+  /* line of the program the instruction was compiled from, as given by the
+   * last .loc directive, or nullFileLocation if there was none */
+  t_fileLocation source;
 } t_instruction;
 
 #define DATA_MAX 16
@@ -146,13 +154,41 @@ typedef struct t_objSecItem {
     t_instruction instr;
     t_data data;
     t_alignData alignData;
+    /* the label declared here, for the items of class VOID */
+    t_objLabel *label;
   } body;
 } t_objSecItem;
 
+/* Row of the line table of the .text section: the instructions from address
+ * up to the next row were compiled from the line of the program in source,
+ * or are not attributed to any line if source.file is NULL */
+typedef struct t_objLine {
+  uint32_t address;
+  t_fileLocation source;
+} t_objLine;
+
 
 t_object *newObject(void);
 void deleteObject(t_object *obj);
 
+/* In RVC mode the instructions are encoded in 16 bits whenever possible */
+void objSetCompressed(t_object *obj, bool compressed);
+bool objIsCompressed(t_object *obj);
+
+/* When set, the instructions without a .loc directive are attributed to
+ * their own line of the assembly file in the line table */
+void objSetDebugLines(t_object *obj, bool debugLines);
+
+/* Copies the first len characters of str into a string owned by the object */
+char *objNewString(t_object *obj, const char *str, size_t len);
+
+/* Merges the objects into a new one, which takes ownership of their
+ * contents. The sections of each object are appended in order to the ones of
+ * the previous objects, aligned to a word. The labels declared .global are
+ * shared by all the objects, the others are local to the object which
+ * defines them. Returns NULL if a global label is defined more than once. */
+t_object *objLink(t_object *objs[], int numObjs);
+
 t_objLabel *objFindLabel(t_object *obj, const char *name);
 t_objLabel *objGetLabel(t_object *obj, const char *name);
 void objDump(t_object *obj);
@@ -170,8 +206,13 @@ uint32_t objSecGetSize(t_objSection *sec);
 
 t_objSecItem *objLabelGetPointedItem(t_objLabel *lbl);
 const char *objLabelGetName(t_objLabel *lbl);
+void objLabelSetGlobal(t_objLabel *lbl);
+bool objLabelIsGlobal(t_objLabel *lbl);
 uint32_t objLabelGetPointer(t_objLabel *lbl);
 
 bool objMaterialize(t_object *obj);
 
+/* The line table built by objMaterialize, sorted by address */
+t_objLine *objGetLines(t_object *obj, size_t *outNumLines);
+
 #endif
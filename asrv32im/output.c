@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -35,6 +36,8 @@ typedef uint32_t Elf32_Word;
 #define EM_NONE      0     // No machine
 #define EM_RISCV     0xF3  // RISC-V
 
+#define EF_RISCV_RVC 0x1   // Uses compressed instructions
+
 typedef struct __attribute__((packed)) Elf32_Ehdr {
   unsigned char e_ident[EI_NIDENT];
   Elf32_Half e_type;
@@ -72,10 +75,13 @@ typedef struct __attribute__((packed)) Elf32_Phdr {
 } Elf32_Phdr;
 
 #define SHN_UNDEF     0         // undefined section ID
+#define SHN_ABS       0xFFF1    // absolute symbols
 
 #define SHT_NULL      0         // null section
 #define SHT_PROGBITS  1         // section loaded with the program
+#define SHT_SYMTAB    2         // symbol table
 #define SHT_STRTAB    3         // string table
+#define SHT_NOBITS    8         // section loaded as zeros, not in the file
 
 #define SHF_WRITE     (1 << 0)  // section writable flag
 #define SHF_ALLOC     (1 << 1)  // section initialized flag
@@ -95,6 +101,33 @@ typedef struct __attribute__((packed)) Elf32_Shdr {
   Elf32_Word sh_entsize;
 } Elf32_Shdr;
 
+#define STB_LOCAL     0         // symbol not visible outside the object
+#define STB_GLOBAL    1         // symbol visible to all objects
+#define STT_NOTYPE    0         // symbol type is unspecified
+#define ELF32_ST_INFO(bind, type) (((bind) << 4) + ((type) & 0xF))
+
+typedef struct __attribute__((packed)) Elf32_Sym {
+  Elf32_Word st_name;
+  Elf32_Addr st_value;
+  Elf32_Word st_size;
+  unsigned char st_info;
+  unsigned char st_other;
+  Elf32_Half st_shndx;
+} Elf32_Sym;
+
+/* Subset of the DWARF 3 line number program used for .debug_line */
+#define DW_LNS_copy          1
+#define DW_LNS_advance_pc    2
+#define DW_LNS_advance_line  3
+#define DW_LNS_set_file      4
+#define DW_LNE_end_sequence  1
+#define DW_LNE_set_address   2
+
+#define DW_LINE_VERSION      3
+#define DW_LINE_BASE         (-5)
+#define DW_LINE_RANGE        14
+#define DW_LINE_OPCODE_BASE  13
+
 
 static uint32_t toLE32(uint32_t v)
 {
@@ -147,7 +180,7 @@ void outStrTblAddString(t_outStrTbl *tbl, char *str, Elf32_Word *outIdx)
   size_t strSz = strlen(str) + 1;
   if (tbl->bufSz - tbl->tail < strSz) {
     size_t newBufSz = tbl->bufSz * 2 + strSz;
-    char *newBuf = realloc(tbl->buf, tbl->bufSz);
+    char *newBuf = realloc(tbl->buf, newBufSz);
     if (!newBuf)
       fatalError("out of memory");
     tbl->buf = newBuf;
@@ -159,6 +192,64 @@ void outStrTblAddString(t_outStrTbl *tbl, char *str, Elf32_Word *outIdx)
   tbl->tail += strSz;
 }
 
+typedef struct t_outBuf {
+  uint8_t *buf;
+  size_t size;
+  size_t capacity;
+} t_outBuf;
+
+static void outBufAppend(t_outBuf *out, const void *data, size_t size)
+{
+  if (out->capacity - out->size < size) {
+    size_t capacity = out->capacity * 2 + size;
+    uint8_t *buf = realloc(out->buf, capacity);
+    if (!buf)
+      fatalError("out of memory");
+    out->buf = buf;
+    out->capacity = capacity;
+  }
+  memcpy(out->buf + out->size, data, size);
+  out->size += size;
+}
+
+static void outBufAppendByte(t_outBuf *out, uint8_t byte)
+{
+  outBufAppend(out, &byte, 1);
+}
+
+static void outBufAppend32(t_outBuf *out, uint32_t v)
+{
+  uint32_t tmp = toLE32(v);
+  outBufAppend(out, &tmp, sizeof(uint32_t));
+}
+
+static void outBufAppendULEB(t_outBuf *out, uint32_t v)
+{
+  do {
+    uint8_t byte = v & 0x7F;
+    v >>= 7;
+    outBufAppendByte(out, byte | (v != 0 ? 0x80 : 0));
+  } while (v != 0);
+}
+
+static void outBufAppendSLEB(t_outBuf *out, int32_t v)
+{
+  bool more;
+  do {
+    uint8_t byte = v & 0x7F;
+    v >>= 7;
+    more = !((v == 0 && (byte & 0x40) == 0) || (v == -1 && (byte & 0x40)));
+    outBufAppendByte(out, byte | (more ? 0x80 : 0));
+  } while (more);
+}
+
+static void outBufPut32(t_outBuf *out, size_t offset, uint32_t v)
+{
+  uint32_t tmp = toLE32(v);
+  memcpy(out->buf + offset, &tmp, sizeof(uint32_t));
+}
+
+
 Elf32_Shdr outputStrTabToELFSHdr(
     t_outStrTbl *tbl, Elf32_Addr fileOffset, Elf32_Word name)
 {
@@ -178,13 +269,9 @@ Elf32_Shdr outputStrTabToELFSHdr(
   return shdr;
 }
 
-t_outError outputStrTabContentToFile(FILE *fp, long whence, t_outStrTbl *tbl)
+void outputStrTabContentToBuffer(uint8_t *out, t_outStrTbl *tbl)
 {
-  if (fseek(fp, whence, SEEK_SET) < 0)
-    return OUT_FILE_ERROR;
-  if (fwrite(tbl->buf, tbl->tail, 1, fp) < 1)
-    return OUT_FILE_ERROR;
-  return OUT_NO_ERROR;
+  memcpy(out, tbl->buf, tbl->tail);
 }
 
 
@@ -224,64 +311,248 @@ Elf32_Shdr outputSecToELFSHdr(
   return shdr;
 }
 
-t_outError outputSecContentToFile(FILE *fp, long whence, t_objSection *sec)
+void outputSecContentToBuffer(uint8_t *out, t_objSection *sec)
 {
-  if (fseek(fp, whence, SEEK_SET) < 0)
-    return OUT_FILE_ERROR;
-
   t_objSecItem *itm = objSecGetItemList(sec);
   for (; itm != NULL; itm = itm->next) {
     if (itm->class == OBJ_SEC_ITM_CLASS_VOID) {
       continue;
     } else if (itm->class == OBJ_SEC_ITM_CLASS_DATA) {
-      if (itm->body.data.initialized) {
-        if (fwrite(itm->body.data.data, itm->body.data.dataSize, 1, fp) < 1)
-          return OUT_FILE_ERROR;
-      } else {
-        uint8_t tmp = 0;
-        for (int i = 0; i < itm->body.data.dataSize; i++)
-          if (fwrite(&tmp, sizeof(uint8_t), 1, fp) < 1)
-            return OUT_FILE_ERROR;
-      }
+      size_t size = itm->body.data.dataSize;
+      if (itm->body.data.initialized)
+        memcpy(out, itm->body.data.data, size);
+      else
+        memset(out, 0, size);
+      out += size;
     } else if (itm->class == OBJ_SEC_ITM_CLASS_ALIGN_DATA) {
+      size_t size = itm->body.alignData.effectiveSize;
       if (itm->body.alignData.nopFill) {
         uint32_t tmp = toLE32(0x00000013); // nop = addi x0, x0, 0
-        assert((itm->body.alignData.effectiveSize % 4) == 0);
-        for (int i = 0; i < itm->body.alignData.effectiveSize; i += 4)
-          if (fwrite(&tmp, sizeof(uint32_t), 1, fp) < 1)
-            return OUT_FILE_ERROR;
+        size_t i = 0;
+        if (size % 4 != 0) {
+          uint16_t cnop = toLE16(0x0001); // c.nop, only in RVC mode
+          assert((size % 4) == 2);
+          memcpy(out, &cnop, sizeof(uint16_t));
+          i = 2;
+        }
+        for (; i < size; i += 4)
+          memcpy(out + i, &tmp, sizeof(uint32_t));
       } else {
-        uint8_t tmp = itm->body.alignData.fillByte;
-        for (int i = 0; i < itm->body.alignData.effectiveSize; i++)
-          if (fwrite(&tmp, sizeof(uint8_t), 1, fp) < 1)
-            return OUT_FILE_ERROR;
+        memset(out, itm->body.alignData.fillByte, size);
       }
+      out += size;
     } else {
       assert(0 && "bug, unexpected item type in section");
     }
   }
-  return OUT_NO_ERROR;
 }
 
 
 enum {
   PRG_ID_TEXT = 0,
   PRG_ID_DATA,
+  PRG_ID_BSS,
   PRG_NUM
 };
 
+/* Labels whose name starts with a dot, like the ones of the numeric local
+ * labels, are not written to the symbol table. Local symbols must come before
+ * the global ones, whose index is returned. */
+static Elf32_Word outputSymbols(t_object *obj, t_outStrTbl *strTbl,
+    t_outBuf *symtab, const Elf32_Half secIndex[])
+{
+  static const t_objSectionID sections[] = {
+      OBJ_SECTION_TEXT, OBJ_SECTION_DATA, OBJ_SECTION_BSS};
+  Elf32_Sym sym = {0};
+  outBufAppend(symtab, &sym, sizeof(Elf32_Sym));
+  Elf32_Word firstGlobal = 0;
+
+  for (int global = 0; global <= 1; global++) {
+    if (global)
+      firstGlobal = (Elf32_Word)(symtab->size / sizeof(Elf32_Sym));
+    for (int i = 0; i < 3; i++) {
+      t_objSection *sec = objGetSection(obj, sections[i]);
+      t_objSecItem *itm = objSecGetItemList(sec);
+      for (; itm != NULL; itm = itm->next) {
+        if (itm->class != OBJ_SEC_ITM_CLASS_VOID || !itm->body.label)
+          continue;
+        t_objLabel *lbl = itm->body.label;
+        const char *name = objLabelGetName(lbl);
+        if (name[0] == '.' || objLabelIsGlobal(lbl) != global)
+          continue;
+        Elf32_Word nameIdx;
+        outStrTblAddString(strTbl, (char *)name, &nameIdx);
+        sym.st_name = toLE32(nameIdx);
+        sym.st_value = toLE32(itm->address);
+        sym.st_size = toLE32(0);
+        sym.st_info =
+            ELF32_ST_INFO(global ? STB_GLOBAL : STB_LOCAL, STT_NOTYPE);
+        sym.st_other = 0;
+        sym.st_shndx = toLE16(secIndex[i]);
+        outBufAppend(symtab, &sym, sizeof(Elf32_Sym));
+      }
+    }
+  }
+  return firstGlobal;
+}
+
+
+/* Returns the DWARF number of the file, adding it to the list if needed */
+static uint32_t outputLineFile(const char ***files, uint32_t *numFiles,
+    const char *file)
+{
+  for (uint32_t i = 0; i < *numFiles; i++) {
+    if (strcmp((*files)[i], file) == 0)
+      return i + 1;
+  }
+  const char **newFiles =
+      realloc(*files, sizeof(const char *) * (*numFiles + 1));
+  if (!newFiles)
+    fatalError("out of memory");
+  *files = newFiles;
+  newFiles[(*numFiles)++] = file;
+  return *numFiles;
+}
+
+/* Writes the line table of the object as a DWARF line number program with a
+ * sequence for every run of instructions attributed to some line. Returns
+ * false if there is no line table. */
+static bool outputLineTable(t_object *obj, t_outBuf *out)
+{
+  size_t numLines;
+  t_objLine *lines = objGetLines(obj, &numLines);
+  if (numLines == 0)
+    return false;
+  t_objSection *text = objGetSection(obj, OBJ_SECTION_TEXT);
+  uint32_t textEnd = objSecGetStart(text) + objSecGetSize(text);
+
+  const char **files = NULL;
+  uint32_t numFiles = 0;
+  t_outBuf program = {0};
+  bool inSequence = false;
+  uint32_t address = 0, file = 1;
+  int32_t line = 1;
+  for (size_t i = 0; i <= numLines; i++) {
+    uint32_t nextAddress = i < numLines ? lines[i].address : textEnd;
+    const char *nextFile = i < numLines ? lines[i].source.file : NULL;
+    if (!nextFile) {
+      if (inSequence) {
+        outBufAppendByte(&program, DW_LNS_advance_pc);
+        outBufAppendULEB(&program, nextAddress - address);
+        outBufAppendByte(&program, 0);
+        outBufAppendULEB(&program, 1);
+        outBufAppendByte(&program, DW_LNE_end_sequence);
+        inSequence = false;
+      }
+      continue;
+    }
+
+    if (!inSequence) {
+      outBufAppendByte(&program, 0);
+      outBufAppendULEB(&program, 5);
+      outBufAppendByte(&program, DW_LNE_set_address);
+      outBufAppend32(&program, nextAddress);
+      address = nextAddress;
+      file = 1;
+      line = 1;
+      inSequence = true;
+    }
+    uint32_t nextFileNum = outputLineFile(&files, &numFiles, nextFile);
+    if (nextFileNum != file) {
+      outBufAppendByte(&program, DW_LNS_set_file);
+      outBufAppendULEB(&program, nextFileNum);
+      file = nextFileNum;
+    }
+    int32_t lineDelta = lines[i].source.row + 1 - line;
+    uint32_t addrDelta = nextAddress - address;
+    uint32_t special = (uint32_t)(lineDelta - DW_LINE_BASE) +
+        DW_LINE_RANGE * addrDelta + DW_LINE_OPCODE_BASE;
+    if (lineDelta >= DW_LINE_BASE &&
+        lineDelta < DW_LINE_BASE + DW_LINE_RANGE &&
+        addrDelta < 256 && special <= 255) {
+      outBufAppendByte(&program, (uint8_t)special);
+    } else {
+      if (addrDelta != 0) {
+        outBufAppendByte(&program, DW_LNS_advance_pc);
+        outBufAppendULEB(&program, addrDelta);
+      }
+      if (lineDelta != 0) {
+        outBufAppendByte(&program, DW_LNS_advance_line);
+        outBufAppendSLEB(&program, lineDelta);
+      }
+      outBufAppendByte(&program, DW_LNS_copy);
+    }
+    address = nextAddress;
+    line += lineDelta;
+  }
+
+  static const uint8_t opcodeLengths[DW_LINE_OPCODE_BASE - 1] = {
+      0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1};
+  outBufAppend32(out, 0); // unit length
+  outBufAppendByte(out, DW_LINE_VERSION & 0xFF);
+  outBufAppendByte(out, DW_LINE_VERSION >> 8);
+  outBufAppend32(out, 0); // header length
+  size_t headerStart = out->size;
+  outBufAppendByte(out, 1); // minimum instruction length
+  outBufAppendByte(out, 1); // default is_stmt
+  outBufAppendByte(out, (uint8_t)DW_LINE_BASE);
+  outBufAppendByte(out, DW_LINE_RANGE);
+  outBufAppendByte(out, DW_LINE_OPCODE_BASE);
+  outBufAppend(out, opcodeLengths, sizeof(opcodeLengths));
+  outBufAppendByte(out, 0); // no include directories
+  for (uint32_t i = 0; i < numFiles; i++) {
+    outBufAppend(out, files[i], strlen(files[i]) + 1);
+    outBufAppendULEB(out, 0); // directory
+    outBufAppendULEB(out, 0); // modification time
+    outBufAppendULEB(out, 0); // size
+  }
+  outBufAppendByte(out, 0);
+  outBufPut32(out, 6, (uint32_t)(out->size - headerStart));
+  outBufAppend(out, program.buf, program.size);
+  outBufPut32(out, 0, (uint32_t)(out->size - 4));
+
+  free(program.buf);
+  free(files);
+  return true;
+}
+
+
+Elf32_Shdr outputBufToELFSHdr(Elf32_Word name, Elf32_Word type,
+    Elf32_Addr fileOffset, size_t size, Elf32_Word link, Elf32_Word info,
+    Elf32_Word align, Elf32_Word entsize)
+{
+  Elf32_Shdr shdr = {0};
+
+  shdr.sh_name = toLE32(name);
+  shdr.sh_type = toLE32(type);
+  shdr.sh_flags = toLE32(0);
+  shdr.sh_addr = toLE32(0);
+  shdr.sh_offset = toLE32(fileOffset);
+  shdr.sh_size = toLE32((Elf32_Word)size);
+  shdr.sh_link = toLE32(link);
+  shdr.sh_info = toLE32(info);
+  shdr.sh_addralign = toLE32(align);
+  shdr.sh_entsize = toLE32(entsize);
+
+  return shdr;
+}
+
+
 enum {
   SEC_ID_NULL = SHN_UNDEF,
   SEC_ID_TEXT,
   SEC_ID_DATA,
-  SEC_ID_SYMTAB,
-  SEC_NUM
+  SEC_ID_STRTAB,
+  SEC_MAX = 7
 };
 
+/* The sections after .strtab are numbered as they are added: .bss only when
+ * it is not empty, then .symtab, then .debug_line only when there is a line
+ * table. The .bss segment is last, and only written with its section. */
 typedef struct __attribute__((packed)) t_outputELFHead {
   Elf32_Ehdr e;
   Elf32_Phdr p[PRG_NUM];
-  Elf32_Shdr s[SEC_NUM];
+  Elf32_Shdr s[SEC_MAX];
 } t_outputELFHead;
 
 t_outError outputToELF(t_object *obj, const char *fname)
@@ -290,6 +561,18 @@ t_outError outputToELF(t_object *obj, const char *fname)
 
   t_objSection *text = objGetSection(obj, OBJ_SECTION_TEXT);
   t_objSection *data = objGetSection(obj, OBJ_SECTION_DATA);
+  t_objSection *bss = objGetSection(obj, OBJ_SECTION_BSS);
+  bool hasBss = objSecGetSize(bss) > 0;
+  t_outBuf lineTbl = {0};
+  bool hasLines = outputLineTable(obj, &lineTbl);
+  int numPrg = hasBss ? PRG_NUM : PRG_ID_BSS;
+  int numSec = SEC_ID_STRTAB + 1;
+  int bssSec = hasBss ? numSec++ : SHN_ABS;
+  int symtabSec = numSec++;
+  int lineSec = hasLines ? numSec++ : SHN_UNDEF;
+  size_t phoff = sizeof(Elf32_Ehdr);
+  size_t shoff = phoff + sizeof(Elf32_Phdr) * (size_t)numPrg;
+  size_t headSize = shoff + sizeof(Elf32_Shdr) * (size_t)numSec;
 
   t_outputELFHead head = {0};
   head.e.e_ident[EI_MAG0] = 0x7F;
@@ -302,15 +585,15 @@ t_outError outputToELF(t_object *obj, const char *fname)
   head.e.e_type = toLE16(ET_EXEC);
   head.e.e_machine = toLE16(EM_RISCV);
   head.e.e_version = toLE32(1);
-  head.e.e_phoff = toLE32((Elf32_Off)((intptr_t)head.p - (intptr_t)&head.e));
-  head.e.e_shoff = toLE32((Elf32_Off)((intptr_t)head.s - (intptr_t)&head.e));
-  head.e.e_flags = toLE32(0);
+  head.e.e_phoff = toLE32((Elf32_Off)phoff);
+  head.e.e_shoff = toLE32((Elf32_Off)shoff);
+  head.e.e_flags = toLE32(objIsCompressed(obj) ? EF_RISCV_RVC : 0);
   head.e.e_ehsize = toLE16(sizeof(Elf32_Ehdr));
   head.e.e_phentsize = toLE16(sizeof(Elf32_Phdr));
-  head.e.e_phnum = toLE16(PRG_NUM);
+  head.e.e_phnum = toLE16((Elf32_Half)numPrg);
   head.e.e_shentsize = toLE16(sizeof(Elf32_Shdr));
-  head.e.e_shnum = toLE16(SEC_NUM);
-  head.e.e_shstrndx = toLE16(SEC_ID_SYMTAB);
+  head.e.e_shnum = toLE16((Elf32_Half)numSec);
+  head.e.e_shstrndx = toLE16(SEC_ID_STRTAB);
 
   t_objLabel *l_entry = objFindLabel(obj, "_start");
   if (!l_entry) {
@@ -321,16 +604,30 @@ t_outError outputToELF(t_object *obj, const char *fname)
     head.e.e_entry = toLE32(objLabelGetPointer(l_entry));
   }
 
-  Elf32_Addr textAddr = sizeof(t_outputELFHead);
-  Elf32_Addr dataAddr = textAddr + objSecGetSize(text);
-  Elf32_Addr strtabAddr = dataAddr + objSecGetSize(data);
-
   t_outStrTbl strTbl;
   initOutStrTbl(&strTbl);
-  Elf32_Word textSecName, dataSecName, strtabSecName;
+  Elf32_Word textSecName, dataSecName, strtabSecName, symtabSecName;
   outStrTblAddString(&strTbl, ".text", &textSecName);
   outStrTblAddString(&strTbl, ".data", &dataSecName);
   outStrTblAddString(&strTbl, ".strtab", &strtabSecName);
+  outStrTblAddString(&strTbl, ".symtab", &symtabSecName);
+  Elf32_Word bssSecName = 0, lineSecName = 0;
+  if (hasBss)
+    outStrTblAddString(&strTbl, ".bss", &bssSecName);
+  if (hasLines)
+    outStrTblAddString(&strTbl, ".debug_line", &lineSecName);
+
+  // The symbol names are in the same string table as the section names
+  t_outBuf symTbl = {0};
+  const Elf32_Half symSecIndex[] = {
+      SEC_ID_TEXT, SEC_ID_DATA, (Elf32_Half)bssSec};
+  Elf32_Word firstGlobal = outputSymbols(obj, &strTbl, &symTbl, symSecIndex);
+
+  Elf32_Addr textAddr = (Elf32_Addr)headSize;
+  Elf32_Addr dataAddr = textAddr + objSecGetSize(text);
+  Elf32_Addr strtabAddr = dataAddr + objSecGetSize(data);
+  Elf32_Addr symtabAddr = (strtabAddr + (Elf32_Addr)strTbl.tail + 3) & ~3U;
+  Elf32_Addr lineAddr = symtabAddr + (Elf32_Addr)symTbl.size;
 
   head.p[PRG_ID_TEXT] = outputSecToELFPHdr(text, textAddr, PF_R + PF_X);
   head.p[PRG_ID_DATA] = outputSecToELFPHdr(data, dataAddr, PF_R + PF_W);
@@ -339,31 +636,53 @@ t_outError outputToELF(t_object *obj, const char *fname)
       text, textAddr, textSecName, SHF_ALLOC + SHF_EXECINSTR);
   head.s[SEC_ID_DATA] =
       outputSecToELFSHdr(data, dataAddr, dataSecName, SHF_ALLOC + SHF_WRITE);
-  head.s[SEC_ID_SYMTAB] =
+  head.s[SEC_ID_STRTAB] =
       outputStrTabToELFSHdr(&strTbl, strtabAddr, strtabSecName);
+  if (hasBss) {
+    head.p[PRG_ID_BSS] = outputSecToELFPHdr(bss, strtabAddr, PF_R + PF_W);
+    head.p[PRG_ID_BSS].p_filesz = toLE32(0);
+    head.s[bssSec] = outputSecToELFSHdr(
+        bss, strtabAddr, bssSecName, SHF_ALLOC + SHF_WRITE);
+    head.s[bssSec].sh_type = toLE32(SHT_NOBITS);
+  }
+  head.s[symtabSec] = outputBufToELFSHdr(symtabSecName, SHT_SYMTAB,
+      symtabAddr, symTbl.size, SEC_ID_STRTAB, firstGlobal, 4,
+      sizeof(Elf32_Sym));
+  if (hasLines)
+    head.s[lineSec] = outputBufToELFSHdr(lineSecName, SHT_PROGBITS, lineAddr,
+        lineTbl.size, SHN_UNDEF, 0, 1, 0);
+
+  // Build the whole image in memory and write it at once
+  size_t imageSize = (size_t)lineAddr + lineTbl.size;
+  uint8_t *image = calloc(imageSize, 1);
+  if (!image) {
+    res = OUT_MEMORY_ERROR;
+    goto exit;
+  }
+  memcpy(image, &head.e, sizeof(Elf32_Ehdr));
+  memcpy(image + phoff, head.p, sizeof(Elf32_Phdr) * (size_t)numPrg);
+  memcpy(image + shoff, head.s, sizeof(Elf32_Shdr) * (size_t)numSec);
+  outputSecContentToBuffer(image + textAddr, text);
+  outputSecContentToBuffer(image + dataAddr, data);
+  outputStrTabContentToBuffer(image + strtabAddr, &strTbl);
+  memcpy(image + symtabAddr, symTbl.buf, symTbl.size);
+  if (hasLines)
+    memcpy(image + lineAddr, lineTbl.buf, lineTbl.size);
 
   FILE *fp = fopen(fname, "wb");
   if (fp == NULL) {
     res = OUT_FILE_ERROR;
     goto exit;
   }
-  if (fwrite(&head, sizeof(t_outputELFHead), 1, fp) < 1) {
+  if (fwrite(image, imageSize, 1, fp) < 1)
+    res = OUT_FILE_ERROR;
+  if (fclose(fp) != 0)
     res = OUT_FILE_ERROR;
-    goto exit;
-  }
-  res = outputSecContentToFile(fp, textAddr, text);
-  if (res != OUT_NO_ERROR)
-    goto exit;
-  res = outputSecContentToFile(fp, dataAddr, data);
-  if (res != OUT_NO_ERROR)
-    goto exit;
-  res = outputStrTabContentToFile(fp, strtabAddr, &strTbl);
-  if (res != OUT_NO_ERROR)
-    goto exit;
 
 exit:
+  free(image);
+  free(symTbl.buf);
+  free(lineTbl.buf);
   deinitOutStrTbl(&strTbl);
-  if (fp)
-    fclose(fp);
   return res;
 }
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "parser.h"
 #include "errors.h"
 
@@ -14,10 +15,15 @@ enum {
   P_SYN_ERROR = -1
 };
 
+#define LOCAL_LABEL_TABLE_MIN_SIZE 16
+#define LOCAL_LABEL_EMPTY (-1)
+
 typedef struct t_localLabel {
-  struct t_localLabel *next;
   int identifier;
-  t_objLabel *label;
+  /* last declaration, target of backward references */
+  t_objLabel *back;
+  /* next declaration, target of forward references */
+  t_objLabel *forward;
 } t_localLabel;
 
 typedef struct t_parserState {
@@ -27,68 +33,85 @@ typedef struct t_parserState {
   t_object *object;
   t_objSection *curSection;
   int numErrors;
-  t_localLabel *backLabels;
-  t_localLabel *forwardLabels;
+  /* open addressing hash table of the local labels by identifier, with
+   * linear probing; it is never more than half full */
+  t_localLabel *localLabels;
+  size_t localLabelsSize;
+  size_t numLocalLabels;
+  /* names of the files declared by .file, by number */
+  char **sourceFiles;
+  int numSourceFiles;
+  /* line set by the last .loc directive */
+  t_fileLocation curSource;
 } t_parserState;
 
 
-static t_localLabel *parserGetLocalLabel(
-    t_parserState *state, int identifier, bool back)
+static t_localLabel *newLocalLabelTable(size_t size)
 {
-  t_localLabel *cur;
-  if (back)
-    cur = state->backLabels;
-  else
-    cur = state->forwardLabels;
-  while (cur) {
-    if (cur->identifier == identifier)
-      break;
-    cur = cur->next;
-  }
-  if (cur)
-    return cur;
-  if (back)
-    return NULL;
-
-  cur = calloc(1, sizeof(t_localLabel));
-  if (!cur)
+  t_localLabel *table = malloc(sizeof(t_localLabel) * size);
+  if (!table)
     fatalError("out of memory");
-  cur->identifier = identifier;
-  char realLblName[50];
-  static int progressive = 0;
-  snprintf(realLblName, 50, ".local_%d_%d", identifier, progressive++);
-  cur->label = objGetLabel(state->object, realLblName);
-  cur->next = state->forwardLabels;
-  state->forwardLabels = cur;
-  return cur;
+  for (size_t i = 0; i < size; i++)
+    table[i].identifier = LOCAL_LABEL_EMPTY;
+  return table;
 }
 
-static void parserDeclareLocalLabel(t_parserState *state, t_localLabel *label)
+static t_localLabel *parserLocalLabelSlot(t_parserState *state, int identifier)
 {
-  t_localLabel *prev = NULL, *cur = state->forwardLabels;
-  while (cur && cur != label) {
-    prev = cur;
-    cur = cur->next;
-  }
-  assert(cur != NULL && "attempted to declare a label which was never created");
-  if (prev == NULL) {
-    state->forwardLabels = label->next;
-  } else {
-    prev->next = label->next;
-  }
-  label->next = state->backLabels;
-  state->backLabels = label;
-  objSecDeclareLabel(state->curSection, label->label);
+  size_t mask = state->localLabelsSize - 1;
+  size_t i = ((unsigned)identifier * 2654435761U) & mask;
+  while (state->localLabels[i].identifier != LOCAL_LABEL_EMPTY &&
+      state->localLabels[i].identifier != identifier)
+    i = (i + 1) & mask;
+  return &state->localLabels[i];
 }
 
-static void deleteLocalLabelList(t_localLabel *head)
+static t_localLabel *parserGetLocalLabelEntry(
+    t_parserState *state, int identifier)
 {
-  t_localLabel *next;
-  while (head) {
-    next = head->next;
-    free(head);
-    head = next;
+  t_localLabel *ll = parserLocalLabelSlot(state, identifier);
+  if (ll->identifier == identifier)
+    return ll;
+
+  if (++state->numLocalLabels > state->localLabelsSize / 2) {
+    t_localLabel *old = state->localLabels;
+    size_t oldSize = state->localLabelsSize;
+    state->localLabelsSize *= 2;
+    state->localLabels = newLocalLabelTable(state->localLabelsSize);
+    for (size_t i = 0; i < oldSize; i++) {
+      if (old[i].identifier != LOCAL_LABEL_EMPTY)
+        *parserLocalLabelSlot(state, old[i].identifier) = old[i];
+    }
+    free(old);
+    ll = parserLocalLabelSlot(state, identifier);
   }
+  ll->identifier = identifier;
+  ll->back = NULL;
+  ll->forward = NULL;
+  return ll;
+}
+
+static t_objLabel *parserGetLocalLabel(
+    t_parserState *state, int identifier, bool back)
+{
+  t_localLabel *ll = parserGetLocalLabelEntry(state, identifier);
+  if (back || ll->forward)
+    return back ? ll->back : ll->forward;
+
+  char realLblName[50];
+  static int progressive = 0;
+  snprintf(realLblName, 50, ".local_%d_%d", identifier, progressive++);
+  ll->forward = objGetLabel(state->object, realLblName);
+  return ll->forward;
+}
+
+static void parserDeclareLocalLabel(t_parserState *state, int identifier)
+{
+  t_objLabel *label = parserGetLocalLabel(state, identifier, false);
+  t_localLabel *ll = parserGetLocalLabelEntry(state, identifier);
+  ll->back = label;
+  ll->forward = NULL;
+  objSecDeclareLabel(state->curSection, label);
 }
 
 
@@ -167,8 +190,10 @@ static t_parserError acceptLabel(t_parserState *state, t_instruction *instr)
     bool back = n < 0;
     if (back)
       n = -n;
-    t_localLabel *ll = parserGetLocalLabel(state, n, back);
-    instr->label = ll->label;
+    instr->label = parserGetLocalLabel(state, n, back);
+    // the object is discarded because of the error, so the label is unused
+    if (!instr->label)
+      parserEmitError(state, "reference to an undeclared local label");
     return P_ACCEPT;
 
   } else if (parserAccept(state, TOK_ID) == P_ACCEPT) {
@@ -356,6 +381,7 @@ static t_parserError expectInstruction(t_parserState *state)
   t_immSizeClass immSize;
   t_instruction instr = {0};
   instr.location = state->lookaheadToken->location;
+  instr.source = state->curSource;
 
   parserExpect(state, TOK_MNEMONIC, NULL);
   instr.opcode = state->curToken->value.mnemonic;
@@ -729,6 +755,10 @@ static t_parserError expectAlign(t_parserState *state)
     int32_t pad;
     if (expectNumber(state, &pad, -128, 256) != P_ACCEPT)
       return P_SYN_ERROR;
+    if (pad != 0 && objSecGetID(state->curSection) == OBJ_SECTION_BSS) {
+      parserEmitError(state, "alignment in .bss can only be filled with zeros");
+      return P_SYN_ERROR;
+    }
     align.nopFill = false;
     align.fillByte = (uint8_t)pad;
   } else {
@@ -748,8 +778,85 @@ static t_parserError expectAlign(t_parserState *state)
 }
 
 
+/* Parses the directives which declare the line of the program the following
+ * instructions were compiled from:
+ *   .file N "name"   declares the file number N
+ *   .loc N LINE [COLUMN]
+ * The column is ignored, and so is .file without a number. */
+static t_parserError expectDebugLine(t_parserState *state)
+{
+  int32_t n;
+
+  if (parserAccept(state, TOK_FILE) == P_ACCEPT) {
+    if (parserAccept(state, TOK_NUMBER) == P_ACCEPT) {
+      n = state->curToken->value.number;
+      if (n <= 0 || n > 0xFFFF) {
+        emitError(state->curToken->location, "invalid file number");
+        state->numErrors++;
+        return P_SYN_ERROR;
+      }
+    } else {
+      n = 0;
+    }
+    if (parserExpect(state, TOK_STRING, ".file needs a file name") !=
+        P_ACCEPT)
+      return P_SYN_ERROR;
+    if (n > 0) {
+      char *begin = state->curToken->value.string;
+      char *end = performStringEscapes(state->curToken->location, begin);
+      if (n >= state->numSourceFiles) {
+        char **files =
+            realloc(state->sourceFiles, sizeof(char *) * (size_t)(n + 1));
+        if (!files)
+          fatalError("out of memory");
+        for (int i = state->numSourceFiles; i <= n; i++)
+          files[i] = NULL;
+        state->sourceFiles = files;
+        state->numSourceFiles = n + 1;
+      }
+      state->sourceFiles[n] =
+          objNewString(state->object, begin, (size_t)(end - begin));
+    }
+    return parserExpect(state, TOK_NEWLINE, "expected end of the line");
+  }
+
+  if (parserAccept(state, TOK_LOC) == P_ACCEPT) {
+    int32_t line;
+    if (expectNumber(state, &n, 1, 0xFFFF) != P_ACCEPT)
+      return P_SYN_ERROR;
+    if (n >= state->numSourceFiles || !state->sourceFiles[n]) {
+      emitError(state->curToken->location, "file %d not declared by .file", n);
+      state->numErrors++;
+      return P_SYN_ERROR;
+    }
+    if (expectNumber(state, &line, 0, INT32_MAX) != P_ACCEPT)
+      return P_SYN_ERROR;
+    // line 0 means that the code is not attributed to any line
+    state->curSource = nullFileLocation;
+    if (line > 0) {
+      state->curSource.file = state->sourceFiles[n];
+      state->curSource.row = line - 1;
+      state->curSource.column = 0;
+    }
+    if (state->lookaheadToken->id == TOK_NUMBER)
+      parserNextToken(state);
+    return parserExpect(state, TOK_NEWLINE, "expected end of the line");
+  }
+
+  return P_SYN_ERROR;
+}
+
+
 static t_parserError expectLineContent(t_parserState *state)
 {
+  if (objSecGetID(state->curSection) == OBJ_SECTION_BSS &&
+      state->lookaheadToken->id != TOK_SPACE &&
+      state->lookaheadToken->id != TOK_ALIGN &&
+      state->lookaheadToken->id != TOK_BALIGN) {
+    parserEmitError(state, "only .space and alignment directives are allowed "
+                           "in .bss");
+    return P_SYN_ERROR;
+  }
   if (state->lookaheadToken->id == TOK_MNEMONIC)
     return expectInstruction(state);
   if (state->lookaheadToken->id == TOK_SPACE ||
@@ -777,16 +884,24 @@ static t_parserError expectLine(t_parserState *state)
   } else if (parserAccept(state, TOK_DATA) == P_ACCEPT) {
     state->curSection = objGetSection(state->object, OBJ_SECTION_DATA);
     return parserExpect(state, TOK_NEWLINE, ".data does not take arguments");
+  } else if (parserAccept(state, TOK_BSS) == P_ACCEPT) {
+    state->curSection = objGetSection(state->object, OBJ_SECTION_BSS);
+    return parserExpect(state, TOK_NEWLINE, ".bss does not take arguments");
   }
 
   if (parserAccept(state, TOK_GLOBAL) == P_ACCEPT) {
     if (parserExpect(state, TOK_ID,
             ".global needs exactly one label argument") != P_ACCEPT)
       return P_SYN_ERROR;
+    objLabelSetGlobal(objGetLabel(state->object, state->curToken->value.id));
     return parserExpect(
         state, TOK_NEWLINE, ".global cannot have more than one argument");
   }
 
+  if (state->lookaheadToken->id == TOK_FILE ||
+      state->lookaheadToken->id == TOK_LOC)
+    return expectDebugLine(state);
+
   if (state->lookaheadToken->id == TOK_NUMBER) {
     int n = state->lookaheadToken->value.number;
     if (n < 0) {
@@ -797,10 +912,9 @@ static t_parserError expectLine(t_parserState *state)
     if (parserExpect(state, TOK_COLON,
             "expected colon after number to define a local label") != P_ACCEPT)
       return P_SYN_ERROR;
-    t_localLabel *ll = parserGetLocalLabel(state, n, 0);
-    parserDeclareLocalLabel(state, ll);
+    parserDeclareLocalLabel(state, n);
   } else if (parserAccept(state, TOK_ID) == P_ACCEPT) {
-    char *id = state->curToken->value.id;
+    const char *id = state->curToken->value.id;
     t_objLabel *label = objGetLabel(state->object, id);
     if (parserExpect(state, TOK_COLON,
             "label declaration without trailing comma") != P_ACCEPT)
@@ -826,14 +940,18 @@ t_object *parseObject(t_lexer *lex)
   state.numErrors = 0;
   state.curToken = NULL;
   state.lookaheadToken = lexNextToken(lex);
-  state.backLabels = NULL;
-  state.forwardLabels = NULL;
+  state.localLabelsSize = LOCAL_LABEL_TABLE_MIN_SIZE;
+  state.localLabels = newLocalLabelTable(state.localLabelsSize);
+  state.numLocalLabels = 0;
+  state.sourceFiles = NULL;
+  state.numSourceFiles = 0;
+  state.curSource = nullFileLocation;
 
   while (parserAccept(&state, TOK_EOF) != P_ACCEPT) {
     t_parserError err = expectLine(&state);
     if (err != P_ACCEPT) {
       if (state.numErrors > 10) {
-        fprintf(stderr, "too many errors, aborting...\n");
+        fprintf(getErrorOutput(), "too many errors, aborting...\n");
         break;
       }
       // try to ignore the error and advance to the next line
@@ -846,13 +964,106 @@ t_object *parseObject(t_lexer *lex)
 
   deleteToken(state.curToken);
   deleteToken(state.lookaheadToken);
-  deleteLocalLabelList(state.backLabels);
-  deleteLocalLabelList(state.forwardLabels);
+  free(state.localLabels);
+  free(state.sourceFiles);
 
   if (state.numErrors > 0) {
-    fprintf(stderr, "%d error(s) generated.\n", state.numErrors);
+    fprintf(getErrorOutput(), "%d error(s) generated.\n", state.numErrors);
     deleteObject(state.object);
     return NULL;
   }
   return state.object;
 }
+
+
+/* Files are taken in order by the first idle worker */
+typedef struct {
+  char **paths;
+  t_lexer **lexers;
+  t_object **objs;
+  FILE **diagnostics;
+  int numFiles;
+  int nextFile;
+  pthread_mutex_t lock;
+} t_parseQueue;
+
+static void *parseWorker(void *arg)
+{
+  t_parseQueue *queue = arg;
+
+  for (;;) {
+    pthread_mutex_lock(&queue->lock);
+    int i = queue->nextFile++;
+    pthread_mutex_unlock(&queue->lock);
+    if (i >= queue->numFiles)
+      break;
+
+    setErrorOutput(queue->diagnostics[i]);
+    queue->lexers[i] = newLexer(queue->paths[i]);
+    if (queue->lexers[i] == NULL)
+      emitError(nullFileLocation, "could not read input file \"%s\"",
+          queue->paths[i]);
+    else
+      queue->objs[i] = parseObject(queue->lexers[i]);
+  }
+  setErrorOutput(NULL);
+  return NULL;
+}
+
+bool parseFiles(char *paths[], int numFiles, int numThreads,
+    t_lexer *lexers[], t_object *objs[])
+{
+  t_parseQueue queue;
+  queue.paths = paths;
+  queue.lexers = lexers;
+  queue.objs = objs;
+  queue.numFiles = numFiles;
+  queue.nextFile = 0;
+  if (numThreads > numFiles)
+    numThreads = numFiles;
+  queue.diagnostics = calloc((size_t)numFiles, sizeof(FILE *));
+  pthread_t *threads = calloc((size_t)numThreads, sizeof(pthread_t));
+  if (!queue.diagnostics || !threads)
+    fatalError("out of memory");
+  for (int i = 0; i < numFiles; i++) {
+    lexers[i] = NULL;
+    objs[i] = NULL;
+  }
+  // With more than one thread the diagnostics of each file are collected
+  // separately, and printed when all the files have been parsed
+  if (numThreads > 1) {
+    for (int i = 0; i < numFiles; i++)
+      queue.diagnostics[i] = tmpfile();
+  }
+  pthread_mutex_init(&queue.lock, NULL);
+
+  // The calling thread works too, and it is the only worker if the others
+  // cannot be started
+  int numStarted = 0;
+  while (numStarted < numThreads - 1 &&
+      pthread_create(&threads[numStarted], NULL, parseWorker, &queue) == 0)
+    numStarted++;
+  parseWorker(&queue);
+  for (int i = 0; i < numStarted; i++)
+    pthread_join(threads[i], NULL);
+
+  bool res = true;
+  for (int i = 0; i < numFiles; i++) {
+    FILE *diag = queue.diagnostics[i];
+    if (diag) {
+      char buf[4096];
+      size_t n;
+      rewind(diag);
+      while ((n = fread(buf, 1, sizeof(buf), diag)) > 0)
+        fwrite(buf, 1, n, stderr);
+      fclose(diag);
+    }
+    if (objs[i] == NULL)
+      res = false;
+  }
+
+  pthread_mutex_destroy(&queue.lock);
+  free(threads);
+  free(queue.diagnostics);
+  return res;
+}
@@ -5,5 +5,11 @@
 #include "object.h"
 
 t_object *parseObject(t_lexer *lex);
+/* Lexes and parses each file into an object, on up to numThreads threads.
+ * The lexers must be kept until the objects are no longer used, because the
+ * locations in the objects refer to them. The diagnostics are printed in the
+ * order of the files. Returns false if any file could not be parsed. */
+bool parseFiles(char *paths[], int numFiles, int numThreads,
+    t_lexer *lexers[], t_object *objs[]);
 
 #endif
@@ -0,0 +1,7 @@
+.bss foo
+.bss
+addi t0, zero, 1
+.word 1
+.byte 2
+.ascii "abc"
+.balign 8, 0xFF
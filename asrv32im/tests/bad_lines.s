@@ -0,0 +1,10 @@
+# wrong .file and .loc directives
+        .file 0 "zero.src"
+        .file 1
+        .file 1 "one.src" 2
+        .loc 2 10
+        .loc 0 5
+        .loc 1
+        .loc 1 -4
+        .loc 1 5 6 7
+        addi a0, a0, 1
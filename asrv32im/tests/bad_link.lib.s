@@ -0,0 +1,4 @@
+# second input of bad_link.s
+.global shared
+shared:
+  j _start
@@ -0,0 +1,5 @@
+.global _start
+.global shared
+_start:
+shared:
+  j shared
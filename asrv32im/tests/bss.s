@@ -0,0 +1,16 @@
+_start:
+la t0, buf
+lw t1, 0(t0)
+sw t1, buf2, t2
+
+.data
+.byte 0x10
+
+.bss
+buf:
+.space 100
+.align 4
+buf2:
+.space 0x100000
+.balign 8, 0
+.space 1
@@ -0,0 +1,12 @@
+# line table of the assembly source with --debug
+        .text
+_start:
+        addi a0, zero, 1
+        li a1, 0x12345678
+
+        .file 1 "debug_lines.src"
+        .loc 1 7
+        add a2, a0, a1
+        sub a2, a2, a1
+        .loc 1 0
+        ebreak
@@ -0,0 +1,28 @@
+# line table from .file and .loc directives
+        .file "lines.src"
+        .file 1 "lines.src"
+        .file 2 "include/lib.src"
+        .text
+        .global _start
+_start:
+        .loc 1 3
+        addi a0, zero, 1
+        addi a1, zero, 2
+        .loc 1 4 7
+        add a2, a0, a1
+        .loc 1 200
+        li a3, 0x12345678
+        .loc 1 2
+        jal ra, func
+        .loc 1 0
+        ebreak
+        .loc 2 10
+func:
+        addi a0, a0, 1
+        .loc 2 9
+        la a1, value
+        .loc 1 5
+        jalr zero, ra, 0
+        .data
+value:
+        .word 1
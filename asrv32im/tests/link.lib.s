@@ -0,0 +1,17 @@
+# second input of link.s
+.global increment
+.global message
+increment:
+  la t0, counter
+  lw t1, 0(t0)
+  addi t1, t1, 1
+  sw t1, 0(t0)
+  j local
+local:
+  jalr zero, ra, 0
+
+.data
+local_data:
+  .byte 2
+message:
+  .ascii "ok\0"
@@ -0,0 +1,16 @@
+.global _start
+.global counter
+_start:
+  la t0, counter
+  lw a0, 0(t0)
+  jal increment
+  la t1, message
+  lb a1, 0(t1)
+local:
+  li a7, 93
+  ecall
+
+.data
+counter:
+  .word 41
+.byte 1
@@ -0,0 +1,47 @@
+_start:
+# compressed when the operands fit
+nop
+addi s0, s0, -32
+li a0, 31
+addi sp, sp, -512
+addi a5, sp, 1020
+addi a1, a2, 0
+add a1, zero, a2
+add a1, a1, a2
+add a1, a2, a1
+sub s0, s0, s1
+and a5, a4, a5
+slli t0, t0, 31
+srai a0, a0, 1
+andi a1, a1, -1
+lui a2, 0xFFFFF
+lw s1, 124(a5)
+sw s1, 0(a5)
+lw ra, 252(sp)
+sw ra, 0(sp)
+jalr zero, ra, 0
+jalr ra, t0, 0
+ebreak
+# not compressed
+addi s0, s0, 32
+addi sp, sp, 48
+sub t0, t0, t1
+lui sp, 1
+lw s1, 128(a5)
+lw s1, 2(a5)
+sw t0, 0(a5)
+jalr zero, ra, 4
+ecall
+.align 3
+# branches to labels are compressed only when in range
+near:
+beqz s0, near
+bnez a5, far
+beq s0, s1, near
+j far
+jal near
+jal t0, near
+.balign 2048
+far:
+j near
+beqz s0, near
@@ -0,0 +1,115 @@
+#!/bin/sh
+# Compares the results of the benchmarks with a baseline.
+#
+# usage: compare.sh BASELINE RESULTS
+#
+# Both files are written by run.sh. The output of each program must be the
+# same as in the baseline, and the number of instructions executed and the
+# size of the code must not grow: they do not depend on the machine, so any
+# change is due to the compiler. The times are compared with a tolerance of
+# $TOLERANCE percent (default 25), and differences of less than $MIN_MS
+# milliseconds (default 1) are ignored as noise. The same tolerance applies
+# to the number of instructions simulated per second.
+#
+# Prints a line for every difference and exits with status 1 if there is any
+# regression.
+
+if [ $# -ne 2 ]; then
+  echo "usage: $0 BASELINE RESULTS" >&2
+  exit 2
+fi
+for f in "$1" "$2"; do
+  if [ ! -f "$f" ]; then
+    echo "$0: \"$f\" not found" >&2
+    exit 2
+  fi
+done
+
+awk -v tolerance="${TOLERANCE:-25}" -v minMs="${MIN_MS:-1}" '
+  # Reads the members of a benchmark into val[key, member], where the key is
+  # "name (config)", and returns the key.
+  function parse(line, val,    key, pair, sep, member, value) {
+    key = ""
+    while (match(line, /"[a-z_]+": ("[^"]*"|-?[0-9.]+)/)) {
+      pair = substr(line, RSTART, RLENGTH)
+      line = substr(line, RSTART + RLENGTH)
+      sep = index(pair, ":")
+      member = substr(pair, 2, sep - 3)
+      value = substr(pair, sep + 2)
+      gsub(/"/, "", value)
+      if (member == "name")
+        name = value
+      else if (member == "config")
+        key = name " (" value ")"
+      if (key != "")
+        val[key, member] = value
+      if (!(member in members)) {
+        members[member] = 1
+        memberList[++numMembers] = member
+      }
+    }
+    return key
+  }
+
+  function report(kind, key, member, old, new) {
+    printf "%-11s %-28s %-26s %14s -> %s\n", kind, key, member, old, new
+    if (kind == "REGRESSION" || kind == "FAIL")
+      failed = 1
+  }
+
+  FNR == 1 { inBaseline = (FILENAME == ARGV[1]) }
+  /^ *{"name": / {
+    if (inBaseline) {
+      key = parse($0, base)
+      inBase[key] = 1
+    } else {
+      key = parse($0, cur)
+      keys[++numKeys] = key
+    }
+  }
+
+  END {
+    for (k = 1; k <= numKeys; k++) {
+      key = keys[k]
+      if (!(key in inBase)) {
+        report("NEW", key, "", "-", "-")
+        continue
+      }
+      for (m = 1; m <= numMembers; m++) {
+        member = memberList[m]
+        if (!((key, member) in cur) || !((key, member) in base))
+          continue
+        old = base[key, member]
+        new = cur[key, member]
+        if (member == "output") {
+          if (old != new)
+            report("FAIL", key, member, old, new)
+          continue
+        }
+        # The values are compared as numbers from here on.
+        old += 0
+        new += 0
+        if (member == "instructions" || member == "code_bytes") {
+          if (new > old)
+            report("REGRESSION", key, member, old, new)
+          else if (new < old)
+            report("IMPROVED", key, member, old, new)
+        } else if (member ~ /_ms$/) {
+          if (new - old >= minMs && new > old * (1 + tolerance / 100))
+            report("REGRESSION", key, member, old, new)
+          else if (old - new >= minMs && new < old * (1 - tolerance / 100))
+            report("IMPROVED", key, member, old, new)
+        } else if (member == "instructions_per_second") {
+          if (new < old * (1 - tolerance / 100))
+            report("REGRESSION", key, member, old, new)
+          else if (new > old * (1 + tolerance / 100))
+            report("IMPROVED", key, member, old, new)
+        }
+      }
+    }
+    if (failed) {
+      print "The results have regressions with respect to the baseline"
+      exit 1
+    }
+    print "No regressions with respect to the baseline"
+  }' "$1" "$2"
@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <getopt.h>
+
+
+void usage(const char *name)
+{
+  printf("usage: %s [options] statements\n\n", name);
+  puts("Writes to the standard output a LANCE program with about the given");
+  puts("number of statements, to measure how the compiler and the assembler");
+  puts("scale with the size of their input. The program reads a number, and");
+  puts("always terminates.\n");
+  puts("Options:");
+  puts("  -s, --shape=SHAPE     Kind of program:");
+  puts("                          straight  assignments only");
+  puts("                          nested    deeply nested while and if");
+  puts("                          vars      a variable every two statements");
+  puts("                          arrays    accesses to large arrays");
+  puts("                          mixed     all of them (default)");
+  puts("  -d, --depth=N         Nesting depth of the nested shape");
+  puts("                          (default: 12)");
+  puts("  -v, --vars=N          Number of scalar variables (default: 32, or");
+  puts("                          half the statements for the vars shape)");
+  puts("  -S, --seed=N          Seed of the random choices (default: 1)");
+  puts("  -h, --help            Displays available options");
+}
+
+
+typedef enum {
+  SHAPE_STRAIGHT,
+  SHAPE_NESTED,
+  SHAPE_VARS,
+  SHAPE_ARRAYS,
+  SHAPE_MIXED
+} t_shape;
+
+static const char *shapeNames[] = {
+    "straight", "nested", "vars", "arrays", "mixed"};
+#define NUM_SHAPES (int)(sizeof(shapeNames) / sizeof(shapeNames[0]))
+
+/* Number of elements of each array, which is a power of two so that any
+ * index can be brought in range with a mask */
+#define ARRAY_SIZE_SMALL 256
+#define ARRAY_SIZE_LARGE 65536
+#define NUM_ARRAYS 8
+/* The code of the body of a loop or of an if must be short enough for the
+ * branches around it, so the nesting is limited by the size of a block */
+#define MAX_BLOCK_STATEMENTS 24
+
+typedef struct {
+  t_shape shape;
+  int numVars;
+  int arraySize;
+  int depth;
+  uint32_t rng;
+  /* statements left to generate */
+  long left;
+  /* current indentation, in levels */
+  int indent;
+} t_gen;
+
+
+static uint32_t rnd(t_gen *g, uint32_t n)
+{
+  g->rng ^= g->rng << 13;
+  g->rng ^= g->rng >> 17;
+  g->rng ^= g->rng << 5;
+  return g->rng % n;
+}
+
+static void indent(t_gen *g)
+{
+  for (int i = 0; i < g->indent; i++)
+    fputs("  ", stdout);
+}
+
+/* Prints a declaration of the variables prefix0 to prefix(n-1), each one
+ * followed by suffix, wrapped to 80 columns */
+static void declare(const char *prefix, int n, const char *suffix)
+{
+  int column = 0;
+  for (int i = 0; i < n; i++) {
+    char item[64];
+    int len = snprintf(item, sizeof(item), "%s%d%s", prefix, i, suffix);
+    if (column == 0) {
+      fputs("int ", stdout);
+      column = 4;
+    } else if (column + len + 2 > 80) {
+      fputs(",\n    ", stdout);
+      column = 4;
+    } else {
+      fputs(", ", stdout);
+      column += 2;
+    }
+    fputs(item, stdout);
+    column += len;
+  }
+  if (column > 0)
+    fputs(";\n", stdout);
+}
+
+static void printOperand(t_gen *g)
+{
+  if (rnd(g, 4) == 0)
+    printf("%u", rnd(g, 1000));
+  else
+    printf("v%u", rnd(g, (uint32_t)g->numVars));
+}
+
+static void printExpression(t_gen *g)
+{
+  static const char *ops[] = {"+", "-", "*", "&", "|", "^"};
+  printOperand(g);
+  switch (rnd(g, 8)) {
+    case 0:
+      fputs(" / ((", stdout);
+      printOperand(g);
+      fputs(" & 7) + 1)", stdout);
+      break;
+    case 1:
+      fputs(" << (", stdout);
+      printOperand(g);
+      fputs(" & 3)", stdout);
+      break;
+    default:
+      printf(" %s ", ops[rnd(g, sizeof(ops) / sizeof(ops[0]))]);
+      printOperand(g);
+      break;
+  }
+}
+
+static void genAssign(t_gen *g)
+{
+  indent(g);
+  printf("v%u = ", rnd(g, (uint32_t)g->numVars));
+  printExpression(g);
+  fputs(";\n", stdout);
+  g->left--;
+}
+
+static void genArray(t_gen *g)
+{
+  unsigned a = rnd(g, NUM_ARRAYS), b = rnd(g, NUM_ARRAYS);
+  indent(g);
+  printf("a%u[v%u & %d] = a%u[v%u & %d] + ", a, rnd(g, (uint32_t)g->numVars),
+      g->arraySize - 1, b, rnd(g, (uint32_t)g->numVars), g->arraySize - 1);
+  printOperand(g);
+  fputs(";\n", stdout);
+  g->left--;
+}
+
+static void genSimple(t_gen *g)
+{
+  if (g->shape == SHAPE_ARRAYS || (g->shape == SHAPE_MIXED && rnd(g, 4) == 0))
+    genArray(g);
+  else
+    genAssign(g);
+}
+
+static void genBlock(t_gen *g, int depth, long size);
+
+/* Generates an if or a while statement, whose body holds the given number of
+ * statements and is nested up to depth levels */
+static void genCompound(t_gen *g, int depth, long size)
+{
+  g->left--;
+  if (rnd(g, 2) == 0) {
+    indent(g);
+    printf("if (v%u < ", rnd(g, (uint32_t)g->numVars));
+    printOperand(g);
+    fputs(") {\n", stdout);
+    genBlock(g, depth - 1, size);
+    indent(g);
+    fputs("}", stdout);
+    if (g->left > 0 && rnd(g, 2) == 0) {
+      fputs(" else {\n", stdout);
+      genBlock(g, 0, 1);
+      indent(g);
+      fputs("}", stdout);
+    }
+    fputs("\n", stdout);
+  } else {
+    /* a loop executed once, with a counter for each level of nesting */
+    indent(g);
+    printf("c%d = 0;\n", depth);
+    indent(g);
+    printf("while (c%d < 1) {\n", depth);
+    genBlock(g, depth - 1, size);
+    g->indent++;
+    indent(g);
+    printf("c%d = c%d + 1;\n", depth, depth);
+    g->indent--;
+    indent(g);
+    fputs("}\n", stdout);
+  }
+}
+
+/* Generates the body of a compound statement */
+static void genBlock(t_gen *g, int depth, long size)
+{
+  g->indent++;
+  for (long i = 0; i < size && g->left > 0; i++) {
+    if (depth > 0 && i == size / 2)
+      genCompound(g, depth, size);
+    else
+      genSimple(g);
+  }
+  g->indent--;
+}
+
+static void genProgram(t_gen *g)
+{
+  declare("v", g->numVars, "");
+  /* the compound statements of the mixed shape are nested up to 3 levels */
+  declare("c", (g->depth > 3 ? g->depth : 3) + 1, "");
+  char arraySuffix[32];
+  snprintf(arraySuffix, sizeof(arraySuffix), "[%d]", g->arraySize);
+  declare("a", NUM_ARRAYS, arraySuffix);
+  fputs("\nread(v0);\n", stdout);
+  for (int i = 1; i < g->numVars; i++)
+    printf("v%d = v%d + %d;\n", i, i - 1, i);
+  g->left -= g->numVars;
+
+  while (g->left > 0) {
+    switch (g->shape) {
+      case SHAPE_NESTED:
+        genCompound(g, g->depth, MAX_BLOCK_STATEMENTS / (g->depth + 1) + 1);
+        break;
+      case SHAPE_MIXED:
+        if (rnd(g, 8) == 0)
+          genCompound(g, (int)rnd(g, 3) + 1, (long)rnd(g, 4) + 1);
+        else
+          genSimple(g);
+        break;
+      default:
+        genSimple(g);
+        break;
+    }
+  }
+
+  fputs("\nwrite(", stdout);
+  for (int i = 0; i < g->numVars && i < 32; i++)
+    printf("%sv%d", i == 0 ? "" : i % 10 == 0 ? "\n    ^ " : " ^ ", i);
+  fputs(");\n", stdout);
+}
+
+
+static bool parseNumber(const char *str, long min, long max, long *out)
+{
+  char *end;
+  *out = strtol(str, &end, 0);
+  return end != str && *end == '\0' && *out >= min && *out <= max;
+}
+
+
+int main(int argc, char *argv[])
+{
+  int ch;
+  static const struct option options[] = {
+      {"depth", required_argument, NULL, 'd'},
+      { "help",       no_argument, NULL, 'h'},
+      { "seed", required_argument, NULL, 'S'},
+      {"shape", required_argument, NULL, 's'},
+      { "vars", required_argument, NULL, 'v'},
+      {   NULL,                 0, NULL,   0}
+  };
+
+  char *name = argv[0];
+  t_gen g = {SHAPE_MIXED, 0, ARRAY_SIZE_SMALL, 12, 1, 0, 0};
+  long val;
+
+  while ((ch = getopt_long(argc, argv, "d:hS:s:v:", options, NULL)) != -1) {
+    switch (ch) {
+      case 'd':
+        if (!parseNumber(optarg, 1, MAX_BLOCK_STATEMENTS, &val)) {
+          fprintf(stderr, "Invalid depth\n");
+          return 1;
+        }
+        g.depth = (int)val;
+        break;
+      case 'S':
+        if (!parseNumber(optarg, 0, UINT32_MAX, &val)) {
+          fprintf(stderr, "Invalid seed\n");
+          return 1;
+        }
+        /* the state of xorshift must not be zero */
+        g.rng = (uint32_t)val ? (uint32_t)val : 1;
+        break;
+      case 's':
+        g.shape = NUM_SHAPES;
+        for (int i = 0; i < NUM_SHAPES; i++) {
+          if (strcmp(optarg, shapeNames[i]) == 0)
+            g.shape = (t_shape)i;
+        }
+        if (g.shape == NUM_SHAPES) {
+          fprintf(stderr, "Invalid shape\n");
+          return 1;
+        }
+        break;
+      case 'v':
+        if (!parseNumber(optarg, 1, 10000000, &val)) {
+          fprintf(stderr, "Invalid number of variables\n");
+          return 1;
+        }
+        g.numVars = (int)val;
+        break;
+      case 'h':
+        usage(name);
+        return 0;
+      default:
+        usage(name);
+        return 1;
+    }
+  }
+  argc -= optind;
+  argv += optind;
+  if (argc != 1 || !parseNumber(argv[0], 1, 100000000, &g.left)) {
+    usage(name);
+    return 1;
+  }
+
+  if (g.numVars == 0)
+    g.numVars = g.shape == SHAPE_VARS && g.left > 64 ? (int)(g.left / 2) : 32;
+  if (g.shape == SHAPE_ARRAYS)
+    g.arraySize = ARRAY_SIZE_LARGE;
+  genProgram(&g);
+  return ferror(stdout) ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+
+void usage(const char *name)
+{
+  printf("usage: %s [options] command [argument...]\n\n", name);
+  puts("Runs a command and prints its wall time in milliseconds, the peak");
+  puts("of its resident memory in KiB and its exit status, as in:");
+  puts("  1234.567 20480 0");
+  puts("A command killed by a signal has status 128 + the signal number.\n");
+  puts("Options:");
+  puts("  -o, --output=FILE     Prints the measurements to FILE instead of");
+  puts("                          the standard output");
+  puts("  -t, --timeout=SECS    Kills the command after SECS seconds");
+  puts("  -h, --help            Displays available options");
+}
+
+
+static bool parseNumber(const char *str, unsigned long *out)
+{
+  char *end;
+  *out = strtoul(str, &end, 0);
+  return end != str && *end == '\0';
+}
+
+
+int main(int argc, char *argv[])
+{
+  int ch;
+  static const struct option options[] = {
+      {   "help",       no_argument, NULL, 'h'},
+      { "output", required_argument, NULL, 'o'},
+      {"timeout", required_argument, NULL, 't'},
+      {     NULL,                 0, NULL,   0}
+  };
+
+  char *name = argv[0];
+  const char *outputFile = NULL;
+  unsigned long timeout = 0;
+
+  /* the options after the command are its own */
+  while ((ch = getopt_long(argc, argv, "+ho:t:", options, NULL)) != -1) {
+    switch (ch) {
+      case 'o':
+        outputFile = optarg;
+        break;
+      case 't':
+        if (!parseNumber(optarg, &timeout)) {
+          fprintf(stderr, "Invalid timeout\n");
+          return 1;
+        }
+        break;
+      case 'h':
+        usage(name);
+        return 0;
+      default:
+        usage(name);
+        return 1;
+    }
+  }
+  argc -= optind;
+  argv += optind;
+  if (argc < 1) {
+    usage(name);
+    return 1;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return 1;
+  }
+  if (pid == 0) {
+    /* the alarm survives exec, and its signal terminates the command */
+    if (timeout)
+      alarm((unsigned)timeout);
+    execvp(argv[0], argv);
+    perror(argv[0]);
+    _exit(127);
+  }
+
+  int status;
+  struct rusage ru;
+  if (wait4(pid, &status, 0, &ru) < 0) {
+    perror("wait4");
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double ms = (double)(end.tv_sec - start.tv_sec) * 1e3 +
+      (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+  int code = WIFEXITED(status) ? WEXITSTATUS(status)
+                               : 128 + WTERMSIG(status);
+
+  FILE *fp = stdout;
+  if (outputFile && !(fp = fopen(outputFile, "w"))) {
+    perror(outputFile);
+    return 1;
+  }
+  /* ru_maxrss is in KiB on Linux and in bytes on macOS */
+#ifdef __APPLE__
+  long rss = ru.ru_maxrss / 1024;
+#else
+  long rss = ru.ru_maxrss;
+#endif
+  fprintf(fp, "%.3f %ld %d\n", ms, rss, code);
+  if (fp != stdout)
+    fclose(fp);
+  return 0;
+}
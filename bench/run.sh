@@ -0,0 +1,151 @@
+#!/bin/sh
+# Runs the benchmarks and writes their results in JSON.
+#
+# usage: run.sh BIN_DIR WORK_DIR OUTPUT [PROGRAM.src...]
+#
+# Every program is compiled with each configuration of ACSE, assembled and
+# run in the simulator with no input. The wall times are the minimum of
+# $REPEAT runs (default 3). For each program and configuration it records:
+#   - the wall time of each phase of ACSE, from its -time-report;
+#   - the wall time of the assembler and of the simulator, and the number of
+#     instructions simulated per second;
+#   - the number of instructions executed and the size of the code in bytes;
+#   - a checksum of the output of the program.
+# The configurations are selected by $CONFIGS, among O0, O1 and O1-color.
+
+set -e
+
+if [ $# -lt 3 ]; then
+  echo "usage: $0 BIN_DIR WORK_DIR OUTPUT [PROGRAM.src...]" >&2
+  exit 2
+fi
+BIN_DIR=$1
+WORK_DIR=$2
+OUTPUT=$3
+shift 3
+REPEAT=${REPEAT:-3}
+CONFIGS=${CONFIGS:-"O0 O1 O1-color"}
+PHASES="parse optimize lowering cfg liveness allocation spills peephole output"
+
+ACSE=$BIN_DIR/acse
+ASM=$BIN_DIR/asrv32im
+SIM=$BIN_DIR/simrv32im
+
+case $(date +%N) in
+  *N*|'')
+    echo "$0: date does not support nanoseconds (%N)" >&2
+    exit 1;;
+esac
+
+mkdir -p "$WORK_DIR"
+
+# Prints the current time in nanoseconds.
+now()
+{
+  date +%s%N
+}
+
+# Prints the options of ACSE for a configuration.
+configFlags()
+{
+  case $1 in
+    O0) echo "";;
+    O1) echo "-O1";;
+    O1-color) echo "-O1 -ralloc=color";;
+    *)
+      echo "$0: unknown configuration \"$1\"" >&2
+      exit 1;;
+  esac
+}
+
+# Runs a command $REPEAT times and prints the minimum wall time in
+# milliseconds. The output of the command is discarded.
+minTime()
+{
+  best=
+  i=0
+  while [ $i -lt "$REPEAT" ]; do
+    start=$(now)
+    "$@" </dev/null >/dev/null 2>&1
+    end=$(now)
+    t=$((end - start))
+    if [ -z "$best" ] || [ $t -lt "$best" ]; then
+      best=$t
+    fi
+    i=$((i + 1))
+  done
+  awk -v ns="$best" 'BEGIN { printf "%.3f", ns / 1e6 }'
+}
+
+# Prints the JSON members with the minimum time of each phase of ACSE,
+# reading the time reports of the runs from the standard input.
+phaseTimes()
+{
+  awk -v phases="$PHASES" '
+    $2 ~ /^[0-9.]+$/ && (!($1 in best) || $2 + 0 < best[$1]) { best[$1] = $2 }
+    END {
+      n = split(phases " total", names, " ")
+      for (i = 1; i <= n; i++)
+        printf "\"compile_%s_ms\": %.3f, ", names[i], best[names[i]]
+    }'
+}
+
+if [ $# -eq 0 ]; then
+  set -- "$(dirname "$0")"/*.src
+fi
+
+first=1
+{
+  echo "{"
+  echo "  \"version\": 1,"
+  echo "  \"repeat\": $REPEAT,"
+  echo "  \"benchmarks\": ["
+  for src in "$@"; do
+    name=$(basename "$src" .src)
+    for config in $CONFIGS; do
+      flags=$(configFlags "$config")
+      base=$WORK_DIR/$name.$config
+      echo "  $name ($config)" >&2
+
+      # Compile, keeping the time report of every run.
+      : > "$base.time"
+      i=0
+      while [ $i -lt "$REPEAT" ]; do
+        # shellcheck disable=SC2086
+        "$ACSE" $flags -time-report "$src" -o "$base.s" 2>> "$base.time"
+        i=$((i + 1))
+      done
+      compile=$(phaseTimes < "$base.time")
+
+      assemble=$(minTime "$ASM" "$base.s" -o "$base.o")
+      "$ASM" "$base.s" -o "$base.o"
+
+      # The profile gives the number of instructions and the size of the
+      # code; the timed runs are made without it, since it slows down the
+      # simulator.
+      "$SIM" -p "$base.prof" "$base.o" < /dev/null > "$base.out"
+      output=$(cksum < "$base.out" | awk '{ print $1 }')
+      read -r codeStart codeEnd instrs <<EOF
+$(sed -n '1s/^Profile of \([^-]*\)-\([^:]*\): \([0-9]*\).*/\1 \2 \3/p' \
+    "$base.prof")
+EOF
+      codeBytes=$((codeEnd - codeStart))
+      simulate=$(minTime "$SIM" "$base.o")
+      ips=$(awk -v n="$instrs" -v ms="$simulate" \
+            'BEGIN { printf "%.0f", (ms > 0 ? n / (ms / 1000) : 0) }')
+
+      [ $first -eq 1 ] || echo ","
+      first=0
+      printf '    {"name": "%s", "config": "%s", "flags": "%s", ' \
+          "$name" "$config" "$flags"
+      printf '"output": "%s", %s' "$output" "$compile"
+      printf '"assemble_ms": %s, "simulate_ms": %s, ' "$assemble" "$simulate"
+      printf '"instructions_per_second": %s, "instructions": %s, ' \
+          "$ips" "$instrs"
+      printf '"code_bytes": %s}' "$codeBytes"
+    done
+  done
+  echo
+  echo "  ]"
+  echo "}"
+} > "$OUTPUT"
@@ -0,0 +1,140 @@
+#!/bin/sh
+# Measures how the time and the memory of the compiler and the assembler
+# grow with the size of the program.
+#
+# usage: scale.sh BIN_DIR TOOLS_DIR WORK_DIR OUTPUT
+#
+# For each shape in $SHAPES (default: all the shapes of lancegen) and each
+# number of statements in $SIZES (default: 1000 10000 100000) a program is
+# generated with lancegen. It is compiled with ACSE in each configuration in
+# $CONFIGS (default: O0 O1), and the output is assembled. The wall time and
+# the peak resident memory of every run are written to OUTPUT in JSON, and
+# printed as a chart for each shape, tool and configuration. The growth
+# columns give the exponent k of the growth, as if the cost were
+# proportional to n^k between each size n and the previous one: 1 means
+# linear and 2 quadratic.
+#
+# Each run is stopped after $TIMEOUT seconds (default 600), and the larger
+# sizes of the same shape and configuration are then skipped.
+
+set -e
+
+if [ $# -ne 4 ]; then
+  echo "usage: $0 BIN_DIR TOOLS_DIR WORK_DIR OUTPUT" >&2
+  exit 2
+fi
+BIN_DIR=$1
+TOOLS_DIR=$2
+WORK_DIR=$3
+OUTPUT=$4
+SHAPES=${SHAPES:-"straight nested vars arrays mixed"}
+SIZES=${SIZES:-"1000 10000 100000"}
+CONFIGS=${CONFIGS:-"O0 O1"}
+TIMEOUT=${TIMEOUT:-600}
+
+ACSE=$BIN_DIR/acse
+ASM=$BIN_DIR/asrv32im
+GEN=$TOOLS_DIR/lancegen
+MEASURE=$TOOLS_DIR/measure
+
+mkdir -p "$WORK_DIR"
+
+# Prints the options of ACSE for a configuration.
+configFlags()
+{
+  case $1 in
+    O0) echo "";;
+    O1) echo "-O1";;
+    O1-color) echo "-O1 -ralloc=color";;
+    *)
+      echo "$0: unknown configuration \"$1\"" >&2
+      exit 1;;
+  esac
+}
+
+# Runs a command under measure, and appends a line with its results to the
+# table. Returns the exit status of the command.
+# usage: measureRun SHAPE SIZE TOOL CONFIG command...
+measureRun()
+{
+  shape=$1 size=$2 tool=$3 config=$4
+  shift 4
+  "$MEASURE" -t "$TIMEOUT" -o "$WORK_DIR/last" "$@" >/dev/null 2>&1
+  read -r ms rss status < "$WORK_DIR/last"
+  echo "$shape $size $tool $config $ms $rss $status" >> "$table"
+  echo "  $shape $size: $tool ($config) $ms ms, $rss KiB" >&2
+  return "$status"
+}
+
+table=$WORK_DIR/table
+: > "$table"
+for shape in $SHAPES; do
+  failed=
+  for size in $SIZES; do
+    src=$WORK_DIR/$shape.$size.src
+    "$GEN" -s "$shape" "$size" > "$src"
+    for config in $CONFIGS; do
+      case " $failed " in
+        *" $config "*) continue;;
+      esac
+      base=$WORK_DIR/$shape.$size.$config
+      # shellcheck disable=SC2046
+      if ! measureRun "$shape" "$size" acse "$config" \
+          "$ACSE" $(configFlags "$config") "$src" -o "$base.s" ||
+         ! measureRun "$shape" "$size" asrv32im "$config" \
+          "$ASM" "$base.s" -o "$base.o"; then
+        echo "  $shape ($config) failed at $size statements," \
+            "skipping the larger sizes" >&2
+        failed="$failed $config"
+      fi
+      rm -f "$base.s" "$base.o"
+    done
+    rm -f "$src"
+  done
+done
+
+awk -v output="$OUTPUT" '
+  function growth(prev, cur, prevSize, size) {
+    if (prevSize == "" || prev <= 0 || cur <= 0)
+      return "-"
+    return sprintf("%.2f", log(cur / prev) / log(size / prevSize))
+  }
+
+  {
+    printf "%s    {\"shape\": \"%s\", \"statements\": %d, \"tool\": \"%s\", " \
+        "\"config\": \"%s\", \"wall_ms\": %.3f, \"rss_kib\": %d, " \
+        "\"status\": %d}", (NR > 1 ? ",\n" : ""), $1, $2, $3, $4, $5, $6, $7 \
+        > output
+    # The rows are grouped by series in the order they first appear.
+    series = $1 ", " $3 " (" $4 ")"
+    if (!(series in numRows))
+      seriesList[++numSeries] = series
+    rows[series, ++numRows[series]] = $0
+  }
+
+  BEGIN {
+    printf "{\n  \"version\": 1,\n  \"runs\": [\n" > output
+  }
+
+  END {
+    printf "\n  ]\n}\n" > output
+    for (s = 1; s <= numSeries; s++) {
+      series = seriesList[s]
+      printf "\n%s\n", series
+      printf "  %10s %11s %6s %11s %6s\n", "statements", "wall (ms)",
+          "growth", "RSS (KiB)", "growth"
+      prevSize = ""
+      for (r = 1; r <= numRows[series]; r++) {
+        split(rows[series, r], f, " ")
+        size = f[2]; ms = f[5]; rss = f[6]; status = f[7]
+        bar = ""
+        for (i = 1; i <= int(8 * log(ms + 1) / log(10)); i++)
+          bar = bar "#"
+        printf "  %10d %11.1f %6s %11d %6s  %s%s\n", size, ms,
+            growth(prevMs, ms, prevSize, size), rss,
+            growth(prevRss, rss, prevSize, size), bar,
+            status != 0 ? "  (failed, status " status ")" : ""
+        prevSize = size; prevMs = ms; prevRss = rss
+      }
+    }
+  }' "$table"
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "batch.h"
+#include "context.h"
+#include "cpu.h"
+#include "memory.h"
+#include "supervisor.h"
+
+/* Outcomes of a job which did not get to run the program */
+enum {
+  BATCH_STATUS_FILE_ERROR = -2000,
+  BATCH_STATUS_LOAD_ERROR = -2001
+};
+
+typedef struct {
+  const char *input;
+  t_svStatus status;
+  t_isaInt exitCode;
+  t_memAddress faultAddress;
+} t_batchJob;
+
+/* Jobs are taken in order by the first idle worker. Each job runs for much
+ * longer than it takes to dispatch it, so a single shared index is all the
+ * load balancing needed. */
+typedef struct {
+  const t_ldrImage *image;
+  const t_batchOptions *opts;
+  t_batchJob *jobs;
+  int numJobs;
+  int nextJob;
+  pthread_mutex_t lock;
+} t_batchQueue;
+
+
+static t_batchJob *batchTakeJob(t_batchQueue *queue)
+{
+  t_batchJob *job = NULL;
+  pthread_mutex_lock(&queue->lock);
+  if (queue->nextJob < queue->numJobs)
+    job = &queue->jobs[queue->nextJob++];
+  pthread_mutex_unlock(&queue->lock);
+  return job;
+}
+
+
+static void batchRunJob(t_batchQueue *queue, t_batchJob *job)
+{
+  job->status = BATCH_STATUS_FILE_ERROR;
+
+  size_t inputLen = strlen(job->input);
+  char *outName = malloc(inputLen + sizeof(".out"));
+  if (!outName)
+    return;
+  memcpy(outName, job->input, inputLen);
+  strcpy(outName + inputLen, ".out");
+  FILE *in = fopen(job->input, "rb");
+  FILE *out = fopen(outName, "wb");
+  free(outName);
+  t_simContext *ctx = newSimContext();
+  if (!in || !out || !ctx)
+    goto cleanup;
+
+  cpuSetBlockTranslation(ctx, queue->opts->blockTranslation);
+  svSetIOFiles(ctx, in, out);
+  svSetBufferedIO(ctx, true);
+  svSetInstructionLimit(ctx, queue->opts->instrLimit);
+  svSetStackSize(ctx, queue->opts->stackSize);
+  bool loaded = queue->opts->snapshot
+      ? snapLoad(ctx, queue->opts->snapshot) == SNAP_NO_ERROR
+      : ldrLoadImage(ctx, queue->image) == LDR_NO_ERROR &&
+          initSupervisor(ctx) == SV_NO_ERROR;
+  if (!loaded) {
+    job->status = BATCH_STATUS_LOAD_ERROR;
+    goto cleanup;
+  }
+
+  job->status = svVMRun(ctx);
+  job->exitCode = svGetExitCode(ctx);
+  if (job->status == SV_STATUS_MEMORY_FAULT)
+    job->faultAddress = memGetLastFaultAddress(ctx);
+  else if (job->status == SV_STATUS_ILL_INST_FAULT)
+    job->faultAddress = cpuGetRegister(ctx, CPU_REG_PC);
+
+cleanup:
+  deleteSimContext(ctx);
+  if (in)
+    fclose(in);
+  if (out)
+    fclose(out);
+}
+
+
+static void *batchWorker(void *arg)
+{
+  t_batchQueue *queue = (t_batchQueue *)arg;
+  t_batchJob *job;
+  while ((job = batchTakeJob(queue)) != NULL)
+    batchRunJob(queue, job);
+  return NULL;
+}
+
+
+static void batchPrintResult(const t_batchJob *job)
+{
+  printf("%s: ", job->input);
+  switch (job->status) {
+    case SV_STATUS_TERMINATED:
+      printf("exit code %" PRId32 "\n", job->exitCode);
+      break;
+    case SV_STATUS_MEMORY_FAULT:
+      printf("memory fault at address 0x%08" PRIx32 "\n", job->faultAddress);
+      break;
+    case SV_STATUS_ILL_INST_FAULT:
+      printf("illegal instruction at address 0x%08" PRIx32 "\n",
+          job->faultAddress);
+      break;
+    case SV_STATUS_INSTR_LIMIT:
+      puts("instruction limit reached");
+      break;
+    case SV_STATUS_INVALID_SYSCALL:
+      puts("invalid system call");
+      break;
+    case BATCH_STATUS_LOAD_ERROR:
+      puts("error during executable loading");
+      break;
+    default:
+      puts("could not open the input or output file");
+  }
+}
+
+
+int batchRun(const t_ldrImage *image, char *inputs[], int numInputs,
+    const t_batchOptions *opts)
+{
+  t_batchQueue queue;
+  queue.image = image;
+  queue.opts = opts;
+  queue.numJobs = numInputs;
+  queue.nextJob = 0;
+  queue.jobs = calloc((size_t)numInputs, sizeof(t_batchJob));
+  int numThreads = opts->numThreads < numInputs ? opts->numThreads : numInputs;
+  pthread_t *threads = calloc((size_t)numThreads, sizeof(pthread_t));
+  if (!queue.jobs || !threads) {
+    free(queue.jobs);
+    free(threads);
+    fprintf(stderr, "Out of memory\n");
+    return numInputs;
+  }
+  for (int i = 0; i < numInputs; i++)
+    queue.jobs[i].input = inputs[i];
+  pthread_mutex_init(&queue.lock, NULL);
+
+  /* The calling thread works too, and it is the only worker if the others
+   * cannot be started */
+  int numStarted = 0;
+  while (numStarted < numThreads - 1 &&
+      pthread_create(&threads[numStarted], NULL, batchWorker, &queue) == 0)
+    numStarted++;
+  batchWorker(&queue);
+  for (int i = 0; i < numStarted; i++)
+    pthread_join(threads[i], NULL);
+
+  int numFailed = 0;
+  for (int i = 0; i < numInputs; i++) {
+    batchPrintResult(&queue.jobs[i]);
+    if (queue.jobs[i].status != SV_STATUS_TERMINATED)
+      numFailed++;
+  }
+
+  pthread_mutex_destroy(&queue.lock);
+  free(threads);
+  free(queue.jobs);
+  return numFailed;
+}
@@ -0,0 +1,29 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "loader.h"
+#include "snapshot.h"
+
+typedef struct {
+  int numThreads;
+  bool blockTranslation;
+  /* maximum number of instructions executed by each job, 0 if unlimited */
+  uint64_t instrLimit;
+  t_memSize stackSize;
+  /* if not NULL, every job resumes the program from it instead of starting
+   * it from the executable */
+  const t_snapshot *snapshot;
+} t_batchOptions;
+
+
+/* Runs the executable once for each input file, using it as the standard
+ * input of the program. The output of the program is written to a file with
+ * the name of the input followed by ".out", and the outcome of each run is
+ * printed to stdout. Returns the number of runs which did not terminate
+ * normally. */
+int batchRun(const t_ldrImage *image, char *inputs[], int numInputs,
+    const t_batchOptions *opts);
+
+#endif
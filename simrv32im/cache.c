@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "cache.h"
+#include "cpu.h"
+#include "isa.h"
+
+#define CACHE_MAX_REPORTED_PCS 20
+
+/* Each line is identified by its address divided by the line size. A line
+ * whose lastUse is zero is invalid. */
+typedef struct {
+  t_memAddress tag;
+  uint64_t lastUse;
+  bool dirty;
+} t_cacheLine;
+
+typedef struct {
+  t_cacheConfig config;
+  uint32_t numSets;
+  uint32_t lineBits;
+  t_cacheLine *lines;
+  uint64_t clock;
+  uint64_t accesses;
+  uint64_t misses;
+  uint64_t writebacks;
+  /* misses caused by each instruction in the profiled range */
+  uint64_t *pcMisses;
+} t_cacheLevel;
+
+typedef struct {
+  uint32_t slot;
+  uint64_t misses;
+} t_cacheEntry;
+
+struct cacheState {
+  t_cacheLevel *levels[CACHE_NUM_LEVELS];
+  t_memAddress base;
+  uint32_t numSlots;
+  /* data accesses made by each instruction in the profiled range */
+  uint64_t *pcDataAccesses;
+};
+
+static const char *const cacheLevelNames[CACHE_NUM_LEVELS] = {
+    "L1I", "L1D", "L2"};
+
+
+static bool cacheIsPowerOf2(uint32_t x)
+{
+  return x != 0 && (x & (x - 1)) == 0;
+}
+
+
+static uint32_t cacheLog2(uint32_t x)
+{
+  uint32_t res = 0;
+  while (x > 1) {
+    x >>= 1;
+    res++;
+  }
+  return res;
+}
+
+
+static void deleteCacheLevel(t_cacheLevel *level)
+{
+  if (!level)
+    return;
+  free(level->lines);
+  free(level->pcMisses);
+  free(level);
+}
+
+
+static t_cacheLevel *newCacheLevel(
+    const t_cacheConfig *config, uint32_t numSlots)
+{
+  t_cacheLevel *level = calloc(1, sizeof(t_cacheLevel));
+  if (!level)
+    return NULL;
+  level->config = *config;
+  level->numSets = config->size / (config->ways * config->lineSize);
+  level->lineBits = cacheLog2(config->lineSize);
+  level->lines = calloc(config->size / config->lineSize, sizeof(t_cacheLine));
+  level->pcMisses = calloc(numSlots + 1, sizeof(uint64_t));
+  if (!level->lines || !level->pcMisses) {
+    deleteCacheLevel(level);
+    return NULL;
+  }
+  return level;
+}
+
+
+t_cacheState *newCacheState(
+    const t_cacheConfig config[CACHE_NUM_LEVELS], t_memAddress base,
+    t_memSize extent)
+{
+  t_cacheState *cache = calloc(1, sizeof(t_cacheState));
+  if (!cache)
+    return NULL;
+  cache->base = base;
+  cache->numSlots = extent / 2;
+  cache->pcDataAccesses = calloc(cache->numSlots + 1, sizeof(uint64_t));
+  if (!cache->pcDataAccesses) {
+    deleteCacheState(cache);
+    return NULL;
+  }
+  for (int i = 0; i < CACHE_NUM_LEVELS; i++) {
+    if (config[i].size == 0)
+      continue;
+    cache->levels[i] = newCacheLevel(&config[i], cache->numSlots);
+    if (!cache->levels[i]) {
+      deleteCacheState(cache);
+      return NULL;
+    }
+  }
+  return cache;
+}
+
+
+void deleteCacheState(t_cacheState *cache)
+{
+  if (!cache)
+    return;
+  for (int i = 0; i < CACHE_NUM_LEVELS; i++)
+    deleteCacheLevel(cache->levels[i]);
+  free(cache->pcDataAccesses);
+  free(cache);
+}
+
+
+static bool cacheParseSize(const char *str, char **end, uint32_t *out)
+{
+  unsigned long val = strtoul(str, end, 0);
+  if (*end == str)
+    return false;
+  if (**end == 'k' || **end == 'K') {
+    val *= 1024;
+    (*end)++;
+  } else if (**end == 'm' || **end == 'M') {
+    val *= 1024 * 1024;
+    (*end)++;
+  }
+  if (val > UINT32_MAX / 2 + 1 || !cacheIsPowerOf2((uint32_t)val))
+    return false;
+  *out = (uint32_t)val;
+  return true;
+}
+
+
+bool cacheParseConfig(const char *str, t_cacheConfig config[CACHE_NUM_LEVELS])
+{
+  while (*str) {
+    t_cacheLevelID id;
+    if (strncmp(str, "l1i:", 4) == 0) {
+      id = CACHE_L1I;
+      str += 4;
+    } else if (strncmp(str, "l1d:", 4) == 0) {
+      id = CACHE_L1D;
+      str += 4;
+    } else if (strncmp(str, "l2:", 3) == 0) {
+      id = CACHE_L2;
+      str += 3;
+    } else {
+      return false;
+    }
+
+    t_cacheConfig level;
+    char *end;
+    if (!cacheParseSize(str, &end, &level.size) || *end != ':')
+      return false;
+    if (!cacheParseSize(end + 1, &end, &level.ways) || *end != ':')
+      return false;
+    if (!cacheParseSize(end + 1, &end, &level.lineSize))
+      return false;
+    if (*end == ',')
+      end++;
+    else if (*end != '\0')
+      return false;
+    if (level.lineSize < 4 || level.size / level.lineSize < level.ways)
+      return false;
+    config[id] = level;
+    str = end;
+  }
+  return true;
+}
+
+
+bool cacheEnable(t_simContext *ctx,
+    const t_cacheConfig config[CACHE_NUM_LEVELS], t_memAddress base,
+    t_memSize extent)
+{
+  t_cacheState *cache = newCacheState(config, base, extent);
+  if (!cache)
+    return false;
+  deleteCacheState(ctx->cache);
+  ctx->cache = cache;
+  cpuSetBlockTranslation(ctx, false);
+  return true;
+}
+
+
+static uint32_t cacheSlot(t_cacheState *cache, t_memAddress pc)
+{
+  uint32_t slot = (pc - cache->base) >> 1;
+  return slot < cache->numSlots ? slot : cache->numSlots;
+}
+
+
+/* Accesses the line holding addr in the given level, and in the levels
+ * after it on a miss. slot identifies the instruction which made the access
+ * (numSlots if it is outside of the profiled range). */
+static void cacheAccessLevel(t_cacheState *cache, t_cacheLevelID id,
+    t_memAddress addr, bool isStore, uint32_t slot)
+{
+  t_cacheLevel *level = cache->levels[id];
+  t_cacheLevel *next = id == CACHE_L2 ? NULL : cache->levels[CACHE_L2];
+  if (!level) {
+    if (next)
+      cacheAccessLevel(cache, CACHE_L2, addr, isStore, slot);
+    return;
+  }
+  t_memAddress tag = addr >> level->lineBits;
+  t_cacheLine *set = &level->lines[(tag & (level->numSets - 1)) *
+      level->config.ways];
+
+  level->accesses++;
+  level->clock++;
+  t_cacheLine *victim = &set[0];
+  for (uint32_t i = 0; i < level->config.ways; i++) {
+    if (set[i].lastUse != 0 && set[i].tag == tag) {
+      set[i].lastUse = level->clock;
+      set[i].dirty |= isStore;
+      return;
+    }
+    if (set[i].lastUse < victim->lastUse)
+      victim = &set[i];
+  }
+
+  level->misses++;
+  level->pcMisses[slot]++;
+  if (victim->lastUse != 0 && victim->dirty) {
+    level->writebacks++;
+    if (next)
+      cacheAccessLevel(cache, CACHE_L2, victim->tag << level->lineBits, true,
+          slot);
+  }
+  if (next)
+    cacheAccessLevel(cache, CACHE_L2, addr, false, slot);
+  victim->tag = tag;
+  victim->lastUse = level->clock;
+  victim->dirty = isStore;
+}
+
+
+void cacheFetch(t_simContext *ctx, t_memAddress pc)
+{
+  t_cacheState *cache = ctx->cache;
+  cacheAccessLevel(cache, CACHE_L1I, pc, false, cacheSlot(cache, pc));
+}
+
+
+void cacheAccess(t_simContext *ctx, t_memAddress pc, t_memAddress addr,
+    t_memSize size, bool isStore)
+{
+  t_cacheState *cache = ctx->cache;
+  uint32_t slot = cacheSlot(cache, pc);
+  cache->pcDataAccesses[slot]++;
+  t_cacheLevel *l1d = cache->levels[CACHE_L1D];
+  uint32_t lineBits = l1d ? l1d->lineBits : 2;
+  /* an unaligned access may touch two lines */
+  cacheAccessLevel(cache, CACHE_L1D, addr, isStore, slot);
+  if (((addr + size - 1) >> lineBits) != (addr >> lineBits))
+    cacheAccessLevel(cache, CACHE_L1D, addr + size - 1, isStore, slot);
+}
+
+
+static uint64_t cachePCMisses(t_cacheState *cache, uint32_t slot)
+{
+  uint64_t res = 0;
+  for (int i = 0; i < CACHE_NUM_LEVELS; i++)
+    if (cache->levels[i])
+      res += cache->levels[i]->pcMisses[slot];
+  return res;
+}
+
+
+static int cacheCompareEntries(const void *a, const void *b)
+{
+  const t_cacheEntry *ea = a, *eb = b;
+  if (ea->misses != eb->misses)
+    return ea->misses < eb->misses ? 1 : -1;
+  return ea->slot < eb->slot ? -1 : ea->slot > eb->slot;
+}
+
+
+void cacheWriteReport(t_simContext *ctx, FILE *fp)
+{
+  t_cacheState *cache = ctx->cache;
+
+  fprintf(fp, "%-5s %8s %5s %5s %14s %14s %8s %12s\n", "cache", "size",
+      "ways", "line", "accesses", "misses", "miss %", "writebacks");
+  for (int i = 0; i < CACHE_NUM_LEVELS; i++) {
+    t_cacheLevel *level = cache->levels[i];
+    if (!level)
+      continue;
+    double missRate = level->accesses
+        ? (double)level->misses * 100.0 / (double)level->accesses
+        : 0.0;
+    char size[16];
+    if (level->config.size % 1024 == 0)
+      snprintf(size, sizeof(size), "%" PRIu32 "K", level->config.size / 1024);
+    else
+      snprintf(size, sizeof(size), "%" PRIu32, level->config.size);
+    fprintf(fp,
+        "%-5s %8s %5" PRIu32 " %5" PRIu32 " %14" PRIu64 " %14" PRIu64
+        " %7.2f%% %12" PRIu64 "\n",
+        cacheLevelNames[i], size, level->config.ways,
+        level->config.lineSize, level->accesses, level->misses, missRate,
+        level->writebacks);
+  }
+
+  t_cacheEntry *entries = malloc(sizeof(t_cacheEntry) * (cache->numSlots + 1));
+  if (!entries)
+    return;
+  uint32_t numEntries = 0;
+  for (uint32_t i = 0; i < cache->numSlots; i++) {
+    uint64_t misses = cachePCMisses(cache, i);
+    if (misses == 0)
+      continue;
+    entries[numEntries].slot = i;
+    entries[numEntries++].misses = misses;
+  }
+  qsort(entries, numEntries, sizeof(t_cacheEntry), cacheCompareEntries);
+  if (numEntries > CACHE_MAX_REPORTED_PCS)
+    numEntries = CACHE_MAX_REPORTED_PCS;
+
+  fprintf(fp, "\nInstructions with the most misses:\n");
+  fprintf(fp, "  %-10s %12s", "address", "data acc.");
+  for (int i = 0; i < CACHE_NUM_LEVELS; i++)
+    if (cache->levels[i])
+      fprintf(fp, " %7s miss", cacheLevelNames[i]);
+  fprintf(fp, "  instruction\n");
+  for (uint32_t i = 0; i < numEntries; i++) {
+    uint32_t slot = entries[i].slot;
+    t_memAddress pc = cache->base + slot * 2;
+    char disasm[80];
+    isaDisassemble(cpuDebugReadInstruction(ctx, pc), disasm, sizeof(disasm));
+    fprintf(fp, "  0x%08" PRIx32 " %12" PRIu64, pc,
+        cache->pcDataAccesses[slot]);
+    for (int j = 0; j < CACHE_NUM_LEVELS; j++)
+      if (cache->levels[j])
+        fprintf(fp, " %12" PRIu64, cache->levels[j]->pcMisses[slot]);
+    fprintf(fp, "  %s\n", disasm);
+  }
+  free(entries);
+}
@@ -0,0 +1,57 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "memory.h"
+#include "context.h"
+
+/* Model of a cache hierarchy with split L1 instruction and data caches and
+ * an optional unified L2. Caches are set associative with LRU replacement,
+ * write-back and write-allocate. The model only counts hits and misses, it
+ * does not change the timing or the results of the simulation. */
+
+typedef int t_cacheLevelID;
+enum {
+  CACHE_L1I = 0,
+  CACHE_L1D,
+  CACHE_L2,
+  CACHE_NUM_LEVELS
+};
+
+typedef struct {
+  /* all sizes are in bytes and must be powers of two; a cache with size zero
+   * is not modeled */
+  uint32_t size;
+  uint32_t ways;
+  uint32_t lineSize;
+} t_cacheConfig;
+
+typedef struct cacheState t_cacheState;
+
+
+t_cacheState *newCacheState(
+    const t_cacheConfig config[CACHE_NUM_LEVELS], t_memAddress base,
+    t_memSize extent);
+void deleteCacheState(t_cacheState *cache);
+
+/* Parses a list of cache configurations in the form
+ *   name:size:ways:line[,name:size:ways:line...]
+ * where name is l1i, l1d or l2 and size can have a k or m suffix. Levels not
+ * in the list are left unchanged. Returns false if the list is invalid. */
+bool cacheParseConfig(const char *str, t_cacheConfig config[CACHE_NUM_LEVELS]);
+
+/* Starts modeling the caches. Misses are also counted separately for each
+ * instruction in the given range of addresses. */
+bool cacheEnable(t_simContext *ctx,
+    const t_cacheConfig config[CACHE_NUM_LEVELS], t_memAddress base,
+    t_memSize extent);
+
+void cacheFetch(t_simContext *ctx, t_memAddress pc);
+void cacheAccess(t_simContext *ctx, t_memAddress pc, t_memAddress addr,
+    t_memSize size, bool isStore);
+
+void cacheWriteReport(t_simContext *ctx, FILE *fp);
+
+#endif
@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include "context.h"
+#include "cpu.h"
+#include "memory.h"
+#include "supervisor.h"
+#include "debugger.h"
+#include "profiler.h"
+#include "cache.h"
+#include "trace.h"
+#include "symbols.h"
+
+
+t_simContext *newSimContext(void)
+{
+  t_simContext *ctx = calloc(1, sizeof(t_simContext));
+  if (!ctx)
+    return NULL;
+  ctx->cpu = newCPUState();
+  ctx->mem = newMemState();
+  ctx->sv = newSvState();
+  ctx->dbg = newDbgState();
+  if (!ctx->cpu || !ctx->mem || !ctx->sv || !ctx->dbg) {
+    deleteSimContext(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+
+void deleteSimContext(t_simContext *ctx)
+{
+  if (!ctx)
+    return;
+  traceClose(ctx);
+  deleteSymState(ctx->sym);
+  deleteCacheState(ctx->cache);
+  deleteProfState(ctx->prof);
+  deleteDbgState(ctx->dbg);
+  deleteSvState(ctx->sv);
+  deleteMemState(ctx->mem);
+  deleteCPUState(ctx->cpu);
+  free(ctx);
+}
+
+
+void resetSimContext(t_simContext *ctx)
+{
+  memUnmapAll(ctx);
+  cpuReset(ctx, 0);
+  svReset(ctx);
+}
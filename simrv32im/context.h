@@ -0,0 +1,30 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+/* The complete state of a simulated machine. Each module keeps its state in
+ * one of the members, and every function operating on a machine takes its
+ * context, so that independent contexts can be used at the same time, also
+ * from different threads. */
+typedef struct simContext {
+  struct cpuState *cpu;
+  struct memState *mem;
+  struct svState *sv;
+  struct dbgState *dbg;
+  /* NULL unless the profiler, the cache model or the trace recorder are
+   * enabled */
+  struct profState *prof;
+  struct cacheState *cache;
+  struct traceState *trace;
+  /* NULL unless the symbols of the executable were loaded */
+  struct symState *sym;
+} t_simContext;
+
+
+t_simContext *newSimContext(void);
+void deleteSimContext(t_simContext *ctx);
+/* Unloads the program from a context, which keeps its settings and can then
+ * load and run another one. The profiler, the cache model, the trace and the
+ * symbols, if enabled, are left as they are. */
+void resetSimContext(t_simContext *ctx);
+
+#endif
@@ -1,430 +1,1228 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include "cpu.h"
+#include "isa.h"
 #include "memory.h"
+#include "profiler.h"
+#include "cache.h"
+#include "trace.h"
 
 #define CPU_N_REGS 32
+/* Decoded instructions writing x0 write this register instead, so that x0
+ * never needs to be reset. */
+#define CPU_REG_SINK CPU_N_REGS
 
-t_cpuURegValue cpuRegs[CPU_N_REGS];
-t_cpuURegValue cpuPC;
-t_cpuStatus lastStatus;
+typedef uint8_t t_cpuOp;
+enum {
+  CPU_OP_NONE = 0,
+  CPU_OP_LB,
+  CPU_OP_LH,
+  CPU_OP_LW,
+  CPU_OP_LBU,
+  CPU_OP_LHU,
+  CPU_OP_ADDI,
+  CPU_OP_SLLI,
+  CPU_OP_SLTI,
+  CPU_OP_SLTIU,
+  CPU_OP_XORI,
+  CPU_OP_SRLI,
+  CPU_OP_SRAI,
+  CPU_OP_ORI,
+  CPU_OP_ANDI,
+  CPU_OP_AUIPC,
+  CPU_OP_SB,
+  CPU_OP_SH,
+  CPU_OP_SW,
+  CPU_OP_ADD,
+  CPU_OP_SLL,
+  CPU_OP_SLT,
+  CPU_OP_SLTU,
+  CPU_OP_XOR,
+  CPU_OP_SRL,
+  CPU_OP_OR,
+  CPU_OP_AND,
+  CPU_OP_SUB,
+  CPU_OP_SRA,
+  CPU_OP_MUL,
+  CPU_OP_MULH,
+  CPU_OP_MULHSU,
+  CPU_OP_MULHU,
+  CPU_OP_DIV,
+  CPU_OP_DIVU,
+  CPU_OP_REM,
+  CPU_OP_REMU,
+  CPU_OP_LUI,
+  CPU_OP_BEQ,
+  CPU_OP_BNE,
+  CPU_OP_BLT,
+  CPU_OP_BGE,
+  CPU_OP_BLTU,
+  CPU_OP_BGEU,
+  CPU_OP_JALR,
+  CPU_OP_JAL,
+  CPU_OP_ECALL,
+  CPU_OP_EBREAK,
+  CPU_OP_ILLEGAL,
+  /* fused pairs of instructions */
+  CPU_OP_LUI_ADDI,
+  CPU_OP_AUIPC_ADDI,
+  CPU_OP_AUIPC_LW,
+  CPU_OP_AUIPC_SW,
+  CPU_OP_ADDI_MUL,
+  CPU_OP_SLT_BEQ,
+  CPU_OP_SLT_BNE,
+  CPU_OP_SLTU_BEQ,
+  CPU_OP_SLTU_BNE
+};
 
+/* An instruction with all its fields already extracted. The immediate is
+ * stored in the form used by the operation (sign-extended, shifted or masked)
+ * so that executing it requires no further decoding.
+ *   When the instruction and the following one form a common idiom, fusedOp
+ * is an operation executing both, and the fused* fields are the decoded
+ * fields of the second instruction. Otherwise fusedOp is the same as op.
+ *   length is the size in bytes of the instruction, 2 if it is compressed and
+ * 4 otherwise, and fusedLength the size of the instructions executed by
+ * fusedOp. Compressed instructions are decoded as the instructions they
+ * stand for. */
+typedef struct {
+  t_memAddress pc;
+  t_cpuOp op;
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  t_cpuURegValue imm;
+  t_cpuOp fusedOp;
+  uint8_t fusedRd;
+  uint8_t fusedRs1;
+  uint8_t fusedRs2;
+  t_cpuURegValue fusedImm;
+  uint8_t length;
+  uint8_t fusedLength;
+} t_cpuDecodedInst;
 
-t_cpuURegValue cpuGetRegister(t_cpuRegID reg)
+/* The decode cache is direct-mapped and indexed by word address. The
+ * instructions starting in the middle of a word, which exist only in code
+ * with compressed instructions, take their entry from the other half of the
+ * cache. Only instructions at even addresses are cached.
+ *   Every page which ever contained a cached instruction is marked in
+ * codePages, so that stores outside the text can skip the lookup of the
+ * cache entry they might be overwriting. Entries copied into a translated
+ * block are marked in decodeInBlock.
+ *   The first code pages marked are also listed, so that the cache of a
+ * small program is flushed by clearing only the entries of its pages. Past
+ * CPU_MAX_LISTED_PAGES pages clearing the whole cache is faster. */
+#define CPU_DCACHE_BITS 14
+#define CPU_DCACHE_SIZE (1 << CPU_DCACHE_BITS)
+#define CPU_HALF_INDEX(pc, bits) \
+  ((((pc) >> 2) ^ ((pc) << ((bits) - 2))) & ((1U << (bits)) - 1))
+#define CPU_DCACHE_INDEX(pc) CPU_HALF_INDEX(pc, CPU_DCACHE_BITS)
+#define CPU_CODE_PAGE_BITS 12
+#define CPU_CODE_PAGE_COUNT (1 << (32 - CPU_CODE_PAGE_BITS))
+#define CPU_MAX_LISTED_PAGES \
+  (CPU_DCACHE_SIZE >> (CPU_CODE_PAGE_BITS - 1))
+
+/* Block translation.
+ *   When enabled, the targets of control transfers are counted, and once
+ * one of them has been reached CPU_BLOCK_HOT_THRESHOLD times the basic block
+ * starting there is translated: its decoded instructions are copied into a
+ * t_cpuBlock, followed by a sentinel holding the address of the next
+ * instruction. Translated blocks run without any lookup, budget check or PC
+ * update between instructions, and jump directly to the blocks which
+ * followed them in the past (chaining).
+ *   All blocks are discarded when one of their instructions is overwritten or
+ * evicted from the decode cache. Since this can happen while a block is
+ * running, discarded blocks are freed only when no block is running. */
+#define CPU_BLOCK_MAX_LENGTH 64
+#define CPU_BLOCK_HOT_THRESHOLD 16
+#define CPU_BLOCK_TABLE_BITS 12
+#define CPU_BLOCK_TABLE_SIZE (1 << CPU_BLOCK_TABLE_BITS)
+#define CPU_BLOCK_TABLE_INDEX(pc) CPU_HALF_INDEX(pc, CPU_BLOCK_TABLE_BITS)
+
+typedef struct cpuBlock {
+  struct cpuBlock *next;
+  t_memAddress succPC[2];
+  struct cpuBlock *succ[2];
+  uint32_t length;
+  t_cpuDecodedInst insts[];
+} t_cpuBlock;
+
+typedef struct {
+  t_memAddress pc;
+  uint32_t heat;
+  t_cpuBlock *block;
+} t_cpuBlockTableEntry;
+
+typedef struct cpuState {
+  t_cpuURegValue regs[CPU_N_REGS + 1];
+  t_cpuURegValue pc;
+  t_cpuStatus lastStatus;
+  uint64_t instrCount;
+  t_cpuDecodedInst decodeCache[CPU_DCACHE_SIZE];
+  uint32_t codePages[CPU_CODE_PAGE_COUNT / 32];
+  uint32_t listedPages[CPU_MAX_LISTED_PAGES];
+  /* CPU_MAX_LISTED_PAGES + 1 when more pages were marked than listed */
+  int numListedPages;
+  uint8_t decodeInBlock[CPU_DCACHE_SIZE];
+  /* holds instructions at addresses which cannot be cached */
+  t_cpuDecodedInst uncached;
+  bool blocksEnabled;
+  t_cpuBlockTableEntry blockTable[CPU_BLOCK_TABLE_SIZE];
+  t_cpuBlock *blocks;
+  t_cpuBlock *staleBlocks;
+} t_cpuState;
+
+
+static void cpuFlushDecodeCache(t_cpuState *cpu)
 {
+  if (cpu->numListedPages > CPU_MAX_LISTED_PAGES) {
+    for (int i = 0; i < CPU_DCACHE_SIZE; i++)
+      cpu->decodeCache[i].op = cpu->decodeCache[i].fusedOp = CPU_OP_NONE;
+    for (int i = 0; i < CPU_CODE_PAGE_COUNT / 32; i++)
+      cpu->codePages[i] = 0;
+    cpu->numListedPages = 0;
+    return;
+  }
+  for (int i = 0; i < cpu->numListedPages; i++) {
+    uint32_t page = cpu->listedPages[i];
+    cpu->codePages[page / 32] &= ~(1U << (page % 32));
+    t_memAddress pc = (t_memAddress)page << CPU_CODE_PAGE_BITS;
+    for (int j = 0; j < (1 << (CPU_CODE_PAGE_BITS - 1)); j++, pc += 2) {
+      t_cpuDecodedInst *entry = &cpu->decodeCache[CPU_DCACHE_INDEX(pc)];
+      entry->op = entry->fusedOp = CPU_OP_NONE;
+    }
+  }
+  cpu->numListedPages = 0;
+}
+
+
+static void cpuFlushBlocks(t_cpuState *cpu)
+{
+  if (!cpu->blocks)
+    return;
+  for (int i = 0; i < CPU_BLOCK_TABLE_SIZE; i++) {
+    cpu->blockTable[i].heat = 0;
+    cpu->blockTable[i].block = NULL;
+  }
+  for (int i = 0; i < CPU_DCACHE_SIZE; i++)
+    cpu->decodeInBlock[i] = 0;
+
+  t_cpuBlock *last = cpu->blocks;
+  while (last->next)
+    last = last->next;
+  last->next = cpu->staleBlocks;
+  cpu->staleBlocks = cpu->blocks;
+  cpu->blocks = NULL;
+}
+
+
+static void cpuFreeStaleBlocks(t_cpuState *cpu)
+{
+  while (cpu->staleBlocks) {
+    t_cpuBlock *next = cpu->staleBlocks->next;
+    free(cpu->staleBlocks);
+    cpu->staleBlocks = next;
+  }
+}
+
+
+static bool cpuIsCodePage(t_cpuState *cpu, t_memAddress addr)
+{
+  uint32_t page = addr >> CPU_CODE_PAGE_BITS;
+  return (cpu->codePages[page / 32] & (1U << (page % 32))) != 0;
+}
+
+
+static void cpuMarkCodePage(t_cpuState *cpu, t_memAddress addr)
+{
+  uint32_t page = addr >> CPU_CODE_PAGE_BITS;
+  uint32_t bit = 1U << (page % 32);
+  if (cpu->codePages[page / 32] & bit)
+    return;
+  cpu->codePages[page / 32] |= bit;
+  if (cpu->numListedPages < CPU_MAX_LISTED_PAGES)
+    cpu->listedPages[cpu->numListedPages] = page;
+  if (cpu->numListedPages <= CPU_MAX_LISTED_PAGES)
+    cpu->numListedPages++;
+}
+
+
+/* Invalidates the cached instructions overlapping the halfword at addr. They
+ * start at most 2 bytes before it, and the pairs fused with it at most 6
+ * bytes before it. */
+static bool cpuInvalidateHalf(t_cpuState *cpu, t_memAddress addr)
+{
+  bool inBlock = false;
+  for (t_memAddress back = 0; back <= 6; back += 2) {
+    t_memAddress pc = addr - back;
+    uint32_t index = CPU_DCACHE_INDEX(pc);
+    t_cpuDecodedInst *entry = &cpu->decodeCache[index];
+    if (entry->pc != pc || entry->op == CPU_OP_NONE)
+      continue;
+    if (back < entry->length)
+      entry->op = entry->fusedOp = CPU_OP_NONE;
+    else if (back < entry->fusedLength && entry->fusedOp != entry->op)
+      entry->fusedOp = entry->op;
+    else
+      continue;
+    inBlock |= cpu->decodeInBlock[index];
+  }
+  if (!inBlock)
+    return false;
+  cpuFlushBlocks(cpu);
+  return true;
+}
+
+
+static bool cpuInvalidateRange(
+    t_cpuState *cpu, t_memAddress addr, t_memAddress last)
+{
+  bool flushed = false;
+  t_memAddress end = (last | 1) + 1;
+  for (t_memAddress half = addr & ~(t_memAddress)1; half != end; half += 2)
+    flushed |= cpuInvalidateHalf(cpu, half);
+  return flushed;
+}
+
+
+/* Returns true if translated blocks were discarded because of the store */
+static inline bool cpuNotifyStore(
+    t_cpuState *cpu, t_memAddress addr, t_memSize size)
+{
+  t_memAddress last = addr + size - 1;
+  if (!cpuIsCodePage(cpu, addr) && !cpuIsCodePage(cpu, last))
+    return false;
+  return cpuInvalidateRange(cpu, addr, last);
+}
+
+
+t_cpuState *newCPUState(void)
+{
+  return calloc(1, sizeof(t_cpuState));
+}
+
+
+void deleteCPUState(t_cpuState *cpu)
+{
+  if (!cpu)
+    return;
+  cpuFlushBlocks(cpu);
+  cpuFreeStaleBlocks(cpu);
+  free(cpu);
+}
+
+
+t_cpuURegValue cpuGetRegister(t_simContext *ctx, t_cpuRegID reg)
+{
+  t_cpuState *cpu = ctx->cpu;
   if (reg == CPU_REG_X0)
     return 0;
   if (reg == CPU_REG_PC)
-    return cpuPC;
-  return cpuRegs[reg];
+    return cpu->pc;
+  return cpu->regs[reg];
 }
 
 
-void cpuSetRegister(t_cpuRegID reg, t_cpuURegValue value)
+void cpuSetRegister(t_simContext *ctx, t_cpuRegID reg, t_cpuURegValue value)
 {
+  t_cpuState *cpu = ctx->cpu;
   if (reg == CPU_REG_PC)
-    cpuPC = value;
+    cpu->pc = value;
   if (reg != CPU_REG_ZERO)
-    cpuRegs[reg] = value;
+    cpu->regs[reg] = value;
 }
 
 
-void cpuReset(t_cpuURegValue pcValue)
+void cpuReset(t_simContext *ctx, t_cpuURegValue pcValue)
 {
-  lastStatus = CPU_STATUS_OK;
-  cpuPC = pcValue;
+  t_cpuState *cpu = ctx->cpu;
+  cpu->lastStatus = CPU_STATUS_OK;
+  cpu->instrCount = 0;
+  cpu->pc = pcValue;
   for (int i = 0; i < CPU_N_REGS; i++) {
-    cpuRegs[i] = 0;
+    cpu->regs[i] = 0;
   }
+  cpuFlushDecodeCache(cpu);
+  cpuFlushBlocks(cpu);
+}
+
+
+uint64_t cpuGetInstructionCount(t_simContext *ctx)
+{
+  return ctx->cpu->instrCount;
 }
 
 
-t_cpuStatus cpuClearLastFault(void)
+void cpuSetInstructionCount(t_simContext *ctx, uint64_t count)
 {
-  if (lastStatus == CPU_STATUS_ILL_INST_FAULT ||
-      lastStatus == CPU_STATUS_EBREAK_TRAP ||
-      lastStatus == CPU_STATUS_ECALL_TRAP)
-    cpuPC += 4;
-  lastStatus = CPU_STATUS_OK;
-  return lastStatus;
+  ctx->cpu->instrCount = count;
 }
 
 
-t_cpuStatus cpuExecuteLOAD(uint32_t instr);
-t_cpuStatus cpuExecuteOPIMM(uint32_t instr);
-t_cpuStatus cpuExecuteAUIPC(uint32_t instr);
-t_cpuStatus cpuExecuteSTORE(uint32_t instr);
-t_cpuStatus cpuExecuteOP(uint32_t instr);
-t_cpuStatus cpuExecuteLUI(uint32_t instr);
-t_cpuStatus cpuExecuteBRANCH(uint32_t instr);
-t_cpuStatus cpuExecuteJALR(uint32_t instr);
-t_cpuStatus cpuExecuteJAL(uint32_t instr);
-t_cpuStatus cpuExecuteSYSTEM(uint32_t instr);
+t_cpuStatus cpuGetLastStatus(t_simContext *ctx)
+{
+  return ctx->cpu->lastStatus;
+}
 
-t_cpuStatus cpuTick(void)
+
+void cpuSetBlockTranslation(t_simContext *ctx, bool enable)
 {
-  if (lastStatus != CPU_STATUS_OK)
-    return lastStatus;
+  t_cpuState *cpu = ctx->cpu;
+  /* the profiler and the cache model only see the instructions fetched from
+   * the decode cache */
+  cpu->blocksEnabled = enable && !ctx->prof && !ctx->cache && !ctx->trace;
+  if (!cpu->blocksEnabled)
+    cpuFlushBlocks(cpu);
+}
 
-  uint32_t nextInst;
-  t_memError fetchErr = memRead32(cpuPC, &nextInst);
-  if (fetchErr != MEM_NO_ERROR) {
-    lastStatus = CPU_STATUS_MEMORY_FAULT;
-    return lastStatus;
+
+t_cpuStatus cpuClearLastFault(t_simContext *ctx)
+{
+  t_cpuState *cpu = ctx->cpu;
+  if (cpu->lastStatus == CPU_STATUS_ILL_INST_FAULT ||
+      cpu->lastStatus == CPU_STATUS_EBREAK_TRAP ||
+      cpu->lastStatus == CPU_STATUS_ECALL_TRAP)
+    cpu->pc += ISA_INST_LENGTH(memDebugRead16(ctx, cpu->pc, NULL));
+  cpu->lastStatus = CPU_STATUS_OK;
+  return cpu->lastStatus;
+}
+
+
+uint32_t cpuDebugReadInstruction(t_simContext *ctx, t_cpuURegValue pc)
+{
+  uint16_t low = memDebugRead16(ctx, pc, NULL);
+  if (ISA_INST_IS_COMPRESSED(low))
+    return low;
+  return memDebugRead32(ctx, pc, NULL);
+}
+
+
+
+static t_cpuOp cpuDecodeLOAD(uint32_t instr, t_cpuDecodedInst *out)
+{
+  out->imm = ISA_INST_I_IMM12_SEXT(instr);
+  switch (ISA_INST_FUNCT3(instr)) {
+    case 0:
+      return CPU_OP_LB;
+    case 1:
+      return CPU_OP_LH;
+    case 2:
+      return CPU_OP_LW;
+    case 4:
+      return CPU_OP_LBU;
+    case 5:
+      return CPU_OP_LHU;
+  }
+  return CPU_OP_ILLEGAL;
+}
+
+static t_cpuOp cpuDecodeOPIMM(uint32_t instr, t_cpuDecodedInst *out)
+{
+  out->imm = ISA_INST_I_IMM12_SEXT(instr);
+  switch (ISA_INST_FUNCT3(instr)) {
+    case 0:
+      return CPU_OP_ADDI;
+    case 1:
+      out->imm = ISA_INST_I_IMM12(instr) & 0x1F;
+      if (ISA_INST_FUNCT7(instr) == 0x00)
+        return CPU_OP_SLLI;
+      return CPU_OP_ILLEGAL;
+    case 2:
+      return CPU_OP_SLTI;
+    case 3:
+      out->imm = ISA_INST_I_IMM12(instr);
+      return CPU_OP_SLTIU;
+    case 4:
+      return CPU_OP_XORI;
+    case 5:
+      out->imm = ISA_INST_I_IMM12(instr) & 0x1F;
+      if (ISA_INST_FUNCT7(instr) == 0x00)
+        return CPU_OP_SRLI;
+      if (ISA_INST_FUNCT7(instr) == 0x20)
+        return CPU_OP_SRAI;
+      return CPU_OP_ILLEGAL;
+    case 6:
+      return CPU_OP_ORI;
+    case 7:
+      return CPU_OP_ANDI;
   }
+  return CPU_OP_ILLEGAL;
+}
 
-  switch (ISA_INST_OPCODE(nextInst)) {
+static t_cpuOp cpuDecodeSTORE(uint32_t instr, t_cpuDecodedInst *out)
+{
+  out->imm = ISA_INST_S_IMM12_SEXT(instr);
+  switch (ISA_INST_FUNCT3(instr)) {
+    case 0:
+      return CPU_OP_SB;
+    case 1:
+      return CPU_OP_SH;
+    case 2:
+      return CPU_OP_SW;
+  }
+  return CPU_OP_ILLEGAL;
+}
+
+static t_cpuOp cpuDecodeOP(uint32_t instr)
+{
+  static const t_cpuOp baseOps[8] = {CPU_OP_ADD, CPU_OP_SLL, CPU_OP_SLT,
+      CPU_OP_SLTU, CPU_OP_XOR, CPU_OP_SRL, CPU_OP_OR, CPU_OP_AND};
+  static const t_cpuOp altOps[8] = {CPU_OP_SUB, CPU_OP_ILLEGAL,
+      CPU_OP_ILLEGAL, CPU_OP_ILLEGAL, CPU_OP_ILLEGAL, CPU_OP_SRA,
+      CPU_OP_ILLEGAL, CPU_OP_ILLEGAL};
+  static const t_cpuOp mulOps[8] = {CPU_OP_MUL, CPU_OP_MULH, CPU_OP_MULHSU,
+      CPU_OP_MULHU, CPU_OP_DIV, CPU_OP_DIVU, CPU_OP_REM, CPU_OP_REMU};
+
+  switch (ISA_INST_FUNCT7(instr)) {
+    case 0x00:
+      return baseOps[ISA_INST_FUNCT3(instr)];
+    case 0x20:
+      return altOps[ISA_INST_FUNCT3(instr)];
+    case 0x01:
+      return mulOps[ISA_INST_FUNCT3(instr)];
+  }
+  return CPU_OP_ILLEGAL;
+}
+
+static t_cpuOp cpuDecodeBRANCH(uint32_t instr, t_cpuDecodedInst *out)
+{
+  out->imm = ISA_INST_B_IMM13_SEXT(instr);
+  switch (ISA_INST_FUNCT3(instr)) {
+    case 0:
+      return CPU_OP_BEQ;
+    case 1:
+      return CPU_OP_BNE;
+    case 4:
+      return CPU_OP_BLT;
+    case 5:
+      return CPU_OP_BGE;
+    case 6:
+      return CPU_OP_BLTU;
+    case 7:
+      return CPU_OP_BGEU;
+  }
+  return CPU_OP_ILLEGAL;
+}
+
+static t_cpuOp cpuDecodeSYSTEM(uint32_t instr)
+{
+  if (ISA_INST_FUNCT3(instr) != 0)
+    return CPU_OP_ILLEGAL;
+  if (ISA_INST_I_IMM12(instr) == 0)
+    return CPU_OP_ECALL;
+  if (ISA_INST_I_IMM12(instr) == 1)
+    return CPU_OP_EBREAK;
+  return CPU_OP_ILLEGAL;
+}
+
+static void cpuDecode(uint32_t instr, t_cpuDecodedInst *out)
+{
+  out->rd = ISA_INST_RD(instr) == CPU_REG_ZERO ? CPU_REG_SINK
+                                                : ISA_INST_RD(instr);
+  out->rs1 = ISA_INST_RS1(instr);
+  out->rs2 = ISA_INST_RS2(instr);
+  out->imm = 0;
+
+  switch (ISA_INST_OPCODE(instr)) {
     case ISA_INST_OPCODE_LOAD:
-      lastStatus = cpuExecuteLOAD(nextInst);
+      out->op = cpuDecodeLOAD(instr, out);
       break;
     case ISA_INST_OPCODE_OPIMM:
-      lastStatus = cpuExecuteOPIMM(nextInst);
+      out->op = cpuDecodeOPIMM(instr, out);
       break;
     case ISA_INST_OPCODE_AUIPC:
-      lastStatus = cpuExecuteAUIPC(nextInst);
+      out->imm = ISA_INST_U_IMM20(instr) << 12;
+      out->op = CPU_OP_AUIPC;
       break;
     case ISA_INST_OPCODE_STORE:
-      lastStatus = cpuExecuteSTORE(nextInst);
+      out->op = cpuDecodeSTORE(instr, out);
       break;
     case ISA_INST_OPCODE_OP:
-      lastStatus = cpuExecuteOP(nextInst);
+      out->op = cpuDecodeOP(instr);
       break;
     case ISA_INST_OPCODE_LUI:
-      lastStatus = cpuExecuteLUI(nextInst);
+      out->imm = ISA_INST_U_IMM20(instr) << 12;
+      out->op = CPU_OP_LUI;
       break;
     case ISA_INST_OPCODE_BRANCH:
-      lastStatus = cpuExecuteBRANCH(nextInst);
+      out->op = cpuDecodeBRANCH(instr, out);
       break;
     case ISA_INST_OPCODE_JALR:
-      lastStatus = cpuExecuteJALR(nextInst);
+      out->imm = ISA_INST_I_IMM12_SEXT(instr);
+      out->op = ISA_INST_FUNCT3(instr) == 0 ? CPU_OP_JALR : CPU_OP_ILLEGAL;
       break;
     case ISA_INST_OPCODE_JAL:
-      lastStatus = cpuExecuteJAL(nextInst);
+      out->imm = ISA_INST_J_IMM21_SEXT(instr);
+      out->op = CPU_OP_JAL;
       break;
     case ISA_INST_OPCODE_SYSTEM:
-      lastStatus = cpuExecuteSYSTEM(nextInst);
+      out->op = cpuDecodeSYSTEM(instr);
       break;
     default:
-      lastStatus = CPU_STATUS_ILL_INST_FAULT;
+      out->op = CPU_OP_ILLEGAL;
   }
-  cpuRegs[CPU_REG_ZERO] = 0;
-  return lastStatus;
 }
 
-t_cpuStatus cpuExecuteLOAD(uint32_t instr)
-{
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  t_memAddress addr = cpuRegs[rs1] + ISA_INST_I_IMM12_SEXT(instr);
 
-  uint8_t tmp8;
-  uint16_t tmp16;
-  uint32_t tmp32;
-  t_memError memStatus;
-  switch (ISA_INST_FUNCT3(instr)) {
-    case 0: /* LB */
-      memStatus = memRead8(addr, &tmp8);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = (t_cpuURegValue)((t_cpuSRegValue)((int8_t)tmp8));
-      break;
-    case 1: /* LH */
-      memStatus = memRead16(addr, &tmp16);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = (t_cpuURegValue)((t_cpuSRegValue)((int16_t)tmp16));
-      break;
-    case 2: /* LW */
-      memStatus = memRead32(addr, &tmp32);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = tmp32;
+static t_cpuOp cpuFuse(const t_cpuDecodedInst *a, const t_cpuDecodedInst *b)
+{
+  switch (a->op) {
+    case CPU_OP_LUI:
+      if (b->op == CPU_OP_ADDI && b->rs1 == a->rd)
+        return CPU_OP_LUI_ADDI;
       break;
-    case 4: /* LBU */
-      memStatus = memRead8(addr, &tmp8);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = (t_cpuURegValue)tmp8;
+    case CPU_OP_AUIPC:
+      if (b->op == CPU_OP_ADDI && b->rs1 == a->rd)
+        return CPU_OP_AUIPC_ADDI;
+      if (b->op == CPU_OP_LW && b->rs1 == a->rd)
+        return CPU_OP_AUIPC_LW;
+      if (b->op == CPU_OP_SW && b->rs1 == a->rd)
+        return CPU_OP_AUIPC_SW;
       break;
-    case 5: /* LHU */
-      memStatus = memRead16(addr, &tmp16);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = (t_cpuURegValue)tmp16;
+    case CPU_OP_ADDI:
+      if (a->rs1 == CPU_REG_ZERO && b->op == CPU_OP_MUL &&
+          (b->rs1 == a->rd || b->rs2 == a->rd))
+        return CPU_OP_ADDI_MUL;
       break;
-    default:
-      return CPU_STATUS_ILL_INST_FAULT;
+    case CPU_OP_SLT:
+    case CPU_OP_SLTU:
+      if ((b->op != CPU_OP_BEQ && b->op != CPU_OP_BNE) ||
+          b->rs1 != a->rd || b->rs2 != CPU_REG_ZERO)
+        break;
+      if (a->op == CPU_OP_SLT)
+        return b->op == CPU_OP_BEQ ? CPU_OP_SLT_BEQ : CPU_OP_SLT_BNE;
+      return b->op == CPU_OP_BEQ ? CPU_OP_SLTU_BEQ : CPU_OP_SLTU_BNE;
   }
+  return a->op;
+}
 
-  cpuPC += 4;
-  return CPU_STATUS_OK;
+
+/* Fetches the instruction at pc, translating it if it is compressed. An
+ * invalid compressed instruction is translated to an illegal one. */
+static t_memError cpuFetchInst(t_simContext *ctx, t_memAddress pc,
+    uint32_t *out, uint8_t *outLength)
+{
+  uint32_t instr;
+  uint16_t low;
+  // a compressed instruction may be right at the end of an area
+  if (memFetch32(ctx, pc, &instr) != MEM_NO_ERROR) {
+    if (memFetch16(ctx, pc, &low) != MEM_NO_ERROR ||
+        !ISA_INST_IS_COMPRESSED(low))
+      return MEM_MAPPING_ERROR;
+    instr = low;
+  }
+  *outLength = (uint8_t)ISA_INST_LENGTH(instr);
+  if (!ISA_INST_IS_COMPRESSED(instr))
+    *out = instr;
+  else if (!isaExpandCompressed((uint16_t)instr, out))
+    *out = 0;
+  return MEM_NO_ERROR;
 }
 
-t_cpuStatus cpuExecuteOPIMM(uint32_t instr)
+
+/* Tries to fuse the instruction in entry with the one following it. Pairs
+ * are never fused across pages. */
+static void cpuDecodeFused(t_simContext *ctx, t_cpuDecodedInst *entry)
 {
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
+  entry->fusedOp = entry->op;
+  entry->fusedLength = entry->length;
+  t_memAddress nextPC = entry->pc + entry->length;
+  uint32_t nextInst;
+  uint8_t nextLength;
+  if (cpuFetchInst(ctx, nextPC, &nextInst, &nextLength) != MEM_NO_ERROR)
+    return;
+  t_memAddress nextEnd = nextPC + nextLength - 1;
+  if ((nextEnd >> CPU_CODE_PAGE_BITS) != (entry->pc >> CPU_CODE_PAGE_BITS))
+    return;
+  t_cpuDecodedInst next;
+  cpuDecode(nextInst, &next);
+  t_cpuOp fusedOp = cpuFuse(entry, &next);
+  if (fusedOp == entry->op)
+    return;
+  entry->fusedOp = fusedOp;
+  entry->fusedRd = next.rd;
+  entry->fusedRs1 = next.rs1;
+  entry->fusedRs2 = next.rs2;
+  entry->fusedImm = next.imm;
+  entry->fusedLength = entry->length + nextLength;
+  // branch offsets are made relative to the first instruction
+  if (next.op == CPU_OP_BEQ || next.op == CPU_OP_BNE)
+    entry->fusedImm += entry->length;
+}
 
-  switch (ISA_INST_FUNCT3(instr)) {
-    case 0: /* ADDI */
-      cpuRegs[rd] = cpuRegs[rs1] + ISA_INST_I_IMM12_SEXT(instr);
-      break;
-    case 1: /* SLLI */
-      if (ISA_INST_FUNCT7(instr) == 0x00)
-        cpuRegs[rd] = cpuRegs[rs1] << (ISA_INST_I_IMM12(instr) & 0x1F);
-      else
-        return CPU_STATUS_ILL_INST_FAULT;
-      break;
-    case 2: /* SLTI */
-      cpuRegs[rd] = ((t_cpuSRegValue)cpuRegs[rs1]) <
-          ((t_cpuSRegValue)ISA_INST_I_IMM12_SEXT(instr));
-      break;
-    case 3: /* SLTIU */
-      cpuRegs[rd] = cpuRegs[rs1] < ISA_INST_I_IMM12(instr);
-      break;
-    case 4: /* XORI */
-      cpuRegs[rd] = cpuRegs[rs1] ^ ISA_INST_I_IMM12_SEXT(instr);
-      break;
-    case 5: /* SRLI / SRAI */
-      if (ISA_INST_FUNCT7(instr) == 0x00)
-        cpuRegs[rd] = cpuRegs[rs1] >> (ISA_INST_I_IMM12(instr) & 0x1F);
-      else if (ISA_INST_FUNCT7(instr) == 0x20)
-        cpuRegs[rd] = SRA(cpuRegs[rs1], (ISA_INST_I_IMM12(instr) & 0x1F));
-      else
-        return CPU_STATUS_ILL_INST_FAULT;
-      break;
-    case 6: /* ORI */
-      cpuRegs[rd] = cpuRegs[rs1] | ISA_INST_I_IMM12_SEXT(instr);
-      break;
-    case 7: /* ANDI */
-      cpuRegs[rd] = cpuRegs[rs1] & ISA_INST_I_IMM12_SEXT(instr);
-      break;
+
+static t_cpuStatus cpuFetch(
+    t_simContext *ctx, t_memAddress pc, t_cpuDecodedInst **out)
+{
+  t_cpuState *cpu = ctx->cpu;
+  t_cpuDecodedInst *entry;
+
+  if ((pc & 1) == 0) {
+    entry = &cpu->decodeCache[CPU_DCACHE_INDEX(pc)];
+    if (entry->pc == pc && entry->op != CPU_OP_NONE) {
+      *out = entry;
+      return CPU_STATUS_OK;
+    }
+  } else {
+    entry = &cpu->uncached;
   }
 
-  cpuPC += 4;
+  uint32_t nextInst;
+  uint8_t length;
+  t_memError fetchErr = cpuFetchInst(ctx, pc, &nextInst, &length);
+  if (fetchErr != MEM_NO_ERROR)
+    return CPU_STATUS_MEMORY_FAULT;
+  if (entry != &cpu->uncached) {
+    if (cpu->decodeInBlock[CPU_DCACHE_INDEX(pc)])
+      cpuFlushBlocks(cpu);
+    // the instruction may end in the following page
+    cpuMarkCodePage(cpu, pc);
+    cpuMarkCodePage(cpu, pc + length - 1);
+  }
+  cpuDecode(nextInst, entry);
+  entry->pc = pc;
+  entry->length = length;
+  if (entry != &cpu->uncached) {
+    cpuDecodeFused(ctx, entry);
+  } else {
+    entry->fusedOp = entry->op;
+    entry->fusedLength = length;
+  }
+  *out = entry;
   return CPU_STATUS_OK;
 }
 
-t_cpuStatus cpuExecuteAUIPC(uint32_t instr)
+
+static bool cpuIsBlockEnd(t_cpuOp op)
 {
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  cpuRegs[rd] = cpuPC + (ISA_INST_U_IMM20(instr) << 12);
-  cpuPC += 4;
-  return CPU_STATUS_OK;
+  return (op >= CPU_OP_BEQ && op <= CPU_OP_JAL) || op == CPU_OP_ECALL ||
+      op == CPU_OP_EBREAK || op == CPU_OP_ILLEGAL;
 }
 
-t_cpuStatus cpuExecuteSTORE(uint32_t instr)
+
+static t_cpuBlock *cpuTranslateBlock(t_simContext *ctx, t_memAddress pc)
 {
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  t_cpuRegID rs2 = ISA_INST_RS2(instr);
-  t_memAddress addr = cpuRegs[rs1] + ISA_INST_S_IMM12_SEXT(instr);
+  t_cpuState *cpu = ctx->cpu;
+  t_cpuDecodedInst *insts[CPU_BLOCK_MAX_LENGTH];
+  uint32_t length = 0;
+  t_memAddress nextPC = pc;
 
-  t_memError memStatus;
-  switch (ISA_INST_FUNCT3(instr)) {
-    case 0: /* SB */
-      memStatus = memWrite8(addr, cpuRegs[rs2] & 0xFF);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
+  while (length < CPU_BLOCK_MAX_LENGTH) {
+    if (cpuFetch(ctx, nextPC, &insts[length]) != CPU_STATUS_OK)
       break;
-    case 1: /* SH */
-      memStatus = memWrite16(addr, cpuRegs[rs2] & 0xFFFF);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
+    nextPC += insts[length]->length;
+    if (cpuIsBlockEnd(insts[length++]->op))
       break;
-    case 2: /* SW */
-      memStatus = memWrite32(addr, cpuRegs[rs2]);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
-      break;
-    default:
-      return CPU_STATUS_ILL_INST_FAULT;
   }
+  if (length == 0)
+    return NULL;
 
-  cpuPC += 4;
-  return CPU_STATUS_OK;
+  t_cpuBlock *block = malloc(
+      sizeof(t_cpuBlock) + sizeof(t_cpuDecodedInst) * (length + 1));
+  if (!block)
+    return NULL;
+  block->succ[0] = block->succ[1] = NULL;
+  block->succPC[0] = block->succPC[1] = 0;
+  block->length = length;
+  for (uint32_t i = 0; i < length; i++) {
+    block->insts[i] = *insts[i];
+    cpu->decodeInBlock[CPU_DCACHE_INDEX(insts[i]->pc)] = 1;
+  }
+  // the second instruction of a pair fused with the last one is outside
+  block->insts[length - 1].fusedOp = block->insts[length - 1].op;
+  block->insts[length - 1].fusedLength = block->insts[length - 1].length;
+  block->insts[length].pc = nextPC;
+  block->insts[length].op = block->insts[length].fusedOp = CPU_OP_NONE;
+
+  block->next = cpu->blocks;
+  cpu->blocks = block;
+  return block;
 }
 
-t_cpuStatus cpuExecuteOP(uint32_t instr)
-{
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  t_cpuRegID rs2 = ISA_INST_RS2(instr);
 
-  if (ISA_INST_FUNCT7(instr) == 0x00) {
-    switch (ISA_INST_FUNCT3(instr)) {
-      case 0: /* ADD */
-        cpuRegs[rd] = cpuRegs[rs1] + cpuRegs[rs2];
-        break;
-      case 1: /* SLL */
-        cpuRegs[rd] = cpuRegs[rs1] << (cpuRegs[rs2] & 0x1F);
-        break;
-      case 2: /* SLT */
-        cpuRegs[rd] =
-            ((t_cpuSRegValue)cpuRegs[rs1]) < ((t_cpuSRegValue)cpuRegs[rs2]);
-        break;
-      case 3: /* SLTU */
-        cpuRegs[rd] = cpuRegs[rs1] < cpuRegs[rs2];
-        break;
-      case 4: /* XOR */
-        cpuRegs[rd] = cpuRegs[rs1] ^ cpuRegs[rs2];
-        break;
-      case 5: /* SRL */
-        cpuRegs[rd] = cpuRegs[rs1] >> (cpuRegs[rs2] & 0x1F);
-        break;
-      case 6: /* OR */
-        cpuRegs[rd] = cpuRegs[rs1] | cpuRegs[rs2];
-        break;
-      case 7: /* AND */
-        cpuRegs[rd] = cpuRegs[rs1] & cpuRegs[rs2];
-        break;
-    }
-  } else if (ISA_INST_FUNCT7(instr) == 0x20) {
-    switch (ISA_INST_FUNCT3(instr)) {
-      case 0: /* SUB */
-        cpuRegs[rd] = cpuRegs[rs1] - cpuRegs[rs2];
-        break;
-      case 1:
-      case 2:
-      case 3:
-      case 4:
-        return CPU_STATUS_ILL_INST_FAULT;
-      case 5: /* SRA */
-        cpuRegs[rd] = SRA(cpuRegs[rs1], (cpuRegs[rs2] & 0x1F));
-        break;
-      case 6:
-      case 7:
-        return CPU_STATUS_ILL_INST_FAULT;
-    }
-  } else if (ISA_INST_FUNCT7(instr) == 0x01) {
-    switch (ISA_INST_FUNCT3(instr)) {
-      case 0: /* MUL */
-        cpuRegs[rd] = cpuRegs[rs1] * cpuRegs[rs2];
-        break;
-      case 1: /* MULH */
-        cpuRegs[rd] = (uint32_t)(((int64_t)((int32_t)cpuRegs[rs1]) *
-                                     (int64_t)((int32_t)cpuRegs[rs2])) >>
-            32);
-        break;
-      case 2: /* MULHSU */
-        cpuRegs[rd] = (uint32_t)(((int64_t)((int32_t)cpuRegs[rs1]) *
-                                     (int64_t)(cpuRegs[rs2])) >>
-            32);
-        break;
-      case 3: /* MULHU */
-        cpuRegs[rd] = (t_cpuURegValue)(((uint64_t)(cpuRegs[rs1]) *
-                                           (uint64_t)(cpuRegs[rs2])) >>
-            32);
-        break;
-      case 4: /* DIV */
-        if (cpuRegs[rs2] == 0)
-          cpuRegs[rd] = 0xFFFFFFFF;
-        else if (cpuRegs[rs1] == 0x80000000 && cpuRegs[rs2] == 0xFFFFFFFF)
-          cpuRegs[rd] = 0x80000000;
-        else
-          cpuRegs[rd] = (t_cpuURegValue)((t_cpuSRegValue)cpuRegs[rs1] /
-              (t_cpuSRegValue)cpuRegs[rs2]);
-        break;
-      case 5: /* DIVU */
-        if (cpuRegs[rs2] == 0)
-          cpuRegs[rd] = 0xFFFFFFFF;
-        else
-          cpuRegs[rd] = cpuRegs[rs1] / cpuRegs[rs2];
-        break;
-      case 6: /* REM */
-        if (cpuRegs[rs2] == 0)
-          cpuRegs[rd] = cpuRegs[rs1];
-        else if (cpuRegs[rs1] == 0x80000000 && cpuRegs[rs2] == 0xFFFFFFFF)
-          cpuRegs[rd] = 0;
-        else
-          cpuRegs[rd] = (t_cpuURegValue)((t_cpuSRegValue)cpuRegs[rs1] %
-              (t_cpuSRegValue)cpuRegs[rs2]);
-        break;
-      case 7: /* REMU */
-        if (cpuRegs[rs2] == 0)
-          cpuRegs[rd] = cpuRegs[rs1];
-        else
-          cpuRegs[rd] = cpuRegs[rs1] % cpuRegs[rs2];
-        break;
-    }
-  } else {
-    return CPU_STATUS_ILL_INST_FAULT;
+static t_cpuBlock *cpuLookupBlock(t_simContext *ctx, t_memAddress pc)
+{
+  t_cpuState *cpu = ctx->cpu;
+  if (pc & 1)
+    return NULL;
+  t_cpuBlockTableEntry *entry = &cpu->blockTable[CPU_BLOCK_TABLE_INDEX(pc)];
+  if (entry->pc != pc) {
+    if (entry->block)
+      return NULL;
+    entry->pc = pc;
+    entry->heat = 0;
   }
+  if (entry->block || ++entry->heat < CPU_BLOCK_HOT_THRESHOLD)
+    return entry->block;
+  entry->block = cpuTranslateBlock(ctx, pc);
+  if (!entry->block)
+    entry->heat = 0;
+  return entry->block;
+}
 
-  cpuPC += 4;
-  return CPU_STATUS_OK;
+
+/* Address of the instruction making a transfer of control or a memory
+ * access in the handler of inst: the second one when inst is the first of a
+ * fused pair, since no first instruction of a pair can make them */
+static inline t_memAddress cpuEffectivePC(const t_cpuDecodedInst *inst)
+{
+  return inst->pc + (inst->fusedOp != inst->op ? inst->length : 0);
 }
 
-t_cpuStatus cpuExecuteLUI(uint32_t instr)
+
+/* Records the instruction retired before inst, and starts the record of
+ * inst */
+static inline void cpuTraceInst(
+    t_traceState *trace, t_cpuState *cpu, const t_cpuDecodedInst *inst)
 {
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  cpuRegs[rd] = ISA_INST_U_IMM20(instr) << 12;
-  cpuPC += 4;
-  return CPU_STATUS_OK;
+  uint8_t reg = inst->rd == CPU_REG_SINK ? TRACE_NO_REG : inst->rd;
+  uint8_t rs2 = 0;
+  traceRetire(trace, cpu->regs);
+  if (inst->op >= CPU_OP_SB && inst->op <= CPU_OP_SW) {
+    reg = TRACE_NO_REG;
+    rs2 = inst->rs2;
+  } else if ((inst->op >= CPU_OP_BEQ && inst->op <= CPU_OP_BGEU) ||
+      inst->op == CPU_OP_EBREAK || inst->op == CPU_OP_ILLEGAL) {
+    reg = TRACE_NO_REG;
+  } else if (inst->op == CPU_OP_ECALL) {
+    /* the result of the call, written by the supervisor */
+    reg = CPU_REG_A0;
+  }
+  traceBegin(trace, inst->pc, reg, rs2);
 }
 
-t_cpuStatus cpuExecuteBRANCH(uint32_t instr)
+
+/* The interpreter loop. With GCC-compatible compilers every handler jumps
+ * directly to the handler of the next instruction through a table of label
+ * addresses (direct threading); otherwise a plain switch is used.
+ *   The semantics of the operations are in cpu_ops.h, which is instantiated
+ * twice: once for instructions fetched from the decode cache, and once for
+ * instructions in translated blocks. */
+#if defined(__GNUC__)
+#define CPU_THREADED_DISPATCH
+#endif
+
+#define CPU_OP_LABELS(p) \
+  [CPU_OP_LB] = &&p##CPU_OP_LB, [CPU_OP_LH] = &&p##CPU_OP_LH, \
+  [CPU_OP_LW] = &&p##CPU_OP_LW, [CPU_OP_LBU] = &&p##CPU_OP_LBU, \
+  [CPU_OP_LHU] = &&p##CPU_OP_LHU, [CPU_OP_ADDI] = &&p##CPU_OP_ADDI, \
+  [CPU_OP_SLLI] = &&p##CPU_OP_SLLI, [CPU_OP_SLTI] = &&p##CPU_OP_SLTI, \
+  [CPU_OP_SLTIU] = &&p##CPU_OP_SLTIU, [CPU_OP_XORI] = &&p##CPU_OP_XORI, \
+  [CPU_OP_SRLI] = &&p##CPU_OP_SRLI, [CPU_OP_SRAI] = &&p##CPU_OP_SRAI, \
+  [CPU_OP_ORI] = &&p##CPU_OP_ORI, [CPU_OP_ANDI] = &&p##CPU_OP_ANDI, \
+  [CPU_OP_AUIPC] = &&p##CPU_OP_AUIPC, [CPU_OP_SB] = &&p##CPU_OP_SB, \
+  [CPU_OP_SH] = &&p##CPU_OP_SH, [CPU_OP_SW] = &&p##CPU_OP_SW, \
+  [CPU_OP_ADD] = &&p##CPU_OP_ADD, [CPU_OP_SLL] = &&p##CPU_OP_SLL, \
+  [CPU_OP_SLT] = &&p##CPU_OP_SLT, [CPU_OP_SLTU] = &&p##CPU_OP_SLTU, \
+  [CPU_OP_XOR] = &&p##CPU_OP_XOR, [CPU_OP_SRL] = &&p##CPU_OP_SRL, \
+  [CPU_OP_OR] = &&p##CPU_OP_OR, [CPU_OP_AND] = &&p##CPU_OP_AND, \
+  [CPU_OP_SUB] = &&p##CPU_OP_SUB, [CPU_OP_SRA] = &&p##CPU_OP_SRA, \
+  [CPU_OP_MUL] = &&p##CPU_OP_MUL, [CPU_OP_MULH] = &&p##CPU_OP_MULH, \
+  [CPU_OP_MULHSU] = &&p##CPU_OP_MULHSU, [CPU_OP_MULHU] = &&p##CPU_OP_MULHU, \
+  [CPU_OP_DIV] = &&p##CPU_OP_DIV, [CPU_OP_DIVU] = &&p##CPU_OP_DIVU, \
+  [CPU_OP_REM] = &&p##CPU_OP_REM, [CPU_OP_REMU] = &&p##CPU_OP_REMU, \
+  [CPU_OP_LUI] = &&p##CPU_OP_LUI, [CPU_OP_BEQ] = &&p##CPU_OP_BEQ, \
+  [CPU_OP_BNE] = &&p##CPU_OP_BNE, [CPU_OP_BLT] = &&p##CPU_OP_BLT, \
+  [CPU_OP_BGE] = &&p##CPU_OP_BGE, [CPU_OP_BLTU] = &&p##CPU_OP_BLTU, \
+  [CPU_OP_BGEU] = &&p##CPU_OP_BGEU, [CPU_OP_JALR] = &&p##CPU_OP_JALR, \
+  [CPU_OP_JAL] = &&p##CPU_OP_JAL, [CPU_OP_ECALL] = &&p##CPU_OP_ECALL, \
+  [CPU_OP_EBREAK] = &&p##CPU_OP_EBREAK, \
+  [CPU_OP_ILLEGAL] = &&p##CPU_OP_ILLEGAL, \
+  [CPU_OP_LUI_ADDI] = &&p##CPU_OP_LUI_ADDI, \
+  [CPU_OP_AUIPC_ADDI] = &&p##CPU_OP_AUIPC_ADDI, \
+  [CPU_OP_AUIPC_LW] = &&p##CPU_OP_AUIPC_LW, \
+  [CPU_OP_AUIPC_SW] = &&p##CPU_OP_AUIPC_SW, \
+  [CPU_OP_ADDI_MUL] = &&p##CPU_OP_ADDI_MUL, \
+  [CPU_OP_SLT_BEQ] = &&p##CPU_OP_SLT_BEQ, \
+  [CPU_OP_SLT_BNE] = &&p##CPU_OP_SLT_BNE, \
+  [CPU_OP_SLTU_BEQ] = &&p##CPU_OP_SLTU_BEQ, \
+  [CPU_OP_SLTU_BNE] = &&p##CPU_OP_SLTU_BNE
+
+#ifdef CPU_THREADED_DISPATCH
+#define CPU_DISPATCH(dispOp) goto *handlers[dispOp]
+#define CPU_MONITOR_DISPATCH(dispOp) \
+  goto *monitorHandlers[CPU_MONITOR_OP(dispOp)]
+#define CPU_BLOCK_DISPATCH() goto *blockHandlers[inst->fusedOp]
+#else
+#define CPU_DISPATCH(dispOp) \
+  do {                       \
+    op = (dispOp);           \
+    goto dispatch;           \
+  } while (0)
+#define CPU_MONITOR_DISPATCH(dispOp) CPU_DISPATCH(CPU_MONITOR_OP(dispOp))
+#define CPU_BLOCK_DISPATCH() goto blockDispatch
+#endif
+
+#define CPU_FETCH_AND_DISPATCH_WITH(fetched, dispatch) \
+  do {                                            \
+    if (remaining == 0)                           \
+      goto exit;                                  \
+    remaining--;                                  \
+    inst = &cpu->decodeCache[CPU_DCACHE_INDEX(cpu->pc)]; \
+    if (inst->pc != cpu->pc || inst->op == CPU_OP_NONE) { \
+      status = cpuFetch(ctx, cpu->pc, &inst);            \
+      if (status != CPU_STATUS_OK)                \
+        goto exit;                                \
+    }                                             \
+    fetched;                                      \
+    dispatch(inst->fusedOp);                      \
+  } while (0)
+
+/* Moves the pc past an instruction, or a fused pair, whose length is most
+ * likely the usual one. The branch is always predicted in code without
+ * compressed instructions, and unlike an addition of the length it does not
+ * make the next fetch wait for the load of the decode cache entry. */
+#define CPU_ADVANCE(length, usual)                \
+  do {                                            \
+    if ((length) == (usual))                      \
+      cpu->pc += (usual);                         \
+    else                                          \
+      cpu->pc += (length);                        \
+  } while (0)
+
+/* Hooks of the profiler, of the cache model and of the trace recorder. With
+ * threaded dispatch they are only in a separate copy of the handlers, which
+ * is used when one of them is enabled, so that they cost nothing otherwise.
+ * With a switch every handler checks if they are enabled. Traces record
+ * every instruction, so fused pairs are executed separately while tracing. */
+#define CPU_MONITOR_OP(dispOp) (ctx->trace ? inst->op : (dispOp))
+#define CPU_MONITOR_FETCH(pc)                    \
+  do {                                           \
+    if (ctx->cache)                              \
+      cacheFetch(ctx, pc);                       \
+  } while (0)
+#define CPU_MONITOR_STEP()                       \
+  do {                                           \
+    CPU_MONITOR_FETCH(cpu->pc);                  \
+    if (ctx->trace)                              \
+      cpuTraceInst(ctx->trace, cpu, inst);       \
+  } while (0)
+#define CPU_MONITOR_JUMP(addr)                   \
+  do {                                           \
+    if (ctx->prof)                               \
+      profCountJump(ctx->prof, cpuEffectivePC(inst), addr); \
+  } while (0)
+#define CPU_MONITOR_ACCESS(addr, size, isStore)  \
+  do {                                           \
+    if (ctx->cache)                              \
+      cacheAccess(ctx, cpuEffectivePC(inst), addr, size, isStore); \
+    if (ctx->trace)                              \
+      traceAccess(ctx->trace, addr, size, isStore); \
+  } while (0)
+
+#ifdef CPU_THREADED_DISPATCH
+#define CPU_FETCH_AND_DISPATCH() \
+  CPU_FETCH_AND_DISPATCH_WITH((void)0, CPU_DISPATCH)
+#define CPU_MONITOR(hook)
+#else
+#define CPU_FETCH_AND_DISPATCH() \
+  CPU_FETCH_AND_DISPATCH_WITH(CPU_MONITOR_STEP(), CPU_MONITOR_DISPATCH)
+#define CPU_MONITOR(hook) hook
+#endif
+
+/* Gives back the budget of the instructions of the current block which
+ * follow the current one */
+#define CPU_BLOCK_REFUND() \
+  (remaining += (uint32_t)(block->insts + block->length - inst - 1))
+
+#define RD cpu->regs[inst->rd]
+#define RS1 cpu->regs[inst->rs1]
+#define RS2 cpu->regs[inst->rs2]
+#define IMM inst->imm
+#define ADDR (RS1 + IMM)
+#define FRD cpu->regs[inst->fusedRd]
+#define FRS1 cpu->regs[inst->fusedRs1]
+#define FRS2 cpu->regs[inst->fusedRs2]
+#define FIMM inst->fusedImm
+#define FADDR (FRS1 + FIMM)
+#define LENGTH inst->length
+
+t_cpuStatus cpuRun(t_simContext *ctx, uint32_t maxInstrs)
 {
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  t_cpuRegID rs2 = ISA_INST_RS2(instr);
-  t_cpuSRegValue offs = (t_cpuSRegValue)ISA_INST_B_IMM13_SEXT(instr);
-  bool taken = 0;
+#ifdef CPU_THREADED_DISPATCH
+  static const void *const handlers[] = {
+      [CPU_OP_NONE] = &&H_CPU_OP_ILLEGAL, CPU_OP_LABELS(H_)};
+  static const void *const blockHandlers[] = {
+      [CPU_OP_NONE] = &&B_CPU_OP_NONE, CPU_OP_LABELS(B_)};
+  static const void *const monitorHandlers[] = {
+      [CPU_OP_NONE] = &&M_CPU_OP_ILLEGAL, CPU_OP_LABELS(M_)};
+#endif
+  t_cpuState *cpu = ctx->cpu;
+  uint32_t remaining = maxInstrs;
+  t_cpuStatus status = cpu->lastStatus;
+  t_cpuDecodedInst *inst;
+  t_cpuBlock *block, *prevBlock;
+#ifndef CPU_THREADED_DISPATCH
+  t_cpuOp op;
+#endif
+  uint8_t tmp8;
+  uint16_t tmp16;
+  uint32_t tmp32;
 
-  switch (ISA_INST_FUNCT3(instr)) {
-    case 0: /* BEQ */
-      taken = cpuRegs[rs1] == cpuRegs[rs2];
-      break;
-    case 1: /* BNE */
-      taken = cpuRegs[rs1] != cpuRegs[rs2];
-      break;
-    case 4: /* BLT */
-      taken = (t_cpuSRegValue)cpuRegs[rs1] < (t_cpuSRegValue)cpuRegs[rs2];
-      break;
-    case 5: /* BGE */
-      taken = (t_cpuSRegValue)cpuRegs[rs1] >= (t_cpuSRegValue)cpuRegs[rs2];
-      break;
-    case 6: /* BLTU */
-      taken = cpuRegs[rs1] < cpuRegs[rs2];
-      break;
-    case 7: /* BGEU */
-      taken = cpuRegs[rs1] >= cpuRegs[rs2];
-      break;
+  if (status != CPU_STATUS_OK)
+    return status;
+  cpuFreeStaleBlocks(cpu);
+  if (cpu->blocksEnabled)
+    goto blockEnter;
+  if (ctx->prof)
+    profCountResume(ctx->prof, cpu->pc);
+#ifdef CPU_THREADED_DISPATCH
+  if (ctx->prof || ctx->cache || ctx->trace)
+    goto monitorEnter;
+#endif
+
+  /* Execution from the decode cache */
+#ifdef CPU_THREADED_DISPATCH
+#define CPU_HANDLER(op) H_##op
+#define CPU_CONTINUE() CPU_FETCH_AND_DISPATCH()
+#define CPU_SPLIT_DISPATCH(dispOp) CPU_DISPATCH(dispOp)
+#else
+#define CPU_HANDLER(op) case op
+#define CPU_CONTINUE() goto next
+#define CPU_SPLIT_DISPATCH(dispOp) CPU_DISPATCH(dispOp)
+#endif
+#define PC cpu->pc
+#define NEXT()                  \
+  do {                          \
+    CPU_ADVANCE(inst->length, 4); \
+    CPU_CONTINUE();             \
+  } while (0)
+#define JUMP(addr)              \
+  do {                          \
+    cpu->pc = (addr);             \
+    CPU_MONITOR(CPU_MONITOR_JUMP(cpu->pc)); \
+    if (cpu->blocksEnabled)       \
+      goto blockEnter;          \
+    CPU_CONTINUE();             \
+  } while (0)
+#define STORED(addr, size)      \
+  do {                          \
+    cpuNotifyStore(cpu, addr, size); \
+    NEXT();                     \
+  } while (0)
+#define MEM_ACCESS(addr, size, isStore) \
+  CPU_MONITOR(CPU_MONITOR_ACCESS(addr, size, isStore))
+#define MEM_FAULT() goto memFault
+#define TRAP(trapStatus)        \
+  do {                          \
+    status = (trapStatus);      \
+    goto exit;                  \
+  } while (0)
+#define FUSED()                 \
+  do {                          \
+    if (remaining == 0)         \
+      CPU_SPLIT_DISPATCH(inst->op); \
+    remaining--;                \
+    CPU_MONITOR(CPU_MONITOR_FETCH(inst->pc + inst->length)); \
+  } while (0)
+#define FUSED_NEXT()            \
+  do {                          \
+    CPU_ADVANCE(inst->fusedLength, 8); \
+    CPU_CONTINUE();             \
+  } while (0)
+#define FUSED_STORED(addr, size) \
+  do {                          \
+    cpuNotifyStore(cpu, addr, size); \
+    FUSED_NEXT();               \
+  } while (0)
+#define FUSED_MEM_FAULT()       \
+  do {                          \
+    cpu->pc += inst->length;      \
+    goto memFault;              \
+  } while (0)
+
+#ifndef CPU_THREADED_DISPATCH
+next:
+#endif
+  CPU_FETCH_AND_DISPATCH();
+#ifndef CPU_THREADED_DISPATCH
+dispatch:
+  switch (op) {
+#endif
+#include "cpu_ops.h"
+#ifndef CPU_THREADED_DISPATCH
     default:
-      return CPU_STATUS_ILL_INST_FAULT;
+      TRAP(CPU_STATUS_ILL_INST_FAULT);
   }
+#endif
 
-  cpuPC += taken ? (t_cpuURegValue)offs : 4;
-  return CPU_STATUS_OK;
-}
+  /* Execution from the decode cache with the profiler, the cache model or
+   * the trace recorder enabled */
+#ifdef CPU_THREADED_DISPATCH
+#undef CPU_HANDLER
+#undef CPU_CONTINUE
+#undef CPU_SPLIT_DISPATCH
+#undef CPU_MONITOR
+#define CPU_HANDLER(op) M_##op
+#define CPU_CONTINUE()                                  \
+  CPU_FETCH_AND_DISPATCH_WITH(                          \
+      CPU_MONITOR_STEP(), CPU_MONITOR_DISPATCH)
+#define CPU_SPLIT_DISPATCH(dispOp) CPU_MONITOR_DISPATCH(dispOp)
+#define CPU_MONITOR(hook) hook
 
-t_cpuStatus cpuExecuteJALR(uint32_t instr)
-{
-  t_cpuSRegValue offs = (t_cpuSRegValue)ISA_INST_I_IMM12_SEXT(instr);
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  if (ISA_INST_FUNCT3(instr) != 0)
-    return CPU_STATUS_ILL_INST_FAULT;
-  cpuRegs[rd] = cpuPC + 4;
-  // clear bit zero as suggested by the spec
-  cpuPC = (cpuRegs[rs1] + (t_cpuURegValue)offs) & ~(t_cpuURegValue)1;
-  return CPU_STATUS_OK;
-}
+monitorEnter:
+  CPU_CONTINUE();
+#include "cpu_ops.h"
+#endif
 
-t_cpuStatus cpuExecuteJAL(uint32_t instr)
-{
-  t_cpuSRegValue offs = (t_cpuSRegValue)ISA_INST_J_IMM21_SEXT(instr);
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  cpuRegs[rd] = cpuPC + 4;
-  cpuPC += (t_cpuURegValue)offs;
-  return CPU_STATUS_OK;
+#undef CPU_HANDLER
+#undef CPU_CONTINUE
+#undef CPU_SPLIT_DISPATCH
+#undef NEXT
+#undef PC
+#undef JUMP
+#undef STORED
+#undef MEM_ACCESS
+#undef MEM_FAULT
+#undef TRAP
+#undef FUSED
+#undef FUSED_NEXT
+#undef FUSED_STORED
+#undef FUSED_MEM_FAULT
+
+  /* Execution of translated blocks */
+#ifdef CPU_THREADED_DISPATCH
+#define CPU_HANDLER(op) B_##op
+#else
+#define CPU_HANDLER(op) case op
+#endif
+#define PC inst->pc
+#define NEXT()                  \
+  do {                          \
+    inst++;                     \
+    CPU_BLOCK_DISPATCH();       \
+  } while (0)
+#define JUMP(addr)              \
+  do {                          \
+    cpu->pc = (addr);             \
+    goto blockExit;             \
+  } while (0)
+#define STORED(addr, size)      \
+  do {                          \
+    if (cpuNotifyStore(cpu, addr, size)) { \
+      cpu->pc = PC + inst->length; \
+      CPU_BLOCK_REFUND();       \
+      goto blockEnter;          \
+    }                           \
+    NEXT();                     \
+  } while (0)
+#define MEM_ACCESS(addr, size, isStore)
+#define MEM_FAULT()             \
+  do {                          \
+    cpu->pc = PC;                 \
+    CPU_BLOCK_REFUND();         \
+    goto memFault;              \
+  } while (0)
+#define TRAP(trapStatus)        \
+  do {                          \
+    cpu->pc = PC;                 \
+    CPU_BLOCK_REFUND();         \
+    status = (trapStatus);      \
+    goto exit;                  \
+  } while (0)
+#define FUSED()
+#define FUSED_NEXT()            \
+  do {                          \
+    inst += 2;                  \
+    CPU_BLOCK_DISPATCH();       \
+  } while (0)
+#define FUSED_STORED(addr, size) \
+  do {                          \
+    if (cpuNotifyStore(cpu, addr, size)) { \
+      cpu->pc = PC + inst->fusedLength; \
+      inst++;                   \
+      CPU_BLOCK_REFUND();       \
+      goto blockEnter;          \
+    }                           \
+    FUSED_NEXT();               \
+  } while (0)
+#define FUSED_MEM_FAULT()       \
+  do {                          \
+    cpu->pc = PC + inst->length;  \
+    inst++;                     \
+    CPU_BLOCK_REFUND();         \
+    goto memFault;              \
+  } while (0)
+
+blockEnter:
+  block = cpuLookupBlock(ctx, cpu->pc);
+blockChain:
+  if (!block || block->length > remaining)
+    CPU_FETCH_AND_DISPATCH();
+  remaining -= block->length;
+  inst = block->insts;
+  CPU_BLOCK_DISPATCH();
+
+#ifndef CPU_THREADED_DISPATCH
+blockDispatch:
+  switch (inst->fusedOp) {
+#endif
+#include "cpu_ops.h"
+    CPU_HANDLER(CPU_OP_NONE):
+      cpu->pc = inst->pc;
+      goto blockExit;
+#ifndef CPU_THREADED_DISPATCH
+  }
+#endif
+
+blockExit:
+  prevBlock = block;
+  if (prevBlock->succ[0] && prevBlock->succPC[0] == cpu->pc) {
+    block = prevBlock->succ[0];
+  } else if (prevBlock->succ[1] && prevBlock->succPC[1] == cpu->pc) {
+    block = prevBlock->succ[1];
+  } else {
+    block = cpuLookupBlock(ctx, cpu->pc);
+    if (block) {
+      int slot = prevBlock->succ[0] ? 1 : 0;
+      prevBlock->succPC[slot] = cpu->pc;
+      prevBlock->succ[slot] = block;
+    }
+  }
+  goto blockChain;
+
+#undef CPU_HANDLER
+#undef NEXT
+#undef PC
+#undef JUMP
+#undef STORED
+#undef MEM_ACCESS
+#undef MEM_FAULT
+#undef TRAP
+#undef FUSED
+#undef FUSED_NEXT
+#undef FUSED_STORED
+#undef FUSED_MEM_FAULT
+
+memFault:
+  status = CPU_STATUS_MEMORY_FAULT;
+exit:
+  if (ctx->prof)
+    profCountStop(ctx->prof, cpu->pc, status == CPU_STATUS_ECALL_TRAP);
+  /* the instruction which caused a fault has not been executed */
+  if (ctx->trace && status != CPU_STATUS_OK &&
+      status != CPU_STATUS_ECALL_TRAP && ctx->trace->pending.pc == cpu->pc)
+    ctx->trace->hasPending = false;
+  cpu->instrCount += maxInstrs - remaining;
+  cpu->lastStatus = status;
+  return status;
 }
 
-t_cpuStatus cpuExecuteSYSTEM(uint32_t instr)
+#undef RD
+#undef RS1
+#undef RS2
+#undef IMM
+#undef ADDR
+#undef FRD
+#undef FRS1
+#undef FRS2
+#undef FIMM
+#undef FADDR
+#undef LENGTH
+
+
+t_cpuStatus cpuTick(t_simContext *ctx)
 {
-  if (ISA_INST_FUNCT3(instr) != 0)
-    return CPU_STATUS_ILL_INST_FAULT;
-  if (ISA_INST_I_IMM12(instr) == 0)
-    return CPU_STATUS_ECALL_TRAP;
-  if (ISA_INST_I_IMM12(instr) == 1)
-    return CPU_STATUS_EBREAK_TRAP;
-  return CPU_STATUS_ILL_INST_FAULT;
+  return cpuRun(ctx, 1);
 }
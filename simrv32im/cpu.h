@@ -1,7 +1,9 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <stdbool.h>
 #include "isa.h"
+#include "context.h"
 
 typedef int t_cpuStatus;
 enum {
@@ -12,11 +14,30 @@ enum {
   CPU_STATUS_EBREAK_TRAP = -4
 };
 
-t_cpuURegValue cpuGetRegister(t_cpuRegID reg);
-void cpuSetRegister(t_cpuRegID reg, t_cpuURegValue value);
+typedef struct cpuState t_cpuState;
 
-void cpuReset(t_cpuURegValue pcValue);
-t_cpuStatus cpuTick(void);
-t_cpuStatus cpuClearLastFault(void);
+t_cpuState *newCPUState(void);
+void deleteCPUState(t_cpuState *cpu);
+
+t_cpuURegValue cpuGetRegister(t_simContext *ctx, t_cpuRegID reg);
+void cpuSetRegister(t_simContext *ctx, t_cpuRegID reg, t_cpuURegValue value);
+
+void cpuReset(t_simContext *ctx, t_cpuURegValue pcValue);
+t_cpuStatus cpuTick(t_simContext *ctx);
+t_cpuStatus cpuRun(t_simContext *ctx, uint32_t maxInstrs);
+t_cpuStatus cpuClearLastFault(t_simContext *ctx);
+/* Number of instructions executed since the last reset, including the ones
+ * which caused a trap or a fault */
+uint64_t cpuGetInstructionCount(t_simContext *ctx);
+void cpuSetInstructionCount(t_simContext *ctx, uint64_t count);
+/* Status of the last trap or fault, which is reported again by cpuRun until
+ * it is cleared */
+t_cpuStatus cpuGetLastStatus(t_simContext *ctx);
+
+void cpuSetBlockTranslation(t_simContext *ctx, bool enable);
+
+/* Reads the instruction at pc without side effects, for disassembling it.
+ * A compressed instruction is returned in the low 16 bits. */
+uint32_t cpuDebugReadInstruction(t_simContext *ctx, t_cpuURegValue pc);
 
 #endif
@@ -0,0 +1,266 @@
+/* Semantics of all the operations executed by the CPU.
+ *   This file is included by cpuRun() once for each execution mode, with
+ * the following macros defined:
+ *   CPU_HANDLER(op)  label of the code executing op
+ *   PC               address of the current instruction
+ *   LENGTH           size of the current instruction (2 if compressed)
+ *   NEXT()           continues with the instruction at PC + LENGTH
+ *   JUMP(addr)       continues with the instruction at addr
+ *   STORED(a, size)  notifies a store of size bytes at a, then does NEXT()
+ *   MEM_ACCESS(a, size, isStore)
+ *                    notifies a load or a store before it is made
+ *   MEM_FAULT()      stops execution with a memory fault
+ *   TRAP(status)     stops execution with the given trap or fault status
+ * Fused operations execute the current instruction and the next one. They
+ * start with FUSED(), and use FUSED_NEXT(), FUSED_STORED() and
+ * FUSED_MEM_FAULT() in place of NEXT(), STORED() and MEM_FAULT() for faults
+ * caused by the second instruction. */
+
+CPU_HANDLER(CPU_OP_LB):
+  MEM_ACCESS(ADDR, 1, false);
+  if (memRead8(ctx, ADDR, &tmp8) != MEM_NO_ERROR)
+    MEM_FAULT();
+  RD = (t_cpuURegValue)((t_cpuSRegValue)((int8_t)tmp8));
+  NEXT();
+CPU_HANDLER(CPU_OP_LH):
+  MEM_ACCESS(ADDR, 2, false);
+  if (memRead16(ctx, ADDR, &tmp16) != MEM_NO_ERROR)
+    MEM_FAULT();
+  RD = (t_cpuURegValue)((t_cpuSRegValue)((int16_t)tmp16));
+  NEXT();
+CPU_HANDLER(CPU_OP_LW):
+  MEM_ACCESS(ADDR, 4, false);
+  if (memRead32(ctx, ADDR, &tmp32) != MEM_NO_ERROR)
+    MEM_FAULT();
+  RD = tmp32;
+  NEXT();
+CPU_HANDLER(CPU_OP_LBU):
+  MEM_ACCESS(ADDR, 1, false);
+  if (memRead8(ctx, ADDR, &tmp8) != MEM_NO_ERROR)
+    MEM_FAULT();
+  RD = (t_cpuURegValue)tmp8;
+  NEXT();
+CPU_HANDLER(CPU_OP_LHU):
+  MEM_ACCESS(ADDR, 2, false);
+  if (memRead16(ctx, ADDR, &tmp16) != MEM_NO_ERROR)
+    MEM_FAULT();
+  RD = (t_cpuURegValue)tmp16;
+  NEXT();
+
+CPU_HANDLER(CPU_OP_ADDI):
+  RD = RS1 + IMM;
+  NEXT();
+CPU_HANDLER(CPU_OP_SLLI):
+  RD = RS1 << IMM;
+  NEXT();
+CPU_HANDLER(CPU_OP_SLTI):
+  RD = (t_cpuSRegValue)RS1 < (t_cpuSRegValue)IMM;
+  NEXT();
+CPU_HANDLER(CPU_OP_SLTIU):
+  RD = RS1 < IMM;
+  NEXT();
+CPU_HANDLER(CPU_OP_XORI):
+  RD = RS1 ^ IMM;
+  NEXT();
+CPU_HANDLER(CPU_OP_SRLI):
+  RD = RS1 >> IMM;
+  NEXT();
+CPU_HANDLER(CPU_OP_SRAI):
+  RD = SRA(RS1, IMM);
+  NEXT();
+CPU_HANDLER(CPU_OP_ORI):
+  RD = RS1 | IMM;
+  NEXT();
+CPU_HANDLER(CPU_OP_ANDI):
+  RD = RS1 & IMM;
+  NEXT();
+CPU_HANDLER(CPU_OP_AUIPC):
+  RD = PC + IMM;
+  NEXT();
+
+CPU_HANDLER(CPU_OP_SB):
+  MEM_ACCESS(ADDR, 1, true);
+  if (memWrite8(ctx, ADDR, RS2 & 0xFF) != MEM_NO_ERROR)
+    MEM_FAULT();
+  STORED(ADDR, 1);
+CPU_HANDLER(CPU_OP_SH):
+  MEM_ACCESS(ADDR, 2, true);
+  if (memWrite16(ctx, ADDR, RS2 & 0xFFFF) != MEM_NO_ERROR)
+    MEM_FAULT();
+  STORED(ADDR, 2);
+CPU_HANDLER(CPU_OP_SW):
+  MEM_ACCESS(ADDR, 4, true);
+  if (memWrite32(ctx, ADDR, RS2) != MEM_NO_ERROR)
+    MEM_FAULT();
+  STORED(ADDR, 4);
+
+CPU_HANDLER(CPU_OP_ADD):
+  RD = RS1 + RS2;
+  NEXT();
+CPU_HANDLER(CPU_OP_SLL):
+  RD = RS1 << (RS2 & 0x1F);
+  NEXT();
+CPU_HANDLER(CPU_OP_SLT):
+  RD = (t_cpuSRegValue)RS1 < (t_cpuSRegValue)RS2;
+  NEXT();
+CPU_HANDLER(CPU_OP_SLTU):
+  RD = RS1 < RS2;
+  NEXT();
+CPU_HANDLER(CPU_OP_XOR):
+  RD = RS1 ^ RS2;
+  NEXT();
+CPU_HANDLER(CPU_OP_SRL):
+  RD = RS1 >> (RS2 & 0x1F);
+  NEXT();
+CPU_HANDLER(CPU_OP_OR):
+  RD = RS1 | RS2;
+  NEXT();
+CPU_HANDLER(CPU_OP_AND):
+  RD = RS1 & RS2;
+  NEXT();
+CPU_HANDLER(CPU_OP_SUB):
+  RD = RS1 - RS2;
+  NEXT();
+CPU_HANDLER(CPU_OP_SRA):
+  RD = SRA(RS1, (RS2 & 0x1F));
+  NEXT();
+CPU_HANDLER(CPU_OP_MUL):
+  RD = RS1 * RS2;
+  NEXT();
+CPU_HANDLER(CPU_OP_MULH):
+  RD = (uint32_t)(((int64_t)((int32_t)RS1) * (int64_t)((int32_t)RS2)) >> 32);
+  NEXT();
+CPU_HANDLER(CPU_OP_MULHSU):
+  RD = (uint32_t)(((int64_t)((int32_t)RS1) * (int64_t)(RS2)) >> 32);
+  NEXT();
+CPU_HANDLER(CPU_OP_MULHU):
+  RD = (t_cpuURegValue)(((uint64_t)(RS1) * (uint64_t)(RS2)) >> 32);
+  NEXT();
+CPU_HANDLER(CPU_OP_DIV):
+  if (RS2 == 0)
+    RD = 0xFFFFFFFF;
+  else if (RS1 == 0x80000000 && RS2 == 0xFFFFFFFF)
+    RD = 0x80000000;
+  else
+    RD = (t_cpuURegValue)((t_cpuSRegValue)RS1 / (t_cpuSRegValue)RS2);
+  NEXT();
+CPU_HANDLER(CPU_OP_DIVU):
+  if (RS2 == 0)
+    RD = 0xFFFFFFFF;
+  else
+    RD = RS1 / RS2;
+  NEXT();
+CPU_HANDLER(CPU_OP_REM):
+  if (RS2 == 0)
+    RD = RS1;
+  else if (RS1 == 0x80000000 && RS2 == 0xFFFFFFFF)
+    RD = 0;
+  else
+    RD = (t_cpuURegValue)((t_cpuSRegValue)RS1 % (t_cpuSRegValue)RS2);
+  NEXT();
+CPU_HANDLER(CPU_OP_REMU):
+  if (RS2 == 0)
+    RD = RS1;
+  else
+    RD = RS1 % RS2;
+  NEXT();
+
+CPU_HANDLER(CPU_OP_LUI):
+  RD = IMM;
+  NEXT();
+
+CPU_HANDLER(CPU_OP_BEQ):
+  if (RS1 == RS2)
+    JUMP(PC + IMM);
+  NEXT();
+CPU_HANDLER(CPU_OP_BNE):
+  if (RS1 != RS2)
+    JUMP(PC + IMM);
+  NEXT();
+CPU_HANDLER(CPU_OP_BLT):
+  if ((t_cpuSRegValue)RS1 < (t_cpuSRegValue)RS2)
+    JUMP(PC + IMM);
+  NEXT();
+CPU_HANDLER(CPU_OP_BGE):
+  if ((t_cpuSRegValue)RS1 >= (t_cpuSRegValue)RS2)
+    JUMP(PC + IMM);
+  NEXT();
+CPU_HANDLER(CPU_OP_BLTU):
+  if (RS1 < RS2)
+    JUMP(PC + IMM);
+  NEXT();
+CPU_HANDLER(CPU_OP_BGEU):
+  if (RS1 >= RS2)
+    JUMP(PC + IMM);
+  NEXT();
+
+CPU_HANDLER(CPU_OP_JALR):
+  // clear bit zero as suggested by the spec
+  tmp32 = (RS1 + IMM) & ~(t_cpuURegValue)1;
+  RD = PC + LENGTH;
+  JUMP(tmp32);
+CPU_HANDLER(CPU_OP_JAL):
+  RD = PC + LENGTH;
+  JUMP(PC + IMM);
+
+CPU_HANDLER(CPU_OP_ECALL):
+  TRAP(CPU_STATUS_ECALL_TRAP);
+CPU_HANDLER(CPU_OP_EBREAK):
+  TRAP(CPU_STATUS_EBREAK_TRAP);
+CPU_HANDLER(CPU_OP_ILLEGAL):
+  TRAP(CPU_STATUS_ILL_INST_FAULT);
+
+CPU_HANDLER(CPU_OP_LUI_ADDI):
+  FUSED();
+  RD = IMM;
+  FRD = FRS1 + FIMM;
+  FUSED_NEXT();
+CPU_HANDLER(CPU_OP_AUIPC_ADDI):
+  FUSED();
+  RD = PC + IMM;
+  FRD = FRS1 + FIMM;
+  FUSED_NEXT();
+CPU_HANDLER(CPU_OP_AUIPC_LW):
+  FUSED();
+  RD = PC + IMM;
+  MEM_ACCESS(FADDR, 4, false);
+  if (memRead32(ctx, FADDR, &tmp32) != MEM_NO_ERROR)
+    FUSED_MEM_FAULT();
+  FRD = tmp32;
+  FUSED_NEXT();
+CPU_HANDLER(CPU_OP_AUIPC_SW):
+  FUSED();
+  RD = PC + IMM;
+  MEM_ACCESS(FADDR, 4, true);
+  if (memWrite32(ctx, FADDR, FRS2) != MEM_NO_ERROR)
+    FUSED_MEM_FAULT();
+  FUSED_STORED(FADDR, 4);
+CPU_HANDLER(CPU_OP_ADDI_MUL):
+  FUSED();
+  RD = RS1 + IMM;
+  FRD = FRS1 * FRS2;
+  FUSED_NEXT();
+CPU_HANDLER(CPU_OP_SLT_BEQ):
+  FUSED();
+  RD = (t_cpuSRegValue)RS1 < (t_cpuSRegValue)RS2;
+  if (FRS1 == FRS2)
+    JUMP(PC + FIMM);
+  FUSED_NEXT();
+CPU_HANDLER(CPU_OP_SLT_BNE):
+  FUSED();
+  RD = (t_cpuSRegValue)RS1 < (t_cpuSRegValue)RS2;
+  if (FRS1 != FRS2)
+    JUMP(PC + FIMM);
+  FUSED_NEXT();
+CPU_HANDLER(CPU_OP_SLTU_BEQ):
+  FUSED();
+  RD = RS1 < RS2;
+  if (FRS1 == FRS2)
+    JUMP(PC + FIMM);
+  FUSED_NEXT();
+CPU_HANDLER(CPU_OP_SLTU_BNE):
+  FUSED();
+  RD = RS1 < RS2;
+  if (FRS1 != FRS2)
+    JUMP(PC + FIMM);
+  FUSED_NEXT();
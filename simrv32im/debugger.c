@@ -6,55 +6,88 @@
 #include "isa.h"
 #include "cpu.h"
 #include "debugger.h"
+#include "symbols.h"
 
 typedef struct dbgBreakpoint {
   struct dbgBreakpoint *next;
+  struct dbgBreakpoint *nextInBucket;
   t_dbgBreakpointId id;
   t_memAddress address;
 } t_dbgBreakpoint;
 
-t_dbgBreakpoint *dbgBreakpointList = NULL;
+/* Breakpoints are also chained in a hash table indexed by address, so that
+ * checking the current PC does not depend on how many there are */
+#define DBG_BREAKPOINT_BUCKETS 1024
+#define DBG_BREAKPOINT_BUCKET(addr) \
+  (((addr) >> 2) & (DBG_BREAKPOINT_BUCKETS - 1))
+
+typedef struct dbgState {
+  t_dbgBreakpoint *breakpointList;
+  t_dbgBreakpoint *breakpointTable[DBG_BREAKPOINT_BUCKETS];
+  t_dbgBreakpointId lastBreakpointID;
+  bool enabled;
+  bool userRequestsEnter;
+  bool stepInEnabled;
+  bool stepOverEnabled;
+  t_memAddress stepOverAddr;
+} t_dbgState;
+
+
+t_dbgState *newDbgState(void)
+{
+  return calloc(1, sizeof(t_dbgState));
+}
 
-t_dbgBreakpointId dbgLastBreakpointID = 0;
 
-bool dbgEnabled = false;
-bool dbgUserRequestsEnter = false;
-bool dbgStepInEnabled = false;
-bool dbgStepOverEnabled = false;
-t_memAddress dbgStepOverAddr;
+void deleteDbgState(t_dbgState *dbg)
+{
+  if (!dbg)
+    return;
+  while (dbg->breakpointList) {
+    t_dbgBreakpoint *next = dbg->breakpointList->next;
+    free(dbg->breakpointList);
+    dbg->breakpointList = next;
+  }
+  free(dbg);
+}
 
 
-bool dbgEnable(void)
+bool dbgEnable(t_simContext *ctx)
 {
-  bool oldEnable = dbgEnabled;
-  dbgEnabled = true;
+  t_dbgState *dbg = ctx->dbg;
+  bool oldEnable = dbg->enabled;
+  dbg->enabled = true;
   return oldEnable;
 }
 
 
-bool dbgGetEnabled(void)
+bool dbgGetEnabled(t_simContext *ctx)
 {
-  return dbgEnabled;
+  t_dbgState *dbg = ctx->dbg;
+  return dbg->enabled;
 }
 
 
-bool dbgDisable(void)
+bool dbgDisable(t_simContext *ctx)
 {
-  bool oldEnable = dbgEnabled;
-  dbgEnabled = false;
+  t_dbgState *dbg = ctx->dbg;
+  bool oldEnable = dbg->enabled;
+  dbg->enabled = false;
   return oldEnable;
 }
 
 
-void dbgRequestEnter(void)
+void dbgRequestEnter(t_simContext *ctx)
 {
-  dbgUserRequestsEnter = true;
+  t_dbgState *dbg = ctx->dbg;
+  dbg->userRequestsEnter = true;
 }
 
 
-int dbgPrintf(const char *format, ...)
+int dbgPrintf(t_simContext *ctx, const char *format, ...)
 {
-  if (!dbgEnabled)
+  t_dbgState *dbg = ctx->dbg;
+  if (!dbg->enabled)
     return 0;
 
   va_list args;
@@ -65,21 +98,27 @@ int dbgPrintf(const char *format, ...)
 }
 
 
-t_dbgBreakpointId dbgAddBreakpoint(t_memAddress address)
+t_dbgBreakpointId dbgAddBreakpoint(t_simContext *ctx, t_memAddress address)
 {
+  t_dbgState *dbg = ctx->dbg;
   t_dbgBreakpoint *bp = calloc(1, sizeof(t_dbgBreakpoint));
-  bp->next = dbgBreakpointList;
-  bp->id = dbgLastBreakpointID++;
+  bp->next = dbg->breakpointList;
+  bp->id = dbg->lastBreakpointID++;
   bp->address = address;
-  dbgBreakpointList = bp;
+  dbg->breakpointList = bp;
+  t_dbgBreakpoint **bucket =
+      &dbg->breakpointTable[DBG_BREAKPOINT_BUCKET(address)];
+  bp->nextInBucket = *bucket;
+  *bucket = bp;
   return bp->id;
 }
 
 
-bool dbgRemoveBreakpoint(t_dbgBreakpointId brkId)
+bool dbgRemoveBreakpoint(t_simContext *ctx, t_dbgBreakpointId brkId)
 {
+  t_dbgState *dbg = ctx->dbg;
   t_dbgBreakpoint *prev = NULL;
-  t_dbgBreakpoint *cur = dbgBreakpointList;
+  t_dbgBreakpoint *cur = dbg->breakpointList;
   while (cur && cur->id != brkId) {
     prev = cur;
     cur = cur->next;
@@ -89,16 +128,22 @@ bool dbgRemoveBreakpoint(t_dbgBreakpointId brkId)
   if (prev) {
     prev->next = cur->next;
   } else {
-    dbgBreakpointList = cur->next;
+    dbg->breakpointList = cur->next;
   }
+  t_dbgBreakpoint **link =
+      &dbg->breakpointTable[DBG_BREAKPOINT_BUCKET(cur->address)];
+  while (*link != cur)
+    link = &(*link)->nextInBucket;
+  *link = cur->nextInBucket;
   free(cur);
   return true;
 }
 
 
-t_memAddress dbgGetBreakpoint(t_dbgBreakpointId brkId)
+t_memAddress dbgGetBreakpoint(t_simContext *ctx, t_dbgBreakpointId brkId)
 {
-  t_dbgBreakpoint *cur = dbgBreakpointList;
+  t_dbgState *dbg = ctx->dbg;
+  t_dbgBreakpoint *cur = dbg->breakpointList;
   while (cur && cur->id != brkId)
     cur = cur->next;
   if (cur)
@@ -107,14 +152,16 @@ t_memAddress dbgGetBreakpoint(t_dbgBreakpointId brkId)
 }
 
 
-t_dbgEnumBreakpointState dbgEnumerateBreakpoints(t_dbgEnumBreakpointState state,
-    t_dbgBreakpointId *outId, t_memAddress *outAddress)
+t_dbgEnumBreakpointState dbgEnumerateBreakpoints(t_simContext *ctx,
+    t_dbgEnumBreakpointState state, t_dbgBreakpointId *outId,
+    t_memAddress *outAddress)
 {
+  t_dbgState *dbg = ctx->dbg;
   t_dbgBreakpoint *xstate = (t_dbgBreakpoint *)state;
   t_dbgBreakpoint *cur;
 
   if (!xstate) {
-    cur = dbgBreakpointList;
+    cur = dbg->breakpointList;
   } else {
     cur = xstate->next;
   }
@@ -139,32 +186,30 @@ enum {
   DBG_TRIG_TYPE_USER
 };
 
-t_dbgTrigType dbgCheckTrigger(t_dbgBreakpointId *outId)
+t_dbgTrigType dbgCheckTrigger(t_simContext *ctx, t_dbgBreakpointId *outId)
 {
-  if (!dbgEnabled)
+  t_dbgState *dbg = ctx->dbg;
+  if (!dbg->enabled)
     return DBG_TRIG_NONE;
 
-  if (dbgUserRequestsEnter)
+  if (dbg->userRequestsEnter)
     return DBG_TRIG_TYPE_USER;
 
-  if (dbgStepInEnabled)
+  if (dbg->stepInEnabled)
     return DBG_TRIG_TYPE_STEPIN;
 
-  t_memAddress curPc = cpuGetRegister(CPU_REG_PC);
-  if (dbgStepOverEnabled && dbgStepOverAddr == curPc)
+  t_memAddress curPc = cpuGetRegister(ctx, CPU_REG_PC);
+  if (dbg->stepOverEnabled && dbg->stepOverAddr == curPc)
     return DBG_TRIG_TYPE_STEPOVER;
 
-  t_memAddress bpAddr;
-  t_dbgEnumBreakpointState state =
-      dbgEnumerateBreakpoints(DBG_ENUM_BREAKPOINT_START, outId, &bpAddr);
-  while (state != DBG_ENUM_BREAKPOINT_STOP) {
-    if (bpAddr == curPc)
-      break;
-    state = dbgEnumerateBreakpoints(state, outId, &bpAddr);
-  }
+  t_dbgBreakpoint *bp = dbg->breakpointTable[DBG_BREAKPOINT_BUCKET(curPc)];
+  while (bp && bp->address != curPc)
+    bp = bp->nextInBucket;
 
-  if (state)
+  if (bp) {
+    *outId = bp->id;
     return DBG_TRIG_TYPE_BREAKP;
+  }
   return DBG_TRIG_NONE;
 }
 
@@ -198,16 +243,17 @@ enum {
 };
 
 void dbgCmdHelp(void);
-void dbgCmdStepOver(void);
-void dbgCmdAddBreakpoint(char *args);
-void dbgCmdRemoveBreakpoint(char *args);
-void dbgCmdPrintBreakpoints(void);
-void dbgCmdPrintCpuStatus(void);
-void dbgCmdDisassemble(char *args);
-void dbgCmdMemDump(char *args);
-
-t_dbgResult dbgInterface(void)
+void dbgCmdStepOver(t_simContext *ctx);
+void dbgCmdAddBreakpoint(t_simContext *ctx, char *args);
+void dbgCmdRemoveBreakpoint(t_simContext *ctx, char *args);
+void dbgCmdPrintBreakpoints(t_simContext *ctx);
+void dbgCmdPrintCpuStatus(t_simContext *ctx);
+void dbgCmdDisassemble(t_simContext *ctx, char *args);
+void dbgCmdMemDump(t_simContext *ctx, char *args);
+
+t_dbgResult dbgInterface(t_simContext *ctx)
 {
+  t_dbgState *dbg = ctx->dbg;
   char input[80];
 
   fprintf(stderr, "debug> ");
@@ -221,23 +267,23 @@ t_dbgResult dbgInterface(void)
   } else if (dbgParserAcceptKeyword("c", &nextTok)) {
     return DBG_IF_STOP_DEBUG;
   } else if (dbgParserAcceptKeyword("s", &nextTok)) {
-    dbgStepInEnabled = 1;
+    dbg->stepInEnabled = 1;
     return DBG_IF_STOP_DEBUG;
   } else if (dbgParserAcceptKeyword("n", &nextTok)) {
-    dbgCmdStepOver();
+    dbgCmdStepOver(ctx);
     return DBG_IF_STOP_DEBUG;
   } else if (dbgParserAcceptKeyword("bl", &nextTok)) {
-    dbgCmdPrintBreakpoints();
+    dbgCmdPrintBreakpoints(ctx);
   } else if (dbgParserAcceptKeyword("br", &nextTok)) {
-    dbgCmdRemoveBreakpoint(nextTok);
+    dbgCmdRemoveBreakpoint(ctx, nextTok);
   } else if (dbgParserAcceptKeyword("b", &nextTok)) {
-    dbgCmdAddBreakpoint(nextTok);
+    dbgCmdAddBreakpoint(ctx, nextTok);
   } else if (dbgParserAcceptKeyword("v", &nextTok)) {
-    dbgCmdPrintCpuStatus();
+    dbgCmdPrintCpuStatus(ctx);
   } else if (dbgParserAcceptKeyword("u", &nextTok)) {
-    dbgCmdDisassemble(nextTok);
+    dbgCmdDisassemble(ctx, nextTok);
   } else if (dbgParserAcceptKeyword("d", &nextTok)) {
-    dbgCmdMemDump(nextTok);
+    dbgCmdMemDump(ctx, nextTok);
   } else if (*nextTok != '\0') {
     dbgCmdHelp();
   }
@@ -254,43 +300,52 @@ void dbgCmdHelp(void)
   puts("s               Step in");
   puts("n               Step over");
   puts("b <address>     Add a breakpoint at the specified address");
+  puts("                  (also a label or file:line, when the executable");
+  puts("                  has symbols and a line table)");
   puts("bl              List all breakpoints");
   puts("br <id>         Remove breakpoint number <id>");
   puts("v               Print current CPU state");
   puts("u <start> <len> Disassemble 'len' instructions from address 'start'");
+  puts("                  (also a label or file:line)");
   puts("d <start> <len> Dump 'len' bytes from address 'start'");
 }
 
-void dbgCmdStepOver(void)
+void dbgCmdStepOver(t_simContext *ctx)
 {
-  t_cpuURegValue pc = cpuGetRegister(CPU_REG_PC);
-  uint32_t inst = memDebugRead32(pc, NULL);
+  t_dbgState *dbg = ctx->dbg;
+  t_cpuURegValue pc = cpuGetRegister(ctx, CPU_REG_PC);
+  uint32_t inst = cpuDebugReadInstruction(ctx, pc);
+  t_memSize length = ISA_INST_LENGTH(inst);
+  if (ISA_INST_IS_COMPRESSED(inst) &&
+      !isaExpandCompressed((uint16_t)inst, &inst))
+    inst = 0;
   if ((ISA_INST_OPCODE(inst) == ISA_INST_OPCODE_JAL ||
           (ISA_INST_OPCODE(inst) == ISA_INST_OPCODE_JALR &&
               ISA_INST_FUNCT3(inst) == 0)) &&
       ISA_INST_RD(inst) == CPU_REG_RA) {
     /* the instruction is presumably a subroutine call */
-    dbgStepOverEnabled = 1;
-    dbgStepOverAddr = pc + 4;
+    dbg->stepOverEnabled = 1;
+    dbg->stepOverAddr = pc + length;
   } else {
-    dbgStepInEnabled = 1;
+    dbg->stepInEnabled = 1;
   }
 }
 
-void dbgCmdAddBreakpoint(char *args)
+void dbgCmdAddBreakpoint(t_simContext *ctx, char *args)
 {
   char *arg2;
-  unsigned long addr = strtoul(args, &arg2, 0);
-  if (args == arg2) {
-    fprintf(stderr, "First argument is not a valid number\n");
+  t_memAddress addr;
+  if (!symParseAddress(ctx, args, &arg2, &addr)) {
+    fprintf(stderr, "First argument is not a valid address\n");
     return;
   }
 
-  t_dbgBreakpointId id = dbgAddBreakpoint((t_memAddress)addr);
-  fprintf(stderr, "Added breakpoint %d at address 0x%08lx\n", id, addr);
+  t_dbgBreakpointId id = dbgAddBreakpoint(ctx, addr);
+  fprintf(stderr, "Added breakpoint %d at address 0x%08" PRIx32 "\n", id,
+      addr);
 }
 
-void dbgCmdRemoveBreakpoint(char *args)
+void dbgCmdRemoveBreakpoint(t_simContext *ctx, char *args)
 {
   char *arg2;
   unsigned long bpid = strtoul(args, &arg2, 0);
@@ -299,40 +354,52 @@ void dbgCmdRemoveBreakpoint(char *args)
     return;
   }
 
-  if (dbgRemoveBreakpoint((t_dbgBreakpointId)bpid))
+  if (dbgRemoveBreakpoint(ctx, (t_dbgBreakpointId)bpid))
     fprintf(stderr, "Removed breakpoint %lu\n", bpid);
   else
     fprintf(stderr, "Breakpoint %lu not found\n", bpid);
 }
 
-void dbgCmdPrintBreakpoints(void)
+void dbgCmdPrintBreakpoints(t_simContext *ctx)
 {
   t_dbgBreakpointId id;
   t_memAddress addr;
 
   t_dbgEnumBreakpointState enumState =
-      dbgEnumerateBreakpoints(DBG_ENUM_BREAKPOINT_START, &id, &addr);
+      dbgEnumerateBreakpoints(ctx, DBG_ENUM_BREAKPOINT_START, &id, &addr);
   if (enumState == DBG_ENUM_BREAKPOINT_STOP) {
     fprintf(stderr, "No breakpoints defined\n");
   } else {
     while (enumState != DBG_ENUM_BREAKPOINT_STOP) {
       fprintf(stderr, "Breakpoint %-8d Address 0x%08x\n", id, addr);
-      enumState = dbgEnumerateBreakpoints(enumState, &id, &addr);
+      enumState = dbgEnumerateBreakpoints(ctx, enumState, &id, &addr);
     }
   }
 }
 
-void dbgCmdPrintCpuStatus(void)
+void dbgCmdPrintCpuStatus(t_simContext *ctx)
 {
   char buffer[80];
 
-  t_cpuURegValue pc = cpuGetRegister(CPU_REG_PC);
-  uint32_t inst = memDebugRead32(pc, NULL);
+  t_cpuURegValue pc = cpuGetRegister(ctx, CPU_REG_PC);
+  uint32_t inst = cpuDebugReadInstruction(ctx, pc);
   isaDisassemble(inst, buffer, 80);
-  fprintf(stderr, "PC : %08x: %08x %s\n", pc, inst, buffer);
+  fprintf(stderr, "PC : %08x: %0*x %s\n", pc, ISA_INST_LENGTH(inst) * 2, inst,
+      buffer);
+  const t_symSymbol *symbol = symFindSymbol(ctx, pc);
+  int line;
+  const char *file = symFindLine(ctx, pc, &line);
+  if (symbol && file)
+    fprintf(stderr, "     %s+0x%" PRIx32 " at %s:%d\n", symbol->name,
+        pc - symbol->address, file, line);
+  else if (symbol)
+    fprintf(stderr, "     %s+0x%" PRIx32 "\n", symbol->name,
+        pc - symbol->address);
+  else if (file)
+    fprintf(stderr, "     at %s:%d\n", file, line);
 
   for (t_cpuRegID r = CPU_REG_X0; r <= CPU_REG_X31; r++) {
-    fprintf(stderr, "X%-2d: %08x", r, cpuGetRegister(r));
+    fprintf(stderr, "X%-2d: %08x", r, cpuGetRegister(ctx, r));
     if ((r + 1) % 4 == 0)
       fputc('\n', stderr);
     else
@@ -340,14 +407,14 @@ void dbgCmdPrintCpuStatus(void)
   }
 }
 
-void dbgCmdDisassemble(char *args)
+void dbgCmdDisassemble(t_simContext *ctx, char *args)
 {
   char buffer[80];
 
   char *arg2;
-  unsigned long addr = strtoul(args, &arg2, 0);
-  if (args == arg2) {
-    fprintf(stderr, "First argument is not a valid number\n");
+  t_memAddress addr;
+  if (!symParseAddress(ctx, args, &arg2, &addr)) {
+    fprintf(stderr, "First argument is not a valid address\n");
     return;
   }
   char *arg3;
@@ -357,18 +424,23 @@ void dbgCmdDisassemble(char *args)
     return;
   }
 
+  t_memAddress curaddr = addr;
   for (int i = 0; i < len; i++) {
-    t_memAddress curaddr = (t_memAddress)addr + (t_memAddress)(4 * i);
-    uint32_t instr = memDebugRead32(curaddr, NULL);
+    const t_symSymbol *symbol = symFindSymbol(ctx, curaddr);
+    if (symbol && symbol->address == curaddr)
+      fprintf(stderr, "%s:\n", symbol->name);
+    uint32_t instr = cpuDebugReadInstruction(ctx, curaddr);
     isaDisassemble(instr, buffer, 80);
-    fprintf(
-        stderr, "%08" PRIx32 ":  %08" PRIx32 "  %s\n", curaddr, instr, buffer);
+    fprintf(stderr, "%08" PRIx32 ":  %*s%0*" PRIx32 "  %s\n", curaddr,
+        ISA_INST_IS_COMPRESSED(instr) ? 4 : 0, "",
+        ISA_INST_LENGTH(instr) * 2, instr, buffer);
+    curaddr += ISA_INST_LENGTH(instr);
   }
 
   return;
 }
 
-void dbgCmdMemDump(char *args)
+void dbgCmdMemDump(t_simContext *ctx, char *args)
 {
   char *arg2;
   unsigned long addr = strtoul(args, &arg2, 0);
@@ -387,7 +459,7 @@ void dbgCmdMemDump(char *args)
     fprintf(stderr, "%08" PRIx32 ": ", (t_memAddress)addr);
     for (int i = 0; i < len; i++) {
       t_memAddress curaddr = (t_memAddress)addr + (t_memAddress)i;
-      uint8_t byte = memDebugRead8(curaddr, NULL);
+      uint8_t byte = memDebugRead8(ctx, curaddr, NULL);
       fprintf(stderr, "%02" PRIx8, byte);
       if ((i + 1) % 16 == 0 || (i + 1) == len)
         fputc('\n', stderr);
@@ -403,27 +475,28 @@ void dbgCmdMemDump(char *args)
 }
 
 
-t_dbgResult dbgTick(void)
+t_dbgResult dbgTick(t_simContext *ctx)
 {
+  t_dbgState *dbg = ctx->dbg;
   t_dbgBreakpointId bpId;
-  t_dbgTrigType bpTrig = dbgCheckTrigger(&bpId);
+  t_dbgTrigType bpTrig = dbgCheckTrigger(ctx, &bpId);
   if (bpTrig == DBG_TRIG_NONE)
     return DBG_RESULT_CONTINUE;
 
   if (bpTrig == DBG_TRIG_TYPE_BREAKP) {
     fprintf(stderr, "Stopped at breakpoint #%d (PC=0x%08x)\n", bpId,
-        dbgGetBreakpoint(bpId));
+        dbgGetBreakpoint(ctx, bpId));
   }
 
-  dbgStepInEnabled = false;
-  dbgStepOverEnabled = false;
-  dbgUserRequestsEnter = false;
+  dbg->stepInEnabled = false;
+  dbg->stepOverEnabled = false;
+  dbg->userRequestsEnter = false;
 
-  dbgCmdPrintCpuStatus();
+  dbgCmdPrintCpuStatus(ctx);
 
   t_dbgResult dbgRes;
   do {
-    dbgRes = dbgInterface();
+    dbgRes = dbgInterface(ctx);
   } while (dbgRes == DBG_IF_CONT_DEBUG);
 
   if (dbgRes == DBG_IF_STOP_DEBUG)
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "memory.h"
+#include "context.h"
 
 typedef int t_dbgResult;
 enum {
@@ -19,19 +20,25 @@ typedef void *t_dbgEnumBreakpointState;
 #define DBG_ENUM_BREAKPOINT_STOP ((t_dbgEnumBreakpointState)NULL)
 
 
-bool dbgEnable(void);
-bool dbgGetEnabled(void);
-bool dbgDisable(void);
-void dbgRequestEnter(void);
+typedef struct dbgState t_dbgState;
 
-int dbgPrintf(const char *format, ...);
+t_dbgState *newDbgState(void);
+void deleteDbgState(t_dbgState *dbg);
 
-t_dbgBreakpointId dbgAddBreakpoint(t_memAddress address);
-bool dbgRemoveBreakpoint(t_dbgBreakpointId brkId);
-t_memAddress dbgGetBreakpoint(t_dbgBreakpointId brkId);
-t_dbgEnumBreakpointState dbgEnumerateBreakpoints(t_dbgEnumBreakpointState state,
-    t_dbgBreakpointId *outId, t_memAddress *outAddress);
+bool dbgEnable(t_simContext *ctx);
+bool dbgGetEnabled(t_simContext *ctx);
+bool dbgDisable(t_simContext *ctx);
+void dbgRequestEnter(t_simContext *ctx);
 
-t_dbgResult dbgTick(void);
+int dbgPrintf(t_simContext *ctx, const char *format, ...);
+
+t_dbgBreakpointId dbgAddBreakpoint(t_simContext *ctx, t_memAddress address);
+bool dbgRemoveBreakpoint(t_simContext *ctx, t_dbgBreakpointId brkId);
+t_memAddress dbgGetBreakpoint(t_simContext *ctx, t_dbgBreakpointId brkId);
+t_dbgEnumBreakpointState dbgEnumerateBreakpoints(t_simContext *ctx,
+    t_dbgEnumBreakpointState state, t_dbgBreakpointId *outId,
+    t_memAddress *outAddress);
+
+t_dbgResult dbgTick(t_simContext *ctx);
 
 #endif
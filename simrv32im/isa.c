@@ -11,11 +11,223 @@ int isaDisassembleBRANCH(uint32_t instr, char *out, size_t bufsz);
 int isaDisassembleSYSTEM(uint32_t instr, char *out, size_t bufsz);
 
 
+static uint32_t isaPackR(
+    uint32_t opcode, uint32_t funct3, uint32_t funct7, uint32_t rd,
+    uint32_t rs1, uint32_t rs2)
+{
+  return opcode | (rd << 7) | (funct3 << 12) | (rs1 << 15) | (rs2 << 20) |
+      (funct7 << 25);
+}
+
+static uint32_t isaPackI(
+    uint32_t opcode, uint32_t funct3, uint32_t rd, uint32_t rs1, uint32_t imm)
+{
+  return opcode | (rd << 7) | (funct3 << 12) | (rs1 << 15) |
+      ((imm & 0xFFF) << 20);
+}
+
+static uint32_t isaPackS(uint32_t funct3, uint32_t rs1, uint32_t rs2,
+    uint32_t imm)
+{
+  return ISA_INST_OPCODE_STORE | (BITS(imm, 0, 5) << 7) | (funct3 << 12) |
+      (rs1 << 15) | (rs2 << 20) | (BITS(imm, 5, 12) << 25);
+}
+
+static uint32_t isaPackB(uint32_t funct3, uint32_t rs1, uint32_t rs2,
+    uint32_t imm)
+{
+  return ISA_INST_OPCODE_BRANCH | (BITS(imm, 11, 12) << 7) |
+      (BITS(imm, 1, 5) << 8) | (funct3 << 12) | (rs1 << 15) | (rs2 << 20) |
+      (BITS(imm, 5, 11) << 25) | (BITS(imm, 12, 13) << 31);
+}
+
+static uint32_t isaPackJ(uint32_t rd, uint32_t imm)
+{
+  return ISA_INST_OPCODE_JAL | (rd << 7) | (BITS(imm, 12, 20) << 12) |
+      (BITS(imm, 11, 12) << 20) | (BITS(imm, 1, 11) << 21) |
+      (BITS(imm, 20, 21) << 31);
+}
+
+/* Fields of the compressed formats. The registers of the 3 bit fields are
+ * x8-x15. */
+#define ISA_C_RD(x) BITS(x, 7, 12)
+#define ISA_C_RS2(x) BITS(x, 2, 7)
+#define ISA_C_RS1S(x) (8 + BITS(x, 7, 10))
+#define ISA_C_RS2S(x) (8 + BITS(x, 2, 5))
+#define ISA_C_IMM6_SEXT(x) SEXT(BITS(x, 2, 7) | (BITS(x, 12, 13) << 5), 6)
+#define ISA_C_MEM_UIMM(x) \
+  ((BITS(x, 10, 13) << 3) | (BITS(x, 6, 7) << 2) | (BITS(x, 5, 6) << 6))
+#define ISA_C_J_IMM12_SEXT(x)                                               \
+  SEXT((BITS(x, 12, 13) << 11) | (BITS(x, 11, 12) << 4) |                   \
+      (BITS(x, 9, 11) << 8) | (BITS(x, 8, 9) << 10) | (BITS(x, 7, 8) << 6) | \
+      (BITS(x, 6, 7) << 7) | (BITS(x, 3, 6) << 1) | (BITS(x, 2, 3) << 5),    \
+      12)
+#define ISA_C_B_IMM9_SEXT(x)                                                \
+  SEXT((BITS(x, 12, 13) << 8) | (BITS(x, 10, 12) << 3) |                    \
+      (BITS(x, 5, 7) << 6) | (BITS(x, 3, 5) << 1) | (BITS(x, 2, 3) << 5),   \
+      9)
+
+static bool isaExpandQuadrant0(uint16_t instr, uint32_t *out)
+{
+  uint32_t imm;
+
+  switch (BITS(instr, 13, 16)) {
+    case 0: // C.ADDI4SPN
+      imm = (BITS(instr, 11, 13) << 4) | (BITS(instr, 7, 11) << 6) |
+          (BITS(instr, 6, 7) << 2) | (BITS(instr, 5, 6) << 3);
+      if (imm == 0)
+        return false;
+      *out = isaPackI(
+          ISA_INST_OPCODE_OPIMM, 0, ISA_C_RS2S(instr), CPU_REG_SP, imm);
+      return true;
+    case 2: // C.LW
+      *out = isaPackI(ISA_INST_OPCODE_LOAD, 2, ISA_C_RS2S(instr),
+          ISA_C_RS1S(instr), ISA_C_MEM_UIMM(instr));
+      return true;
+    case 6: // C.SW
+      *out = isaPackS(
+          2, ISA_C_RS1S(instr), ISA_C_RS2S(instr), ISA_C_MEM_UIMM(instr));
+      return true;
+  }
+  return false;
+}
+
+static bool isaExpandQuadrant1(uint16_t instr, uint32_t *out)
+{
+  static const uint32_t arithFunct3[4] = {0, 4, 6, 7};
+  uint32_t rd = ISA_C_RD(instr);
+  uint32_t rs1s = ISA_C_RS1S(instr);
+  uint32_t imm = ISA_C_IMM6_SEXT(instr);
+
+  switch (BITS(instr, 13, 16)) {
+    case 0: // C.ADDI, C.NOP
+      *out = isaPackI(ISA_INST_OPCODE_OPIMM, 0, rd, rd, imm);
+      return true;
+    case 1: // C.JAL
+      *out = isaPackJ(CPU_REG_RA, ISA_C_J_IMM12_SEXT(instr));
+      return true;
+    case 2: // C.LI
+      *out = isaPackI(ISA_INST_OPCODE_OPIMM, 0, rd, CPU_REG_ZERO, imm);
+      return true;
+    case 3:
+      if (rd == CPU_REG_SP) { // C.ADDI16SP
+        imm = SEXT((BITS(instr, 12, 13) << 9) | (BITS(instr, 6, 7) << 4) |
+                (BITS(instr, 5, 6) << 6) | (BITS(instr, 3, 5) << 7) |
+                (BITS(instr, 2, 3) << 5),
+            10);
+        if (imm == 0)
+          return false;
+        *out = isaPackI(ISA_INST_OPCODE_OPIMM, 0, rd, rd, imm);
+        return true;
+      }
+      if (imm == 0) // C.LUI
+        return false;
+      *out = ISA_INST_OPCODE_LUI | (rd << 7) | ((imm & 0xFFFFF) << 12);
+      return true;
+    case 4:
+      switch (BITS(instr, 10, 12)) {
+        case 0: // C.SRLI
+        case 1: // C.SRAI
+          if (BITS(instr, 12, 13))
+            return false;
+          *out = isaPackI(ISA_INST_OPCODE_OPIMM, 5, rs1s, rs1s,
+              (imm & 0x1F) | (BITS(instr, 10, 11) << 10));
+          return true;
+        case 2: // C.ANDI
+          *out = isaPackI(ISA_INST_OPCODE_OPIMM, 7, rs1s, rs1s, imm);
+          return true;
+      }
+      // C.SUB, C.XOR, C.OR, C.AND
+      if (BITS(instr, 12, 13))
+        return false;
+      *out = isaPackR(ISA_INST_OPCODE_OP, arithFunct3[BITS(instr, 5, 7)],
+          BITS(instr, 5, 7) == 0 ? 0x20 : 0x00, rs1s, rs1s, ISA_C_RS2S(instr));
+      return true;
+    case 5: // C.J
+      *out = isaPackJ(CPU_REG_ZERO, ISA_C_J_IMM12_SEXT(instr));
+      return true;
+    case 6: // C.BEQZ
+    case 7: // C.BNEZ
+      *out = isaPackB(BITS(instr, 13, 14), rs1s, CPU_REG_ZERO,
+          ISA_C_B_IMM9_SEXT(instr));
+      return true;
+  }
+  return false;
+}
+
+static bool isaExpandQuadrant2(uint16_t instr, uint32_t *out)
+{
+  uint32_t rd = ISA_C_RD(instr);
+  uint32_t rs2 = ISA_C_RS2(instr);
+  uint32_t imm;
+
+  switch (BITS(instr, 13, 16)) {
+    case 0: // C.SLLI
+      if (BITS(instr, 12, 13))
+        return false;
+      *out = isaPackI(ISA_INST_OPCODE_OPIMM, 1, rd, rd, rs2);
+      return true;
+    case 2: // C.LWSP
+      if (rd == CPU_REG_ZERO)
+        return false;
+      imm = (BITS(instr, 12, 13) << 5) | (BITS(instr, 4, 7) << 2) |
+          (BITS(instr, 2, 4) << 6);
+      *out = isaPackI(ISA_INST_OPCODE_LOAD, 2, rd, CPU_REG_SP, imm);
+      return true;
+    case 4:
+      if (BITS(instr, 12, 13) == 0) {
+        if (rs2 != CPU_REG_ZERO) // C.MV
+          *out = isaPackR(ISA_INST_OPCODE_OP, 0, 0, rd, CPU_REG_ZERO, rs2);
+        else if (rd != CPU_REG_ZERO) // C.JR
+          *out = isaPackI(ISA_INST_OPCODE_JALR, 0, CPU_REG_ZERO, rd, 0);
+        else
+          return false;
+      } else {
+        if (rs2 != CPU_REG_ZERO) // C.ADD
+          *out = isaPackR(ISA_INST_OPCODE_OP, 0, 0, rd, rd, rs2);
+        else if (rd != CPU_REG_ZERO) // C.JALR
+          *out = isaPackI(ISA_INST_OPCODE_JALR, 0, CPU_REG_RA, rd, 0);
+        else // C.EBREAK
+          *out = isaPackI(ISA_INST_OPCODE_SYSTEM, 0, 0, 0, 1);
+      }
+      return true;
+    case 6: // C.SWSP
+      imm = (BITS(instr, 9, 13) << 2) | (BITS(instr, 7, 9) << 6);
+      *out = isaPackS(2, CPU_REG_SP, rs2, imm);
+      return true;
+  }
+  return false;
+}
+
+bool isaExpandCompressed(uint16_t instr, uint32_t *out)
+{
+  switch (instr & 3) {
+    case 0:
+      return isaExpandQuadrant0(instr, out);
+    case 1:
+      return isaExpandQuadrant1(instr, out);
+    case 2:
+      return isaExpandQuadrant2(instr, out);
+  }
+  return false;
+}
+
+
 int isaDisassemble(uint32_t instr, char *out, size_t bufsz)
 {
   t_cpuRegID rd, rs1;
   int32_t imm;
 
+  if (ISA_INST_IS_COMPRESSED(instr)) {
+    uint32_t expanded;
+    if (!isaExpandCompressed((uint16_t)instr, &expanded))
+      return isaDisassembleIllegal(instr, out, bufsz);
+    int len = snprintf(out, bufsz, "C.");
+    if (len < 0 || (size_t)len >= bufsz)
+      return len;
+    return len + isaDisassemble(expanded, out + len, bufsz - (size_t)len);
+  }
+
   switch (ISA_INST_OPCODE(instr)) {
     case ISA_INST_OPCODE_OP:
       return isaDisassembleOP(instr, out, bufsz);
@@ -1,6 +1,7 @@
 #ifndef ISA_H
 #define ISA_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -147,7 +148,16 @@ static inline uint32_t bits32(uint32_t x, int a, int b)
 #define ISA_INST_OPCODE_JAL ISA_INST_OPCODE_CODE(0x1B)
 #define ISA_INST_OPCODE_SYSTEM ISA_INST_OPCODE_CODE(0x1C)
 
+/* Compressed (RVC) instructions are 16 bit long, and are the ones whose two
+ * lowest bits are not both set */
+#define ISA_INST_IS_COMPRESSED(x) (((x) & 3) != 3)
+#define ISA_INST_LENGTH(x) (ISA_INST_IS_COMPRESSED(x) ? 2 : 4)
 
+
+/* Translates a compressed instruction to the 32 bit instruction it stands
+ * for. Returns false if the instruction is not a valid RV32C instruction. */
+bool isaExpandCompressed(uint16_t instr, uint32_t *out);
+/* Compressed instructions are disassembled from the low 16 bits of instr */
 int isaDisassemble(uint32_t instr, char *out, size_t bufsz);
 
 #endif
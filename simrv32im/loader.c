@@ -1,49 +1,146 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
 #include "cpu.h"
 #include "loader.h"
 #include "debugger.h"
+#include "symbols.h"
 
 
-t_ldrError ldrLoadBinary(
-    const char *path, t_memAddress baseAddr, t_memAddress entry)
+/* Maps a segment of the file into guest memory. The file contents are mapped
+ * copy-on-write when possible; when the file cannot be mapped (for example
+ * when it is not a regular file) they are read into a new area instead. */
+static t_ldrError ldrLoadSegment(
+    t_simContext *ctx, int fd, const t_ldrSegment *seg)
 {
-  dbgPrintf("Loading raw binary file \"%s\" at address %" PRIu32 "\n", path);
+  t_memError err = memMapFileArea(
+      ctx, seg->base, seg->extent, fd, seg->fileOffset, seg->fileSize);
+  if (err == MEM_NO_ERROR)
+    return LDR_NO_ERROR;
+  if (err != MEM_MAPPING_ERROR)
+    return LDR_MEMORY_ERROR;
 
-  FILE *fp = fopen(path, "rb");
-  if (fp == NULL)
-    return LDR_FILE_ERROR;
+  uint8_t *buf;
+  if (memMapArea(ctx, seg->base, seg->extent, &buf) != MEM_NO_ERROR)
+    return LDR_MEMORY_ERROR;
+  t_memSize done = 0;
+  while (done < seg->fileSize) {
+    ssize_t res = pread(fd, buf + done, seg->fileSize - done,
+        (off_t)(seg->fileOffset + done));
+    if (res <= 0)
+      return LDR_FILE_ERROR;
+    done += (t_memSize)res;
+  }
+  return LDR_NO_ERROR;
+}
 
-  if (fseek(fp, 0, SEEK_END) < 0)
-    return LDR_FILE_ERROR;
-  long fpos = ftell(fp);
-  if (fpos < 0 || fpos > 0x8000000L) {
+
+static t_ldrError ldrAddSegment(t_ldrImage *image, t_memAddress base,
+    t_memSize extent, t_memSize fileOffset, t_memSize fileSize)
+{
+  t_ldrSegment *segments = realloc(
+      image->segments, sizeof(t_ldrSegment) * (size_t)(image->numSegments + 1));
+  if (!segments)
+    return LDR_MEMORY_ERROR;
+  image->segments = segments;
+  t_ldrSegment *seg = &segments[image->numSegments++];
+  seg->base = base;
+  seg->extent = extent;
+  seg->fileOffset = fileOffset;
+  seg->fileSize = fileSize;
+  return LDR_NO_ERROR;
+}
+
+
+static t_ldrImage *ldrNewImage(FILE *fp)
+{
+  if (!fp)
+    return NULL;
+  t_ldrImage *image = calloc(1, sizeof(t_ldrImage));
+  if (!image) {
     fclose(fp);
-    return LDR_FILE_ERROR;
+    return NULL;
   }
-  t_memSize size = (t_memSize)fpos;
-  if (fseek(fp, 0, SEEK_SET) < 0) {
-    fclose(fp);
-    return LDR_FILE_ERROR;
+  image->fp = fp;
+  return image;
+}
+
+
+void ldrCloseImage(t_ldrImage *image)
+{
+  if (!image)
+    return;
+  fclose(image->fp);
+  free(image->segments);
+  free(image);
+}
+
+
+t_ldrError ldrLoadImage(t_simContext *ctx, const t_ldrImage *image)
+{
+  for (int i = 0; i < image->numSegments; i++) {
+    const t_ldrSegment *seg = &image->segments[i];
+    dbgPrintf(ctx, "Loaded section at 0x%08" PRIx32 " (size=0x%08" PRIx32
+              ") to 0x%08" PRIx32 " (size=0x%08" PRIx32 ")\n",
+        seg->fileOffset, seg->fileSize, seg->base, seg->extent);
+    t_ldrError res = ldrLoadSegment(ctx, fileno(image->fp), seg);
+    if (res != LDR_NO_ERROR)
+      return res;
   }
 
-  uint8_t *buf;
-  if (memMapArea(baseAddr, size, &buf) != MEM_NO_ERROR) {
-    fclose(fp);
-    return LDR_MEMORY_ERROR;
+  dbgPrintf(ctx, "Setting the entry point to 0x%" PRIx32 "\n", image->entry);
+  cpuReset(ctx, image->entry);
+  return LDR_NO_ERROR;
+}
+
+
+t_ldrError ldrOpenBinary(const char *path, t_memAddress baseAddr,
+    t_memAddress entry, t_ldrImage **outImage)
+{
+  t_ldrImage *image = ldrNewImage(fopen(path, "rb"));
+  if (!image)
+    return LDR_FILE_ERROR;
+
+  if (fseek(image->fp, 0, SEEK_END) < 0) {
+    ldrCloseImage(image);
+    return LDR_FILE_ERROR;
   }
-  if (fread(buf, size, 1, fp) < 1) {
-    fclose(fp);
+  long fpos = ftell(image->fp);
+  if (fpos <= 0 || fpos > 0x8000000L) {
+    ldrCloseImage(image);
     return LDR_FILE_ERROR;
   }
+  t_memSize size = (t_memSize)fpos;
 
-  cpuReset(entry);
-
-  fclose(fp);
+  image->entry = entry;
+  t_ldrError res = ldrAddSegment(image, baseAddr, size, 0, size);
+  if (res != LDR_NO_ERROR) {
+    ldrCloseImage(image);
+    return res;
+  }
+  *outImage = image;
   return LDR_NO_ERROR;
 }
 
 
+t_ldrError ldrLoadBinary(t_simContext *ctx, const char *path,
+    t_memAddress baseAddr, t_memAddress entry)
+{
+  dbgPrintf(ctx, "Loading raw binary file \"%s\" at address %" PRIu32 "\n",
+      path, baseAddr);
+
+  t_ldrImage *image;
+  t_ldrError res = ldrOpenBinary(path, baseAddr, entry, &image);
+  if (res != LDR_NO_ERROR)
+    return res;
+  res = ldrLoadImage(ctx, image);
+  ldrCloseImage(image);
+  return res;
+}
+
+
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 typedef uint32_t Elf32_Addr;
@@ -107,6 +204,34 @@ typedef struct __attribute__((packed)) Elf32_Phdr {
   Elf32_Word p_align;
 } Elf32_Phdr;
 
+#define SHT_SYMTAB 2 /* Symbol table */
+
+typedef struct __attribute__((packed)) Elf32_Shdr {
+  Elf32_Word sh_name;
+  Elf32_Word sh_type;
+  Elf32_Word sh_flags;
+  Elf32_Addr sh_addr;
+  Elf32_Off sh_offset;
+  Elf32_Word sh_size;
+  Elf32_Word sh_link;
+  Elf32_Word sh_info;
+  Elf32_Word sh_addralign;
+  Elf32_Word sh_entsize;
+} Elf32_Shdr;
+
+#define STB_GLOBAL 1 /* Global symbol */
+#define SHN_UNDEF 0  /* Undefined section */
+#define ELF32_ST_BIND(info) ((info) >> 4)
+
+typedef struct __attribute__((packed)) Elf32_Sym {
+  Elf32_Word st_name;
+  Elf32_Addr st_value;
+  Elf32_Word st_size;
+  unsigned char st_info;
+  unsigned char st_other;
+  Elf32_Half st_shndx;
+} Elf32_Sym;
+
 static uint32_t fromLE32(uint32_t v)
 {
   uint32_t res;
@@ -135,14 +260,18 @@ static uint16_t fromLE16(uint16_t v)
   return res;
 }
 
-t_ldrError ldrLoadELF(const char *path)
+t_ldrError ldrOpenELF(const char *path, t_ldrImage **outImage)
 {
-  t_ldrError res = LDR_NO_ERROR;
+  return ldrOpenELFFile(fopen(path, "rb"), outImage);
+}
 
-  dbgPrintf("Loading ELF file \"%s\"\n", path);
 
-  FILE *fp = fopen(path, "rb");
-  if (fp == NULL)
+t_ldrError ldrOpenELFFile(FILE *fp, t_ldrImage **outImage)
+{
+  t_ldrError res = LDR_NO_ERROR;
+
+  t_ldrImage *image = ldrNewImage(fp);
+  if (!image)
     return LDR_FILE_ERROR;
 
   Elf32_Ehdr header;
@@ -177,30 +306,17 @@ t_ldrError ldrLoadELF(const char *path)
     Elf32_Word pfilesz = fromLE32(segment.p_filesz);
     Elf32_Word pvaddr = fromLE32(segment.p_vaddr);
     Elf32_Word pmemsz = fromLE32(segment.p_memsz);
-    dbgPrintf("Loaded section at 0x%08" PRIx32 " (size=0x%08" PRIx32
-              ") to 0x%08" PRIx32 " (size=0x%08" PRIx32 ")\n",
-        poffset, pfilesz, pvaddr, pmemsz);
     if (pmemsz > 0) {
-      uint8_t *buf;
-      if (memMapArea(pvaddr, pmemsz, &buf) != MEM_NO_ERROR)
-        goto mem_error;
-      if (pfilesz > 0) {
-        fseek(fp, (long)poffset, SEEK_SET);
-        size_t readsz = MIN(pmemsz, pfilesz);
-        if (fread(buf, readsz, 1, fp) < 1)
-          goto read_error;
-      }
+      res = ldrAddSegment(image, pvaddr, pmemsz, poffset, MIN(pmemsz, pfilesz));
+      if (res != LDR_NO_ERROR)
+        goto cleanup;
     }
   }
 
-  Elf32_Addr entry = fromLE32(header.e_entry);
-  dbgPrintf("Setting the entry point to 0x%" PRIx32 "\n", entry);
-  cpuReset(entry);
+  image->entry = fromLE32(header.e_entry);
+  *outImage = image;
+  return LDR_NO_ERROR;
 
-  goto cleanup;
-mem_error:
-  res = LDR_MEMORY_ERROR;
-  goto cleanup;
 read_error:
   res = LDR_FILE_ERROR;
   goto cleanup;
@@ -210,6 +326,131 @@ invalid_file:
 invalid_arch:
   res = LDR_INVALID_ARCH;
 cleanup:
+  ldrCloseImage(image);
+  return res;
+}
+
+
+t_ldrError ldrLoadELF(t_simContext *ctx, const char *path)
+{
+  dbgPrintf(ctx, "Loading ELF file \"%s\"\n", path);
+
+  t_ldrImage *image;
+  t_ldrError res = ldrOpenELF(path, &image);
+  if (res != LDR_NO_ERROR)
+    return res;
+  res = ldrLoadImage(ctx, image);
+  ldrCloseImage(image);
+  return res;
+}
+
+
+/* Reads the contents of a section into a new buffer, with a terminator so
+ * that strings at its end are always terminated */
+static uint8_t *ldrReadSection(FILE *fp, const Elf32_Shdr *shdr)
+{
+  Elf32_Word size = fromLE32(shdr->sh_size);
+  if (size > 0x8000000)
+    return NULL;
+  uint8_t *buf = malloc((size_t)size + 1);
+  if (!buf)
+    return NULL;
+  if (fseek(fp, (long)fromLE32(shdr->sh_offset), SEEK_SET) < 0 ||
+      (size > 0 && fread(buf, size, 1, fp) < 1)) {
+    free(buf);
+    return NULL;
+  }
+  buf[size] = '\0';
+  return buf;
+}
+
+t_ldrError ldrLoadSymbols(t_simContext *ctx, const char *path)
+{
+  t_ldrError res = LDR_NO_ERROR;
+  Elf32_Shdr *shdrs = NULL;
+  uint8_t *shstrtab = NULL, *symtab = NULL, *strtab = NULL, *lines = NULL;
+  t_symState *sym = NULL;
+
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return LDR_FILE_ERROR;
+  Elf32_Ehdr header;
+  if (fread(&header, sizeof(Elf32_Ehdr), 1, fp) < 1)
+    goto invalid_file;
+  long shnum = fromLE16(header.e_shnum);
+  long shoff = fromLE32(header.e_shoff);
+  long shstrndx = fromLE16(header.e_shstrndx);
+  if (shnum == 0 || fromLE16(header.e_shentsize) != sizeof(Elf32_Shdr) ||
+      shstrndx >= shnum)
+    goto invalid_file;
+  shdrs = malloc(sizeof(Elf32_Shdr) * (size_t)shnum);
+  if (!shdrs)
+    goto memory_error;
+  if (fseek(fp, shoff, SEEK_SET) < 0 ||
+      fread(shdrs, sizeof(Elf32_Shdr), (size_t)shnum, fp) < (size_t)shnum)
+    goto invalid_file;
+  shstrtab = ldrReadSection(fp, &shdrs[shstrndx]);
+  if (!shstrtab)
+    goto invalid_file;
+  Elf32_Word shstrtabSize = fromLE32(shdrs[shstrndx].sh_size);
+
+  sym = newSymState();
+  if (!sym)
+    goto memory_error;
+  for (long i = 0; i < shnum; i++) {
+    Elf32_Word name = fromLE32(shdrs[i].sh_name);
+    if (name < shstrtabSize &&
+        strcmp((char *)shstrtab + name, ".debug_line") == 0) {
+      lines = ldrReadSection(fp, &shdrs[i]);
+      if (!lines)
+        goto invalid_file;
+      /* the rows read before an error are still useful */
+      symAddLineTable(sym, lines, fromLE32(shdrs[i].sh_size));
+      free(lines);
+      lines = NULL;
+    }
+    Elf32_Word link = fromLE32(shdrs[i].sh_link);
+    if (fromLE32(shdrs[i].sh_type) != SHT_SYMTAB || link >= shnum)
+      continue;
+    symtab = ldrReadSection(fp, &shdrs[i]);
+    strtab = ldrReadSection(fp, &shdrs[link]);
+    if (!symtab || !strtab)
+      goto invalid_file;
+    Elf32_Word strtabSize = fromLE32(shdrs[link].sh_size);
+    Elf32_Word numSyms = fromLE32(shdrs[i].sh_size) / sizeof(Elf32_Sym);
+    for (Elf32_Word j = 1; j < numSyms; j++) {
+      Elf32_Sym s;
+      memcpy(&s, symtab + j * sizeof(Elf32_Sym), sizeof(Elf32_Sym));
+      Elf32_Word symName = fromLE32(s.st_name);
+      if (fromLE16(s.st_shndx) == SHN_UNDEF || symName == 0 ||
+          symName >= strtabSize)
+        continue;
+      if (!symAddSymbol(sym, (char *)strtab + symName, fromLE32(s.st_value),
+              ELF32_ST_BIND(s.st_info) == STB_GLOBAL))
+        goto memory_error;
+    }
+    free(symtab);
+    free(strtab);
+    symtab = strtab = NULL;
+  }
+  symFinish(sym);
+  deleteSymState(ctx->sym);
+  ctx->sym = sym;
+  sym = NULL;
+  goto cleanup;
+
+invalid_file:
+  res = LDR_INVALID_FORMAT;
+  goto cleanup;
+memory_error:
+  res = LDR_MEMORY_ERROR;
+cleanup:
+  deleteSymState(sym);
+  free(symtab);
+  free(strtab);
+  free(lines);
+  free(shstrtab);
+  free(shdrs);
   fclose(fp);
   return res;
 }
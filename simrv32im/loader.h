@@ -1,7 +1,9 @@
 #ifndef LOADER_H
 #define LOADER_H
 
+#include <stdio.h>
 #include "memory.h"
+#include "context.h"
 
 typedef int t_ldrError;
 enum {
@@ -20,9 +22,39 @@ enum {
 };
 
 
-t_ldrError ldrLoadBinary(
-    const char *path, t_memAddress baseAddr, t_memAddress entry);
-t_ldrError ldrLoadELF(const char *path);
+/* An executable opened and parsed once, which can then be loaded into any
+ * number of contexts */
+typedef struct {
+  t_memAddress base;
+  t_memSize extent;
+  t_memSize fileOffset;
+  t_memSize fileSize;
+} t_ldrSegment;
+
+typedef struct {
+  FILE *fp;
+  t_memAddress entry;
+  int numSegments;
+  t_ldrSegment *segments;
+} t_ldrImage;
+
+
+t_ldrError ldrOpenBinary(const char *path, t_memAddress baseAddr,
+    t_memAddress entry, t_ldrImage **outImage);
+t_ldrError ldrOpenELF(const char *path, t_ldrImage **outImage);
+/* Same as ldrOpenELF, for an executable already opened for reading from its
+ * start. The image owns the file, which is closed when the image is closed
+ * or if the executable cannot be opened. */
+t_ldrError ldrOpenELFFile(FILE *fp, t_ldrImage **outImage);
+t_ldrError ldrLoadImage(t_simContext *ctx, const t_ldrImage *image);
+void ldrCloseImage(t_ldrImage *image);
+
+t_ldrError ldrLoadBinary(t_simContext *ctx, const char *path,
+    t_memAddress baseAddr, t_memAddress entry);
+t_ldrError ldrLoadELF(t_simContext *ctx, const char *path);
+/* Reads the symbol table and the line table of an ELF executable, if it has
+ * them, for the debugger and the profiler */
+t_ldrError ldrLoadSymbols(t_simContext *ctx, const char *path);
 
 t_ldrFileType ldrDetectExecType(const char *path);
 
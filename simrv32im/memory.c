@@ -1,4 +1,8 @@
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "memory.h"
 
 typedef struct memArea {
@@ -6,11 +10,60 @@ typedef struct memArea {
   t_memAddress baseAddress;
   t_memSize extent;
   uint8_t *buffer;
+  /* host mapping holding the buffer, if it is not allocated with the area */
+  void *mapping;
+  size_t mappingLength;
 } t_memArea;
 
-t_memArea *memAreas = NULL;
+#define MEM_L1_INDEX(addr) ((addr) >> (MEM_PAGE_BITS + MEM_L2_BITS))
+#define MEM_L2_INDEX(addr) (((addr) >> MEM_PAGE_BITS) & ((1 << MEM_L2_BITS) - 1))
 
-t_memAddress memLastFaultAddress = 0;
+
+t_memState *newMemState(void)
+{
+  return calloc(1, sizeof(t_memState));
+}
+
+
+static void memFreeAreas(t_memState *mem)
+{
+  t_memArea *area = mem->areas;
+  while (area) {
+    t_memArea *next = area->next;
+    if (area->mapping)
+      munmap(area->mapping, area->mappingLength);
+    free(area);
+    area = next;
+  }
+  mem->areas = NULL;
+}
+
+
+void deleteMemState(t_memState *mem)
+{
+  if (!mem)
+    return;
+  memFreeAreas(mem);
+  for (int i = 0; i < (1 << MEM_L1_BITS); i++)
+    free(mem->pageTable[i]);
+  free(mem);
+}
+
+
+void memUnmapAll(t_simContext *ctx)
+{
+  t_memState *mem = ctx->mem;
+  memFreeAreas(mem);
+  /* The second level tables are kept, as the next program will most likely
+   * use the same ones */
+  for (int i = 0; i < (1 << MEM_L1_BITS); i++) {
+    if (mem->pageTable[i])
+      memset(mem->pageTable[i], 0, sizeof(t_memArea *) << MEM_L2_BITS);
+  }
+  memset(mem->dataTLB, 0, sizeof(mem->dataTLB));
+  memset(mem->fetchTLB, 0, sizeof(mem->fetchTLB));
+  mem->lastFaultAddress = 0;
+}
 
 
 static t_memAddress memAreaEnd(t_memArea *area)
@@ -19,11 +72,13 @@ static t_memAddress memAreaEnd(t_memArea *area)
 }
 
 
-static t_memArea *memFindArea(t_memAddress addr, t_memSize extent, int isDbg)
+static t_memArea *memFindArea(
+    t_memState *mem, t_memAddress addr, t_memSize extent, int isDbg)
 {
-  t_memArea *curArea = memAreas;
-  while (curArea) {
-    if (curArea->baseAddress <= addr && addr < memAreaEnd(curArea)) {
+  t_memArea **l2Table = mem->pageTable[MEM_L1_INDEX(addr)];
+  t_memArea *curArea = l2Table ? l2Table[MEM_L2_INDEX(addr)] : NULL;
+  while (curArea && curArea->baseAddress <= addr) {
+    if (addr < memAreaEnd(curArea)) {
       if ((addr + extent) <= memAreaEnd(curArea))
         return curArea;
       else
@@ -34,18 +89,17 @@ static t_memArea *memFindArea(t_memAddress addr, t_memSize extent, int isDbg)
 
 fail:
   if (!isDbg)
-    memLastFaultAddress = addr;
+    mem->lastFaultAddress = addr;
   return NULL;
 }
 
 
-t_memError memMapArea(t_memAddress base, t_memSize extent, uint8_t **outBuffer)
+static t_memError memLinkArea(t_memState *mem, t_memArea *newArea)
 {
+  t_memAddress base = newArea->baseAddress;
+  t_memSize extent = newArea->extent;
   t_memArea *prevArea = NULL;
-  t_memArea *nextArea = memAreas;
-
-  if (extent == 0)
-    return MEM_NO_ERROR;
+  t_memArea *nextArea = mem->areas;
 
   while (nextArea) {
     if ((base + extent) <= nextArea->baseAddress)
@@ -58,60 +112,147 @@ t_memError memMapArea(t_memAddress base, t_memSize extent, uint8_t **outBuffer)
       return MEM_EXTENT_MAPPED;
   }
 
+  t_memAddress firstPage = base >> MEM_PAGE_BITS;
+  t_memAddress lastPage = (base + extent - 1) >> MEM_PAGE_BITS;
+  for (t_memAddress l1 = firstPage >> MEM_L2_BITS;
+       l1 <= (lastPage >> MEM_L2_BITS); l1++) {
+    if (mem->pageTable[l1])
+      continue;
+    mem->pageTable[l1] = calloc(1 << MEM_L2_BITS, sizeof(t_memArea *));
+    if (!mem->pageTable[l1])
+      return MEM_OUT_OF_MEMORY;
+  }
+
+  newArea->next = nextArea;
+  if (prevArea)
+    prevArea->next = newArea;
+  else
+    mem->areas = newArea;
+
+  for (t_memAddress page = firstPage; page <= lastPage; page++) {
+    t_memAddress pageAddr = page << MEM_PAGE_BITS;
+    t_memArea **entry =
+        &mem->pageTable[MEM_L1_INDEX(pageAddr)][MEM_L2_INDEX(pageAddr)];
+    if (*entry == NULL || (*entry)->baseAddress > base)
+      *entry = newArea;
+  }
+
+  return MEM_NO_ERROR;
+}
+
+
+t_memError memMapArea(t_simContext *ctx, t_memAddress base, t_memSize extent,
+    uint8_t **outBuffer)
+{
+  if (extent == 0)
+    return MEM_NO_ERROR;
+
   t_memArea *newArea = calloc(1, sizeof(t_memArea) + (size_t)extent);
   if (!newArea)
     return MEM_OUT_OF_MEMORY;
   newArea->baseAddress = base;
   newArea->extent = extent;
   newArea->buffer = (uint8_t *)((void *)newArea) + sizeof(t_memArea);
+
+  t_memError err = memLinkArea(ctx->mem, newArea);
+  if (err != MEM_NO_ERROR) {
+    free(newArea);
+    return err;
+  }
   if (outBuffer)
     *outBuffer = newArea->buffer;
-  newArea->next = nextArea;
-  if (prevArea)
-    prevArea->next = newArea;
-  else
-    memAreas = newArea;
-
   return MEM_NO_ERROR;
 }
 
 
-t_memError memRead8(t_memAddress addr, uint8_t *out)
+/* Creates an area whose buffer starts skew bytes into a host mapping */
+static t_memError memLinkMapping(t_simContext *ctx, t_memAddress base,
+    t_memSize extent, uint8_t *map, size_t mapLen, size_t skew)
 {
-  t_memArea *area = memFindArea(addr, 1, 0);
-  if (!area)
-    return MEM_MAPPING_ERROR;
-  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
-  *out = bufBasePtr[0];
-  return MEM_NO_ERROR;
+  t_memArea *newArea = calloc(1, sizeof(t_memArea));
+  if (!newArea) {
+    munmap(map, mapLen);
+    return MEM_OUT_OF_MEMORY;
+  }
+  newArea->baseAddress = base;
+  newArea->extent = extent;
+  newArea->buffer = map + skew;
+  newArea->mapping = map;
+  newArea->mappingLength = mapLen;
+
+  t_memError err = memLinkArea(ctx->mem, newArea);
+  if (err != MEM_NO_ERROR) {
+    munmap(map, mapLen);
+    free(newArea);
+  }
+  return err;
 }
 
-t_memError memRead16(t_memAddress addr, uint16_t *out)
+
+t_memError memReserveArea(t_simContext *ctx, t_memAddress base,
+    t_memSize extent)
 {
-  t_memArea *area = memFindArea(addr, 2, 0);
-  if (!area)
-    return MEM_MAPPING_ERROR;
-  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
-  *out = (uint16_t)bufBasePtr[0] + (uint16_t)((uint16_t)bufBasePtr[1] << 8);
-  return MEM_NO_ERROR;
+  if (extent == 0)
+    return MEM_NO_ERROR;
+  size_t hostPage = (size_t)sysconf(_SC_PAGESIZE);
+  size_t mapLen = ((size_t)extent + hostPage - 1) & ~(hostPage - 1);
+  uint8_t *map = mmap(NULL, mapLen, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (map == MAP_FAILED)
+    return MEM_OUT_OF_MEMORY;
+  return memLinkMapping(ctx, base, extent, map, mapLen, 0);
 }
 
-t_memError memRead32(t_memAddress addr, uint32_t *out)
+
+t_memError memMapFileArea(t_simContext *ctx, t_memAddress base,
+    t_memSize extent, int fd, t_memSize fileOffset, t_memSize fileSize)
 {
-  t_memArea *area = memFindArea(addr, 4, 0);
-  if (!area)
+  if (extent == 0)
+    return MEM_NO_ERROR;
+  if (fileSize > extent)
+    fileSize = extent;
+
+  /* Mapping a range past the end of the file would fault on access */
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+      (off_t)fileOffset + (off_t)fileSize > st.st_size)
     return MEM_MAPPING_ERROR;
-  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
-  *out = (uint32_t)bufBasePtr[0] + (uint32_t)((uint32_t)bufBasePtr[1] << 8) +
-      (uint32_t)((uint32_t)bufBasePtr[2] << 16) +
-      (uint32_t)((uint32_t)bufBasePtr[3] << 24);
-  return MEM_NO_ERROR;
+
+  /* The host mapping starts at the host page containing the segment, so the
+   * area buffer is offset by the misalignment of the file offset. The whole
+   * extent is first reserved as anonymous zero pages, then the file contents
+   * are mapped copy-on-write over the head of it. */
+  size_t hostPage = (size_t)sysconf(_SC_PAGESIZE);
+  size_t skew = (size_t)fileOffset % hostPage;
+  size_t fileLen = skew + (size_t)fileSize;
+  size_t mapLen = (skew + (size_t)extent + hostPage - 1) & ~(hostPage - 1);
+  uint8_t *map = mmap(NULL, mapLen, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    return MEM_MAPPING_ERROR;
+  if (fileSize > 0) {
+    void *fileMap = mmap(map, fileLen, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_FIXED, fd, (off_t)(fileOffset - skew));
+    if (fileMap == MAP_FAILED) {
+      munmap(map, mapLen);
+      return MEM_MAPPING_ERROR;
+    }
+    /* Clear whatever follows the segment in its last file page, up to the
+     * end of the area */
+    size_t clearEnd = (fileLen + hostPage - 1) & ~(hostPage - 1);
+    if (clearEnd > skew + (size_t)extent)
+      clearEnd = skew + (size_t)extent;
+    if (clearEnd > fileLen)
+      memset(map + fileLen, 0, clearEnd - fileLen);
+  }
+
+  return memLinkMapping(ctx, base, extent, map, mapLen, skew);
 }
 
 
-uint8_t memDebugRead8(t_memAddress addr, int *mapped)
+uint8_t memDebugRead8(t_simContext *ctx, t_memAddress addr, int *mapped)
 {
-  t_memArea *area = memFindArea(addr, 1, 1);
+  t_memArea *area = memFindArea(ctx->mem, addr, 1, 1);
   if (!area) {
     if (mapped)
       *mapped = 0;
@@ -123,9 +264,9 @@ uint8_t memDebugRead8(t_memAddress addr, int *mapped)
   return bufBasePtr[0];
 }
 
-uint16_t memDebugRead16(t_memAddress addr, int *mapped)
+uint16_t memDebugRead16(t_simContext *ctx, t_memAddress addr, int *mapped)
 {
-  t_memArea *area = memFindArea(addr, 2, 1);
+  t_memArea *area = memFindArea(ctx->mem, addr, 2, 1);
   if (!area) {
     if (mapped)
       *mapped = 0;
@@ -137,9 +278,9 @@ uint16_t memDebugRead16(t_memAddress addr, int *mapped)
   return (uint16_t)bufBasePtr[0] + (uint16_t)((uint16_t)bufBasePtr[1] << 8);
 }
 
-uint32_t memDebugRead32(t_memAddress addr, int *mapped)
+uint32_t memDebugRead32(t_simContext *ctx, t_memAddress addr, int *mapped)
 {
-  t_memArea *area = memFindArea(addr, 4, 1);
+  t_memArea *area = memFindArea(ctx->mem, addr, 4, 1);
   if (!area) {
     if (mapped)
       *mapped = 0;
@@ -153,42 +294,58 @@ uint32_t memDebugRead32(t_memAddress addr, int *mapped)
 }
 
 
-t_memError memWrite8(t_memAddress addr, uint8_t in)
+uint8_t *memTLBMiss(
+    t_simContext *ctx, t_memTLBEntry *tlb, t_memAddress addr, t_memSize size)
 {
-  t_memArea *area = memFindArea(addr, 1, 0);
+  t_memArea *area = memFindArea(ctx->mem, addr, size, 0);
   if (!area)
-    return MEM_MAPPING_ERROR;
-  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
-  bufBasePtr[0] = in;
-  return MEM_NO_ERROR;
+    return NULL;
+
+  /* The new entry covers the part of the area inside the page of the
+   * accessed address */
+  t_memAddress pageStart = addr & ~(t_memAddress)(MEM_PAGE_SIZE - 1);
+  t_memAddress start = area->baseAddress > pageStart ? area->baseAddress
+                                                     : pageStart;
+  t_memSize extent = memAreaEnd(area) - start;
+  if (extent > MEM_PAGE_SIZE - (start - pageStart))
+    extent = MEM_PAGE_SIZE - (start - pageStart);
+  t_memTLBEntry *entry = &tlb[MEM_TLB_INDEX(addr)];
+  entry->base = start;
+  entry->extent = extent;
+  entry->buffer = area->buffer + (size_t)(start - area->baseAddress);
+
+  return area->buffer + (size_t)(addr - area->baseAddress);
 }
 
-t_memError memWrite16(t_memAddress addr, uint16_t in)
+
+t_memAddress memGetLastFaultAddress(t_simContext *ctx)
 {
-  t_memArea *area = memFindArea(addr, 2, 0);
-  if (!area)
-    return MEM_MAPPING_ERROR;
-  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
-  bufBasePtr[0] = (uint8_t)(in & 0xFF);
-  bufBasePtr[1] = (uint8_t)((in >> 8) & 0xFF);
-  return MEM_NO_ERROR;
+  return ctx->mem->lastFaultAddress;
 }
 
-t_memError memWrite32(t_memAddress addr, uint32_t in)
+
+bool memGetAreaBounds(t_simContext *ctx, t_memAddress addr,
+    t_memAddress *outBase, t_memSize *outExtent)
 {
-  t_memArea *area = memFindArea(addr, 4, 0);
+  t_memArea *area = memFindArea(ctx->mem, addr, 1, 1);
   if (!area)
-    return MEM_MAPPING_ERROR;
-  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
-  bufBasePtr[0] = (uint8_t)(in & 0xFF);
-  bufBasePtr[1] = (uint8_t)((in >> 8) & 0xFF);
-  bufBasePtr[2] = (uint8_t)((in >> 16) & 0xFF);
-  bufBasePtr[3] = (uint8_t)((in >> 24) & 0xFF);
-  return MEM_NO_ERROR;
+    return false;
+  *outBase = area->baseAddress;
+  *outExtent = area->extent;
+  return true;
 }
 
 
-t_memAddress memGetLastFaultAddress(void)
+bool memGetArea(t_simContext *ctx, int index, t_memAddress *outBase,
+    t_memSize *outExtent, const uint8_t **outBuffer)
 {
-  return memLastFaultAddress;
+  t_memArea *area = ctx->mem->areas;
+  for (; area && index > 0; index--)
+    area = area->next;
+  if (!area)
+    return false;
+  *outBase = area->baseAddress;
+  *outExtent = area->extent;
+  *outBuffer = area->buffer;
+  return true;
 }
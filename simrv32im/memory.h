@@ -1,8 +1,10 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "isa.h"
+#include "context.h"
 
 typedef t_isaUXSize t_memAddress;
 typedef t_memAddress t_memSize;
@@ -15,20 +17,171 @@ enum {
   MEM_MAPPING_ERROR = -3,
 };
 
-t_memError memMapArea(t_memAddress base, t_memSize extent, uint8_t **outBuffer);
+/* Software TLB. Each entry maps a range of guest addresses, contained in a
+ * single page and a single area, to the host buffer holding it. Separate
+ * TLBs are used for instruction fetches and data accesses, so that code and
+ * data sharing the same page do not evict each other. */
 
-t_memError memRead8(t_memAddress addr, uint8_t *out);
-t_memError memRead16(t_memAddress addr, uint16_t *out);
-t_memError memRead32(t_memAddress addr, uint32_t *out);
+#define MEM_PAGE_BITS 12
+#define MEM_PAGE_SIZE (1 << MEM_PAGE_BITS)
+#define MEM_TLB_BITS 6
+#define MEM_TLB_SIZE (1 << MEM_TLB_BITS)
+#define MEM_TLB_INDEX(addr) (((addr) >> MEM_PAGE_BITS) & (MEM_TLB_SIZE - 1))
 
-uint8_t memDebugRead8(t_memAddress addr, int *mapped);
-uint16_t memDebugRead16(t_memAddress addr, int *mapped);
-uint32_t memDebugRead32(t_memAddress addr, int *mapped);
+typedef struct {
+  t_memAddress base;
+  t_memSize extent;
+  uint8_t *buffer;
+} t_memTLBEntry;
 
-t_memError memWrite8(t_memAddress addr, uint8_t in);
-t_memError memWrite16(t_memAddress addr, uint16_t in);
-t_memError memWrite32(t_memAddress addr, uint32_t in);
+/* Two-level page table. Each page points to the first area (in address
+ * order) which overlaps it; areas after it in the list may overlap the same
+ * page when they are not page-aligned. */
+#define MEM_L2_BITS 10
+#define MEM_L1_BITS (32 - MEM_PAGE_BITS - MEM_L2_BITS)
 
-t_memAddress memGetLastFaultAddress(void);
+typedef struct memState {
+  t_memTLBEntry dataTLB[MEM_TLB_SIZE];
+  t_memTLBEntry fetchTLB[MEM_TLB_SIZE];
+  struct memArea *areas;
+  struct memArea **pageTable[1 << MEM_L1_BITS];
+  t_memAddress lastFaultAddress;
+} t_memState;
+
+
+t_memState *newMemState(void);
+void deleteMemState(t_memState *mem);
+/* Unmaps all the areas, leaving the memory empty as in a new context */
+void memUnmapAll(t_simContext *ctx);
+
+t_memError memMapArea(t_simContext *ctx, t_memAddress base, t_memSize extent,
+    uint8_t **outBuffer);
+t_memError memMapFileArea(t_simContext *ctx, t_memAddress base,
+    t_memSize extent, int fd, t_memSize fileOffset, t_memSize fileSize);
+/* Maps a zero-filled area whose host memory is only allocated when each of
+ * its pages is first written */
+t_memError memReserveArea(t_simContext *ctx, t_memAddress base,
+    t_memSize extent);
+
+uint8_t memDebugRead8(t_simContext *ctx, t_memAddress addr, int *mapped);
+uint16_t memDebugRead16(t_simContext *ctx, t_memAddress addr, int *mapped);
+uint32_t memDebugRead32(t_simContext *ctx, t_memAddress addr, int *mapped);
+
+t_memAddress memGetLastFaultAddress(t_simContext *ctx);
+/* Finds the bounds of the area containing addr; returns false if addr is not
+ * mapped */
+bool memGetAreaBounds(t_simContext *ctx, t_memAddress addr,
+    t_memAddress *outBase, t_memSize *outExtent);
+/* Gets the bounds and the contents of the index-th area in address order;
+ * returns false if there are not as many areas */
+bool memGetArea(t_simContext *ctx, int index, t_memAddress *outBase,
+    t_memSize *outExtent, const uint8_t **outBuffer);
+
+
+uint8_t *memTLBMiss(
+    t_simContext *ctx, t_memTLBEntry *tlb, t_memAddress addr, t_memSize size);
+
+static inline uint8_t *memTranslate(
+    t_simContext *ctx, t_memTLBEntry *tlb, t_memAddress addr, t_memSize size)
+{
+  t_memTLBEntry *entry = &tlb[MEM_TLB_INDEX(addr)];
+  t_memSize offset = addr - entry->base;
+  if (offset < entry->extent && entry->extent - offset >= size)
+    return entry->buffer + offset;
+  return memTLBMiss(ctx, tlb, addr, size);
+}
+
+
+static inline t_memError memRead8(
+    t_simContext *ctx, t_memAddress addr, uint8_t *out)
+{
+  uint8_t *bufBasePtr = memTranslate(ctx, ctx->mem->dataTLB, addr, 1);
+  if (!bufBasePtr)
+    return MEM_MAPPING_ERROR;
+  *out = bufBasePtr[0];
+  return MEM_NO_ERROR;
+}
+
+static inline t_memError memRead16(
+    t_simContext *ctx, t_memAddress addr, uint16_t *out)
+{
+  uint8_t *bufBasePtr = memTranslate(ctx, ctx->mem->dataTLB, addr, 2);
+  if (!bufBasePtr)
+    return MEM_MAPPING_ERROR;
+  *out = (uint16_t)bufBasePtr[0] + (uint16_t)((uint16_t)bufBasePtr[1] << 8);
+  return MEM_NO_ERROR;
+}
+
+static inline uint32_t memLoadLE32(const uint8_t *bufBasePtr)
+{
+  return (uint32_t)bufBasePtr[0] + (uint32_t)((uint32_t)bufBasePtr[1] << 8) +
+      (uint32_t)((uint32_t)bufBasePtr[2] << 16) +
+      (uint32_t)((uint32_t)bufBasePtr[3] << 24);
+}
+
+static inline t_memError memRead32(
+    t_simContext *ctx, t_memAddress addr, uint32_t *out)
+{
+  uint8_t *bufBasePtr = memTranslate(ctx, ctx->mem->dataTLB, addr, 4);
+  if (!bufBasePtr)
+    return MEM_MAPPING_ERROR;
+  *out = memLoadLE32(bufBasePtr);
+  return MEM_NO_ERROR;
+}
+
+static inline t_memError memFetch16(
+    t_simContext *ctx, t_memAddress addr, uint16_t *out)
+{
+  uint8_t *bufBasePtr = memTranslate(ctx, ctx->mem->fetchTLB, addr, 2);
+  if (!bufBasePtr)
+    return MEM_MAPPING_ERROR;
+  *out = (uint16_t)bufBasePtr[0] + (uint16_t)((uint16_t)bufBasePtr[1] << 8);
+  return MEM_NO_ERROR;
+}
+
+static inline t_memError memFetch32(
+    t_simContext *ctx, t_memAddress addr, uint32_t *out)
+{
+  uint8_t *bufBasePtr = memTranslate(ctx, ctx->mem->fetchTLB, addr, 4);
+  if (!bufBasePtr)
+    return MEM_MAPPING_ERROR;
+  *out = memLoadLE32(bufBasePtr);
+  return MEM_NO_ERROR;
+}
+
+
+static inline t_memError memWrite8(
+    t_simContext *ctx, t_memAddress addr, uint8_t in)
+{
+  uint8_t *bufBasePtr = memTranslate(ctx, ctx->mem->dataTLB, addr, 1);
+  if (!bufBasePtr)
+    return MEM_MAPPING_ERROR;
+  bufBasePtr[0] = in;
+  return MEM_NO_ERROR;
+}
+
+static inline t_memError memWrite16(
+    t_simContext *ctx, t_memAddress addr, uint16_t in)
+{
+  uint8_t *bufBasePtr = memTranslate(ctx, ctx->mem->dataTLB, addr, 2);
+  if (!bufBasePtr)
+    return MEM_MAPPING_ERROR;
+  bufBasePtr[0] = (uint8_t)(in & 0xFF);
+  bufBasePtr[1] = (uint8_t)((in >> 8) & 0xFF);
+  return MEM_NO_ERROR;
+}
+
+static inline t_memError memWrite32(
+    t_simContext *ctx, t_memAddress addr, uint32_t in)
+{
+  uint8_t *bufBasePtr = memTranslate(ctx, ctx->mem->dataTLB, addr, 4);
+  if (!bufBasePtr)
+    return MEM_MAPPING_ERROR;
+  bufBasePtr[0] = (uint8_t)(in & 0xFF);
+  bufBasePtr[1] = (uint8_t)((in >> 8) & 0xFF);
+  bufBasePtr[2] = (uint8_t)((in >> 16) & 0xFF);
+  bufBasePtr[3] = (uint8_t)((in >> 24) & 0xFF);
+  return MEM_NO_ERROR;
+}
 
 #endif
@@ -0,0 +1,410 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include "profiler.h"
+#include "cpu.h"
+#include "isa.h"
+#include "symbols.h"
+
+#define PROF_MAX_LOOPS 10
+
+typedef struct {
+  uint32_t slot;
+  uint64_t count;
+} t_profEntry;
+
+typedef struct {
+  const char *file;
+  int line;
+  uint64_t count;
+  /* largest count of a single instruction of the line: the number of times
+   * the line was executed */
+  uint64_t runs;
+} t_profLine;
+
+typedef struct {
+  t_memAddress start;
+  t_memAddress end;
+  uint64_t iterations;
+  uint64_t instructions;
+} t_profLoop;
+
+
+t_profState *newProfState(t_memAddress base, t_memSize extent)
+{
+  t_profState *prof = calloc(1, sizeof(t_profState));
+  if (!prof)
+    return NULL;
+  prof->base = base;
+  prof->numSlots = extent / 2;
+  prof->arrivals = calloc(prof->numSlots + 1, sizeof(uint64_t));
+  prof->leaves = calloc(prof->numSlots + 1, sizeof(uint64_t));
+  if (!prof->arrivals || !prof->leaves) {
+    deleteProfState(prof);
+    return NULL;
+  }
+  return prof;
+}
+
+
+void deleteProfState(t_profState *prof)
+{
+  if (!prof)
+    return;
+  free(prof->arrivals);
+  free(prof->leaves);
+  free(prof);
+}
+
+
+bool profEnable(t_simContext *ctx, t_memAddress base, t_memSize extent)
+{
+  t_profState *prof = newProfState(base, extent);
+  if (!prof)
+    return false;
+  deleteProfState(ctx->prof);
+  ctx->prof = prof;
+  cpuSetBlockTranslation(ctx, false);
+  return true;
+}
+
+
+void profCountResume(t_profState *prof, t_memAddress pc)
+{
+  uint32_t slot = (pc - prof->base) >> 1;
+  if (slot < prof->numSlots && (pc & 1) == 0)
+    prof->arrivals[slot]++;
+}
+
+
+void profCountStop(t_profState *prof, t_memAddress pc, bool executed)
+{
+  uint32_t slot = (pc - prof->base) >> 1;
+  if (slot >= prof->numSlots || (pc & 1) != 0)
+    return;
+  if (executed)
+    prof->leaves[slot]++;
+  else
+    prof->arrivals[slot]--;
+}
+
+
+static int profCompareEntries(const void *a, const void *b)
+{
+  const t_profEntry *ea = a, *eb = b;
+  if (ea->count != eb->count)
+    return ea->count < eb->count ? 1 : -1;
+  return ea->slot < eb->slot ? -1 : ea->slot > eb->slot;
+}
+
+
+static int profCompareLoops(const void *a, const void *b)
+{
+  const t_profLoop *la = a, *lb = b;
+  if (la->instructions != lb->instructions)
+    return la->instructions < lb->instructions ? 1 : -1;
+  return la->start < lb->start ? -1 : la->start > lb->start;
+}
+
+
+static int profCompareLinesBySource(const void *a, const void *b)
+{
+  const t_profLine *la = a, *lb = b;
+  if (la->file != lb->file)
+    return la->file < lb->file ? -1 : 1;
+  return la->line < lb->line ? -1 : la->line > lb->line;
+}
+
+static int profCompareLinesByCount(const void *a, const void *b)
+{
+  const t_profLine *la = a, *lb = b;
+  if (la->count != lb->count)
+    return la->count < lb->count ? 1 : -1;
+  return profCompareLinesBySource(a, b);
+}
+
+
+static double profPercent(uint64_t count, uint64_t total)
+{
+  return total ? (double)count * 100.0 / (double)total : 0.0;
+}
+
+
+/* Reads the instruction at pc, translating it if it is compressed */
+static uint32_t profReadInstruction(t_simContext *ctx, t_memAddress pc)
+{
+  uint32_t inst = cpuDebugReadInstruction(ctx, pc);
+  if (ISA_INST_IS_COMPRESSED(inst) &&
+      !isaExpandCompressed((uint16_t)inst, &inst))
+    return 0;
+  return inst;
+}
+
+
+static const char *profOpcodeName(uint32_t opcode)
+{
+  switch (opcode) {
+    case ISA_INST_OPCODE_LOAD:
+      return "LOAD";
+    case ISA_INST_OPCODE_OPIMM:
+      return "OP-IMM";
+    case ISA_INST_OPCODE_AUIPC:
+      return "AUIPC";
+    case ISA_INST_OPCODE_STORE:
+      return "STORE";
+    case ISA_INST_OPCODE_OP:
+      return "OP";
+    case ISA_INST_OPCODE_LUI:
+      return "LUI";
+    case ISA_INST_OPCODE_BRANCH:
+      return "BRANCH";
+    case ISA_INST_OPCODE_JALR:
+      return "JALR";
+    case ISA_INST_OPCODE_JAL:
+      return "JAL";
+    case ISA_INST_OPCODE_SYSTEM:
+      return "SYSTEM";
+  }
+  return NULL;
+}
+
+
+/* Loops are identified by their backward jumps: a loop spans from the target
+ * of the jump to the jump itself, and runs once for every time the jump was
+ * taken */
+static int profFindLoops(
+    t_simContext *ctx, const uint64_t *prefix, t_profLoop *loops)
+{
+  t_profState *prof = ctx->prof;
+  int numLoops = 0;
+
+  for (uint32_t i = 0; i < prof->numSlots; i++) {
+    uint64_t iterations = prof->leaves[i];
+    if (iterations == 0)
+      continue;
+    t_memAddress pc = prof->base + i * 2;
+    uint32_t inst = profReadInstruction(ctx, pc);
+    int32_t offset;
+    if (ISA_INST_OPCODE(inst) == ISA_INST_OPCODE_BRANCH)
+      offset = (int32_t)ISA_INST_B_IMM13_SEXT(inst);
+    else if (ISA_INST_OPCODE(inst) == ISA_INST_OPCODE_JAL)
+      offset = (int32_t)ISA_INST_J_IMM21_SEXT(inst);
+    else
+      continue;
+    if (offset > 0 || (uint32_t)(-offset / 2) > i)
+      continue;
+
+    t_profLoop loop;
+    loop.start = pc + (t_memAddress)offset;
+    loop.end = pc;
+    loop.iterations = iterations;
+    loop.instructions = prefix[i + 1] - prefix[i + (uint32_t)(offset / 2)];
+    if (numLoops < PROF_MAX_LOOPS) {
+      loops[numLoops++] = loop;
+    } else if (profCompareLoops(&loop, &loops[numLoops - 1]) < 0) {
+      loops[numLoops - 1] = loop;
+    } else {
+      continue;
+    }
+    qsort(loops, (size_t)numLoops, sizeof(t_profLoop), profCompareLoops);
+  }
+  return numLoops;
+}
+
+
+/* Writes the lines of the source program which the instructions in the loop
+ * were compiled from, as "file:first-last" */
+static void profLoopSource(t_simContext *ctx, const t_profLoop *loop,
+    char *buf, size_t bufSize)
+{
+  const char *file = NULL;
+  int first = 0, last = 0;
+  for (t_memAddress pc = loop->start; pc <= loop->end; pc += 2) {
+    int line;
+    const char *lineFile = symFindLine(ctx, pc, &line);
+    if (!lineFile || (file && lineFile != file))
+      continue;
+    if (!file || line < first)
+      first = line;
+    if (!file || line > last)
+      last = line;
+    file = lineFile;
+  }
+  if (!file)
+    snprintf(buf, bufSize, "-");
+  else if (first == last)
+    snprintf(buf, bufSize, "%s:%d", file, first);
+  else
+    snprintf(buf, bufSize, "%s:%d-%d", file, first, last);
+}
+
+
+/* Sums the execution counts of the instructions compiled from each line of
+ * the source program, sorted by frequency, together with the number of times
+ * each line was executed. acse reads this section with -fprofile-use. */
+static void profWriteLines(t_simContext *ctx, const t_profEntry *entries,
+    uint32_t numEntries, uint64_t total, FILE *fp)
+{
+  t_profState *prof = ctx->prof;
+  t_profLine *lines = malloc(sizeof(t_profLine) * (numEntries + 1));
+  if (!lines)
+    return;
+  uint32_t numLines = 0;
+  for (uint32_t i = 0; i < numEntries; i++) {
+    t_memAddress pc = prof->base + entries[i].slot * 2;
+    int line;
+    const char *file = symFindLine(ctx, pc, &line);
+    if (!file)
+      continue;
+    lines[numLines].file = file;
+    lines[numLines].line = line;
+    lines[numLines].runs = entries[i].count;
+    lines[numLines++].count = entries[i].count;
+  }
+  if (numLines == 0) {
+    free(lines);
+    return;
+  }
+
+  qsort(lines, numLines, sizeof(t_profLine), profCompareLinesBySource);
+  uint32_t numMerged = 0;
+  for (uint32_t i = 0; i < numLines; i++) {
+    if (numMerged > 0 && profCompareLinesBySource(
+                             &lines[numMerged - 1], &lines[i]) == 0) {
+      lines[numMerged - 1].count += lines[i].count;
+      if (lines[i].runs > lines[numMerged - 1].runs)
+        lines[numMerged - 1].runs = lines[i].runs;
+    } else {
+      lines[numMerged++] = lines[i];
+    }
+  }
+  qsort(lines, numMerged, sizeof(t_profLine), profCompareLinesByCount);
+
+  fprintf(fp, "\nSource lines by execution count:\n");
+  fprintf(fp, "  %14s %8s %14s  %s\n", "count", "%", "runs", "line");
+  for (uint32_t i = 0; i < numMerged; i++)
+    fprintf(fp, "  %14" PRIu64 " %7.2f%% %14" PRIu64 "  %s:%d\n",
+        lines[i].count, profPercent(lines[i].count, total), lines[i].runs,
+        lines[i].file, lines[i].line);
+  free(lines);
+}
+
+
+void profWriteReport(t_simContext *ctx, FILE *fp)
+{
+  t_profState *prof = ctx->prof;
+  uint64_t opcodeCounts[128] = {0};
+  uint64_t *prefix = malloc(sizeof(uint64_t) * (prof->numSlots + 1));
+  t_profEntry *entries = malloc(sizeof(t_profEntry) * (prof->numSlots + 1));
+  if (!prefix || !entries) {
+    fprintf(stderr, "Out of memory while writing the profile\n");
+    free(prefix);
+    free(entries);
+    return;
+  }
+
+  /* prefix[i] is the number of executions of the instructions before slot i,
+   * count the number of executions of the one in the slot. The second slot
+   * of an instruction which is not compressed is skipped: nothing jumps
+   * there, so the count falls through it unchanged. */
+  uint32_t numEntries = 0;
+  uint64_t count = 0;
+  uint32_t nextInst = 0;
+  prefix[0] = 0;
+  for (uint32_t i = 0; i < prof->numSlots; i++) {
+    if (i > 0)
+      count -= prof->leaves[i - 1];
+    count += prof->arrivals[i];
+    if (i < nextInst && prof->arrivals[i] == 0) {
+      prefix[i + 1] = prefix[i];
+      continue;
+    }
+    prefix[i + 1] = prefix[i] + count;
+    t_memAddress pc = prof->base + i * 2;
+    nextInst = i + ISA_INST_LENGTH(cpuDebugReadInstruction(ctx, pc)) / 2;
+    if (count == 0)
+      continue;
+    uint32_t inst = profReadInstruction(ctx, pc);
+    opcodeCounts[ISA_INST_OPCODE(inst)] += count;
+    entries[numEntries].slot = i;
+    entries[numEntries++].count = count;
+  }
+  uint64_t total = prefix[prof->numSlots];
+
+  fprintf(fp, "Profile of 0x%08" PRIx32 "-0x%08" PRIx32 ": %" PRIu64
+              " instructions executed\n",
+      prof->base, prof->base + prof->numSlots * 2, total);
+  uint64_t allInsts = cpuGetInstructionCount(ctx);
+  if (allInsts > total)
+    fprintf(fp, "  %" PRIu64 " more outside of the profiled range\n",
+        allInsts - total);
+
+  uint64_t otherOpcodes = 0;
+  for (uint32_t i = 0; i < 128; i++) {
+    if (opcodeCounts[i] && !profOpcodeName(i)) {
+      otherOpcodes += opcodeCounts[i];
+      opcodeCounts[i] = 0;
+    }
+  }
+  t_profEntry opcodes[128];
+  int numOpcodes = 0;
+  for (uint32_t i = 0; i < 128; i++) {
+    if (opcodeCounts[i]) {
+      opcodes[numOpcodes].slot = i;
+      opcodes[numOpcodes++].count = opcodeCounts[i];
+    }
+  }
+  qsort(opcodes, (size_t)numOpcodes, sizeof(t_profEntry), profCompareEntries);
+  fprintf(fp, "\nInstructions by opcode:\n");
+  fprintf(fp, "  %-10s %14s %8s\n", "opcode", "count", "%");
+  for (int i = 0; i < numOpcodes; i++)
+    fprintf(fp, "  %-10s %14" PRIu64 " %7.2f%%\n",
+        profOpcodeName(opcodes[i].slot), opcodes[i].count,
+        profPercent(opcodes[i].count, total));
+  if (otherOpcodes)
+    fprintf(fp, "  %-10s %14" PRIu64 " %7.2f%%\n", "other", otherOpcodes,
+        profPercent(otherOpcodes, total));
+
+  t_profLoop loops[PROF_MAX_LOOPS];
+  int numLoops = profFindLoops(ctx, prefix, loops);
+  fprintf(fp, "\nHot loops:\n");
+  fprintf(fp, "  %-10s %-10s %14s %14s %8s  %s\n", "start", "end",
+      "iterations", "instructions", "%", "source");
+  for (int i = 0; i < numLoops; i++) {
+    char source[128];
+    profLoopSource(ctx, &loops[i], source, sizeof(source));
+    fprintf(fp,
+        "  0x%08" PRIx32 " 0x%08" PRIx32 " %14" PRIu64 " %14" PRIu64
+        " %7.2f%%  %s\n",
+        loops[i].start, loops[i].end, loops[i].iterations,
+        loops[i].instructions, profPercent(loops[i].instructions, total),
+        source);
+  }
+
+  qsort(entries, numEntries, sizeof(t_profEntry), profCompareEntries);
+  profWriteLines(ctx, entries, numEntries, total, fp);
+  fprintf(fp, "\nInstructions by execution count:\n");
+  fprintf(fp, "  %-10s %14s %8s %8s  %s\n", "address", "count", "%", "taken",
+      "instruction");
+  for (uint32_t i = 0; i < numEntries; i++) {
+    uint32_t slot = entries[i].slot;
+    t_memAddress pc = prof->base + slot * 2;
+    uint32_t inst = profReadInstruction(ctx, pc);
+    char disasm[80];
+    isaDisassemble(cpuDebugReadInstruction(ctx, pc), disasm, sizeof(disasm));
+    char taken[16] = "";
+    if (ISA_INST_OPCODE(inst) == ISA_INST_OPCODE_BRANCH)
+      snprintf(taken, sizeof(taken), "%.2f%%",
+          profPercent(prof->leaves[slot], entries[i].count));
+    char where[96] = "";
+    const t_symSymbol *symbol = symFindSymbol(ctx, pc);
+    if (symbol)
+      snprintf(where, sizeof(where), "  <%s+0x%" PRIx32 ">", symbol->name,
+          pc - symbol->address);
+    fprintf(fp, "  0x%08" PRIx32 " %14" PRIu64 " %7.2f%% %8s  %-*s%s\n", pc,
+        entries[i].count, profPercent(entries[i].count, total), taken,
+        symbol ? 28 : 0, disasm, where);
+  }
+
+  free(prefix);
+  free(entries);
+}
@@ -0,0 +1,57 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "memory.h"
+#include "context.h"
+
+/* Profile of the instructions in a range of addresses (normally the text of
+ * the program), in arrays indexed by halfword offset from the start of the
+ * range, since compressed instructions are only 2 bytes long.
+ *   Only the transfers of control are counted, which is much cheaper than
+ * counting every instruction: arrivals holds the number of times execution
+ * jumped to or resumed at each instruction, minus the number of times it
+ * stopped before executing it, and leaves the number of times each
+ * instruction was followed by anything else than the next one. The number
+ * of executions of each instruction follows from those of the previous one,
+ * since all the others fall through. */
+typedef struct profState {
+  t_memAddress base;
+  uint32_t numSlots;
+  uint64_t *arrivals;
+  uint64_t *leaves;
+} t_profState;
+
+
+t_profState *newProfState(t_memAddress base, t_memSize extent);
+void deleteProfState(t_profState *prof);
+
+/* Starts profiling the instructions executed in the range of addresses.
+ * Block translation is disabled while profiling. */
+bool profEnable(t_simContext *ctx, t_memAddress base, t_memSize extent);
+
+/* Writes the execution counts sorted by frequency, together with the counts
+ * per opcode and the hottest loops */
+void profWriteReport(t_simContext *ctx, FILE *fp);
+
+
+static inline void profCountJump(
+    t_profState *prof, t_memAddress from, t_memAddress to)
+{
+  uint32_t slot = (from - prof->base) >> 1;
+  if (slot < prof->numSlots)
+    prof->leaves[slot]++;
+  slot = (to - prof->base) >> 1;
+  if (slot < prof->numSlots && (to & 1) == 0)
+    prof->arrivals[slot]++;
+}
+
+/* Execution resumes at pc after being stopped */
+void profCountResume(t_profState *prof, t_memAddress pc);
+/* Execution stops at pc, after executing the instruction there if executed
+ * is true or before it otherwise */
+void profCountStop(t_profState *prof, t_memAddress pc, bool executed);
+
+#endif
@@ -0,0 +1,616 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+#include "context.h"
+#include "cpu.h"
+#include "loader.h"
+
+/* Number of executables kept loaded. When all of them are in use by a job,
+ * a new executable is loaded for its job alone. */
+#define SRV_CACHE_SIZE 64
+/* Connections accepted and waiting for an idle thread */
+#define SRV_QUEUE_SIZE 64
+
+
+static void srvPut32(uint8_t *buf, uint32_t value)
+{
+  for (int i = 0; i < 4; i++)
+    buf[i] = (uint8_t)(value >> (i * 8));
+}
+
+static void srvPut64(uint8_t *buf, uint64_t value)
+{
+  srvPut32(buf, (uint32_t)value);
+  srvPut32(buf + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t srvGet32(const uint8_t *buf)
+{
+  return (uint32_t)buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 |
+      (uint32_t)buf[3] << 24;
+}
+
+static uint64_t srvGet64(const uint8_t *buf)
+{
+  return (uint64_t)srvGet32(buf) | (uint64_t)srvGet32(buf + 4) << 32;
+}
+
+
+/* Reads exactly len bytes; returns false at the end of the file or on an
+ * error */
+static bool srvReadAll(int fd, void *buf, size_t len)
+{
+  size_t done = 0;
+  while (done < len) {
+    ssize_t res = read(fd, (uint8_t *)buf + done, len - done);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res <= 0)
+      return false;
+    done += (size_t)res;
+  }
+  return true;
+}
+
+static bool srvWriteAll(int fd, const void *buf, size_t len)
+{
+  size_t done = 0;
+  while (done < len) {
+    ssize_t res = write(fd, (const uint8_t *)buf + done, len - done);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res <= 0)
+      return false;
+    done += (size_t)res;
+  }
+  return true;
+}
+
+
+/* Makes a buffer hold at least size bytes, keeping its contents */
+static bool srvReserve(void **buf, size_t *capacity, size_t size)
+{
+  if (size <= *capacity)
+    return true;
+  size_t newCapacity = *capacity ? *capacity : 4096;
+  while (newCapacity < size)
+    newCapacity *= 2;
+  void *newBuf = realloc(*buf, newCapacity);
+  if (!newBuf)
+    return false;
+  *buf = newBuf;
+  *capacity = newCapacity;
+  return true;
+}
+
+
+/* Reads the whole contents of a file, up to maxLength bytes, into a buffer
+ * which is grown as needed */
+static bool srvReadFile(int fd, size_t maxLength, void **buf,
+    size_t *capacity, size_t *outLength)
+{
+  size_t len = 0;
+  for (;;) {
+    if (!srvReserve(buf, capacity, len + 4096))
+      return false;
+    size_t avail = *capacity - len;
+    ssize_t res = read(fd, (uint8_t *)*buf + len, avail);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res < 0)
+      return false;
+    if (res == 0)
+      break;
+    len += (size_t)res;
+    if (len > maxLength)
+      return false;
+  }
+  *outLength = len;
+  return true;
+}
+
+
+/* FNV-1a, which is only used to find the candidates in the cache, as their
+ * contents are then compared */
+static uint64_t srvHash(const uint8_t *data, size_t len)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+
+typedef struct {
+  uint64_t hash;
+  size_t length;
+  uint8_t *contents;
+  t_ldrImage *image;
+  /* number of jobs using the image */
+  int users;
+  uint64_t lastUse;
+  bool cached;
+} t_srvImage;
+
+typedef struct {
+  t_srvImage *entries[SRV_CACHE_SIZE];
+  uint64_t clock;
+  pthread_mutex_t lock;
+} t_srvCache;
+
+
+static void srvFreeImage(t_srvImage *img)
+{
+  ldrCloseImage(img->image);
+  free(img->contents);
+  free(img);
+}
+
+
+/* Loads an executable from its contents, which are copied to a temporary
+ * file so that the image does not depend on the file it came from */
+static t_srvImage *srvNewImage(
+    const uint8_t *data, size_t len, uint64_t hash, t_svStatus *outError)
+{
+  *outError = SRV_STATUS_FILE_ERROR;
+  t_srvImage *img = calloc(1, sizeof(t_srvImage));
+  if (!img)
+    return NULL;
+  img->hash = hash;
+  img->length = len;
+  img->contents = malloc(len ? len : 1);
+  FILE *fp = tmpfile();
+  if (!img->contents || !fp || fwrite(data, 1, len, fp) < len ||
+      fflush(fp) != 0) {
+    if (fp)
+      fclose(fp);
+    free(img->contents);
+    free(img);
+    return NULL;
+  }
+  memcpy(img->contents, data, len);
+  rewind(fp);
+  if (ldrOpenELFFile(fp, &img->image) != LDR_NO_ERROR) {
+    *outError = SRV_STATUS_LOAD_ERROR;
+    free(img->contents);
+    free(img);
+    return NULL;
+  }
+  return img;
+}
+
+
+/* Returns the image of the executable with the given contents, loading it
+ * if it is not in the cache. The least recently used image which is not in
+ * use makes room for it. */
+static t_srvImage *srvAcquireImage(t_srvCache *cache, const uint8_t *data,
+    size_t len, t_svStatus *outError)
+{
+  uint64_t hash = srvHash(data, len);
+  pthread_mutex_lock(&cache->lock);
+  cache->clock++;
+
+  t_srvImage *img = NULL;
+  for (int i = 0; i < SRV_CACHE_SIZE && !img; i++) {
+    t_srvImage *entry = cache->entries[i];
+    if (entry && entry->hash == hash && entry->length == len &&
+        memcmp(entry->contents, data, len) == 0)
+      img = entry;
+  }
+  if (!img) {
+    img = srvNewImage(data, len, hash, outError);
+    int victim = -1;
+    for (int i = 0; i < SRV_CACHE_SIZE && img; i++) {
+      t_srvImage *entry = cache->entries[i];
+      if (!entry) {
+        victim = i;
+        break;
+      }
+      if (entry->users == 0 &&
+          (victim < 0 || entry->lastUse < cache->entries[victim]->lastUse))
+        victim = i;
+    }
+    if (victim >= 0) {
+      if (cache->entries[victim])
+        srvFreeImage(cache->entries[victim]);
+      cache->entries[victim] = img;
+      img->cached = true;
+    }
+  }
+
+  if (img) {
+    img->users++;
+    img->lastUse = cache->clock;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return img;
+}
+
+
+static void srvReleaseImage(t_srvCache *cache, t_srvImage *img)
+{
+  pthread_mutex_lock(&cache->lock);
+  img->users--;
+  if (!img->cached && img->users == 0)
+    srvFreeImage(img);
+  pthread_mutex_unlock(&cache->lock);
+}
+
+
+/* Connections are served in the order they are accepted by the first idle
+ * thread */
+typedef struct {
+  const t_srvOptions *opts;
+  t_srvCache cache;
+  int queue[SRV_QUEUE_SIZE];
+  int queueHead;
+  int queueLength;
+  pthread_mutex_t lock;
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+} t_srvServer;
+
+/* The state of each thread is kept from one job to the next, so that a job
+ * usually needs no allocation */
+typedef struct {
+  t_srvServer *srv;
+  t_simContext *ctx;
+  void *exec;
+  size_t execCapacity;
+  void *file;
+  size_t fileCapacity;
+  void *input;
+  size_t inputCapacity;
+} t_srvWorker;
+
+
+static void srvPutConnection(t_srvServer *srv, int fd)
+{
+  pthread_mutex_lock(&srv->lock);
+  while (srv->queueLength == SRV_QUEUE_SIZE)
+    pthread_cond_wait(&srv->notFull, &srv->lock);
+  srv->queue[(srv->queueHead + srv->queueLength++) % SRV_QUEUE_SIZE] = fd;
+  pthread_cond_signal(&srv->notEmpty);
+  pthread_mutex_unlock(&srv->lock);
+}
+
+
+static int srvTakeConnection(t_srvServer *srv)
+{
+  pthread_mutex_lock(&srv->lock);
+  while (srv->queueLength == 0)
+    pthread_cond_wait(&srv->notEmpty, &srv->lock);
+  int fd = srv->queue[srv->queueHead];
+  srv->queueHead = (srv->queueHead + 1) % SRV_QUEUE_SIZE;
+  srv->queueLength--;
+  pthread_cond_signal(&srv->notFull);
+  pthread_mutex_unlock(&srv->lock);
+  return fd;
+}
+
+
+/* Gets the contents of the executable of a job. A path is opened by the
+ * server, so it is relative to the directory of the server. */
+static bool srvGetExecutable(t_srvWorker *w, uint32_t kind,
+    size_t execLength, const uint8_t **outData, size_t *outLength)
+{
+  if (kind == SRV_JOB_ELF) {
+    *outData = w->exec;
+    *outLength = execLength;
+    return true;
+  }
+  ((char *)w->exec)[execLength] = '\0';
+  int fd = open((char *)w->exec, O_RDONLY);
+  if (fd < 0)
+    return false;
+  bool res = srvReadFile(
+      fd, SRV_MAX_EXEC_LENGTH, &w->file, &w->fileCapacity, outLength);
+  close(fd);
+  *outData = w->file;
+  return res;
+}
+
+
+static void srvRunJob(t_srvWorker *w, const uint8_t *execData,
+    size_t execLength, size_t inputLength, uint64_t instrLimit,
+    t_srvResult *res)
+{
+  t_simContext *ctx = w->ctx;
+  t_srvImage *img = srvAcquireImage(
+      &w->srv->cache, execData, execLength, &res->status);
+  if (!img)
+    return;
+
+  svSetMemoryIO(ctx, w->input, inputLength);
+  svSetInstructionLimit(ctx, instrLimit);
+  if (ldrLoadImage(ctx, img->image) != LDR_NO_ERROR ||
+      initSupervisor(ctx) != SV_NO_ERROR) {
+    res->status = SRV_STATUS_LOAD_ERROR;
+  } else {
+    res->status = svVMRun(ctx);
+    res->exitCode = svGetExitCode(ctx);
+    res->instrCount = cpuGetInstructionCount(ctx);
+    if (res->status == SV_STATUS_MEMORY_FAULT)
+      res->faultAddress = memGetLastFaultAddress(ctx);
+    else if (res->status == SV_STATUS_ILL_INST_FAULT)
+      res->faultAddress = cpuGetRegister(ctx, CPU_REG_PC);
+  }
+  srvReleaseImage(&w->srv->cache, img);
+}
+
+
+/* Reads a job from the connection, runs it and sends its result. Returns
+ * false when the connection must be closed. */
+static bool srvServeJob(t_srvWorker *w, int fd)
+{
+  uint8_t header[SRV_RESULT_HEADER_SIZE];
+  if (!srvReadAll(fd, header, SRV_JOB_HEADER_SIZE))
+    return false;
+  uint32_t kind = srvGet32(header);
+  uint32_t execLength = srvGet32(header + 4);
+  uint32_t inputLength = srvGet32(header + 8);
+  uint64_t instrLimit = srvGet64(header + 12);
+  uint64_t maxInstrs = w->srv->opts->instrLimit;
+  if (instrLimit == 0 || (maxInstrs != 0 && maxInstrs < instrLimit))
+    instrLimit = maxInstrs;
+
+  t_srvResult res = {SRV_STATUS_INVALID_JOB, 0, 0, 0};
+  bool valid = (kind == SRV_JOB_PATH || kind == SRV_JOB_ELF) &&
+      execLength <= SRV_MAX_EXEC_LENGTH &&
+      inputLength <= SRV_MAX_INPUT_LENGTH &&
+      srvReserve(&w->exec, &w->execCapacity, (size_t)execLength + 1) &&
+      srvReserve(&w->input, &w->inputCapacity, inputLength);
+  if (valid) {
+    if (!srvReadAll(fd, w->exec, execLength) ||
+        !srvReadAll(fd, w->input, inputLength))
+      return false;
+    const uint8_t *execData;
+    size_t execDataLength;
+    if (srvGetExecutable(w, kind, execLength, &execData, &execDataLength))
+      srvRunJob(w, execData, execDataLength, inputLength, instrLimit, &res);
+    else
+      res.status = SRV_STATUS_FILE_ERROR;
+  }
+
+  size_t outputLength = 0;
+  const char *output = svGetRecordedOutput(w->ctx, &outputLength);
+  srvPut32(header, (uint32_t)res.status);
+  srvPut32(header + 4, (uint32_t)res.exitCode);
+  srvPut64(header + 8, res.instrCount);
+  srvPut32(header + 16, res.faultAddress);
+  srvPut32(header + 20, (uint32_t)outputLength);
+  bool sent = srvWriteAll(fd, header, SRV_RESULT_HEADER_SIZE) &&
+      srvWriteAll(fd, output, outputLength);
+  /* the memory of the program is released before waiting for the next job */
+  resetSimContext(w->ctx);
+  return sent && valid;
+}
+
+
+static void *srvWorkerMain(void *arg)
+{
+  t_srvWorker *w = (t_srvWorker *)arg;
+  for (;;) {
+    int fd = srvTakeConnection(w->srv);
+    while (srvServeJob(w, fd))
+      ;
+    close(fd);
+  }
+  return NULL;
+}
+
+
+static volatile sig_atomic_t srvInterrupted = 0;
+
+static void srvHandleSignal(int sig)
+{
+  (void)sig;
+  srvInterrupted = 1;
+}
+
+
+/* Creates the listening socket, replacing a socket left by a previous
+ * server */
+static int srvListen(const char *socketPath)
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long\n");
+    return -1;
+  }
+  strcpy(addr.sun_path, socketPath);
+
+  struct stat st;
+  if (lstat(socketPath, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(socketPath);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    perror(socketPath);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
+static t_srvWorker *srvStartWorkers(t_srvServer *srv, int *numStarted)
+{
+  int numThreads = srv->opts->numThreads;
+  t_srvWorker *workers = calloc((size_t)numThreads, sizeof(t_srvWorker));
+  if (!workers)
+    return NULL;
+
+  /* The signals which stop the server are handled by the main thread */
+  sigset_t stopSignals, oldMask;
+  sigemptyset(&stopSignals);
+  sigaddset(&stopSignals, SIGINT);
+  sigaddset(&stopSignals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stopSignals, &oldMask);
+  *numStarted = 0;
+  for (int i = 0; i < numThreads; i++) {
+    t_srvWorker *w = &workers[*numStarted];
+    w->srv = srv;
+    w->ctx = newSimContext();
+    if (!w->ctx)
+      break;
+    cpuSetBlockTranslation(w->ctx, srv->opts->blockTranslation);
+    svSetStackSize(w->ctx, srv->opts->stackSize);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, srvWorkerMain, w) != 0) {
+      deleteSimContext(w->ctx);
+      break;
+    }
+    pthread_detach(thread);
+    (*numStarted)++;
+  }
+  pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+  return workers;
+}
+
+
+bool srvServe(const char *socketPath, const t_srvOptions *opts)
+{
+  static t_srvServer srv;
+  srv.opts = opts;
+  pthread_mutex_init(&srv.cache.lock, NULL);
+  pthread_mutex_init(&srv.lock, NULL);
+  pthread_cond_init(&srv.notEmpty, NULL);
+  pthread_cond_init(&srv.notFull, NULL);
+
+  int listenFd = srvListen(socketPath);
+  if (listenFd < 0)
+    return false;
+  int numStarted;
+  t_srvWorker *workers = srvStartWorkers(&srv, &numStarted);
+  if (!workers || numStarted == 0) {
+    fprintf(stderr, "Could not start the server threads\n");
+    close(listenFd);
+    unlink(socketPath);
+    return false;
+  }
+
+  /* A client which disconnects early must not kill the server, and the
+   * signals stopping it must interrupt accept */
+  signal(SIGPIPE, SIG_IGN);
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = srvHandleSignal;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  while (!srvInterrupted) {
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd >= 0) {
+      srvPutConnection(&srv, fd);
+    } else if (errno != EINTR && errno != ECONNABORTED) {
+      perror("accept");
+      break;
+    }
+  }
+
+  /* The jobs still running are abandoned when the process exits */
+  close(listenFd);
+  unlink(socketPath);
+  return true;
+}
+
+
+bool srvSubmit(const char *socketPath, const char *execPath,
+    uint64_t instrLimit, t_srvResult *outResult)
+{
+  bool res = false;
+  void *exec = NULL, *input = NULL;
+  size_t execCapacity = 0, inputCapacity = 0, execLength, inputLength;
+  int fd = -1;
+
+  int execFd = open(execPath, O_RDONLY);
+  if (execFd < 0) {
+    perror(execPath);
+    return false;
+  }
+  bool readOk = srvReadFile(execFd, SRV_MAX_EXEC_LENGTH, &exec,
+      &execCapacity, &execLength);
+  close(execFd);
+  if (!readOk) {
+    fprintf(stderr, "Could not read the executable\n");
+    goto cleanup;
+  }
+  if (!srvReadFile(STDIN_FILENO, SRV_MAX_INPUT_LENGTH, &input,
+           &inputCapacity, &inputLength)) {
+    fprintf(stderr, "Could not read the input\n");
+    goto cleanup;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long\n");
+    goto cleanup;
+  }
+  strcpy(addr.sun_path, socketPath);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror(socketPath);
+    goto cleanup;
+  }
+
+  uint8_t header[SRV_RESULT_HEADER_SIZE];
+  srvPut32(header, SRV_JOB_ELF);
+  srvPut32(header + 4, (uint32_t)execLength);
+  srvPut32(header + 8, (uint32_t)inputLength);
+  srvPut64(header + 12, instrLimit);
+  signal(SIGPIPE, SIG_IGN);
+  if (!srvWriteAll(fd, header, SRV_JOB_HEADER_SIZE) ||
+      !srvWriteAll(fd, exec, execLength) ||
+      !srvWriteAll(fd, input, inputLength) ||
+      !srvReadAll(fd, header, SRV_RESULT_HEADER_SIZE)) {
+    fprintf(stderr, "The server did not answer\n");
+    goto cleanup;
+  }
+  outResult->status = (t_svStatus)srvGet32(header);
+  outResult->exitCode = (t_isaInt)srvGet32(header + 4);
+  outResult->instrCount = srvGet64(header + 8);
+  outResult->faultAddress = srvGet32(header + 16);
+
+  /* the output is copied as it arrives, reusing the input buffer */
+  size_t outputLength = srvGet32(header + 20);
+  while (outputLength > 0) {
+    size_t chunk = outputLength < inputCapacity ? outputLength : inputCapacity;
+    if (!srvReadAll(fd, input, chunk)) {
+      fprintf(stderr, "The server did not answer\n");
+      goto cleanup;
+    }
+    fwrite(input, 1, chunk, stdout);
+    outputLength -= chunk;
+  }
+  fflush(stdout);
+  res = true;
+
+cleanup:
+  if (fd >= 0)
+    close(fd);
+  free(exec);
+  free(input);
+  return res;
+}
@@ -0,0 +1,82 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "memory.h"
+#include "supervisor.h"
+
+/* Protocol of the server. A client connects to the Unix socket and sends any
+ * number of jobs, each one answered before the next is read. All the
+ * integers are little-endian.
+ *
+ * A job is a header of 20 bytes:
+ *   uint32 kind          SRV_JOB_PATH or SRV_JOB_ELF
+ *   uint32 execLength    length of the executable field
+ *   uint32 inputLength   length of the input field
+ *   uint64 instrLimit    maximum number of instructions executed, 0 for the
+ *                        limit of the server
+ * followed by the executable field, which is the path of an ELF executable
+ * (without a terminator) for SRV_JOB_PATH or its contents for SRV_JOB_ELF,
+ * and by the standard input of the program.
+ *
+ * The answer is a header of 24 bytes:
+ *   int32 status         a t_svStatus, or one of the SRV_STATUS_* errors
+ *   int32 exitCode       exit code of the program
+ *   uint64 instrCount    number of instructions executed
+ *   uint32 faultAddress  address of the memory fault or of the illegal
+ *                        instruction, if any
+ *   uint32 outputLength  length of the output
+ * followed by the standard output of the program.
+ *
+ * The server closes the connection after a job it cannot read. */
+enum {
+  SRV_JOB_PATH = 0,
+  SRV_JOB_ELF = 1
+};
+
+#define SRV_JOB_HEADER_SIZE 20
+#define SRV_RESULT_HEADER_SIZE 24
+/* Longest executable and input accepted */
+#define SRV_MAX_EXEC_LENGTH 0x8000000
+#define SRV_MAX_INPUT_LENGTH 0x10000000
+
+/* Outcomes of a job which did not get to run the program */
+enum {
+  SRV_STATUS_FILE_ERROR = -2000,
+  SRV_STATUS_LOAD_ERROR = -2001,
+  SRV_STATUS_INVALID_JOB = -2002
+};
+
+typedef struct {
+  int numThreads;
+  bool blockTranslation;
+  /* maximum number of instructions executed by each job, 0 if unlimited */
+  uint64_t instrLimit;
+  t_memSize stackSize;
+} t_srvOptions;
+
+typedef struct {
+  t_svStatus status;
+  t_isaInt exitCode;
+  uint64_t instrCount;
+  t_memAddress faultAddress;
+} t_srvResult;
+
+
+/* Accepts connections on the Unix socket at the given path, and runs the
+ * jobs they send until the process is interrupted. Each thread serves one
+ * connection at a time with its own context, which is reused by all the
+ * jobs. The executables are kept loaded, and a job whose executable has the
+ * same contents as a previous one does not load it again. Returns false if
+ * the socket could not be created. */
+bool srvServe(const char *socketPath, const t_srvOptions *opts);
+
+/* Runs an ELF executable in the server listening at socketPath, with the
+ * standard input as its input, and writes its output to the standard
+ * output. Returns false if the job could not be sent or its answer
+ * received. */
+bool srvSubmit(const char *socketPath, const char *execPath,
+    uint64_t instrLimit, t_srvResult *outResult);
+
+#endif
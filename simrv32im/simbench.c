@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include "context.h"
+#include "cpu.h"
+#include "memory.h"
+#include "supervisor.h"
+#include "isa.h"
+
+
+void usage(const char *name)
+{
+  puts("ACSE RISC-V RV32IM simulator, (c) 2022-24 Politecnico di Milano");
+  printf("usage: %s [options] [kernel...]\n\n", name);
+  puts("Measures the time taken by the simulator to execute synthetic");
+  puts("kernels, in nanoseconds per instruction. The kernels are:");
+  puts("  alu, mem, branch, muldiv, ecall");
+  puts("All of them are run if none is given.\n");
+  puts("Options:");
+  puts("  -j, --jit             Enables the translation of the code into");
+  puts("                          blocks, as simrv32im --jit");
+  puts("  -n, --iterations=N    Iterations of the loop of each kernel");
+  puts("                          (default: chosen per kernel)");
+  puts("  -r, --repeat=N        Number of measured runs (default: 10)");
+  puts("  -w, --warmup=N        Number of runs before the measured ones");
+  puts("                          (default: 2)");
+  puts("  -h, --help            Displays available options");
+}
+
+
+/* Code of a kernel, encoded in a buffer */
+#define BENCH_MAX_CODE 256
+typedef struct {
+  uint32_t code[BENCH_MAX_CODE];
+  int length;
+} t_benchCode;
+
+#define BENCH_CODE_BASE 0x1000
+/* Areas of one page each, separated by a page which is not mapped, read and
+ * written in turn by the mem kernel. There are more of them than entries in
+ * the TLB, and they span several entries of the first level of the page
+ * table. */
+#define BENCH_AREA_BASE 0x10000000
+#define BENCH_AREA_STRIDE (2 * MEM_PAGE_SIZE)
+#define BENCH_NUM_AREAS (4 * MEM_TLB_SIZE)
+
+static void emit(t_benchCode *c, uint32_t inst)
+{
+  if (c->length == BENCH_MAX_CODE) {
+    fprintf(stderr, "Kernel too long\n");
+    exit(1);
+  }
+  c->code[c->length++] = inst;
+}
+
+static uint32_t encR(int opcode, int f3, int f7, int rd, int rs1, int rs2)
+{
+  return (uint32_t)opcode | (uint32_t)rd << 7 | (uint32_t)f3 << 12 |
+      (uint32_t)rs1 << 15 | (uint32_t)rs2 << 20 | (uint32_t)f7 << 25;
+}
+
+static uint32_t encI(int opcode, int f3, int rd, int rs1, int32_t imm)
+{
+  return (uint32_t)opcode | (uint32_t)rd << 7 | (uint32_t)f3 << 12 |
+      (uint32_t)rs1 << 15 | ((uint32_t)imm & 0xFFF) << 20;
+}
+
+static uint32_t encS(int f3, int rs1, int rs2, int32_t imm)
+{
+  uint32_t u = (uint32_t)imm;
+  return ISA_INST_OPCODE_STORE | (u & 0x1F) << 7 | (uint32_t)f3 << 12 |
+      (uint32_t)rs1 << 15 | (uint32_t)rs2 << 20 | ((u >> 5) & 0x7F) << 25;
+}
+
+static uint32_t encB(int f3, int rs1, int rs2, int32_t offset)
+{
+  uint32_t u = (uint32_t)offset;
+  return ISA_INST_OPCODE_BRANCH | ((u >> 11) & 1) << 7 |
+      ((u >> 1) & 0xF) << 8 | (uint32_t)f3 << 12 | (uint32_t)rs1 << 15 |
+      (uint32_t)rs2 << 20 | ((u >> 5) & 0x3F) << 25 | ((u >> 12) & 1) << 31;
+}
+
+static uint32_t encJ(int rd, int32_t offset)
+{
+  uint32_t u = (uint32_t)offset;
+  return ISA_INST_OPCODE_JAL | (uint32_t)rd << 7 |
+      ((u >> 12) & 0xFF) << 12 | ((u >> 11) & 1) << 20 |
+      ((u >> 1) & 0x3FF) << 21 | ((u >> 20) & 1) << 31;
+}
+
+/* Shorthands for the instructions used by the kernels */
+static void emitOp(t_benchCode *c, int f3, int f7, int rd, int rs1, int rs2)
+{
+  emit(c, encR(ISA_INST_OPCODE_OP, f3, f7, rd, rs1, rs2));
+}
+
+static void emitOpImm(t_benchCode *c, int f3, int rd, int rs1, int32_t imm)
+{
+  emit(c, encI(ISA_INST_OPCODE_OPIMM, f3, rd, rs1, imm));
+}
+
+static void emitAddi(t_benchCode *c, int rd, int rs1, int32_t imm)
+{
+  emitOpImm(c, 0, rd, rs1, imm);
+}
+
+static void emitLoad(t_benchCode *c, int f3, int rd, int rs1, int32_t imm)
+{
+  emit(c, encI(ISA_INST_OPCODE_LOAD, f3, rd, rs1, imm));
+}
+
+static void emitLi(t_benchCode *c, int rd, uint32_t value)
+{
+  uint32_t lo = value & 0xFFF;
+  uint32_t hi = value - SEXT(lo, 12);
+  if (hi != 0) {
+    emit(c, ISA_INST_OPCODE_LUI | (uint32_t)rd << 7 | hi);
+    if (lo != 0)
+      emitAddi(c, rd, rd, (int32_t)lo);
+  } else {
+    emitAddi(c, rd, CPU_REG_ZERO, (int32_t)lo);
+  }
+}
+
+static void emitEcall(t_benchCode *c)
+{
+  emit(c, ISA_INST_OPCODE_SYSTEM);
+}
+
+/* Emits the end of the loop started at index loop, which is repeated until
+ * s0 reaches zero, and the exit of the program */
+static void emitLoopEnd(t_benchCode *c, int loop)
+{
+  emitAddi(c, CPU_REG_S0, CPU_REG_S0, -1);
+  emit(c, encB(1, CPU_REG_S0, CPU_REG_ZERO, (loop - c->length) * 4));
+  emitLi(c, CPU_REG_A7, 10);
+  emitEcall(c);
+}
+
+
+/* Arithmetic and logic instructions only */
+static void genALU(t_benchCode *c)
+{
+  int loop = c->length;
+  emitOp(c, 0, 0x00, CPU_REG_T0, CPU_REG_T0, CPU_REG_T1);   /* add */
+  emitOp(c, 4, 0x00, CPU_REG_T1, CPU_REG_T1, CPU_REG_T0);   /* xor */
+  emitOpImm(c, 1, CPU_REG_S1, CPU_REG_T0, 3);               /* slli */
+  emitOp(c, 6, 0x00, CPU_REG_T3, CPU_REG_S1, CPU_REG_T1);   /* or */
+  emitOp(c, 0, 0x20, CPU_REG_T4, CPU_REG_T3, CPU_REG_T0);   /* sub */
+  emitOpImm(c, 5, CPU_REG_T5, CPU_REG_T4, 2);               /* srli */
+  emitOp(c, 7, 0x00, CPU_REG_T6, CPU_REG_T5, CPU_REG_T3);   /* and */
+  emitOp(c, 3, 0x00, CPU_REG_A0, CPU_REG_T6, CPU_REG_T4);   /* sltu */
+  emitAddi(c, CPU_REG_T0, CPU_REG_T0, 1);
+  emitAddi(c, CPU_REG_T1, CPU_REG_T1, 7);
+  emitLoopEnd(c, loop);
+}
+
+/* Loads and stores of all sizes, moving to another area at each iteration */
+static void genMem(t_benchCode *c)
+{
+  emitLi(c, CPU_REG_A1, BENCH_AREA_BASE);
+  emitLi(c, CPU_REG_A2, BENCH_AREA_BASE + BENCH_NUM_AREAS * BENCH_AREA_STRIDE);
+  emitLi(c, CPU_REG_A3, BENCH_AREA_STRIDE);
+  emitAddi(c, CPU_REG_T0, CPU_REG_A1, 0);
+  int loop = c->length;
+  emitLoad(c, 2, CPU_REG_T1, CPU_REG_T0, 0);                /* lw */
+  emitAddi(c, CPU_REG_T1, CPU_REG_T1, 1);
+  emit(c, encS(2, CPU_REG_T0, CPU_REG_T1, 4));              /* sw */
+  emitLoad(c, 2, CPU_REG_S1, CPU_REG_T0, 8);                /* lw */
+  emitOp(c, 0, 0x00, CPU_REG_T3, CPU_REG_T3, CPU_REG_S1);   /* add */
+  emit(c, encS(2, CPU_REG_T0, CPU_REG_T3, 12));             /* sw */
+  emitLoad(c, 4, CPU_REG_T4, CPU_REG_T0, 16);               /* lbu */
+  emit(c, encS(0, CPU_REG_T0, CPU_REG_T4, 17));             /* sb */
+  emitLoad(c, 1, CPU_REG_T5, CPU_REG_T0, 20);               /* lh */
+  emit(c, encS(1, CPU_REG_T0, CPU_REG_T5, 22));             /* sh */
+  emitOp(c, 0, 0x00, CPU_REG_T0, CPU_REG_T0, CPU_REG_A3);   /* add */
+  emit(c, encB(1, CPU_REG_T0, CPU_REG_A2, 8));              /* bne */
+  emitAddi(c, CPU_REG_T0, CPU_REG_A1, 0);
+  emitLoopEnd(c, loop);
+}
+
+/* Conditional branches taken in a pseudo-random pattern, and jumps */
+static void genBranch(t_benchCode *c)
+{
+  emitLi(c, CPU_REG_T0, 0x12345678);
+  emitLi(c, CPU_REG_A3, 0x40000000);
+  int loop = c->length;
+  /* xorshift step */
+  emitOpImm(c, 1, CPU_REG_T1, CPU_REG_T0, 13);
+  emitOp(c, 4, 0x00, CPU_REG_T0, CPU_REG_T0, CPU_REG_T1);
+  emitOpImm(c, 5, CPU_REG_T1, CPU_REG_T0, 17);
+  emitOp(c, 4, 0x00, CPU_REG_T0, CPU_REG_T0, CPU_REG_T1);
+  emitOpImm(c, 1, CPU_REG_T1, CPU_REG_T0, 5);
+  emitOp(c, 4, 0x00, CPU_REG_T0, CPU_REG_T0, CPU_REG_T1);
+  /* each branch skips the increment after it */
+  emitOpImm(c, 7, CPU_REG_S1, CPU_REG_T0, 1);
+  emit(c, encB(0, CPU_REG_S1, CPU_REG_ZERO, 8));            /* beq */
+  emitAddi(c, CPU_REG_A0, CPU_REG_A0, 1);
+  emitOpImm(c, 7, CPU_REG_S1, CPU_REG_T0, 2);
+  emit(c, encB(1, CPU_REG_S1, CPU_REG_ZERO, 8));            /* bne */
+  emitAddi(c, CPU_REG_A1, CPU_REG_A1, 1);
+  emit(c, encB(4, CPU_REG_T0, CPU_REG_ZERO, 8));            /* blt */
+  emitAddi(c, CPU_REG_A2, CPU_REG_A2, 1);
+  emit(c, encB(7, CPU_REG_T0, CPU_REG_A3, 8));              /* bgeu */
+  emitAddi(c, CPU_REG_A4, CPU_REG_A4, 1);
+  emit(c, encJ(CPU_REG_ZERO, 8));                           /* j */
+  emitAddi(c, CPU_REG_A5, CPU_REG_A5, 1);
+  emitLoopEnd(c, loop);
+}
+
+/* Multiplications and divisions */
+static void genMulDiv(t_benchCode *c)
+{
+  emitLi(c, CPU_REG_T0, 123456789);
+  emitLi(c, CPU_REG_T1, 987);
+  int loop = c->length;
+  emitOp(c, 0, 0x01, CPU_REG_S1, CPU_REG_T0, CPU_REG_T1);   /* mul */
+  emitOp(c, 1, 0x01, CPU_REG_T3, CPU_REG_T0, CPU_REG_T1);   /* mulh */
+  emitOp(c, 2, 0x01, CPU_REG_T4, CPU_REG_T0, CPU_REG_T1);   /* mulhsu */
+  emitOp(c, 3, 0x01, CPU_REG_T5, CPU_REG_T0, CPU_REG_T1);   /* mulhu */
+  emitOp(c, 4, 0x01, CPU_REG_T6, CPU_REG_T0, CPU_REG_T1);   /* div */
+  emitOp(c, 5, 0x01, CPU_REG_A0, CPU_REG_T0, CPU_REG_T1);   /* divu */
+  emitOp(c, 6, 0x01, CPU_REG_A1, CPU_REG_T0, CPU_REG_T1);   /* rem */
+  emitOp(c, 7, 0x01, CPU_REG_A2, CPU_REG_T0, CPU_REG_T1);   /* remu */
+  emitOp(c, 0, 0x00, CPU_REG_T0, CPU_REG_T0, CPU_REG_S1);   /* add */
+  emitAddi(c, CPU_REG_T1, CPU_REG_T1, 2);
+  emitLoopEnd(c, loop);
+}
+
+/* System calls printing a number and a new line */
+static void genEcall(t_benchCode *c)
+{
+  int loop = c->length;
+  emitAddi(c, CPU_REG_A0, CPU_REG_S0, 0);
+  emitLi(c, CPU_REG_A7, 1);
+  emitEcall(c);
+  emitLi(c, CPU_REG_A0, '\n');
+  emitLi(c, CPU_REG_A7, 11);
+  emitEcall(c);
+  emitLoopEnd(c, loop);
+}
+
+
+typedef struct {
+  const char *name;
+  void (*gen)(t_benchCode *c);
+  /* default number of iterations of the loop */
+  uint32_t iterations;
+  /* maps the areas of the mem kernel */
+  bool mapsAreas;
+} t_kernel;
+
+static const t_kernel kernels[] = {
+    {   "alu",    genALU, 1000000, false},
+    {   "mem",    genMem,  800000,  true},
+    {"branch", genBranch,  600000, false},
+    {"muldiv", genMulDiv, 1000000, false},
+    { "ecall",  genEcall,  300000, false},
+};
+#define NUM_KERNELS (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+
+/* Prepares a new machine to execute a kernel */
+static t_simContext *newKernelContext(const t_kernel *kernel,
+    const t_benchCode *code, uint32_t iterations, bool jit, FILE *out)
+{
+  t_simContext *ctx = newSimContext();
+  if (!ctx)
+    return NULL;
+  uint8_t *buf;
+  if (memMapArea(ctx, BENCH_CODE_BASE, (t_memSize)code->length * 4, &buf) !=
+      MEM_NO_ERROR)
+    goto fail;
+  for (int i = 0; i < code->length; i++) {
+    buf[i * 4] = (uint8_t)code->code[i];
+    buf[i * 4 + 1] = (uint8_t)(code->code[i] >> 8);
+    buf[i * 4 + 2] = (uint8_t)(code->code[i] >> 16);
+    buf[i * 4 + 3] = (uint8_t)(code->code[i] >> 24);
+  }
+  for (int i = 0; kernel->mapsAreas && i < BENCH_NUM_AREAS; i++) {
+    if (memMapArea(ctx, BENCH_AREA_BASE + (t_memAddress)i * BENCH_AREA_STRIDE,
+            MEM_PAGE_SIZE, NULL) != MEM_NO_ERROR)
+      goto fail;
+  }
+  cpuReset(ctx, BENCH_CODE_BASE);
+  if (initSupervisor(ctx) != SV_NO_ERROR)
+    goto fail;
+  svSetIOFiles(ctx, stdin, out);
+  svSetBufferedIO(ctx, true);
+  cpuSetBlockTranslation(ctx, jit);
+  cpuSetRegister(ctx, CPU_REG_S0, iterations);
+  return ctx;
+
+fail:
+  deleteSimContext(ctx);
+  return NULL;
+}
+
+
+static double nowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+  double da = *(const double *)a, db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+/* Runs a kernel warmup + repeat times and prints the statistics of the
+ * measured runs. Returns false if the kernel could not be run. */
+static bool runKernel(const t_kernel *kernel, uint32_t iterations, bool jit,
+    int warmup, int repeat, FILE *out)
+{
+  t_benchCode code = {{0}, 0};
+  kernel->gen(&code);
+  double *samples = malloc(sizeof(double) * (size_t)repeat);
+  if (!samples)
+    return false;
+
+  uint64_t instrs = 0;
+  for (int i = 0; i < warmup + repeat; i++) {
+    t_simContext *ctx = newKernelContext(kernel, &code, iterations, jit, out);
+    if (!ctx) {
+      fprintf(stderr, "Could not set up the kernel \"%s\"\n", kernel->name);
+      free(samples);
+      return false;
+    }
+    double start = nowNs();
+    t_svStatus status = svVMRun(ctx);
+    double end = nowNs();
+    svFlushOutput(ctx);
+    instrs = cpuGetInstructionCount(ctx);
+    deleteSimContext(ctx);
+    if (status != SV_STATUS_TERMINATED) {
+      fprintf(stderr, "The kernel \"%s\" did not terminate (status %d)\n",
+          kernel->name, status);
+      free(samples);
+      return false;
+    }
+    if (i >= warmup)
+      samples[i - warmup] = (end - start) / (double)instrs;
+  }
+
+  qsort(samples, (size_t)repeat, sizeof(double), compareDoubles);
+  double sum = 0, sqSum = 0;
+  for (int i = 0; i < repeat; i++)
+    sum += samples[i];
+  double mean = sum / repeat;
+  for (int i = 0; i < repeat; i++)
+    sqSum += (samples[i] - mean) * (samples[i] - mean);
+  double median = samples[repeat / 2];
+  if (repeat % 2 == 0)
+    median = (samples[repeat / 2 - 1] + median) / 2;
+  printf("%-8s %12" PRIu64 " %9.3f %9.3f %9.3f %9.3f %9.3f %9.1f\n",
+      kernel->name, instrs, samples[0], median, mean,
+      sqrt(sqSum / repeat), samples[repeat - 1], 1e3 / median);
+  free(samples);
+  return true;
+}
+
+
+static bool parseNumber(const char *str, uint64_t *out)
+{
+  char *end;
+  *out = strtoull(str, &end, 0);
+  return end != str && *end == '\0';
+}
+
+
+int main(int argc, char *argv[])
+{
+  int ch;
+  static const struct option options[] = {
+      {      "help",       no_argument, NULL, 'h'},
+      {       "jit",       no_argument, NULL, 'j'},
+      {"iterations", required_argument, NULL, 'n'},
+      {    "repeat", required_argument, NULL, 'r'},
+      {    "warmup", required_argument, NULL, 'w'},
+      {        NULL,                 0, NULL,   0}
+  };
+
+  char *name = argv[0];
+  bool jit = false;
+  uint64_t iterations = 0;
+  uint64_t repeat = 10;
+  uint64_t warmup = 2;
+
+  while ((ch = getopt_long(argc, argv, "hjn:r:w:", options, NULL)) != -1) {
+    switch (ch) {
+      case 'j':
+        jit = true;
+        break;
+      case 'n':
+        if (!parseNumber(optarg, &iterations) || iterations == 0 ||
+            iterations > UINT32_MAX) {
+          fprintf(stderr, "Invalid number of iterations\n");
+          return 1;
+        }
+        break;
+      case 'r':
+        if (!parseNumber(optarg, &repeat) || repeat == 0 || repeat > 10000) {
+          fprintf(stderr, "Invalid number of runs\n");
+          return 1;
+        }
+        break;
+      case 'w':
+        if (!parseNumber(optarg, &warmup) || warmup > 10000) {
+          fprintf(stderr, "Invalid number of runs\n");
+          return 1;
+        }
+        break;
+      case 'h':
+        usage(name);
+        return 0;
+      default:
+        usage(name);
+        return 1;
+    }
+  }
+  argc -= optind;
+  argv += optind;
+
+  bool selected[NUM_KERNELS];
+  for (int k = 0; k < NUM_KERNELS; k++)
+    selected[k] = argc == 0;
+  for (int i = 0; i < argc; i++) {
+    int k = 0;
+    while (k < NUM_KERNELS && strcmp(argv[i], kernels[k].name) != 0)
+      k++;
+    if (k == NUM_KERNELS) {
+      fprintf(stderr, "Unknown kernel \"%s\"\n", argv[i]);
+      return 1;
+    }
+    selected[k] = true;
+  }
+
+  /* The output of the ecall kernel is not interesting */
+  FILE *out = fopen("/dev/null", "w");
+  if (!out) {
+    fprintf(stderr, "Could not open /dev/null\n");
+    return 1;
+  }
+
+  printf("%s, %d warmup and %d measured runs per kernel\n",
+      jit ? "Block translation" : "Interpreter", (int)warmup, (int)repeat);
+  printf("%-8s %12s %9s %9s %9s %9s %9s %9s\n", "kernel", "instrs/run",
+      "min", "median", "mean", "stddev", "max", "MIPS");
+  printf("%-8s %12s %9s %9s %9s %9s %9s %9s\n", "", "", "ns/instr", "", "",
+      "", "", "(median)");
+  int res = 0;
+  for (int k = 0; k < NUM_KERNELS; k++) {
+    if (!selected[k])
+      continue;
+    uint32_t n = iterations ? (uint32_t)iterations : kernels[k].iterations;
+    if (!runKernel(&kernels[k], n, jit, (int)warmup, (int)repeat, out)) {
+      res = 1;
+      break;
+    }
+  }
+  fclose(out);
+  return res;
+}
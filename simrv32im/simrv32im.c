@@ -3,23 +3,74 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
 #include "isa.h"
+#include "context.h"
 #include "cpu.h"
 #include "memory.h"
 #include "loader.h"
 #include "supervisor.h"
 #include "debugger.h"
+#include "batch.h"
+#include "profiler.h"
+#include "cache.h"
+#include "trace.h"
+#include "snapshot.h"
+#include "server.h"
 
 
 void usage(const char *name)
 {
   puts("ACSE RISC-V RV32IM simulator, (c) 2022-24 Politecnico di Milano");
-  printf("usage: %s [options] executable\n\n", name);
+  printf("usage: %s [options] executable\n", name);
+  printf("       %s --batch [options] executable input...\n", name);
+  printf("       %s --restore=FILE [--batch] [options] [input...]\n", name);
+  printf("       %s --serve=SOCKET [options]\n", name);
+  printf("       %s --connect=SOCKET [options] executable\n\n", name);
   puts("Options:");
+  puts("  -b, --batch           Runs the executable once for each input file,");
+  puts("                          in parallel. The output of each run is");
+  puts("                          written to the input file name + \".out\"");
+  puts("  -c, --cache=CONFIG    Models the given caches and prints their hits");
+  puts("                          and misses at exit. CONFIG is a comma");
+  puts("                          separated list of name:size:ways:line,");
+  puts("                          where name is l1i, l1d or l2");
+  puts("  -C, --connect=SOCKET  Runs the executable in the simulator serving");
+  puts("                          SOCKET instead of starting it here");
   puts("  -d, --debug           Enters debug mode before starting execution");
   puts("  -e, --entry=ADDR      Force the entry point to ADDR");
+  puts("  -i, --interactive     Prompts for input and does not buffer output");
+  puts("                          even when the input is not a terminal");
+  puts("  -j, --jit             Translates frequently executed code to speed");
+  puts("                          up the simulation");
+  puts("  -L, --serve=SOCKET    Runs the jobs sent by the clients of the Unix");
+  puts("                          socket SOCKET, in parallel, until");
+  puts("                          interrupted (see server.h for the protocol)");
   puts("  -l, --load-addr=ADDR  Sets the executable loading address (only");
   puts("                          for executables in raw binary format)");
+  puts("  -m, --max-instrs=N    Stops the program after N instructions");
+  puts("  -p, --profile=FILE    Counts the executions of each instruction of");
+  puts("                          the program and writes a report to FILE");
+  puts("  -R, --restore=FILE    Resumes the program saved in the snapshot");
+  puts("                          FILE instead of loading an executable");
+  puts("  -r, --trace=FILE      Records every executed instruction, with the");
+  puts("                          register and the memory it changed, to FILE");
+  puts("                          (use simtrace to read it)");
+  puts("  -s, --snapshot=FILE   Saves the state of the program to FILE before");
+  puts("                          it reads any input, then continues. In");
+  puts("                          batch mode every run resumes from it");
+  puts("  -A, --snapshot-at=ADDR");
+  puts("                        Takes the snapshot before executing the");
+  puts("                          instruction at ADDR instead");
+  puts("  -N, --snapshot-after=N");
+  puts("                        Takes the snapshot after N instructions");
+  puts("                          instead");
+  puts("  -S, --stack-size=SIZE Size of the stack reserved for the program,");
+  puts("                          in bytes or with a k or m suffix");
+  puts("                          (default: 8m)");
+  puts("  -t, --threads=N       Number of threads used in batch and serve");
+  puts("                          mode (default: number of processors)");
   puts("  -x, --prg-exit-code   Exits the simulator with the same exit code");
   puts("                          as the simulated program. In case of faults");
   puts("                          produces POSIX-style exit codes.");
@@ -35,14 +86,17 @@ enum {
   SIM_EXIT_INVALID_FILE,
   SIM_EXIT_SIGSEGV,
   SIM_EXIT_SIGILL,
+  SIM_EXIT_INSTR_LIMIT,
+  SIM_EXIT_BATCH_FAILED,
   COUNT_SIM_EXIT
 };
 
 int exitCode(t_exitCode code, bool toPosix)
 {
-  static const int normalCodes[COUNT_SIM_EXIT] = {0, 0, 1, 2, 100, 101};
+  static const int normalCodes[COUNT_SIM_EXIT] = {
+      0, 0, 1, 2, 100, 101, 102, 3};
   static const int posixCodes[COUNT_SIM_EXIT] = {
-      0, 126, 126, 126, 128 + 11, 128 + 4};
+      0, 126, 126, 126, 128 + 11, 128 + 4, 128 + 24, 1};
   if (code < 0 || code >= COUNT_SIM_EXIT)
     return code;
   if (toPosix)
@@ -51,16 +105,82 @@ int exitCode(t_exitCode code, bool toPosix)
 }
 
 
+/* Prints the message corresponding to a loader error; returns false if there
+ * was no error */
+bool reportLoaderError(t_ldrError ldrErr)
+{
+  if (ldrErr == LDR_INVALID_ARCH)
+    fprintf(stderr, "Not a valid RISC-V executable, exiting.\n");
+  else if (ldrErr == LDR_INVALID_FORMAT)
+    fprintf(stderr, "Unsupported executable, exiting.\n");
+  else if (ldrErr != LDR_NO_ERROR)
+    fprintf(stderr, "Error during executable loading, exiting.\n");
+  return ldrErr != LDR_NO_ERROR;
+}
+
+
+/* Prints the message corresponding to the way the program stopped, and
+ * returns the exit code of the simulator */
+int reportStatus(t_svStatus status, t_memAddress faultAddress,
+    t_isaInt prgCode, bool prgExitCode)
+{
+  if (status == SV_STATUS_MEMORY_FAULT) {
+    fprintf(stderr, "Memory fault at address 0x%08x, execution stopped.\n",
+        faultAddress);
+    return exitCode(SIM_EXIT_SIGSEGV, prgExitCode);
+  } else if (status == SV_STATUS_ILL_INST_FAULT) {
+    fprintf(stderr, "Illegal instruction at address 0x%08x\n", faultAddress);
+    return exitCode(SIM_EXIT_SIGILL, prgExitCode);
+  } else if (status == SV_STATUS_INSTR_LIMIT) {
+    fprintf(stderr, "Instruction limit reached, execution stopped.\n");
+    return exitCode(SIM_EXIT_INSTR_LIMIT, prgExitCode);
+  } else if (prgExitCode) {
+    return prgCode;
+  }
+  return 0;
+}
+
+
+bool reportSnapshotError(t_snapError snapErr)
+{
+  if (snapErr == SNAP_INPUT_USED)
+    fprintf(stderr, "The program read input before the snapshot point.\n");
+  else if (snapErr == SNAP_NOT_REACHED)
+    fprintf(stderr, "The program stopped before the snapshot point.\n");
+  else if (snapErr == SNAP_INVALID_FORMAT)
+    fprintf(stderr, "Not a valid snapshot.\n");
+  else if (snapErr != SNAP_NO_ERROR)
+    fprintf(stderr, "Could not save or load the snapshot.\n");
+  return snapErr != SNAP_NO_ERROR;
+}
+
+
 int main(int argc, char *argv[])
 {
   int ch;
   char *tmpStr;
   static const struct option options[] = {
+      {  "snapshot-at", required_argument, NULL, 'A'},
+      {        "batch",       no_argument, NULL, 'b'},
+      {        "cache", required_argument, NULL, 'c'},
+      {      "connect", required_argument, NULL, 'C'},
       {        "debug",       no_argument, NULL, 'd'},
       {        "entry", required_argument, NULL, 'e'},
       {         "help",       no_argument, NULL, 'h'},
+      {  "interactive",       no_argument, NULL, 'i'},
+      {          "jit",       no_argument, NULL, 'j'},
+      {        "serve", required_argument, NULL, 'L'},
       {    "load-addr", required_argument, NULL, 'l'},
+      {   "max-instrs", required_argument, NULL, 'm'},
+      {"snapshot-after", required_argument, NULL, 'N'},
+      {      "profile", required_argument, NULL, 'p'},
+      {        "trace", required_argument, NULL, 'r'},
+      {      "restore", required_argument, NULL, 'R'},
+      {     "snapshot", required_argument, NULL, 's'},
+      {   "stack-size", required_argument, NULL, 'S'},
+      {      "threads", required_argument, NULL, 't'},
       {"prg-exit-code",       no_argument, NULL, 'x'},
+      {           NULL,                 0, NULL,   0}
   };
 
   char *name = argv[0];
@@ -69,9 +189,40 @@ int main(int argc, char *argv[])
   bool entryIsSet = false;
   t_memAddress load = 0;
   bool prgExitCode = false;
+  bool jit = false;
+  bool interactive = false;
+  bool batch = false;
+  uint64_t maxInstrs = 0;
+  long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *profileFile = NULL;
+  t_cacheConfig cacheConfig[CACHE_NUM_LEVELS] = {{0}};
+  bool cacheModel = false;
+  const char *traceFile = NULL;
+  const char *snapshotFile = NULL;
+  const char *restoreFile = NULL;
+  t_svStopKind stopKind = SV_STOP_AT_INPUT;
+  uint64_t stopValue = 0;
+  unsigned long stackSize = SV_DEFAULT_STACK_SIZE;
+  const char *serveSocket = NULL;
+  const char *connectSocket = NULL;
 
-  while ((ch = getopt_long(argc, argv, "de:hl:x", options, NULL)) != -1) {
+  const char *optString = "A:bc:C:de:hijL:l:m:N:p:r:R:s:S:t:x";
+  while ((ch = getopt_long(argc, argv, optString, options, NULL)) != -1) {
     switch (ch) {
+      case 'A':
+        stopKind = SV_STOP_AT_PC;
+        stopValue = strtoul(optarg, &tmpStr, 0);
+        if (tmpStr == optarg) {
+          fprintf(stderr, "Invalid snapshot address\n");
+          return 1;
+        }
+        break;
+      case 'b':
+        batch = true;
+        break;
+      case 'C':
+        connectSocket = optarg;
+        break;
       case 'd':
         debug = true;
         break;
@@ -83,6 +234,9 @@ int main(int argc, char *argv[])
           return 1;
         }
         break;
+      case 'L':
+        serveSocket = optarg;
+        break;
       case 'l':
         load = (t_memAddress)strtoul(optarg, &tmpStr, 0);
         if (tmpStr == optarg) {
@@ -90,6 +244,64 @@ int main(int argc, char *argv[])
           return 1;
         }
         break;
+      case 'm':
+        maxInstrs = strtoull(optarg, &tmpStr, 0);
+        if (tmpStr == optarg) {
+          fprintf(stderr, "Invalid instruction count\n");
+          return 1;
+        }
+        break;
+      case 'N':
+        stopKind = SV_STOP_AFTER_COUNT;
+        stopValue = strtoull(optarg, &tmpStr, 0);
+        if (tmpStr == optarg) {
+          fprintf(stderr, "Invalid instruction count\n");
+          return 1;
+        }
+        break;
+      case 'c':
+        if (!cacheParseConfig(optarg, cacheConfig)) {
+          fprintf(stderr, "Invalid cache configuration\n");
+          return 1;
+        }
+        cacheModel = true;
+        break;
+      case 'p':
+        profileFile = optarg;
+        break;
+      case 'r':
+        traceFile = optarg;
+        break;
+      case 'R':
+        restoreFile = optarg;
+        break;
+      case 's':
+        snapshotFile = optarg;
+        break;
+      case 'S':
+        stackSize = strtoul(optarg, &tmpStr, 0);
+        if (*tmpStr == 'k' || *tmpStr == 'K')
+          stackSize *= 1024;
+        else if (*tmpStr == 'm' || *tmpStr == 'M')
+          stackSize *= 1024 * 1024;
+        if (tmpStr == optarg || stackSize == 0 || stackSize > 0x40000000) {
+          fprintf(stderr, "Invalid stack size\n");
+          return 1;
+        }
+        break;
+      case 't':
+        numThreads = strtol(optarg, &tmpStr, 0);
+        if (tmpStr == optarg || numThreads < 1) {
+          fprintf(stderr, "Invalid number of threads\n");
+          return 1;
+        }
+        break;
+      case 'i':
+        interactive = true;
+        break;
+      case 'j':
+        jit = true;
+        break;
       case 'x':
         prgExitCode = true;
         break;
@@ -104,62 +316,221 @@ int main(int argc, char *argv[])
   argc -= optind;
   argv += optind;
 
-  if (argc < 1) {
+  if (serveSocket || connectSocket) {
+    if (batch || debug || profileFile || cacheModel || traceFile ||
+        snapshotFile || restoreFile || (serveSocket && connectSocket)) {
+      fprintf(stderr, "Cannot use a server with these options, exiting.\n");
+      return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+    }
+    if (argc != (connectSocket ? 1 : 0)) {
+      usage(name);
+      return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+    }
+  }
+  if (serveSocket) {
+    t_srvOptions opts;
+    opts.numThreads = numThreads < 1 ? 1 : (int)numThreads;
+    opts.blockTranslation = jit;
+    opts.instrLimit = maxInstrs;
+    opts.stackSize = (t_memSize)stackSize;
+    if (!srvServe(serveSocket, &opts))
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+    return 0;
+  }
+  if (connectSocket) {
+    t_srvResult res;
+    if (!srvSubmit(connectSocket, argv[0], maxInstrs, &res))
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+    if (res.status == SRV_STATUS_FILE_ERROR ||
+        res.status == SRV_STATUS_INVALID_JOB) {
+      fprintf(stderr, "Could not open executable, exiting.\n");
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+    } else if (res.status == SRV_STATUS_LOAD_ERROR) {
+      fprintf(stderr, "Error during executable loading, exiting.\n");
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+    }
+    return reportStatus(
+        res.status, res.faultAddress, res.exitCode, prgExitCode);
+  }
+
+  /* A restored program has no executable */
+  int numFiles = (restoreFile ? 0 : 1) + (batch ? 1 : 0);
+  if (argc < numFiles) {
     usage(name);
     return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
-  } else if (argc > 1) {
+  } else if (argc > numFiles && !batch) {
     fprintf(stderr, "Cannot load more than one file, exiting.\n");
     return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+  } else if (batch && (debug || profileFile || cacheModel || traceFile)) {
+    fprintf(stderr, "Cannot debug or profile in batch mode, exiting.\n");
+    return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+  } else if (restoreFile && snapshotFile) {
+    fprintf(stderr, "Cannot take a snapshot of a restored program, "
+                    "exiting.\n");
+    return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+  }
+
+  t_ldrFileType excType = LDR_FORMAT_ELF;
+  if (!restoreFile) {
+    excType = ldrDetectExecType(argv[0]);
+    if (excType == LDR_FORMAT_DETECT_ERROR) {
+      fprintf(stderr, "Could not open executable, exiting.\n");
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+    }
+  }
+  if (excType == LDR_FORMAT_BINARY && !entryIsSet)
+    entry = load;
+
+  if (batch) {
+    t_ldrImage *image = NULL;
+    t_ldrError ldrErr = LDR_NO_ERROR;
+    if (restoreFile) {
+      /* nothing to load */
+    } else if (excType == LDR_FORMAT_BINARY) {
+      ldrErr = ldrOpenBinary(argv[0], load, entry, &image);
+    } else {
+      ldrErr = ldrOpenELF(argv[0], &image);
+      if (ldrErr == LDR_NO_ERROR && entryIsSet)
+        image->entry = entry;
+    }
+    if (reportLoaderError(ldrErr))
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+
+    /* The part of the program before the snapshot point is executed only
+     * once, then every run resumes from the snapshot */
+    t_snapshot *snap = NULL;
+    t_snapError snapErr = SNAP_NO_ERROR;
+    if (snapshotFile) {
+      snapErr = snapTake(
+          image, (t_memSize)stackSize, stopKind, stopValue, snapshotFile);
+      restoreFile = snapshotFile;
+    }
+    if (snapErr == SNAP_NO_ERROR && restoreFile)
+      snapErr = snapOpen(restoreFile, &snap);
+    if (reportSnapshotError(snapErr)) {
+      ldrCloseImage(image);
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+    }
+
+    t_batchOptions opts;
+    opts.numThreads = numThreads < 1 ? 1 : (int)numThreads;
+    opts.blockTranslation = jit;
+    opts.instrLimit = maxInstrs;
+    opts.stackSize = (t_memSize)stackSize;
+    opts.snapshot = snap;
+    int firstInput = numFiles - 1;
+    int numFailed = batchRun(
+        image, argv + firstInput, argc - firstInput, &opts);
+    snapClose(snap);
+    ldrCloseImage(image);
+    if (numFailed > 0)
+      return exitCode(SIM_EXIT_BATCH_FAILED, prgExitCode);
+    return 0;
   }
 
+  t_simContext *ctx = newSimContext();
+  if (!ctx) {
+    fprintf(stderr, "Out of memory, exiting.\n");
+    return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+  }
   if (debug)
-    dbgEnable();
+    dbgEnable(ctx);
+  cpuSetBlockTranslation(ctx, jit);
+  /* The debugger shares the terminal with the program, so its output must
+   * not be delayed */
+  svSetBufferedIO(ctx, !interactive && !debug && !isatty(STDIN_FILENO));
+  svSetInstructionLimit(ctx, maxInstrs);
+  svSetStackSize(ctx, (t_memSize)stackSize);
 
   t_ldrError ldrErr;
-  t_ldrFileType excType = ldrDetectExecType(argv[0]);
-  if (excType == LDR_FORMAT_BINARY) {
-    if (!entryIsSet)
-      entry = load;
-    ldrErr = ldrLoadBinary(argv[0], load, entry);
-  } else if (excType == LDR_FORMAT_ELF) {
-    ldrErr = ldrLoadELF(argv[0]);
-    if (entryIsSet)
-      cpuSetRegister(CPU_REG_PC, entry);
+  if (restoreFile) {
+    t_snapshot *snap;
+    t_snapError snapErr = snapOpen(restoreFile, &snap);
+    if (snapErr == SNAP_NO_ERROR) {
+      snapErr = snapLoad(ctx, snap);
+      snapClose(snap);
+    }
+    if (reportSnapshotError(snapErr)) {
+      deleteSimContext(ctx);
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+    }
+    ldrErr = LDR_NO_ERROR;
+  } else if (excType == LDR_FORMAT_BINARY) {
+    ldrErr = ldrLoadBinary(ctx, argv[0], load, entry);
   } else {
-    fprintf(stderr, "Could not open executable, exiting.\n");
+    ldrErr = ldrLoadELF(ctx, argv[0]);
+    if (entryIsSet)
+      cpuSetRegister(ctx, CPU_REG_PC, entry);
+    /* the symbols are optional, so their errors are ignored */
+    if (ldrErr == LDR_NO_ERROR && (debug || profileFile))
+      ldrLoadSymbols(ctx, argv[0]);
+  }
+  if (reportLoaderError(ldrErr)) {
+    deleteSimContext(ctx);
     return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
   }
 
-  if (ldrErr == LDR_INVALID_ARCH) {
-    fprintf(stderr, "Not a valid RISC-V executable, exiting.\n");
-    return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
-  } else if (ldrErr == LDR_INVALID_FORMAT) {
-    fprintf(stderr, "Unsupported executable, exiting.\n");
-    return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
-  } else if (ldrErr != LDR_NO_ERROR) {
-    fprintf(stderr, "Error during executable loading, exiting.\n");
-    return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+  /* The profiled range is the area holding the entry point, which is the
+   * text of the program */
+  if (profileFile || cacheModel) {
+    t_memAddress textBase;
+    t_memSize textSize;
+    t_memAddress pc = cpuGetRegister(ctx, CPU_REG_PC);
+    if (!memGetAreaBounds(ctx, pc, &textBase, &textSize) ||
+        (profileFile && !profEnable(ctx, textBase, textSize)) ||
+        (cacheModel && !cacheEnable(ctx, cacheConfig, textBase, textSize))) {
+      fprintf(stderr, "Could not enable the profiler, exiting.\n");
+      deleteSimContext(ctx);
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+    }
   }
 
-  t_svStatus status = initSupervisor();
+  t_svStatus status = restoreFile ? SV_NO_ERROR : initSupervisor(ctx);
+  if (snapshotFile) {
+    svSetOutputRecording(ctx, true);
+    svSetStopPoint(ctx, stopKind, stopValue);
+  }
+  /* started after the supervisor, which sets up the stack pointer */
+  if (traceFile && traceEnable(ctx, traceFile,
+                       restoreFile ? restoreFile : argv[0]) != TRACE_NO_ERROR) {
+    fprintf(stderr, "Could not create the trace \"%s\", exiting.\n",
+        traceFile);
+    deleteSimContext(ctx);
+    return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+  }
 
   if (debug)
-    dbgRequestEnter();
+    dbgRequestEnter(ctx);
 
-  while (status == SV_STATUS_RUNNING) {
-    status = svVMTick();
+  if (status == SV_STATUS_RUNNING)
+    status = svVMRun(ctx);
+  if (status == SV_STATUS_STOPPED) {
+    reportSnapshotError(snapSave(ctx, snapshotFile));
+    svSetOutputRecording(ctx, false);
+    status = svVMRun(ctx);
+  } else if (snapshotFile) {
+    reportSnapshotError(SNAP_NOT_REACHED);
   }
 
-  if (status == SV_STATUS_MEMORY_FAULT) {
-    fprintf(stderr, "Memory fault at address 0x%08x, execution stopped.\n",
-        memGetLastFaultAddress());
-    return exitCode(SIM_EXIT_SIGSEGV, prgExitCode);
-  } else if (status == SV_STATUS_ILL_INST_FAULT) {
-    fprintf(stderr, "Illegal instruction at address 0x%08x\n",
-        cpuGetRegister(CPU_REG_PC));
-    return exitCode(SIM_EXIT_SIGILL, prgExitCode);
+  t_memAddress faultAddress = status == SV_STATUS_MEMORY_FAULT
+      ? memGetLastFaultAddress(ctx)
+      : cpuGetRegister(ctx, CPU_REG_PC);
+  int res = reportStatus(status, faultAddress, svGetExitCode(ctx), prgExitCode);
+
+  if (traceFile && traceClose(ctx) != TRACE_NO_ERROR)
+    fprintf(stderr, "Could not write the trace to \"%s\".\n", traceFile);
+  if (cacheModel)
+    cacheWriteReport(ctx, stderr);
+  if (profileFile) {
+    FILE *fp = fopen(profileFile, "w");
+    if (fp) {
+      profWriteReport(ctx, fp);
+      fclose(fp);
+    } else {
+      fprintf(stderr, "Could not write the profile to \"%s\".\n",
+          profileFile);
+    }
   }
-  if (prgExitCode)
-    return svGetExitCode();
-  return 0;
+  deleteSimContext(ctx);
+  return res;
 }
@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include "trace.h"
+#include "context.h"
+#include "loader.h"
+#include "memory.h"
+#include "isa.h"
+#include "cpu.h"
+
+
+void usage(const char *name)
+{
+  puts("ACSE RISC-V RV32IM simulator, (c) 2022-24 Politecnico di Milano");
+  printf("usage: %s [options] trace\n\n", name);
+  puts("Prints the instructions recorded in a trace made with simrv32im");
+  puts("--trace.\n");
+  puts("Options:");
+  puts("  -a, --addr=ADDR       Only prints the loads and stores touching");
+  puts("                          ADDR");
+  puts("  -c, --count=N         Prints at most N instructions");
+  puts("  -e, --executable=FILE Disassembles the instructions from FILE");
+  puts("                          instead of the executable which was traced");
+  puts("  -l, --load-addr=ADDR  Loading address of the executable (only for");
+  puts("                          executables in raw binary format)");
+  puts("  -p, --pc=ADDR         Only prints the executions of the instruction");
+  puts("                          at ADDR");
+  puts("  -r, --reg=N           Only prints the instructions writing xN");
+  puts("  -R, --regs-at=N       Prints the registers after the Nth");
+  puts("                          instruction");
+  puts("  -s, --start=N         Skips the first N instructions");
+  puts("  -S, --summary         Only prints the number of instructions,");
+  puts("                          jumps, loads and stores in the trace");
+  puts("  -h, --help            Displays available options");
+}
+
+
+typedef struct {
+  bool hasPC;
+  t_memAddress pc;
+  bool hasAddr;
+  t_memAddress addr;
+  int reg;
+  uint64_t start;
+  uint64_t count;
+} t_filter;
+
+
+static bool filterMatches(const t_filter *filter, const t_traceRecord *rec)
+{
+  if (filter->hasPC && rec->pc != filter->pc)
+    return false;
+  if (filter->reg >= 0 && rec->reg != filter->reg)
+    return false;
+  if (filter->hasAddr) {
+    t_memSize size = 1U << TRACE_F_SIZE(rec->access);
+    if (!rec->access || filter->addr - rec->address >= size)
+      return false;
+  }
+  return true;
+}
+
+
+static void printRecord(
+    t_simContext *ctx, uint64_t index, const t_traceRecord *rec)
+{
+  char disasm[80] = "";
+  if (ctx)
+    isaDisassemble(
+        cpuDebugReadInstruction(ctx, rec->pc), disasm, sizeof(disasm));
+  printf("%10" PRIu64 "  0x%08" PRIx32 "  %-28s", index, rec->pc, disasm);
+  if (rec->reg != TRACE_NO_REG)
+    printf("  x%d = 0x%08" PRIx32, rec->reg, rec->regValue);
+  if (rec->access & TRACE_F_LOAD)
+    printf("  load%d [0x%08" PRIx32 "]", 8 << TRACE_F_SIZE(rec->access),
+        rec->address);
+  if (rec->access & TRACE_F_STORE)
+    printf("  store%d [0x%08" PRIx32 "] = 0x%" PRIx32,
+        8 << TRACE_F_SIZE(rec->access), rec->address, rec->storeValue);
+  putchar('\n');
+}
+
+
+static void printRegisters(uint64_t index, const uint32_t *regs)
+{
+  printf("Registers after instruction %" PRIu64 ":\n", index);
+  for (int i = 0; i < TRACE_NUM_REGS; i++)
+    printf("  x%-2d 0x%08" PRIx32 "%s", i, regs[i], i % 4 == 3 ? "\n" : "");
+}
+
+
+static t_simContext *loadExecutable(const char *path, t_memAddress load)
+{
+  t_ldrFileType type = ldrDetectExecType(path);
+  if (type == LDR_FORMAT_DETECT_ERROR)
+    return NULL;
+  t_simContext *ctx = newSimContext();
+  if (!ctx)
+    return NULL;
+  t_ldrError err = type == LDR_FORMAT_BINARY
+      ? ldrLoadBinary(ctx, path, load, load)
+      : ldrLoadELF(ctx, path);
+  if (err != LDR_NO_ERROR) {
+    deleteSimContext(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+
+static bool parseNumber(const char *str, uint64_t *out)
+{
+  char *end;
+  *out = strtoull(str, &end, 0);
+  return end != str && *end == '\0';
+}
+
+
+int main(int argc, char *argv[])
+{
+  int ch;
+  static const struct option options[] = {
+      {      "addr", required_argument, NULL, 'a'},
+      {     "count", required_argument, NULL, 'c'},
+      {"executable", required_argument, NULL, 'e'},
+      {      "help",       no_argument, NULL, 'h'},
+      { "load-addr", required_argument, NULL, 'l'},
+      {        "pc", required_argument, NULL, 'p'},
+      {       "reg", required_argument, NULL, 'r'},
+      {   "regs-at", required_argument, NULL, 'R'},
+      {     "start", required_argument, NULL, 's'},
+      {   "summary",       no_argument, NULL, 'S'},
+      {        NULL,                 0, NULL,   0}
+  };
+
+  char *name = argv[0];
+  t_filter filter = {false, 0, false, 0, -1, 0, UINT64_MAX};
+  const char *exePath = NULL;
+  uint64_t load = 0;
+  bool summary = false;
+  bool hasRegsAt = false;
+  uint64_t regsAt = 0;
+  uint64_t val;
+
+  while ((ch = getopt_long(argc, argv, "a:c:e:hl:p:r:R:s:S", options, NULL)) !=
+      -1) {
+    switch (ch) {
+      case 'a':
+        if (!parseNumber(optarg, &val)) {
+          fprintf(stderr, "Invalid address\n");
+          return 1;
+        }
+        filter.hasAddr = true;
+        filter.addr = (t_memAddress)val;
+        break;
+      case 'c':
+        if (!parseNumber(optarg, &filter.count)) {
+          fprintf(stderr, "Invalid instruction count\n");
+          return 1;
+        }
+        break;
+      case 'e':
+        exePath = optarg;
+        break;
+      case 'l':
+        if (!parseNumber(optarg, &load)) {
+          fprintf(stderr, "Invalid load address\n");
+          return 1;
+        }
+        break;
+      case 'p':
+        if (!parseNumber(optarg, &val)) {
+          fprintf(stderr, "Invalid address\n");
+          return 1;
+        }
+        filter.hasPC = true;
+        filter.pc = (t_memAddress)val;
+        break;
+      case 'r':
+        if (*optarg == 'x')
+          optarg++;
+        if (!parseNumber(optarg, &val) || val >= TRACE_NUM_REGS) {
+          fprintf(stderr, "Invalid register\n");
+          return 1;
+        }
+        filter.reg = (int)val;
+        break;
+      case 'R':
+        if (!parseNumber(optarg, &regsAt)) {
+          fprintf(stderr, "Invalid instruction index\n");
+          return 1;
+        }
+        hasRegsAt = true;
+        break;
+      case 's':
+        if (!parseNumber(optarg, &filter.start)) {
+          fprintf(stderr, "Invalid instruction index\n");
+          return 1;
+        }
+        break;
+      case 'S':
+        summary = true;
+        break;
+      case 'h':
+        usage(name);
+        return 0;
+      default:
+        usage(name);
+        return 1;
+    }
+  }
+  argc -= optind;
+  argv += optind;
+  if (argc != 1) {
+    usage(name);
+    return 1;
+  }
+
+  t_traceReader *reader;
+  t_traceError err = traceOpen(argv[0], &reader);
+  if (err == TRACE_INVALID_FORMAT) {
+    fprintf(stderr, "Not a valid trace, exiting.\n");
+    return 2;
+  } else if (err != TRACE_NO_ERROR) {
+    fprintf(stderr, "Could not open the trace, exiting.\n");
+    return 2;
+  }
+
+  t_simContext *ctx = NULL;
+  if (!summary && !hasRegsAt) {
+    if (!exePath)
+      exePath = traceGetExecutable(reader);
+    ctx = loadExecutable(exePath, (t_memAddress)load);
+    if (!ctx)
+      fprintf(stderr, "Could not load \"%s\", instructions will not be "
+                      "disassembled.\n", exePath);
+  }
+  if (hasRegsAt && regsAt == 0)
+    printRegisters(0, traceGetRegisters(reader));
+
+  uint64_t index = 0, printed = 0;
+  uint64_t jumps = 0, loads = 0, stores = 0;
+  t_memAddress prevPC = traceGetStartPC(reader) - 4;
+  t_traceRecord rec;
+  while ((err = traceRead(reader, &rec)) == TRACE_NO_ERROR) {
+    index++;
+    if (summary) {
+      // compressed instructions are followed by the one 2 bytes after them
+      jumps += rec.pc != prevPC + 4 && rec.pc != prevPC + 2;
+      loads += (rec.access & TRACE_F_LOAD) != 0;
+      stores += (rec.access & TRACE_F_STORE) != 0;
+      prevPC = rec.pc;
+    } else if (hasRegsAt) {
+      if (index == regsAt) {
+        printRegisters(index, traceGetRegisters(reader));
+        break;
+      }
+    } else if (index > filter.start && filterMatches(&filter, &rec)) {
+      if (printed++ == filter.count)
+        break;
+      printRecord(ctx, index, &rec);
+    }
+  }
+  if (err == TRACE_INVALID_FORMAT)
+    fprintf(stderr, "The trace is truncated or corrupted.\n");
+
+  if (summary) {
+    printf("%" PRIu64 " instructions\n", index);
+    printf("%" PRIu64 " jumps\n", jumps);
+    printf("%" PRIu64 " loads\n", loads);
+    printf("%" PRIu64 " stores\n", stores);
+  } else if (hasRegsAt && index < regsAt) {
+    fprintf(stderr, "The trace has only %" PRIu64 " instructions.\n", index);
+  }
+
+  deleteSimContext(ctx);
+  traceCloseReader(reader);
+  return err == TRACE_INVALID_FORMAT ? 2 : 0;
+}
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#include "cpu.h"
+
+#define SNAP_MAGIC_SIZE (sizeof(SNAP_MAGIC) - 1)
+#define SNAP_NUM_REGS 32
+#define SNAP_HEADER_WORDS (1 + 1 + SNAP_NUM_REGS + 2 + 1 + 1 + 1)
+#define SNAP_AREA_WORDS 4
+#define SNAP_ALIGN(x) (((x) + MEM_PAGE_SIZE - 1) & ~(size_t)(MEM_PAGE_SIZE - 1))
+
+
+static void snapPut32(uint8_t *out, uint32_t x)
+{
+  out[0] = (uint8_t)(x & 0xFF);
+  out[1] = (uint8_t)((x >> 8) & 0xFF);
+  out[2] = (uint8_t)((x >> 16) & 0xFF);
+  out[3] = (uint8_t)(x >> 24);
+}
+
+
+static uint32_t snapGet32(const uint8_t *in)
+{
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) |
+      ((uint32_t)in[3] << 24);
+}
+
+
+typedef struct {
+  t_memAddress base;
+  t_memSize extent;
+  const uint8_t *buffer;
+  /* bytes stored in the file, the rest of the extent is zero */
+  t_memSize size;
+} t_snapArea;
+
+
+static t_memSize snapTrimmedSize(const uint8_t *buffer, t_memSize extent)
+{
+  while (extent > 0 && buffer[extent - 1] == 0)
+    extent--;
+  return extent;
+}
+
+
+/* Number of whole pages of zeros at the start of the buffer */
+static t_memSize snapLeadingZeros(const uint8_t *buffer, t_memSize extent)
+{
+  t_memSize res = 0;
+  while (res < extent && buffer[res] == 0)
+    res++;
+  return res & ~(t_memSize)(MEM_PAGE_SIZE - 1);
+}
+
+
+/* Lists the areas to save. The stack is used from its top, so the unused
+ * pages of an area are saved as a separate area with no contents. */
+static int snapListAreas(t_simContext *ctx, t_snapArea **outAreas)
+{
+  int numAreas = 0;
+  t_memAddress base;
+  t_memSize extent;
+  const uint8_t *buffer;
+  while (memGetArea(ctx, numAreas, &base, &extent, &buffer))
+    numAreas++;
+  t_snapArea *areas = malloc(sizeof(t_snapArea) * (size_t)(numAreas * 2 + 1));
+  if (!areas)
+    return -1;
+
+  int n = 0;
+  for (int i = 0; i < numAreas; i++) {
+    memGetArea(ctx, i, &base, &extent, &buffer);
+    t_memSize lead = snapLeadingZeros(buffer, extent);
+    if (lead > 0 && lead < extent) {
+      areas[n].base = base;
+      areas[n].extent = lead;
+      areas[n].buffer = buffer;
+      areas[n++].size = 0;
+      base += lead;
+      extent -= lead;
+      buffer += lead;
+    }
+    areas[n].base = base;
+    areas[n].extent = extent;
+    areas[n].buffer = buffer;
+    areas[n++].size = snapTrimmedSize(buffer, extent);
+  }
+  *outAreas = areas;
+  return n;
+}
+
+
+t_snapError snapSave(t_simContext *ctx, const char *path)
+{
+  if (svGetInputUsed(ctx))
+    return SNAP_INPUT_USED;
+
+  t_snapArea *areas;
+  int numAreas = snapListAreas(ctx, &areas);
+  if (numAreas < 0)
+    return SNAP_MEMORY_ERROR;
+  size_t outputLength;
+  const char *output = svGetRecordedOutput(ctx, &outputLength);
+
+  size_t headerSize = SNAP_MAGIC_SIZE + 4 * SNAP_HEADER_WORDS +
+      4 * SNAP_AREA_WORDS * (size_t)numAreas;
+  uint8_t *header = malloc(headerSize);
+  if (!header) {
+    free(areas);
+    return SNAP_MEMORY_ERROR;
+  }
+  /* a pending system call is executed again when the program is resumed */
+  uint64_t instrCount = cpuGetInstructionCount(ctx);
+  if (cpuGetLastStatus(ctx) == CPU_STATUS_ECALL_TRAP)
+    instrCount--;
+  uint8_t *p = header;
+  memcpy(p, SNAP_MAGIC, SNAP_MAGIC_SIZE);
+  p += SNAP_MAGIC_SIZE;
+  snapPut32(p, SNAP_VERSION);
+  snapPut32(p + 4, cpuGetRegister(ctx, CPU_REG_PC));
+  p += 8;
+  for (int i = 0; i < SNAP_NUM_REGS; i++, p += 4)
+    snapPut32(p, cpuGetRegister(ctx, (t_cpuRegID)i));
+  snapPut32(p, (uint32_t)instrCount);
+  snapPut32(p + 4, (uint32_t)(instrCount >> 32));
+  snapPut32(p + 8, svGetStackBottom(ctx));
+  snapPut32(p + 12, (uint32_t)outputLength);
+  snapPut32(p + 16, (uint32_t)numAreas);
+  p += 20;
+  size_t offset = SNAP_ALIGN(headerSize + outputLength);
+  for (int i = 0; i < numAreas; i++, p += 4 * SNAP_AREA_WORDS) {
+    snapPut32(p, areas[i].base);
+    snapPut32(p + 4, areas[i].extent);
+    snapPut32(p + 8, (uint32_t)offset);
+    snapPut32(p + 12, areas[i].size);
+    offset = SNAP_ALIGN(offset + areas[i].size);
+  }
+
+  FILE *fp = fopen(path, "wb");
+  if (!fp) {
+    free(header);
+    free(areas);
+    return SNAP_FILE_ERROR;
+  }
+  bool ok = fwrite(header, 1, headerSize, fp) == headerSize &&
+      (outputLength == 0 ||
+          fwrite(output, 1, outputLength, fp) == outputLength);
+  p = header + SNAP_MAGIC_SIZE + 4 * SNAP_HEADER_WORDS;
+  for (int i = 0; ok && i < numAreas; i++, p += 4 * SNAP_AREA_WORDS) {
+    size_t size = areas[i].size;
+    ok = fseek(fp, (long)snapGet32(p + 8), SEEK_SET) == 0 &&
+        fwrite(areas[i].buffer, 1, size, fp) == size;
+  }
+  free(header);
+  free(areas);
+  if (fclose(fp) != 0)
+    ok = false;
+  return ok ? SNAP_NO_ERROR : SNAP_FILE_ERROR;
+}
+
+
+t_snapError snapTake(const t_ldrImage *image, t_memSize stackSize,
+    t_svStopKind kind, uint64_t value, const char *path)
+{
+  t_snapError err = SNAP_MEMORY_ERROR;
+  FILE *in = fopen("/dev/null", "rb");
+  FILE *out = fopen("/dev/null", "wb");
+  t_simContext *ctx = newSimContext();
+  if (!in || !out || !ctx)
+    goto cleanup;
+
+  svSetIOFiles(ctx, in, out);
+  svSetBufferedIO(ctx, true);
+  svSetOutputRecording(ctx, true);
+  svSetStackSize(ctx, stackSize);
+  if (ldrLoadImage(ctx, image) != LDR_NO_ERROR ||
+      initSupervisor(ctx) != SV_NO_ERROR)
+    goto cleanup;
+  svSetStopPoint(ctx, kind, value);
+  if (svVMRun(ctx) == SV_STATUS_STOPPED)
+    err = snapSave(ctx, path);
+  else
+    err = SNAP_NOT_REACHED;
+
+cleanup:
+  deleteSimContext(ctx);
+  if (in)
+    fclose(in);
+  if (out)
+    fclose(out);
+  return err;
+}
+
+
+t_snapError snapOpen(const char *path, t_snapshot **outSnap)
+{
+  t_snapshot *snap = calloc(1, sizeof(t_snapshot));
+  if (!snap)
+    return SNAP_MEMORY_ERROR;
+  snap->image = calloc(1, sizeof(t_ldrImage));
+  if (!snap->image) {
+    free(snap);
+    return SNAP_MEMORY_ERROR;
+  }
+  t_ldrImage *image = snap->image;
+  image->fp = fopen(path, "rb");
+  if (!image->fp) {
+    snapClose(snap);
+    return SNAP_FILE_ERROR;
+  }
+
+  uint8_t header[SNAP_MAGIC_SIZE + 4 * SNAP_HEADER_WORDS];
+  if (fread(header, 1, sizeof(header), image->fp) != sizeof(header) ||
+      memcmp(header, SNAP_MAGIC, SNAP_MAGIC_SIZE) != 0 ||
+      snapGet32(header + SNAP_MAGIC_SIZE) != SNAP_VERSION) {
+    snapClose(snap);
+    return SNAP_INVALID_FORMAT;
+  }
+  const uint8_t *p = header + SNAP_MAGIC_SIZE + 4;
+  image->entry = snapGet32(p);
+  p += 4;
+  for (int i = 0; i < SNAP_NUM_REGS; i++, p += 4)
+    snap->regs[i] = snapGet32(p);
+  snap->instrCount = snapGet32(p) | ((uint64_t)snapGet32(p + 4) << 32);
+  snap->stackBottom = snapGet32(p + 8);
+  snap->outputLength = snapGet32(p + 12);
+  uint32_t numAreas = snapGet32(p + 16);
+  if (numAreas > 0x10000) {
+    snapClose(snap);
+    return SNAP_INVALID_FORMAT;
+  }
+
+  image->segments = malloc(sizeof(t_ldrSegment) * (numAreas + 1));
+  snap->output = malloc(snap->outputLength + 1);
+  if (!image->segments || !snap->output) {
+    snapClose(snap);
+    return SNAP_MEMORY_ERROR;
+  }
+  for (uint32_t i = 0; i < numAreas; i++) {
+    uint8_t entry[4 * SNAP_AREA_WORDS];
+    if (fread(entry, 1, sizeof(entry), image->fp) != sizeof(entry)) {
+      snapClose(snap);
+      return SNAP_INVALID_FORMAT;
+    }
+    t_ldrSegment *seg = &image->segments[image->numSegments++];
+    seg->base = snapGet32(entry);
+    seg->extent = snapGet32(entry + 4);
+    seg->fileOffset = snapGet32(entry + 8);
+    seg->fileSize = snapGet32(entry + 12);
+    if (seg->fileSize > seg->extent) {
+      snapClose(snap);
+      return SNAP_INVALID_FORMAT;
+    }
+  }
+  if (fread(snap->output, 1, snap->outputLength, image->fp) !=
+      snap->outputLength) {
+    snapClose(snap);
+    return SNAP_INVALID_FORMAT;
+  }
+  *outSnap = snap;
+  return SNAP_NO_ERROR;
+}
+
+
+void snapClose(t_snapshot *snap)
+{
+  if (!snap)
+    return;
+  if (snap->image->fp)
+    ldrCloseImage(snap->image);
+  else
+    free(snap->image);
+  free(snap->output);
+  free(snap);
+}
+
+
+t_snapError snapLoad(t_simContext *ctx, const t_snapshot *snap)
+{
+  /* the contents of the areas are mapped copy-on-write from the file */
+  t_ldrError err = ldrLoadImage(ctx, snap->image);
+  if (err == LDR_FILE_ERROR)
+    return SNAP_FILE_ERROR;
+  else if (err != LDR_NO_ERROR)
+    return SNAP_MEMORY_ERROR;
+  for (int i = 1; i < SNAP_NUM_REGS; i++)
+    cpuSetRegister(ctx, (t_cpuRegID)i, snap->regs[i]);
+  cpuSetInstructionCount(ctx, snap->instrCount);
+  svRestoreSupervisor(ctx, snap->stackBottom, snap->output, snap->outputLength);
+  return SNAP_NO_ERROR;
+}
@@ -0,0 +1,66 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "memory.h"
+#include "loader.h"
+#include "supervisor.h"
+#include "context.h"
+
+/* Snapshots of a stopped program, from which it can be resumed any number of
+ * times. A snapshot holds the registers, the contents of every mapped area,
+ * the state of the supervisor and the output produced so far. It cannot be
+ * taken after the program has read any input, so that every run resumed
+ * from it can be given a different input.
+ *   In the file all numbers are 32 bit little endian. The header holds
+ * SNAP_MAGIC, the version, the pc, the 32 registers, the instruction count
+ * (low word first), the bottom of the stack, the length of the output and
+ * the number of areas, followed by one entry for each area with its base,
+ * extent, offset of its contents in the file and size of its contents. The
+ * output follows, and then the contents of the areas, each one starting on
+ * a page boundary so that it can be mapped copy-on-write. The trailing zeros
+ * of the areas are not stored, and the zero pages at their start are saved
+ * as separate areas with no contents. */
+
+#define SNAP_MAGIC "SIMSNAP\0"
+#define SNAP_VERSION 1
+
+typedef int t_snapError;
+enum {
+  SNAP_NO_ERROR = 0,
+  SNAP_FILE_ERROR = -1,
+  SNAP_MEMORY_ERROR = -2,
+  SNAP_INVALID_FORMAT = -3,
+  /* the program read input before the snapshot */
+  SNAP_INPUT_USED = -4,
+  /* the program stopped before reaching the snapshot point */
+  SNAP_NOT_REACHED = -5
+};
+
+typedef struct {
+  /* areas of memory, with the pc as the entry point */
+  t_ldrImage *image;
+  uint32_t regs[32];
+  uint64_t instrCount;
+  t_memAddress stackBottom;
+  char *output;
+  size_t outputLength;
+} t_snapshot;
+
+
+/* Saves the state of a program stopped by svVMRun */
+t_snapError snapSave(t_simContext *ctx, const char *path);
+/* Runs the executable with no input and no output until the given stop
+ * point, and saves its state */
+t_snapError snapTake(const t_ldrImage *image, t_memSize stackSize,
+    t_svStopKind kind, uint64_t value, const char *path);
+
+t_snapError snapOpen(const char *path, t_snapshot **outSnap);
+void snapClose(t_snapshot *snap);
+/* Restores the snapshot into a new context, in place of loading an
+ * executable and initializing the supervisor */
+t_snapError snapLoad(t_simContext *ctx, const t_snapshot *snap);
+
+#endif
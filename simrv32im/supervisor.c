@@ -1,33 +1,279 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
 #include <inttypes.h>
+#include <unistd.h>
 #include "supervisor.h"
 #include "memory.h"
 #include "debugger.h"
 
+#define SV_IO_BUFFER_SIZE 0x10000
+
+typedef struct svState {
+  t_memAddress stackBottom;
+  t_memSize stackSize;
+  t_isaInt exitCode;
+  uint64_t instrLimit;
+  FILE *inFile;
+  FILE *outFile;
+  /* Non-interactive I/O state. Output is accumulated and written out when
+   * the buffer fills or the program stops; input is read in large chunks. */
+  bool bufferedIO;
+  char outBuffer[SV_IO_BUFFER_SIZE];
+  size_t outLength;
+  char inBuffer[SV_IO_BUFFER_SIZE];
+  size_t inPos;
+  size_t inLength;
+  /* with memory I/O the input is read from inData, and the output is kept
+   * in the record buffer instead of being written to outFile */
+  bool memoryIO;
+  const char *inData;
+  size_t inDataLength;
+  size_t inDataPos;
+  bool inputUsed;
+  t_svStopKind stopKind;
+  uint64_t stopValue;
+  /* copy of the output, kept while recording is enabled */
+  bool recordOutput;
+  char *record;
+  size_t recordLength;
+  size_t recordCapacity;
+} t_svState;
+
 const t_memAddress svStackTop = 0x80000000;
-t_memAddress svStackBottom;
-t_isaInt svExitCode;
 
 
-t_svError initSupervisor(void)
+t_svState *newSvState(void)
+{
+  t_svState *sv = calloc(1, sizeof(t_svState));
+  if (!sv)
+    return NULL;
+  sv->inFile = stdin;
+  sv->outFile = stdout;
+  sv->stackSize = SV_DEFAULT_STACK_SIZE;
+  return sv;
+}
+
+
+void deleteSvState(t_svState *sv)
+{
+  if (!sv)
+    return;
+  free(sv->record);
+  free(sv);
+}
+
+
+t_svError initSupervisor(t_simContext *ctx)
 {
-  svStackBottom = svStackTop - SV_STACK_PAGE_SIZE;
-  t_memError merr = memMapArea(svStackBottom, SV_STACK_PAGE_SIZE, NULL);
+  t_svState *sv = ctx->sv;
+  /* The whole stack is mapped up front, as its pages take host memory only
+   * once they are used, so that the program does not fault to grow it */
+  sv->stackBottom = svStackTop - sv->stackSize;
+  t_memError merr = memReserveArea(ctx, sv->stackBottom, sv->stackSize);
   if (merr != MEM_NO_ERROR)
     return SV_MEMORY_ERROR;
-  cpuSetRegister(CPU_REG_SP, svStackTop - 4);
+  cpuSetRegister(ctx, CPU_REG_SP, svStackTop - 4);
   return SV_NO_ERROR;
 }
 
 
-void svExpandStack(void)
+bool svExpandStack(t_simContext *ctx)
 {
-  t_memAddress faultAddr = memGetLastFaultAddress();
-  if (faultAddr < svStackBottom &&
-      faultAddr >= (svStackBottom - SV_STACK_PAGE_SIZE)) {
-    svStackBottom -= SV_STACK_PAGE_SIZE;
-    memMapArea(svStackBottom, SV_STACK_PAGE_SIZE, NULL);
+  t_svState *sv = ctx->sv;
+  t_memAddress faultAddr = memGetLastFaultAddress(ctx);
+  if (faultAddr < sv->stackBottom &&
+      faultAddr >= (sv->stackBottom - SV_STACK_PAGE_SIZE)) {
+    if (memMapArea(ctx, sv->stackBottom - SV_STACK_PAGE_SIZE,
+            SV_STACK_PAGE_SIZE, NULL) != MEM_NO_ERROR)
+      return false;
+    sv->stackBottom -= SV_STACK_PAGE_SIZE;
+    return true;
   }
+  return false;
+}
+
+
+void svReset(t_simContext *ctx)
+{
+  t_svState *sv = ctx->sv;
+  sv->stackBottom = 0;
+  sv->exitCode = 0;
+  sv->outLength = 0;
+  sv->inPos = sv->inLength = 0;
+  sv->inDataPos = 0;
+  sv->inputUsed = false;
+  sv->stopKind = SV_STOP_NONE;
+  sv->recordLength = 0;
+}
+
+
+void svSetIOFiles(t_simContext *ctx, FILE *in, FILE *out)
+{
+  t_svState *sv = ctx->sv;
+  sv->inFile = in;
+  sv->outFile = out;
+  sv->memoryIO = false;
+  sv->inData = NULL;
+}
+
+
+void svSetMemoryIO(t_simContext *ctx, const char *input, size_t inputLength)
+{
+  t_svState *sv = ctx->sv;
+  sv->memoryIO = true;
+  sv->bufferedIO = true;
+  sv->inData = input;
+  sv->inDataLength = inputLength;
+  sv->inDataPos = 0;
+  sv->inPos = sv->inLength = 0;
+}
+
+
+void svSetInstructionLimit(t_simContext *ctx, uint64_t limit)
+{
+  ctx->sv->instrLimit = limit;
+}
+
+
+void svSetStackSize(t_simContext *ctx, t_memSize size)
+{
+  if (size > svStackTop - SV_STACK_PAGE_SIZE)
+    size = svStackTop - SV_STACK_PAGE_SIZE;
+  size = (size + SV_STACK_PAGE_SIZE - 1) & ~(t_memSize)(SV_STACK_PAGE_SIZE - 1);
+  ctx->sv->stackSize = size ? size : SV_STACK_PAGE_SIZE;
+}
+
+
+void svSetBufferedIO(t_simContext *ctx, bool enable)
+{
+  t_svState *sv = ctx->sv;
+  fflush(sv->outFile);
+  sv->bufferedIO = enable;
+}
+
+
+static void svRecordOutput(t_svState *sv, const char *str, size_t len);
+
+static void svWriteOutput(t_svState *sv)
+{
+  if (sv->memoryIO) {
+    svRecordOutput(sv, sv->outBuffer, sv->outLength);
+    sv->outLength = 0;
+    return;
+  }
+  size_t done = 0;
+  while (done < sv->outLength) {
+    ssize_t res = write(
+        fileno(sv->outFile), sv->outBuffer + done, sv->outLength - done);
+    if (res <= 0)
+      break;
+    done += (size_t)res;
+  }
+  sv->outLength = 0;
+}
+
+
+static void svRecordOutput(t_svState *sv, const char *str, size_t len)
+{
+  if (len == 0)
+    return;
+  if (sv->recordLength + len > sv->recordCapacity) {
+    size_t capacity = sv->recordCapacity ? sv->recordCapacity * 2 : 256;
+    while (capacity < sv->recordLength + len)
+      capacity *= 2;
+    char *record = realloc(sv->record, capacity);
+    if (!record)
+      return;
+    sv->record = record;
+    sv->recordCapacity = capacity;
+  }
+  memcpy(sv->record + sv->recordLength, str, len);
+  sv->recordLength += len;
+}
+
+
+static void svPutChar(t_svState *sv, char c)
+{
+  if (sv->outLength == SV_IO_BUFFER_SIZE)
+    svWriteOutput(sv);
+  sv->outBuffer[sv->outLength++] = c;
+}
+
+
+static void svPutInt(t_svState *sv, int32_t value)
+{
+  char digits[12];
+  int n = 0;
+  uint32_t mag = value < 0 ? -(uint32_t)value : (uint32_t)value;
+
+  do {
+    digits[n++] = (char)('0' + mag % 10);
+    mag /= 10;
+  } while (mag != 0);
+  if (value < 0)
+    digits[n++] = '-';
+  if (sv->outLength + (size_t)n > SV_IO_BUFFER_SIZE)
+    svWriteOutput(sv);
+  while (n > 0)
+    sv->outBuffer[sv->outLength++] = digits[--n];
+}
+
+
+/* Returns the next input character without consuming it, or EOF */
+static int svPeekChar(t_svState *sv)
+{
+  if (sv->inPos == sv->inLength) {
+    ssize_t res;
+    if (sv->memoryIO) {
+      res = (ssize_t)(sv->inDataLength - sv->inDataPos);
+      if (res > SV_IO_BUFFER_SIZE)
+        res = SV_IO_BUFFER_SIZE;
+      memcpy(sv->inBuffer, sv->inData + sv->inDataPos, (size_t)res);
+      sv->inDataPos += (size_t)res;
+    } else {
+      res = read(fileno(sv->inFile), sv->inBuffer, SV_IO_BUFFER_SIZE);
+    }
+    if (res <= 0)
+      return EOF;
+    sv->inPos = 0;
+    sv->inLength = (size_t)res;
+  }
+  return (unsigned char)sv->inBuffer[sv->inPos];
+}
+
+
+static int svGetChar(t_svState *sv)
+{
+  int c = svPeekChar(sv);
+  if (c != EOF)
+    sv->inPos++;
+  return c;
+}
+
+
+/* Same as scanf("%d") for well-formed input; returns 0 when no number
+ * could be read */
+static int32_t svGetInt(t_svState *sv)
+{
+  int c;
+  while ((c = svPeekChar(sv)) == ' ' || (c >= '\t' && c <= '\r'))
+    sv->inPos++;
+
+  bool neg = false;
+  if (c == '-' || c == '+') {
+    neg = c == '-';
+    sv->inPos++;
+    c = svPeekChar(sv);
+  }
+  uint32_t value = 0;
+  while (c >= '0' && c <= '9') {
+    value = value * 10 + (uint32_t)(c - '0');
+    sv->inPos++;
+    c = svPeekChar(sv);
+  }
+  return (int32_t)(neg ? -value : value);
 }
 
 
@@ -40,32 +286,64 @@ enum {
   SV_SYSCALL_EXIT = 93
 };
 
-t_svStatus svHandleEnvCall(void)
+t_svStatus svHandleEnvCall(t_simContext *ctx)
 {
-  t_cpuURegValue syscallId = cpuGetRegister(CPU_REG_A7);
+  t_svState *sv = ctx->sv;
+  t_cpuURegValue syscallId = cpuGetRegister(ctx, CPU_REG_A7);
   int32_t ret;
+  char str[16];
+
+  if (syscallId == SV_SYSCALL_READ_INT || syscallId == SV_SYSCALL_READ_CHAR) {
+    /* the call is left pending, and is handled when the program resumes */
+    if (sv->stopKind == SV_STOP_AT_INPUT) {
+      sv->stopKind = SV_STOP_NONE;
+      return SV_STATUS_STOPPED;
+    }
+    sv->inputUsed = true;
+  }
+  if (sv->recordOutput) {
+    str[0] = '\0';
+    if (syscallId == SV_SYSCALL_PRINT_INT)
+      snprintf(str, sizeof(str), "%d", cpuGetRegister(ctx, CPU_REG_A0));
+    else if (syscallId == SV_SYSCALL_PRINT_CHAR)
+      str[0] = (char)cpuGetRegister(ctx, CPU_REG_A0);
+    else if (syscallId == SV_SYSCALL_READ_INT && !sv->bufferedIO)
+      strcpy(str, "int value? >");
+    svRecordOutput(sv, str, syscallId == SV_SYSCALL_PRINT_CHAR ? 1
+                                                               : strlen(str));
+  }
 
   switch (syscallId) {
     case SV_SYSCALL_PRINT_INT:
-      fprintf(stdout, "%d", cpuGetRegister(CPU_REG_A0));
+      if (sv->bufferedIO)
+        svPutInt(sv, (int32_t)cpuGetRegister(ctx, CPU_REG_A0));
+      else
+        fprintf(sv->outFile, "%d", cpuGetRegister(ctx, CPU_REG_A0));
       break;
     case SV_SYSCALL_READ_INT:
-      fputs("int value? >", stdout);
-      fscanf(stdin, "%" PRId32, &ret);
-      cpuSetRegister(CPU_REG_A0, (t_cpuURegValue)ret);
+      if (sv->bufferedIO) {
+        ret = svGetInt(sv);
+      } else {
+        fputs("int value? >", sv->outFile);
+        fscanf(sv->inFile, "%" PRId32, &ret);
+      }
+      cpuSetRegister(ctx, CPU_REG_A0, (t_cpuURegValue)ret);
       break;
     case SV_SYSCALL_EXIT_0:
-      svExitCode = 0;
+      sv->exitCode = 0;
       return SV_STATUS_TERMINATED;
     case SV_SYSCALL_PRINT_CHAR:
-      putchar((int)cpuGetRegister(CPU_REG_A0));
+      if (sv->bufferedIO)
+        svPutChar(sv, (char)cpuGetRegister(ctx, CPU_REG_A0));
+      else
+        fputc((int)cpuGetRegister(ctx, CPU_REG_A0), sv->outFile);
       break;
     case SV_SYSCALL_READ_CHAR:
-      ret = getchar();
-      cpuSetRegister(CPU_REG_A0, (t_cpuURegValue)ret);
+      ret = sv->bufferedIO ? svGetChar(sv) : fgetc(sv->inFile);
+      cpuSetRegister(ctx, CPU_REG_A0, (t_cpuURegValue)ret);
       break;
     case SV_SYSCALL_EXIT:
-      svExitCode = (int)cpuGetRegister(CPU_REG_A0);
+      sv->exitCode = (int)cpuGetRegister(ctx, CPU_REG_A0);
       return SV_STATUS_TERMINATED;
     default:
       return SV_STATUS_INVALID_SYSCALL;
@@ -75,40 +353,197 @@ t_svStatus svHandleEnvCall(void)
 }
 
 
-t_isaInt svGetExitCode(void)
+t_isaInt svGetExitCode(t_simContext *ctx)
+{
+  return ctx->sv->exitCode;
+}
+
+
+void svFlushOutput(t_simContext *ctx)
+{
+  svWriteOutput(ctx->sv);
+}
+
+
+void svSetStopPoint(t_simContext *ctx, t_svStopKind kind, uint64_t value)
+{
+  ctx->sv->stopKind = kind;
+  ctx->sv->stopValue = value;
+}
+
+
+void svSetOutputRecording(t_simContext *ctx, bool enable)
+{
+  t_svState *sv = ctx->sv;
+  sv->recordOutput = enable;
+  if (!enable) {
+    free(sv->record);
+    sv->record = NULL;
+    sv->recordLength = sv->recordCapacity = 0;
+  }
+}
+
+
+const char *svGetRecordedOutput(t_simContext *ctx, size_t *outLength)
+{
+  *outLength = ctx->sv->recordLength;
+  return ctx->sv->record;
+}
+
+
+bool svGetInputUsed(t_simContext *ctx)
+{
+  return ctx->sv->inputUsed;
+}
+
+
+t_memAddress svGetStackBottom(t_simContext *ctx)
+{
+  return ctx->sv->stackBottom;
+}
+
+
+void svRestoreSupervisor(t_simContext *ctx, t_memAddress stackBottom,
+    const char *output, size_t outputLength)
 {
-  return svExitCode;
+  t_svState *sv = ctx->sv;
+  sv->stackBottom = stackBottom;
+  if (sv->recordOutput)
+    svRecordOutput(sv, output, outputLength);
+  if (!sv->bufferedIO) {
+    fwrite(output, 1, outputLength, sv->outFile);
+    return;
+  }
+  for (size_t i = 0; i < outputLength; i++)
+    svPutChar(sv, output[i]);
+}
+
+
+/* Returns whether the program has reached its stop point, which is then
+ * cleared */
+static bool svReachedStopPoint(t_simContext *ctx)
+{
+  t_svState *sv = ctx->sv;
+  if ((sv->stopKind == SV_STOP_AT_PC &&
+          cpuGetRegister(ctx, CPU_REG_PC) == sv->stopValue) ||
+      (sv->stopKind == SV_STOP_AFTER_COUNT &&
+          cpuGetInstructionCount(ctx) >= sv->stopValue)) {
+    sv->stopKind = SV_STOP_NONE;
+    return true;
+  }
+  return false;
+}
+
+
+/* Returns how many instructions can be executed before the instruction
+ * limit or the stop point are reached, up to maxInstrs */
+static uint32_t svAllowedInstructions(t_simContext *ctx, uint32_t maxInstrs)
+{
+  t_svState *sv = ctx->sv;
+  uint64_t done = cpuGetInstructionCount(ctx);
+  if (sv->stopKind == SV_STOP_AT_PC)
+    maxInstrs = 1;
+  else if (sv->stopKind == SV_STOP_AFTER_COUNT &&
+      sv->stopValue - done < maxInstrs)
+    maxInstrs = (uint32_t)(sv->stopValue - done);
+  uint64_t limit = sv->instrLimit;
+  if (limit == 0)
+    return maxInstrs;
+  if (done >= limit)
+    return 0;
+  if (limit - done < maxInstrs)
+    return (uint32_t)(limit - done);
+  return maxInstrs;
+}
+
+
+static t_cpuStatus svRunCPU(t_simContext *ctx)
+{
+  /* When the debugger is active it must be able to stop the program at
+   * every instruction, otherwise the CPU can run undisturbed until the next
+   * trap or fault. */
+  if (dbgGetEnabled(ctx))
+    return cpuTick(ctx);
+  return cpuRun(ctx, svAllowedInstructions(ctx, SV_RUN_BATCH_SIZE));
 }
 
 
-t_svStatus svVMTick(void)
+static t_svStatus svHandleCPUStatus(
+    t_simContext *ctx, t_cpuStatus cpuStatus)
 {
   t_svStatus status = SV_STATUS_RUNNING;
 
-  t_dbgResult dbgRes = dbgTick();
+  if (cpuStatus == CPU_STATUS_ECALL_TRAP) {
+    status = svHandleEnvCall(ctx);
+    if (status == SV_STATUS_RUNNING)
+      cpuClearLastFault(ctx);
+  } else if (cpuStatus == CPU_STATUS_EBREAK_TRAP) {
+    if (dbgGetEnabled(ctx))
+      dbgRequestEnter(ctx);
+    cpuClearLastFault(ctx);
+  } else if (cpuStatus == CPU_STATUS_ILL_INST_FAULT)
+    status = SV_STATUS_ILL_INST_FAULT;
+  else if (cpuStatus == CPU_STATUS_MEMORY_FAULT)
+    status = SV_STATUS_MEMORY_FAULT;
+
+  if (status != SV_STATUS_RUNNING)
+    svFlushOutput(ctx);
+  return status;
+}
+
+
+t_svStatus svVMTick(t_simContext *ctx)
+{
+  t_dbgResult dbgRes = dbgTick(ctx);
   if (dbgRes == DBG_RESULT_EXIT) {
-    status = SV_STATUS_KILLED;
-  } else {
-    t_cpuStatus cpuStatus = cpuTick();
-    if (cpuStatus == CPU_STATUS_MEMORY_FAULT) {
-      svExpandStack();
-      cpuClearLastFault();
-      cpuStatus = cpuTick();
-    }
+    svFlushOutput(ctx);
+    return SV_STATUS_KILLED;
+  }
+  if (svReachedStopPoint(ctx)) {
+    svFlushOutput(ctx);
+    return SV_STATUS_STOPPED;
+  }
+  if (svAllowedInstructions(ctx, 1) == 0) {
+    svFlushOutput(ctx);
+    return SV_STATUS_INSTR_LIMIT;
+  }
 
-    if (cpuStatus == CPU_STATUS_ECALL_TRAP) {
-      status = svHandleEnvCall();
-      if (status == SV_STATUS_RUNNING)
-        cpuClearLastFault();
-    } else if (cpuStatus == CPU_STATUS_EBREAK_TRAP) {
-      if (dbgGetEnabled())
-        dbgRequestEnter();
-      cpuClearLastFault();
-    } else if (cpuStatus == CPU_STATUS_ILL_INST_FAULT)
-      status = SV_STATUS_ILL_INST_FAULT;
-    else if (cpuStatus == CPU_STATUS_MEMORY_FAULT)
-      status = SV_STATUS_MEMORY_FAULT;
+  t_cpuStatus cpuStatus = svRunCPU(ctx);
+  while (cpuStatus == CPU_STATUS_MEMORY_FAULT && svExpandStack(ctx)) {
+    cpuClearLastFault(ctx);
+    cpuStatus = svRunCPU(ctx);
   }
+  return svHandleCPUStatus(ctx, cpuStatus);
+}
 
+
+t_svStatus svVMRun(t_simContext *ctx)
+{
+  t_svStatus status = SV_STATUS_RUNNING;
+
+  if (dbgGetEnabled(ctx)) {
+    while (status == SV_STATUS_RUNNING)
+      status = svVMTick(ctx);
+    return status;
+  }
+
+  /* Without the debugger there is nothing to check between batches */
+  while (status == SV_STATUS_RUNNING) {
+    if (svReachedStopPoint(ctx)) {
+      svFlushOutput(ctx);
+      return SV_STATUS_STOPPED;
+    }
+    uint32_t allowed = svAllowedInstructions(ctx, SV_RUN_BATCH_SIZE);
+    if (allowed == 0) {
+      svFlushOutput(ctx);
+      return SV_STATUS_INSTR_LIMIT;
+    }
+    t_cpuStatus cpuStatus = cpuRun(ctx, allowed);
+    if (cpuStatus == CPU_STATUS_MEMORY_FAULT && svExpandStack(ctx)) {
+      cpuClearLastFault(ctx);
+      continue;
+    }
+    status = svHandleCPUStatus(ctx, cpuStatus);
+  }
   return status;
 }
@@ -1,10 +1,17 @@
 #ifndef SUPERVISOR_H
 #define SUPERVISOR_H
 
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include "isa.h"
 #include "cpu.h"
+#include "memory.h"
+#include "context.h"
 
 #define SV_STACK_PAGE_SIZE 4096
+#define SV_DEFAULT_STACK_SIZE 0x800000
+#define SV_RUN_BATCH_SIZE 0x100000
 
 typedef int t_svError;
 enum {
@@ -17,14 +24,65 @@ enum {
   SV_STATUS_RUNNING = 0,
   SV_STATUS_TERMINATED = 1,
   SV_STATUS_KILLED = 2,
+  SV_STATUS_INSTR_LIMIT = 3,
+  SV_STATUS_STOPPED = 4,
   SV_STATUS_MEMORY_FAULT = CPU_STATUS_MEMORY_FAULT,
   SV_STATUS_ILL_INST_FAULT = CPU_STATUS_ILL_INST_FAULT,
   SV_STATUS_INVALID_SYSCALL = -1000
 };
 
+/* Points where svVMRun stops the program and returns SV_STATUS_STOPPED, so
+ * that its state can be saved. Execution can then be resumed by calling
+ * svVMRun again. */
+typedef int t_svStopKind;
+enum {
+  SV_STOP_NONE = 0,
+  /* before executing the instruction at the given address; the program is
+   * run one instruction at a time until then */
+  SV_STOP_AT_PC,
+  /* after the given number of instructions */
+  SV_STOP_AFTER_COUNT,
+  /* before the first system call reading input */
+  SV_STOP_AT_INPUT
+};
+
+
+typedef struct svState t_svState;
+
+t_svState *newSvState(void);
+void deleteSvState(t_svState *sv);
+
+t_svError initSupervisor(t_simContext *ctx);
+/* Clears the state of the program run last, keeping the settings, so that
+ * initSupervisor can be called again */
+void svReset(t_simContext *ctx);
+void svSetIOFiles(t_simContext *ctx, FILE *in, FILE *out);
+/* Sets buffered I/O from and to memory: the program reads the given input,
+ * which must stay valid while it runs, and its output is kept for
+ * svGetRecordedOutput. Output recording must not be enabled as well. */
+void svSetMemoryIO(t_simContext *ctx, const char *input, size_t inputLength);
+void svSetInstructionLimit(t_simContext *ctx, uint64_t limit);
+/* Sets the size of the stack reserved by initSupervisor, which is rounded up
+ * to a multiple of SV_STACK_PAGE_SIZE. The stack still grows one page at a
+ * time past the reservation. */
+void svSetStackSize(t_simContext *ctx, t_memSize size);
+void svSetBufferedIO(t_simContext *ctx, bool enable);
+void svFlushOutput(t_simContext *ctx);
+t_svStatus svVMTick(t_simContext *ctx);
+t_svStatus svVMRun(t_simContext *ctx);
+t_isaInt svGetExitCode(t_simContext *ctx);
 
-t_svError initSupervisor(void);
-t_svStatus svVMTick(void);
-t_isaInt svGetExitCode(void);
+void svSetStopPoint(t_simContext *ctx, t_svStopKind kind, uint64_t value);
+/* When enabled, all the output of the program is also kept in memory */
+void svSetOutputRecording(t_simContext *ctx, bool enable);
+const char *svGetRecordedOutput(t_simContext *ctx, size_t *outLength);
+/* Returns whether the program has used any input system call */
+bool svGetInputUsed(t_simContext *ctx);
+t_memAddress svGetStackBottom(t_simContext *ctx);
+/* Replaces initSupervisor for a program whose memory was restored with its
+ * stack already mapped. The output the program had already produced is
+ * written again. */
+void svRestoreSupervisor(t_simContext *ctx, t_memAddress stackBottom,
+    const char *output, size_t outputLength);
 
 #endif
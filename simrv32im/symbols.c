@@ -0,0 +1,481 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "symbols.h"
+
+
+t_symState *newSymState(void)
+{
+  return calloc(1, sizeof(t_symState));
+}
+
+
+void deleteSymState(t_symState *sym)
+{
+  if (!sym)
+    return;
+  for (int i = 0; i < sym->numSymbols; i++)
+    free(sym->symbols[i].name);
+  free(sym->symbols);
+  free(sym->lines);
+  for (int i = 0; i < sym->numFiles; i++)
+    free(sym->files[i]);
+  free(sym->files);
+  free(sym);
+}
+
+
+bool symAddSymbol(
+    t_symState *sym, const char *name, t_memAddress address, bool global)
+{
+  t_symSymbol *symbols = realloc(
+      sym->symbols, sizeof(t_symSymbol) * (size_t)(sym->numSymbols + 1));
+  if (!symbols)
+    return false;
+  sym->symbols = symbols;
+  char *copy = strdup(name);
+  if (!copy)
+    return false;
+  t_symSymbol *s = &symbols[sym->numSymbols++];
+  s->name = copy;
+  s->address = address;
+  s->global = global;
+  return true;
+}
+
+
+static int symAddFile(t_symState *sym, const char *dir, const char *name)
+{
+  size_t size = strlen(name) + 1;
+  if (dir && name[0] != '/')
+    size += strlen(dir) + 1;
+  char *path = malloc(size);
+  if (!path)
+    return -1;
+  if (dir && name[0] != '/')
+    snprintf(path, size, "%s/%s", dir, name);
+  else
+    memcpy(path, name, size);
+
+  for (int i = 0; i < sym->numFiles; i++) {
+    if (strcmp(sym->files[i], path) == 0) {
+      free(path);
+      return i;
+    }
+  }
+  char **files =
+      realloc(sym->files, sizeof(char *) * (size_t)(sym->numFiles + 1));
+  if (!files) {
+    free(path);
+    return -1;
+  }
+  sym->files = files;
+  files[sym->numFiles] = path;
+  return sym->numFiles++;
+}
+
+
+static bool symAddLine(t_symState *sym, t_memAddress address, int file,
+    int line)
+{
+  if (sym->numLines % 256 == 0) {
+    t_symLine *lines = realloc(
+        sym->lines, sizeof(t_symLine) * (size_t)(sym->numLines + 256));
+    if (!lines)
+      return false;
+    sym->lines = lines;
+  }
+  t_symLine *l = &sym->lines[sym->numLines];
+  l->address = address;
+  l->file = file;
+  l->line = line;
+  l->order = sym->numLines++;
+  return true;
+}
+
+
+/* Bounds-checked reader of the contents of a section */
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+  bool error;
+} t_symReader;
+
+static uint8_t symRead8(t_symReader *rd)
+{
+  if (rd->p >= rd->end) {
+    rd->error = true;
+    return 0;
+  }
+  return *rd->p++;
+}
+
+static uint32_t symReadLE(t_symReader *rd, int size)
+{
+  uint32_t res = 0;
+  for (int i = 0; i < size; i++) {
+    uint32_t byte = symRead8(rd);
+    if (i < 4)
+      res |= byte << (8 * i);
+  }
+  return res;
+}
+
+static uint32_t symReadULEB(t_symReader *rd)
+{
+  uint32_t res = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = symRead8(rd);
+    if (shift < 32)
+      res |= (uint32_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while ((byte & 0x80) && !rd->error);
+  return res;
+}
+
+static int32_t symReadSLEB(t_symReader *rd)
+{
+  uint32_t res = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = symRead8(rd);
+    if (shift < 32)
+      res |= (uint32_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while ((byte & 0x80) && !rd->error);
+  if (shift < 32 && (byte & 0x40))
+    res |= ~(uint32_t)0 << shift;
+  return (int32_t)res;
+}
+
+static const char *symReadString(t_symReader *rd)
+{
+  const char *res = (const char *)rd->p;
+  while (symRead8(rd) != 0 && !rd->error)
+    ;
+  return rd->error ? NULL : res;
+}
+
+
+/* Files are numbered from 1 in each unit */
+typedef struct {
+  int *files;
+  int numFiles;
+  int numDirs;
+  const char *dirs[64];
+} t_symUnitFiles;
+
+static bool symAddUnitFile(
+    t_symState *sym, t_symUnitFiles *uf, const char *name, uint32_t dir)
+{
+  int *files = realloc(uf->files, sizeof(int) * (size_t)(uf->numFiles + 2));
+  if (!files)
+    return false;
+  uf->files = files;
+  const char *dirName =
+      dir > 0 && (int)dir <= uf->numDirs ? uf->dirs[dir - 1] : NULL;
+  files[++uf->numFiles] = symAddFile(sym, dirName, name);
+  return files[uf->numFiles] >= 0;
+}
+
+
+/* Runs the line number program of one unit, adding its rows */
+static bool symRunLineProgram(t_symState *sym, t_symReader *rd)
+{
+  uint32_t unitLength = symReadLE(rd, 4);
+  // the 64-bit DWARF format is not supported
+  if (rd->error || unitLength >= 0xFFFFFFF0 ||
+      unitLength > (size_t)(rd->end - rd->p))
+    return false;
+  t_symReader unit = {rd->p, rd->p + unitLength, false};
+  rd->p = unit.end;
+
+  uint32_t version = symReadLE(&unit, 2);
+  if (version < 2 || version > 4)
+    return false;
+  uint32_t headerLength = symReadLE(&unit, 4);
+  if (unit.error || headerLength > (size_t)(unit.end - unit.p))
+    return false;
+  const uint8_t *program = unit.p + headerLength;
+  uint32_t minInstLength = symRead8(&unit);
+  if (version >= 4)
+    symRead8(&unit);
+  symRead8(&unit);
+  int32_t lineBase = (int8_t)symRead8(&unit);
+  uint32_t lineRange = symRead8(&unit);
+  uint32_t opcodeBase = symRead8(&unit);
+  const uint8_t *opcodeLengths = unit.p;
+  for (uint32_t i = 1; i < opcodeBase; i++)
+    symRead8(&unit);
+  if (unit.error || lineRange == 0 || opcodeBase == 0)
+    return false;
+
+  t_symUnitFiles uf = {NULL, 0, 0, {NULL}};
+  for (;;) {
+    const char *dir = symReadString(&unit);
+    if (!dir || dir[0] == '\0')
+      break;
+    if (uf.numDirs < 64)
+      uf.dirs[uf.numDirs++] = dir;
+  }
+  bool ok = !unit.error;
+  while (ok) {
+    const char *name = symReadString(&unit);
+    if (!name || name[0] == '\0')
+      break;
+    uint32_t dir = symReadULEB(&unit);
+    symReadULEB(&unit);
+    symReadULEB(&unit);
+    ok = symAddUnitFile(sym, &uf, name, dir);
+  }
+  unit.p = program;
+
+  t_memAddress address = 0;
+  uint32_t file = 1;
+  int32_t line = 1;
+  while (ok && unit.p < unit.end && !unit.error) {
+    uint32_t opcode = symRead8(&unit);
+    bool emit = false, endSequence = false;
+    if (opcode >= opcodeBase) {
+      uint32_t adjusted = opcode - opcodeBase;
+      address += (adjusted / lineRange) * minInstLength;
+      line += lineBase + (int32_t)(adjusted % lineRange);
+      emit = true;
+    } else if (opcode == 0) {
+      uint32_t length = symReadULEB(&unit);
+      if (length == 0 || length > (size_t)(unit.end - unit.p)) {
+        ok = false;
+        break;
+      }
+      const uint8_t *next = unit.p + length;
+      uint32_t subOpcode = symRead8(&unit);
+      if (subOpcode == 1) {
+        emit = endSequence = true;
+      } else if (subOpcode == 2) {
+        address = symReadLE(&unit, (int)length - 1);
+      } else if (subOpcode == 3) {
+        const char *name = symReadString(&unit);
+        uint32_t dir = symReadULEB(&unit);
+        ok = name != NULL && symAddUnitFile(sym, &uf, name, dir);
+      }
+      unit.p = next;
+    } else if (opcode == 1) {
+      emit = true;
+    } else if (opcode == 2) {
+      address += symReadULEB(&unit) * minInstLength;
+    } else if (opcode == 3) {
+      line += symReadSLEB(&unit);
+    } else if (opcode == 4) {
+      file = symReadULEB(&unit);
+    } else if (opcode == 8) {
+      address += ((255 - opcodeBase) / lineRange) * minInstLength;
+    } else if (opcode == 9) {
+      address += symReadLE(&unit, 2);
+    } else {
+      // the other standard opcodes do not affect the rows
+      for (uint8_t i = 0; i < opcodeLengths[opcode - 1]; i++)
+        symReadULEB(&unit);
+    }
+
+    if (emit && ok) {
+      int fileIdx =
+          file >= 1 && file <= (uint32_t)uf.numFiles ? uf.files[file] : -1;
+      int rowLine = endSequence || fileIdx < 0 || line < 0 ? 0 : line;
+      ok = symAddLine(sym, address, fileIdx, rowLine);
+    }
+    if (endSequence) {
+      address = 0;
+      file = 1;
+      line = 1;
+    }
+  }
+
+  free(uf.files);
+  return ok && !unit.error;
+}
+
+
+bool symAddLineTable(t_symState *sym, const uint8_t *data, size_t size)
+{
+  t_symReader rd = {data, data + size, false};
+  while (rd.p < rd.end) {
+    if (!symRunLineProgram(sym, &rd))
+      return false;
+  }
+  return true;
+}
+
+
+static int symCompareSymbols(const void *a, const void *b)
+{
+  const t_symSymbol *sa = a, *sb = b;
+  if (sa->address != sb->address)
+    return sa->address < sb->address ? -1 : 1;
+  if (sa->global != sb->global)
+    return sa->global ? -1 : 1;
+  return strcmp(sa->name, sb->name);
+}
+
+/* At the same address the end of a sequence comes before the rows of the
+ * next one, and the later rows of a sequence replace the earlier ones */
+static int symCompareLines(const void *a, const void *b)
+{
+  const t_symLine *la = a, *lb = b;
+  if (la->address != lb->address)
+    return la->address < lb->address ? -1 : 1;
+  if ((la->line == 0) != (lb->line == 0))
+    return la->line == 0 ? -1 : 1;
+  return la->order < lb->order ? -1 : la->order > lb->order;
+}
+
+void symFinish(t_symState *sym)
+{
+  if (sym->numSymbols > 0)
+    qsort(sym->symbols, (size_t)sym->numSymbols, sizeof(t_symSymbol),
+        symCompareSymbols);
+  if (sym->numLines > 0)
+    qsort(sym->lines, (size_t)sym->numLines, sizeof(t_symLine),
+        symCompareLines);
+}
+
+
+const t_symSymbol *symFindSymbol(t_simContext *ctx, t_memAddress address)
+{
+  t_symState *sym = ctx->sym;
+  if (!sym)
+    return NULL;
+  // first symbol after the address; among the symbols at the same address
+  // the first one is preferred
+  int lo = 0, hi = sym->numSymbols;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (sym->symbols[mid].address <= address)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return NULL;
+  t_memAddress found = sym->symbols[lo - 1].address;
+  while (lo > 1 && sym->symbols[lo - 2].address == found)
+    lo--;
+  return &sym->symbols[lo - 1];
+}
+
+
+bool symGetSymbolAddress(
+    t_simContext *ctx, const char *name, t_memAddress *outAddress)
+{
+  t_symState *sym = ctx->sym;
+  if (!sym)
+    return false;
+  const t_symSymbol *found = NULL;
+  for (int i = 0; i < sym->numSymbols; i++) {
+    if (strcmp(sym->symbols[i].name, name) != 0)
+      continue;
+    if (!found || (sym->symbols[i].global && !found->global))
+      found = &sym->symbols[i];
+  }
+  if (!found)
+    return false;
+  *outAddress = found->address;
+  return true;
+}
+
+
+const char *symFindLine(
+    t_simContext *ctx, t_memAddress address, int *outLine)
+{
+  t_symState *sym = ctx->sym;
+  if (!sym)
+    return NULL;
+  int lo = 0, hi = sym->numLines;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (sym->lines[mid].address <= address)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return NULL;
+  const t_symLine *row = &sym->lines[lo - 1];
+  if (row->line == 0 || row->file < 0)
+    return NULL;
+  *outLine = row->line;
+  return sym->files[row->file];
+}
+
+
+static bool symFileMatches(const char *path, const char *name)
+{
+  size_t pathLen = strlen(path), nameLen = strlen(name);
+  if (pathLen < nameLen || strcmp(path + pathLen - nameLen, name) != 0)
+    return false;
+  return pathLen == nameLen || path[pathLen - nameLen - 1] == '/';
+}
+
+bool symGetLineAddress(t_simContext *ctx, const char *file, int line,
+    t_memAddress *outAddress)
+{
+  t_symState *sym = ctx->sym;
+  if (!sym)
+    return false;
+  // the rows are sorted by address, so the first one is the lowest
+  for (int i = 0; i < sym->numLines; i++) {
+    const t_symLine *row = &sym->lines[i];
+    if (row->line == line && row->file >= 0 &&
+        symFileMatches(sym->files[row->file], file)) {
+      *outAddress = row->address;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool symParseAddress(t_simContext *ctx, const char *str, char **end,
+    t_memAddress *outAddress)
+{
+  while (isspace((unsigned char)*str))
+    str++;
+  if (isdigit((unsigned char)*str)) {
+    char *numEnd;
+    unsigned long addr = strtoul(str, &numEnd, 0);
+    *end = numEnd;
+    *outAddress = (t_memAddress)addr;
+    return true;
+  }
+
+  const char *tokEnd = str;
+  while (*tokEnd != '\0' && !isspace((unsigned char)*tokEnd))
+    tokEnd++;
+  *end = (char *)str;
+  if (tokEnd == str)
+    return false;
+  size_t len = (size_t)(tokEnd - str);
+  char *tok = malloc(len + 1);
+  if (!tok)
+    return false;
+  memcpy(tok, str, len);
+  tok[len] = '\0';
+
+  bool found;
+  char *colon = strrchr(tok, ':');
+  char *lineEnd;
+  long line = colon ? strtol(colon + 1, &lineEnd, 10) : 0;
+  if (colon && lineEnd != colon + 1 && *lineEnd == '\0') {
+    *colon = '\0';
+    found = symGetLineAddress(ctx, tok, (int)line, outAddress);
+  } else {
+    found = symGetSymbolAddress(ctx, tok, outAddress);
+  }
+  free(tok);
+  if (found)
+    *end = (char *)tokEnd;
+  return found;
+}
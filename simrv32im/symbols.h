@@ -0,0 +1,68 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "memory.h"
+#include "context.h"
+
+/* Symbols and line table of the executable, used to show where an address
+ * is in terms of labels and of lines of the program it was compiled from.
+ * The line table is read from a DWARF .debug_line section (versions 2 to
+ * 4), like the one written by asrv32im from the .loc directives. */
+typedef struct symSymbol {
+  char *name;
+  t_memAddress address;
+  bool global;
+} t_symSymbol;
+
+typedef struct symLine {
+  t_memAddress address;
+  /* index in the file names; lines are 1-based, 0 ends a sequence */
+  int file;
+  int line;
+  /* position in the table, to keep the sort stable */
+  int order;
+} t_symLine;
+
+typedef struct symState {
+  int numSymbols;
+  t_symSymbol *symbols;
+  int numLines;
+  t_symLine *lines;
+  int numFiles;
+  char **files;
+} t_symState;
+
+
+t_symState *newSymState(void);
+void deleteSymState(t_symState *sym);
+
+bool symAddSymbol(
+    t_symState *sym, const char *name, t_memAddress address, bool global);
+/* Returns false if the section is malformed; the rows read up to the error
+ * are kept */
+bool symAddLineTable(t_symState *sym, const uint8_t *data, size_t size);
+/* Sorts the tables by address, after all the symbols and lines are added */
+void symFinish(t_symState *sym);
+
+/* Returns the last symbol at or before the address, or NULL */
+const t_symSymbol *symFindSymbol(t_simContext *ctx, t_memAddress address);
+bool symGetSymbolAddress(
+    t_simContext *ctx, const char *name, t_memAddress *outAddress);
+/* Returns the name of the file the instruction at the address was compiled
+ * from and sets the line, or returns NULL */
+const char *symFindLine(
+    t_simContext *ctx, t_memAddress address, int *outLine);
+/* Finds the lowest address attributed to the line, in the file with the
+ * given name or whose name ends with "/" and the given name */
+bool symGetLineAddress(t_simContext *ctx, const char *file, int line,
+    t_memAddress *outAddress);
+
+/* Parses an address, a symbol name or file:line, and sets end past it like
+ * strtoul */
+bool symParseAddress(t_simContext *ctx, const char *str, char **end,
+    t_memAddress *outAddress);
+
+#endif
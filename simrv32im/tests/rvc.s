@@ -0,0 +1,132 @@
+# Compressed instructions test.
+# The compressed instructions are written with .half, so that the test does
+# not depend on the assembler choosing them. Most tests execute them in a
+# loop, so that they also run from translated blocks.
+
+.text; .global _start; .global rvc_ret; _start: lui s0,%hi(test_name); addi s0,s0,%lo(test_name); name_print_loop: lb a0,0(s0); beqz a0,prname_done; li a7,11; ecall; addi s0,s0,1; j name_print_loop; test_name: .ascii "rvc"; .byte '.','.',0x00; .balign 4, 0; prname_done:
+
+  # arithmetic
+  test_2: li x28, 2; li t0, 20
+loop_2:
+  .half 0x4515 # c.li a0, 5
+  .half 0x1575 # c.addi a0, -3
+  .half 0x85aa # c.mv a1, a0
+  .half 0x95aa # c.add a1, a0
+  .half 0x6605 # c.lui a2, 1
+  .half 0x8211 # c.srli a2, 4
+  .half 0x060a # c.slli a2, 2
+  .half 0x56c1 # c.li a3, -16
+  .half 0x8689 # c.srai a3, 2
+  .half 0x4731 # c.li a4, 12
+  .half 0x8b29 # c.andi a4, 10
+  .half 0x4419 # c.li s0, 6
+  .half 0x448d # c.li s1, 3
+  .half 0x8c05 # c.sub s0, s1
+  .half 0x8cc1 # c.or s1, s0
+  .half 0x4795 # c.li a5, 5
+  .half 0x8fa5 # c.xor a5, s1
+  .half 0x8fe5 # c.and a5, s1
+  .half 0x0001 # c.nop
+  addi t0, t0, -1; bne t0, zero, loop_2
+  li x29, 2; bne a0, x29, fail
+  li x29, 4; bne a1, x29, fail
+  li x29, 0x400; bne a2, x29, fail
+  li x29, -4; bne a3, x29, fail
+  li x29, 8; bne a4, x29, fail
+  li x29, 3; bne s0, x29, fail
+  li x29, 3; bne s1, x29, fail
+  li x29, 2; bne a5, x29, fail
+
+  # loads and stores
+  test_3: li x28, 3; li t0, 20
+loop_3:
+  .half 0x713d # c.addi16sp -32
+  .half 0x0038 # c.addi4spn a4, sp, 8
+  .half 0x452d # c.li a0, 11
+  .half 0xce2a # c.swsp a0, 28
+  .half 0x45f2 # c.lwsp a1, 28
+  .half 0x5665 # c.li a2, -7
+  .half 0xc350 # c.sw a2, 4(a4)
+  .half 0x4354 # c.lw a3, 4(a4)
+  lw a5, 12(sp)
+  .half 0x6105 # c.addi16sp 32
+  addi t0, t0, -1; bne t0, zero, loop_3
+  li x29, 11; bne a1, x29, fail
+  li x29, -7; bne a3, x29, fail
+  li x29, -7; bne a5, x29, fail
+
+  # branches and jumps, each one skipping a jump to fail
+  test_4: li x28, 4; li t0, 20
+loop_4:
+  li a0, 0
+  .half 0xc119 # c.beqz a0, 6
+  j fail
+  .half 0xe119 # c.bnez a0, 6
+  j loop_4_bnez
+loop_4_bnez:
+  li a0, 1
+  .half 0xe119 # c.bnez a0, 6
+  j fail
+  .half 0xa019 # c.j 6
+  j fail
+cjal_site:
+  .half 0x2019 # c.jal 6
+  j fail
+  la t1, cjal_site; addi t1, t1, 2; bne ra, t1, fail
+  la t1, sub_4
+cjalr_site:
+  .half 0x9302 # c.jalr t1
+  la t1, cjalr_site; addi t1, t1, 2; bne ra, t1, fail
+  li x29, 7; bne a0, x29, fail
+  addi t0, t0, -1; bne t0, zero, loop_4
+
+  # uncompressed instructions in the middle of a word, fused with compressed
+  # ones
+  test_5: li x28, 5; li s0, 0; li t2, 0; li t3, 40
+  .half 0x0001 # c.nop
+loop_5:
+  .half 0x040d # c.addi s0, 3
+  lui a0, 1
+  .half 0x0515 # c.addi a0, 5
+  addi t2, t2, 1
+  sltu a1, t2, t3
+  .half 0x660d # c.lui a2, 3
+  addi a2, a2, 7
+  .half 0xf5ed # c.bnez a1, -22
+  li x29, 120; bne s0, x29, fail
+  li x29, 0x1005; bne a0, x29, fail
+  li x29, 0x3007; bne a2, x29, fail
+
+  # self-modifying code
+  test_6: li x28, 6; li t0, 20
+loop_6a:
+  jal ra, patched_6; li x29, 0x2001; bne a0, x29, fail
+  addi t0, t0, -1; bne t0, zero, loop_6a
+  la t1, patched_6; la t2, tdat; lh t3, 0(t2); sh t3, 4(t1); li t0, 20
+loop_6b:
+  jal ra, patched_6; li x29, 0x2003; bne a0, x29, fail
+  addi t0, t0, -1; bne t0, zero, loop_6b
+  la t1, patched_6; lh t3, 2(t2); sh t3, 2(t1)
+  jal ra, patched_6; li x29, 0x12003; bne a0, x29, fail
+
+  bne x0, x28, pass; fail: j fail_print; fail_string: .ascii "FAIL\n\0"; .balign 4, 0; fail_print: la s0,fail_string; fail_print_loop: lb a0,0(s0); beqz a0,fail_print_exit; li a7,11; ecall; addi s0,s0,1; j fail_print_loop; fail_print_exit: li a7,93; li a0,1; ecall;; pass: j pass_print; pass_string: .ascii "PASS!\n\0"; .balign 4, 0; pass_print: la s0,pass_string; pass_print_loop: lb a0,0(s0); beqz a0,pass_print_exit; li a7,11; ecall; addi s0,s0,1; j pass_print_loop; pass_print_exit: jal zero,rvc_ret;
+
+sub_4:
+  .half 0x451d # c.li a0, 7
+  .half 0x8082 # c.jr ra
+
+patched_6:
+  lui a0, 2
+  .half 0x0505 # c.addi a0, 1
+  .half 0x8082 # c.jr ra
+
+  # the exit system call is in the middle of a word
+  .half 0x0001 # c.nop
+rvc_ret: li a7,93; li a0,0; ecall;
+
+  .data
+.balign 4;
+
+ tdat:
+  .half 0x050d # c.addi a0, 3
+  .half 0x0001 # upper half of lui a0, 0x12
@@ -0,0 +1,22 @@
+# Self-modifying code test.
+# Checks that stores to already executed instructions are visible when the
+# modified instructions are executed again.
+
+.text; .global _start; .global smc_ret; _start: lui s0,%hi(test_name); addi s0,s0,%lo(test_name); name_print_loop: lb a0,0(s0); beqz a0,prname_done; li a7,11; ecall; addi s0,s0,1; j name_print_loop; test_name: .ascii "smc"; .byte '.','.',0x00; .balign 4, 0; prname_done:
+
+  test_2: li x28, 2; li x4, 0; 1: jal x1, patched; li x29, 1; bne x3, x29, fail; addi x4, x4, 1; li x5, 40; bne x4, x5, 1b;
+  test_3: li x28, 3; la x1, patched; la x2, tdat; lw x2, 0(x2); sw x2, 0(x1); jal x1, patched; li x29, 2; bne x3, x29, fail;
+  test_4: li x28, 4; la x1, patched; li x2, 0x30; sb x2, 2(x1); jal x1, patched; li x29, 3; bne x3, x29, fail;
+  test_5: li x28, 5; la x1, patched; li x2, 0x0040; sh x2, 2(x1); jal x1, patched; li x29, 4; bne x3, x29, fail;
+
+  bne x0, x28, pass; fail: j fail_print; fail_string: .ascii "FAIL\n\0"; .balign 4, 0; fail_print: la s0,fail_string; fail_print_loop: lb a0,0(s0); beqz a0,fail_print_exit; li a7,11; ecall; addi s0,s0,1; j fail_print_loop; fail_print_exit: li a7,93; li a0,1; ecall;; pass: j pass_print; pass_string: .ascii "PASS!\n\0"; .balign 4, 0; pass_print: la s0,pass_string; pass_print_loop: lb a0,0(s0); beqz a0,pass_print_exit; li a7,11; ecall; addi s0,s0,1; j pass_print_loop; pass_print_exit: jal zero,smc_ret;
+
+  patched: addi x3, x0, 1; jalr x0, x1, 0;
+
+smc_ret: li a7,93; li a0,0; ecall;
+
+  .data
+.balign 4;
+
+ tdat:
+ tdat1: .word 0x00200193
@@ -0,0 +1,352 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include "trace.h"
+#include "cpu.h"
+
+#define TRACE_RING_BITS 16
+#define TRACE_RING_SIZE (1 << TRACE_RING_BITS)
+#define TRACE_OUT_BUFFER_SIZE (1 << 16)
+/* space needed to encode the largest record */
+#define TRACE_MAX_RECORD_SIZE 32
+
+struct traceReader {
+  FILE *fp;
+  char *exePath;
+  t_memAddress startPC;
+  t_memAddress pc;
+  t_memAddress address;
+  uint32_t regs[TRACE_NUM_REGS];
+};
+
+
+static uint32_t traceZigzag(uint32_t x)
+{
+  return (x << 1) ^ (uint32_t)-(int32_t)(x >> 31);
+}
+
+
+static uint32_t traceUnzigzag(uint32_t x)
+{
+  return (x >> 1) ^ (uint32_t)-(int32_t)(x & 1);
+}
+
+
+static uint8_t *traceEncodeNumber(uint8_t *out, uint32_t x)
+{
+  while (x >= 0x80) {
+    *out++ = (uint8_t)(x | 0x80);
+    x >>= 7;
+  }
+  *out++ = (uint8_t)x;
+  return out;
+}
+
+
+static void traceWriteBytes(t_traceState *trace, const void *data, size_t n)
+{
+  if (fwrite(data, 1, n, trace->fp) != n)
+    trace->writeError = true;
+}
+
+
+static void traceWrite32(t_traceState *trace, uint32_t x)
+{
+  uint8_t buf[4] = {x & 0xFF, (x >> 8) & 0xFF, (x >> 16) & 0xFF, x >> 24};
+  traceWriteBytes(trace, buf, 4);
+}
+
+
+static uint32_t traceAccessMask(uint8_t access)
+{
+  uint32_t size = 1U << TRACE_F_SIZE(access);
+  return size == 4 ? 0xFFFFFFFF : (1U << (size * 8)) - 1;
+}
+
+
+/* Body of the encoder thread */
+static void *traceEncoder(void *arg)
+{
+  t_traceState *trace = arg;
+  uint8_t *buf = malloc(TRACE_OUT_BUFFER_SIZE);
+  uint8_t *out = buf;
+  t_memAddress prevPC = trace->startPC - 4;
+  t_memAddress prevAddress = 0;
+  uint32_t regs[TRACE_NUM_REGS];
+  struct timespec idle = {0, 50000};
+
+  memcpy(regs, trace->startRegs, sizeof(regs));
+  for (;;) {
+    bool done = __atomic_load_n(&trace->done, __ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = trace->tail;
+    if (head == tail) {
+      if (done)
+        break;
+      nanosleep(&idle, NULL);
+      continue;
+    }
+
+    for (; tail != head; tail++) {
+      const t_traceRecord *rec = &trace->ring[tail & trace->ringMask];
+      if (!buf)
+        continue;
+      uint8_t *flags = out++;
+      *flags = rec->access;
+      if (rec->pc != prevPC + 4) {
+        *flags |= TRACE_F_JUMP;
+        out = traceEncodeNumber(out, traceZigzag(rec->pc - (prevPC + 4)));
+      }
+      prevPC = rec->pc;
+      if (rec->reg != TRACE_NO_REG) {
+        *flags |= TRACE_F_REG;
+        *out++ = rec->reg;
+        out = traceEncodeNumber(
+            out, traceZigzag(rec->regValue - regs[rec->reg]));
+        regs[rec->reg] = rec->regValue;
+      }
+      if (rec->access) {
+        out = traceEncodeNumber(out, traceZigzag(rec->address - prevAddress));
+        prevAddress = rec->address;
+        if (rec->access & TRACE_F_STORE)
+          out = traceEncodeNumber(
+              out, rec->storeValue & traceAccessMask(rec->access));
+      }
+      if (out - buf > TRACE_OUT_BUFFER_SIZE - TRACE_MAX_RECORD_SIZE) {
+        traceWriteBytes(trace, buf, (size_t)(out - buf));
+        out = buf;
+      }
+    }
+    __atomic_store_n(&trace->tail, tail, __ATOMIC_RELEASE);
+  }
+
+  if (buf)
+    traceWriteBytes(trace, buf, (size_t)(out - buf));
+  else
+    trace->writeError = true;
+  free(buf);
+  return NULL;
+}
+
+
+void traceWaitForSpace(t_traceState *trace)
+{
+  for (;;) {
+    trace->cachedTail = __atomic_load_n(&trace->tail, __ATOMIC_ACQUIRE);
+    if (trace->head - trace->cachedTail <= trace->ringMask)
+      return;
+    sched_yield();
+  }
+}
+
+
+static void deleteTraceState(t_traceState *trace)
+{
+  if (trace->fp)
+    fclose(trace->fp);
+  free(trace->ring);
+  free(trace);
+}
+
+
+t_traceError traceEnable(
+    t_simContext *ctx, const char *path, const char *exePath)
+{
+  t_traceState *trace = calloc(1, sizeof(t_traceState));
+  if (!trace)
+    return TRACE_MEMORY_ERROR;
+  trace->ring = malloc(sizeof(t_traceRecord) * TRACE_RING_SIZE);
+  trace->ringMask = TRACE_RING_SIZE - 1;
+  if (!trace->ring) {
+    deleteTraceState(trace);
+    return TRACE_MEMORY_ERROR;
+  }
+  trace->fp = fopen(path, "wb");
+  if (!trace->fp) {
+    deleteTraceState(trace);
+    return TRACE_FILE_ERROR;
+  }
+
+  trace->startPC = cpuGetRegister(ctx, CPU_REG_PC);
+  for (int i = 0; i < TRACE_NUM_REGS; i++)
+    trace->startRegs[i] = cpuGetRegister(ctx, (t_cpuRegID)i);
+  size_t exePathLen = strlen(exePath);
+  traceWriteBytes(trace, TRACE_MAGIC, strlen(TRACE_MAGIC));
+  traceWrite32(trace, TRACE_VERSION);
+  traceWrite32(trace, trace->startPC);
+  for (int i = 0; i < TRACE_NUM_REGS; i++)
+    traceWrite32(trace, trace->startRegs[i]);
+  traceWrite32(trace, (uint32_t)exePathLen);
+  traceWriteBytes(trace, exePath, exePathLen);
+  if (trace->writeError) {
+    deleteTraceState(trace);
+    return TRACE_FILE_ERROR;
+  }
+
+  if (pthread_create(&trace->encoder, NULL, traceEncoder, trace) != 0) {
+    deleteTraceState(trace);
+    return TRACE_MEMORY_ERROR;
+  }
+  ctx->trace = trace;
+  cpuSetBlockTranslation(ctx, false);
+  return TRACE_NO_ERROR;
+}
+
+
+t_traceError traceClose(t_simContext *ctx)
+{
+  t_traceState *trace = ctx->trace;
+  if (!trace)
+    return TRACE_NO_ERROR;
+  uint32_t regs[TRACE_NUM_REGS];
+  for (int i = 0; i < TRACE_NUM_REGS; i++)
+    regs[i] = cpuGetRegister(ctx, (t_cpuRegID)i);
+  traceRetire(trace, regs);
+
+  __atomic_store_n(&trace->done, true, __ATOMIC_RELEASE);
+  pthread_join(trace->encoder, NULL);
+  bool error = trace->writeError;
+  if (fclose(trace->fp) != 0)
+    error = true;
+  trace->fp = NULL;
+  deleteTraceState(trace);
+  ctx->trace = NULL;
+  return error ? TRACE_FILE_ERROR : TRACE_NO_ERROR;
+}
+
+
+static bool traceRead32(FILE *fp, uint32_t *out)
+{
+  uint8_t buf[4];
+  if (fread(buf, 1, 4, fp) != 4)
+    return false;
+  *out = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+      ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+  return true;
+}
+
+
+static bool traceDecodeNumber(FILE *fp, uint32_t *out)
+{
+  uint32_t res = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    int c = getc(fp);
+    if (c == EOF)
+      return false;
+    res |= (uint32_t)(c & 0x7F) << shift;
+    if ((c & 0x80) == 0) {
+      *out = res;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+t_traceError traceOpen(const char *path, t_traceReader **outReader)
+{
+  t_traceReader *reader = calloc(1, sizeof(t_traceReader));
+  if (!reader)
+    return TRACE_MEMORY_ERROR;
+  reader->fp = fopen(path, "rb");
+  if (!reader->fp) {
+    free(reader);
+    return TRACE_FILE_ERROR;
+  }
+
+  char magic[sizeof(TRACE_MAGIC) - 1];
+  uint32_t version, exePathLen;
+  bool ok = fread(magic, 1, sizeof(magic), reader->fp) == sizeof(magic) &&
+      memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0 &&
+      traceRead32(reader->fp, &version) && version == TRACE_VERSION &&
+      traceRead32(reader->fp, &reader->startPC);
+  for (int i = 0; ok && i < TRACE_NUM_REGS; i++)
+    ok = traceRead32(reader->fp, &reader->regs[i]);
+  ok = ok && traceRead32(reader->fp, &exePathLen) && exePathLen < 0x10000;
+  if (ok) {
+    reader->exePath = malloc(exePathLen + 1);
+    if (!reader->exePath) {
+      traceCloseReader(reader);
+      return TRACE_MEMORY_ERROR;
+    }
+    ok = fread(reader->exePath, 1, exePathLen, reader->fp) == exePathLen;
+    reader->exePath[exePathLen] = '\0';
+  }
+  if (!ok) {
+    traceCloseReader(reader);
+    return TRACE_INVALID_FORMAT;
+  }
+  reader->pc = reader->startPC - 4;
+  *outReader = reader;
+  return TRACE_NO_ERROR;
+}
+
+
+void traceCloseReader(t_traceReader *reader)
+{
+  if (!reader)
+    return;
+  fclose(reader->fp);
+  free(reader->exePath);
+  free(reader);
+}
+
+
+const char *traceGetExecutable(t_traceReader *reader)
+{
+  return reader->exePath;
+}
+
+
+t_memAddress traceGetStartPC(t_traceReader *reader)
+{
+  return reader->startPC;
+}
+
+
+const uint32_t *traceGetRegisters(t_traceReader *reader)
+{
+  return reader->regs;
+}
+
+
+t_traceError traceRead(t_traceReader *reader, t_traceRecord *rec)
+{
+  int flags = getc(reader->fp);
+  if (flags == EOF)
+    return TRACE_END;
+  uint32_t x;
+
+  reader->pc += 4;
+  if (flags & TRACE_F_JUMP) {
+    if (!traceDecodeNumber(reader->fp, &x))
+      return TRACE_INVALID_FORMAT;
+    reader->pc += traceUnzigzag(x);
+  }
+  rec->pc = reader->pc;
+  rec->reg = TRACE_NO_REG;
+  rec->regValue = 0;
+  if (flags & TRACE_F_REG) {
+    int reg = getc(reader->fp);
+    if (reg == EOF || reg >= TRACE_NUM_REGS ||
+        !traceDecodeNumber(reader->fp, &x))
+      return TRACE_INVALID_FORMAT;
+    rec->reg = (uint8_t)reg;
+    reader->regs[reg] += traceUnzigzag(x);
+    rec->regValue = reader->regs[reg];
+  }
+  rec->access = (uint8_t)(flags & ~(TRACE_F_JUMP | TRACE_F_REG));
+  rec->address = 0;
+  rec->storeValue = 0;
+  if (flags & (TRACE_F_LOAD | TRACE_F_STORE)) {
+    if (!traceDecodeNumber(reader->fp, &x))
+      return TRACE_INVALID_FORMAT;
+    reader->address += traceUnzigzag(x);
+    rec->address = reader->address;
+    if ((flags & TRACE_F_STORE) &&
+        !traceDecodeNumber(reader->fp, &rec->storeValue))
+      return TRACE_INVALID_FORMAT;
+  }
+  return TRACE_NO_ERROR;
+}
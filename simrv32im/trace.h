@@ -0,0 +1,155 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "memory.h"
+#include "context.h"
+
+/* Execution traces.
+ *   The CPU records every retired instruction as a t_traceRecord into a
+ * ring buffer, which is drained by a background thread encoding the records
+ * into the trace file. The ring has a single producer and a single consumer,
+ * so the two threads synchronize only through the head and tail indices.
+ *   In the file each record starts with a byte of TRACE_F_* flags, followed
+ * by the fields they announce, as LEB128 variable-length numbers:
+ *   TRACE_F_JUMP   zigzag(pc - (previous pc + 4)); without it the record is
+ *                  for the instruction after the previous one
+ *   TRACE_F_REG    register number (one byte), then
+ *                  zigzag(new value - previous value of the register)
+ *   TRACE_F_LOAD   zigzag(address - previous access address)
+ *   TRACE_F_STORE  zigzag(address - previous access address), then the
+ *                  value stored
+ * The size of a load or store is 1 << TRACE_F_SIZE(flags).
+ *   The records follow a header with TRACE_MAGIC, the version, the pc and
+ * the registers when recording started (which are the previous values for
+ * the first record) and the path of the executable. */
+
+#define TRACE_MAGIC "SIMTRACE"
+#define TRACE_VERSION 1
+
+#define TRACE_F_JUMP 0x01
+#define TRACE_F_REG 0x02
+#define TRACE_F_LOAD 0x04
+#define TRACE_F_STORE 0x08
+#define TRACE_F_SIZE(flags) (((flags) >> 4) & 3)
+#define TRACE_F_SIZE_BITS(log2Size) ((log2Size) << 4)
+
+#define TRACE_NO_REG 0xFF
+
+typedef int t_traceError;
+enum {
+  TRACE_NO_ERROR = 0,
+  TRACE_FILE_ERROR = -1,
+  TRACE_MEMORY_ERROR = -2,
+  TRACE_INVALID_FORMAT = -3,
+  TRACE_END = -4
+};
+
+typedef struct {
+  t_memAddress pc;
+  t_memAddress address;
+  uint32_t regValue;
+  uint32_t storeValue;
+  /* register written, or TRACE_NO_REG */
+  uint8_t reg;
+  /* TRACE_F_LOAD or TRACE_F_STORE, plus the size; zero if no access */
+  uint8_t access;
+} t_traceRecord;
+
+#define TRACE_NUM_REGS 32
+
+typedef struct traceState {
+  t_traceRecord *ring;
+  uint32_t ringMask;
+  /* written only by the CPU */
+  uint32_t head;
+  uint32_t cachedTail;
+  /* written only by the encoder */
+  uint32_t tail;
+  bool done;
+  /* the instruction being executed, recorded when it retires */
+  t_traceRecord pending;
+  bool hasPending;
+  uint8_t pendingRs2;
+  /* state when recording started */
+  t_memAddress startPC;
+  uint32_t startRegs[TRACE_NUM_REGS];
+  pthread_t encoder;
+  FILE *fp;
+  bool writeError;
+} t_traceState;
+
+
+/* Starts recording the execution to a new trace file. Block translation is
+ * disabled while tracing, and fused instructions are executed separately. */
+t_traceError traceEnable(
+    t_simContext *ctx, const char *path, const char *exePath);
+/* Records the last instruction, then waits for the trace to be written and
+ * closes it */
+t_traceError traceClose(t_simContext *ctx);
+
+/* Waits until there is space in the ring */
+void traceWaitForSpace(t_traceState *trace);
+
+static inline void tracePush(t_traceState *trace, const t_traceRecord *rec)
+{
+  uint32_t head = trace->head;
+  if (head - trace->cachedTail > trace->ringMask)
+    traceWaitForSpace(trace);
+  trace->ring[head & trace->ringMask] = *rec;
+  __atomic_store_n(&trace->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Records the pending instruction, which has retired, taking the values it
+ * wrote from regs */
+static inline void traceRetire(t_traceState *trace, const uint32_t *regs)
+{
+  if (!trace->hasPending)
+    return;
+  t_traceRecord *rec = &trace->pending;
+  if (rec->reg != TRACE_NO_REG)
+    rec->regValue = regs[rec->reg];
+  if (rec->access & TRACE_F_STORE)
+    rec->storeValue = regs[trace->pendingRs2];
+  tracePush(trace, rec);
+  trace->hasPending = false;
+}
+
+/* Starts the record of an instruction. reg is the register it writes, rs2
+ * the one holding the value it stores, if any. */
+static inline void traceBegin(
+    t_traceState *trace, t_memAddress pc, uint8_t reg, uint8_t rs2)
+{
+  trace->pending.pc = pc;
+  trace->pending.reg = reg;
+  trace->pending.access = 0;
+  trace->pendingRs2 = rs2;
+  trace->hasPending = true;
+}
+
+static inline void traceAccess(
+    t_traceState *trace, t_memAddress addr, t_memSize size, bool isStore)
+{
+  trace->pending.address = addr;
+  trace->pending.access = (isStore ? TRACE_F_STORE : TRACE_F_LOAD) |
+      TRACE_F_SIZE_BITS(size == 4 ? 2 : size == 2 ? 1 : 0);
+}
+
+
+/* Reading traces */
+
+typedef struct traceReader t_traceReader;
+
+t_traceError traceOpen(const char *path, t_traceReader **outReader);
+void traceCloseReader(t_traceReader *reader);
+const char *traceGetExecutable(t_traceReader *reader);
+/* Reads the next record; returns TRACE_END at the end of the trace */
+t_traceError traceRead(t_traceReader *reader, t_traceRecord *rec);
+/* Values of the registers after the last record read */
+const uint32_t *traceGetRegisters(t_traceReader *reader);
+t_memAddress traceGetStartPC(t_traceReader *reader);
+
+#endif